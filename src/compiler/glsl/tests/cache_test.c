@@ -442,6 +442,192 @@ test_put_and_get(void)
    disk_cache_destroy(cache);
 }
 
+static void
+test_put_and_get_pack(void)
+{
+   struct disk_cache *cache;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[20];
+   uint8_t *big[3];
+   uint8_t big_key[3][20];
+   uint32_t seed = 1;
+   char *result;
+   size_t size;
+   unsigned i, j;
+
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_TEST_TMP "/pack-cache-dir", 1);
+   setenv("MESA_GLSL_CACHE_PACK", "true", 1);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "4K", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_null(result, "disk_cache_get from pack with non-existent item");
+
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "disk_cache_get from pack (pointer)");
+   expect_equal(size, sizeof(blob), "disk_cache_get from pack (size)");
+   free(result);
+
+   disk_cache_remove(cache, blob_key);
+   expect_true(!does_cache_contain(cache, blob_key),
+               "disk_cache_remove from pack");
+
+   /* Three items that don't compress, of which only two fit in the pack:
+    * adding the last one compacts the pack, dropping the oldest.
+    */
+   for (i = 0; i < 3; i++) {
+      big[i] = malloc(1536);
+      for (j = 0; j < 1536; j++) {
+         seed = seed * 1103515245 + 12345;
+         big[i][j] = seed >> 16;
+      }
+      disk_cache_compute_key(cache, big[i], 1536, big_key[i]);
+      disk_cache_put(cache, big_key[i], big[i], 1536, NULL);
+      wait_until_file_written(cache, big_key[i]);
+   }
+
+   expect_true(!does_cache_contain(cache, big_key[0]),
+               "pack compaction evicts the oldest item");
+   for (i = 1; i < 3; i++) {
+      result = disk_cache_get(cache, big_key[i], &size);
+      expect_true(result && size == 1536 && !memcmp(result, big[i], 1536),
+                  "pack compaction keeps the newest items");
+      free(result);
+   }
+
+   disk_cache_destroy(cache);
+
+   /* Use the pack just written as a prebuilt one for a new, empty cache. */
+   setenv("MESA_GLSL_CACHE_READ_ONLY_PACK_DIRS",
+          CACHE_TEST_TMP "/pack-cache-dir/" CACHE_DIR_NAME, 1);
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_TEST_TMP "/pack-cache-dir-2", 1);
+   unsetenv("MESA_GLSL_CACHE_PACK");
+   cache = disk_cache_create("test", "make_check", 0);
+
+   result = disk_cache_get(cache, big_key[2], &size);
+   expect_true(result && size == 1536 && !memcmp(result, big[2], 1536),
+               "disk_cache_get from read-only pack");
+   free(result);
+
+   disk_cache_destroy(cache);
+
+   for (i = 0; i < 3; i++)
+      free(big[i]);
+
+   unsetenv("MESA_GLSL_CACHE_READ_ONLY_PACK_DIRS");
+   unsetenv("MESA_GLSL_CACHE_MAX_SIZE");
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_TEST_TMP "/mesa-glsl-cache-dir", 1);
+}
+
+static void
+test_compression_and_stats(void)
+{
+   struct disk_cache *cache;
+   struct disk_cache_stats stats;
+   char blob[] = "This blob is written with zlib, read with the default";
+   uint8_t blob_key[20];
+   char *result;
+   size_t size;
+
+   /* Entries can be read back whatever codec they were written with. */
+   setenv("MESA_GLSL_CACHE_COMPRESSION", "zlib", 1);
+   setenv("MESA_GLSL_CACHE_COMPRESSION_LEVEL", "1", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+
+   disk_cache_destroy(cache);
+
+   unsetenv("MESA_GLSL_CACHE_COMPRESSION");
+   unsetenv("MESA_GLSL_CACHE_COMPRESSION_LEVEL");
+   cache = disk_cache_create("test", "make_check", 0);
+
+   disk_cache_get_stats(cache, &stats);
+   expect_equal(stats.hits + stats.misses, 0, "no stats for a new cache");
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "disk_cache_get of a zlib entry (pointer)");
+   expect_equal(size, sizeof(blob), "disk_cache_get of a zlib entry (size)");
+   free(result);
+
+   disk_cache_remove(cache, blob_key);
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_null(result, "disk_cache_get of a removed entry");
+
+   disk_cache_get_stats(cache, &stats);
+   expect_equal(stats.hits, 1, "stats hits");
+   expect_equal(stats.misses, 1, "stats misses");
+   expect_equal(stats.bytes_uncompressed, sizeof(blob),
+                "stats uncompressed bytes");
+   expect_true(stats.bytes_read > 0, "stats compressed bytes");
+
+   disk_cache_destroy(cache);
+}
+
+static void
+test_memory_tier(void)
+{
+   struct disk_cache *cache;
+   struct disk_cache_stats stats;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[20];
+   uint8_t *big;
+   uint8_t big_key[2][20];
+   char *result;
+   size_t size;
+
+   setenv("MESA_GLSL_CACHE_MEMORY_SIZE", "1K", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   /* Entries are found in memory right away, without waiting for the
+    * cache thread to write them.
+    */
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "disk_cache_get from memory (pointer)");
+   expect_equal(size, sizeof(blob), "disk_cache_get from memory (size)");
+   free(result);
+
+   disk_cache_get_stats(cache, &stats);
+   expect_equal(stats.memory_hits, 1, "disk_cache_get from memory (stats)");
+
+   /* Two items that don't fit in memory together: the least recently used
+    * one is dropped.
+    */
+   big = calloc(1, 600);
+   big[0] = 1;
+   disk_cache_compute_key(cache, big, 600, big_key[0]);
+   disk_cache_put(cache, big_key[0], big, 600, NULL);
+   big[0] = 2;
+   disk_cache_compute_key(cache, big, 600, big_key[1]);
+   disk_cache_put(cache, big_key[1], big, 600, NULL);
+   free(big);
+
+   wait_until_file_written(cache, big_key[1]);
+   wait_until_file_written(cache, big_key[0]);
+
+   disk_cache_get_stats(cache, &stats);
+   expect_equal(stats.memory_hits, 2, "memory tier evicts the LRU item");
+   expect_equal(stats.hits, 3, "evicted item is still read from disk");
+
+   disk_cache_remove(cache, blob_key);
+   expect_null(disk_cache_get(cache, blob_key, &size),
+               "disk_cache_remove from memory");
+
+   disk_cache_destroy(cache);
+
+   setenv("MESA_GLSL_CACHE_MEMORY_SIZE", "0", 1);
+}
+
 static void
 test_put_key_and_get_key(void)
 {
@@ -501,10 +687,19 @@ main(void)
 #ifdef ENABLE_SHADER_CACHE
    int err;
 
+   /* The in-memory tier would hide what happens on disk, test it alone. */
+   setenv("MESA_GLSL_CACHE_MEMORY_SIZE", "0", 1);
+
    test_disk_cache_create();
 
    test_put_and_get();
 
+   test_put_and_get_pack();
+
+   test_compression_and_stats();
+
+   test_memory_tier();
+
    test_put_key_and_get_key();
 
    err = rmrf_local(CACHE_TEST_TMP);
@@ -44,6 +44,7 @@
 #include "draw_prim_assembler.h"
 #include "draw_vs.h"
 #include "draw_gs.h"
+#include "draw_tess.h"
 
 #if HAVE_LLVM
 #include "gallivm/lp_bld_init.h"
@@ -133,6 +134,8 @@ draw_create_no_llvm(struct pipe_context *pipe)
 
 boolean draw_init(struct draw_context *draw)
 {
+   unsigned i;
+
    /*
     * Note that several functions compute the clipmask of the predefined
     * formats with hardcoded formulas instead of using these. So modifications
@@ -163,6 +166,11 @@ boolean draw_init(struct draw_context *draw)
    if (!draw_gs_init( draw ))
       return FALSE;
 
+   for (i = 0; i < 4; i++)
+      draw->default_outer_tess_level[i] = 1.0f;
+   for (i = 0; i < 2; i++)
+      draw->default_inner_tess_level[i] = 1.0f;
+
    draw->quads_always_flatshade_last = !draw->pipe->screen->get_param(
       draw->pipe->screen, PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION);
 
@@ -177,10 +185,12 @@ boolean draw_init(struct draw_context *draw)
  * members on each invocation (because their state might have to persist
  * between multiple primitive restart rendering call) but might have to 
  * for each new instance. 
- * This is particularly the case for primitive id's in geometry shader.
+ * This is particularly the case for primitive id's in geometry and
+ * tessellation shaders.
  */
 void draw_new_instance(struct draw_context *draw)
 {
+   draw_tess_new_instance(draw->tes.tess_eval_shader);
    draw_geometry_shader_new_instance(draw->gs.geometry_shader);
    draw_prim_assembler_new_instance(draw->ia);
 }
@@ -445,6 +455,8 @@ draw_set_mapped_constant_buffer(struct draw_context *draw,
                                 unsigned size )
 {
    debug_assert(shader_type == PIPE_SHADER_VERTEX ||
+                shader_type == PIPE_SHADER_TESS_CTRL ||
+                shader_type == PIPE_SHADER_TESS_EVAL ||
                 shader_type == PIPE_SHADER_GEOMETRY);
    debug_assert(slot < PIPE_MAX_CONSTANT_BUFFERS);
 
@@ -459,6 +471,14 @@ draw_set_mapped_constant_buffer(struct draw_context *draw,
       draw->pt.user.gs_constants[slot] = buffer;
       draw->pt.user.gs_constants_size[slot] = size;
       break;
+   case PIPE_SHADER_TESS_CTRL:
+      draw->pt.user.tcs_constants[slot] = buffer;
+      draw->pt.user.tcs_constants_size[slot] = size;
+      break;
+   case PIPE_SHADER_TESS_EVAL:
+      draw->pt.user.tes_constants[slot] = buffer;
+      draw->pt.user.tes_constants_size[slot] = size;
+      break;
    default:
       assert(0 && "invalid shader type in draw_set_mapped_constant_buffer");
    }
@@ -522,6 +542,23 @@ draw_enable_point_sprites(struct draw_context *draw, boolean enable)
 }
 
 
+/**
+ * Gives the draw module a queue whose threads may run the vertex shader on
+ * successive segments of a draw.  The queue belongs to the driver, which
+ * may share it between contexts, and must outlive the draw context.  NULL
+ * keeps all shading on the calling thread.  Only the llvm path honours
+ * this.  Setting the DRAW_VS_THREADS env var to false ignores the queue.
+ */
+void
+draw_set_vs_queue(struct draw_context *draw, struct util_queue *queue)
+{
+   draw_do_flush( draw, DRAW_FLUSH_STATE_CHANGE );
+   if (!debug_get_bool_option("DRAW_VS_THREADS", TRUE))
+      queue = NULL;
+   draw->pt.vs_queue = queue;
+}
+
+
 void
 draw_set_force_passthrough( struct draw_context *draw, boolean enable )
 {
@@ -578,8 +615,8 @@ draw_remove_extra_vertex_attribs(struct draw_context *draw)
 
 
 /**
- * If a geometry shader is present, return its info, else the vertex shader's
- * info.
+ * If a geometry shader is present, return its info, else the tessellation
+ * evaluation shader's info if there is one, else the vertex shader's info.
  */
 struct tgsi_shader_info *
 draw_get_shader_info(const struct draw_context *draw)
@@ -587,6 +624,8 @@ draw_get_shader_info(const struct draw_context *draw)
 
    if (draw->gs.geometry_shader) {
       return &draw->gs.geometry_shader->info;
+   } else if (draw->tes.tess_eval_shader) {
+      return &draw->tes.tess_eval_shader->info;
    } else {
       return &draw->vs.vertex_shader->info;
    }
@@ -711,6 +750,23 @@ draw_total_gs_outputs(const struct draw_context *draw)
    return info->num_outputs + draw->extra_shader_outputs.num;
 }
 
+/**
+ * Return total number of the tessellation evaluation shader outputs,
+ * including any extra output attributes filled in by draw stages.
+ */
+uint
+draw_total_tes_outputs(const struct draw_context *draw)
+{
+   const struct tgsi_shader_info *info;
+
+   if (!draw->tes.tess_eval_shader)
+      return 0;
+
+   info = &draw->tes.tess_eval_shader->info;
+
+   return info->num_outputs + draw->extra_shader_outputs.num;
+}
+
 
 /**
  * Provide TGSI sampler objects for vertex/geometry shaders that use
@@ -826,6 +882,8 @@ draw_current_shader_outputs(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.num_gs_outputs;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.num_tes_outputs;
    return draw->vs.num_vs_outputs;
 }
 
@@ -839,6 +897,8 @@ draw_current_shader_position_output(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.position_output;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.position_output;
    return draw->vs.position_output;
 }
 
@@ -852,6 +912,8 @@ draw_current_shader_viewport_index_output(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->viewport_index_output;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->viewport_index_output;
    return draw->vs.vertex_shader->viewport_index_output;
 }
 
@@ -864,6 +926,8 @@ draw_current_shader_uses_viewport_index(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->info.writes_viewport_index;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->info.writes_viewport_index;
    return draw->vs.vertex_shader->info.writes_viewport_index;
 }
 
@@ -871,7 +935,7 @@ draw_current_shader_uses_viewport_index(const struct draw_context *draw)
 /**
  * Return the index of the shader output which will contain the
  * clip vertex position.
- * Note we don't support clipvertex output in the gs. For clipping
+ * Note we don't support clipvertex output in the gs or tes. For clipping
  * to work correctly hence we return ordinary position output instead.
  */
 uint
@@ -879,6 +943,8 @@ draw_current_shader_clipvertex_output(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.position_output;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.position_output;
    return draw->vs.clipvertex_output;
 }
 
@@ -888,6 +954,8 @@ draw_current_shader_ccdistance_output(const struct draw_context *draw, int index
    debug_assert(index < PIPE_MAX_CLIP_OR_CULL_DISTANCE_ELEMENT_COUNT);
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->ccdistance_output[index];
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->ccdistance_output[index];
    return draw->vs.ccdistance_output[index];
 }
 
@@ -897,6 +965,8 @@ draw_current_shader_num_written_clipdistances(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->info.num_written_clipdistance;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->info.num_written_clipdistance;
    return draw->vs.vertex_shader->info.num_written_clipdistance;
 }
 
@@ -905,6 +975,8 @@ draw_current_shader_num_written_culldistances(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->info.num_written_culldistance;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->info.num_written_culldistance;
    return draw->vs.vertex_shader->info.num_written_culldistance;
 }
 
@@ -1058,6 +1130,8 @@ draw_get_shader_param(enum pipe_shader_type shader, enum pipe_shader_cap param)
    if (draw_get_option_use_llvm()) {
       switch(shader) {
       case PIPE_SHADER_VERTEX:
+      case PIPE_SHADER_TESS_CTRL:
+      case PIPE_SHADER_TESS_EVAL:
       case PIPE_SHADER_GEOMETRY:
          return gallivm_get_shader_param(param);
       default:
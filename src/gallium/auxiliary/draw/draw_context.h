@@ -45,10 +45,13 @@ struct draw_context;
 struct draw_stage;
 struct draw_vertex_shader;
 struct draw_geometry_shader;
+struct draw_tess_ctrl_shader;
+struct draw_tess_eval_shader;
 struct draw_fragment_shader;
 struct tgsi_sampler;
 struct tgsi_image;
 struct tgsi_buffer;
+struct util_queue;
 
 /*
  * structure to contain driver internal information 
@@ -118,6 +121,8 @@ void draw_enable_point_sprites(struct draw_context *draw, boolean enable);
 
 void draw_set_zs_format(struct draw_context *draw, enum pipe_format format);
 
+void draw_set_vs_queue(struct draw_context *draw, struct util_queue *queue);
+
 boolean
 draw_install_aaline_stage(struct draw_context *draw, struct pipe_context *pipe);
 
@@ -150,6 +155,9 @@ draw_total_vs_outputs(const struct draw_context *draw);
 uint
 draw_total_gs_outputs(const struct draw_context *draw);
 
+uint
+draw_total_tes_outputs(const struct draw_context *draw);
+
 void
 draw_texture_sampler(struct draw_context *draw,
                      enum pipe_shader_type shader_type,
@@ -226,6 +234,29 @@ void draw_bind_geometry_shader(struct draw_context *draw,
 void draw_delete_geometry_shader(struct draw_context *draw,
                                  struct draw_geometry_shader *dvs);
 
+/*
+ * Tessellation shader functions
+ */
+struct draw_tess_ctrl_shader *
+draw_create_tess_ctrl_shader(struct draw_context *draw,
+                             const struct pipe_shader_state *shader);
+void draw_bind_tess_ctrl_shader(struct draw_context *draw,
+                                struct draw_tess_ctrl_shader *dtcs);
+void draw_delete_tess_ctrl_shader(struct draw_context *draw,
+                                  struct draw_tess_ctrl_shader *dtcs);
+
+struct draw_tess_eval_shader *
+draw_create_tess_eval_shader(struct draw_context *draw,
+                             const struct pipe_shader_state *shader);
+void draw_bind_tess_eval_shader(struct draw_context *draw,
+                                struct draw_tess_eval_shader *dtes);
+void draw_delete_tess_eval_shader(struct draw_context *draw,
+                                  struct draw_tess_eval_shader *dtes);
+
+void draw_set_tess_state(struct draw_context *draw,
+                         const float default_outer_level[4],
+                         const float default_inner_level[2]);
+
 
 /*
  * Vertex data functions
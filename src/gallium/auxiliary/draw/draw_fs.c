@@ -32,6 +32,11 @@
 #include "util/u_prim.h"
 
 #include "tgsi/tgsi_parse.h"
+#ifdef HAVE_LLVM
+#include "nir/nir_to_tgsi_info.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#endif
 
 #include "draw_fs.h"
 #include "draw_private.h"
@@ -47,7 +52,18 @@ draw_create_fragment_shader(struct draw_context *draw,
    dfs = CALLOC_STRUCT(draw_fragment_shader);
    if (dfs) {
       dfs->base = *shader;
-      tgsi_scan_shader(shader->tokens, &dfs->info);
+#ifdef HAVE_LLVM
+      if (shader->type == PIPE_SHADER_IR_NIR) {
+         /* the nir shader itself belongs to the driver, only keep the info */
+         dfs->base.ir.nir = NULL;
+         nir_tgsi_scan_shader(shader->ir.nir, &dfs->info,
+                              draw->pipe->screen->get_param(draw->pipe->screen,
+                                                            PIPE_CAP_TGSI_TEXCOORD));
+      } else
+#endif
+      {
+         tgsi_scan_shader(shader->tokens, &dfs->info);
+      }
    }
 
    return dfs;
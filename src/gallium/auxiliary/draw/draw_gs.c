@@ -31,6 +31,11 @@
 #include "draw_context.h"
 #ifdef HAVE_LLVM
 #include "draw_llvm.h"
+#include "gallivm/lp_bld_nir.h"
+#include "nir/nir_to_tgsi_info.h"
+#include "compiler/nir/nir.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
 #endif
 
 #include "tgsi/tgsi_parse.h"
@@ -747,13 +752,34 @@ draw_create_geometry_shader(struct draw_context *draw,
 
    gs->draw = draw;
    gs->state = *state;
-   gs->state.tokens = tgsi_dup_tokens(state->tokens);
-   if (!gs->state.tokens) {
-      FREE(gs);
-      return NULL;
-   }
+#ifdef HAVE_LLVM
+   if (state->type == PIPE_SHADER_IR_NIR) {
+      /* NIR is only consumed by the llvm path, on a private copy */
+      nir_shader *nir;
+
+      assert(use_llvm);
+      nir = nir_shader_clone(NULL, state->ir.nir);
+      if (!nir) {
+         FREE(gs);
+         return NULL;
+      }
+      lp_build_nir_prepare(nir);
+      nir_tgsi_scan_shader(nir, &gs->info,
+                           draw->pipe->screen->get_param(draw->pipe->screen,
+                                                         PIPE_CAP_TGSI_TEXCOORD));
+      gs->state.tokens = NULL;
+      gs->state.ir.nir = nir;
+   } else
+#endif
+   {
+      gs->state.tokens = tgsi_dup_tokens(state->tokens);
+      if (!gs->state.tokens) {
+         FREE(gs);
+         return NULL;
+      }
 
-   tgsi_scan_shader(state->tokens, &gs->info);
+      tgsi_scan_shader(state->tokens, &gs->info);
+   }
 
    /* setup the defaults */
    gs->max_out_prims = 0;
@@ -893,6 +919,9 @@ void draw_delete_geometry_shader(struct draw_context *draw,
       align_free(dgs->llvm_prim_ids);
 
       align_free(dgs->gs_input);
+
+      if (dgs->state.type == PIPE_SHADER_IR_NIR)
+         ralloc_free(dgs->state.ir.nir);
    }
 #endif
 
@@ -52,6 +52,8 @@
 
 #include "tgsi/tgsi_exec.h"
 #include "tgsi/tgsi_dump.h"
+#include "gallivm/lp_bld_nir.h"
+#include "compiler/nir/nir.h"
 
 #include "util/u_math.h"
 #include "util/u_pointer.h"
@@ -516,6 +518,12 @@ draw_llvm_create(struct draw_context *draw, LLVMContextRef context)
    llvm->nr_gs_variants = 0;
    make_empty_list(&llvm->gs_variants_list);
 
+   llvm->nr_tcs_variants = 0;
+   make_empty_list(&llvm->tcs_variants_list);
+
+   llvm->nr_tes_variants = 0;
+   make_empty_list(&llvm->tes_variants_list);
+
    return llvm;
 
 fail:
@@ -565,14 +573,17 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_vs_variant%u",
                  variant->shader->variants_cached);
 
-   variant->gallivm = gallivm_create(module_name, llvm->context);
+   variant->gallivm = gallivm_create(module_name, llvm->context, NULL);
 
    create_jit_types(variant);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
    if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
-      tgsi_dump(llvm->draw->vs.vertex_shader->state.tokens, 0);
+      if (llvm->draw->vs.vertex_shader->state.type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(llvm->draw->vs.vertex_shader->state.ir.nir, stderr);
+      else
+         tgsi_dump(llvm->draw->vs.vertex_shader->state.tokens, 0);
       draw_llvm_dump_variant_key(&variant->key);
    }
 
@@ -610,26 +621,45 @@ generate_vs(struct draw_llvm_variant *variant,
             boolean clamp_vertex_color)
 {
    struct draw_llvm *llvm = variant->llvm;
-   const struct tgsi_token *tokens = llvm->draw->vs.vertex_shader->state.tokens;
+   const struct pipe_shader_state *state = &llvm->draw->vs.vertex_shader->state;
    LLVMValueRef consts_ptr =
       draw_jit_context_vs_constants(variant->gallivm, context_ptr);
    LLVMValueRef num_consts_ptr =
       draw_jit_context_num_vs_constants(variant->gallivm, context_ptr);
 
-   lp_build_tgsi_soa(variant->gallivm,
-                     tokens,
-                     vs_type,
-                     NULL /*struct lp_build_mask_context *mask*/,
-                     consts_ptr,
-                     num_consts_ptr,
-                     system_values,
-                     inputs,
-                     outputs,
-                     context_ptr,
-                     NULL,
-                     draw_sampler,
-                     &llvm->draw->vs.vertex_shader->info,
-                     NULL);
+   if (state->type == PIPE_SHADER_IR_NIR)
+      lp_build_nir_soa(variant->gallivm,
+                       state->ir.nir,
+                       vs_type,
+                       NULL /*struct lp_build_mask_context *mask*/,
+                       consts_ptr,
+                       num_consts_ptr,
+                       system_values,
+                       inputs,
+                       outputs,
+                       context_ptr,
+                       NULL,
+                       draw_sampler,
+                       &llvm->draw->vs.vertex_shader->info,
+                       NULL,
+                       NULL);
+   else
+      lp_build_tgsi_soa(variant->gallivm,
+                        state->tokens,
+                        vs_type,
+                        NULL /*struct lp_build_mask_context *mask*/,
+                        consts_ptr,
+                        num_consts_ptr,
+                        system_values,
+                        inputs,
+                        outputs,
+                        context_ptr,
+                        NULL,
+                        draw_sampler,
+                        &llvm->draw->vs.vertex_shader->info,
+                        NULL,
+                        NULL,
+                        NULL);
 
    {
       LLVMValueRef out;
@@ -1553,19 +1583,19 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
    struct lp_build_sampler_soa *sampler = 0;
    LLVMValueRef ret, clipmask_bool_ptr;
    struct draw_llvm_variant_key *key = &variant->key;
-   /* If geometry shader is present we need to skip both the viewport
-    * transformation and clipping otherwise the inputs to the geometry
-    * shader will be incorrect.
+   /* If a geometry or tessellation shader is present we need to skip both
+    * the viewport transformation and clipping otherwise the inputs to the
+    * next shader stage will be incorrect.
     * The code can't handle vp transform when vs writes vp index neither
     * (though this would be fixable here, but couldn't just broadcast
     * the values).
     */
-   const boolean bypass_viewport = key->has_gs || key->bypass_viewport ||
+   const boolean bypass_viewport = key->has_gs_or_tes || key->bypass_viewport ||
                                    vs_info->writes_viewport_index;
-   const boolean enable_cliptest = !key->has_gs && (key->clip_xy ||
-                                                    key->clip_z ||
-                                                    key->clip_user ||
-                                                    key->need_edgeflags);
+   const boolean enable_cliptest = !key->has_gs_or_tes && (key->clip_xy ||
+                                                           key->clip_z ||
+                                                           key->clip_user ||
+                                                           key->need_edgeflags);
    LLVMValueRef variant_func;
    const unsigned pos = draw->vs.position_output;
    const unsigned cv = draw->vs.clipvertex_output;
@@ -1983,7 +2013,8 @@ draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
    /* XXX assumes edgeflag output not at 0 */
    key->need_edgeflags = (llvm->draw->vs.edgeflag_output ? TRUE : FALSE);
    key->ucp_enable = llvm->draw->rasterizer->clip_plane_enable;
-   key->has_gs = llvm->draw->gs.geometry_shader != NULL;
+   key->has_gs_or_tes = llvm->draw->gs.geometry_shader != NULL ||
+                        llvm->draw->tes.tess_eval_shader != NULL;
    key->num_outputs = draw_total_vs_outputs(llvm->draw);
 
    /* All variants of this shader will have the same value for
@@ -2054,7 +2085,7 @@ draw_llvm_dump_variant_key(struct draw_llvm_variant_key *key)
    debug_printf("bypass_viewport = %u\n", key->bypass_viewport);
    debug_printf("clip_halfz = %u\n", key->clip_halfz);
    debug_printf("need_edgeflags = %u\n", key->need_edgeflags);
-   debug_printf("has_gs = %u\n", key->has_gs);
+   debug_printf("has_gs_or_tes = %u\n", key->has_gs_or_tes);
    debug_printf("ucp_enable = %u\n", key->ucp_enable);
 
    for (i = 0 ; i < key->nr_vertex_elements; i++) {
@@ -2085,12 +2116,22 @@ draw_llvm_set_mapped_texture(struct draw_context *draw,
    struct draw_jit_texture *jit_tex;
 
    assert(shader_stage == PIPE_SHADER_VERTEX ||
+          shader_stage == PIPE_SHADER_TESS_CTRL ||
+          shader_stage == PIPE_SHADER_TESS_EVAL ||
           shader_stage == PIPE_SHADER_GEOMETRY);
 
    if (shader_stage == PIPE_SHADER_VERTEX) {
       assert(sview_idx < ARRAY_SIZE(draw->llvm->jit_context.textures));
 
       jit_tex = &draw->llvm->jit_context.textures[sview_idx];
+   } else if (shader_stage == PIPE_SHADER_TESS_CTRL) {
+      assert(sview_idx < ARRAY_SIZE(draw->llvm->tcs_jit_context.textures));
+
+      jit_tex = &draw->llvm->tcs_jit_context.textures[sview_idx];
+   } else if (shader_stage == PIPE_SHADER_TESS_EVAL) {
+      assert(sview_idx < ARRAY_SIZE(draw->llvm->tes_jit_context.textures));
+
+      jit_tex = &draw->llvm->tes_jit_context.textures[sview_idx];
    } else if (shader_stage == PIPE_SHADER_GEOMETRY) {
       assert(sview_idx < ARRAY_SIZE(draw->llvm->gs_jit_context.textures));
 
@@ -2134,6 +2175,24 @@ draw_llvm_set_sampler_state(struct draw_context *draw,
             COPY_4V(jit_sam->border_color, s->border_color.f);
          }
       }
+   } else if (shader_type == PIPE_SHADER_TESS_CTRL ||
+              shader_type == PIPE_SHADER_TESS_EVAL) {
+      struct draw_jit_context *jit_context =
+         shader_type == PIPE_SHADER_TESS_CTRL ?
+         &draw->llvm->tcs_jit_context : &draw->llvm->tes_jit_context;
+
+      for (i = 0; i < draw->num_samplers[shader_type]; i++) {
+         struct draw_jit_sampler *jit_sam = &jit_context->samplers[i];
+
+         if (draw->samplers[shader_type][i]) {
+            const struct pipe_sampler_state *s
+               = draw->samplers[shader_type][i];
+            jit_sam->min_lod = s->min_lod;
+            jit_sam->max_lod = s->max_lod;
+            jit_sam->lod_bias = s->lod_bias;
+            COPY_4V(jit_sam->border_color, s->border_color.f);
+         }
+      }
    } else if (shader_type == PIPE_SHADER_GEOMETRY) {
       for (i = 0; i < draw->num_samplers[PIPE_SHADER_GEOMETRY]; i++) {
          struct draw_jit_sampler *jit_sam = &draw->llvm->gs_jit_context.samplers[i];
@@ -2245,7 +2304,7 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
    struct lp_type gs_type;
    unsigned i;
    struct draw_gs_llvm_iface gs_iface;
-   const struct tgsi_token *tokens = variant->shader->base.state.tokens;
+   const struct pipe_shader_state *state = &variant->shader->base.state;
    LLVMValueRef consts_ptr, num_consts_ptr;
    LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
    struct lp_build_mask_context mask;
@@ -2339,24 +2398,46 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
    }
 
    if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
-      tgsi_dump(tokens, 0);
+      if (state->type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(state->ir.nir, stderr);
+      else
+         tgsi_dump(state->tokens, 0);
       draw_gs_llvm_dump_variant_key(&variant->key);
    }
 
-   lp_build_tgsi_soa(variant->gallivm,
-                     tokens,
-                     gs_type,
-                     &mask,
-                     consts_ptr,
-                     num_consts_ptr,
-                     &system_values,
-                     NULL,
-                     outputs,
-                     context_ptr,
-                     NULL,
-                     sampler,
-                     &llvm->draw->gs.geometry_shader->info,
-                     (const struct lp_build_tgsi_gs_iface *)&gs_iface);
+   if (state->type == PIPE_SHADER_IR_NIR)
+      lp_build_nir_soa(variant->gallivm,
+                       state->ir.nir,
+                       gs_type,
+                       &mask,
+                       consts_ptr,
+                       num_consts_ptr,
+                       &system_values,
+                       NULL,
+                       outputs,
+                       context_ptr,
+                       NULL,
+                       sampler,
+                       &llvm->draw->gs.geometry_shader->info,
+                       (const struct lp_build_tgsi_gs_iface *)&gs_iface,
+                       NULL);
+   else
+      lp_build_tgsi_soa(variant->gallivm,
+                        state->tokens,
+                        gs_type,
+                        &mask,
+                        consts_ptr,
+                        num_consts_ptr,
+                        &system_values,
+                        NULL,
+                        outputs,
+                        context_ptr,
+                        NULL,
+                        sampler,
+                        &llvm->draw->gs.geometry_shader->info,
+                        (const struct lp_build_tgsi_gs_iface *)&gs_iface,
+                        NULL,
+                        NULL);
 
    sampler->destroy(sampler);
 
@@ -2391,7 +2472,7 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_gs_variant%u",
                  variant->shader->variants_cached);
 
-   variant->gallivm = gallivm_create(module_name, llvm->context);
+   variant->gallivm = gallivm_create(module_name, llvm->context, NULL);
 
    create_gs_jit_types(variant);
 
@@ -2490,3 +2571,871 @@ draw_gs_llvm_dump_variant_key(struct draw_gs_llvm_variant_key *key)
                    util_format_name(sampler[i].texture_state.format));
    }
 }
+
+
+/*
+ * Tessellation shaders.
+ *
+ * The patch data lives in plain float[4] arrays laid out by draw_tess.c,
+ * with per-patch attributes in block 0 and per-vertex ones in the
+ * following blocks, except for the control shader input which has no
+ * per-patch block.
+ */
+
+struct draw_tcs_llvm_iface {
+   struct lp_build_tgsi_tess_iface base;
+
+   struct draw_tcs_llvm_variant *variant;
+   LLVMValueRef input;
+   LLVMValueRef output;
+
+   /* the pass over a vector of invocations being generated */
+   struct lp_build_loop_state *loop;
+   struct lp_build_mask_context *mask;
+   struct lp_build_context *blduivec;
+};
+
+static inline const struct draw_tcs_llvm_iface *
+draw_tcs_llvm_iface(const struct lp_build_tgsi_tess_iface *iface)
+{
+   return (const struct draw_tcs_llvm_iface *)iface;
+}
+
+struct draw_tes_llvm_iface {
+   struct lp_build_tgsi_tess_iface base;
+
+   struct draw_tes_llvm_variant *variant;
+   LLVMValueRef input;
+};
+
+static inline const struct draw_tes_llvm_iface *
+draw_tes_llvm_iface(const struct lp_build_tgsi_tess_iface *iface)
+{
+   return (const struct draw_tes_llvm_iface *)iface;
+}
+
+
+/**
+ * Float offset of an attribute channel within a patch buffer,
+ * ((first_block + vertex) * stride + attrib) * 4 + swizzle, with the
+ * vertex index clamped to the buffer size. The result is a vector if any
+ * of the indices is, and a scalar otherwise.
+ */
+static LLVMValueRef
+tess_attrib_offset(struct lp_build_tgsi_context *bld_base,
+                   unsigned stride,
+                   unsigned first_block,
+                   boolean is_vindex_indirect,
+                   LLVMValueRef vertex_index,
+                   boolean is_aindex_indirect,
+                   LLVMValueRef attrib_index,
+                   LLVMValueRef swizzle_index)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   const boolean indirect = is_vindex_indirect || is_aindex_indirect;
+   struct lp_build_context scalar_bld;
+   struct lp_build_context *bld;
+   LLVMValueRef block, offset;
+
+   if (indirect) {
+      bld = &bld_base->uint_bld;
+      swizzle_index = lp_build_broadcast_scalar(bld, swizzle_index);
+      if (!is_aindex_indirect)
+         attrib_index = lp_build_broadcast_scalar(bld, attrib_index);
+      if (vertex_index && !is_vindex_indirect)
+         vertex_index = lp_build_broadcast_scalar(bld, vertex_index);
+   }
+   else {
+      lp_build_context_init(&scalar_bld, gallivm, lp_type_uint(32));
+      bld = &scalar_bld;
+   }
+
+   if (vertex_index) {
+      block = lp_build_min(bld, vertex_index,
+                           lp_build_const_int_vec(gallivm, bld->type,
+                                                  DRAW_TESS_MAX_PATCH_VERTICES - 1));
+      block = lp_build_add(bld, block,
+                           lp_build_const_int_vec(gallivm, bld->type,
+                                                  first_block));
+   }
+   else {
+      block = bld->zero;
+   }
+
+   offset = lp_build_mul_imm(bld, block, stride);
+   offset = lp_build_add(bld, offset, attrib_index);
+   offset = lp_build_shl_imm(bld, offset, 2);
+   return lp_build_add(bld, offset, swizzle_index);
+}
+
+
+static LLVMValueRef
+tess_load(struct lp_build_tgsi_context *bld_base,
+          LLVMValueRef ptr,
+          LLVMValueRef offset,
+          boolean indirect)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef res;
+   unsigned i;
+
+   if (!indirect) {
+      res = LLVMBuildLoad(builder, LLVMBuildGEP(builder, ptr, &offset, 1, ""), "");
+      return lp_build_broadcast_scalar(&bld_base->base, res);
+   }
+
+   res = bld_base->base.undef;
+   for (i = 0; i < bld_base->base.type.length; ++i) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+      LLVMValueRef chan_offset = LLVMBuildExtractElement(builder, offset, idx, "");
+      LLVMValueRef value;
+
+      value = LLVMBuildGEP(builder, ptr, &chan_offset, 1, "");
+      value = LLVMBuildLoad(builder, value, "");
+      res = LLVMBuildInsertElement(builder, res, value, idx, "");
+   }
+   return res;
+}
+
+
+static LLVMValueRef
+draw_tcs_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                          struct lp_build_tgsi_context *bld_base,
+                          boolean is_vindex_indirect,
+                          LLVMValueRef vertex_index,
+                          boolean is_aindex_indirect,
+                          LLVMValueRef attrib_index,
+                          LLVMValueRef swizzle_index)
+{
+   const struct draw_tcs_llvm_iface *tcs = draw_tcs_llvm_iface(tess_iface);
+   LLVMValueRef offset;
+
+   offset = tess_attrib_offset(bld_base,
+                               tcs->variant->shader->base.input_stride, 0,
+                               is_vindex_indirect, vertex_index,
+                               is_aindex_indirect, attrib_index,
+                               swizzle_index);
+   return tess_load(bld_base, tcs->input, offset,
+                    is_vindex_indirect || is_aindex_indirect);
+}
+
+
+static LLVMValueRef
+draw_tcs_llvm_fetch_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                           struct lp_build_tgsi_context *bld_base,
+                           boolean is_vindex_indirect,
+                           LLVMValueRef vertex_index,
+                           boolean is_aindex_indirect,
+                           LLVMValueRef attrib_index,
+                           LLVMValueRef swizzle_index)
+{
+   const struct draw_tcs_llvm_iface *tcs = draw_tcs_llvm_iface(tess_iface);
+   LLVMValueRef offset;
+
+   offset = tess_attrib_offset(bld_base,
+                               tcs->variant->shader->base.output_stride, 1,
+                               is_vindex_indirect, vertex_index,
+                               is_aindex_indirect, attrib_index,
+                               swizzle_index);
+   return tess_load(bld_base, tcs->output, offset,
+                    is_vindex_indirect || is_aindex_indirect);
+}
+
+
+/**
+ * Store the active lanes of a control shader output. With a direct
+ * address all the lanes write the same location, and the last active one
+ * wins.
+ */
+static void
+draw_tcs_llvm_store_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                           struct lp_build_tgsi_context *bld_base,
+                           boolean is_vindex_indirect,
+                           LLVMValueRef vertex_index,
+                           boolean is_aindex_indirect,
+                           LLVMValueRef attrib_index,
+                           LLVMValueRef swizzle_index,
+                           LLVMValueRef value,
+                           LLVMValueRef mask_vec)
+{
+   const struct draw_tcs_llvm_iface *tcs = draw_tcs_llvm_iface(tess_iface);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const boolean indirect = is_vindex_indirect || is_aindex_indirect;
+   LLVMValueRef offset;
+   unsigned i;
+
+   offset = tess_attrib_offset(bld_base,
+                               tcs->variant->shader->base.output_stride, 1,
+                               is_vindex_indirect, vertex_index,
+                               is_aindex_indirect, attrib_index,
+                               swizzle_index);
+
+   value = LLVMBuildBitCast(builder, value, bld_base->base.vec_type, "");
+
+   for (i = 0; i < bld_base->base.type.length; ++i) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+      LLVMValueRef chan_offset = indirect ?
+         LLVMBuildExtractElement(builder, offset, idx, "") : offset;
+      LLVMValueRef ptr, old, val, active;
+
+      ptr = LLVMBuildGEP(builder, tcs->output, &chan_offset, 1, "");
+      old = LLVMBuildLoad(builder, ptr, "");
+      val = LLVMBuildExtractElement(builder, value, idx, "");
+      active = LLVMBuildExtractElement(builder, mask_vec, idx, "");
+      active = LLVMBuildICmp(builder, LLVMIntNE, active,
+                             lp_build_const_int32(gallivm, 0), "");
+      LLVMBuildStore(builder, LLVMBuildSelect(builder, active, val, old, ""),
+                     ptr);
+   }
+}
+
+
+static LLVMValueRef
+draw_tes_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                          struct lp_build_tgsi_context *bld_base,
+                          boolean is_vindex_indirect,
+                          LLVMValueRef vertex_index,
+                          boolean is_aindex_indirect,
+                          LLVMValueRef attrib_index,
+                          LLVMValueRef swizzle_index)
+{
+   const struct draw_tes_llvm_iface *tes = draw_tes_llvm_iface(tess_iface);
+   LLVMValueRef offset;
+
+   offset = tess_attrib_offset(bld_base,
+                               tes->variant->shader->base.input_stride, 1,
+                               is_vindex_indirect, vertex_index,
+                               is_aindex_indirect, attrib_index,
+                               swizzle_index);
+   return tess_load(bld_base, tes->input, offset,
+                    is_vindex_indirect || is_aindex_indirect);
+}
+
+
+static struct lp_type
+tess_soa_type(void)
+{
+   struct lp_type type;
+
+   memset(&type, 0, sizeof type);
+   type.floating = TRUE; /* floating point values */
+   type.sign = TRUE;     /* values are signed */
+   type.norm = FALSE;    /* values are not limited to [0,1] or [-1,1] */
+   type.width = 32;      /* 32-bit float */
+   type.length = lp_native_vector_width / 32;
+   return type;
+}
+
+
+/**
+ * Mask of the lanes whose index, counter + lane, is below limit.
+ */
+static LLVMValueRef
+tess_lane_mask(struct gallivm_state *gallivm,
+               struct lp_build_context *blduivec,
+               LLVMValueRef counter,
+               LLVMValueRef limit,
+               LLVMValueRef *lane_index)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef index = blduivec->undef;
+   unsigned i;
+
+   for (i = 0; i < blduivec->type.length; i++) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+      index = LLVMBuildInsertElement(builder, index, idx, idx, "");
+   }
+   index = LLVMBuildAdd(builder, index,
+                        lp_build_broadcast_scalar(blduivec, counter), "");
+   if (lane_index)
+      *lane_index = index;
+
+   return lp_build_compare(gallivm, blduivec->type, PIPE_FUNC_LESS, index,
+                           lp_build_broadcast_scalar(blduivec, limit));
+}
+
+
+static void
+create_tess_jit_types(struct gallivm_state *gallivm,
+                      LLVMTypeRef *context_ptr_type)
+{
+   LLVMTypeRef texture_type, sampler_type, context_type;
+
+   texture_type = create_jit_texture_type(gallivm, "texture");
+   sampler_type = create_jit_sampler_type(gallivm, "sampler");
+
+   context_type = create_jit_context_type(gallivm, texture_type, sampler_type,
+                                          "draw_jit_context");
+   *context_ptr_type = LLVMPointerType(context_type, 0);
+}
+
+
+/**
+ * Begin a pass of the control shader over all invocations of the patch, a
+ * vector of them at a time.
+ */
+static LLVMValueRef
+tcs_begin_pass(const struct draw_tcs_llvm_iface *tcs)
+{
+   struct gallivm_state *gallivm = tcs->variant->gallivm;
+   LLVMValueRef invocation_id, mask_val;
+
+   lp_build_loop_begin(tcs->loop, gallivm, lp_build_const_int32(gallivm, 0));
+
+   mask_val = tess_lane_mask(gallivm, tcs->blduivec, tcs->loop->counter,
+                             lp_build_const_int32(gallivm,
+                                tcs->variant->shader->base.vertices_out),
+                             &invocation_id);
+   lp_build_mask_begin(tcs->mask, gallivm, tess_soa_type(), mask_val);
+
+   return invocation_id;
+}
+
+
+static void
+tcs_end_pass(const struct draw_tcs_llvm_iface *tcs)
+{
+   struct gallivm_state *gallivm = tcs->variant->gallivm;
+
+   lp_build_mask_end(tcs->mask);
+   lp_build_loop_end_cond(tcs->loop,
+                          lp_build_const_int32(gallivm,
+                             tcs->variant->shader->base.vertices_out),
+                          lp_build_const_int32(gallivm,
+                                               tcs->blduivec->type.length),
+                          LLVMIntUGE);
+}
+
+
+/**
+ * All invocations must have reached the barrier before any goes past it,
+ * so what follows it is a new pass over all of them.
+ */
+static LLVMValueRef
+draw_tcs_llvm_emit_barrier(const struct lp_build_tgsi_tess_iface *tess_iface,
+                           struct lp_build_tgsi_context *bld_base)
+{
+   const struct draw_tcs_llvm_iface *tcs = draw_tcs_llvm_iface(tess_iface);
+
+   tcs_end_pass(tcs);
+   return tcs_begin_pass(tcs);
+}
+
+
+static void
+draw_tcs_llvm_generate(struct draw_llvm *llvm,
+                       struct draw_tcs_llvm_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMContextRef context = gallivm->context;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef float_ptr_type =
+      LLVMPointerType(LLVMFloatTypeInContext(context), 0);
+   LLVMTypeRef arg_types[5];
+   LLVMTypeRef func_type;
+   LLVMValueRef variant_func;
+   LLVMValueRef context_ptr, prim_id;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_build_context blduivec;
+   struct lp_build_loop_state lp_loop;
+   struct lp_build_mask_context mask;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_bld_tgsi_system_values system_values;
+   struct draw_tcs_llvm_iface tcs_iface;
+   struct draw_tess_ctrl_shader *tcs = &variant->shader->base;
+   const struct lp_type tcs_type = tess_soa_type();
+   char func_name[64];
+   unsigned i;
+
+   memset(&system_values, 0, sizeof(system_values));
+
+   util_snprintf(func_name, sizeof(func_name), "draw_llvm_tcs_variant%u",
+                 variant->shader->variants_cached);
+
+   arg_types[0] = variant->context_ptr_type;           /* context */
+   arg_types[1] = float_ptr_type;                      /* input */
+   arg_types[2] = float_ptr_type;                      /* output */
+   arg_types[3] = int32_type;                          /* prim_id */
+   arg_types[4] = int32_type;                          /* patch_vertices_in */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   variant_func = LLVMAddFunction(gallivm->module, func_name, func_type);
+   variant->function = variant_func;
+
+   LLVMSetFunctionCallConv(variant_func, LLVMCCallConv);
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(variant_func, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   context_ptr                = LLVMGetParam(variant_func, 0);
+   tcs_iface.input            = LLVMGetParam(variant_func, 1);
+   tcs_iface.output           = LLVMGetParam(variant_func, 2);
+   prim_id                    = LLVMGetParam(variant_func, 3);
+   system_values.vertices_in  = LLVMGetParam(variant_func, 4);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(tcs_iface.input, "input");
+   lp_build_name(tcs_iface.output, "output");
+   lp_build_name(prim_id, "prim_id");
+   lp_build_name(system_values.vertices_in, "patch_vertices_in");
+
+   tcs_iface.base.fetch_input = draw_tcs_llvm_fetch_input;
+   tcs_iface.base.fetch_output = draw_tcs_llvm_fetch_output;
+   tcs_iface.base.store_output = draw_tcs_llvm_store_output;
+   tcs_iface.base.emit_barrier = tcs->vertices_out > tcs_type.length ?
+                                 draw_tcs_llvm_emit_barrier : NULL;
+   tcs_iface.variant = variant;
+   tcs_iface.loop = &lp_loop;
+   tcs_iface.mask = &mask;
+   tcs_iface.blduivec = &blduivec;
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, variant_func, "entry");
+   builder = gallivm->builder;
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   lp_build_context_init(&blduivec, gallivm, lp_uint_type(tcs_type));
+
+   consts_ptr = draw_jit_context_vs_constants(gallivm, context_ptr);
+   num_consts_ptr = draw_jit_context_num_vs_constants(gallivm, context_ptr);
+
+   /* code generated texture sampling */
+   sampler = draw_llvm_sampler_soa_create(variant->key.samplers);
+
+   system_values.prim_id = lp_build_broadcast_scalar(&blduivec, prim_id);
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      tgsi_dump(tcs->state.tokens, 0);
+      draw_tess_llvm_dump_variant_key(&variant->key);
+   }
+
+   /* one invocation per lane, a vector of them at a time */
+   system_values.invocation_id = tcs_begin_pass(&tcs_iface);
+   lp_build_tgsi_soa(gallivm,
+                     tcs->state.tokens,
+                     tcs_type,
+                     &mask,
+                     consts_ptr,
+                     num_consts_ptr,
+                     &system_values,
+                     NULL,
+                     outputs,
+                     context_ptr,
+                     NULL,
+                     sampler,
+                     &tcs->info,
+                     NULL,
+                     NULL,
+                     &tcs_iface.base);
+   tcs_end_pass(&tcs_iface);
+
+   sampler->destroy(sampler);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, variant_func);
+}
+
+
+static void
+draw_tes_llvm_generate(struct draw_llvm *llvm,
+                       struct draw_tes_llvm_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMContextRef context = gallivm->context;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef float_ptr_type =
+      LLVMPointerType(LLVMFloatTypeInContext(context), 0);
+   LLVMTypeRef arg_types[10];
+   LLVMTypeRef func_type;
+   LLVMValueRef variant_func;
+   LLVMValueRef context_ptr, io_ptr, u_ptr, v_ptr, num_coords, prim_id;
+   LLVMValueRef outer_ptr, inner_ptr;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_build_context bld, blduivec;
+   struct lp_build_loop_state lp_loop;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_bld_tgsi_system_values system_values;
+   struct draw_tes_llvm_iface tes_iface;
+   struct draw_tess_eval_shader *tes = &variant->shader->base;
+   const struct lp_type tes_type = tess_soa_type();
+   LLVMTypeRef vec_ptr_type;
+   char func_name[64];
+   unsigned i;
+
+   memset(&system_values, 0, sizeof(system_values));
+
+   util_snprintf(func_name, sizeof(func_name), "draw_llvm_tes_variant%u",
+                 variant->shader->variants_cached);
+
+   arg_types[0] = variant->context_ptr_type;           /* context */
+   arg_types[1] = float_ptr_type;                      /* input */
+   arg_types[2] = variant->vertex_header_ptr_type;     /* vertex_header */
+   arg_types[3] = float_ptr_type;                      /* u */
+   arg_types[4] = float_ptr_type;                      /* v */
+   arg_types[5] = int32_type;                          /* num_coords */
+   arg_types[6] = int32_type;                          /* prim_id */
+   arg_types[7] = int32_type;                          /* patch_vertices_in */
+   arg_types[8] = float_ptr_type;                      /* outer */
+   arg_types[9] = float_ptr_type;                      /* inner */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   variant_func = LLVMAddFunction(gallivm->module, func_name, func_type);
+   variant->function = variant_func;
+
+   LLVMSetFunctionCallConv(variant_func, LLVMCCallConv);
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(variant_func, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   context_ptr                = LLVMGetParam(variant_func, 0);
+   tes_iface.input            = LLVMGetParam(variant_func, 1);
+   io_ptr                     = LLVMGetParam(variant_func, 2);
+   u_ptr                      = LLVMGetParam(variant_func, 3);
+   v_ptr                      = LLVMGetParam(variant_func, 4);
+   num_coords                 = LLVMGetParam(variant_func, 5);
+   prim_id                    = LLVMGetParam(variant_func, 6);
+   system_values.vertices_in  = LLVMGetParam(variant_func, 7);
+   outer_ptr                  = LLVMGetParam(variant_func, 8);
+   inner_ptr                  = LLVMGetParam(variant_func, 9);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(tes_iface.input, "input");
+   lp_build_name(io_ptr, "io");
+   lp_build_name(u_ptr, "u");
+   lp_build_name(v_ptr, "v");
+   lp_build_name(num_coords, "num_coords");
+   lp_build_name(prim_id, "prim_id");
+   lp_build_name(system_values.vertices_in, "patch_vertices_in");
+   lp_build_name(outer_ptr, "outer");
+   lp_build_name(inner_ptr, "inner");
+
+   tes_iface.base.fetch_input = draw_tes_llvm_fetch_input;
+   tes_iface.base.fetch_output = NULL;
+   tes_iface.base.store_output = NULL;
+   tes_iface.base.emit_barrier = NULL;
+   tes_iface.variant = variant;
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, variant_func, "entry");
+   builder = gallivm->builder;
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   lp_build_context_init(&bld, gallivm, tes_type);
+   lp_build_context_init(&blduivec, gallivm, lp_uint_type(tes_type));
+
+   consts_ptr = draw_jit_context_vs_constants(gallivm, context_ptr);
+   num_consts_ptr = draw_jit_context_num_vs_constants(gallivm, context_ptr);
+
+   /* code generated texture sampling */
+   sampler = draw_llvm_sampler_soa_create(variant->key.samplers);
+
+   system_values.prim_id = lp_build_broadcast_scalar(&blduivec, prim_id);
+   for (i = 0; i < 4; i++)
+      system_values.tess_outer[i] =
+         lp_build_pointer_get(builder, outer_ptr,
+                              lp_build_const_int32(gallivm, i));
+   for (i = 0; i < 2; i++)
+      system_values.tess_inner[i] =
+         lp_build_pointer_get(builder, inner_ptr,
+                              lp_build_const_int32(gallivm, i));
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      tgsi_dump(tes->state.tokens, 0);
+      draw_tess_llvm_dump_variant_key(&variant->key);
+   }
+
+   vec_ptr_type = LLVMPointerType(bld.vec_type, 0);
+
+   /* a vector of domain points at a time, the tessellator pads them */
+   lp_build_loop_begin(&lp_loop, gallivm, lp_build_const_int32(gallivm, 0));
+   {
+      struct lp_build_mask_context mask;
+      LLVMValueRef mask_val, io, u, v;
+
+      mask_val = tess_lane_mask(gallivm, &blduivec, lp_loop.counter,
+                                num_coords, NULL);
+      lp_build_mask_begin(&mask, gallivm, tes_type, mask_val);
+
+      u = LLVMBuildGEP(builder, u_ptr, &lp_loop.counter, 1, "");
+      u = LLVMBuildBitCast(builder, u, vec_ptr_type, "");
+      u = lp_build_pointer_get_unaligned(builder, u,
+                                         lp_build_const_int32(gallivm, 0), 4);
+      v = LLVMBuildGEP(builder, v_ptr, &lp_loop.counter, 1, "");
+      v = LLVMBuildBitCast(builder, v, vec_ptr_type, "");
+      v = lp_build_pointer_get_unaligned(builder, v,
+                                         lp_build_const_int32(gallivm, 0), 4);
+
+      system_values.tess_coord[0] = u;
+      system_values.tess_coord[1] = v;
+      if (tes->prim_mode == PIPE_PRIM_TRIANGLES)
+         system_values.tess_coord[2] =
+            lp_build_sub(&bld, lp_build_sub(&bld, bld.one, u), v);
+      else
+         system_values.tess_coord[2] = bld.zero;
+
+      lp_build_tgsi_soa(gallivm,
+                        tes->state.tokens,
+                        tes_type,
+                        &mask,
+                        consts_ptr,
+                        num_consts_ptr,
+                        &system_values,
+                        NULL,
+                        outputs,
+                        context_ptr,
+                        NULL,
+                        sampler,
+                        &tes->info,
+                        NULL,
+                        NULL,
+                        &tes_iface.base);
+
+      lp_build_mask_end(&mask);
+
+      io = LLVMBuildGEP(builder, io_ptr, &lp_loop.counter, 1, "");
+      convert_to_aos(gallivm, io, NULL, outputs, blduivec.zero,
+                     tes->info.num_outputs, tes_type, FALSE);
+   }
+   lp_build_loop_end_cond(&lp_loop, num_coords,
+                          lp_build_const_int32(gallivm, tes_type.length),
+                          LLVMIntUGE);
+
+   sampler->destroy(sampler);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, variant_func);
+}
+
+
+struct draw_tcs_llvm_variant *
+draw_tcs_llvm_create_variant(struct draw_llvm *llvm,
+                             const struct draw_tess_llvm_variant_key *key)
+{
+   struct draw_tcs_llvm_variant *variant;
+   struct llvm_tess_ctrl_shader *shader =
+      llvm_tess_ctrl_shader(llvm->draw->tcs.tess_ctrl_shader);
+   char module_name[64];
+
+   variant = MALLOC(sizeof *variant +
+                    shader->variant_key_size -
+                    sizeof variant->key);
+   if (!variant)
+      return NULL;
+
+   variant->llvm = llvm;
+   variant->shader = shader;
+
+   util_snprintf(module_name, sizeof(module_name), "draw_llvm_tcs_variant%u",
+                 variant->shader->variants_cached);
+
+   variant->gallivm = gallivm_create(module_name, llvm->context, NULL);
+
+   create_tess_jit_types(variant->gallivm, &variant->context_ptr_type);
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   draw_tcs_llvm_generate(llvm, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_func = (draw_tcs_jit_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   gallivm_free_ir(variant->gallivm);
+
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+   /*variant->no = */shader->variants_created++;
+
+   return variant;
+}
+
+
+void
+draw_tcs_llvm_destroy_variant(struct draw_tcs_llvm_variant *variant)
+{
+   struct draw_llvm *llvm = variant->llvm;
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      debug_printf("Deleting TCS variant: %u tcs variants,\t%u total variants\n",
+                    variant->shader->variants_cached, llvm->nr_tcs_variants);
+   }
+
+   gallivm_destroy(variant->gallivm);
+
+   remove_from_list(&variant->list_item_local);
+   variant->shader->variants_cached--;
+   remove_from_list(&variant->list_item_global);
+   llvm->nr_tcs_variants--;
+   FREE(variant);
+}
+
+
+struct draw_tes_llvm_variant *
+draw_tes_llvm_create_variant(struct draw_llvm *llvm,
+                             unsigned num_outputs,
+                             const struct draw_tess_llvm_variant_key *key)
+{
+   struct draw_tes_llvm_variant *variant;
+   struct llvm_tess_eval_shader *shader =
+      llvm_tess_eval_shader(llvm->draw->tes.tess_eval_shader);
+   LLVMTypeRef vertex_header;
+   char module_name[64];
+
+   variant = MALLOC(sizeof *variant +
+                    shader->variant_key_size -
+                    sizeof variant->key);
+   if (!variant)
+      return NULL;
+
+   variant->llvm = llvm;
+   variant->shader = shader;
+
+   util_snprintf(module_name, sizeof(module_name), "draw_llvm_tes_variant%u",
+                 variant->shader->variants_cached);
+
+   variant->gallivm = gallivm_create(module_name, llvm->context, NULL);
+
+   create_tess_jit_types(variant->gallivm, &variant->context_ptr_type);
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   vertex_header = create_jit_vertex_header(variant->gallivm, num_outputs);
+
+   variant->vertex_header_ptr_type = LLVMPointerType(vertex_header, 0);
+
+   draw_tes_llvm_generate(llvm, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_func = (draw_tes_jit_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   gallivm_free_ir(variant->gallivm);
+
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+   /*variant->no = */shader->variants_created++;
+
+   return variant;
+}
+
+
+void
+draw_tes_llvm_destroy_variant(struct draw_tes_llvm_variant *variant)
+{
+   struct draw_llvm *llvm = variant->llvm;
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      debug_printf("Deleting TES variant: %u tes variants,\t%u total variants\n",
+                    variant->shader->variants_cached, llvm->nr_tes_variants);
+   }
+
+   gallivm_destroy(variant->gallivm);
+
+   remove_from_list(&variant->list_item_local);
+   variant->shader->variants_cached--;
+   remove_from_list(&variant->list_item_global);
+   llvm->nr_tes_variants--;
+   FREE(variant);
+}
+
+
+static struct draw_tess_llvm_variant_key *
+draw_tess_llvm_make_variant_key(struct draw_llvm *llvm, char *store,
+                                enum pipe_shader_type shader_type,
+                                const struct tgsi_shader_info *info,
+                                unsigned num_outputs)
+{
+   unsigned i;
+   struct draw_tess_llvm_variant_key *key;
+   struct draw_sampler_static_state *draw_sampler;
+
+   key = (struct draw_tess_llvm_variant_key *)store;
+
+   memset(key, 0, offsetof(struct draw_tess_llvm_variant_key, samplers[0]));
+
+   key->num_outputs = num_outputs;
+
+   /* All variants of this shader will have the same value for
+    * nr_samplers.  Not yet trying to compact away holes in the
+    * sampler array.
+    */
+   key->nr_samplers = info->file_max[TGSI_FILE_SAMPLER] + 1;
+   if (info->file_max[TGSI_FILE_SAMPLER_VIEW] != -1) {
+      key->nr_sampler_views = info->file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+   }
+   else {
+      key->nr_sampler_views = key->nr_samplers;
+   }
+
+   draw_sampler = key->samplers;
+
+   memset(draw_sampler, 0, MAX2(key->nr_samplers, key->nr_sampler_views) * sizeof *draw_sampler);
+
+   for (i = 0 ; i < key->nr_samplers; i++) {
+      lp_sampler_static_sampler_state(&draw_sampler[i].sampler_state,
+                                      llvm->draw->samplers[shader_type][i]);
+   }
+   for (i = 0 ; i < key->nr_sampler_views; i++) {
+      lp_sampler_static_texture_state(&draw_sampler[i].texture_state,
+                                      llvm->draw->sampler_views[shader_type][i]);
+   }
+
+   return key;
+}
+
+
+struct draw_tess_llvm_variant_key *
+draw_tcs_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
+{
+   return draw_tess_llvm_make_variant_key(llvm, store,
+                                          PIPE_SHADER_TESS_CTRL,
+                                          &llvm->draw->tcs.tess_ctrl_shader->info,
+                                          0);
+}
+
+
+struct draw_tess_llvm_variant_key *
+draw_tes_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
+{
+   return draw_tess_llvm_make_variant_key(llvm, store,
+                                          PIPE_SHADER_TESS_EVAL,
+                                          &llvm->draw->tes.tess_eval_shader->info,
+                                          draw_total_tes_outputs(llvm->draw));
+}
+
+
+void
+draw_tess_llvm_dump_variant_key(struct draw_tess_llvm_variant_key *key)
+{
+   unsigned i;
+   struct draw_sampler_static_state *sampler = key->samplers;
+
+   for (i = 0 ; i < key->nr_sampler_views; i++) {
+      debug_printf("sampler[%i].src_format = %s\n", i,
+                   util_format_name(sampler[i].texture_state.format));
+   }
+}
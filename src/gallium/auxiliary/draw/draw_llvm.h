@@ -32,6 +32,7 @@
 
 #include "draw/draw_vs.h"
 #include "draw/draw_gs.h"
+#include "draw/draw_tess.h"
 
 #include "gallivm/lp_bld_sample.h"
 #include "gallivm/lp_bld_limits.h"
@@ -284,6 +285,38 @@ typedef int
                     int *prim_ids,
                     unsigned invocation_id);
 
+/**
+ * Tessellation control shader entry point, running all the invocations of
+ * one patch.
+ *
+ * input holds the vertex shader outputs of the patch, laid out per vertex
+ * as in the control shader's input register file. output receives the
+ * per-patch outputs followed by the per-vertex ones, in the layout of the
+ * output register file.
+ */
+typedef void
+(*draw_tcs_jit_func)(struct draw_jit_context *context,
+                     const float *input,
+                     float *output,
+                     unsigned prim_id,
+                     unsigned patch_vertices_in);
+
+/**
+ * Tessellation evaluation shader entry point, evaluating num_coords domain
+ * points of one patch. input is laid out like the control shader output.
+ */
+typedef void
+(*draw_tes_jit_func)(struct draw_jit_context *context,
+                     const float *input,
+                     struct vertex_header *io,
+                     const float *u,
+                     const float *v,
+                     unsigned num_coords,
+                     unsigned prim_id,
+                     unsigned patch_vertices_in,
+                     const float *outer,
+                     const float *inner);
+
 struct draw_llvm_variant_key
 {
    unsigned nr_vertex_elements:8;
@@ -296,7 +329,7 @@ struct draw_llvm_variant_key
    unsigned clip_halfz:1;
    unsigned bypass_viewport:1;
    unsigned need_edgeflags:1;
-   unsigned has_gs:1;
+   unsigned has_gs_or_tes:1;
    unsigned num_outputs:8;
    unsigned ucp_enable:PIPE_MAX_CLIP_PLANES;
    /* note padding here - must use memset */
@@ -320,6 +353,16 @@ struct draw_gs_llvm_variant_key
    struct draw_sampler_static_state samplers[1];
 };
 
+struct draw_tess_llvm_variant_key
+{
+   unsigned nr_samplers:8;
+   unsigned nr_sampler_views:8;
+   unsigned num_outputs:8;
+   /* note padding here - must use memset */
+
+   struct draw_sampler_static_state samplers[1];
+};
+
 #define DRAW_LLVM_MAX_VARIANT_KEY_SIZE \
    (sizeof(struct draw_llvm_variant_key) +	\
     PIPE_MAX_SHADER_SAMPLER_VIEWS * sizeof(struct draw_sampler_static_state) +	\
@@ -329,6 +372,10 @@ struct draw_gs_llvm_variant_key
    (sizeof(struct draw_gs_llvm_variant_key) +	\
     PIPE_MAX_SHADER_SAMPLER_VIEWS * sizeof(struct draw_sampler_static_state))
 
+#define DRAW_TESS_LLVM_MAX_VARIANT_KEY_SIZE \
+   (sizeof(struct draw_tess_llvm_variant_key) +	\
+    PIPE_MAX_SHADER_SAMPLER_VIEWS * sizeof(struct draw_sampler_static_state))
+
 
 static inline size_t
 draw_llvm_variant_key_size(unsigned nr_vertex_elements,
@@ -348,6 +395,14 @@ draw_gs_llvm_variant_key_size(unsigned nr_samplers)
 }
 
 
+static inline size_t
+draw_tess_llvm_variant_key_size(unsigned nr_samplers)
+{
+   return (sizeof(struct draw_tess_llvm_variant_key) +
+           (nr_samplers - 1) * sizeof(struct draw_sampler_static_state));
+}
+
+
 static inline struct draw_sampler_static_state *
 draw_llvm_variant_key_samplers(struct draw_llvm_variant_key *key)
 {
@@ -368,6 +423,18 @@ struct draw_gs_llvm_variant_list_item
    struct draw_gs_llvm_variant_list_item *next, *prev;
 };
 
+struct draw_tcs_llvm_variant_list_item
+{
+   struct draw_tcs_llvm_variant *base;
+   struct draw_tcs_llvm_variant_list_item *next, *prev;
+};
+
+struct draw_tes_llvm_variant_list_item
+{
+   struct draw_tes_llvm_variant *base;
+   struct draw_tes_llvm_variant_list_item *next, *prev;
+};
+
 
 struct draw_llvm_variant
 {
@@ -418,6 +485,48 @@ struct draw_gs_llvm_variant
    struct draw_gs_llvm_variant_key key;
 };
 
+struct draw_tcs_llvm_variant
+{
+   struct gallivm_state *gallivm;
+
+   /* LLVM JIT builder types */
+   LLVMTypeRef context_ptr_type;
+
+   LLVMValueRef function;
+   draw_tcs_jit_func jit_func;
+
+   struct llvm_tess_ctrl_shader *shader;
+
+   struct draw_llvm *llvm;
+   struct draw_tcs_llvm_variant_list_item list_item_global;
+   struct draw_tcs_llvm_variant_list_item list_item_local;
+
+   /* key is variable-sized, must be last */
+   struct draw_tess_llvm_variant_key key;
+};
+
+
+struct draw_tes_llvm_variant
+{
+   struct gallivm_state *gallivm;
+
+   /* LLVM JIT builder types */
+   LLVMTypeRef context_ptr_type;
+   LLVMTypeRef vertex_header_ptr_type;
+
+   LLVMValueRef function;
+   draw_tes_jit_func jit_func;
+
+   struct llvm_tess_eval_shader *shader;
+
+   struct draw_llvm *llvm;
+   struct draw_tes_llvm_variant_list_item list_item_global;
+   struct draw_tes_llvm_variant_list_item list_item_local;
+
+   /* key is variable-sized, must be last */
+   struct draw_tess_llvm_variant_key key;
+};
+
 struct llvm_vertex_shader {
    struct draw_vertex_shader base;
 
@@ -436,6 +545,24 @@ struct llvm_geometry_shader {
    unsigned variants_cached;
 };
 
+struct llvm_tess_ctrl_shader {
+   struct draw_tess_ctrl_shader base;
+
+   unsigned variant_key_size;
+   struct draw_tcs_llvm_variant_list_item variants;
+   unsigned variants_created;
+   unsigned variants_cached;
+};
+
+struct llvm_tess_eval_shader {
+   struct draw_tess_eval_shader base;
+
+   unsigned variant_key_size;
+   struct draw_tes_llvm_variant_list_item variants;
+   unsigned variants_created;
+   unsigned variants_cached;
+};
+
 
 struct draw_llvm {
    struct draw_context *draw;
@@ -445,12 +572,20 @@ struct draw_llvm {
 
    struct draw_jit_context jit_context;
    struct draw_gs_jit_context gs_jit_context;
+   struct draw_jit_context tcs_jit_context;
+   struct draw_jit_context tes_jit_context;
 
    struct draw_llvm_variant_list_item vs_variants_list;
    int nr_variants;
 
    struct draw_gs_llvm_variant_list_item gs_variants_list;
    int nr_gs_variants;
+
+   struct draw_tcs_llvm_variant_list_item tcs_variants_list;
+   int nr_tcs_variants;
+
+   struct draw_tes_llvm_variant_list_item tes_variants_list;
+   int nr_tes_variants;
 };
 
 
@@ -466,6 +601,18 @@ llvm_geometry_shader(struct draw_geometry_shader *gs)
    return (struct llvm_geometry_shader *)gs;
 }
 
+static inline struct llvm_tess_ctrl_shader *
+llvm_tess_ctrl_shader(struct draw_tess_ctrl_shader *tcs)
+{
+   return (struct llvm_tess_ctrl_shader *)tcs;
+}
+
+static inline struct llvm_tess_eval_shader *
+llvm_tess_eval_shader(struct draw_tess_eval_shader *tes)
+{
+   return (struct llvm_tess_eval_shader *)tes;
+}
+
 
 
 
@@ -504,6 +651,32 @@ draw_gs_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
 void
 draw_gs_llvm_dump_variant_key(struct draw_gs_llvm_variant_key *key);
 
+
+struct draw_tcs_llvm_variant *
+draw_tcs_llvm_create_variant(struct draw_llvm *llvm,
+                             const struct draw_tess_llvm_variant_key *key);
+
+void
+draw_tcs_llvm_destroy_variant(struct draw_tcs_llvm_variant *variant);
+
+struct draw_tess_llvm_variant_key *
+draw_tcs_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
+
+
+struct draw_tes_llvm_variant *
+draw_tes_llvm_create_variant(struct draw_llvm *llvm,
+                             unsigned num_vertex_header_attribs,
+                             const struct draw_tess_llvm_variant_key *key);
+
+void
+draw_tes_llvm_destroy_variant(struct draw_tes_llvm_variant *variant);
+
+struct draw_tess_llvm_variant_key *
+draw_tes_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
+
+void
+draw_tess_llvm_dump_variant_key(struct draw_tess_llvm_variant_key *key);
+
 struct lp_build_sampler_soa *
 draw_llvm_sampler_soa_create(const struct draw_sampler_static_state *static_state);
 
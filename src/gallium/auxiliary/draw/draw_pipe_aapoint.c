@@ -360,8 +360,14 @@ generate_aapoint_fs(struct aapoint_stage *aapoint)
    const struct pipe_shader_state *orig_fs = &aapoint->fs->state;
    struct pipe_shader_state aapoint_fs;
    struct aa_transform_context transform;
-   const uint newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
    struct pipe_context *pipe = aapoint->stage.draw->pipe;
+   uint newLen;
+
+   /* only TGSI shaders can be transformed */
+   if (!orig_fs->tokens)
+      return FALSE;
+
+   newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
 
    aapoint_fs = *orig_fs; /* copy to init */
    aapoint_fs.tokens = tgsi_alloc_tokens(newLen);
@@ -558,7 +564,11 @@ aapoint_first_point(struct draw_stage *stage, struct prim_header *header)
    /*
     * Bind (generate) our fragprog.
     */
-   bind_aapoint_fragment_shader(aapoint);
+   if (!bind_aapoint_fragment_shader(aapoint)) {
+      stage->point = draw_pipe_passthrough_point;
+      stage->point(stage, header);
+      return;
+   }
 
    draw_aapoint_prepare_outputs(draw, draw->pipeline.aapoint);
 
@@ -710,7 +720,8 @@ aapoint_create_fs_state(struct pipe_context *pipe,
    if (!aafs)
       return NULL;
 
-   aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
+   if (fs->type == PIPE_SHADER_IR_TGSI)
+      aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
 
    /* pass-through */
    aafs->driver_fs = aapoint->driver_create_fs_state(pipe, fs);
@@ -132,6 +132,10 @@ generate_pstip_fs(struct pstip_stage *pstip)
    wincoord_file = screen->get_param(screen, PIPE_CAP_TGSI_FS_POSITION_IS_SYSVAL) ?
                    TGSI_FILE_SYSTEM_VALUE : TGSI_FILE_INPUT;
 
+   /* only TGSI shaders can be transformed */
+   if (!orig_fs->tokens)
+      return FALSE;
+
    pstip_fs = *orig_fs; /* copy to init */
    pstip_fs.tokens = util_pstipple_create_fragment_shader(orig_fs->tokens,
                                                           &pstip->fs->sampler_unit,
@@ -334,7 +338,8 @@ pstip_create_fs_state(struct pipe_context *pipe,
    struct pstip_fragment_shader *pstipfs = CALLOC_STRUCT(pstip_fragment_shader);
 
    if (pstipfs) {
-      pstipfs->state.tokens = tgsi_dup_tokens(fs->tokens);
+      if (fs->type == PIPE_SHADER_IR_TGSI)
+         pstipfs->state.tokens = tgsi_dup_tokens(fs->tokens);
 
       /* pass-through */
       pstipfs->driver_fs = pstip->driver_create_fs_state(pstip->pipe, fs);
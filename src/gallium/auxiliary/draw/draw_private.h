@@ -61,6 +61,8 @@ struct gallivm_state;
 
 struct pipe_context;
 struct draw_vertex_shader;
+struct draw_tess_ctrl_shader;
+struct draw_tess_eval_shader;
 struct draw_context;
 struct draw_stage;
 struct vbuf_render;
@@ -71,6 +73,7 @@ struct tgsi_buffer;
 struct draw_pt_front_end;
 struct draw_assembler;
 struct draw_llvm;
+struct util_queue;
 
 
 /**
@@ -205,6 +208,10 @@ struct draw_context
          unsigned vs_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
          const void *gs_constants[PIPE_MAX_CONSTANT_BUFFERS];
          unsigned gs_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
+         const void *tcs_constants[PIPE_MAX_CONSTANT_BUFFERS];
+         unsigned tcs_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
+         const void *tes_constants[PIPE_MAX_CONSTANT_BUFFERS];
+         unsigned tes_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
          
          /* pointer to planes */
          float (*planes)[DRAW_TOTAL_CLIP_PLANES][4]; 
@@ -212,6 +219,13 @@ struct draw_context
 
       boolean test_fse;         /* enable FSE even though its not correct (eg for softpipe) */
       boolean no_fse;           /* disable FSE even when it is correct */
+
+      /** worker threads the llvm middle end may shade on, owned by the
+       * driver and possibly shared with other contexts, or NULL */
+      struct util_queue *vs_queue;
+
+      /** vertices per patch of the current PIPE_PRIM_PATCHES draw */
+      unsigned vertices_per_patch;
    } pt;
 
    struct {
@@ -296,6 +310,22 @@ struct draw_context
 
    } gs;
 
+   /** Tessellation control shader state */
+   struct {
+      struct draw_tess_ctrl_shader *tess_ctrl_shader;
+   } tcs;
+
+   /** Tessellation evaluation shader state */
+   struct {
+      struct draw_tess_eval_shader *tess_eval_shader;
+      uint num_tes_outputs;  /**< convenience, from tess_eval_shader */
+      uint position_output;
+   } tes;
+
+   /** Tessellation levels used when there's no control shader */
+   float default_outer_tess_level[4];
+   float default_inner_tess_level[2];
+
    /** Fragment shader state */
    struct {
       struct draw_fragment_shader *fragment_shader;
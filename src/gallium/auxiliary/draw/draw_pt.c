@@ -32,6 +32,7 @@
 
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
+#include "draw/draw_tess.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
 #include "draw/draw_vbuf.h"
@@ -66,15 +67,17 @@ draw_pt_arrays(struct draw_context *draw,
     */
    {
       unsigned first, incr;
-      draw_pt_split_prim(prim, &first, &incr);
+      draw_pt_split_prim(prim, draw->pt.vertices_per_patch, &first, &incr);
       count = draw_pt_trim_count(count, first, incr);
       if (count < first)
          return TRUE;
    }
 
    if (!draw->force_passthrough) {
-      unsigned gs_out_prim = (draw->gs.geometry_shader ? 
+      unsigned gs_out_prim = (draw->gs.geometry_shader ?
                               draw->gs.geometry_shader->output_primitive :
+                              draw->tes.tess_eval_shader ?
+                              draw->tes.tess_eval_shader->output_primitive :
                               prim);
 
       if (!draw->render) {
@@ -148,6 +151,9 @@ draw_pt_arrays(struct draw_context *draw,
 
    frontend->run( frontend, start, count );
 
+   if (middle->sync)
+      middle->sync(middle);
+
    return TRUE;
 }
 
@@ -482,6 +488,7 @@ draw_vbo(struct draw_context *draw,
    draw->pt.user.min_index = info->min_index;
    draw->pt.user.max_index = info->max_index;
    draw->pt.user.eltSize = info->index_size ? draw->pt.user.eltSizeIB : 0;
+   draw->pt.vertices_per_patch = info->vertices_per_patch;
 
    if (0)
       debug_printf("draw_vbo(mode=%u start=%u count=%u):\n",
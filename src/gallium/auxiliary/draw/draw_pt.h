@@ -126,6 +126,12 @@ struct draw_pt_middle_end {
 
    void (*finish)( struct draw_pt_middle_end * );
    void (*destroy)( struct draw_pt_middle_end * );
+
+   /* Optional.  Wait for and emit any work still queued from the run
+    * calls above.  Called at the end of each draw, before the vertex
+    * and index buffers the draw referenced may go away.
+    */
+   void (*sync)( struct draw_pt_middle_end * );
 };
 
 
@@ -245,7 +251,8 @@ void draw_pt_post_vs_destroy( struct pt_post_vs *pvs );
 /*******************************************************************************
  * Utils: 
  */
-void draw_pt_split_prim(unsigned prim, unsigned *first, unsigned *incr);
+void draw_pt_split_prim(unsigned prim, unsigned vertices_per_patch,
+                        unsigned *first, unsigned *incr);
 unsigned draw_pt_trim_count(unsigned count, unsigned first, unsigned incr);
 
 
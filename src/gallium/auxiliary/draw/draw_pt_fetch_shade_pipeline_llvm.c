@@ -28,8 +28,10 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
+#include "draw/draw_tess.h"
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vertex.h"
 #include "draw/draw_pt.h"
@@ -40,6 +42,47 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+/**
+ * Max number of vertex shading jobs in flight, and the segment size below
+ * which we don't bother handing work to the queue when it is idle.
+ */
+#define LLVM_VS_MAX_JOBS 16
+#define LLVM_VS_MIN_JOB_VERTICES 64
+
+struct llvm_middle_end;
+
+/**
+ * One segment (as handed to us by vsplit) whose vertices are being shaded
+ * on a worker thread.  Everything the shader reads which vsplit or the
+ * state tracker may change before the job runs is copied in here; the
+ * stages after the vertex shader always run on the draw thread, in
+ * submission order.
+ */
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   struct util_queue_fence fence;
+
+   struct draw_llvm_variant *variant;
+   unsigned start_or_maxelt;
+   unsigned vid_base;
+   unsigned instance_id;
+   unsigned start_instance;
+   unsigned opt;
+
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+   unsigned primitive_length;
+
+   unsigned *fetch_elts;
+   unsigned fetch_elts_size;
+   ushort *draw_elts;
+   unsigned draw_elts_size;
+
+   struct draw_vertex_info vert_info;
+   boolean clipped;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -57,6 +100,13 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Driver's queue the jobs currently go to, see draw_set_vs_queue(). */
+   struct util_queue *queue;
+   struct llvm_vs_job jobs[LLVM_VS_MAX_JOBS];
+   unsigned num_jobs;      /**< ring size actually used */
+   unsigned job_head;      /**< oldest job still pending */
+   unsigned jobs_pending;
 };
 
 
@@ -138,6 +188,142 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
    gs->current_variant = variant;
 }
 
+static void
+llvm_middle_end_prepare_tcs(struct llvm_middle_end *fpme)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_llvm *llvm = fpme->llvm;
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_llvm_variant_key *key;
+   struct draw_tcs_llvm_variant *variant = NULL;
+   struct draw_tcs_llvm_variant_list_item *li;
+   struct llvm_tess_ctrl_shader *shader = llvm_tess_ctrl_shader(tcs);
+   char store[DRAW_TESS_LLVM_MAX_VARIANT_KEY_SIZE];
+   unsigned i;
+
+   key = draw_tcs_llvm_make_variant_key(llvm, store);
+
+   /* Search shader's list of variants for the key */
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
+         variant = li->base;
+         break;
+      }
+      li = next_elem(li);
+   }
+
+   if (variant) {
+      /* found the variant, move to head of global list (for LRU) */
+      move_to_head(&llvm->tcs_variants_list, &variant->list_item_global);
+   }
+   else {
+      /* Need to create new variant */
+
+      /* First check if we've created too many variants.  If so, free
+       * 3.125% of the LRU to avoid using too much memory.
+       */
+      if (llvm->nr_tcs_variants >= DRAW_MAX_SHADER_VARIANTS) {
+         if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+            debug_printf("Evicting TCS: %u tcs variants,\t%u total variants\n",
+                      shader->variants_cached, llvm->nr_tcs_variants);
+         }
+
+         for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 32; i++) {
+            struct draw_tcs_llvm_variant_list_item *item;
+            if (is_empty_list(&llvm->tcs_variants_list)) {
+               break;
+            }
+            item = last_elem(&llvm->tcs_variants_list);
+            assert(item);
+            assert(item->base);
+            draw_tcs_llvm_destroy_variant(item->base);
+         }
+      }
+
+      variant = draw_tcs_llvm_create_variant(llvm, key);
+
+      if (variant) {
+         insert_at_head(&shader->variants, &variant->list_item_local);
+         insert_at_head(&llvm->tcs_variants_list,
+                        &variant->list_item_global);
+         llvm->nr_tcs_variants++;
+         shader->variants_cached++;
+      }
+   }
+
+   tcs->current_variant = variant;
+}
+
+static void
+llvm_middle_end_prepare_tes(struct llvm_middle_end *fpme)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_llvm *llvm = fpme->llvm;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
+   struct draw_tess_llvm_variant_key *key;
+   struct draw_tes_llvm_variant *variant = NULL;
+   struct draw_tes_llvm_variant_list_item *li;
+   struct llvm_tess_eval_shader *shader = llvm_tess_eval_shader(tes);
+   char store[DRAW_TESS_LLVM_MAX_VARIANT_KEY_SIZE];
+   unsigned i;
+
+   key = draw_tes_llvm_make_variant_key(llvm, store);
+
+   /* Search shader's list of variants for the key */
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
+         variant = li->base;
+         break;
+      }
+      li = next_elem(li);
+   }
+
+   if (variant) {
+      /* found the variant, move to head of global list (for LRU) */
+      move_to_head(&llvm->tes_variants_list, &variant->list_item_global);
+   }
+   else {
+      /* Need to create new variant */
+
+      /* First check if we've created too many variants.  If so, free
+       * 3.125% of the LRU to avoid using too much memory.
+       */
+      if (llvm->nr_tes_variants >= DRAW_MAX_SHADER_VARIANTS) {
+         if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+            debug_printf("Evicting TES: %u tes variants,\t%u total variants\n",
+                      shader->variants_cached, llvm->nr_tes_variants);
+         }
+
+         for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 32; i++) {
+            struct draw_tes_llvm_variant_list_item *item;
+            if (is_empty_list(&llvm->tes_variants_list)) {
+               break;
+            }
+            item = last_elem(&llvm->tes_variants_list);
+            assert(item);
+            assert(item->base);
+            draw_tes_llvm_destroy_variant(item->base);
+         }
+      }
+
+      /* the vertex layout has to match what draw_tess_run() allocates */
+      variant = draw_tes_llvm_create_variant(llvm, draw_total_tes_outputs(draw),
+                                             key);
+
+      if (variant) {
+         insert_at_head(&shader->variants, &variant->list_item_local);
+         insert_at_head(&llvm->tes_variants_list,
+                        &variant->list_item_global);
+         llvm->nr_tes_variants++;
+         shader->variants_cached++;
+      }
+   }
+
+   tes->current_variant = variant;
+}
+
 /**
  * Prepare/validate middle part of the vertex pipeline.
  * NOTE: if you change this function, also look at the non-LLVM
@@ -154,7 +340,10 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
    struct draw_llvm *llvm = fpme->llvm;
    struct draw_vertex_shader *vs = draw->vs.vertex_shader;
    struct draw_geometry_shader *gs = draw->gs.geometry_shader;
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
    const unsigned out_prim = gs ? gs->output_primitive :
+      tes ? tes->output_primitive :
       u_assembled_prim(in_prim);
    unsigned point_clip = draw->rasterizer->fill_front == PIPE_POLYGON_MODE_POINT ||
                          out_prim == PIPE_PRIM_POINTS;
@@ -173,7 +362,7 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
                             draw->rasterizer->clip_halfz,
                             (draw->vs.edgeflag_output ? TRUE : FALSE) );
 
-   draw_pt_so_emit_prepare( fpme->so_emit, gs == NULL );
+   draw_pt_so_emit_prepare( fpme->so_emit, gs == NULL && tes == NULL );
 
    if (!(opt & PT_PIPELINE)) {
       draw_pt_emit_prepare( fpme->emit, out_prim,
@@ -267,6 +456,12 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
       fpme->current_variant = variant;
    }
 
+   if (tcs) {
+      llvm_middle_end_prepare_tcs(fpme);
+   }
+   if (tes) {
+      llvm_middle_end_prepare_tes(fpme);
+   }
    if (gs) {
       llvm_middle_end_prepare_gs(fpme);
    }
@@ -307,13 +502,38 @@ llvm_middle_end_bind_parameters(struct draw_pt_middle_end *middle)
       }
    }
 
+   for (i = 0; i < ARRAY_SIZE(llvm->tcs_jit_context.vs_constants); ++i) {
+      int num_consts =
+         draw->pt.user.tcs_constants_size[i] / (sizeof(float) * 4);
+      llvm->tcs_jit_context.vs_constants[i] = draw->pt.user.tcs_constants[i];
+      llvm->tcs_jit_context.num_vs_constants[i] = num_consts;
+      if (num_consts == 0) {
+         llvm->tcs_jit_context.vs_constants[i] = fake_const_buf;
+      }
+   }
+   for (i = 0; i < ARRAY_SIZE(llvm->tes_jit_context.vs_constants); ++i) {
+      int num_consts =
+         draw->pt.user.tes_constants_size[i] / (sizeof(float) * 4);
+      llvm->tes_jit_context.vs_constants[i] = draw->pt.user.tes_constants[i];
+      llvm->tes_jit_context.num_vs_constants[i] = num_consts;
+      if (num_consts == 0) {
+         llvm->tes_jit_context.vs_constants[i] = fake_const_buf;
+      }
+   }
+
    llvm->jit_context.planes =
       (float (*)[DRAW_TOTAL_CLIP_PLANES][4]) draw->pt.user.planes[0];
    llvm->gs_jit_context.planes =
       (float (*)[DRAW_TOTAL_CLIP_PLANES][4]) draw->pt.user.planes[0];
+   llvm->tcs_jit_context.planes =
+      (float (*)[DRAW_TOTAL_CLIP_PLANES][4]) draw->pt.user.planes[0];
+   llvm->tes_jit_context.planes =
+      (float (*)[DRAW_TOTAL_CLIP_PLANES][4]) draw->pt.user.planes[0];
 
    llvm->jit_context.viewports = draw->viewports;
    llvm->gs_jit_context.viewports = draw->viewports;
+   llvm->tcs_jit_context.viewports = draw->viewports;
+   llvm->tes_jit_context.viewports = draw->viewports;
 }
 
 
@@ -347,81 +567,106 @@ emit(struct pt_emit *emit,
 }
 
 
-static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+/**
+ * Run fetch + vertex shader for a segment.  Returns the clipped flag from
+ * the generated code and fills in vert_info.  May be called from a worker
+ * thread, so must only touch what's passed in and the (read-only while
+ * drawing) jit context.
+ */
+static boolean
+llvm_shade(struct llvm_middle_end *fpme,
+           struct draw_llvm_variant *variant,
+           const struct draw_fetch_info *fetch_info,
+           unsigned start_or_maxelt,
+           unsigned vid_base,
+           unsigned instance_id,
+           unsigned start_instance,
+           struct draw_vertex_info *vert_info)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
-   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
-   struct draw_prim_info gs_prim_info;
-   struct draw_vertex_info llvm_vert_info;
-   struct draw_vertex_info gs_vert_info;
-   struct draw_vertex_info *vert_info;
-   struct draw_prim_info ia_prim_info;
-   struct draw_vertex_info ia_vert_info;
-   const struct draw_prim_info *prim_info = in_prim_info;
-   boolean free_prim_info = FALSE;
-   unsigned opt = fpme->opt;
-   boolean clipped = 0;
-   unsigned start_or_maxelt, vid_base;
-   const unsigned *elts;
+   const unsigned *elts = fetch_info->linear ? NULL : fetch_info->elts;
 
    assert(fetch_info->count > 0);
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
+   vert_info->count = fetch_info->count;
+   vert_info->vertex_size = fpme->vertex_size;
+   vert_info->stride = fpme->vertex_size;
+   vert_info->verts = (struct vertex_header *)
       MALLOC(fpme->vertex_size *
              align(fetch_info->count, lp_native_vector_width / 32));
-   if (!llvm_vert_info.verts) {
+   if (!vert_info->verts) {
       assert(0);
-      return;
+      return FALSE;
    }
 
+   return variant->jit_func(&fpme->llvm->jit_context,
+                            vert_info->verts,
+                            draw->pt.user.vbuffer,
+                            fetch_info->count,
+                            start_or_maxelt,
+                            fpme->vertex_size,
+                            draw->pt.vertex_buffer,
+                            instance_id,
+                            vid_base,
+                            start_instance,
+                            elts);
+}
+
+
+static void
+llvm_pipeline_stats(struct llvm_middle_end *fpme,
+                    const struct draw_fetch_info *fetch_info,
+                    const struct draw_prim_info *prim_info)
+{
+   struct draw_context *draw = fpme->draw;
+
    if (draw->collect_statistics) {
       draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+      if (prim_info->prim == PIPE_PRIM_PATCHES)
+         draw->statistics.ia_primitives +=
+            prim_info->count / draw->pt.vertices_per_patch;
+      else
+         draw->statistics.ia_primitives +=
+            u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
       draw->statistics.vs_invocations += fetch_info->count;
    }
+}
 
-   if (fetch_info->linear) {
-      start_or_maxelt = fetch_info->start;
-      vid_base = draw->start_index;
-      elts = NULL;
-   }
-   else {
-      start_or_maxelt = draw->pt.user.eltMax;
-      vid_base = draw->pt.user.eltBias;
-      elts = fetch_info->elts;
-   }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts);
-
-   /* Finished with fetch and vs:
-    */
-   fetch_info = NULL;
-   vert_info = &llvm_vert_info;
+
+/**
+ * Everything after the vertex shader: GS or prim assembly, stream output,
+ * clipping and finally the pipeline or emit.  Always runs on the draw
+ * thread.  Takes ownership of vert_info->verts.
+ */
+static void
+llvm_pipeline_post(struct llvm_middle_end *fpme,
+                   struct draw_vertex_info *llvm_vert_info,
+                   const struct draw_prim_info *in_prim_info,
+                   boolean clipped,
+                   unsigned opt)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
+   struct draw_prim_info gs_prim_info;
+   struct draw_vertex_info gs_vert_info;
+   struct draw_vertex_info *vert_info = llvm_vert_info;
+   struct draw_prim_info ia_prim_info;
+   struct draw_vertex_info ia_vert_info;
+   const struct draw_prim_info *prim_info = in_prim_info;
+   boolean free_prim_info = FALSE;
+
+   if (!vert_info->verts)
+      return;
 
    if ((opt & PT_SHADE) && gshader) {
-      struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
+      const struct tgsi_shader_info *input_info =
+         tes ? &tes->info : &draw->vs.vertex_shader->info;
       draw_geometry_shader_run(gshader,
                                draw->pt.user.gs_constants,
                                draw->pt.user.gs_constants_size,
                                vert_info,
                                prim_info,
-                               &vshader->info,
+                               input_info,
                                &gs_vert_info,
                                &gs_prim_info);
 
@@ -470,7 +715,7 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
     * will try to access non-existent position output.
     */
    if (draw_current_shader_position_output(draw) != -1) {
-      if ((opt & PT_SHADE) && (gshader ||
+      if ((opt & PT_SHADE) && (gshader || tes ||
                                draw->vs.vertex_shader->info.writes_viewport_index)) {
          clipped = draw_pt_post_vs_run( fpme->post_vs, vert_info, prim_info );
       }
@@ -495,6 +740,225 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+/**
+ * Hand the vertex shader output of a segment on to the rest of the
+ * pipeline, through the tessellation stages if there are any.  Patches
+ * can expand into more vertices than the back ends take at once, so
+ * draw_tess_run() may split them into several batches.
+ */
+static void
+llvm_pipeline_post_vs(struct llvm_middle_end *fpme,
+                      struct draw_vertex_info *vert_info,
+                      const struct draw_prim_info *prim_info,
+                      boolean clipped,
+                      unsigned opt)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
+   const unsigned vertices_per_patch = draw->pt.vertices_per_patch;
+   struct draw_vertex_info tes_vert_info;
+   struct draw_prim_info tes_prim_info;
+   unsigned num_patches, next_patch = 0;
+
+   if (!tes || !(opt & PT_SHADE) || !tes->current_variant ||
+       (draw->tcs.tess_ctrl_shader &&
+        !draw->tcs.tess_ctrl_shader->current_variant)) {
+      llvm_pipeline_post(fpme, vert_info, prim_info, clipped, opt);
+      return;
+   }
+
+   if (!vert_info->verts)
+      return;
+
+   num_patches = vertices_per_patch ? prim_info->count / vertices_per_patch : 0;
+   while (next_patch < num_patches) {
+      draw_tess_run(draw, vert_info, prim_info, &draw->vs.vertex_shader->info,
+                    &next_patch, &tes_vert_info, &tes_prim_info);
+      if (tes_vert_info.verts && tes_prim_info.count)
+         llvm_pipeline_post(fpme, &tes_vert_info, &tes_prim_info, FALSE, opt);
+      else
+         FREE(tes_vert_info.verts);
+   }
+
+   FREE(vert_info->verts);
+}
+
+
+static void
+llvm_vs_job_execute(void *data, int thread_index)
+{
+   struct llvm_vs_job *job = (struct llvm_vs_job *) data;
+
+   job->clipped = llvm_shade(job->fpme, job->variant, &job->fetch_info,
+                             job->start_or_maxelt, job->vid_base,
+                             job->instance_id, job->start_instance,
+                             &job->vert_info);
+}
+
+
+/**
+ * Wait for the oldest pending job and run the rest of the pipeline on it.
+ */
+static void
+llvm_vs_job_complete(struct llvm_middle_end *fpme)
+{
+   struct llvm_vs_job *job = &fpme->jobs[fpme->job_head];
+
+   assert(fpme->jobs_pending);
+
+   util_queue_fence_wait(&job->fence);
+   llvm_pipeline_post_vs(fpme, &job->vert_info, &job->prim_info,
+                         job->clipped, job->opt);
+
+   fpme->job_head = (fpme->job_head + 1) % fpme->num_jobs;
+   fpme->jobs_pending--;
+}
+
+
+static void
+llvm_vs_jobs_drain(struct llvm_middle_end *fpme)
+{
+   while (fpme->jobs_pending)
+      llvm_vs_job_complete(fpme);
+}
+
+
+/**
+ * Pick up the queue the driver gave us, waiting for the jobs on the
+ * previous one if it changed.  Returns FALSE if shading should stay on
+ * the draw thread.
+ */
+static boolean
+llvm_vs_queue_validate(struct llvm_middle_end *fpme)
+{
+   struct util_queue *queue = fpme->draw->pt.vs_queue;
+
+   if (queue == fpme->queue)
+      return queue != NULL;
+
+   llvm_vs_jobs_drain(fpme);
+   fpme->queue = queue;
+   if (!queue)
+      return FALSE;
+
+   /* Twice as many slots as threads so there is always a segment ready
+    * for a worker while the draw thread is busy with the back end.  The
+    * queue may be shared, so this is what one draw context can have in
+    * flight rather than what the queue holds.
+    */
+   fpme->num_jobs = CLAMP(queue->max_threads * 2, 1, LLVM_VS_MAX_JOBS);
+   fpme->job_head = 0;
+   fpme->jobs_pending = 0;
+   return TRUE;
+}
+
+
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_context *draw = fpme->draw;
+   struct llvm_vs_job *job;
+   unsigned start_or_maxelt, vid_base;
+
+   llvm_pipeline_stats(fpme, fetch_info, prim_info);
+
+   if (fetch_info->linear) {
+      start_or_maxelt = fetch_info->start;
+      vid_base = draw->start_index;
+   }
+   else {
+      start_or_maxelt = draw->pt.user.eltMax;
+      vid_base = draw->pt.user.eltBias;
+   }
+
+   /* Small segments are not worth a round trip through the queue, but
+    * once anything is queued every segment has to follow it to keep the
+    * primitives in order.
+    */
+   if (!llvm_vs_queue_validate(fpme) ||
+       (!fpme->jobs_pending &&
+        fetch_info->count < LLVM_VS_MIN_JOB_VERTICES)) {
+      struct draw_vertex_info vert_info;
+      boolean clipped;
+
+      clipped = llvm_shade(fpme, fpme->current_variant, fetch_info,
+                           start_or_maxelt, vid_base,
+                           draw->instance_id, draw->start_instance,
+                           &vert_info);
+      llvm_pipeline_post_vs(fpme, &vert_info, prim_info, clipped, fpme->opt);
+      return;
+   }
+
+   if (fpme->jobs_pending == fpme->num_jobs)
+      llvm_vs_job_complete(fpme);
+
+   job = &fpme->jobs[(fpme->job_head + fpme->jobs_pending) % fpme->num_jobs];
+
+   job->fpme = fpme;
+   job->variant = fpme->current_variant;
+   job->start_or_maxelt = start_or_maxelt;
+   job->vid_base = vid_base;
+   job->instance_id = draw->instance_id;
+   job->start_instance = draw->start_instance;
+   job->opt = fpme->opt;
+
+   /* vsplit reuses its element buffers for the next segment */
+   job->fetch_info = *fetch_info;
+   if (!fetch_info->linear) {
+      if (job->fetch_elts_size < fetch_info->count) {
+         FREE(job->fetch_elts);
+         job->fetch_elts = MALLOC(fetch_info->count * sizeof(unsigned));
+         job->fetch_elts_size = job->fetch_elts ? fetch_info->count : 0;
+      }
+      if (!job->fetch_elts)
+         goto fallback;
+      memcpy(job->fetch_elts, fetch_info->elts,
+             fetch_info->count * sizeof(unsigned));
+      job->fetch_info.elts = job->fetch_elts;
+   }
+
+   assert(prim_info->primitive_count == 1);
+   job->prim_info = *prim_info;
+   job->primitive_length = prim_info->primitive_lengths[0];
+   job->prim_info.primitive_lengths = &job->primitive_length;
+   if (!prim_info->linear) {
+      if (job->draw_elts_size < prim_info->count) {
+         FREE(job->draw_elts);
+         job->draw_elts = MALLOC(prim_info->count * sizeof(ushort));
+         job->draw_elts_size = job->draw_elts ? prim_info->count : 0;
+      }
+      if (!job->draw_elts)
+         goto fallback;
+      memcpy(job->draw_elts, prim_info->elts,
+             prim_info->count * sizeof(ushort));
+      job->prim_info.elts = job->draw_elts;
+   }
+
+   job->vert_info.verts = NULL;
+   job->clipped = FALSE;
+   fpme->jobs_pending++;
+   util_queue_add_job(fpme->queue, job, &job->fence,
+                      llvm_vs_job_execute, NULL);
+   return;
+
+fallback:
+   {
+      struct draw_vertex_info vert_info;
+      boolean clipped;
+
+      llvm_vs_jobs_drain(fpme);
+      clipped = llvm_shade(fpme, fpme->current_variant, fetch_info,
+                           start_or_maxelt, vid_base,
+                           draw->instance_id, draw->start_instance,
+                           &vert_info);
+      llvm_pipeline_post_vs(fpme, &vert_info, prim_info, clipped, fpme->opt);
+   }
+}
+
+
 static inline unsigned
 prim_type(unsigned prim, unsigned flags)
 {
@@ -595,10 +1059,17 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
 }
 
 
+static void
+llvm_middle_end_sync(struct draw_pt_middle_end *middle)
+{
+   llvm_vs_jobs_drain(llvm_middle_end(middle));
+}
+
+
 static void
 llvm_middle_end_finish(struct draw_pt_middle_end *middle)
 {
-   /* nothing to do */
+   llvm_vs_jobs_drain(llvm_middle_end(middle));
 }
 
 
@@ -606,6 +1077,15 @@ static void
 llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   unsigned i;
+
+   llvm_vs_jobs_drain(fpme);
+
+   for (i = 0; i < LLVM_VS_MAX_JOBS; i++) {
+      util_queue_fence_destroy(&fpme->jobs[i].fence);
+      FREE(fpme->jobs[i].fetch_elts);
+      FREE(fpme->jobs[i].draw_elts);
+   }
 
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
@@ -627,6 +1107,7 @@ struct draw_pt_middle_end *
 draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 {
    struct llvm_middle_end *fpme = 0;
+   unsigned i;
 
    if (!draw->llvm)
       return NULL;
@@ -642,9 +1123,13 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    fpme->base.run_linear_elts = llvm_middle_end_linear_run_elts;
    fpme->base.finish          = llvm_middle_end_finish;
    fpme->base.destroy         = llvm_middle_end_destroy;
+   fpme->base.sync            = llvm_middle_end_sync;
 
    fpme->draw = draw;
 
+   for (i = 0; i < LLVM_VS_MAX_JOBS; i++)
+      util_queue_fence_init(&fpme->jobs[i].fence);
+
    fpme->fetch = draw_pt_fetch_create( draw );
    if (!fpme->fetch)
       goto fail;
@@ -35,7 +35,8 @@
 #include "draw/draw_pt.h"
 #include "util/u_debug.h"
 
-void draw_pt_split_prim(unsigned prim, unsigned *first, unsigned *incr)
+void draw_pt_split_prim(unsigned prim, unsigned vertices_per_patch,
+                        unsigned *first, unsigned *incr)
 {
    switch (prim) {
    case PIPE_PRIM_POINTS:
@@ -85,6 +86,10 @@ void draw_pt_split_prim(unsigned prim, unsigned *first, unsigned *incr)
       *first = 4;
       *incr = 2;
       break;
+   case PIPE_PRIM_PATCHES:
+      *first = vertices_per_patch;
+      *incr = vertices_per_patch;
+      break;
    default:
       assert(0);
       *first = 0;
@@ -0,0 +1,607 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Tessellation control and evaluation shader stages.
+ *
+ * Both shaders only exist as LLVM generated code. The control shader runs
+ * once per patch with one invocation per SIMD lane, the fixed function
+ * tessellator then turns the patch into domain points, and the evaluation
+ * shader consumes those a whole vector at a time, writing post-transform
+ * vertices just like the vertex or geometry shader would.
+ */
+
+#include "draw_tess.h"
+
+#include "draw_private.h"
+#include "draw_context.h"
+#ifdef HAVE_LLVM
+#include "draw_llvm.h"
+#endif
+
+#include "pipe/p_shader_tokens.h"
+#include "tgsi/tgsi_parse.h"
+
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+/* The back ends can only address a ushort worth of vertices */
+#define DRAW_TESS_MAX_OUTPUT_VERTICES 65535
+
+/* Domain points are evaluated in whole vectors of up to this many */
+#define DRAW_TESS_VECTOR_PAD 16
+
+
+static boolean
+is_patch_semantic(unsigned semantic_name)
+{
+   return semantic_name == TGSI_SEMANTIC_PATCH ||
+          semantic_name == TGSI_SEMANTIC_TESSOUTER ||
+          semantic_name == TGSI_SEMANTIC_TESSINNER;
+}
+
+
+/**
+ * Find the output of the previous stage matching an input, -1 if none.
+ */
+static int
+find_output(const struct tgsi_shader_info *info,
+            unsigned semantic_name, unsigned semantic_index)
+{
+   unsigned i;
+
+   for (i = 0; i < info->num_outputs; i++) {
+      if (info->output_semantic_name[i] == semantic_name &&
+          info->output_semantic_index[i] == semantic_index)
+         return i;
+   }
+   return -1;
+}
+
+
+static const float *
+vs_output(const struct draw_vertex_info *input_verts, unsigned idx,
+          int slot)
+{
+   const struct vertex_header *v = (const struct vertex_header *)
+      ((const char *)input_verts->verts + idx * input_verts->stride);
+   return v->data[slot];
+}
+
+
+/**
+ * Fill the evaluation shader inputs of one patch from the control shader
+ * outputs, or from the vertex shader outputs and the default tessellation
+ * levels if there's no control shader.
+ */
+static void
+fetch_tes_inputs(struct draw_context *draw,
+                 const int *tes_map,
+                 const struct draw_vertex_info *input_verts,
+                 const unsigned *patch_idx,
+                 unsigned num_vertices)
+{
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
+   const struct tgsi_shader_info *info = &tes->info;
+   unsigned i, v;
+
+   for (i = 0; i < info->num_inputs; i++) {
+      unsigned name = info->input_semantic_name[i];
+      int slot = tes_map[i];
+
+      if (is_patch_semantic(name)) {
+         float *dst = tes->input[i];
+
+         if (tcs && slot >= 0) {
+            memcpy(dst, tcs->output[slot], 4 * sizeof(float));
+         }
+         else if (!tcs && name == TGSI_SEMANTIC_TESSOUTER) {
+            memcpy(dst, draw->default_outer_tess_level, 4 * sizeof(float));
+         }
+         else if (!tcs && name == TGSI_SEMANTIC_TESSINNER) {
+            dst[0] = draw->default_inner_tess_level[0];
+            dst[1] = draw->default_inner_tess_level[1];
+            dst[2] = dst[3] = 0.0f;
+         }
+         else {
+            memset(dst, 0, 4 * sizeof(float));
+         }
+         continue;
+      }
+
+      for (v = 0; v < num_vertices; v++) {
+         float *dst = tes->input[(v + 1) * tes->input_stride + i];
+
+         if (slot < 0)
+            memset(dst, 0, 4 * sizeof(float));
+         else if (tcs)
+            memcpy(dst, tcs->output[(v + 1) * tcs->output_stride + slot],
+                   4 * sizeof(float));
+         else
+            memcpy(dst, vs_output(input_verts, patch_idx[v], slot),
+                   4 * sizeof(float));
+      }
+   }
+}
+
+
+/**
+ * Get the tessellation levels of the current patch.
+ */
+static void
+get_tess_levels(struct draw_context *draw,
+                int outer_slot, int inner_slot,
+                float outer[4], float inner[2])
+{
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+
+   if (!tcs) {
+      memcpy(outer, draw->default_outer_tess_level, 4 * sizeof(float));
+      memcpy(inner, draw->default_inner_tess_level, 2 * sizeof(float));
+      return;
+   }
+
+   /* levels the control shader doesn't write are undefined, use zero */
+   if (outer_slot >= 0)
+      memcpy(outer, tcs->output[outer_slot], 4 * sizeof(float));
+   else
+      memset(outer, 0, 4 * sizeof(float));
+
+   if (inner_slot >= 0)
+      memcpy(inner, tcs->output[inner_slot], 2 * sizeof(float));
+   else
+      memset(inner, 0, 2 * sizeof(float));
+}
+
+
+void
+draw_tess_run(struct draw_context *draw,
+              const struct draw_vertex_info *input_verts,
+              const struct draw_prim_info *input_prims,
+              const struct tgsi_shader_info *input_info,
+              unsigned *next_patch,
+              struct draw_vertex_info *output_verts,
+              struct draw_prim_info *output_prims)
+{
+#ifdef HAVE_LLVM
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
+   struct draw_tessellator *tessellator = &tes->tessellator;
+   const unsigned vertices_per_patch = draw->pt.vertices_per_patch;
+   const unsigned num_patches = input_prims->count / vertices_per_patch;
+   const unsigned patch_vertices_out =
+      tcs ? tcs->vertices_out : vertices_per_patch;
+   const unsigned vertex_size = sizeof(struct vertex_header) +
+      draw_total_tes_outputs(draw) * 4 * sizeof(float);
+   int tcs_map[PIPE_MAX_SHADER_INPUTS];
+   int tes_map[PIPE_MAX_SHADER_INPUTS];
+   int outer_slot = -1, inner_slot = -1;
+   unsigned max_verts = 0;
+   unsigned patch, i, v;
+
+   assert(tes && tes->current_variant);
+   assert(!tcs || tcs->current_variant);
+   assert(vertices_per_patch > 0 &&
+          vertices_per_patch <= DRAW_TESS_MAX_PATCH_VERTICES);
+
+   output_verts->vertex_size = vertex_size;
+   output_verts->stride = vertex_size;
+   output_verts->count = 0;
+   output_verts->verts = NULL;
+
+   output_prims->linear = FALSE;
+   output_prims->start = 0;
+   output_prims->elts = NULL;
+   output_prims->count = 0;
+   output_prims->prim = tes->output_primitive;
+   output_prims->flags = 0x0;
+   output_prims->primitive_lengths = &output_prims->count;
+   output_prims->primitive_count = 1;
+
+   /* Match up the inputs of each stage with the outputs of the previous */
+   if (tcs) {
+      for (i = 0; i < tcs->info.num_inputs; i++)
+         tcs_map[i] = find_output(input_info,
+                                  tcs->info.input_semantic_name[i],
+                                  tcs->info.input_semantic_index[i]);
+      outer_slot = find_output(&tcs->info, TGSI_SEMANTIC_TESSOUTER, 0);
+      inner_slot = find_output(&tcs->info, TGSI_SEMANTIC_TESSINNER, 0);
+   }
+   for (i = 0; i < tes->info.num_inputs; i++)
+      tes_map[i] = find_output(tcs ? &tcs->info : input_info,
+                               tes->info.input_semantic_name[i],
+                               tes->info.input_semantic_index[i]);
+
+   for (patch = *next_patch; patch < num_patches; patch++) {
+      unsigned patch_idx[DRAW_TESS_MAX_PATCH_VERTICES];
+      unsigned first = input_prims->start + patch * vertices_per_patch;
+      float outer[4], inner[2];
+      unsigned needed;
+      ushort *elts;
+
+      for (v = 0; v < vertices_per_patch; v++) {
+         patch_idx[v] = input_prims->linear ? first + v :
+                                              input_prims->elts[first + v];
+      }
+
+      if (tcs) {
+         for (v = 0; v < vertices_per_patch; v++) {
+            for (i = 0; i < tcs->info.num_inputs; i++) {
+               float *dst = tcs->input[v * tcs->input_stride + i];
+
+               if (tcs_map[i] < 0)
+                  memset(dst, 0, 4 * sizeof(float));
+               else
+                  memcpy(dst, vs_output(input_verts, patch_idx[v], tcs_map[i]),
+                         4 * sizeof(float));
+            }
+         }
+
+         tcs->current_variant->jit_func(&draw->llvm->tcs_jit_context,
+                                        &tcs->input[0][0],
+                                        &tcs->output[0][0],
+                                        tes->in_patch_idx,
+                                        vertices_per_patch);
+      }
+
+      get_tess_levels(draw, outer_slot, inner_slot, outer, inner);
+      draw_tessellate(tessellator, outer, inner);
+
+      if (tessellator->num_points) {
+         /* leave the rest of the patches for the next batch */
+         if (output_verts->count + tessellator->num_points >
+             DRAW_TESS_MAX_OUTPUT_VERTICES && output_verts->count)
+            break;
+
+         needed = output_verts->count +
+                  align(tessellator->num_points, DRAW_TESS_VECTOR_PAD);
+         if (needed > max_verts) {
+            unsigned size = MAX2(needed, max_verts * 2);
+
+            output_verts->verts = REALLOC(output_verts->verts,
+                                          max_verts * vertex_size,
+                                          size * vertex_size);
+            max_verts = size;
+         }
+         if (output_prims->count + tessellator->num_indices > tes->max_elts) {
+            unsigned size = MAX2(output_prims->count +
+                                 tessellator->num_indices,
+                                 tes->max_elts * 2);
+
+            tes->elts = REALLOC(tes->elts, tes->max_elts * sizeof(ushort),
+                                size * sizeof(ushort));
+            tes->max_elts = size;
+         }
+         if (!output_verts->verts || !tes->elts) {
+            FREE(output_verts->verts);
+            output_verts->verts = NULL;
+            output_verts->count = 0;
+            output_prims->count = 0;
+            *next_patch = num_patches;
+            return;
+         }
+
+         fetch_tes_inputs(draw, tes_map, input_verts, patch_idx,
+                          patch_vertices_out);
+
+         tes->current_variant->jit_func(&draw->llvm->tes_jit_context,
+                                        &tes->input[0][0],
+                                        (struct vertex_header *)
+                                        ((char *)output_verts->verts +
+                                         output_verts->count * vertex_size),
+                                        tessellator->u,
+                                        tessellator->v,
+                                        tessellator->num_points,
+                                        tes->in_patch_idx,
+                                        patch_vertices_out,
+                                        outer, inner);
+
+         elts = tes->elts + output_prims->count;
+         for (i = 0; i < tessellator->num_indices; i++)
+            elts[i] = (ushort)(output_verts->count + tessellator->indices[i]);
+
+         output_verts->count += tessellator->num_points;
+         output_prims->count += tessellator->num_indices;
+      }
+
+      if (draw->collect_statistics) {
+         if (tcs)
+            draw->statistics.hs_invocations += tcs->vertices_out;
+         draw->statistics.ds_invocations += tessellator->num_points;
+      }
+
+      tes->in_patch_idx++;
+   }
+
+   output_prims->elts = tes->elts;
+   *next_patch = patch;
+#else
+   (void) input_verts;
+   (void) input_prims;
+   (void) input_info;
+   memset(output_verts, 0, sizeof *output_verts);
+   memset(output_prims, 0, sizeof *output_prims);
+   *next_patch = ~0u;
+#endif
+}
+
+
+struct draw_tess_ctrl_shader *
+draw_create_tess_ctrl_shader(struct draw_context *draw,
+                             const struct pipe_shader_state *state)
+{
+#ifdef HAVE_LLVM
+   struct llvm_tess_ctrl_shader *llvm_tcs;
+   struct draw_tess_ctrl_shader *tcs;
+
+   /* There's no interpreted path for tessellation */
+   if (!draw->llvm || state->type != PIPE_SHADER_IR_TGSI)
+      return NULL;
+
+   llvm_tcs = CALLOC_STRUCT(llvm_tess_ctrl_shader);
+   if (!llvm_tcs)
+      return NULL;
+
+   tcs = &llvm_tcs->base;
+   make_empty_list(&llvm_tcs->variants);
+
+   tcs->draw = draw;
+   tcs->state = *state;
+   tcs->state.tokens = tgsi_dup_tokens(state->tokens);
+   if (!tcs->state.tokens) {
+      FREE(llvm_tcs);
+      return NULL;
+   }
+
+   tgsi_scan_shader(state->tokens, &tcs->info);
+
+   tcs->vertices_out = tcs->info.properties[TGSI_PROPERTY_TCS_VERTICES_OUT];
+   tcs->input_stride = tcs->info.file_max[TGSI_FILE_INPUT] + 1;
+   tcs->output_stride = tcs->info.file_max[TGSI_FILE_OUTPUT] + 1;
+
+   tcs->input = align_malloc(DRAW_TESS_MAX_PATCH_VERTICES *
+                             MAX2(tcs->input_stride, 1) * 4 * sizeof(float),
+                             16);
+   tcs->output = align_malloc((DRAW_TESS_MAX_PATCH_VERTICES + 1) *
+                              MAX2(tcs->output_stride, 1) * 4 * sizeof(float),
+                              16);
+   if (!tcs->input || !tcs->output) {
+      align_free(tcs->input);
+      align_free(tcs->output);
+      FREE((void *) tcs->state.tokens);
+      FREE(llvm_tcs);
+      return NULL;
+   }
+
+   llvm_tcs->variant_key_size =
+      draw_tess_llvm_variant_key_size(
+         MAX2(tcs->info.file_max[TGSI_FILE_SAMPLER]+1,
+              tcs->info.file_max[TGSI_FILE_SAMPLER_VIEW]+1));
+
+   return tcs;
+#else
+   (void) draw;
+   (void) state;
+   return NULL;
+#endif
+}
+
+
+void
+draw_bind_tess_ctrl_shader(struct draw_context *draw,
+                           struct draw_tess_ctrl_shader *dtcs)
+{
+   draw_do_flush(draw, DRAW_FLUSH_STATE_CHANGE);
+   draw->tcs.tess_ctrl_shader = dtcs;
+}
+
+
+void
+draw_delete_tess_ctrl_shader(struct draw_context *draw,
+                             struct draw_tess_ctrl_shader *dtcs)
+{
+#ifdef HAVE_LLVM
+   struct llvm_tess_ctrl_shader *shader;
+   struct draw_tcs_llvm_variant_list_item *li;
+
+   if (!dtcs)
+      return;
+
+   shader = llvm_tess_ctrl_shader(dtcs);
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      struct draw_tcs_llvm_variant_list_item *next = next_elem(li);
+      draw_tcs_llvm_destroy_variant(li->base);
+      li = next;
+   }
+
+   assert(shader->variants_cached == 0);
+
+   align_free(dtcs->input);
+   align_free(dtcs->output);
+   FREE((void *) dtcs->state.tokens);
+   FREE(shader);
+#endif
+}
+
+
+struct draw_tess_eval_shader *
+draw_create_tess_eval_shader(struct draw_context *draw,
+                             const struct pipe_shader_state *state)
+{
+#ifdef HAVE_LLVM
+   struct llvm_tess_eval_shader *llvm_tes;
+   struct draw_tess_eval_shader *tes;
+   unsigned i;
+
+   if (!draw->llvm || state->type != PIPE_SHADER_IR_TGSI)
+      return NULL;
+
+   llvm_tes = CALLOC_STRUCT(llvm_tess_eval_shader);
+   if (!llvm_tes)
+      return NULL;
+
+   tes = &llvm_tes->base;
+   make_empty_list(&llvm_tes->variants);
+
+   tes->draw = draw;
+   tes->state = *state;
+   tes->state.tokens = tgsi_dup_tokens(state->tokens);
+   if (!tes->state.tokens) {
+      FREE(llvm_tes);
+      return NULL;
+   }
+
+   tgsi_scan_shader(state->tokens, &tes->info);
+
+   tes->prim_mode = tes->info.properties[TGSI_PROPERTY_TES_PRIM_MODE];
+   tes->spacing = tes->info.properties[TGSI_PROPERTY_TES_SPACING];
+   tes->vertex_order_cw = tes->info.properties[TGSI_PROPERTY_TES_VERTEX_ORDER_CW];
+   tes->point_mode = tes->info.properties[TGSI_PROPERTY_TES_POINT_MODE];
+
+   draw_tessellator_init(&tes->tessellator, tes->prim_mode, tes->spacing,
+                         tes->vertex_order_cw, tes->point_mode);
+   tes->output_primitive = tes->tessellator.out_prim;
+
+   tes->position_output = -1;
+   for (i = 0; i < tes->info.num_outputs; i++) {
+      if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_POSITION &&
+          tes->info.output_semantic_index[i] == 0)
+         tes->position_output = i;
+      if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_VIEWPORT_INDEX)
+         tes->viewport_index_output = i;
+      if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_CLIPDIST) {
+         debug_assert(tes->info.output_semantic_index[i] <
+                      PIPE_MAX_CLIP_OR_CULL_DISTANCE_ELEMENT_COUNT);
+         tes->ccdistance_output[tes->info.output_semantic_index[i]] = i;
+      }
+   }
+
+   tes->input_stride = tes->info.file_max[TGSI_FILE_INPUT] + 1;
+   tes->input = align_malloc((DRAW_TESS_MAX_PATCH_VERTICES + 1) *
+                             MAX2(tes->input_stride, 1) * 4 * sizeof(float),
+                             16);
+   if (!tes->input) {
+      FREE((void *) tes->state.tokens);
+      FREE(llvm_tes);
+      return NULL;
+   }
+
+   llvm_tes->variant_key_size =
+      draw_tess_llvm_variant_key_size(
+         MAX2(tes->info.file_max[TGSI_FILE_SAMPLER]+1,
+              tes->info.file_max[TGSI_FILE_SAMPLER_VIEW]+1));
+
+   return tes;
+#else
+   (void) draw;
+   (void) state;
+   return NULL;
+#endif
+}
+
+
+void
+draw_bind_tess_eval_shader(struct draw_context *draw,
+                           struct draw_tess_eval_shader *dtes)
+{
+   draw_do_flush(draw, DRAW_FLUSH_STATE_CHANGE);
+
+   if (dtes) {
+      draw->tes.tess_eval_shader = dtes;
+      draw->tes.num_tes_outputs = dtes->info.num_outputs;
+      draw->tes.position_output = dtes->position_output;
+   }
+   else {
+      draw->tes.tess_eval_shader = NULL;
+      draw->tes.num_tes_outputs = 0;
+   }
+}
+
+
+void
+draw_delete_tess_eval_shader(struct draw_context *draw,
+                             struct draw_tess_eval_shader *dtes)
+{
+#ifdef HAVE_LLVM
+   struct llvm_tess_eval_shader *shader;
+   struct draw_tes_llvm_variant_list_item *li;
+
+   if (!dtes)
+      return;
+
+   shader = llvm_tess_eval_shader(dtes);
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      struct draw_tes_llvm_variant_list_item *next = next_elem(li);
+      draw_tes_llvm_destroy_variant(li->base);
+      li = next;
+   }
+
+   assert(shader->variants_cached == 0);
+
+   draw_tessellator_fini(&dtes->tessellator);
+   align_free(dtes->input);
+   FREE(dtes->elts);
+   FREE((void *) dtes->state.tokens);
+   FREE(shader);
+#endif
+}
+
+
+/**
+ * Set the tessellation levels used when no control shader is bound.
+ */
+void
+draw_set_tess_state(struct draw_context *draw,
+                    const float default_outer_level[4],
+                    const float default_inner_level[2])
+{
+   draw_do_flush(draw, DRAW_FLUSH_PARAMETER_CHANGE);
+
+   memcpy(draw->default_outer_tess_level, default_outer_level,
+          4 * sizeof(float));
+   memcpy(draw->default_inner_tess_level, default_inner_level,
+          2 * sizeof(float));
+}
+
+
+/*
+ * Called at the very begin of the draw call with a new instance
+ * Used to reset state that should persist between primitive restart.
+ */
+void
+draw_tess_new_instance(struct draw_tess_eval_shader *tes)
+{
+   if (!tes)
+      return;
+
+   tes->in_patch_idx = 0;
+}
@@ -0,0 +1,126 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#ifndef DRAW_TESS_H
+#define DRAW_TESS_H
+
+#include "draw_context.h"
+#include "draw_private.h"
+#include "draw_tessellator.h"
+#include "tgsi/tgsi_scan.h"
+
+#define DRAW_TESS_MAX_PATCH_VERTICES 32
+
+struct draw_context;
+
+#ifdef HAVE_LLVM
+struct draw_tcs_llvm_variant;
+struct draw_tes_llvm_variant;
+#endif
+
+/**
+ * Private version of the compiled tessellation control shader.
+ *
+ * Patch data is passed around as plain float[4] arrays. The control
+ * shader output, which is also the evaluation shader input, starts with
+ * one block holding the per-patch attributes followed by one block per
+ * vertex; each block has room for all the registers of the respective
+ * file.
+ */
+struct draw_tess_ctrl_shader {
+   struct draw_context *draw;
+
+   struct pipe_shader_state state;
+   struct tgsi_shader_info info;
+
+   unsigned vertices_out;
+
+   unsigned input_stride;   /**< attributes per input vertex */
+   unsigned output_stride;  /**< attributes per output block */
+
+   float (*input)[4];
+   float (*output)[4];
+
+#ifdef HAVE_LLVM
+   struct draw_tcs_llvm_variant *current_variant;
+#endif
+};
+
+/**
+ * Private version of the compiled tessellation evaluation shader
+ */
+struct draw_tess_eval_shader {
+   struct draw_context *draw;
+
+   struct pipe_shader_state state;
+   struct tgsi_shader_info info;
+
+   enum pipe_prim_type prim_mode;
+   enum pipe_tess_spacing spacing;
+   boolean vertex_order_cw;
+   boolean point_mode;
+   unsigned output_primitive;
+
+   unsigned position_output;
+   unsigned viewport_index_output;
+   unsigned ccdistance_output[PIPE_MAX_CLIP_OR_CULL_DISTANCE_ELEMENT_COUNT];
+
+   unsigned input_stride;   /**< attributes per input block */
+   float (*input)[4];
+
+   struct draw_tessellator tessellator;
+
+   /** patch count since the start of the instance, for the primitive id */
+   unsigned in_patch_idx;
+
+   ushort *elts;
+   unsigned max_elts;
+
+#ifdef HAVE_LLVM
+   struct draw_tes_llvm_variant *current_variant;
+#endif
+};
+
+
+void draw_tess_new_instance(struct draw_tess_eval_shader *tes);
+
+/**
+ * Run the tessellation stages on the patches of a vertex shader output,
+ * starting at *next_patch. Produces indexed output primitives, stopping
+ * early once the vertex count would exceed what the back ends can
+ * address; *next_patch is advanced past the patches consumed, so the
+ * caller just keeps calling until all of them are done.
+ */
+void draw_tess_run(struct draw_context *draw,
+                   const struct draw_vertex_info *input_verts,
+                   const struct draw_prim_info *input_prims,
+                   const struct tgsi_shader_info *input_info,
+                   unsigned *next_patch,
+                   struct draw_vertex_info *output_verts,
+                   struct draw_prim_info *output_prims);
+
+#endif
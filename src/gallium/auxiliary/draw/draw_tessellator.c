@@ -0,0 +1,587 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Tessellation primitive generator, following the rules in section 11.2.2
+ * of the OpenGL 4.5 spec.
+ *
+ * Triangles are built as concentric rings, quads as an outer ring around a
+ * regular grid, and adjacent rings are stitched together edge by edge.
+ * All the positions are derived from the same (mirrored) edge subdivisions,
+ * so shared edges of neighbouring patches get bit identical coordinates.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "draw_tessellator.h"
+
+
+/* Domain points are padded to a whole 512 bit vector of floats */
+#define TESS_POINT_PAD 16
+
+/* Points on one edge of a ring, plus one for the shared corner */
+#define TESS_MAX_EDGE_POINTS (DRAW_TESS_MAX_LEVEL + 1)
+
+
+/**
+ * A polyline along one edge of a ring. param is the position of each point
+ * projected onto the outer edge, which is what the stitching goes by.
+ */
+struct tess_edge
+{
+   unsigned num_segments;
+   ushort idx[TESS_MAX_EDGE_POINTS];
+   float param[TESS_MAX_EDGE_POINTS];
+};
+
+
+static void
+grow_points(struct draw_tessellator *tess, unsigned count)
+{
+   unsigned needed = align(count, TESS_POINT_PAD);
+
+   if (needed > tess->max_points) {
+      unsigned size = MAX2(needed, tess->max_points * 2);
+      tess->u = REALLOC(tess->u, tess->max_points * sizeof(float),
+                        size * sizeof(float));
+      tess->v = REALLOC(tess->v, tess->max_points * sizeof(float),
+                        size * sizeof(float));
+      tess->max_points = size;
+   }
+}
+
+
+static ushort
+emit_point(struct draw_tessellator *tess, float u, float v)
+{
+   unsigned idx = tess->num_points++;
+
+   grow_points(tess, tess->num_points);
+   tess->u[idx] = u;
+   tess->v[idx] = v;
+   return (ushort)idx;
+}
+
+
+static void
+emit_indices(struct draw_tessellator *tess, const ushort *idx, unsigned count)
+{
+   unsigned i;
+
+   if (tess->num_indices + count > tess->max_indices) {
+      unsigned size = MAX2(tess->num_indices + count, tess->max_indices * 2);
+      tess->indices = REALLOC(tess->indices,
+                              tess->max_indices * sizeof(ushort),
+                              size * sizeof(ushort));
+      tess->max_indices = size;
+   }
+
+   for (i = 0; i < count; i++)
+      tess->indices[tess->num_indices++] = idx[i];
+}
+
+
+/**
+ * Emit a triangle, with the winding fixed up by its signed area in (u, v)
+ * space. Degenerate triangles, which fractional spacing produces on
+ * purpose, are passed through as they are.
+ */
+static void
+emit_triangle(struct draw_tessellator *tess, ushort a, ushort b, ushort c)
+{
+   const float *u = tess->u, *v = tess->v;
+   float area = (u[b] - u[a]) * (v[c] - v[a]) - (u[c] - u[a]) * (v[b] - v[a]);
+   ushort tri[3];
+
+   tri[0] = a;
+   if ((area < 0.0f) != tess->vertex_order_cw) {
+      tri[1] = c;
+      tri[2] = b;
+   }
+   else {
+      tri[1] = b;
+      tri[2] = c;
+   }
+   emit_indices(tess, tri, 3);
+}
+
+
+/**
+ * Clamp and round a tessellation level according to the spacing. Returns
+ * the number of segments, and the clamped level in *f.
+ */
+static unsigned
+tess_level(enum pipe_tess_spacing spacing, float level, float *f)
+{
+   float l;
+   unsigned n;
+
+   switch (spacing) {
+   case PIPE_TESS_SPACING_FRACTIONAL_ODD:
+      l = level >= 1.0f ? MIN2(level, DRAW_TESS_MAX_LEVEL - 1) : 1.0f;
+      n = (unsigned)ceilf(l);
+      n |= 1;
+      break;
+   case PIPE_TESS_SPACING_FRACTIONAL_EVEN:
+      l = level >= 2.0f ? MIN2(level, DRAW_TESS_MAX_LEVEL) : 2.0f;
+      n = (unsigned)ceilf(l);
+      n += n & 1;
+      break;
+   case PIPE_TESS_SPACING_EQUAL:
+   default:
+      l = level >= 1.0f ? MIN2(level, DRAW_TESS_MAX_LEVEL) : 1.0f;
+      n = (unsigned)ceilf(l);
+      l = (float)n;
+      break;
+   }
+
+   *f = l;
+   return n;
+}
+
+
+/**
+ * Split [0, 1] into n segments for level f: n - 2 of them have length 1/f,
+ * the two at the ends share what's left. The second half is mirrored from
+ * the first so that the result is exactly symmetric.
+ */
+static void
+subdivide(float f, unsigned n, float *t)
+{
+   float s;
+   unsigned i;
+
+   if (n == 1) {
+      t[0] = 0.0f;
+      t[1] = 1.0f;
+      return;
+   }
+
+   s = (f - (float)(n - 2)) * 0.5f;
+   for (i = 0; i <= n / 2; i++) {
+      float p = i == 0 ? 0.0f : (s + (float)(i - 1)) / f;
+      t[i] = p;
+      t[n - i] = 1.0f - p;
+   }
+}
+
+
+/**
+ * Connect the points of an outer ring edge to those of the next inner ring
+ * with a strip of triangles, always advancing on the side whose next
+ * segment is centered further back.
+ */
+static void
+stitch_edge(struct draw_tessellator *tess,
+            const struct tess_edge *outer,
+            const struct tess_edge *inner)
+{
+   unsigned i = 0, j = 0;
+   unsigned m = outer->num_segments, q = inner->num_segments;
+
+   while (i < m || j < q) {
+      boolean advance_outer;
+
+      if (j == q)
+         advance_outer = TRUE;
+      else if (i == m)
+         advance_outer = FALSE;
+      else
+         advance_outer = outer->param[i] + outer->param[i + 1] <=
+                         inner->param[j] + inner->param[j + 1];
+
+      if (advance_outer) {
+         emit_triangle(tess, outer->idx[i], outer->idx[i + 1], inner->idx[j]);
+         i++;
+      }
+      else {
+         emit_triangle(tess, outer->idx[i], inner->idx[j + 1], inner->idx[j]);
+         j++;
+      }
+   }
+}
+
+
+/*
+ * Triangles.
+ *
+ * Corner k of the domain has barycentric coordinate k equal to one, and
+ * ring edge k runs from corner k to corner k + 1. Edge 0 is w == 0, edge 1
+ * is u == 0 and edge 2 is v == 0.
+ */
+
+static void
+tri_point(struct tess_edge *edge, struct draw_tessellator *tess,
+          unsigned e, unsigned j, float p, float d)
+{
+   float coord[3];
+
+   /* inset by d, keeping the projection onto the outer edge at p */
+   coord[e] = 1.0f - p - d * 0.5f;
+   coord[(e + 1) % 3] = p - d * 0.5f;
+   coord[(e + 2) % 3] = d;
+
+   edge->idx[j] = emit_point(tess, coord[0], coord[1]);
+   edge->param[j] = p;
+}
+
+
+/**
+ * Build a ring from the given edge subdivisions, inset by d. Corners are
+ * shared between adjacent edges.
+ */
+static void
+tri_ring(struct draw_tessellator *tess, struct tess_edge edges[3],
+         const float *t[3], const unsigned n[3], float d)
+{
+   unsigned e, j;
+
+   for (e = 0; e < 3; e++) {
+      edges[e].num_segments = n[e];
+      for (j = 0; j < n[e]; j++)
+         tri_point(&edges[e], tess, e, j, t[e][j], d);
+   }
+
+   for (e = 0; e < 3; e++) {
+      struct tess_edge *next = &edges[(e + 1) % 3];
+      edges[e].idx[n[e]] = next->idx[0];
+      edges[e].param[n[e]] = 1.0f - next->param[0];
+   }
+}
+
+
+static void
+tessellate_triangles(struct draw_tessellator *tess,
+                     const float outer[4], const float inner[2])
+{
+   float t_outer[3][TESS_MAX_EDGE_POINTS];
+   float t_inner[TESS_MAX_EDGE_POINTS];
+   const float *t[3];
+   unsigned n_outer[3], n_inner, n[3];
+   float f_outer[3], f_inner;
+   struct tess_edge rings[2][3];
+   unsigned e, k, cur = 0;
+
+   for (e = 0; e < 3; e++) {
+      /* ring edge e is the edge with outer level (e + 2) % 3 */
+      n_outer[e] = tess_level(tess->spacing, outer[(e + 2) % 3], &f_outer[e]);
+      subdivide(f_outer[e], n_outer[e], t_outer[e]);
+   }
+   n_inner = tess_level(tess->spacing, inner[0], &f_inner);
+
+   if (n_inner == 1) {
+      if (n_outer[0] == 1 && n_outer[1] == 1 && n_outer[2] == 1) {
+         ushort tri[3];
+
+         tri[0] = emit_point(tess, 1.0f, 0.0f);
+         tri[1] = emit_point(tess, 0.0f, 1.0f);
+         tri[2] = emit_point(tess, 0.0f, 0.0f);
+         emit_triangle(tess, tri[0], tri[1], tri[2]);
+         return;
+      }
+      n_inner = tess_level(tess->spacing, 1.0f + FLT_EPSILON, &f_inner);
+   }
+   subdivide(f_inner, n_inner, t_inner);
+
+   for (e = 0; e < 3; e++)
+      t[e] = t_outer[e];
+   tri_ring(tess, rings[cur], t, n_outer, 0.0f);
+
+   for (k = 1; 2 * k <= n_inner; k++) {
+      struct tess_edge *prev = rings[cur];
+      struct tess_edge *ring = rings[cur ^ 1];
+
+      if (2 * k == n_inner) {
+         /* innermost ring collapses into the center point */
+         ushort center = emit_point(tess, 1.0f / 3.0f, 1.0f / 3.0f);
+         for (e = 0; e < 3; e++) {
+            ring[e].num_segments = 0;
+            ring[e].idx[0] = center;
+            ring[e].param[0] = 0.5f;
+         }
+      }
+      else {
+         for (e = 0; e < 3; e++) {
+            t[e] = &t_inner[k];
+            n[e] = n_inner - 2 * k;
+         }
+         tri_ring(tess, ring, t, n, t_inner[k] * (2.0f / 3.0f));
+      }
+
+      for (e = 0; e < 3; e++)
+         stitch_edge(tess, &prev[e], &ring[e]);
+
+      cur ^= 1;
+   }
+
+   if (n_inner & 1) {
+      /* innermost ring is a single triangle */
+      const struct tess_edge *ring = rings[cur];
+      emit_triangle(tess, ring[0].idx[0], ring[1].idx[0], ring[2].idx[0]);
+   }
+}
+
+
+/*
+ * Quads.
+ *
+ * The outer ring runs counter-clockwise from (0, 0): v == 0, u == 1,
+ * v == 1 and u == 0, which use outer levels 1, 2, 3 and 0 respectively.
+ */
+
+static void
+quad_outer_ring(struct draw_tessellator *tess, struct tess_edge edges[4],
+                const float outer[4])
+{
+   static const float start[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+   static const float dir[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+   float t[TESS_MAX_EDGE_POINTS];
+   unsigned e, j;
+
+   for (e = 0; e < 4; e++) {
+      float f;
+      unsigned n = tess_level(tess->spacing, outer[(e + 1) % 4], &f);
+
+      subdivide(f, n, t);
+      edges[e].num_segments = n;
+      for (j = 0; j < n; j++) {
+         edges[e].idx[j] = emit_point(tess,
+                                      start[e][0] + dir[e][0] * t[j],
+                                      start[e][1] + dir[e][1] * t[j]);
+         edges[e].param[j] = t[j];
+      }
+   }
+
+   for (e = 0; e < 4; e++) {
+      edges[e].idx[edges[e].num_segments] = edges[(e + 1) % 4].idx[0];
+      edges[e].param[edges[e].num_segments] = 1.0f;
+   }
+}
+
+
+static void
+tessellate_quads(struct draw_tessellator *tess,
+                 const float outer[4], const float inner[2])
+{
+   float tu[TESS_MAX_EDGE_POINTS], tv[TESS_MAX_EDGE_POINTS];
+   ushort grid[TESS_MAX_EDGE_POINTS][TESS_MAX_EDGE_POINTS];
+   struct tess_edge outer_ring[4], inner_ring[4];
+   unsigned nu, nv, i, j, e;
+   float fu, fv;
+
+   nu = tess_level(tess->spacing, inner[0], &fu);
+   nv = tess_level(tess->spacing, inner[1], &fv);
+
+   if (nu == 1 || nv == 1) {
+      boolean outer_ones = TRUE;
+
+      for (e = 0; e < 4; e++) {
+         float f;
+         if (tess_level(tess->spacing, outer[e], &f) != 1)
+            outer_ones = FALSE;
+      }
+
+      if (nu == 1 && nv == 1 && outer_ones) {
+         ushort q[4];
+
+         q[0] = emit_point(tess, 0.0f, 0.0f);
+         q[1] = emit_point(tess, 1.0f, 0.0f);
+         q[2] = emit_point(tess, 1.0f, 1.0f);
+         q[3] = emit_point(tess, 0.0f, 1.0f);
+         emit_triangle(tess, q[0], q[1], q[2]);
+         emit_triangle(tess, q[0], q[2], q[3]);
+         return;
+      }
+      if (nu == 1)
+         nu = tess_level(tess->spacing, 1.0f + FLT_EPSILON, &fu);
+      if (nv == 1)
+         nv = tess_level(tess->spacing, 1.0f + FLT_EPSILON, &fv);
+   }
+   subdivide(fu, nu, tu);
+   subdivide(fv, nv, tv);
+
+   quad_outer_ring(tess, outer_ring, outer);
+
+   /* interior grid, rows of constant v */
+   for (j = 1; j < nv; j++)
+      for (i = 1; i < nu; i++)
+         grid[i][j] = emit_point(tess, tu[i], tv[j]);
+
+   for (j = 1; j + 1 < nv; j++) {
+      for (i = 1; i + 1 < nu; i++) {
+         emit_triangle(tess, grid[i][j], grid[i + 1][j], grid[i + 1][j + 1]);
+         emit_triangle(tess, grid[i][j], grid[i + 1][j + 1], grid[i][j + 1]);
+      }
+   }
+
+   /* boundary of the grid, in the same order as the outer ring */
+   inner_ring[0].num_segments = inner_ring[2].num_segments = nu - 2;
+   inner_ring[1].num_segments = inner_ring[3].num_segments = nv - 2;
+   for (i = 0; i <= nu - 2; i++) {
+      inner_ring[0].idx[i] = grid[1 + i][1];
+      inner_ring[0].param[i] = tu[1 + i];
+      inner_ring[2].idx[i] = grid[nu - 1 - i][nv - 1];
+      inner_ring[2].param[i] = 1.0f - tu[nu - 1 - i];
+   }
+   for (j = 0; j <= nv - 2; j++) {
+      inner_ring[1].idx[j] = grid[nu - 1][1 + j];
+      inner_ring[1].param[j] = tv[1 + j];
+      inner_ring[3].idx[j] = grid[1][nv - 1 - j];
+      inner_ring[3].param[j] = 1.0f - tv[nv - 1 - j];
+   }
+
+   for (e = 0; e < 4; e++)
+      stitch_edge(tess, &outer_ring[e], &inner_ring[e]);
+}
+
+
+/*
+ * Isolines: outer level 0 is the number of lines, always with equal
+ * spacing, and outer level 1 the number of segments in each of them.
+ */
+static void
+tessellate_isolines(struct draw_tessellator *tess, const float outer[4])
+{
+   float t[TESS_MAX_EDGE_POINTS];
+   unsigned num_lines, n, i, j;
+   float f;
+
+   num_lines = tess_level(PIPE_TESS_SPACING_EQUAL, outer[0], &f);
+   n = tess_level(tess->spacing, outer[1], &f);
+   subdivide(f, n, t);
+
+   for (j = 0; j < num_lines; j++) {
+      float v = (float)j / (float)num_lines;
+      ushort prev = emit_point(tess, t[0], v);
+
+      for (i = 1; i <= n; i++) {
+         ushort line[2];
+
+         line[0] = prev;
+         line[1] = prev = emit_point(tess, t[i], v);
+         if (!tess->point_mode)
+            emit_indices(tess, line, 2);
+      }
+   }
+}
+
+
+void
+draw_tessellator_init(struct draw_tessellator *tess,
+                      enum pipe_prim_type prim_mode,
+                      enum pipe_tess_spacing spacing,
+                      boolean vertex_order_cw,
+                      boolean point_mode)
+{
+   memset(tess, 0, sizeof *tess);
+   tess->prim_mode = prim_mode;
+   tess->spacing = spacing;
+   tess->vertex_order_cw = vertex_order_cw;
+   tess->point_mode = point_mode;
+
+   if (point_mode)
+      tess->out_prim = PIPE_PRIM_POINTS;
+   else if (prim_mode == PIPE_PRIM_LINES)
+      tess->out_prim = PIPE_PRIM_LINES;
+   else
+      tess->out_prim = PIPE_PRIM_TRIANGLES;
+}
+
+
+void
+draw_tessellator_fini(struct draw_tessellator *tess)
+{
+   FREE(tess->u);
+   FREE(tess->v);
+   FREE(tess->indices);
+   memset(tess, 0, sizeof *tess);
+}
+
+
+void
+draw_tessellate(struct draw_tessellator *tess,
+                const float outer[4],
+                const float inner[2])
+{
+   unsigned i, num_outer;
+
+   tess->num_points = 0;
+   tess->num_indices = 0;
+
+   switch (tess->prim_mode) {
+   case PIPE_PRIM_TRIANGLES:
+      num_outer = 3;
+      break;
+   case PIPE_PRIM_QUADS:
+      num_outer = 4;
+      break;
+   case PIPE_PRIM_LINES:
+      num_outer = 2;
+      break;
+   default:
+      assert(0);
+      return;
+   }
+
+   /* patches with a non-positive (or NaN) outer level are culled */
+   for (i = 0; i < num_outer; i++) {
+      if (!(outer[i] > 0.0f))
+         return;
+   }
+
+   switch (tess->prim_mode) {
+   case PIPE_PRIM_TRIANGLES:
+      tessellate_triangles(tess, outer, inner);
+      break;
+   case PIPE_PRIM_QUADS:
+      tessellate_quads(tess, outer, inner);
+      break;
+   default:
+      tessellate_isolines(tess, outer);
+      break;
+   }
+
+   if (tess->point_mode) {
+      /* every domain point exactly once */
+      tess->num_indices = 0;
+      for (i = 0; i < tess->num_points; i++) {
+         ushort idx = (ushort)i;
+         emit_indices(tess, &idx, 1);
+      }
+   }
+
+   /* zero the padding, so partial vectors evaluate harmless values */
+   for (i = tess->num_points; i < align(tess->num_points, TESS_POINT_PAD); i++) {
+      tess->u[i] = 0.0f;
+      tess->v[i] = 0.0f;
+   }
+}
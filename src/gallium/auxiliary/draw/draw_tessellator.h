@@ -0,0 +1,88 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Fixed function tessellation primitive generator.
+ *
+ * Turns the tessellation levels of a patch into a set of domain points
+ * and the primitives connecting them. The points are kept as separate u
+ * and v arrays, padded with zeros to a multiple of the maximum vector
+ * length, so that the evaluation shader can consume them a whole vector
+ * at a time.
+ */
+
+#ifndef DRAW_TESSELLATOR_H
+#define DRAW_TESSELLATOR_H
+
+#include "pipe/p_compiler.h"
+#include "pipe/p_defines.h"
+
+#define DRAW_TESS_MAX_LEVEL 64
+
+struct draw_tessellator
+{
+   enum pipe_prim_type prim_mode;    /**< TRIANGLES, QUADS or LINES */
+   enum pipe_tess_spacing spacing;
+   boolean vertex_order_cw;
+   boolean point_mode;
+
+   /** Output primitive type: POINTS, LINES or TRIANGLES */
+   enum pipe_prim_type out_prim;
+
+   /* Results of the last draw_tessellate() call */
+   unsigned num_points;
+   float *u;
+   float *v;
+   unsigned num_indices;
+   ushort *indices;
+
+   unsigned max_points;
+   unsigned max_indices;
+};
+
+
+void
+draw_tessellator_init(struct draw_tessellator *tess,
+                      enum pipe_prim_type prim_mode,
+                      enum pipe_tess_spacing spacing,
+                      boolean vertex_order_cw,
+                      boolean point_mode);
+
+void
+draw_tessellator_fini(struct draw_tessellator *tess);
+
+/**
+ * Tessellate a single patch. Afterwards num_points / num_indices describe
+ * the generated geometry, both zero if the patch got discarded.
+ */
+void
+draw_tessellate(struct draw_tessellator *tess,
+                const float outer[4],
+                const float inner[2]);
+
+#endif /* DRAW_TESSELLATOR_H */
@@ -55,7 +55,7 @@ draw_create_vertex_shader(struct draw_context *draw,
 {
    struct draw_vertex_shader *vs = NULL;
 
-   if (draw->dump_vs) {
+   if (draw->dump_vs && shader->type == PIPE_SHADER_IR_TGSI) {
       tgsi_dump(shader->tokens, 0);
    }
 
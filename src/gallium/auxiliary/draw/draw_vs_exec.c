@@ -33,6 +33,7 @@
 
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_sse.h"
 #include "pipe/p_shader_tokens.h"
 
 #include "draw_private.h"
@@ -80,6 +81,85 @@ vs_exec_prepare(struct draw_vertex_shader *shader,
 
 
 
+#if defined(PIPE_ARCH_SSE)
+
+/**
+ * Transpose the inputs of a full batch of MAX_TGSI_VERTICES vertices into
+ * the machine's input registers.
+ */
+static void
+fetch_inputs_sse(struct tgsi_exec_machine *machine,
+                 const float (*input)[4],
+                 unsigned input_stride,
+                 unsigned num_inputs)
+{
+   const float (*in1)[4] = (const float (*)[4])((const char *)input + input_stride);
+   const float (*in2)[4] = (const float (*)[4])((const char *)in1 + input_stride);
+   const float (*in3)[4] = (const float (*)[4])((const char *)in2 + input_stride);
+   unsigned slot;
+
+   for (slot = 0; slot < num_inputs; slot++) {
+      __m128 v0 = _mm_loadu_ps(input[slot]);
+      __m128 v1 = _mm_loadu_ps(in1[slot]);
+      __m128 v2 = _mm_loadu_ps(in2[slot]);
+      __m128 v3 = _mm_loadu_ps(in3[slot]);
+
+      _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+
+      _mm_storeu_ps(machine->Inputs[slot].xyzw[0].f, v0);
+      _mm_storeu_ps(machine->Inputs[slot].xyzw[1].f, v1);
+      _mm_storeu_ps(machine->Inputs[slot].xyzw[2].f, v2);
+      _mm_storeu_ps(machine->Inputs[slot].xyzw[3].f, v3);
+   }
+}
+
+
+/**
+ * Transpose the outputs of a full batch of MAX_TGSI_VERTICES vertices out of
+ * the machine's output registers, clamping colors like the C path does.
+ */
+static void
+store_outputs_sse(const struct tgsi_exec_machine *machine,
+                  const struct tgsi_shader_info *info,
+                  boolean clamp_vertex_color,
+                  float (*output)[4],
+                  unsigned output_stride)
+{
+   float (*out1)[4] = (float (*)[4])((char *)output + output_stride);
+   float (*out2)[4] = (float (*)[4])((char *)out1 + output_stride);
+   float (*out3)[4] = (float (*)[4])((char *)out2 + output_stride);
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0f);
+   unsigned slot;
+
+   for (slot = 0; slot < info->num_outputs; slot++) {
+      enum tgsi_semantic name = info->output_semantic_name[slot];
+      __m128 v0 = _mm_loadu_ps(machine->Outputs[slot].xyzw[0].f);
+      __m128 v1 = _mm_loadu_ps(machine->Outputs[slot].xyzw[1].f);
+      __m128 v2 = _mm_loadu_ps(machine->Outputs[slot].xyzw[2].f);
+      __m128 v3 = _mm_loadu_ps(machine->Outputs[slot].xyzw[3].f);
+
+      if (clamp_vertex_color &&
+          (name == TGSI_SEMANTIC_COLOR || name == TGSI_SEMANTIC_BCOLOR)) {
+         /* operand order makes NaNs pass through, as with CLAMP() */
+         v0 = _mm_min_ps(one, _mm_max_ps(zero, v0));
+         v1 = _mm_min_ps(one, _mm_max_ps(zero, v1));
+         v2 = _mm_min_ps(one, _mm_max_ps(zero, v2));
+         v3 = _mm_min_ps(one, _mm_max_ps(zero, v3));
+      }
+
+      _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+
+      _mm_storeu_ps(output[slot], v0);
+      _mm_storeu_ps(out1[slot], v1);
+      _mm_storeu_ps(out2[slot], v2);
+      _mm_storeu_ps(out3[slot], v3);
+   }
+}
+
+#endif /* PIPE_ARCH_SSE */
+
+
 /**
  * Simplified vertex shader interface for the pt paths.  Given the
  * complexity of code-generating all the above operations together,
@@ -114,6 +194,15 @@ vs_exec_run_linear(struct draw_vertex_shader *shader,
 
    for (i = 0; i < count; i += MAX_TGSI_VERTICES) {
       unsigned int max_vertices = MIN2(MAX_TGSI_VERTICES, count - i);
+#if defined(PIPE_ARCH_SSE)
+      const boolean full_batch = max_vertices == MAX_TGSI_VERTICES;
+
+      if (full_batch)
+         fetch_inputs_sse(machine, input, input_stride,
+                          shader->info.num_inputs);
+#else
+      const boolean full_batch = FALSE;
+#endif
 
       /* Swizzle inputs.
        */
@@ -147,7 +236,7 @@ vs_exec_run_linear(struct draw_vertex_shader *shader,
             machine->SystemValue[vid].xyzw[0].i[j] = i + j;
          }
 
-         for (slot = 0; slot < shader->info.num_inputs; slot++) {
+         for (slot = 0; slot < shader->info.num_inputs && !full_batch; slot++) {
 #if 0
             assert(!util_is_inf_or_nan(input[slot][0]));
             assert(!util_is_inf_or_nan(input[slot][1]));
@@ -169,6 +258,16 @@ vs_exec_run_linear(struct draw_vertex_shader *shader,
 
       /* Unswizzle all output results.
        */
+#if defined(PIPE_ARCH_SSE)
+      if (full_batch) {
+         store_outputs_sse(machine, &shader->info, clamp_vertex_color,
+                           output, output_stride);
+         output = (float (*)[4])((char *)output +
+                                 MAX_TGSI_VERTICES * output_stride);
+         continue;
+      }
+#endif
+
       for (j = 0; j < max_vertices; j++) {
          for (slot = 0; slot < shader->info.num_outputs; slot++) {
             enum tgsi_semantic name = shader->info.output_semantic_name[slot];
@@ -216,8 +315,13 @@ struct draw_vertex_shader *
 draw_create_vs_exec(struct draw_context *draw,
                     const struct pipe_shader_state *state)
 {
-   struct exec_vertex_shader *vs = CALLOC_STRUCT(exec_vertex_shader);
+   struct exec_vertex_shader *vs;
+
+   /* tgsi_exec can only run TGSI */
+   if (state->type != PIPE_SHADER_IR_TGSI)
+      return NULL;
 
+   vs = CALLOC_STRUCT(exec_vertex_shader);
    if (!vs)
       return NULL;
 
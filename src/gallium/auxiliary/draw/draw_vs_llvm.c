@@ -28,6 +28,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "pipe/p_shader_tokens.h"
+#include "pipe/p_context.h"
 #include "pipe/p_screen.h"
 
 #include "draw_private.h"
@@ -37,6 +38,9 @@
 
 #include "tgsi/tgsi_parse.h"
 #include "tgsi/tgsi_scan.h"
+#include "gallivm/lp_bld_nir.h"
+#include "nir/nir_to_tgsi_info.h"
+#include "compiler/nir/nir.h"
 
 static void
 vs_llvm_prepare(struct draw_vertex_shader *shader,
@@ -75,7 +79,10 @@ vs_llvm_delete( struct draw_vertex_shader *dvs )
    }
 
    assert(shader->variants_cached == 0);
-   FREE((void*) dvs->state.tokens);
+   if (dvs->state.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(dvs->state.ir.nir);
+   else
+      FREE((void*) dvs->state.tokens);
    FREE( dvs );
 }
 
@@ -89,14 +96,30 @@ draw_create_vs_llvm(struct draw_context *draw,
    if (!vs)
       return NULL;
 
-   /* we make a private copy of the tokens */
-   vs->base.state.tokens = tgsi_dup_tokens(state->tokens);
-   if (!vs->base.state.tokens) {
-      FREE(vs);
-      return NULL;
+   vs->base.state.type = state->type;
+   if (state->type == PIPE_SHADER_IR_NIR) {
+      /* the caller keeps ownership of its shader, so work on a copy */
+      nir_shader *nir = nir_shader_clone(NULL, state->ir.nir);
+      if (!nir) {
+         FREE(vs);
+         return NULL;
+      }
+      lp_build_nir_prepare(nir);
+      nir_tgsi_scan_shader(nir, &vs->base.info,
+                           draw->pipe->screen->get_param(draw->pipe->screen,
+                                                         PIPE_CAP_TGSI_TEXCOORD));
+      vs->base.state.ir.nir = nir;
+   }
+   else {
+      /* we make a private copy of the tokens */
+      vs->base.state.tokens = tgsi_dup_tokens(state->tokens);
+      if (!vs->base.state.tokens) {
+         FREE(vs);
+         return NULL;
+      }
+
+      tgsi_scan_shader(state->tokens, &vs->base.info);
    }
-
-   tgsi_scan_shader(state->tokens, &vs->base.info);
 
    vs->variant_key_size = 
       draw_llvm_variant_key_size(
@@ -0,0 +1,179 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Helpers for LLVM coroutines.
+ */
+
+
+#include "lp_bld_coro.h"
+
+#if GALLIVM_HAVE_CORO
+
+#include "lp_bld_const.h"
+#include "lp_bld_intr.h"
+
+
+static LLVMTypeRef
+coro_ptr_type(struct gallivm_state *gallivm)
+{
+   return LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+}
+
+
+/**
+ * Start the coroutine the builder is in, which must return an i8 pointer.
+ *
+ * This must be called at the start of the function. It allocates the
+ * coroutine frame with malloc, and emits the blocks which suspend and clean
+ * up the coroutine into info.
+ *
+ * Returns the coroutine handle.
+ */
+LLVMValueRef
+lp_build_coro_begin(struct gallivm_state *gallivm,
+                    struct lp_build_coro_suspend_info *info)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef ptr_type = coro_ptr_type(gallivm);
+   LLVMTypeRef size_type = LLVMIntPtrTypeInContext(lc, gallivm->target);
+   LLVMBasicBlockRef block = LLVMGetInsertBlock(builder);
+   LLVMValueRef function = LLVMGetBasicBlockParent(block);
+   LLVMValueRef args[4];
+   LLVMValueRef coro_id, coro_size, coro_mem, coro_hdl;
+
+   args[0] = lp_build_const_int32(gallivm, 0);
+   args[1] = LLVMConstNull(ptr_type);
+   args[2] = args[1];
+   args[3] = args[1];
+   coro_id = lp_build_intrinsic(builder, "llvm.coro.id",
+                                LLVMTokenTypeInContext(lc), args, 4, 0);
+
+   coro_size = lp_build_intrinsic(builder, "llvm.coro.size.i32",
+                                  LLVMInt32TypeInContext(lc), NULL, 0, 0);
+   args[0] = LLVMBuildZExt(builder, coro_size, size_type, "");
+   coro_mem = lp_build_intrinsic(builder, "malloc", ptr_type, args, 1, 0);
+
+   args[0] = coro_id;
+   args[1] = coro_mem;
+   coro_hdl = lp_build_intrinsic(builder, "llvm.coro.begin", ptr_type,
+                                 args, 2, 0);
+
+   info->suspend = LLVMAppendBasicBlockInContext(lc, function, "coro_suspend");
+   info->cleanup = LLVMAppendBasicBlockInContext(lc, function, "coro_cleanup");
+
+   /* Destroyed: free the frame, if it wasn't elided */
+   LLVMPositionBuilderAtEnd(builder, info->cleanup);
+   args[0] = coro_id;
+   args[1] = coro_hdl;
+   coro_mem = lp_build_intrinsic(builder, "llvm.coro.free", ptr_type,
+                                 args, 2, 0);
+   lp_build_intrinsic(builder, "free", LLVMVoidTypeInContext(lc),
+                      &coro_mem, 1, 0);
+   LLVMBuildBr(builder, info->suspend);
+
+   /* Suspended: hand the handle back to whoever called or resumed us */
+   LLVMPositionBuilderAtEnd(builder, info->suspend);
+   args[0] = coro_hdl;
+   args[1] = LLVMConstInt(LLVMInt1TypeInContext(lc), 0, 0);
+   lp_build_intrinsic(builder, "llvm.coro.end", LLVMInt1TypeInContext(lc),
+                      args, 2, 0);
+   LLVMBuildRet(builder, coro_hdl);
+
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   return coro_hdl;
+}
+
+
+/**
+ * Suspend the coroutine.
+ *
+ * Execution continues in resume_block when the coroutine is resumed. The
+ * final suspension, at the end of the coroutine, has no resume block; after
+ * it the coroutine is done and can only be destroyed.
+ */
+void
+lp_build_coro_suspend_switch(struct gallivm_state *gallivm,
+                             const struct lp_build_coro_suspend_info *info,
+                             LLVMBasicBlockRef resume_block,
+                             boolean final_suspend)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef i8_type = LLVMInt8TypeInContext(lc);
+   LLVMValueRef args[2];
+   LLVMValueRef coro_suspend, suspend_switch;
+
+   assert(final_suspend == !resume_block);
+
+   args[0] = LLVMConstNull(LLVMTokenTypeInContext(lc));
+   args[1] = LLVMConstInt(LLVMInt1TypeInContext(lc), final_suspend, 0);
+   coro_suspend = lp_build_intrinsic(builder, "llvm.coro.suspend", i8_type,
+                                     args, 2, 0);
+
+   /* -1 is a suspension, 0 a resumption and 1 a destruction */
+   suspend_switch = LLVMBuildSwitch(builder, coro_suspend, info->suspend,
+                                    resume_block ? 2 : 1);
+   LLVMAddCase(suspend_switch, LLVMConstInt(i8_type, 1, 0), info->cleanup);
+   if (resume_block)
+      LLVMAddCase(suspend_switch, LLVMConstInt(i8_type, 0, 0), resume_block);
+}
+
+
+void
+lp_build_coro_resume(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   lp_build_intrinsic(gallivm->builder, "llvm.coro.resume",
+                      LLVMVoidTypeInContext(gallivm->context),
+                      &coro_hdl, 1, 0);
+}
+
+
+void
+lp_build_coro_destroy(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   lp_build_intrinsic(gallivm->builder, "llvm.coro.destroy",
+                      LLVMVoidTypeInContext(gallivm->context),
+                      &coro_hdl, 1, 0);
+}
+
+
+/**
+ * Return an i1 telling whether the coroutine reached its final suspension.
+ */
+LLVMValueRef
+lp_build_coro_done(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.done",
+                             LLVMInt1TypeInContext(gallivm->context),
+                             &coro_hdl, 1, 0);
+}
+
+#endif /* GALLIVM_HAVE_CORO */
@@ -0,0 +1,85 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Helpers for LLVM coroutines.
+ *
+ * A coroutine is a function which can suspend itself part way through,
+ * returning a handle its caller can later resume it with. Its locals which
+ * live across a suspension point are kept in a frame allocated at its
+ * start, which the coroutine frees itself once it's destroyed.
+ *
+ * Coroutines are lowered to ordinary functions by the coroutine passes
+ * gallivm_compile_module runs when GALLIVM_HAVE_CORO is set.
+ */
+
+
+#ifndef LP_BLD_CORO_H
+#define LP_BLD_CORO_H
+
+
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_init.h"
+
+
+#if GALLIVM_HAVE_CORO
+
+/**
+ * Blocks a coroutine branches to when it suspends or is destroyed, as
+ * created by lp_build_coro_begin.
+ */
+struct lp_build_coro_suspend_info
+{
+   LLVMBasicBlockRef suspend;  /**< returns the handle to the caller */
+   LLVMBasicBlockRef cleanup;  /**< frees the frame, then suspends */
+};
+
+
+LLVMValueRef
+lp_build_coro_begin(struct gallivm_state *gallivm,
+                    struct lp_build_coro_suspend_info *info);
+
+void
+lp_build_coro_suspend_switch(struct gallivm_state *gallivm,
+                             const struct lp_build_coro_suspend_info *info,
+                             LLVMBasicBlockRef resume_block,
+                             boolean final_suspend);
+
+void
+lp_build_coro_resume(struct gallivm_state *gallivm, LLVMValueRef coro_hdl);
+
+void
+lp_build_coro_destroy(struct gallivm_state *gallivm, LLVMValueRef coro_hdl);
+
+LLVMValueRef
+lp_build_coro_done(struct gallivm_state *gallivm, LLVMValueRef coro_hdl);
+
+#endif /* GALLIVM_HAVE_CORO */
+
+
+#endif /* LP_BLD_CORO_H */
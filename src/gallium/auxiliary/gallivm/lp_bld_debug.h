@@ -46,6 +46,7 @@
 #define GALLIVM_DEBUG_NO_QUAD_LOD   (1 << 7)
 #define GALLIVM_DEBUG_GC            (1 << 8)
 #define GALLIVM_DEBUG_DUMP_BC       (1 << 9)
+#define GALLIVM_DEBUG_CACHE_STATS   (1 << 10)
 
 
 #ifdef __cplusplus
@@ -42,12 +42,13 @@ lp_build_format_cache_type(struct gallivm_state *gallivm)
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_TAGS] =
          LLVMArrayType(LLVMInt64TypeInContext(gallivm->context),
                        LP_BUILD_FORMAT_CACHE_SIZE);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_NEXT_WAY] =
+         LLVMArrayType(LLVMInt32TypeInContext(gallivm->context),
+                       LP_BUILD_FORMAT_CACHE_SETS);
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL] =
          LLVMInt64TypeInContext(gallivm->context);
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS] =
          LLVMInt64TypeInContext(gallivm->context);
-#endif
 
    s = LLVMStructTypeInContext(gallivm->context, elem_types,
                                LP_BUILD_FORMAT_CACHE_MEMBER_COUNT, 0);
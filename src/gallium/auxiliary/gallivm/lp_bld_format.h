@@ -34,6 +34,8 @@
  * Pixel format helpers.
  */
 
+#include <string.h>
+
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_init.h"
 
@@ -44,41 +46,70 @@ struct lp_type;
 struct lp_build_context;
 
 
-#define LP_BUILD_FORMAT_CACHE_DEBUG 0
 /*
  * Block cache
  *
  * Optional block cache to be used when unpacking big pixel blocks.
- * Must be a power of 2
+ * It holds LP_BUILD_FORMAT_CACHE_SIZE decoded blocks, organized as sets of
+ * LP_BUILD_FORMAT_CACHE_WAYS blocks each, replaced round robin within a set.
+ * Both must be powers of 2, and can be overridden at build time.
  */
 
-#define LP_BUILD_FORMAT_CACHE_SIZE 128
+#ifndef LP_BUILD_FORMAT_CACHE_SIZE
+#define LP_BUILD_FORMAT_CACHE_SIZE 256
+#endif
+
+#ifndef LP_BUILD_FORMAT_CACHE_WAYS
+#define LP_BUILD_FORMAT_CACHE_WAYS 4
+#endif
+
+#define LP_BUILD_FORMAT_CACHE_SETS \
+   (LP_BUILD_FORMAT_CACHE_SIZE / LP_BUILD_FORMAT_CACHE_WAYS)
 
 /*
  * Note: cache_data needs 16 byte alignment.
+ *
+ * The tags are the addresses of the cached blocks, with the blocks of set s
+ * at [s * LP_BUILD_FORMAT_CACHE_WAYS, (s + 1) * LP_BUILD_FORMAT_CACHE_WAYS).
+ * cache_access_total / cache_access_miss count texels fetched, and block
+ * decodes, but only with GALLIVM_DEBUG=cache_stats.
  */
 struct lp_build_format_cache
 {
    PIPE_ALIGN_VAR(16) uint32_t cache_data[LP_BUILD_FORMAT_CACHE_SIZE][4][4];
    uint64_t cache_tags[LP_BUILD_FORMAT_CACHE_SIZE];
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   uint32_t cache_next_way[LP_BUILD_FORMAT_CACHE_SETS];
    uint64_t cache_access_total;
    uint64_t cache_access_miss;
-#endif
 };
 
 
 enum {
    LP_BUILD_FORMAT_CACHE_MEMBER_DATA = 0,
    LP_BUILD_FORMAT_CACHE_MEMBER_TAGS,
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   LP_BUILD_FORMAT_CACHE_MEMBER_NEXT_WAY,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS,
-#endif
    LP_BUILD_FORMAT_CACHE_MEMBER_COUNT
 };
 
 
+/**
+ * Forget all cached blocks, needed whenever the memory they were decoded
+ * from may have changed.  Doesn't touch the access counters.
+ */
+static inline void
+lp_build_format_cache_invalidate(struct lp_build_format_cache *cache)
+{
+   memset(cache->cache_tags, 0, sizeof cache->cache_tags);
+   memset(cache->cache_next_way, 0, sizeof cache->cache_next_way);
+}
+
+
+boolean
+lp_build_format_cache_supported(const struct util_format_description *format_desc);
+
+
 LLVMTypeRef
 lp_build_format_cache_type(struct gallivm_state *gallivm);
 
@@ -151,6 +182,15 @@ lp_build_fetch_rgba_soa(struct gallivm_state *gallivm,
                         LLVMValueRef cache,
                         LLVMValueRef rgba_out[4]);
 
+void
+lp_build_store_rgba_soa(struct gallivm_state *gallivm,
+                        const struct util_format_description *format_desc,
+                        struct lp_type type,
+                        LLVMValueRef exec_mask,
+                        LLVMValueRef base_ptr,
+                        LLVMValueRef offsets,
+                        const LLVMValueRef rgba_in[4]);
+
 /*
  * YUV
  */
@@ -31,6 +31,7 @@
 #include "lp_bld_const.h"
 #include "lp_bld_flow.h"
 #include "lp_bld_swizzle.h"
+#include "lp_bld_debug.h"
 
 #include "util/u_math.h"
 
@@ -44,14 +45,20 @@
  * The elements in the cache are the decoded blocks - currently things
  * are restricted to formats which are 4x4 block based, and the decoded
  * texels must fit into 4x8 bits.
- * The cache is direct mapped so hitrates aren't all that great and cache
- * thrashing could happen.
+ * The cache is set associative (see LP_BUILD_FORMAT_CACHE_WAYS), with round
+ * robin replacement within a set, so neighbouring blocks which happen to
+ * hash to the same set don't evict each other all the time.
+ * Any 4x4 block format whose texels fit 8 bit unorm can use it, see
+ * lp_build_format_cache_supported().
  *
  * @author Roland Scheidegger <sroland@vmware.com>
  */
 
 
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+/*
+ * Count accesses and misses, only with GALLIVM_DEBUG=cache_stats as it
+ * costs a load and store per fetch.
+ */
 static void
 update_cache_access(struct gallivm_state *gallivm,
                     LLVMValueRef ptr,
@@ -61,6 +68,9 @@ update_cache_access(struct gallivm_state *gallivm,
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef member_ptr, cache_access;
 
+   if (!(gallivm_debug & GALLIVM_DEBUG_CACHE_STATS))
+      return;
+
    assert(index == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL ||
           index == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
 
@@ -71,14 +81,13 @@ update_cache_access(struct gallivm_state *gallivm,
                                                                    count, 0), "");
    LLVMBuildStore(builder, cache_access, member_ptr);
 }
-#endif
 
 
 static void
 store_cached_block(struct gallivm_state *gallivm,
                    LLVMValueRef *col,
                    LLVMValueRef tag_value,
-                   LLVMValueRef hash_index,
+                   LLVMValueRef slot,
                    LLVMValueRef cache)
 {
    LLVMBuilderRef builder = gallivm->builder;
@@ -89,20 +98,18 @@ store_cached_block(struct gallivm_state *gallivm,
    type_ptr4x32 = LLVMPointerType(LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4), 0);
    indices[0] = lp_build_const_int32(gallivm, 0);
    indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   indices[2] = hash_index;
+   indices[2] = slot;
    ptr = LLVMBuildGEP(builder, cache, indices, ARRAY_SIZE(indices), "");
    LLVMBuildStore(builder, tag_value, ptr);
 
    indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_DATA);
-   hash_index = LLVMBuildMul(builder, hash_index,
-                             lp_build_const_int32(gallivm, 16), "");
+   slot = LLVMBuildMul(builder, slot, lp_build_const_int32(gallivm, 16), "");
    for (count = 0; count < 4; count++) {
-      indices[2] = hash_index;
+      indices[2] = slot;
       ptr = LLVMBuildGEP(builder, cache, indices, ARRAY_SIZE(indices), "");
       ptr = LLVMBuildBitCast(builder, ptr, type_ptr4x32, "");
       LLVMBuildStore(builder, col[count], ptr);
-      hash_index = LLVMBuildAdd(builder, hash_index,
-                                lp_build_const_int32(gallivm, 4), "");
+      slot = LLVMBuildAdd(builder, slot, lp_build_const_int32(gallivm, 4), "");
    }
 }
 
@@ -143,7 +150,7 @@ static void
 update_cached_block(struct gallivm_state *gallivm,
                     const struct util_format_description *format_desc,
                     LLVMValueRef ptr_addr,
-                    LLVMValueRef hash_index,
+                    LLVMValueRef slot,
                     LLVMValueRef cache)
 
 {
@@ -231,7 +238,104 @@ update_cached_block(struct gallivm_state *gallivm,
 
    tag_value = LLVMBuildPtrToInt(gallivm->builder, ptr_addr,
                                  LLVMInt64TypeInContext(gallivm->context), "");
-   store_cached_block(gallivm, col, tag_value, hash_index, cache);
+   store_cached_block(gallivm, col, tag_value, slot, cache);
+}
+
+
+/**
+ * Find the block at addr in its set, decoding it into the next way of the
+ * set if it isn't there.  Returns the index of the cache slot holding it.
+ */
+static LLVMValueRef
+lookup_cached_block(struct gallivm_state *gallivm,
+                    const struct util_format_description *format_desc,
+                    LLVMValueRef cache,
+                    LLVMValueRef addr,
+                    LLVMValueRef set)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMValueRef first, slot, slot_var, hit, indices[3];
+   struct lp_build_if_state if_ctx;
+   unsigned way;
+
+   first = LLVMBuildShl(builder, set,
+                        lp_build_const_int32(gallivm,
+                           util_logbase2(LP_BUILD_FORMAT_CACHE_WAYS)), "");
+
+   /* compare against all the tags of the set */
+   slot = first;
+   hit = LLVMConstInt(LLVMInt1TypeInContext(gallivm->context), 0, 0);
+   for (way = 0; way < LP_BUILD_FORMAT_CACHE_WAYS; way++) {
+      LLVMValueRef way_slot, tag, eq;
+
+      way_slot = LLVMBuildAdd(builder, first,
+                              lp_build_const_int32(gallivm, way), "");
+      tag = lookup_tag_data(gallivm, cache, way_slot);
+      eq = LLVMBuildICmp(builder, LLVMIntEQ, tag, addr, "");
+      slot = LLVMBuildSelect(builder, eq, way_slot, slot, "");
+      hit = LLVMBuildOr(builder, hit, eq, "");
+   }
+
+   slot_var = lp_build_alloca(gallivm, i32t, "cache_slot");
+   LLVMBuildStore(builder, slot, slot_var);
+
+   lp_build_if(&if_ctx, gallivm, LLVMBuildNot(builder, hit, ""));
+   {
+      LLVMValueRef next_way_ptr, victim, ptr_addr;
+
+      indices[0] = lp_build_const_int32(gallivm, 0);
+      indices[1] = lp_build_const_int32(gallivm,
+                                        LP_BUILD_FORMAT_CACHE_MEMBER_NEXT_WAY);
+      indices[2] = set;
+      next_way_ptr = LLVMBuildGEP(builder, cache, indices,
+                                  ARRAY_SIZE(indices), "");
+      victim = LLVMBuildLoad(builder, next_way_ptr, "victim");
+      slot = LLVMBuildAdd(builder, first, victim, "");
+
+      ptr_addr = LLVMBuildIntToPtr(builder, addr, LLVMPointerType(i8t, 0), "");
+      update_cached_block(gallivm, format_desc, ptr_addr, slot, cache);
+
+      victim = LLVMBuildAdd(builder, victim, lp_build_const_int32(gallivm, 1), "");
+      victim = LLVMBuildAnd(builder, victim,
+                            lp_build_const_int32(gallivm,
+                                                 LP_BUILD_FORMAT_CACHE_WAYS - 1), "");
+      LLVMBuildStore(builder, victim, next_way_ptr);
+      LLVMBuildStore(builder, slot, slot_var);
+
+      update_cache_access(gallivm, cache, 1,
+                          LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
+   }
+   lp_build_endif(&if_ctx);
+
+   return LLVMBuildLoad(builder, slot_var, "");
+}
+
+
+/**
+ * Whether the decoded blocks of a format can be kept in a
+ * lp_build_format_cache, that is whether it is made of 4x4 blocks whose
+ * texels fit 8 bit unorm (sRGB encoded for s3tc).
+ */
+boolean
+lp_build_format_cache_supported(const struct util_format_description *format_desc)
+{
+   if (format_desc->block.width != 4 || format_desc->block.height != 4 ||
+       !format_desc->fetch_rgba_8unorm) {
+      return FALSE;
+   }
+
+   switch (format_desc->layout) {
+   case UTIL_FORMAT_LAYOUT_S3TC:
+      return TRUE;
+   case UTIL_FORMAT_LAYOUT_RGTC:
+   case UTIL_FORMAT_LAYOUT_ETC:
+   case UTIL_FORMAT_LAYOUT_BPTC:
+      return util_format_fits_8unorm(format_desc);
+   default:
+      return FALSE;
+   }
 }
 
 
@@ -252,9 +356,9 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
 
 {
    LLVMBuilderRef builder = gallivm->builder;
-   unsigned count, low_bit, log2size;
-   LLVMValueRef color, offset_stored, addr, ptr_addrtrunc, tmp;
-   LLVMValueRef ij_index, hash_index, hash_mask, block_index;
+   unsigned count, low_bit, log2sets;
+   LLVMValueRef color, addr, ptr_addrtrunc, tmp;
+   LLVMValueRef ij_index, set_index, set_mask;
    LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
    LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
    LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
@@ -270,11 +374,11 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
    lp_build_context_init(&bld32, gallivm, type);
 
    /*
-    * compute hash - we use direct mapped cache, the hash function could
+    * compute hash - picks the set, the hash function could
     *                be better but it needs to be simple
     * per-element:
-    *    compare offset with offset stored at tag (hash)
-    *    if not equal decode/store block, update tag
+    *    compare offset with the offsets stored at the tags of the set
+    *    if none is equal decode/store block into the next way, update tag
     *    extract color from cache
     *    assemble result vector
     */
@@ -282,7 +386,7 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
    /* TODO: not ideal with 32bit pointers... */
 
    low_bit = util_logbase2(format_desc->block.bits / 8);
-   log2size = util_logbase2(LP_BUILD_FORMAT_CACHE_SIZE);
+   log2sets = util_logbase2(LP_BUILD_FORMAT_CACHE_SETS);
    addr = LLVMBuildPtrToInt(builder, base_ptr, i64t, "");
    ptr_addrtrunc = LLVMBuildPtrToInt(builder, base_ptr, i32t, "");
    ptr_addrtrunc = lp_build_broadcast_scalar(&bld32, ptr_addrtrunc);
@@ -291,84 +395,54 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
    ptr_addrtrunc = LLVMBuildAdd(builder, offset, ptr_addrtrunc, "");
    ptr_addrtrunc = LLVMBuildLShr(builder, ptr_addrtrunc,
                                  lp_build_const_int_vec(gallivm, type, low_bit), "");
-   /* This only really makes sense for size 64,128,256 */
-   hash_index = ptr_addrtrunc;
+   /* This only really makes sense for 16 to 256 sets */
+   set_index = ptr_addrtrunc;
    ptr_addrtrunc = LLVMBuildLShr(builder, ptr_addrtrunc,
-                                 lp_build_const_int_vec(gallivm, type, 2*log2size), "");
-   hash_index = LLVMBuildXor(builder, ptr_addrtrunc, hash_index, "");
-   tmp = LLVMBuildLShr(builder, hash_index,
-                       lp_build_const_int_vec(gallivm, type, log2size), "");
-   hash_index = LLVMBuildXor(builder, hash_index, tmp, "");
-
-   hash_mask = lp_build_const_int_vec(gallivm, type, LP_BUILD_FORMAT_CACHE_SIZE - 1);
-   hash_index = LLVMBuildAnd(builder, hash_index, hash_mask, "");
+                                 lp_build_const_int_vec(gallivm, type, 2*log2sets), "");
+   set_index = LLVMBuildXor(builder, ptr_addrtrunc, set_index, "");
+   tmp = LLVMBuildLShr(builder, set_index,
+                       lp_build_const_int_vec(gallivm, type, log2sets), "");
+   set_index = LLVMBuildXor(builder, set_index, tmp, "");
+
+   set_mask = lp_build_const_int_vec(gallivm, type, LP_BUILD_FORMAT_CACHE_SETS - 1);
+   set_index = LLVMBuildAnd(builder, set_index, set_mask, "");
    ij_index = LLVMBuildShl(builder, i, lp_build_const_int_vec(gallivm, type, 2), "");
    ij_index = LLVMBuildAdd(builder, ij_index, j, "");
-   block_index = LLVMBuildShl(builder, hash_index,
-                              lp_build_const_int_vec(gallivm, type, 4), "");
-   block_index = LLVMBuildAdd(builder, ij_index, block_index, "");
 
-   if (n > 1) {
-      color = LLVMGetUndef(LLVMVectorType(i32t, n));
-      for (count = 0; count < n; count++) {
-         LLVMValueRef index, cond, colorx;
-         LLVMValueRef block_indexx, hash_indexx, addrx, offsetx, ptr_addrx;
-         struct lp_build_if_state if_ctx;
+   color = n > 1 ? LLVMGetUndef(LLVMVectorType(i32t, n)) : NULL;
+   for (count = 0; count < n; count++) {
+      LLVMValueRef index, colorx, slot;
+      LLVMValueRef set_indexx, ij_indexx, addrx, offsetx;
 
+      if (n > 1) {
          index = lp_build_const_int32(gallivm, count);
          offsetx = LLVMBuildExtractElement(builder, offset, index, "");
-         addrx = LLVMBuildZExt(builder, offsetx, i64t, "");
-         addrx = LLVMBuildAdd(builder, addrx, addr, "");
-         block_indexx = LLVMBuildExtractElement(builder, block_index, index, "");
-         hash_indexx = LLVMBuildLShr(builder, block_indexx,
-                                     lp_build_const_int32(gallivm, 4), "");
-         offset_stored = lookup_tag_data(gallivm, cache, hash_indexx);
-         cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addrx, "");
-
-         lp_build_if(&if_ctx, gallivm, cond);
-         {
-            ptr_addrx = LLVMBuildIntToPtr(builder, addrx,
-                                          LLVMPointerType(i8t, 0), "");
-            update_cached_block(gallivm, format_desc, ptr_addrx, hash_indexx, cache);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-            update_cache_access(gallivm, cache, 1,
-                                LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
-#endif
-         }
-         lp_build_endif(&if_ctx);
-
-         colorx = lookup_cached_pixel(gallivm, cache, block_indexx);
-
-         color = LLVMBuildInsertElement(builder, color, colorx,
-                                        lp_build_const_int32(gallivm, count), "");
+         set_indexx = LLVMBuildExtractElement(builder, set_index, index, "");
+         ij_indexx = LLVMBuildExtractElement(builder, ij_index, index, "");
       }
-   }
-   else {
-      LLVMValueRef cond;
-      struct lp_build_if_state if_ctx;
-
-      tmp = LLVMBuildZExt(builder, offset, i64t, "");
-      addr = LLVMBuildAdd(builder, tmp, addr, "");
-      offset_stored = lookup_tag_data(gallivm, cache, hash_index);
-      cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addr, "");
-
-      lp_build_if(&if_ctx, gallivm, cond);
-      {
-         tmp = LLVMBuildIntToPtr(builder, addr, LLVMPointerType(i8t, 0), "");
-         update_cached_block(gallivm, format_desc, tmp, hash_index, cache);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-         update_cache_access(gallivm, cache, 1,
-                             LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
-#endif
+      else {
+         index = NULL;
+         offsetx = offset;
+         set_indexx = set_index;
+         ij_indexx = ij_index;
       }
-      lp_build_endif(&if_ctx);
+      addrx = LLVMBuildZExt(builder, offsetx, i64t, "");
+      addrx = LLVMBuildAdd(builder, addrx, addr, "");
+
+      slot = lookup_cached_block(gallivm, format_desc, cache, addrx, set_indexx);
 
-      color = lookup_cached_pixel(gallivm, cache, block_index);
+      slot = LLVMBuildShl(builder, slot, lp_build_const_int32(gallivm, 4), "");
+      slot = LLVMBuildAdd(builder, slot, ij_indexx, "");
+      colorx = lookup_cached_pixel(gallivm, cache, slot);
+
+      if (n > 1)
+         color = LLVMBuildInsertElement(builder, color, colorx, index, "");
+      else
+         color = colorx;
    }
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+
    update_cache_access(gallivm, cache, n,
                        LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL);
-#endif
+
    return LLVMBuildBitCast(builder, color, LLVMVectorType(i8t, n * 4), "");
 }
-
@@ -41,6 +41,8 @@
 #include "lp_bld_debug.h"
 #include "lp_bld_format.h"
 #include "lp_bld_arit.h"
+#include "lp_bld_bitarit.h"
+#include "lp_bld_flow.h"
 #include "lp_bld_pack.h"
 
 
@@ -858,3 +860,213 @@ lp_build_fetch_rgba_soa(struct gallivm_state *gallivm,
       convert_to_soa(gallivm, aos_fetch, rgba_out, type);
    }
 }
+
+
+/**
+ * Pack one channel of SoA texels into the low bits of 32 bit integers.
+ */
+static LLVMValueRef
+pack_channel_soa(struct gallivm_state *gallivm,
+                 const struct util_format_channel_description *chan_desc,
+                 struct lp_type type,
+                 LLVMValueRef value)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type float_type = lp_type_float_vec(32, 32 * type.length);
+   struct lp_type int_type = lp_type_int_vec(32, 32 * type.length);
+   struct lp_type uint_type = lp_type_uint_vec(32, 32 * type.length);
+   struct lp_build_context float_bld, int_bld, uint_bld;
+   unsigned width = chan_desc->size;
+   LLVMValueRef mask;
+
+   assert(type.width == 32);
+   assert(width <= 32);
+
+   lp_build_context_init(&float_bld, gallivm, float_type);
+   lp_build_context_init(&int_bld, gallivm, int_type);
+   lp_build_context_init(&uint_bld, gallivm, uint_type);
+
+   mask = lp_build_const_int_vec(gallivm, int_type,
+                                 width == 32 ? ~0 : (1 << width) - 1);
+
+   switch (chan_desc->type) {
+   case UTIL_FORMAT_TYPE_FLOAT:
+      value = LLVMBuildBitCast(builder, value, float_bld.vec_type, "");
+      if (width == 16) {
+         value = lp_build_float_to_half(gallivm, value);
+         return LLVMBuildZExt(builder, value, int_bld.vec_type, "");
+      }
+      assert(width == 32);
+      return LLVMBuildBitCast(builder, value, int_bld.vec_type, "");
+
+   case UTIL_FORMAT_TYPE_UNSIGNED:
+      if (chan_desc->pure_integer) {
+         value = LLVMBuildBitCast(builder, value, uint_bld.vec_type, "");
+         if (width < 32) {
+            value = lp_build_min(&uint_bld, value, mask);
+         }
+         return LLVMBuildBitCast(builder, value, int_bld.vec_type, "");
+      }
+      value = LLVMBuildBitCast(builder, value, float_bld.vec_type, "");
+      if (chan_desc->normalized) {
+         value = lp_build_clamp_zero_one_nanzero(&float_bld, value);
+         return lp_build_clamped_float_to_unsigned_norm(gallivm, float_type,
+                                                        width, value);
+      }
+      value = LLVMBuildFPToUI(builder, value, int_bld.vec_type, "");
+      return LLVMBuildAnd(builder, value, mask, "");
+
+   case UTIL_FORMAT_TYPE_SIGNED:
+      if (chan_desc->pure_integer) {
+         value = LLVMBuildBitCast(builder, value, int_bld.vec_type, "");
+         if (width < 32) {
+            value = lp_build_clamp(&int_bld, value,
+                                   lp_build_const_int_vec(gallivm, int_type,
+                                                          -(1 << (width - 1))),
+                                   lp_build_const_int_vec(gallivm, int_type,
+                                                          (1 << (width - 1)) - 1));
+         }
+      }
+      else {
+         value = LLVMBuildBitCast(builder, value, float_bld.vec_type, "");
+         if (chan_desc->normalized) {
+            value = lp_build_clamp(&float_bld, value,
+                                   lp_build_const_vec(gallivm, float_type, -1.0),
+                                   float_bld.one);
+            value = lp_build_mul(&float_bld, value,
+                                 lp_build_const_vec(gallivm, float_type,
+                                                    (double)((1u << (width - 1)) - 1)));
+            value = lp_build_iround(&float_bld, value);
+         }
+         else {
+            value = LLVMBuildFPToSI(builder, value, int_bld.vec_type, "");
+         }
+      }
+      return LLVMBuildAnd(builder, value, mask, "");
+
+   default:
+      assert(0);
+      return int_bld.zero;
+   }
+}
+
+
+/**
+ * Pack SoA texels and store them to memory.
+ *
+ * This is the counterpart of lp_build_fetch_rgba_soa(), for the formats
+ * which may be bound as images: plain formats with one pixel per block,
+ * at most 32 bits per channel, and R11G11B10_FLOAT.
+ *
+ * \param type       type of the rgba_in vectors, which hold the bits of int,
+ *                   uint or float values according to the format channels
+ * \param exec_mask  lanes to store, lanes which are zero are not written
+ * \param offsets    byte offsets of the texels from base_ptr
+ */
+void
+lp_build_store_rgba_soa(struct gallivm_state *gallivm,
+                        const struct util_format_description *format_desc,
+                        struct lp_type type,
+                        LLVMValueRef exec_mask,
+                        LLVMValueRef base_ptr,
+                        LLVMValueRef offsets,
+                        const LLVMValueRef rgba_in[4])
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type int_type = lp_type_int_vec(32, 32 * type.length);
+   struct lp_build_context int_bld;
+   LLVMValueRef packed[4];
+   LLVMTypeRef store_type, store_ptr_type;
+   LLVMValueRef dummy_ptr;
+   unsigned num_words, store_width;
+   unsigned chan, w, k;
+
+   assert(format_desc->block.width == 1);
+   assert(format_desc->block.height == 1);
+   assert(format_desc->block.bits <= 128);
+
+   lp_build_context_init(&int_bld, gallivm, int_type);
+
+   store_width = MIN2(format_desc->block.bits, 32);
+   num_words = MAX2(format_desc->block.bits / 32, 1);
+   for (w = 0; w < num_words; w++) {
+      packed[w] = int_bld.zero;
+   }
+
+   if (format_desc->format == PIPE_FORMAT_R11G11B10_FLOAT) {
+      struct lp_type float_type = lp_type_float_vec(32, 32 * type.length);
+      LLVMValueRef rgb[3];
+
+      for (chan = 0; chan < 3; chan++) {
+         rgb[chan] = LLVMBuildBitCast(builder, rgba_in[chan],
+                                      lp_build_vec_type(gallivm, float_type),
+                                      "");
+      }
+      packed[0] = lp_build_float_to_r11g11b10(gallivm, rgb);
+   }
+   else {
+      assert(format_desc->layout == UTIL_FORMAT_LAYOUT_PLAIN);
+
+      for (chan = 0; chan < format_desc->nr_channels; chan++) {
+         const struct util_format_channel_description *chan_desc =
+            &format_desc->channel[chan];
+         LLVMValueRef value;
+
+         if (chan_desc->type == UTIL_FORMAT_TYPE_VOID) {
+            continue;
+         }
+
+         /* find the rgba component which lands in this channel */
+         for (k = 0; k < 4; k++) {
+            if (format_desc->swizzle[k] == chan) {
+               break;
+            }
+         }
+         if (k == 4) {
+            continue;
+         }
+
+         value = pack_channel_soa(gallivm, chan_desc, type, rgba_in[k]);
+         if (chan_desc->shift % 32) {
+            value = lp_build_shl_imm(&int_bld, value, chan_desc->shift % 32);
+         }
+         w = chan_desc->shift / 32;
+         packed[w] = LLVMBuildOr(builder, packed[w], value, "");
+      }
+   }
+
+   /*
+    * Texels may be anywhere, so store them one by one. Inactive lanes write
+    * to a private dummy location rather than branching around the store.
+    */
+   store_type = LLVMIntTypeInContext(gallivm->context, store_width);
+   store_ptr_type = LLVMPointerType(store_type, 0);
+   dummy_ptr = lp_build_alloca_undef(gallivm,
+                                     LLVMArrayType(store_type, num_words), "");
+   dummy_ptr = LLVMBuildBitCast(builder, dummy_ptr, store_ptr_type, "");
+
+   for (k = 0; k < type.length; k++) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, k);
+      LLVMValueRef offset = LLVMBuildExtractElement(builder, offsets, idx, "");
+      LLVMValueRef active = LLVMBuildExtractElement(builder, exec_mask, idx, "");
+      LLVMValueRef ptr;
+
+      active = LLVMBuildICmp(builder, LLVMIntNE, active,
+                             LLVMConstNull(LLVMTypeOf(active)), "");
+      ptr = LLVMBuildGEP(builder, base_ptr, &offset, 1, "");
+      ptr = LLVMBuildBitCast(builder, ptr, store_ptr_type, "");
+      ptr = LLVMBuildSelect(builder, active, ptr, dummy_ptr, "");
+
+      for (w = 0; w < num_words; w++) {
+         LLVMValueRef word_idx = lp_build_const_int32(gallivm, w);
+         LLVMValueRef value = LLVMBuildExtractElement(builder, packed[w],
+                                                      idx, "");
+
+         if (store_width < 32) {
+            value = LLVMBuildTrunc(builder, value, store_type, "");
+         }
+         LLVMBuildStore(builder, value,
+                        LLVMBuildGEP(builder, ptr, &word_idx, 1, ""));
+      }
+   }
+}
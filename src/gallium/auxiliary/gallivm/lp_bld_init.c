@@ -43,6 +43,9 @@
 #if HAVE_LLVM >= 0x0700
 #include <llvm-c/Transforms/Utils.h>
 #endif
+#if GALLIVM_HAVE_CORO
+#include <llvm-c/Transforms/Coroutines.h>
+#endif
 #include <llvm-c/BitWriter.h>
 
 
@@ -74,6 +77,7 @@ static const struct debug_named_value lp_bld_debug_flags[] = {
    { "no_quad_lod", GALLIVM_DEBUG_NO_QUAD_LOD, NULL },
    { "gc",     GALLIVM_DEBUG_GC, NULL },
    { "dumpbc", GALLIVM_DEBUG_DUMP_BC, NULL },
+   { "cache_stats", GALLIVM_DEBUG_CACHE_STATS, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -117,6 +121,16 @@ create_pass_manager(struct gallivm_state *gallivm)
    gallivm->passmgr = LLVMCreateFunctionPassManagerForModule(gallivm->module);
    if (!gallivm->passmgr)
       return FALSE;
+
+#if GALLIVM_HAVE_CORO
+   /* Coroutines must be split, across functions, before anything else */
+   gallivm->cgpassmgr = LLVMCreatePassManager();
+   if (!gallivm->cgpassmgr)
+      return FALSE;
+   LLVMAddCoroEarlyPass(gallivm->cgpassmgr);
+   LLVMAddCoroSplitPass(gallivm->cgpassmgr);
+   LLVMAddCoroElidePass(gallivm->cgpassmgr);
+#endif
    /*
     * TODO: some per module pass manager with IPO passes might be helpful -
     * the generated texture functions may benefit from inlining if they are
@@ -136,7 +150,7 @@ create_pass_manager(struct gallivm_state *gallivm)
       free(td_str);
    }
 
-   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0) {
+   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0 && !gallivm->no_opt) {
       /*
        * TODO: Evaluate passes some more - keeping in mind
        * both quality of generated code and compile times.
@@ -169,6 +183,9 @@ create_pass_manager(struct gallivm_state *gallivm)
        */
       LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
    }
+#if GALLIVM_HAVE_CORO
+   LLVMAddCoroCleanupPass(gallivm->passmgr);
+#endif
 
    return TRUE;
 }
@@ -185,6 +202,10 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposePassManager(gallivm->passmgr);
    }
 
+   if (gallivm->cgpassmgr) {
+      LLVMDisposePassManager(gallivm->cgpassmgr);
+   }
+
    if (gallivm->engine) {
       /* This will already destroy any associated module */
       LLVMDisposeExecutionEngine(gallivm->engine);
@@ -192,6 +213,12 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   if (gallivm->cache) {
+      /* Must outlive the engine, which may still notify it */
+      lp_free_objcache(gallivm->cache->jit_obj_cache);
+      gallivm->cache->jit_obj_cache = NULL;
+   }
+
    FREE(gallivm->module_name);
 
    if (!use_mcjit) {
@@ -212,8 +239,10 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->module = NULL;
    gallivm->module_name = NULL;
    gallivm->passmgr = NULL;
+   gallivm->cgpassmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
+   gallivm->cache = NULL;
 }
 
 
@@ -240,7 +269,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+      if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) || gallivm->no_opt) {
          optlevel = None;
       }
       else {
@@ -249,6 +278,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
 
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
                                                     &gallivm->code,
+                                                    gallivm->cache,
                                                     gallivm->module,
                                                     gallivm->memorymgr,
                                                     (unsigned) optlevel,
@@ -301,7 +331,7 @@ fail:
  */
 static boolean
 init_gallivm_state(struct gallivm_state *gallivm, const char *name,
-                   LLVMContextRef context)
+                   LLVMContextRef context, struct lp_cached_code *cache)
 {
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -310,6 +340,7 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
       return FALSE;
 
    gallivm->context = context;
+   gallivm->cache = cache;
 
    if (!gallivm->context)
       goto fail;
@@ -509,15 +540,47 @@ lp_build_init(void)
 
 /**
  * Create a new gallivm_state object.
+ *
+ * If cache is not NULL and holds object code, that code is used instead of
+ * optimizing and compiling the module, which must otherwise be built as
+ * usual.  If it is empty, it will receive the object code of the module
+ * once compiled (unless cache->dont_cache gets set while building it).
+ */
+struct gallivm_state *
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache)
+{
+   struct gallivm_state *gallivm;
+
+   gallivm = CALLOC_STRUCT(gallivm_state);
+   if (gallivm) {
+      if (!init_gallivm_state(gallivm, name, context, cache)) {
+         FREE(gallivm);
+         gallivm = NULL;
+      }
+   }
+
+   return gallivm;
+}
+
+
+/**
+ * Create a new gallivm_state object whose module gets compiled without any
+ * optimization passes and at the lowest codegen level.
+ *
+ * The resulting code is slow, but it is available much sooner, which makes
+ * this suitable for stand-in code while a properly optimized version is
+ * being compiled elsewhere.
  */
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context)
+gallivm_create_unoptimized(const char *name, LLVMContextRef context)
 {
    struct gallivm_state *gallivm;
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
-      if (!init_gallivm_state(gallivm, name, context)) {
+      gallivm->no_opt = TRUE;
+      if (!init_gallivm_state(gallivm, name, context, NULL)) {
          FREE(gallivm);
          gallivm = NULL;
       }
@@ -573,6 +636,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 {
    LLVMValueRef func;
    int64_t time_begin = 0;
+   boolean skip_opt;
 
    assert(!gallivm->compiled);
 
@@ -600,10 +664,13 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
-   /* Run optimization passes */
+   /* Run optimization passes, unless the object code is already cached */
+   skip_opt = gallivm->cache && gallivm->cache->data_size;
+   if (gallivm->cgpassmgr && !skip_opt)
+      LLVMRunPassManager(gallivm->cgpassmgr, gallivm->module);
    LLVMInitializeFunctionPassManager(gallivm->passmgr);
    func = LLVMGetFirstFunction(gallivm->module);
-   while (func) {
+   while (func && !skip_opt) {
       if (0) {
          debug_printf("optimizing func %s...\n", LLVMGetValueName(func));
       }
@@ -626,8 +693,9 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       int64_t time_end = os_time_get();
       int time_msec = (int)((time_end - time_begin) / 1000);
       assert(gallivm->module_name);
-      debug_printf("optimizing module %s took %d msec\n",
-                   gallivm->module_name, time_msec);
+      debug_printf("optimizing module %s took %d msec%s\n",
+                   gallivm->module_name, time_msec,
+                   skip_opt ? " (cached)" : "");
    }
 
    if (use_mcjit) {
@@ -39,6 +39,25 @@
 extern "C" {
 #endif
 
+/** Whether LLVM can split coroutines (the llvm.coro.* intrinsics) */
+#define GALLIVM_HAVE_CORO (HAVE_LLVM >= 0x0800)
+
+/**
+ * Machine code of a module, as produced by (or to be fed back into) the JIT.
+ *
+ * This allows callers to persist the object code of a module, e.g. in a disk
+ * cache, and skip the optimization and code generation passes next time the
+ * same module is built.
+ */
+struct lp_cached_code
+{
+   void *data;
+   size_t data_size;
+   /* Set when the IR embeds process specific addresses */
+   boolean dont_cache;
+   void *jit_obj_cache;
+};
+
 struct gallivm_state
 {
    char *module_name;
@@ -46,11 +65,14 @@ struct gallivm_state
    LLVMExecutionEngineRef engine;
    LLVMTargetDataRef target;
    LLVMPassManagerRef passmgr;
+   LLVMPassManagerRef cgpassmgr;  /**< module passes, for coroutines */
    LLVMContextRef context;
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;
    unsigned compiled;
+   boolean no_opt;  /**< skip IR optimizations, fastest codegen */
 };
 
 
@@ -59,7 +81,11 @@ lp_build_init(void);
 
 
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context);
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache);
+
+struct gallivm_state *
+gallivm_create_unoptimized(const char *name, LLVMContextRef context);
 
 void
 gallivm_destroy(struct gallivm_state *gallivm);
@@ -65,6 +65,7 @@
 #include <llvm/ExecutionEngine/JITMemoryManager.h>
 #else
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #endif
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Host.h>
@@ -97,6 +98,7 @@
 
 #include "lp_bld_misc.h"
 #include "lp_bld_debug.h"
+#include "lp_bld_init.h"
 
 namespace {
 
@@ -473,6 +475,44 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
 };
 
 
+#if HAVE_LLVM >= 0x0306
+/*
+ * Hands the object code MC-JIT produces for a module over to the caller's
+ * lp_cached_code, and feeds it back in place of code generation when the
+ * caller already has it (e.g. from a disk cache).
+ * There is one cache per engine, hence one module, so the module identifier
+ * needs not be part of the key.
+ */
+class LPObjectCache : public llvm::ObjectCache {
+
+   struct lp_cached_code *cache;
+
+   public:
+      LPObjectCache(struct lp_cached_code *cache_out) {
+         cache = cache_out;
+      }
+
+      virtual void notifyObjectCompiled(const llvm::Module *M,
+                                        llvm::MemoryBufferRef Obj) {
+         assert(!cache->data);
+         cache->data_size = Obj.getBufferSize();
+         cache->data = malloc(cache->data_size);
+         if (cache->data)
+            memcpy(cache->data, Obj.getBufferStart(), cache->data_size);
+         else
+            cache->data_size = 0;
+      }
+
+      virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *M) {
+         if (!cache->data_size)
+            return NULL;
+         return llvm::MemoryBuffer::getMemBufferCopy(
+               llvm::StringRef((const char *)cache->data, cache->data_size));
+      }
+};
+#endif
+
+
 /**
  * Same as LLVMCreateJITCompilerForModule, but:
  * - allows using MCJIT and enabling AVX feature where available.
@@ -487,6 +527,7 @@ extern "C"
 LLVMBool
 lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         lp_generated_code **OutCode,
+                                        struct lp_cached_code *cache_out,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef CMM,
                                         unsigned OptLevel,
@@ -739,6 +780,13 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    JIT->RegisterJITEventListener(JEL);
 #endif
    if (JIT) {
+#if HAVE_LLVM >= 0x0306
+      if (cache_out && useMCJIT) {
+         LPObjectCache *objcache = new LPObjectCache(cache_out);
+         JIT->setObjectCache(objcache);
+         cache_out->jit_obj_cache = (void *)objcache;
+      }
+#endif
       *OutJIT = wrap(JIT);
       return 0;
    }
@@ -777,6 +825,45 @@ lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr)
    delete reinterpret_cast<BaseMemoryManager*>(memorymgr);
 }
 
+extern "C"
+void
+lp_free_objcache(void *objcache_ptr)
+{
+#if HAVE_LLVM >= 0x0306
+   LPObjectCache *objcache = (LPObjectCache *)objcache_ptr;
+   delete objcache;
+#else
+   assert(!objcache_ptr);
+#endif
+}
+
+/**
+ * Describe the host CPU the way the JIT sees it (name and features), so
+ * that generated code can be keyed on it.  Caller must free() the result.
+ */
+extern "C" char *
+lp_build_host_cpu_string(void)
+{
+   std::string str;
+
+#if HAVE_LLVM >= 0x0305
+   str = llvm::sys::getHostCPUName().str();
+#endif
+
+#if HAVE_LLVM >= 0x0400 && (defined(PIPE_ARCH_X86) || defined(PIPE_ARCH_X86_64))
+   llvm::StringMap<bool> features;
+   llvm::sys::getHostCPUFeatures(features);
+
+   for (llvm::StringMapIterator<bool> f = features.begin();
+        f != features.end();
+        ++f) {
+      str += ((*f).second ? ",+" : ",-") + (*f).first().str();
+   }
+#endif
+
+   return strdup(str.c_str());
+}
+
 extern "C" LLVMValueRef
 lp_get_called_value(LLVMValueRef call)
 {
@@ -41,6 +41,7 @@ extern "C" {
 
 
 struct lp_generated_code;
+struct lp_cached_code;
 
 extern LLVMTargetLibraryInfoRef
 gallivm_create_target_library_info(const char *triple);
@@ -55,6 +56,7 @@ lp_set_target_options(void);
 extern int
 lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         struct lp_generated_code **OutCode,
+                                        struct lp_cached_code *cache_out,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef MM,
                                         unsigned OptLevel,
@@ -67,6 +69,12 @@ lp_free_generated_code(struct lp_generated_code *code);
 extern LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager();
 
+extern void
+lp_free_objcache(void *objcache);
+
+extern char *
+lp_build_host_cpu_string(void);
+
 extern void
 lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr);
 
@@ -0,0 +1,2605 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * NIR to LLVM IR translation -- SoA.
+ *
+ * Every NIR value is a vector with one element per shader invocation, just
+ * like TGSI registers in lp_bld_tgsi_soa.c. Control flow is not translated
+ * into branches but into execution masks, with the same lp_exec_mask
+ * machinery the TGSI translator uses. For that reason the shader is taken
+ * out of SSA form first (see lp_build_nir_prepare()): values flowing through
+ * phis live in registers (allocas) which are only written for active lanes,
+ * while all other SSA values are plain LLVM values.
+ */
+
+#include "pipe/p_shader_tokens.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "compiler/nir/nir.h"
+#include "compiler/nir/nir_builder.h"
+#include "lp_bld_nir.h"
+#include "lp_bld_type.h"
+#include "lp_bld_const.h"
+#include "lp_bld_arit.h"
+#include "lp_bld_bitarit.h"
+#include "lp_bld_conv.h"
+#include "lp_bld_init.h"
+#include "lp_bld_intr.h"
+#include "lp_bld_logic.h"
+#include "lp_bld_swizzle.h"
+#include "lp_bld_flow.h"
+#include "lp_bld_quad.h"
+#include "lp_bld_debug.h"
+#include "lp_bld_sample.h"
+#include "lp_bld_struct.h"
+
+
+struct lp_build_nir_soa_context
+{
+   /*
+    * Only the build contexts of this are used by the translator itself, the
+    * whole struct is what gets handed to the gs and cs interface callbacks.
+    */
+   struct lp_build_tgsi_context bld_base;
+
+   nir_shader *shader;
+
+   struct lp_build_mask_context *mask;
+   struct lp_exec_mask exec_mask;
+
+   LLVMValueRef consts_ptr;
+   LLVMValueRef const_sizes_ptr;
+   LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
+   LLVMValueRef consts_sizes[LP_MAX_TGSI_CONST_BUFFERS];
+   unsigned num_const_buffers;
+
+   const LLVMValueRef (*inputs)[TGSI_NUM_CHANNELS];
+   LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS];
+
+   LLVMValueRef context_ptr;
+   LLVMValueRef thread_data_ptr;
+
+   const struct lp_build_sampler_soa *sampler;
+
+   struct lp_bld_tgsi_system_values system_values;
+
+   const struct lp_build_tgsi_gs_iface *gs_iface;
+   LLVMValueRef emitted_prims_vec_ptr;
+   LLVMValueRef total_emitted_vertices_vec_ptr;
+   LLVMValueRef emitted_vertices_vec_ptr;
+   LLVMValueRef max_output_vertices_vec;
+
+   const struct lp_build_tgsi_cs_iface *cs_iface;
+
+   /** SSA values, indexed by nir_ssa_def::index */
+   LLVMValueRef (*ssa_defs)[NIR_MAX_VEC_COMPONENTS];
+
+   /** register storage (arrays of vectors), indexed by nir_register::index */
+   LLVMValueRef *regs;
+};
+
+
+/*
+ * Type helpers.
+ */
+
+static struct lp_build_context *
+get_flt_bld(struct lp_build_nir_soa_context *bld,
+            unsigned bit_size)
+{
+   return bit_size == 64 ? &bld->bld_base.dbl_bld : &bld->bld_base.base;
+}
+
+
+static struct lp_build_context *
+get_int_bld(struct lp_build_nir_soa_context *bld,
+            boolean is_unsigned,
+            unsigned bit_size)
+{
+   if (bit_size == 64)
+      return is_unsigned ? &bld->bld_base.uint64_bld : &bld->bld_base.int64_bld;
+   return is_unsigned ? &bld->bld_base.uint_bld : &bld->bld_base.int_bld;
+}
+
+
+static struct lp_build_context *
+get_alu_type_bld(struct lp_build_nir_soa_context *bld,
+                 nir_alu_type type,
+                 unsigned bit_size)
+{
+   switch (nir_alu_type_get_base_type(type)) {
+   case nir_type_float:
+      return get_flt_bld(bld, bit_size);
+   case nir_type_int:
+      return get_int_bld(bld, FALSE, bit_size);
+   case nir_type_uint:
+   case nir_type_bool:
+   default:
+      return get_int_bld(bld, TRUE, bit_size);
+   }
+}
+
+
+static LLVMValueRef
+cast_type(struct lp_build_nir_soa_context *bld,
+          LLVMValueRef val,
+          nir_alu_type type,
+          unsigned bit_size)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   struct lp_build_context *type_bld = get_alu_type_bld(bld, type, bit_size);
+
+   return LLVMBuildBitCast(builder, val, type_bld->vec_type, "");
+}
+
+
+/**
+ * Combine two vectors of 32 bit values into one vector of 64 bit values,
+ * (lo, hi) pairs make up the individual 64 bit elements.
+ */
+static LLVMValueRef
+merge_64bit(struct lp_build_nir_soa_context *bld,
+            LLVMValueRef lo,
+            LLVMValueRef hi)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   unsigned length = bld->bld_base.base.type.length;
+   LLVMValueRef shuffles[2 * LP_MAX_VECTOR_WIDTH / 32];
+   LLVMValueRef res;
+   unsigned i;
+
+   assert(length <= LP_MAX_VECTOR_WIDTH / 32);
+
+   for (i = 0; i < length; i++) {
+      shuffles[2 * i] = lp_build_const_int32(gallivm, i);
+      shuffles[2 * i + 1] = lp_build_const_int32(gallivm, i + length);
+   }
+   lo = LLVMBuildBitCast(builder, lo, bld->bld_base.uint_bld.vec_type, "");
+   hi = LLVMBuildBitCast(builder, hi, bld->bld_base.uint_bld.vec_type, "");
+   res = LLVMBuildShuffleVector(builder, lo, hi,
+                                LLVMConstVector(shuffles, 2 * length), "");
+   return LLVMBuildBitCast(builder, res, bld->bld_base.uint64_bld.vec_type, "");
+}
+
+
+static void
+split_64bit(struct lp_build_nir_soa_context *bld,
+            LLVMValueRef val,
+            LLVMValueRef *lo,
+            LLVMValueRef *hi)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   unsigned length = bld->bld_base.base.type.length;
+   LLVMValueRef shuffles_lo[LP_MAX_VECTOR_WIDTH / 32];
+   LLVMValueRef shuffles_hi[LP_MAX_VECTOR_WIDTH / 32];
+   LLVMTypeRef dword_vec_type =
+      LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 2 * length);
+   unsigned i;
+
+   for (i = 0; i < length; i++) {
+      shuffles_lo[i] = lp_build_const_int32(gallivm, 2 * i);
+      shuffles_hi[i] = lp_build_const_int32(gallivm, 2 * i + 1);
+   }
+   val = LLVMBuildBitCast(builder, val, dword_vec_type, "");
+   *lo = LLVMBuildShuffleVector(builder, val, LLVMGetUndef(dword_vec_type),
+                                LLVMConstVector(shuffles_lo, length), "");
+   *hi = LLVMBuildShuffleVector(builder, val, LLVMGetUndef(dword_vec_type),
+                                LLVMConstVector(shuffles_hi, length), "");
+}
+
+
+/**
+ * The current execution mask, including killed fragments.
+ */
+static LLVMValueRef
+mask_vec(struct lp_build_nir_soa_context *bld)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   struct lp_exec_mask *exec_mask = &bld->exec_mask;
+   LLVMValueRef mask = bld->mask ? lp_build_mask_value(bld->mask) :
+      LLVMConstAllOnes(bld->bld_base.int_bld.vec_type);
+
+   if (!exec_mask->has_mask) {
+      return mask;
+   }
+   return LLVMBuildAnd(builder, mask, exec_mask->exec_mask, "");
+}
+
+
+/*
+ * Registers.
+ */
+
+static LLVMValueRef
+reg_chan_ptr(struct lp_build_nir_soa_context *bld,
+             const nir_register *reg,
+             unsigned index)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMValueRef indices[2];
+
+   indices[0] = lp_build_const_int32(gallivm, 0);
+   indices[1] = lp_build_const_int32(gallivm, index);
+   return LLVMBuildGEP(gallivm->builder, bld->regs[reg->index],
+                       indices, 2, "");
+}
+
+
+/**
+ * Per lane element index into a register array, for indirect access.
+ * Out of bounds indices are clamped to the last element.
+ */
+static LLVMValueRef
+reg_indirect_index(struct lp_build_nir_soa_context *bld,
+                   const nir_register *reg,
+                   unsigned base_offset,
+                   LLVMValueRef indirect,
+                   unsigned chan)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   unsigned num_elems = MAX2(reg->num_array_elems, 1);
+   LLVMValueRef index;
+
+   index = LLVMBuildBitCast(gallivm->builder, indirect, uint_bld->vec_type, "");
+   index = lp_build_add(uint_bld, index,
+                        lp_build_const_int_vec(gallivm, uint_bld->type,
+                                               base_offset));
+   index = lp_build_min(uint_bld, index,
+                        lp_build_const_int_vec(gallivm, uint_bld->type,
+                                               num_elems - 1));
+   index = lp_build_mul(uint_bld, index,
+                        lp_build_const_int_vec(gallivm, uint_bld->type,
+                                               reg->num_components));
+   return lp_build_add(uint_bld, index,
+                       lp_build_const_int_vec(gallivm, uint_bld->type, chan));
+}
+
+
+static LLVMValueRef
+get_src(struct lp_build_nir_soa_context *bld, nir_src src, unsigned chan);
+
+
+static LLVMValueRef
+load_reg(struct lp_build_nir_soa_context *bld,
+         const nir_reg_src *reg_src,
+         unsigned chan)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const nir_register *reg = reg_src->reg;
+   struct lp_build_context *reg_bld = get_int_bld(bld, TRUE, reg->bit_size);
+   LLVMValueRef index, res;
+   unsigned i;
+
+   if (!reg_src->indirect) {
+      unsigned idx = reg_src->base_offset * reg->num_components + chan;
+      return LLVMBuildLoad(builder, reg_chan_ptr(bld, reg, idx), "");
+   }
+
+   index = reg_indirect_index(bld, reg, reg_src->base_offset,
+                              get_src(bld, *reg_src->indirect, 0), chan);
+   res = reg_bld->undef;
+   for (i = 0; i < reg_bld->type.length; i++) {
+      LLVMValueRef lane = lp_build_const_int32(gallivm, i);
+      LLVMValueRef indices[2], ptr, val;
+
+      indices[0] = lp_build_const_int32(gallivm, 0);
+      indices[1] = LLVMBuildExtractElement(builder, index, lane, "");
+      ptr = LLVMBuildGEP(builder, bld->regs[reg->index], indices, 2, "");
+      val = LLVMBuildExtractElement(builder, LLVMBuildLoad(builder, ptr, ""),
+                                    lane, "");
+      res = LLVMBuildInsertElement(builder, res, val, lane, "");
+   }
+   return res;
+}
+
+
+static void
+store_reg(struct lp_build_nir_soa_context *bld,
+          const nir_reg_dest *reg_dest,
+          unsigned chan,
+          LLVMValueRef val)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const nir_register *reg = reg_dest->reg;
+   struct lp_build_context *reg_bld = get_int_bld(bld, TRUE, reg->bit_size);
+   LLVMValueRef index, exec_mask;
+   unsigned i;
+
+   val = LLVMBuildBitCast(builder, val, reg_bld->vec_type, "");
+
+   if (!reg_dest->indirect) {
+      unsigned idx = reg_dest->base_offset * reg->num_components + chan;
+      lp_exec_mask_store(&bld->exec_mask, reg_bld, val,
+                         reg_chan_ptr(bld, reg, idx));
+      return;
+   }
+
+   index = reg_indirect_index(bld, reg, reg_dest->base_offset,
+                              get_src(bld, *reg_dest->indirect, 0), chan);
+   exec_mask = bld->exec_mask.has_mask ? bld->exec_mask.exec_mask :
+      LLVMConstAllOnes(bld->bld_base.int_bld.vec_type);
+   for (i = 0; i < reg_bld->type.length; i++) {
+      LLVMValueRef lane = lp_build_const_int32(gallivm, i);
+      LLVMValueRef indices[2], ptr, old, elem;
+
+      indices[0] = lp_build_const_int32(gallivm, 0);
+      indices[1] = LLVMBuildExtractElement(builder, index, lane, "");
+      ptr = LLVMBuildGEP(builder, bld->regs[reg->index], indices, 2, "");
+      old = LLVMBuildLoad(builder, ptr, "");
+      elem = LLVMBuildSelect(builder,
+                             lp_build_lane_active(gallivm, exec_mask, lane),
+                             LLVMBuildExtractElement(builder, val, lane, ""),
+                             LLVMBuildExtractElement(builder, old, lane, ""),
+                             "");
+      LLVMBuildStore(builder,
+                     LLVMBuildInsertElement(builder, old, elem, lane, ""),
+                     ptr);
+   }
+}
+
+
+/*
+ * Sources and destinations.
+ */
+
+static LLVMValueRef
+get_src(struct lp_build_nir_soa_context *bld, nir_src src, unsigned chan)
+{
+   if (src.is_ssa) {
+      assert(bld->ssa_defs[src.ssa->index][chan]);
+      return bld->ssa_defs[src.ssa->index][chan];
+   }
+   return load_reg(bld, &src.reg, chan);
+}
+
+
+static void
+assign_dest(struct lp_build_nir_soa_context *bld,
+            const nir_dest *dest,
+            unsigned write_mask,
+            LLVMValueRef *vals)
+{
+   unsigned chan;
+
+   for (chan = 0; chan < nir_dest_num_components(*dest); chan++) {
+      if (!(write_mask & (1 << chan)))
+         continue;
+
+      if (dest->is_ssa)
+         bld->ssa_defs[dest->ssa.index][chan] = vals[chan];
+      else
+         store_reg(bld, &dest->reg, chan, vals[chan]);
+   }
+}
+
+
+/*
+ * ALU.
+ */
+
+static LLVMValueRef
+get_alu_src(struct lp_build_nir_soa_context *bld,
+            const nir_alu_instr *instr,
+            unsigned src_idx,
+            unsigned chan)
+{
+   const nir_alu_src *src = &instr->src[src_idx];
+   nir_alu_type type = nir_op_infos[instr->op].input_types[src_idx];
+   unsigned bit_size = nir_src_bit_size(src->src);
+   struct lp_build_context *type_bld = get_alu_type_bld(bld, type, bit_size);
+   LLVMValueRef val;
+
+   val = cast_type(bld, get_src(bld, src->src, src->swizzle[chan]),
+                   type, bit_size);
+
+   if (src->abs)
+      val = lp_build_abs(type_bld, val);
+   if (src->negate)
+      val = lp_build_negate(type_bld, val);
+
+   return val;
+}
+
+
+/**
+ * Turn a comparison result of the given bit size into a 32 bit boolean.
+ */
+static LLVMValueRef
+cmp_to_bool(struct lp_build_nir_soa_context *bld,
+            unsigned bit_size,
+            LLVMValueRef cmp)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+
+   if (bit_size == 64)
+      return LLVMBuildTrunc(builder, cmp, bld->bld_base.int_bld.vec_type, "");
+   return cmp;
+}
+
+
+/**
+ * Turn a 32 bit boolean into a mask usable for selecting values of the given
+ * bit size.
+ */
+static LLVMValueRef
+bool_to_mask(struct lp_build_nir_soa_context *bld,
+             unsigned bit_size,
+             LLVMValueRef val)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+
+   if (bit_size == 64)
+      return LLVMBuildSExt(builder, val, bld->bld_base.int64_bld.vec_type, "");
+   return val;
+}
+
+
+static LLVMValueRef
+do_int_divide(struct lp_build_nir_soa_context *bld,
+              boolean is_unsigned,
+              boolean is_rem,
+              unsigned bit_size,
+              LLVMValueRef src,
+              LLVMValueRef src2)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   struct lp_build_context *int_bld = get_int_bld(bld, is_unsigned, bit_size);
+   LLVMValueRef div_mask, divisor, res;
+
+   /*
+    * Avoid the division by zero exception by dividing by ~0 (or -1) instead,
+    * like the tgsi translation does. The unsigned ops return ~0 for a zero
+    * divisor, the signed ones return zero.
+    */
+   div_mask = lp_build_cmp(int_bld, PIPE_FUNC_EQUAL, src2, int_bld->zero);
+   divisor = LLVMBuildOr(builder, div_mask, src2, "");
+
+   if (is_unsigned) {
+      res = is_rem ? LLVMBuildURem(builder, src, divisor, "") :
+                     LLVMBuildUDiv(builder, src, divisor, "");
+      return LLVMBuildOr(builder, div_mask, res, "");
+   }
+
+   res = is_rem ? LLVMBuildSRem(builder, src, divisor, "") :
+                  LLVMBuildSDiv(builder, src, divisor, "");
+   return LLVMBuildAnd(builder, LLVMBuildNot(builder, div_mask, ""), res, "");
+}
+
+
+static LLVMValueRef
+do_alu_action(struct lp_build_nir_soa_context *bld,
+              nir_op op,
+              unsigned dst_bit_size,
+              const unsigned *src_bit_size,
+              LLVMValueRef *src)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *flt_bld = get_flt_bld(bld, src_bit_size[0]);
+   struct lp_build_context *int_bld = get_int_bld(bld, FALSE, src_bit_size[0]);
+   struct lp_build_context *uint_bld = get_int_bld(bld, TRUE, src_bit_size[0]);
+   struct lp_build_context *dst_flt_bld = get_flt_bld(bld, dst_bit_size);
+   struct lp_build_context *dst_int_bld = get_int_bld(bld, FALSE, dst_bit_size);
+   struct lp_build_context *dst_uint_bld = get_int_bld(bld, TRUE, dst_bit_size);
+   LLVMValueRef result, tmp;
+
+   switch (op) {
+   case nir_op_fmov:
+   case nir_op_imov:
+      result = src[0];
+      break;
+
+   /* conversions */
+   case nir_op_i2f32:
+   case nir_op_i2f64:
+      result = LLVMBuildSIToFP(builder, src[0], dst_flt_bld->vec_type, "");
+      break;
+   case nir_op_u2f32:
+   case nir_op_u2f64:
+      result = LLVMBuildUIToFP(builder, src[0], dst_flt_bld->vec_type, "");
+      break;
+   case nir_op_f2i32:
+   case nir_op_f2i64:
+      result = LLVMBuildFPToSI(builder, src[0], dst_int_bld->vec_type, "");
+      break;
+   case nir_op_f2u32:
+   case nir_op_f2u64:
+      result = LLVMBuildFPToUI(builder, src[0], dst_uint_bld->vec_type, "");
+      break;
+   case nir_op_f2f32:
+      result = src_bit_size[0] == 64 ?
+         LLVMBuildFPTrunc(builder, src[0], dst_flt_bld->vec_type, "") : src[0];
+      break;
+   case nir_op_f2f64:
+      result = src_bit_size[0] == 32 ?
+         LLVMBuildFPExt(builder, src[0], dst_flt_bld->vec_type, "") : src[0];
+      break;
+   case nir_op_i2i32:
+   case nir_op_u2u32:
+      result = src_bit_size[0] == 64 ?
+         LLVMBuildTrunc(builder, src[0], dst_uint_bld->vec_type, "") : src[0];
+      break;
+   case nir_op_i2i64:
+      result = src_bit_size[0] == 32 ?
+         LLVMBuildSExt(builder, src[0], dst_int_bld->vec_type, "") : src[0];
+      break;
+   case nir_op_u2u64:
+      result = src_bit_size[0] == 32 ?
+         LLVMBuildZExt(builder, src[0], dst_uint_bld->vec_type, "") : src[0];
+      break;
+   case nir_op_f2b:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(flt_bld, PIPE_FUNC_NOTEQUAL,
+                                        src[0], flt_bld->zero));
+      break;
+   case nir_op_i2b:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(int_bld, PIPE_FUNC_NOTEQUAL,
+                                        src[0], int_bld->zero));
+      break;
+   case nir_op_b2f:
+      result = lp_build_select(dst_flt_bld,
+                               bool_to_mask(bld, dst_bit_size, src[0]),
+                               dst_flt_bld->one, dst_flt_bld->zero);
+      break;
+   case nir_op_b2i:
+      result = LLVMBuildAnd(builder, src[0],
+                            lp_build_const_int_vec(gallivm,
+                                                   bld->bld_base.int_bld.type,
+                                                   1), "");
+      if (dst_bit_size == 64)
+         result = LLVMBuildZExt(builder, result, dst_int_bld->vec_type, "");
+      break;
+
+   /* float arithmetic */
+   case nir_op_fneg:
+      result = lp_build_negate(flt_bld, src[0]);
+      break;
+   case nir_op_fabs:
+      result = lp_build_abs(flt_bld, src[0]);
+      break;
+   case nir_op_fsat:
+      result = lp_build_clamp_zero_one_nanzero(flt_bld, src[0]);
+      break;
+   case nir_op_fsign:
+      result = lp_build_sgn(flt_bld, src[0]);
+      break;
+   case nir_op_fadd:
+      result = lp_build_add(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_fsub:
+      result = lp_build_sub(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_fmul:
+      result = lp_build_mul(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_fdiv:
+      result = lp_build_div(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_ffma:
+      result = lp_build_mad(flt_bld, src[0], src[1], src[2]);
+      break;
+   case nir_op_frcp:
+      result = lp_build_rcp(flt_bld, src[0]);
+      break;
+   case nir_op_frsq:
+      result = lp_build_rsqrt(flt_bld, src[0]);
+      break;
+   case nir_op_fsqrt:
+      result = lp_build_sqrt(flt_bld, src[0]);
+      break;
+   case nir_op_fexp2:
+      result = lp_build_exp2(flt_bld, src[0]);
+      break;
+   case nir_op_flog2:
+      result = lp_build_log2_safe(flt_bld, src[0]);
+      break;
+   case nir_op_fpow:
+      result = lp_build_pow(flt_bld, src[0], src[1]);
+      break;
+   case nir_op_fsin:
+      result = lp_build_sin(flt_bld, src[0]);
+      break;
+   case nir_op_fcos:
+      result = lp_build_cos(flt_bld, src[0]);
+      break;
+   case nir_op_ftrunc:
+      result = lp_build_trunc(flt_bld, src[0]);
+      break;
+   case nir_op_fceil:
+      result = lp_build_ceil(flt_bld, src[0]);
+      break;
+   case nir_op_ffloor:
+      result = lp_build_floor(flt_bld, src[0]);
+      break;
+   case nir_op_ffract:
+      result = lp_build_fract(flt_bld, src[0]);
+      break;
+   case nir_op_fround_even:
+      result = lp_build_round(flt_bld, src[0]);
+      break;
+   case nir_op_fmin:
+      result = lp_build_min_ext(flt_bld, src[0], src[1],
+                                GALLIVM_NAN_RETURN_OTHER);
+      break;
+   case nir_op_fmax:
+      result = lp_build_max_ext(flt_bld, src[0], src[1],
+                                GALLIVM_NAN_RETURN_OTHER);
+      break;
+   case nir_op_fquantize2f16:
+      result = lp_build_half_to_float(gallivm,
+                                      lp_build_float_to_half(gallivm, src[0]));
+      break;
+   case nir_op_fddx:
+   case nir_op_fddx_coarse:
+   case nir_op_fddx_fine:
+      result = lp_build_ddx(flt_bld, src[0]);
+      break;
+   case nir_op_fddy:
+   case nir_op_fddy_coarse:
+   case nir_op_fddy_fine:
+      result = lp_build_ddy(flt_bld, src[0]);
+      break;
+   case nir_op_frexp_exp:
+   case nir_op_frexp_sig: {
+      /* only exists for doubles, floats are lowered by the glsl compiler */
+      struct lp_build_context *u64_bld = &bld->bld_base.uint64_bld;
+      LLVMValueRef bits = LLVMBuildBitCast(builder, src[0],
+                                           u64_bld->vec_type, "");
+      LLVMValueRef is_zero = lp_build_cmp(flt_bld, PIPE_FUNC_EQUAL,
+                                          src[0], flt_bld->zero);
+      assert(src_bit_size[0] == 64);
+      if (op == nir_op_frexp_exp) {
+         tmp = lp_build_shr_imm(u64_bld, bits, 52);
+         tmp = lp_build_and(u64_bld, tmp,
+                            lp_build_const_int_vec(gallivm, u64_bld->type,
+                                                   0x7ff));
+         tmp = lp_build_sub(u64_bld, tmp,
+                            lp_build_const_int_vec(gallivm, u64_bld->type,
+                                                   1022));
+         tmp = lp_build_andnot(u64_bld, tmp, is_zero);
+         result = LLVMBuildTrunc(builder, tmp,
+                                 bld->bld_base.int_bld.vec_type, "");
+      }
+      else {
+         tmp = lp_build_and(u64_bld, bits,
+                            lp_build_const_int_vec(gallivm, u64_bld->type,
+                                                   ~(0x7ffULL << 52)));
+         tmp = lp_build_or(u64_bld, tmp,
+                           lp_build_const_int_vec(gallivm, u64_bld->type,
+                                                  1022ULL << 52));
+         result = lp_build_select(u64_bld, is_zero, bits, tmp);
+      }
+      break;
+   }
+
+   /* float comparisons */
+   case nir_op_flt:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(flt_bld, PIPE_FUNC_LESS,
+                                        src[0], src[1]));
+      break;
+   case nir_op_fge:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(flt_bld, PIPE_FUNC_GEQUAL,
+                                        src[0], src[1]));
+      break;
+   case nir_op_feq:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(flt_bld, PIPE_FUNC_EQUAL,
+                                        src[0], src[1]));
+      break;
+   case nir_op_fne:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(flt_bld, PIPE_FUNC_NOTEQUAL,
+                                        src[0], src[1]));
+      break;
+
+   /* legacy float logic ops, booleans are 0.0 and 1.0 */
+   case nir_op_fnot:
+      result = lp_build_select(flt_bld,
+                               lp_build_cmp(flt_bld, PIPE_FUNC_EQUAL,
+                                            src[0], flt_bld->zero),
+                               flt_bld->one, flt_bld->zero);
+      break;
+   case nir_op_fand:
+   case nir_op_for:
+   case nir_op_fxor: {
+      LLVMValueRef a = lp_build_cmp(flt_bld, PIPE_FUNC_NOTEQUAL,
+                                    src[0], flt_bld->zero);
+      LLVMValueRef b = lp_build_cmp(flt_bld, PIPE_FUNC_NOTEQUAL,
+                                    src[1], flt_bld->zero);
+      if (op == nir_op_fand)
+         tmp = LLVMBuildAnd(builder, a, b, "");
+      else if (op == nir_op_for)
+         tmp = LLVMBuildOr(builder, a, b, "");
+      else
+         tmp = LLVMBuildXor(builder, a, b, "");
+      result = lp_build_select(flt_bld, tmp, flt_bld->one, flt_bld->zero);
+      break;
+   }
+
+   /* integer arithmetic */
+   case nir_op_ineg:
+      result = LLVMBuildNeg(builder, src[0], "");
+      break;
+   case nir_op_iabs:
+      result = lp_build_abs(int_bld, src[0]);
+      break;
+   case nir_op_isign:
+      result = lp_build_sgn(int_bld, src[0]);
+      break;
+   case nir_op_iadd:
+      result = LLVMBuildAdd(builder, src[0], src[1], "");
+      break;
+   case nir_op_isub:
+      result = LLVMBuildSub(builder, src[0], src[1], "");
+      break;
+   case nir_op_imul:
+      result = LLVMBuildMul(builder, src[0], src[1], "");
+      break;
+   case nir_op_imul_high:
+      assert(src_bit_size[0] == 32);
+      lp_build_mul_32_lohi(int_bld, src[0], src[1], &result);
+      break;
+   case nir_op_umul_high:
+      assert(src_bit_size[0] == 32);
+      lp_build_mul_32_lohi(uint_bld, src[0], src[1], &result);
+      break;
+   case nir_op_idiv:
+      result = do_int_divide(bld, FALSE, FALSE, src_bit_size[0],
+                             src[0], src[1]);
+      break;
+   case nir_op_udiv:
+      result = do_int_divide(bld, TRUE, FALSE, src_bit_size[0],
+                             src[0], src[1]);
+      break;
+   case nir_op_irem:
+      result = do_int_divide(bld, FALSE, TRUE, src_bit_size[0],
+                             src[0], src[1]);
+      break;
+   case nir_op_umod:
+      result = do_int_divide(bld, TRUE, TRUE, src_bit_size[0],
+                             src[0], src[1]);
+      break;
+   case nir_op_imod: {
+      /* like irem, but the result takes the sign of the divisor */
+      LLVMValueRef fixup;
+      result = do_int_divide(bld, FALSE, TRUE, src_bit_size[0],
+                             src[0], src[1]);
+      fixup = LLVMBuildAnd(builder,
+                           lp_build_cmp(int_bld, PIPE_FUNC_NOTEQUAL,
+                                        result, int_bld->zero),
+                           lp_build_cmp(int_bld, PIPE_FUNC_LESS,
+                                        LLVMBuildXor(builder, result,
+                                                     src[1], ""),
+                                        int_bld->zero), "");
+      result = lp_build_select(int_bld, fixup,
+                               LLVMBuildAdd(builder, result, src[1], ""),
+                               result);
+      break;
+   }
+   case nir_op_imin:
+      result = lp_build_min(int_bld, src[0], src[1]);
+      break;
+   case nir_op_imax:
+      result = lp_build_max(int_bld, src[0], src[1]);
+      break;
+   case nir_op_umin:
+      result = lp_build_min(uint_bld, src[0], src[1]);
+      break;
+   case nir_op_umax:
+      result = lp_build_max(uint_bld, src[0], src[1]);
+      break;
+
+   /* integer comparisons */
+   case nir_op_ilt:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(int_bld, PIPE_FUNC_LESS,
+                                        src[0], src[1]));
+      break;
+   case nir_op_ige:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(int_bld, PIPE_FUNC_GEQUAL,
+                                        src[0], src[1]));
+      break;
+   case nir_op_ieq:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(int_bld, PIPE_FUNC_EQUAL,
+                                        src[0], src[1]));
+      break;
+   case nir_op_ine:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(int_bld, PIPE_FUNC_NOTEQUAL,
+                                        src[0], src[1]));
+      break;
+   case nir_op_ult:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(uint_bld, PIPE_FUNC_LESS,
+                                        src[0], src[1]));
+      break;
+   case nir_op_uge:
+      result = cmp_to_bool(bld, src_bit_size[0],
+                           lp_build_cmp(uint_bld, PIPE_FUNC_GEQUAL,
+                                        src[0], src[1]));
+      break;
+
+   /* bit operations */
+   case nir_op_inot:
+      result = LLVMBuildNot(builder, src[0], "");
+      break;
+   case nir_op_iand:
+      result = LLVMBuildAnd(builder, src[0], src[1], "");
+      break;
+   case nir_op_ior:
+      result = LLVMBuildOr(builder, src[0], src[1], "");
+      break;
+   case nir_op_ixor:
+      result = LLVMBuildXor(builder, src[0], src[1], "");
+      break;
+   case nir_op_ishl:
+   case nir_op_ishr:
+   case nir_op_ushr:
+      /* the shift count is always 32 bit, and is masked like in tgsi */
+      tmp = LLVMBuildAnd(builder, src[1],
+                         lp_build_const_int_vec(gallivm,
+                                                bld->bld_base.uint_bld.type,
+                                                src_bit_size[0] - 1), "");
+      if (src_bit_size[0] == 64)
+         tmp = LLVMBuildZExt(builder, tmp, uint_bld->vec_type, "");
+      if (op == nir_op_ishl)
+         result = LLVMBuildShl(builder, src[0], tmp, "");
+      else if (op == nir_op_ishr)
+         result = LLVMBuildAShr(builder, src[0], tmp, "");
+      else
+         result = LLVMBuildLShr(builder, src[0], tmp, "");
+      break;
+   case nir_op_ufind_msb: {
+      char intrinsic[64];
+      assert(src_bit_size[0] == 32);
+      lp_format_intrinsic(intrinsic, sizeof intrinsic, "llvm.ctlz",
+                          uint_bld->vec_type);
+      /* ctlz(0) is 32 with is_zero_undef == false, giving -1 as required */
+      tmp = lp_build_intrinsic_binary(builder, intrinsic, uint_bld->vec_type,
+                                      src[0],
+                                      LLVMConstInt(LLVMInt1TypeInContext(gallivm->context),
+                                                   0, 0));
+      result = LLVMBuildSub(builder,
+                            lp_build_const_int_vec(gallivm, uint_bld->type, 31),
+                            tmp, "");
+      break;
+   }
+
+   /* selects */
+   case nir_op_bcsel:
+      result = lp_build_select(get_int_bld(bld, TRUE, src_bit_size[1]),
+                               bool_to_mask(bld, src_bit_size[1], src[0]),
+                               src[1], src[2]);
+      break;
+   case nir_op_fcsel:
+      result = lp_build_select(get_flt_bld(bld, src_bit_size[1]),
+                               bool_to_mask(bld, src_bit_size[1],
+                                            cmp_to_bool(bld, src_bit_size[0],
+                                                        lp_build_cmp(flt_bld, PIPE_FUNC_NOTEQUAL,
+                                                                     src[0], flt_bld->zero))),
+                               src[1], src[2]);
+      break;
+
+   /* packing */
+   case nir_op_pack_64_2x32_split:
+      result = merge_64bit(bld, src[0], src[1]);
+      break;
+   case nir_op_unpack_64_2x32_split_x:
+   case nir_op_unpack_64_2x32_split_y: {
+      LLVMValueRef lo, hi;
+      split_64bit(bld, src[0], &lo, &hi);
+      result = op == nir_op_unpack_64_2x32_split_x ? lo : hi;
+      break;
+   }
+   case nir_op_pack_half_2x16_split: {
+      LLVMValueRef lo = lp_build_float_to_half(gallivm, src[0]);
+      LLVMValueRef hi = lp_build_float_to_half(gallivm, src[1]);
+      lo = LLVMBuildZExt(builder, lo, bld->bld_base.uint_bld.vec_type, "");
+      hi = LLVMBuildZExt(builder, hi, bld->bld_base.uint_bld.vec_type, "");
+      result = LLVMBuildOr(builder, lo,
+                           lp_build_shl_imm(&bld->bld_base.uint_bld, hi, 16),
+                           "");
+      break;
+   }
+   case nir_op_unpack_half_2x16_split_x:
+   case nir_op_unpack_half_2x16_split_y: {
+      LLVMTypeRef i16_vec_type =
+         LLVMVectorType(LLVMInt16TypeInContext(gallivm->context),
+                        bld->bld_base.base.type.length);
+      tmp = src[0];
+      if (op == nir_op_unpack_half_2x16_split_y)
+         tmp = lp_build_shr_imm(&bld->bld_base.uint_bld, tmp, 16);
+      tmp = LLVMBuildTrunc(builder, tmp, i16_vec_type, "");
+      result = lp_build_half_to_float(gallivm, tmp);
+      break;
+   }
+
+   default:
+      _debug_printf("llvmpipe: unhandled nir alu op %s\n",
+                    nir_op_infos[op].name);
+      assert(0);
+      result = dst_uint_bld->undef;
+      break;
+   }
+
+   return result;
+}
+
+
+static void
+visit_alu(struct lp_build_nir_soa_context *bld,
+          const nir_alu_instr *instr)
+{
+   const nir_op_info *info = &nir_op_infos[instr->op];
+   unsigned num_components = nir_dest_num_components(instr->dest.dest);
+   unsigned dst_bit_size = nir_dest_bit_size(instr->dest.dest);
+   unsigned src_bit_size[NIR_MAX_VEC_COMPONENTS];
+   LLVMValueRef result[NIR_MAX_VEC_COMPONENTS];
+   unsigned i, c;
+
+   for (i = 0; i < info->num_inputs; i++)
+      src_bit_size[i] = nir_src_bit_size(instr->src[i].src);
+
+   for (c = 0; c < num_components; c++) {
+      LLVMValueRef src[NIR_MAX_VEC_COMPONENTS];
+
+      result[c] = NULL;
+      if (!(instr->dest.write_mask & (1 << c)))
+         continue;
+
+      if (instr->op == nir_op_vec2 ||
+          instr->op == nir_op_vec3 ||
+          instr->op == nir_op_vec4) {
+         result[c] = get_src(bld, instr->src[c].src, instr->src[c].swizzle[0]);
+         continue;
+      }
+
+      /* everything else is scalar after nir_lower_alu_to_scalar */
+      assert(info->output_size == 0);
+      for (i = 0; i < info->num_inputs; i++)
+         src[i] = get_alu_src(bld, instr, i, c);
+
+      result[c] = do_alu_action(bld, instr->op, dst_bit_size,
+                                src_bit_size, src);
+
+      if (instr->dest.saturate) {
+         result[c] = lp_build_clamp_zero_one_nanzero(get_flt_bld(bld, dst_bit_size),
+                                                     result[c]);
+      }
+   }
+
+   assign_dest(bld, &instr->dest.dest, instr->dest.write_mask, result);
+}
+
+
+static void
+visit_load_const(struct lp_build_nir_soa_context *bld,
+                 const nir_load_const_instr *instr)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   struct lp_build_context *int_bld = get_int_bld(bld, TRUE, instr->def.bit_size);
+   unsigned c;
+
+   for (c = 0; c < instr->def.num_components; c++) {
+      long long val = instr->def.bit_size == 64 ? instr->value.u64[c] :
+                                                  instr->value.u32[c];
+      bld->ssa_defs[instr->def.index][c] =
+         lp_build_const_int_vec(gallivm, int_bld->type, val);
+   }
+}
+
+
+static void
+visit_ssa_undef(struct lp_build_nir_soa_context *bld,
+                const nir_ssa_undef_instr *instr)
+{
+   struct lp_build_context *int_bld = get_int_bld(bld, TRUE, instr->def.bit_size);
+   unsigned c;
+
+   for (c = 0; c < instr->def.num_components; c++)
+      bld->ssa_defs[instr->def.index][c] = int_bld->undef;
+}
+
+
+/*
+ * Intrinsics.
+ */
+
+/**
+ * Load a dword from a constant buffer, for all lanes. The index is either a
+ * scalar, or a vector of per lane dword indices in which case lanes with
+ * indices at or past the end of the buffer read zero.
+ */
+static LLVMValueRef
+load_const_dword(struct lp_build_nir_soa_context *bld,
+                 unsigned buf,
+                 LLVMValueRef index,
+                 boolean indirect)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef consts_ptr = bld->consts[buf];
+   LLVMValueRef overflow_mask, num_dwords, res;
+   unsigned i;
+
+   if (!indirect) {
+      LLVMValueRef scalar_ptr = LLVMBuildGEP(builder, consts_ptr, &index, 1, "");
+      LLVMValueRef scalar = LLVMBuildLoad(builder, scalar_ptr, "");
+      return lp_build_broadcast_scalar(&bld->bld_base.base, scalar);
+   }
+
+   /* the sizes are in vec4 units */
+   num_dwords = LLVMBuildShl(builder, bld->consts_sizes[buf],
+                             lp_build_const_int32(gallivm, 2), "");
+   num_dwords = lp_build_broadcast_scalar(uint_bld, num_dwords);
+   overflow_mask = lp_build_cmp(uint_bld, PIPE_FUNC_GEQUAL, index, num_dwords);
+   index = lp_build_select(uint_bld, overflow_mask, uint_bld->zero, index);
+
+   res = bld->bld_base.base.undef;
+   for (i = 0; i < uint_bld->type.length; i++) {
+      LLVMValueRef lane = lp_build_const_int32(gallivm, i);
+      LLVMValueRef lane_index = LLVMBuildExtractElement(builder, index,
+                                                        lane, "");
+      LLVMValueRef ptr = LLVMBuildGEP(builder, consts_ptr, &lane_index, 1, "");
+      res = LLVMBuildInsertElement(builder, res, LLVMBuildLoad(builder, ptr, ""),
+                                   lane, "");
+   }
+
+   res = LLVMBuildBitCast(builder, res, uint_bld->vec_type, "");
+   return lp_build_select(uint_bld, overflow_mask, uint_bld->zero, res);
+}
+
+
+/**
+ * Load num_components values of bit_size from constant buffer buf, starting
+ * at dword offset. The offset is a constant (offset_const) plus an optional
+ * per lane offset vector.
+ */
+static void
+load_const_values(struct lp_build_nir_soa_context *bld,
+                  unsigned buf,
+                  unsigned num_components,
+                  unsigned bit_size,
+                  unsigned offset_const,
+                  LLVMValueRef offset_vec,
+                  LLVMValueRef *result)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   unsigned dwords = bit_size == 64 ? 2 : 1;
+   unsigned c, d;
+
+   for (c = 0; c < num_components; c++) {
+      LLVMValueRef vals[2];
+
+      for (d = 0; d < dwords; d++) {
+         unsigned dword = offset_const + c * dwords + d;
+         LLVMValueRef index;
+
+         if (offset_vec) {
+            index = lp_build_add(uint_bld, offset_vec,
+                                 lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                        dword));
+         }
+         else {
+            index = lp_build_const_int32(gallivm, dword);
+         }
+         vals[d] = load_const_dword(bld, buf, index, offset_vec != NULL);
+      }
+
+      result[c] = dwords == 2 ? merge_64bit(bld, vals[0], vals[1]) : vals[0];
+   }
+}
+
+
+static void
+visit_load_uniform(struct lp_build_nir_soa_context *bld,
+                   nir_intrinsic_instr *instr,
+                   LLVMValueRef *result)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   nir_const_value *const_offset = nir_src_as_const_value(instr->src[0]);
+   unsigned base = nir_intrinsic_base(instr);
+   LLVMValueRef offset_vec = NULL;
+   unsigned offset_const = base * 4;
+
+   /* base and offset are in vec4 slots */
+   if (const_offset) {
+      offset_const += const_offset->u32[0] * 4;
+   }
+   else {
+      offset_vec = cast_type(bld, get_src(bld, instr->src[0], 0),
+                             nir_type_uint, 32);
+      offset_vec = lp_build_shl_imm(uint_bld, offset_vec, 2);
+   }
+
+   load_const_values(bld, 0, nir_dest_num_components(instr->dest),
+                     nir_dest_bit_size(instr->dest),
+                     offset_const, offset_vec, result);
+}
+
+
+static void
+visit_load_ubo(struct lp_build_nir_soa_context *bld,
+               nir_intrinsic_instr *instr,
+               LLVMValueRef *result)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   nir_const_value *const_block = nir_src_as_const_value(instr->src[0]);
+   nir_const_value *const_offset = nir_src_as_const_value(instr->src[1]);
+   LLVMValueRef offset_vec = NULL;
+   unsigned offset_const = 0;
+   unsigned buf;
+
+   /*
+    * Constant buffer 0 holds the default uniform block, and the block index
+    * has to be dynamically uniform, so a non constant one could only come
+    * from an array of blocks which the tgsi path doesn't handle either.
+    */
+   assert(const_block);
+   buf = (const_block ? const_block->u32[0] : 0) + 1;
+   if (buf >= bld->num_const_buffers) {
+      unsigned c;
+      for (c = 0; c < nir_dest_num_components(instr->dest); c++)
+         result[c] = uint_bld->zero;
+      return;
+   }
+
+   /* the offset is in bytes */
+   if (const_offset) {
+      offset_const = const_offset->u32[0] / 4;
+   }
+   else {
+      offset_vec = cast_type(bld, get_src(bld, instr->src[1], 0),
+                             nir_type_uint, 32);
+      offset_vec = lp_build_shr_imm(uint_bld, offset_vec, 2);
+   }
+
+   load_const_values(bld, buf, nir_dest_num_components(instr->dest),
+                     nir_dest_bit_size(instr->dest),
+                     offset_const, offset_vec, result);
+}
+
+
+/**
+ * Return the input/output slot and channel for the given component of an
+ * io intrinsic, accounting for 64 bit values taking up two channels.
+ */
+static void
+io_slot_chan(unsigned base,
+             unsigned component,
+             unsigned bit_size,
+             unsigned c,
+             unsigned d,
+             unsigned *slot,
+             unsigned *chan)
+{
+   unsigned dword = component + (bit_size == 64 ? 2 * c + d : c);
+
+   *slot = base + dword / 4;
+   *chan = dword % 4;
+}
+
+
+static unsigned
+io_const_offset(nir_intrinsic_instr *instr)
+{
+   nir_const_value *offset =
+      nir_src_as_const_value(*nir_get_io_offset_src(instr));
+
+   /* indirect i/o is lowered to if ladders by lp_build_nir_prepare() */
+   assert(offset);
+   return offset ? offset->u32[0] : 0;
+}
+
+
+static void
+visit_load_input(struct lp_build_nir_soa_context *bld,
+                 nir_intrinsic_instr *instr,
+                 LLVMValueRef *result)
+{
+   const struct tgsi_shader_info *info = bld->bld_base.info;
+   unsigned base = nir_intrinsic_base(instr) + io_const_offset(instr);
+   unsigned component = nir_intrinsic_component(instr);
+   unsigned bit_size = nir_dest_bit_size(instr->dest);
+   unsigned c, d;
+
+   for (c = 0; c < nir_dest_num_components(instr->dest); c++) {
+      LLVMValueRef vals[2];
+
+      for (d = 0; d < (bit_size == 64 ? 2 : 1); d++) {
+         unsigned slot, chan;
+
+         io_slot_chan(base, component, bit_size, c, d, &slot, &chan);
+         vals[d] = bld->inputs[slot][chan];
+      }
+
+      if (bit_size == 64) {
+         result[c] = merge_64bit(bld, vals[0], vals[1]);
+      }
+      else if (info->processor == PIPE_SHADER_FRAGMENT &&
+               info->input_semantic_name[base] == TGSI_SEMANTIC_FACE) {
+         /* the face input is +1.0/-1.0, gl_FrontFacing is a boolean */
+         result[c] = lp_build_cmp(&bld->bld_base.base, PIPE_FUNC_GREATER,
+                                  vals[0], bld->bld_base.base.zero);
+      }
+      else {
+         result[c] = vals[0];
+      }
+   }
+}
+
+
+static void
+visit_load_per_vertex_input(struct lp_build_nir_soa_context *bld,
+                            nir_intrinsic_instr *instr,
+                            LLVMValueRef *result)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   unsigned base = nir_intrinsic_base(instr) + io_const_offset(instr);
+   unsigned component = nir_intrinsic_component(instr);
+   unsigned bit_size = nir_dest_bit_size(instr->dest);
+   nir_const_value *const_vertex = nir_src_as_const_value(instr->src[0]);
+   LLVMValueRef vertex_index;
+   unsigned c, d;
+
+   assert(bld->gs_iface);
+
+   if (const_vertex)
+      vertex_index = lp_build_const_int32(gallivm, const_vertex->u32[0]);
+   else
+      vertex_index = get_src(bld, instr->src[0], 0);
+
+   for (c = 0; c < nir_dest_num_components(instr->dest); c++) {
+      LLVMValueRef vals[2];
+
+      for (d = 0; d < (bit_size == 64 ? 2 : 1); d++) {
+         unsigned slot, chan;
+
+         io_slot_chan(base, component, bit_size, c, d, &slot, &chan);
+         vals[d] = bld->gs_iface->fetch_input(bld->gs_iface, &bld->bld_base,
+                                              !const_vertex, vertex_index,
+                                              FALSE,
+                                              lp_build_const_int32(gallivm, slot),
+                                              lp_build_const_int32(gallivm, chan));
+      }
+
+      result[c] = bit_size == 64 ? merge_64bit(bld, vals[0], vals[1]) : vals[0];
+   }
+}
+
+
+/**
+ * Map a NIR output channel onto the tgsi style output channel llvmpipe
+ * expects: depth lives in POSITION.z and stencil in STENCIL.y.
+ */
+static unsigned
+output_chan(struct lp_build_nir_soa_context *bld,
+            unsigned slot,
+            unsigned chan)
+{
+   const struct tgsi_shader_info *info = bld->bld_base.info;
+
+   if (info->processor == PIPE_SHADER_FRAGMENT) {
+      if (info->output_semantic_name[slot] == TGSI_SEMANTIC_POSITION)
+         return 2;
+      if (info->output_semantic_name[slot] == TGSI_SEMANTIC_STENCIL)
+         return 1;
+   }
+   return chan;
+}
+
+
+static void
+visit_load_output(struct lp_build_nir_soa_context *bld,
+                  nir_intrinsic_instr *instr,
+                  LLVMValueRef *result)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   unsigned base = nir_intrinsic_base(instr) + io_const_offset(instr);
+   unsigned component = nir_intrinsic_component(instr);
+   unsigned bit_size = nir_dest_bit_size(instr->dest);
+   unsigned c, d;
+
+   for (c = 0; c < nir_dest_num_components(instr->dest); c++) {
+      LLVMValueRef vals[2];
+
+      for (d = 0; d < (bit_size == 64 ? 2 : 1); d++) {
+         unsigned slot, chan;
+
+         io_slot_chan(base, component, bit_size, c, d, &slot, &chan);
+         chan = output_chan(bld, slot, chan);
+         vals[d] = LLVMBuildLoad(builder, bld->outputs[slot][chan], "");
+      }
+
+      result[c] = bit_size == 64 ? merge_64bit(bld, vals[0], vals[1]) : vals[0];
+   }
+}
+
+
+static void
+visit_store_output(struct lp_build_nir_soa_context *bld,
+                   nir_intrinsic_instr *instr)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   unsigned base = nir_intrinsic_base(instr) + io_const_offset(instr);
+   unsigned component = nir_intrinsic_component(instr);
+   unsigned write_mask = nir_intrinsic_write_mask(instr);
+   unsigned bit_size = nir_src_bit_size(instr->src[0]);
+   unsigned c, d;
+
+   for (c = 0; c < nir_src_num_components(instr->src[0]); c++) {
+      LLVMValueRef vals[2];
+
+      if (!(write_mask & (1 << c)))
+         continue;
+
+      vals[0] = get_src(bld, instr->src[0], c);
+      if (bit_size == 64)
+         split_64bit(bld, vals[0], &vals[0], &vals[1]);
+
+      for (d = 0; d < (bit_size == 64 ? 2 : 1); d++) {
+         unsigned slot, chan;
+
+         io_slot_chan(base, component, bit_size, c, d, &slot, &chan);
+         chan = output_chan(bld, slot, chan);
+         lp_exec_mask_store(&bld->exec_mask, &bld->bld_base.base,
+                            LLVMBuildBitCast(builder, vals[d],
+                                             bld->bld_base.base.vec_type, ""),
+                            bld->outputs[slot][chan]);
+      }
+   }
+}
+
+
+static LLVMValueRef
+broadcast_sysval(struct lp_build_nir_soa_context *bld,
+                 LLVMValueRef scalar)
+{
+   return lp_build_broadcast_scalar(&bld->bld_base.uint_bld, scalar);
+}
+
+
+static void
+visit_load_sysval(struct lp_build_nir_soa_context *bld,
+                  nir_intrinsic_instr *instr,
+                  LLVMValueRef *result)
+{
+   const struct lp_bld_tgsi_system_values *sv = &bld->system_values;
+   unsigned c;
+
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_vertex_id:
+      result[0] = sv->vertex_id;
+      break;
+   case nir_intrinsic_load_vertex_id_zero_base:
+      result[0] = sv->vertex_id_nobase;
+      break;
+   case nir_intrinsic_load_base_vertex:
+      result[0] = sv->basevertex;
+      break;
+   case nir_intrinsic_load_instance_id:
+      result[0] = broadcast_sysval(bld, sv->instance_id);
+      break;
+   case nir_intrinsic_load_primitive_id:
+      result[0] = sv->prim_id;
+      break;
+   case nir_intrinsic_load_invocation_id:
+      result[0] = broadcast_sysval(bld, sv->invocation_id);
+      break;
+   case nir_intrinsic_load_local_invocation_id:
+      for (c = 0; c < 3; c++)
+         result[c] = sv->thread_id[c];
+      break;
+   case nir_intrinsic_load_work_group_id:
+      for (c = 0; c < 3; c++)
+         result[c] = broadcast_sysval(bld, sv->block_id[c]);
+      break;
+   case nir_intrinsic_load_num_work_groups:
+      for (c = 0; c < 3; c++)
+         result[c] = broadcast_sysval(bld, sv->grid_size[c]);
+      break;
+   case nir_intrinsic_load_local_group_size:
+      for (c = 0; c < 3; c++)
+         result[c] = broadcast_sysval(bld, sv->block_size[c]);
+      break;
+   default:
+      _debug_printf("llvmpipe: unhandled nir system value %s\n",
+                    nir_intrinsic_infos[instr->intrinsic].name);
+      assert(0);
+      break;
+   }
+
+   for (c = 0; c < nir_dest_num_components(instr->dest); c++) {
+      if (!result[c])
+         result[c] = bld->bld_base.uint_bld.zero;
+   }
+}
+
+
+static void
+emit_kill(struct lp_build_nir_soa_context *bld,
+          LLVMValueRef cond)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   LLVMValueRef mask;
+
+   assert(bld->mask);
+
+   /* For those channels which are "alive" (and pass cond), disable fragment
+    * shader execution.
+    */
+   if (cond) {
+      mask = LLVMBuildNot(builder, cond, "");
+      if (bld->exec_mask.has_mask) {
+         mask = LLVMBuildOr(builder, mask,
+                            LLVMBuildNot(builder, bld->exec_mask.exec_mask, ""),
+                            "");
+      }
+   }
+   else if (bld->exec_mask.has_mask) {
+      mask = LLVMBuildNot(builder, bld->exec_mask.exec_mask, "kilp");
+   }
+   else {
+      mask = LLVMConstNull(bld->bld_base.base.int_vec_type);
+   }
+
+   lp_build_mask_update(bld->mask, mask);
+   lp_build_mask_check(bld->mask);
+}
+
+
+static void
+increment_vec_ptr_by_mask(struct lp_build_nir_soa_context *bld,
+                          LLVMValueRef ptr,
+                          LLVMValueRef mask)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   LLVMValueRef current_vec = LLVMBuildLoad(builder, ptr, "");
+
+   current_vec = LLVMBuildSub(builder, current_vec, mask, "");
+
+   LLVMBuildStore(builder, current_vec, ptr);
+}
+
+
+static void
+clear_uint_vec_ptr_from_mask(struct lp_build_nir_soa_context *bld,
+                             LLVMValueRef ptr,
+                             LLVMValueRef mask)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   LLVMValueRef current_vec = LLVMBuildLoad(builder, ptr, "");
+
+   current_vec = lp_build_select(&bld->bld_base.uint_bld,
+                                 mask,
+                                 bld->bld_base.uint_bld.zero,
+                                 current_vec);
+
+   LLVMBuildStore(builder, current_vec, ptr);
+}
+
+
+static void
+emit_vertex(struct lp_build_nir_soa_context *bld)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   LLVMValueRef mask, total_emitted_vertices_vec;
+
+   if (!bld->gs_iface->emit_vertex)
+      return;
+
+   mask = mask_vec(bld);
+   total_emitted_vertices_vec =
+      LLVMBuildLoad(builder, bld->total_emitted_vertices_vec_ptr, "");
+   mask = LLVMBuildAnd(builder, mask,
+                       lp_build_cmp(&bld->bld_base.int_bld, PIPE_FUNC_LESS,
+                                    total_emitted_vertices_vec,
+                                    bld->max_output_vertices_vec), "");
+
+   bld->gs_iface->emit_vertex(bld->gs_iface, &bld->bld_base,
+                              bld->outputs, total_emitted_vertices_vec);
+   increment_vec_ptr_by_mask(bld, bld->emitted_vertices_vec_ptr, mask);
+   increment_vec_ptr_by_mask(bld, bld->total_emitted_vertices_vec_ptr, mask);
+}
+
+
+static void
+end_primitive_masked(struct lp_build_nir_soa_context *bld,
+                     LLVMValueRef mask)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef emitted_vertices_vec, emitted_prims_vec;
+
+   if (!bld->gs_iface->end_primitive)
+      return;
+
+   emitted_vertices_vec =
+      LLVMBuildLoad(builder, bld->emitted_vertices_vec_ptr, "");
+   emitted_prims_vec =
+      LLVMBuildLoad(builder, bld->emitted_prims_vec_ptr, "");
+
+   /* only end primitives on the lanes which have unflushed vertices */
+   mask = LLVMBuildAnd(builder, mask,
+                       lp_build_cmp(uint_bld, PIPE_FUNC_NOTEQUAL,
+                                    emitted_vertices_vec, uint_bld->zero), "");
+
+   bld->gs_iface->end_primitive(bld->gs_iface, &bld->bld_base,
+                                emitted_vertices_vec, emitted_prims_vec);
+   increment_vec_ptr_by_mask(bld, bld->emitted_prims_vec_ptr, mask);
+   clear_uint_vec_ptr_from_mask(bld, bld->emitted_vertices_vec_ptr, mask);
+}
+
+
+/**
+ * Shader buffers and shared memory, see the tgsi translator for how lanes
+ * are scalarized.
+ */
+static void
+mem_resource(struct lp_build_nir_soa_context *bld,
+             nir_intrinsic_instr *instr,
+             const nir_src *block,
+             LLVMValueRef *base_ptr,
+             LLVMValueRef *size)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef index;
+
+   assert(bld->cs_iface);
+
+   if (!block) {
+      *base_ptr = bld->cs_iface->shared_ptr;
+      *size = bld->cs_iface->shared_size;
+      return;
+   }
+
+   /* the block index has to be dynamically uniform, use the first lane */
+   index = cast_type(bld, get_src(bld, *block, 0), nir_type_uint, 32);
+   index = LLVMBuildExtractElement(builder, index,
+                                   lp_build_const_int32(gallivm, 0), "");
+   *base_ptr = lp_build_array_get(gallivm, bld->cs_iface->ssbo_ptr, index);
+   *size = lp_build_array_get(gallivm, bld->cs_iface->ssbo_sizes_ptr, index);
+}
+
+
+static void
+visit_load_mem(struct lp_build_nir_soa_context *bld,
+               nir_intrinsic_instr *instr,
+               const nir_src *block,
+               nir_src offset_src,
+               unsigned base,
+               LLVMValueRef *result)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   unsigned bit_size = nir_dest_bit_size(instr->dest);
+   unsigned dwords = bit_size == 64 ? 2 : 1;
+   LLVMValueRef base_ptr, size, offset, dummy_ptr;
+   unsigned c, d, i;
+
+   mem_resource(bld, instr, block, &base_ptr, &size);
+
+   offset = cast_type(bld, get_src(bld, offset_src, 0), nir_type_uint, 32);
+   if (base)
+      offset = lp_build_add(uint_bld, offset,
+                            lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                   base));
+   /* zero initialized, out of bounds reads return 0 */
+   dummy_ptr = lp_build_alloca(gallivm, uint_bld->elem_type, "");
+
+   for (c = 0; c < nir_dest_num_components(instr->dest); c++) {
+      LLVMValueRef vals[2];
+
+      for (d = 0; d < dwords; d++) {
+         LLVMValueRef res = uint_bld->undef;
+
+         for (i = 0; i < uint_bld->type.length; i++) {
+            LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+            LLVMValueRef lane_offset =
+               LLVMBuildExtractElement(builder, offset, idx, "");
+            LLVMValueRef ptr =
+               lp_build_mem_lane_ptr(gallivm, base_ptr, size, lane_offset,
+                                     c * dwords + d, NULL, dummy_ptr);
+
+            res = LLVMBuildInsertElement(builder, res,
+                                         LLVMBuildLoad(builder, ptr, ""),
+                                         idx, "");
+         }
+         vals[d] = res;
+      }
+      result[c] = dwords == 2 ? merge_64bit(bld, vals[0], vals[1]) : vals[0];
+   }
+}
+
+
+static void
+visit_store_mem(struct lp_build_nir_soa_context *bld,
+                nir_intrinsic_instr *instr,
+                nir_src value_src,
+                const nir_src *block,
+                nir_src offset_src,
+                unsigned base)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   unsigned bit_size = nir_src_bit_size(value_src);
+   unsigned dwords = bit_size == 64 ? 2 : 1;
+   unsigned write_mask = nir_intrinsic_write_mask(instr);
+   LLVMValueRef base_ptr, size, offset, exec_mask, dummy_ptr;
+   unsigned c, d, i;
+
+   mem_resource(bld, instr, block, &base_ptr, &size);
+
+   offset = cast_type(bld, get_src(bld, offset_src, 0), nir_type_uint, 32);
+   if (base)
+      offset = lp_build_add(uint_bld, offset,
+                            lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                   base));
+   exec_mask = mask_vec(bld);
+   dummy_ptr = lp_build_alloca_undef(gallivm, uint_bld->elem_type, "");
+
+   for (c = 0; c < nir_src_num_components(value_src); c++) {
+      LLVMValueRef vals[2];
+
+      if (!(write_mask & (1 << c)))
+         continue;
+
+      vals[0] = get_src(bld, value_src, c);
+      if (dwords == 2)
+         split_64bit(bld, vals[0], &vals[0], &vals[1]);
+
+      for (d = 0; d < dwords; d++) {
+         LLVMValueRef value = cast_type(bld, vals[d], nir_type_uint, 32);
+
+         for (i = 0; i < uint_bld->type.length; i++) {
+            LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+            LLVMValueRef lane_offset =
+               LLVMBuildExtractElement(builder, offset, idx, "");
+            LLVMValueRef ptr =
+               lp_build_mem_lane_ptr(gallivm, base_ptr, size, lane_offset,
+                                     c * dwords + d,
+                                     lp_build_lane_active(gallivm, exec_mask, idx),
+                                     dummy_ptr);
+
+            LLVMBuildStore(builder,
+                           LLVMBuildExtractElement(builder, value, idx, ""),
+                           ptr);
+         }
+      }
+   }
+}
+
+
+static void
+visit_atomic_mem(struct lp_build_nir_soa_context *bld,
+                 nir_intrinsic_instr *instr,
+                 const nir_src *block,
+                 nir_src offset_src,
+                 unsigned base,
+                 const nir_src *data_src,
+                 LLVMValueRef *result)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef base_ptr, size, offset, value, new_value = NULL;
+   LLVMValueRef exec_mask, dummy_ptr, res;
+   LLVMAtomicRMWBinOp op = LLVMAtomicRMWBinOpXchg;
+   boolean is_cas = FALSE;
+   unsigned i;
+
+   switch (instr->intrinsic) {
+   case nir_intrinsic_ssbo_atomic_add:
+   case nir_intrinsic_shared_atomic_add:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case nir_intrinsic_ssbo_atomic_exchange:
+   case nir_intrinsic_shared_atomic_exchange:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case nir_intrinsic_ssbo_atomic_and:
+   case nir_intrinsic_shared_atomic_and:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case nir_intrinsic_ssbo_atomic_or:
+   case nir_intrinsic_shared_atomic_or:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case nir_intrinsic_ssbo_atomic_xor:
+   case nir_intrinsic_shared_atomic_xor:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case nir_intrinsic_ssbo_atomic_umin:
+   case nir_intrinsic_shared_atomic_umin:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case nir_intrinsic_ssbo_atomic_umax:
+   case nir_intrinsic_shared_atomic_umax:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case nir_intrinsic_ssbo_atomic_imin:
+   case nir_intrinsic_shared_atomic_imin:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case nir_intrinsic_ssbo_atomic_imax:
+   case nir_intrinsic_shared_atomic_imax:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   case nir_intrinsic_ssbo_atomic_comp_swap:
+   case nir_intrinsic_shared_atomic_comp_swap:
+      is_cas = TRUE;
+      break;
+   default:
+      assert(0);
+      break;
+   }
+
+   mem_resource(bld, instr, block, &base_ptr, &size);
+
+   offset = cast_type(bld, get_src(bld, offset_src, 0), nir_type_uint, 32);
+   if (base)
+      offset = lp_build_add(uint_bld, offset,
+                            lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                   base));
+   value = cast_type(bld, get_src(bld, data_src[0], 0), nir_type_uint, 32);
+   if (is_cas)
+      new_value = cast_type(bld, get_src(bld, data_src[1], 0),
+                            nir_type_uint, 32);
+   exec_mask = mask_vec(bld);
+   dummy_ptr = lp_build_alloca(gallivm, uint_bld->elem_type, "");
+
+   res = uint_bld->undef;
+   for (i = 0; i < uint_bld->type.length; i++) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+      LLVMValueRef lane_offset =
+         LLVMBuildExtractElement(builder, offset, idx, "");
+      LLVMValueRef lane_value =
+         LLVMBuildExtractElement(builder, value, idx, "");
+      LLVMValueRef ptr =
+         lp_build_mem_lane_ptr(gallivm, base_ptr, size, lane_offset, 0,
+                               lp_build_lane_active(gallivm, exec_mask, idx),
+                               dummy_ptr);
+      LLVMValueRef old;
+
+      if (new_value) {
+#if HAVE_LLVM >= 0x0306
+         old = LLVMBuildAtomicCmpXchg(builder, ptr, lane_value,
+                                      LLVMBuildExtractElement(builder, new_value,
+                                                              idx, ""),
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      FALSE);
+         old = LLVMBuildExtractValue(builder, old, 0, "");
+#else
+         assert(!"atomic compare and swap requires llvm 3.6");
+         old = LLVMBuildLoad(builder, ptr, "");
+#endif
+      }
+      else {
+         old = LLVMBuildAtomicRMW(builder, op, ptr, lane_value,
+                                  LLVMAtomicOrderingSequentiallyConsistent,
+                                  FALSE);
+      }
+      res = LLVMBuildInsertElement(builder, res, old, idx, "");
+   }
+
+   result[0] = res;
+}
+
+
+static void
+visit_get_buffer_size(struct lp_build_nir_soa_context *bld,
+                      nir_intrinsic_instr *instr,
+                      LLVMValueRef *result)
+{
+   LLVMValueRef base_ptr, size;
+
+   mem_resource(bld, instr, &instr->src[0], &base_ptr, &size);
+   result[0] = lp_build_broadcast_scalar(&bld->bld_base.uint_bld, size);
+}
+
+
+static void
+visit_intrinsic(struct lp_build_nir_soa_context *bld,
+                nir_intrinsic_instr *instr)
+{
+   LLVMValueRef result[NIR_MAX_VEC_COMPONENTS] = { NULL };
+
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_uniform:
+      visit_load_uniform(bld, instr, result);
+      break;
+   case nir_intrinsic_load_ubo:
+      visit_load_ubo(bld, instr, result);
+      break;
+   case nir_intrinsic_load_input:
+      visit_load_input(bld, instr, result);
+      break;
+   case nir_intrinsic_load_per_vertex_input:
+      visit_load_per_vertex_input(bld, instr, result);
+      break;
+   case nir_intrinsic_load_output:
+      visit_load_output(bld, instr, result);
+      break;
+   case nir_intrinsic_store_output:
+      visit_store_output(bld, instr);
+      break;
+
+   case nir_intrinsic_load_vertex_id:
+   case nir_intrinsic_load_vertex_id_zero_base:
+   case nir_intrinsic_load_base_vertex:
+   case nir_intrinsic_load_instance_id:
+   case nir_intrinsic_load_primitive_id:
+   case nir_intrinsic_load_invocation_id:
+   case nir_intrinsic_load_local_invocation_id:
+   case nir_intrinsic_load_work_group_id:
+   case nir_intrinsic_load_num_work_groups:
+   case nir_intrinsic_load_local_group_size:
+      visit_load_sysval(bld, instr, result);
+      break;
+
+   case nir_intrinsic_discard:
+      emit_kill(bld, NULL);
+      break;
+   case nir_intrinsic_discard_if:
+      emit_kill(bld, cast_type(bld, get_src(bld, instr->src[0], 0),
+                               nir_type_uint, 32));
+      break;
+
+   case nir_intrinsic_emit_vertex:
+      emit_vertex(bld);
+      break;
+   case nir_intrinsic_end_primitive:
+      end_primitive_masked(bld, mask_vec(bld));
+      break;
+
+   case nir_intrinsic_load_ssbo:
+      visit_load_mem(bld, instr, &instr->src[0], instr->src[1], 0, result);
+      break;
+   case nir_intrinsic_store_ssbo:
+      visit_store_mem(bld, instr, instr->src[0], &instr->src[1],
+                      instr->src[2], 0);
+      break;
+   case nir_intrinsic_load_shared:
+      visit_load_mem(bld, instr, NULL, instr->src[0],
+                     nir_intrinsic_base(instr), result);
+      break;
+   case nir_intrinsic_store_shared:
+      visit_store_mem(bld, instr, instr->src[0], NULL, instr->src[1],
+                      nir_intrinsic_base(instr));
+      break;
+   case nir_intrinsic_ssbo_atomic_add:
+   case nir_intrinsic_ssbo_atomic_imin:
+   case nir_intrinsic_ssbo_atomic_umin:
+   case nir_intrinsic_ssbo_atomic_imax:
+   case nir_intrinsic_ssbo_atomic_umax:
+   case nir_intrinsic_ssbo_atomic_and:
+   case nir_intrinsic_ssbo_atomic_or:
+   case nir_intrinsic_ssbo_atomic_xor:
+   case nir_intrinsic_ssbo_atomic_exchange:
+   case nir_intrinsic_ssbo_atomic_comp_swap:
+      visit_atomic_mem(bld, instr, &instr->src[0], instr->src[1], 0,
+                       &instr->src[2], result);
+      break;
+   case nir_intrinsic_shared_atomic_add:
+   case nir_intrinsic_shared_atomic_imin:
+   case nir_intrinsic_shared_atomic_umin:
+   case nir_intrinsic_shared_atomic_imax:
+   case nir_intrinsic_shared_atomic_umax:
+   case nir_intrinsic_shared_atomic_and:
+   case nir_intrinsic_shared_atomic_or:
+   case nir_intrinsic_shared_atomic_xor:
+   case nir_intrinsic_shared_atomic_exchange:
+   case nir_intrinsic_shared_atomic_comp_swap:
+      visit_atomic_mem(bld, instr, NULL, instr->src[0],
+                       nir_intrinsic_base(instr), &instr->src[1], result);
+      break;
+   case nir_intrinsic_get_buffer_size:
+      visit_get_buffer_size(bld, instr, result);
+      break;
+
+   case nir_intrinsic_barrier:
+      assert(bld->cs_iface);
+      bld->cs_iface->emit_barrier(bld->cs_iface, &bld->bld_base);
+      break;
+   case nir_intrinsic_memory_barrier:
+   case nir_intrinsic_memory_barrier_atomic_counter:
+   case nir_intrinsic_memory_barrier_buffer:
+   case nir_intrinsic_memory_barrier_image:
+   case nir_intrinsic_memory_barrier_shared:
+   case nir_intrinsic_group_memory_barrier:
+      /* all memory accesses are done in program order */
+      break;
+
+   default:
+      _debug_printf("llvmpipe: unhandled nir intrinsic %s\n",
+                    nir_intrinsic_infos[instr->intrinsic].name);
+      assert(0);
+      break;
+   }
+
+   if (nir_intrinsic_infos[instr->intrinsic].has_dest) {
+      unsigned c;
+
+      for (c = 0; c < nir_dest_num_components(instr->dest); c++) {
+         if (!result[c])
+            result[c] = get_int_bld(bld, TRUE,
+                                    nir_dest_bit_size(instr->dest))->undef;
+      }
+      assign_dest(bld, &instr->dest, ~0u, result);
+   }
+}
+
+
+/*
+ * Textures.
+ */
+
+static enum lp_sampler_lod_property
+lod_property(struct lp_build_nir_soa_context *bld,
+             nir_src src)
+{
+   /*
+    * Constants and uniforms are the same for all lanes. Could also check
+    * more complex expressions but that's likely not worth it.
+    */
+   if (src.is_ssa) {
+      nir_instr *parent = src.ssa->parent_instr;
+
+      if (parent->type == nir_instr_type_load_const)
+         return LP_SAMPLER_LOD_SCALAR;
+      if (parent->type == nir_instr_type_intrinsic &&
+          nir_instr_as_intrinsic(parent)->intrinsic == nir_intrinsic_load_uniform)
+         return LP_SAMPLER_LOD_SCALAR;
+   }
+
+   if (bld->shader->info.stage == MESA_SHADER_FRAGMENT) {
+      if (gallivm_debug & GALLIVM_DEBUG_NO_QUAD_LOD)
+         return LP_SAMPLER_LOD_PER_ELEMENT;
+      return LP_SAMPLER_LOD_PER_QUAD;
+   }
+   return LP_SAMPLER_LOD_PER_ELEMENT;
+}
+
+
+static unsigned
+tex_pipe_target(const nir_tex_instr *instr)
+{
+   switch (instr->sampler_dim) {
+   case GLSL_SAMPLER_DIM_1D:
+      return instr->is_array ? PIPE_TEXTURE_1D_ARRAY : PIPE_TEXTURE_1D;
+   case GLSL_SAMPLER_DIM_2D:
+   case GLSL_SAMPLER_DIM_MS:
+   case GLSL_SAMPLER_DIM_EXTERNAL:
+      return instr->is_array ? PIPE_TEXTURE_2D_ARRAY : PIPE_TEXTURE_2D;
+   case GLSL_SAMPLER_DIM_3D:
+      return PIPE_TEXTURE_3D;
+   case GLSL_SAMPLER_DIM_CUBE:
+      return instr->is_array ? PIPE_TEXTURE_CUBE_ARRAY : PIPE_TEXTURE_CUBE;
+   case GLSL_SAMPLER_DIM_RECT:
+      return PIPE_TEXTURE_RECT;
+   case GLSL_SAMPLER_DIM_BUF:
+      return PIPE_BUFFER;
+   default:
+      assert(0);
+      return PIPE_TEXTURE_2D;
+   }
+}
+
+
+static void
+visit_txs(struct lp_build_nir_soa_context *bld,
+          nir_tex_instr *instr,
+          LLVMValueRef *result)
+{
+   struct lp_sampler_size_query_params params;
+   LLVMValueRef sizes_out[4];
+   int lod_idx = nir_tex_instr_src_index(instr, nir_tex_src_lod);
+   unsigned target = tex_pipe_target(instr);
+   unsigned c;
+
+   memset(&params, 0, sizeof(params));
+
+   params.int_type = bld->bld_base.int_bld.type;
+   params.texture_unit = instr->texture_index;
+   params.target = target;
+   params.context_ptr = bld->context_ptr;
+   params.is_sviewinfo = TRUE;
+   params.sizes_out = sizes_out;
+
+   if (target == PIPE_TEXTURE_RECT || target == PIPE_BUFFER) {
+      params.lod_property = LP_SAMPLER_LOD_SCALAR;
+      params.explicit_lod = NULL;
+   }
+   else if (lod_idx >= 0) {
+      params.lod_property = lod_property(bld, instr->src[lod_idx].src);
+      params.explicit_lod = cast_type(bld, get_src(bld, instr->src[lod_idx].src, 0),
+                                      nir_type_int, 32);
+   }
+   else {
+      params.lod_property = LP_SAMPLER_LOD_SCALAR;
+      params.explicit_lod = bld->bld_base.int_bld.zero;
+   }
+
+   bld->sampler->emit_size_query(bld->sampler, bld->bld_base.base.gallivm,
+                                 &params);
+
+   if (instr->op == nir_texop_query_levels) {
+      result[0] = sizes_out[3];
+   }
+   else {
+      for (c = 0; c < nir_dest_num_components(instr->dest); c++)
+         result[c] = sizes_out[c];
+   }
+}
+
+
+static void
+visit_tex(struct lp_build_nir_soa_context *bld,
+          nir_tex_instr *instr)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef result[NIR_MAX_VEC_COMPONENTS] = { NULL };
+   LLVMValueRef coords[5];
+   LLVMValueRef offsets[3] = { NULL };
+   LLVMValueRef lod = NULL;
+   LLVMValueRef texel[4];
+   struct lp_derivatives derivs;
+   struct lp_sampler_params params;
+   enum lp_sampler_lod_property lod_prop = LP_SAMPLER_LOD_SCALAR;
+   unsigned sample_key = 0;
+   unsigned num_dims = instr->coord_components - instr->is_array;
+   boolean is_fetch = instr->op == nir_texop_txf ||
+                      instr->op == nir_texop_txf_ms;
+   unsigned i, c;
+
+   if (!bld->sampler) {
+      _debug_printf("warning: found texture instruction but no sampler generator supplied\n");
+      for (c = 0; c < nir_dest_num_components(instr->dest); c++)
+         result[c] = uint_bld->undef;
+      assign_dest(bld, &instr->dest, ~0u, result);
+      return;
+   }
+
+   if (instr->op == nir_texop_txs ||
+       instr->op == nir_texop_query_levels) {
+      visit_txs(bld, instr, result);
+      assign_dest(bld, &instr->dest, ~0u, result);
+      return;
+   }
+
+   if (instr->op == nir_texop_texture_samples ||
+       instr->op == nir_texop_samples_identical) {
+      /* no multisampling, so every texture has one sample */
+      result[0] = instr->op == nir_texop_texture_samples ?
+         lp_build_const_int_vec(gallivm, uint_bld->type, 1) :
+         LLVMConstAllOnes(uint_bld->vec_type);
+      assign_dest(bld, &instr->dest, ~0u, result);
+      return;
+   }
+
+   switch (instr->op) {
+   case nir_texop_txf:
+   case nir_texop_txf_ms:
+      sample_key = LP_SAMPLER_OP_FETCH << LP_SAMPLER_OP_TYPE_SHIFT;
+      break;
+   case nir_texop_tg4:
+      sample_key = LP_SAMPLER_OP_GATHER << LP_SAMPLER_OP_TYPE_SHIFT;
+      break;
+   case nir_texop_lod:
+      sample_key = LP_SAMPLER_OP_LODQ << LP_SAMPLER_OP_TYPE_SHIFT;
+      break;
+   default:
+      sample_key = LP_SAMPLER_OP_TEXTURE << LP_SAMPLER_OP_TYPE_SHIFT;
+      break;
+   }
+
+   memset(&params, 0, sizeof(params));
+   for (i = 0; i < 5; i++)
+      coords[i] = is_fetch ? bld->bld_base.int_bld.undef :
+                             bld->bld_base.base.undef;
+
+   for (i = 0; i < instr->num_srcs; i++) {
+      nir_src src = instr->src[i].src;
+      nir_alu_type coord_type = is_fetch ? nir_type_int : nir_type_float;
+
+      switch (instr->src[i].src_type) {
+      case nir_tex_src_coord:
+         for (c = 0; c < num_dims; c++)
+            coords[c] = cast_type(bld, get_src(bld, src, c), coord_type, 32);
+         if (instr->is_array) {
+            /* the layer always goes into the 3rd slot, except for cube arrays */
+            LLVMValueRef layer = cast_type(bld, get_src(bld, src, num_dims),
+                                           coord_type, 32);
+            if (instr->sampler_dim == GLSL_SAMPLER_DIM_CUBE)
+               coords[3] = layer;
+            else
+               coords[2] = layer;
+         }
+         break;
+      case nir_tex_src_comparator:
+         sample_key |= LP_SAMPLER_SHADOW;
+         coords[4] = cast_type(bld, get_src(bld, src, 0), nir_type_float, 32);
+         break;
+      case nir_tex_src_bias:
+         sample_key |= LP_SAMPLER_LOD_BIAS << LP_SAMPLER_LOD_CONTROL_SHIFT;
+         lod = cast_type(bld, get_src(bld, src, 0), nir_type_float, 32);
+         lod_prop = lod_property(bld, src);
+         break;
+      case nir_tex_src_lod:
+         /* buffers and multisample textures have no lod */
+         if (instr->sampler_dim == GLSL_SAMPLER_DIM_BUF ||
+             instr->sampler_dim == GLSL_SAMPLER_DIM_MS)
+            break;
+         sample_key |= LP_SAMPLER_LOD_EXPLICIT << LP_SAMPLER_LOD_CONTROL_SHIFT;
+         lod = cast_type(bld, get_src(bld, src, 0),
+                         is_fetch ? nir_type_int : nir_type_float, 32);
+         lod_prop = lod_property(bld, src);
+         break;
+      case nir_tex_src_ddx:
+      case nir_tex_src_ddy: {
+         LLVMValueRef *deriv = instr->src[i].src_type == nir_tex_src_ddx ?
+            derivs.ddx : derivs.ddy;
+         for (c = 0; c < MIN2(num_dims, 3); c++)
+            deriv[c] = cast_type(bld, get_src(bld, src, c), nir_type_float, 32);
+         sample_key |= LP_SAMPLER_LOD_DERIVATIVES << LP_SAMPLER_LOD_CONTROL_SHIFT;
+         params.derivs = &derivs;
+         if (bld->shader->info.stage == MESA_SHADER_FRAGMENT &&
+             !(gallivm_debug & GALLIVM_DEBUG_NO_QUAD_LOD))
+            lod_prop = LP_SAMPLER_LOD_PER_QUAD;
+         else
+            lod_prop = LP_SAMPLER_LOD_PER_ELEMENT;
+         break;
+      }
+      case nir_tex_src_offset:
+         sample_key |= LP_SAMPLER_OFFSETS;
+         for (c = 0; c < nir_src_num_components(src) && c < 3; c++)
+            offsets[c] = cast_type(bld, get_src(bld, src, c), nir_type_int, 32);
+         break;
+      case nir_tex_src_ms_index:
+         /* no multisampling, all samples are the same */
+         break;
+      case nir_tex_src_texture_offset:
+      case nir_tex_src_sampler_offset:
+         /*
+          * Like tgsi, gallivm needs the unit at compile time to look up the
+          * static sampler state. Non constant indices into sampler arrays
+          * have to be dynamically uniform, but still can't be supported.
+          */
+         assert(nir_src_as_const_value(src));
+         break;
+      default:
+         assert(0);
+         break;
+      }
+   }
+
+   sample_key |= lod_prop << LP_SAMPLER_LOD_PROPERTY_SHIFT;
+
+   params.type = bld->bld_base.base.type;
+   params.sample_key = sample_key;
+   params.texture_index = instr->texture_index;
+   /*
+    * sampler not actually used by fetches, set to 0 so it won't exceed
+    * PIPE_MAX_SAMPLERS.
+    */
+   params.sampler_index = is_fetch ? 0 : instr->sampler_index;
+   params.context_ptr = bld->context_ptr;
+   params.thread_data_ptr = bld->thread_data_ptr;
+   params.coords = coords;
+   params.offsets = offsets;
+   params.lod = lod;
+   params.texel = texel;
+
+   bld->sampler->emit_tex_sample(bld->sampler, gallivm, &params);
+
+   for (c = 0; c < nir_dest_num_components(instr->dest); c++)
+      result[c] = texel[c];
+
+   assign_dest(bld, &instr->dest, ~0u, result);
+}
+
+
+/*
+ * Control flow.
+ */
+
+static void
+visit_cf_list(struct lp_build_nir_soa_context *bld,
+              struct exec_list *list);
+
+
+static void
+visit_jump(struct lp_build_nir_soa_context *bld,
+           const nir_jump_instr *instr)
+{
+   switch (instr->type) {
+   case nir_jump_break:
+      lp_exec_break(&bld->exec_mask, &bld->bld_base);
+      break;
+   case nir_jump_continue:
+      lp_exec_continue(&bld->exec_mask);
+      break;
+   default:
+      /* returns are lowered by the state tracker */
+      assert(0);
+      break;
+   }
+}
+
+
+static void
+visit_block(struct lp_build_nir_soa_context *bld,
+            nir_block *block)
+{
+   nir_foreach_instr(instr, block) {
+      switch (instr->type) {
+      case nir_instr_type_alu:
+         visit_alu(bld, nir_instr_as_alu(instr));
+         break;
+      case nir_instr_type_load_const:
+         visit_load_const(bld, nir_instr_as_load_const(instr));
+         break;
+      case nir_instr_type_ssa_undef:
+         visit_ssa_undef(bld, nir_instr_as_ssa_undef(instr));
+         break;
+      case nir_instr_type_intrinsic:
+         visit_intrinsic(bld, nir_instr_as_intrinsic(instr));
+         break;
+      case nir_instr_type_tex:
+         visit_tex(bld, nir_instr_as_tex(instr));
+         break;
+      case nir_instr_type_jump:
+         visit_jump(bld, nir_instr_as_jump(instr));
+         break;
+      case nir_instr_type_deref:
+         /* left over sampler derefs, nothing to do */
+         break;
+      default:
+         /* phis and parallel copies are gone after nir_convert_from_ssa */
+         assert(0);
+         break;
+      }
+   }
+}
+
+
+static void
+visit_if(struct lp_build_nir_soa_context *bld,
+         nir_if *if_stmt)
+{
+   LLVMValueRef cond = cast_type(bld, get_src(bld, if_stmt->condition, 0),
+                                 nir_type_uint, 32);
+
+   lp_exec_mask_cond_push(&bld->exec_mask, cond);
+   visit_cf_list(bld, &if_stmt->then_list);
+
+   if (!exec_list_is_empty(&if_stmt->else_list)) {
+      lp_exec_mask_cond_invert(&bld->exec_mask);
+      visit_cf_list(bld, &if_stmt->else_list);
+   }
+   lp_exec_mask_cond_pop(&bld->exec_mask);
+}
+
+
+static void
+visit_loop(struct lp_build_nir_soa_context *bld,
+           nir_loop *loop)
+{
+   lp_exec_bgnloop(&bld->exec_mask);
+   visit_cf_list(bld, &loop->body);
+   lp_exec_endloop(bld->bld_base.base.gallivm, &bld->exec_mask);
+}
+
+
+static void
+visit_cf_list(struct lp_build_nir_soa_context *bld,
+              struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list) {
+      switch (node->type) {
+      case nir_cf_node_block:
+         visit_block(bld, nir_cf_node_as_block(node));
+         break;
+      case nir_cf_node_if:
+         visit_if(bld, nir_cf_node_as_if(node));
+         break;
+      case nir_cf_node_loop:
+         visit_loop(bld, nir_cf_node_as_loop(node));
+         break;
+      default:
+         assert(0);
+         break;
+      }
+   }
+}
+
+
+/*
+ * Preparation.
+ */
+
+static int
+type_size(const struct glsl_type *type)
+{
+   /* inputs, outputs and (non packed) uniforms are all in vec4 slots */
+   return glsl_count_attribute_slots(type, false);
+}
+
+
+static void
+loops_to_lcssa(struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list) {
+      switch (node->type) {
+      case nir_cf_node_if: {
+         nir_if *if_stmt = nir_cf_node_as_if(node);
+         loops_to_lcssa(&if_stmt->then_list);
+         loops_to_lcssa(&if_stmt->else_list);
+         break;
+      }
+      case nir_cf_node_loop:
+         /* this takes care of nested loops too */
+         nir_convert_loop_to_lcssa(nir_cf_node_as_loop(node));
+         break;
+      default:
+         break;
+      }
+   }
+}
+
+
+void
+lp_build_nir_prepare(struct nir_shader *nir)
+{
+   nir_lower_tex_options tex_options;
+   bool progress;
+
+   memset(&tex_options, 0, sizeof(tex_options));
+   tex_options.lower_txp = ~0u;
+
+   NIR_PASS_V(nir, nir_lower_indirect_derefs,
+              nir_var_shader_in | nir_var_shader_out);
+   NIR_PASS_V(nir, nir_lower_io,
+              nir_var_shader_in | nir_var_shader_out | nir_var_uniform,
+              type_size, (nir_lower_io_options)0);
+   NIR_PASS_V(nir, nir_lower_tex, &tex_options);
+   NIR_PASS_V(nir, nir_lower_vars_to_ssa);
+   NIR_PASS_V(nir, nir_lower_alu_to_scalar);
+
+   do {
+      progress = false;
+      NIR_PASS(progress, nir, nir_copy_prop);
+      NIR_PASS(progress, nir, nir_opt_algebraic);
+      NIR_PASS(progress, nir, nir_opt_constant_folding);
+      NIR_PASS(progress, nir, nir_opt_dce);
+   } while (progress);
+
+   NIR_PASS_V(nir, nir_lower_locals_to_regs);
+   NIR_PASS_V(nir, nir_remove_dead_derefs);
+
+   /*
+    * SSA values which are live past the end of a loop have to go through a
+    * phi (and thus a register), as lanes leave the loop at different
+    * iterations.
+    */
+   nir_foreach_function(func, nir) {
+      if (func->impl)
+         loops_to_lcssa(&func->impl->body);
+   }
+
+   NIR_PASS_V(nir, nir_convert_from_ssa, true);
+
+   nir_foreach_function(func, nir) {
+      if (func->impl) {
+         nir_index_ssa_defs(func->impl);
+         nir_index_local_regs(func->impl);
+      }
+   }
+}
+
+
+/*
+ * Main entry point.
+ */
+
+static void
+emit_prologue(struct lp_build_nir_soa_context *bld)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   const struct tgsi_shader_info *info = bld->bld_base.info;
+   unsigned i, chan;
+
+   /*
+    * Fetch the constant buffer pointers once, see the tgsi translator for
+    * why this matters.
+    */
+   bld->num_const_buffers = MIN2(bld->shader->info.num_ubos + 1,
+                                 LP_MAX_TGSI_CONST_BUFFERS);
+   for (i = 0; i < bld->num_const_buffers; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      bld->consts[i] = lp_build_array_get(gallivm, bld->consts_ptr, index);
+      bld->consts_sizes[i] =
+         lp_build_array_get(gallivm, bld->const_sizes_ptr, index);
+   }
+
+   for (i = 0; i < info->num_outputs; i++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         bld->outputs[i][chan] = lp_build_alloca(gallivm,
+                                                 bld->bld_base.base.vec_type,
+                                                 "output");
+      }
+   }
+
+   if (bld->gs_iface) {
+      struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+      unsigned max_vertices = info->properties[TGSI_PROPERTY_GS_MAX_OUTPUT_VERTICES];
+
+      bld->max_output_vertices_vec =
+         lp_build_const_int_vec(gallivm, bld->bld_base.int_bld.type,
+                                max_vertices ? max_vertices : 32);
+      bld->emitted_prims_vec_ptr =
+         lp_build_alloca(gallivm, uint_bld->vec_type, "emitted_prims_ptr");
+      bld->emitted_vertices_vec_ptr =
+         lp_build_alloca(gallivm, uint_bld->vec_type, "emitted_vertices_ptr");
+      bld->total_emitted_vertices_vec_ptr =
+         lp_build_alloca(gallivm, uint_bld->vec_type,
+                         "total_emitted_vertices_ptr");
+   }
+}
+
+
+static void
+emit_epilogue(struct lp_build_nir_soa_context *bld)
+{
+   if (bld->gs_iface) {
+      LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+      LLVMValueRef total_emitted_vertices_vec, emitted_prims_vec;
+
+      /* flush the primitive of any lane which didn't end it explicitly */
+      end_primitive_masked(bld, lp_build_mask_value(bld->mask));
+
+      total_emitted_vertices_vec =
+         LLVMBuildLoad(builder, bld->total_emitted_vertices_vec_ptr, "");
+      emitted_prims_vec =
+         LLVMBuildLoad(builder, bld->emitted_prims_vec_ptr, "");
+
+      bld->gs_iface->gs_epilogue(bld->gs_iface, &bld->bld_base,
+                                 total_emitted_vertices_vec,
+                                 emitted_prims_vec);
+   }
+}
+
+
+void
+lp_build_nir_soa(struct gallivm_state *gallivm,
+                 struct nir_shader *shader,
+                 struct lp_type type,
+                 struct lp_build_mask_context *mask,
+                 LLVMValueRef consts_ptr,
+                 LLVMValueRef const_sizes_ptr,
+                 const struct lp_bld_tgsi_system_values *system_values,
+                 const LLVMValueRef (*inputs)[TGSI_NUM_CHANNELS],
+                 LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS],
+                 LLVMValueRef context_ptr,
+                 LLVMValueRef thread_data_ptr,
+                 const struct lp_build_sampler_soa *sampler,
+                 const struct tgsi_shader_info *info,
+                 const struct lp_build_tgsi_gs_iface *gs_iface,
+                 const struct lp_build_tgsi_cs_iface *cs_iface)
+{
+   struct lp_build_nir_soa_context bld;
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+
+   assert(type.length <= LP_MAX_VECTOR_LENGTH);
+
+   /* Setup build context */
+   memset(&bld, 0, sizeof bld);
+   lp_build_context_init(&bld.bld_base.base, gallivm, type);
+   lp_build_context_init(&bld.bld_base.uint_bld, gallivm, lp_uint_type(type));
+   lp_build_context_init(&bld.bld_base.int_bld, gallivm, lp_int_type(type));
+   {
+      struct lp_type dbl_type;
+      dbl_type = type;
+      dbl_type.width *= 2;
+      lp_build_context_init(&bld.bld_base.dbl_bld, gallivm, dbl_type);
+   }
+   {
+      struct lp_type uint64_type;
+      uint64_type = lp_uint_type(type);
+      uint64_type.width *= 2;
+      lp_build_context_init(&bld.bld_base.uint64_bld, gallivm, uint64_type);
+   }
+   {
+      struct lp_type int64_type;
+      int64_type = lp_int_type(type);
+      int64_type.width *= 2;
+      lp_build_context_init(&bld.bld_base.int64_bld, gallivm, int64_type);
+   }
+   bld.bld_base.info = info;
+   bld.shader = shader;
+   bld.mask = mask;
+   bld.inputs = inputs;
+   bld.outputs = outputs;
+   bld.consts_ptr = consts_ptr;
+   bld.const_sizes_ptr = const_sizes_ptr;
+   bld.sampler = sampler;
+   bld.context_ptr = context_ptr;
+   bld.thread_data_ptr = thread_data_ptr;
+   bld.gs_iface = gs_iface;
+   bld.cs_iface = cs_iface;
+   if (system_values)
+      bld.system_values = *system_values;
+
+   lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
+
+   if (gallivm_debug & GALLIVM_DEBUG_TGSI) {
+      nir_print_shader(shader, stderr);
+   }
+
+   bld.ssa_defs = CALLOC(impl->ssa_alloc, sizeof(bld.ssa_defs[0]));
+   bld.regs = CALLOC(impl->reg_alloc, sizeof(bld.regs[0]));
+
+   emit_prologue(&bld);
+
+   /* registers are arrays of vectors of their bit size */
+   foreach_list_typed(nir_register, reg, node, &impl->registers) {
+      struct lp_build_context *reg_bld = get_int_bld(&bld, TRUE, reg->bit_size);
+      unsigned num_elems = MAX2(reg->num_array_elems, 1) * reg->num_components;
+
+      bld.regs[reg->index] =
+         lp_build_alloca(gallivm, LLVMArrayType(reg_bld->vec_type, num_elems),
+                         "reg");
+   }
+
+   visit_cf_list(&bld, &impl->body);
+
+   emit_epilogue(&bld);
+
+   FREE(bld.regs);
+   FREE(bld.ssa_defs);
+   lp_exec_mask_fini(&bld.exec_mask);
+}
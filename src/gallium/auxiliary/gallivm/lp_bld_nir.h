@@ -0,0 +1,85 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * NIR to LLVM IR translation -- SoA.
+ *
+ * This is a sibling of lp_build_tgsi_soa(), with the same interface towards
+ * the drivers (inputs/outputs arrays, sampler, gs and cs interfaces), so
+ * that a shader can be handed to gallivm as NIR without a round trip
+ * through TGSI.
+ */
+
+#ifndef LP_BLD_NIR_H
+#define LP_BLD_NIR_H
+
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_tgsi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct nir_shader;
+
+
+/**
+ * Lower a NIR shader, as handed over by the state tracker, into the form
+ * lp_build_nir_soa() consumes: explicit i/o and uniform intrinsics, scalar
+ * alu, and out of SSA form (registers only for phi webs).
+ *
+ * This modifies the shader in place and only needs to be done once, not
+ * for every variant.
+ */
+void
+lp_build_nir_prepare(struct nir_shader *nir);
+
+
+void
+lp_build_nir_soa(struct gallivm_state *gallivm,
+                 struct nir_shader *shader,
+                 struct lp_type type,
+                 struct lp_build_mask_context *mask,
+                 LLVMValueRef consts_ptr,
+                 LLVMValueRef const_sizes_ptr,
+                 const struct lp_bld_tgsi_system_values *system_values,
+                 const LLVMValueRef (*inputs)[4],
+                 LLVMValueRef (*outputs)[4],
+                 LLVMValueRef context_ptr,
+                 LLVMValueRef thread_data_ptr,
+                 const struct lp_build_sampler_soa *sampler,
+                 const struct tgsi_shader_info *info,
+                 const struct lp_build_tgsi_gs_iface *gs_iface,
+                 const struct lp_build_tgsi_cs_iface *cs_iface);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LP_BLD_NIR_H */
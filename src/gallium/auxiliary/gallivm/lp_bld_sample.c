@@ -118,6 +118,7 @@ lp_sampler_static_texture_state(struct lp_static_texture_state *state,
    state->pot_height        = util_is_power_of_two_or_zero(texture->height0);
    state->pot_depth         = util_is_power_of_two_or_zero(texture->depth0);
    state->level_zero_only   = !view->u.tex.last_level;
+   state->tiled             = !!(texture->flags & LP_RESOURCE_FLAG_TILED);
 
    /*
     * the layer / element / level parameters are all either dynamic
@@ -126,6 +127,39 @@ lp_sampler_static_texture_state(struct lp_static_texture_state *state,
 }
 
 
+/**
+ * Initialize lp_sampler_static_texture_state object with the gallium
+ * image view state. Images are always accessed at a single level, with
+ * an identity swizzle.
+ */
+void
+lp_sampler_static_texture_state_image(struct lp_static_texture_state *state,
+                                      const struct pipe_image_view *view)
+{
+   const struct pipe_resource *resource;
+
+   memset(state, 0, sizeof *state);
+
+   if (!view || !view->resource)
+      return;
+
+   resource = view->resource;
+
+   state->format            = view->format;
+   state->swizzle_r         = PIPE_SWIZZLE_X;
+   state->swizzle_g         = PIPE_SWIZZLE_Y;
+   state->swizzle_b         = PIPE_SWIZZLE_Z;
+   state->swizzle_a         = PIPE_SWIZZLE_W;
+
+   state->target            = resource->target;
+   state->pot_width         = util_is_power_of_two_or_zero(resource->width0);
+   state->pot_height        = util_is_power_of_two_or_zero(resource->height0);
+   state->pot_depth         = util_is_power_of_two_or_zero(resource->depth0);
+   state->level_zero_only   = TRUE;
+   state->tiled             = !!(resource->flags & LP_RESOURCE_FLAG_TILED);
+}
+
+
 /**
  * Initialize lp_sampler_static_sampler_state object with the gallium sampler
  * state (this contains the parts which are considered static).
@@ -2023,6 +2057,73 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Compute the partial offset of a pixel block along one axis of a texture,
+ * like lp_build_sample_partial_offset(), but also handling the tiled
+ * layout (see LP_RESOURCE_FLAG_TILED).
+ *
+ * @param tiled   whether the texture has the tiled layout
+ * @param axis    0, 1 or 2 for the x, y or z axis
+ * @param stride  pixel (x), row (y) or image (z) stride in bytes
+ */
+void
+lp_build_sample_axis_offset(struct lp_build_context *bld,
+                            const struct util_format_description *format_desc,
+                            boolean tiled,
+                            unsigned axis,
+                            LLVMValueRef coord,
+                            LLVMValueRef stride,
+                            LLVMValueRef *out_offset,
+                            LLVMValueRef *out_subcoord)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   unsigned block_length;
+
+   if (tiled && axis < 2) {
+      unsigned tile_length, texel_size;
+      LLVMValueRef tile_mask, tile_coord, tile_stride, sub_coord, sub_stride;
+
+      assert(format_desc->block.width == 1 && format_desc->block.height == 1);
+
+      texel_size = format_desc->block.bits / 8;
+      if (axis == 0) {
+         /* the next tile starts after all the rows of this one */
+         tile_length = LP_TEXTURE_TILE_WIDTH;
+         tile_stride = lp_build_mul_imm(bld, stride, LP_TEXTURE_TILE_HEIGHT);
+         sub_stride = stride;
+      }
+      else {
+         /* rows within a tile are one tile width apart */
+         tile_length = LP_TEXTURE_TILE_HEIGHT;
+         tile_stride = stride;
+         sub_stride = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                             LP_TEXTURE_TILE_WIDTH * texel_size);
+      }
+
+      tile_mask = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                         tile_length - 1);
+      sub_coord = LLVMBuildAnd(builder, coord, tile_mask, "");
+      tile_coord = lp_build_andnot(bld, coord, tile_mask);
+
+      *out_offset = lp_build_add(bld,
+                                 lp_build_mul(bld, tile_coord, tile_stride),
+                                 lp_build_mul(bld, sub_coord, sub_stride));
+      *out_subcoord = bld->zero;
+      return;
+   }
+
+   if (axis == 0)
+      block_length = format_desc->block.width;
+   else if (axis == 1)
+      block_length = format_desc->block.height;
+   else
+      block_length = 1; /* pixel blocks are always 2D */
+
+   lp_build_sample_partial_offset(bld, block_length, coord, stride,
+                                  out_offset, out_subcoord);
+}
+
+
 /**
  * Compute the offset of a pixel block.
  *
@@ -2033,6 +2134,7 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -2048,17 +2150,15 @@ lp_build_sample_offset(struct lp_build_context *bld,
    x_stride = lp_build_const_vec(bld->gallivm, bld->type,
                                  format_desc->block.bits/8);
 
-   lp_build_sample_partial_offset(bld,
-                                  format_desc->block.width,
-                                  x, x_stride,
-                                  &offset, out_i);
+   lp_build_sample_axis_offset(bld, format_desc, tiled, 0,
+                               x, x_stride,
+                               &offset, out_i);
 
    if (y && y_stride) {
       LLVMValueRef y_offset;
-      lp_build_sample_partial_offset(bld,
-                                     format_desc->block.height,
-                                     y, y_stride,
-                                     &y_offset, out_j);
+      lp_build_sample_axis_offset(bld, format_desc, tiled, 1,
+                                  y, y_stride,
+                                  &y_offset, out_j);
       offset = lp_build_add(bld, offset, y_offset);
    }
    else {
@@ -2068,10 +2168,9 @@ lp_build_sample_offset(struct lp_build_context *bld,
    if (z && z_stride) {
       LLVMValueRef z_offset;
       LLVMValueRef k;
-      lp_build_sample_partial_offset(bld,
-                                     1, /* pixel blocks are always 2D */
-                                     z, z_stride,
-                                     &z_offset, &k);
+      lp_build_sample_axis_offset(bld, format_desc, tiled, 2,
+                                  z, z_stride,
+                                  &z_offset, &k);
       offset = lp_build_add(bld, offset, z_offset);
    }
 
@@ -36,6 +36,7 @@
 #define LP_BLD_SAMPLE_H
 
 
+#include "pipe/p_defines.h"
 #include "pipe/p_format.h"
 #include "util/u_debug.h"
 #include "gallivm/lp_bld.h"
@@ -48,12 +49,35 @@ extern "C" {
 
 struct pipe_resource;
 struct pipe_sampler_view;
+struct pipe_image_view;
 struct pipe_sampler_state;
 struct util_format_description;
 struct lp_type;
 struct lp_build_context;
 
 
+/**
+ * Tiled texture layout.
+ *
+ * Textures whose pipe_resource::flags have LP_RESOURCE_FLAG_TILED set
+ * store each LP_TEXTURE_TILE_WIDTH x LP_TEXTURE_TILE_HEIGHT tile of texels
+ * contiguously (texels row major within the tile, tiles row major within
+ * the image), so that filtering footprints touch fewer cache lines than
+ * with the usual row by row layout.  Only formats with 1x1 blocks and
+ * targets with a height can be tiled.
+ *
+ * The row and image strides keep their meaning (the bytes between two
+ * texel rows, averaged over a row of tiles, and between two images), so
+ * the width and height must be padded to whole tiles.
+ *
+ * This is a driver private flag; drivers using gallivm for sampling
+ * mustn't use the same bit for anything else.
+ */
+#define LP_RESOURCE_FLAG_TILED (PIPE_RESOURCE_FLAG_DRV_PRIV << 7)
+#define LP_TEXTURE_TILE_WIDTH  4
+#define LP_TEXTURE_TILE_HEIGHT 4
+
+
 /**
  * Helper struct holding all derivatives needed for sampling
  */
@@ -122,6 +146,36 @@ struct lp_sampler_size_query_params
    LLVMValueRef explicit_lod;
    LLVMValueRef *sizes_out;
 };
+
+enum lp_img_op {
+   LP_IMG_LOAD,
+   LP_IMG_STORE,
+   LP_IMG_ATOMIC,
+   LP_IMG_ATOMIC_CAS,
+};
+
+/**
+ * Image (shader image load/store) access.
+ *
+ * Coordinates are integer texel coordinates. Image data is addressed like
+ * a single level of a texture, with the row and image strides being plain
+ * scalars rather than per mip level arrays.
+ */
+struct lp_img_params
+{
+   struct lp_type type;
+   unsigned image_index;
+   unsigned img_op;          /**< LP_IMG_x */
+   unsigned target;          /**< PIPE_TEXTURE_x */
+   LLVMAtomicRMWBinOp op;    /**< for LP_IMG_ATOMIC */
+   LLVMValueRef exec_mask;   /**< lanes which may write */
+   LLVMValueRef context_ptr;
+   const LLVMValueRef *coords;
+   LLVMValueRef indata[4];   /**< data to store, or atomic operand */
+   LLVMValueRef indata2[4];  /**< for LP_IMG_ATOMIC_CAS, the new value */
+   LLVMValueRef *outdata;    /**< loaded texel, or old atomic value */
+};
+
 /**
  * Texture static state.
  *
@@ -143,6 +197,7 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< LP_RESOURCE_FLAG_TILED layout? */
 };
 
 
@@ -226,14 +281,20 @@ struct lp_sampler_dynamic_state
                  LLVMValueRef context_ptr,
                  unsigned texture_unit);
 
-   /** Obtain stride in bytes between image rows/blocks (returns int32) */
+   /**
+    * Obtain stride in bytes between image rows/blocks (returns pointer to
+    * int32 array of per level strides, or for images a plain int32)
+    */
    LLVMValueRef
    (*row_stride)(const struct lp_sampler_dynamic_state *state,
                  struct gallivm_state *gallivm,
                  LLVMValueRef context_ptr,
                  unsigned texture_unit);
 
-   /** Obtain stride in bytes between image slices (returns int32) */
+   /**
+    * Obtain stride in bytes between image slices (returns pointer to
+    * int32 array of per level strides, or for images a plain int32)
+    */
    LLVMValueRef
    (*img_stride)(const struct lp_sampler_dynamic_state *state,
                  struct gallivm_state *gallivm,
@@ -490,6 +551,11 @@ lp_sampler_static_texture_state(struct lp_static_texture_state *state,
                                 const struct pipe_sampler_view *view);
 
 
+void
+lp_sampler_static_texture_state_image(struct lp_static_texture_state *state,
+                                      const struct pipe_image_view *view);
+
+
 void
 lp_build_lod_selector(struct lp_build_sample_context *bld,
                       boolean is_lodq,
@@ -590,9 +656,21 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                LLVMValueRef *out_i);
 
 
+void
+lp_build_sample_axis_offset(struct lp_build_context *bld,
+                            const struct util_format_description *format_desc,
+                            boolean tiled,
+                            unsigned axis,
+                            LLVMValueRef coord,
+                            LLVMValueRef stride,
+                            LLVMValueRef *out_offset,
+                            LLVMValueRef *out_subcoord);
+
+
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -626,6 +704,12 @@ lp_build_size_query_soa(struct gallivm_state *gallivm,
                         struct lp_sampler_dynamic_state *dynamic_state,
                         const struct lp_sampler_size_query_params *params);
 
+void
+lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
+                    struct lp_sampler_dynamic_state *dynamic_state,
+                    struct gallivm_state *gallivm,
+                    const struct lp_img_params *params);
+
 void
 lp_build_sample_nop(struct gallivm_state *gallivm, 
                     struct lp_type type,
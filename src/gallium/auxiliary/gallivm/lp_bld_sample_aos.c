@@ -62,8 +62,7 @@
 /**
  * Build LLVM code for texture coord wrapping, for nearest filtering,
  * for scaled integer texcoords.
- * \param block_length  is the length of the pixel block along the
- *                      coordinate axis
+ * \param axis  0, 1 or 2 for the s, t or r coordinate
  * \param coord  the incoming texcoord (s,t or r) scaled to the texture size
  * \param coord_f  the incoming texcoord (s,t or r) as float vec
  * \param length  the texture size along one dimension
@@ -76,7 +75,7 @@
  */
 static void
 lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
-                                 unsigned block_length,
+                                 unsigned axis,
                                  LLVMValueRef coord,
                                  LLVMValueRef coord_f,
                                  LLVMValueRef length,
@@ -126,8 +125,9 @@ lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
       assert(0);
    }
 
-   lp_build_sample_partial_offset(int_coord_bld, block_length, coord, stride,
-                                  out_offset, out_i);
+   lp_build_sample_axis_offset(int_coord_bld, bld->format_desc,
+                               bld->static_texture_state->tiled, axis,
+                               coord, stride, out_offset, out_i);
 }
 
 
@@ -258,8 +258,7 @@ lp_build_coord_repeat_npot_linear_int(struct lp_build_sample_context *bld,
 /**
  * Build LLVM code for texture coord wrapping, for linear filtering,
  * for scaled integer texcoords.
- * \param block_length  is the length of the pixel block along the
- *                      coordinate axis
+ * \param axis  0, 1 or 2 for the s, t or r coordinate
  * \param coord0  the incoming texcoord (s,t or r) scaled to the texture size
  * \param coord_f  the incoming texcoord (s,t or r) as float vec
  * \param length  the texture size along one dimension
@@ -274,7 +273,7 @@ lp_build_coord_repeat_npot_linear_int(struct lp_build_sample_context *bld,
  */
 static void
 lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
-                                unsigned block_length,
+                                unsigned axis,
                                 LLVMValueRef coord0,
                                 LLVMValueRef *weight_i,
                                 LLVMValueRef coord_f,
@@ -292,17 +291,26 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
    LLVMBuilderRef builder = bld->gallivm->builder;
    LLVMValueRef length_minus_one;
    LLVMValueRef lmask, umask, mask;
+   unsigned block_length;
+
+   if (axis == 0)
+      block_length = bld->format_desc->block.width;
+   else if (axis == 1)
+      block_length = bld->format_desc->block.height;
+   else
+      block_length = 1;
 
    /*
-    * If the pixel block covers more than one pixel then there is no easy
-    * way to calculate offset1 relative to offset0. Instead, compute them
-    * independently. Otherwise, try to compute offset0 and offset1 with
-    * a single stride multiplication.
+    * If the pixel block covers more than one pixel, or the texels are
+    * tiled, then there is no easy way to calculate offset1 relative to
+    * offset0. Instead, compute them independently. Otherwise, try to
+    * compute offset0 and offset1 with a single stride multiplication.
     */
 
    length_minus_one = lp_build_sub(int_coord_bld, length, int_coord_bld->one);
 
-   if (block_length != 1) {
+   if (block_length != 1 ||
+       (bld->static_texture_state->tiled && axis < 2)) {
       LLVMValueRef coord1;
       switch(wrap_mode) {
       case PIPE_TEX_WRAP_REPEAT:
@@ -351,10 +359,12 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
          coord1 = int_coord_bld->zero;
          break;
       }
-      lp_build_sample_partial_offset(int_coord_bld, block_length, coord0, stride,
-                                     offset0, i0);
-      lp_build_sample_partial_offset(int_coord_bld, block_length, coord1, stride,
-                                     offset1, i1);
+      lp_build_sample_axis_offset(int_coord_bld, bld->format_desc,
+                                  bld->static_texture_state->tiled, axis,
+                                  coord0, stride, offset0, i0);
+      lp_build_sample_axis_offset(int_coord_bld, bld->format_desc,
+                                  bld->static_texture_state->tiled, axis,
+                                  coord1, stride, offset1, i1);
       return;
    }
 
@@ -691,7 +701,7 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
 
    /* Do texcoord wrapping, compute texel offset */
    lp_build_sample_wrap_nearest_int(bld,
-                                    bld->format_desc->block.width,
+                                    0, /* axis */
                                     s_ipart, s_float,
                                     width_vec, x_stride, offsets[0],
                                     bld->static_texture_state->pot_width,
@@ -701,7 +711,7 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
    if (dims >= 2) {
       LLVMValueRef y_offset;
       lp_build_sample_wrap_nearest_int(bld,
-                                       bld->format_desc->block.height,
+                                       1, /* axis */
                                        t_ipart, t_float,
                                        height_vec, row_stride_vec, offsets[1],
                                        bld->static_texture_state->pot_height,
@@ -711,7 +721,7 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
       if (dims >= 3) {
          LLVMValueRef z_offset;
          lp_build_sample_wrap_nearest_int(bld,
-                                          1, /* block length (depth) */
+                                          2, /* axis */
                                           r_ipart, r_float,
                                           depth_vec, img_stride_vec, offsets[2],
                                           bld->static_texture_state->pot_depth,
@@ -811,6 +821,7 @@ lp_build_sample_image_nearest_afloat(struct lp_build_sample_context *bld,
     */
    lp_build_sample_offset(&bld->int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x_icoord, y_icoord,
                           z_icoord,
                           row_stride_vec, img_stride_vec,
@@ -1138,7 +1149,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
 
    /* do texcoord wrapping and compute texel offsets */
    lp_build_sample_wrap_linear_int(bld,
-                                   bld->format_desc->block.width,
+                                   0, /* axis */
                                    s_ipart, &s_fpart, s_float,
                                    width_vec, x_stride, offsets[0],
                                    bld->static_texture_state->pot_width,
@@ -1168,7 +1179,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
 
    if (dims >= 2) {
       lp_build_sample_wrap_linear_int(bld,
-                                      bld->format_desc->block.height,
+                                      1, /* axis */
                                       t_ipart, &t_fpart, t_float,
                                       height_vec, y_stride, offsets[1],
                                       bld->static_texture_state->pot_height,
@@ -1188,7 +1199,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
 
    if (dims >= 3) {
       lp_build_sample_wrap_linear_int(bld,
-                                      1, /* block length (depth) */
+                                      2, /* axis */
                                       r_ipart, &r_fpart, r_float,
                                       depth_vec, z_stride, offsets[2],
                                       bld->static_texture_state->pot_depth,
@@ -1306,14 +1317,14 @@ lp_build_sample_image_linear_afloat(struct lp_build_sample_context *bld,
     * cannot do offset calc with floats, difficult for block-based formats,
     * and not enough precision anyway.
     */
-   lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                  bld->format_desc->block.width,
-                                  x_icoord0, x_stride,
-                                  &x_offset0, &x_subcoord[0]);
-   lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                  bld->format_desc->block.width,
-                                  x_icoord1, x_stride,
-                                  &x_offset1, &x_subcoord[1]);
+   lp_build_sample_axis_offset(&bld->int_coord_bld, bld->format_desc,
+                               bld->static_texture_state->tiled, 0,
+                               x_icoord0, x_stride,
+                               &x_offset0, &x_subcoord[0]);
+   lp_build_sample_axis_offset(&bld->int_coord_bld, bld->format_desc,
+                               bld->static_texture_state->tiled, 0,
+                               x_icoord1, x_stride,
+                               &x_offset1, &x_subcoord[1]);
 
    /* add potential cube/array/mip offsets now as they are constant per pixel */
    if (has_layer_coord(bld->static_texture_state->target)) {
@@ -1336,14 +1347,14 @@ lp_build_sample_image_linear_afloat(struct lp_build_sample_context *bld,
    }
 
    if (dims >= 2) {
-      lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                     bld->format_desc->block.height,
-                                     y_icoord0, y_stride,
-                                     &y_offset0, &y_subcoord[0]);
-      lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                     bld->format_desc->block.height,
-                                     y_icoord1, y_stride,
-                                     &y_offset1, &y_subcoord[1]);
+      lp_build_sample_axis_offset(&bld->int_coord_bld, bld->format_desc,
+                                  bld->static_texture_state->tiled, 1,
+                                  y_icoord0, y_stride,
+                                  &y_offset0, &y_subcoord[0]);
+      lp_build_sample_axis_offset(&bld->int_coord_bld, bld->format_desc,
+                                  bld->static_texture_state->tiled, 1,
+                                  y_icoord1, y_stride,
+                                  &y_offset1, &y_subcoord[1]);
       for (z = 0; z < 2; z++) {
          for (x = 0; x < 2; x++) {
             offset[z][0][x] = lp_build_add(&bld->int_coord_bld,
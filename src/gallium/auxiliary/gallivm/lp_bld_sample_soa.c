@@ -139,6 +139,7 @@ lp_build_sample_texel_soa(struct lp_build_sample_context *bld,
    /* convert x,y,z coords to linear offset from start of texture, in bytes */
    lp_build_sample_offset(&bld->int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x, y, z, y_stride, z_stride,
                           &offset, &i, &j);
    if (mipoffsets) {
@@ -2673,6 +2674,7 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
 
    lp_build_sample_offset(int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x, y, z, row_stride_vec, img_stride_vec,
                           &offset, &i, &j);
 
@@ -3433,7 +3435,7 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
       format_desc = util_format_description(static_texture_state->format);
-      if (format_desc && format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      if (format_desc && lp_build_format_cache_supported(format_desc)) {
          need_cache = TRUE;
       }
    }
@@ -3548,7 +3550,7 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
       format_desc = util_format_description(static_texture_state->format);
-      if (format_desc && format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      if (format_desc && lp_build_format_cache_supported(format_desc)) {
          /*
           * This is not 100% correct, if we have cache but the
           * util_format_s3tc_prefer is true the cache won't get used
@@ -3946,3 +3948,200 @@ lp_build_size_query_soa(struct gallivm_state *gallivm,
                                         num_levels);
    }
 }
+
+
+/**
+ * Load from, store to or do an atomic operation on an image.
+ *
+ * Lanes outside the image read zero and don't write, as do all lanes if no
+ * image is bound.
+ */
+void
+lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
+                    struct lp_sampler_dynamic_state *dynamic_state,
+                    struct gallivm_state *gallivm,
+                    const struct lp_img_params *params)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef context_ptr = params->context_ptr;
+   unsigned image_index = params->image_index;
+   unsigned target = params->target;
+   unsigned dims = texture_dims(target);
+   const struct util_format_description *format_desc;
+   struct lp_type int_coord_type = lp_uint_type(params->type);
+   struct lp_build_context int_coord_bld;
+   LLVMValueRef x, y = NULL, z = NULL;
+   LLVMValueRef row_stride_vec = NULL, img_stride_vec = NULL;
+   LLVMValueRef base_ptr, size, in_bounds, offset, i, j;
+   unsigned chan;
+
+   lp_build_context_init(&int_coord_bld, gallivm, int_coord_type);
+
+   if (static_texture_state->format == PIPE_FORMAT_NONE) {
+      if (params->img_op != LP_IMG_STORE) {
+         for (chan = 0; chan < 4; chan++) {
+            params->outdata[chan] = lp_build_zero(gallivm, params->type);
+         }
+      }
+      return;
+   }
+
+   format_desc = util_format_description(static_texture_state->format);
+
+   base_ptr = dynamic_state->base_ptr(dynamic_state, gallivm,
+                                      context_ptr, image_index);
+
+   /* unsigned compares, so negative coordinates are out of bounds too */
+   x = LLVMBuildBitCast(builder, params->coords[0],
+                        int_coord_bld.vec_type, "");
+   size = dynamic_state->width(dynamic_state, gallivm,
+                               context_ptr, image_index);
+   size = lp_build_broadcast_scalar(&int_coord_bld, size);
+   in_bounds = lp_build_cmp(&int_coord_bld, PIPE_FUNC_LESS, x, size);
+
+   if (dims >= 2) {
+      y = LLVMBuildBitCast(builder, params->coords[1],
+                           int_coord_bld.vec_type, "");
+      size = dynamic_state->height(dynamic_state, gallivm,
+                                   context_ptr, image_index);
+      size = lp_build_broadcast_scalar(&int_coord_bld, size);
+      in_bounds = LLVMBuildAnd(builder, in_bounds,
+                               lp_build_cmp(&int_coord_bld, PIPE_FUNC_LESS,
+                                            y, size), "");
+      row_stride_vec = dynamic_state->row_stride(dynamic_state, gallivm,
+                                                 context_ptr, image_index);
+      row_stride_vec = lp_build_broadcast_scalar(&int_coord_bld,
+                                                 row_stride_vec);
+   }
+
+   if (dims >= 3 || has_layer_coord(target)) {
+      /* the layer (or cube face) comes right after the coordinates */
+      z = LLVMBuildBitCast(builder, params->coords[dims == 3 ? 2 : dims],
+                           int_coord_bld.vec_type, "");
+      size = dynamic_state->depth(dynamic_state, gallivm,
+                                  context_ptr, image_index);
+      size = lp_build_broadcast_scalar(&int_coord_bld, size);
+      in_bounds = LLVMBuildAnd(builder, in_bounds,
+                               lp_build_cmp(&int_coord_bld, PIPE_FUNC_LESS,
+                                            z, size), "");
+      img_stride_vec = dynamic_state->img_stride(dynamic_state, gallivm,
+                                                 context_ptr, image_index);
+      img_stride_vec = lp_build_broadcast_scalar(&int_coord_bld,
+                                                 img_stride_vec);
+   }
+
+   lp_build_sample_offset(&int_coord_bld, format_desc,
+                          static_texture_state->tiled,
+                          x, y, z, row_stride_vec, img_stride_vec,
+                          &offset, &i, &j);
+   offset = lp_build_select(&int_coord_bld, in_bounds, offset,
+                            int_coord_bld.zero);
+
+   switch (params->img_op) {
+   case LP_IMG_LOAD: {
+      struct lp_type texel_type = params->type;
+      struct lp_build_context texel_bld;
+
+      if (format_desc->colorspace == UTIL_FORMAT_COLORSPACE_RGB &&
+          format_desc->channel[0].pure_integer) {
+         if (format_desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED) {
+            texel_type = lp_type_int_vec(params->type.width,
+                                         params->type.width *
+                                         params->type.length);
+         }
+         else if (format_desc->channel[0].type == UTIL_FORMAT_TYPE_UNSIGNED) {
+            texel_type = lp_type_uint_vec(params->type.width,
+                                          params->type.width *
+                                          params->type.length);
+         }
+      }
+      lp_build_context_init(&texel_bld, gallivm, texel_type);
+
+      lp_build_fetch_rgba_soa(gallivm, format_desc, texel_type, TRUE,
+                              base_ptr, offset, i, j, NULL, params->outdata);
+      for (chan = 0; chan < 4; chan++) {
+         params->outdata[chan] = lp_build_select(&texel_bld, in_bounds,
+                                                 params->outdata[chan],
+                                                 texel_bld.zero);
+      }
+      break;
+   }
+
+   case LP_IMG_STORE:
+      lp_build_store_rgba_soa(gallivm, format_desc, params->type,
+                              LLVMBuildAnd(builder, params->exec_mask,
+                                           in_bounds, ""),
+                              base_ptr, offset, params->indata);
+      break;
+
+   case LP_IMG_ATOMIC:
+   case LP_IMG_ATOMIC_CAS: {
+      LLVMTypeRef i32_type = LLVMInt32TypeInContext(gallivm->context);
+      LLVMTypeRef i32_ptr_type = LLVMPointerType(i32_type, 0);
+      LLVMValueRef exec_mask, value, new_value = NULL, dummy_ptr, res;
+      unsigned k;
+
+      /* GL only allows atomics on 32 bit single channel formats */
+      assert(format_desc->block.bits == 32);
+
+      exec_mask = LLVMBuildAnd(builder, params->exec_mask, in_bounds, "");
+      value = LLVMBuildBitCast(builder, params->indata[0],
+                               int_coord_bld.vec_type, "");
+      if (params->img_op == LP_IMG_ATOMIC_CAS) {
+         new_value = LLVMBuildBitCast(builder, params->indata2[0],
+                                      int_coord_bld.vec_type, "");
+      }
+      dummy_ptr = lp_build_alloca(gallivm, i32_type, "");
+
+      res = int_coord_bld.undef;
+      for (k = 0; k < int_coord_type.length; k++) {
+         LLVMValueRef idx = lp_build_const_int32(gallivm, k);
+         LLVMValueRef lane_offset =
+            LLVMBuildExtractElement(builder, offset, idx, "");
+         LLVMValueRef lane_value =
+            LLVMBuildExtractElement(builder, value, idx, "");
+         LLVMValueRef active =
+            LLVMBuildExtractElement(builder, exec_mask, idx, "");
+         LLVMValueRef ptr, old;
+
+         active = LLVMBuildICmp(builder, LLVMIntNE, active,
+                                LLVMConstNull(LLVMTypeOf(active)), "");
+         ptr = LLVMBuildGEP(builder, base_ptr, &lane_offset, 1, "");
+         ptr = LLVMBuildBitCast(builder, ptr, i32_ptr_type, "");
+         ptr = LLVMBuildSelect(builder, active, ptr, dummy_ptr, "");
+
+         if (new_value) {
+#if HAVE_LLVM >= 0x0306
+            old = LLVMBuildAtomicCmpXchg(builder, ptr, lane_value,
+                                         LLVMBuildExtractElement(builder,
+                                                                 new_value,
+                                                                 idx, ""),
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         FALSE);
+            old = LLVMBuildExtractValue(builder, old, 0, "");
+#else
+            assert(!"image atomic compare and swap requires llvm 3.6");
+            old = LLVMBuildLoad(builder, ptr, "");
+#endif
+         }
+         else {
+            old = LLVMBuildAtomicRMW(builder, params->op, ptr, lane_value,
+                                     LLVMAtomicOrderingSequentiallyConsistent,
+                                     FALSE);
+         }
+         res = LLVMBuildInsertElement(builder, res, old, idx, "");
+      }
+
+      params->outdata[0] = res;
+      for (chan = 1; chan < 4; chan++) {
+         params->outdata[chan] = int_coord_bld.zero;
+      }
+      break;
+   }
+
+   default:
+      assert(0);
+      break;
+   }
+}
@@ -67,6 +67,8 @@ struct lp_build_mask_context;
 struct gallivm_state;
 struct lp_derivatives;
 struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_cs_iface;
+struct lp_build_tgsi_tess_iface;
 
 
 enum lp_build_tex_modifier {
@@ -170,6 +172,18 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef prim_id;
    LLVMValueRef basevertex;
    LLVMValueRef invocation_id;
+   /* compute shaders: thread_id is a vector per component, the rest are
+    * scalars uniform across the whole launch */
+   LLVMValueRef thread_id[3];
+   LLVMValueRef block_id[3];
+   LLVMValueRef grid_size[3];
+   LLVMValueRef block_size[3];
+   /* tessellation: tess_coord is a vector per component, the levels and
+    * vertices_in are scalars uniform across the patch */
+   LLVMValueRef tess_coord[3];
+   LLVMValueRef tess_outer[4];
+   LLVMValueRef tess_inner[2];
+   LLVMValueRef vertices_in;
 };
 
 
@@ -198,6 +212,29 @@ struct lp_build_sampler_soa
 };
 
 
+/**
+ * Image load/store code generation interface.
+ *
+ * Like the sampler interface, this lets the driver map images to its own
+ * resource layout.
+ */
+struct lp_build_image_soa
+{
+   void
+   (*destroy)( struct lp_build_image_soa *image );
+
+   void
+   (*emit_op)(const struct lp_build_image_soa *image,
+              struct gallivm_state *gallivm,
+              const struct lp_img_params *params);
+
+   void
+   (*emit_size_query)( const struct lp_build_image_soa *image,
+                       struct gallivm_state *gallivm,
+                       const struct lp_sampler_size_query_params *params);
+};
+
+
 struct lp_build_sampler_aos
 {
    LLVMValueRef
@@ -230,7 +267,9 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   const struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface,
+                  const struct lp_build_tgsi_tess_iface *tess_iface);
 
 
 void
@@ -306,6 +345,26 @@ struct lp_exec_mask {
    int function_stack_size;
 };
 
+/*
+ * Execution mask helpers, shared with the NIR translator.
+ * bld_base is only needed by lp_exec_break for breaking out of a switch.
+ */
+void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld);
+void lp_exec_mask_fini(struct lp_exec_mask *mask);
+void lp_exec_mask_cond_push(struct lp_exec_mask *mask, LLVMValueRef val);
+void lp_exec_mask_cond_invert(struct lp_exec_mask *mask);
+void lp_exec_mask_cond_pop(struct lp_exec_mask *mask);
+void lp_exec_bgnloop(struct lp_exec_mask *mask);
+void lp_exec_break(struct lp_exec_mask *mask,
+                   struct lp_build_tgsi_context *bld_base);
+void lp_exec_continue(struct lp_exec_mask *mask);
+void lp_exec_endloop(struct gallivm_state *gallivm,
+                     struct lp_exec_mask *mask);
+void lp_exec_mask_store(struct lp_exec_mask *mask,
+                        struct lp_build_context *bld_store,
+                        LLVMValueRef val,
+                        LLVMValueRef dst_ptr);
+
 struct lp_build_tgsi_inst_list
 {
    struct tgsi_full_instruction *instructions;
@@ -430,6 +489,75 @@ struct lp_build_tgsi_gs_iface
                        LLVMValueRef emitted_prims_vec);
 };
 
+/**
+ * Compute shader resources.
+ *
+ * Shader buffers and shared memory are plain byte addressed memory; the
+ * pointers and sizes (in bytes) are provided by the driver. Images are
+ * accessed through the driver's image code generator. Barriers need
+ * cooperation from whatever schedules the invocations, so they're emitted
+ * by the driver as well.
+ *
+ * Fragment shaders use this for shader buffers (and so atomic counters) too,
+ * leaving the rest unset.
+ */
+struct lp_build_tgsi_cs_iface
+{
+   LLVMValueRef ssbo_ptr;        /**< pointer to array of buffer pointers */
+   LLVMValueRef ssbo_sizes_ptr;  /**< pointer to array of buffer sizes */
+   LLVMValueRef shared_ptr;      /**< shared (TGSI_FILE_MEMORY) memory */
+   LLVMValueRef shared_size;
+   const struct lp_build_image_soa *image;
+   void (*emit_barrier)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                        struct lp_build_tgsi_context *bld_base);
+};
+
+/**
+ * Tessellation control and evaluation shader i/o.
+ *
+ * Both stages address their inputs per vertex of the patch, and the control
+ * shader additionally reads back and writes its outputs, which are shared
+ * between all invocations of a patch. So neither fits the plain inputs[] /
+ * outputs[] arrays, and all of these accesses go through the driver.
+ * vertex_index is NULL for per-patch attributes. Evaluation shaders write
+ * their outputs as usual and leave fetch_output / store_output NULL.
+ */
+struct lp_build_tgsi_tess_iface
+{
+   LLVMValueRef (*fetch_input)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                               struct lp_build_tgsi_context * bld_base,
+                               boolean is_vindex_indirect,
+                               LLVMValueRef vertex_index,
+                               boolean is_aindex_indirect,
+                               LLVMValueRef attrib_index,
+                               LLVMValueRef swizzle_index);
+   LLVMValueRef (*fetch_output)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                struct lp_build_tgsi_context * bld_base,
+                                boolean is_vindex_indirect,
+                                LLVMValueRef vertex_index,
+                                boolean is_aindex_indirect,
+                                LLVMValueRef attrib_index,
+                                LLVMValueRef swizzle_index);
+   void (*store_output)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                        struct lp_build_tgsi_context * bld_base,
+                        boolean is_vindex_indirect,
+                        LLVMValueRef vertex_index,
+                        boolean is_aindex_indirect,
+                        LLVMValueRef attrib_index,
+                        LLVMValueRef swizzle_index,
+                        LLVMValueRef value,
+                        LLVMValueRef mask_vec);
+   /*
+    * Control shaders whose output patch spans several vectors run their
+    * invocations a vector at a time, so at a BARRIER the pass over the
+    * current vector has to end and a pass over the next vector begin, which
+    * this does, returning the new invocation ids.  Left NULL when the patch
+    * fits in one vector.
+    */
+   LLVMValueRef (*emit_barrier)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                struct lp_build_tgsi_context *bld_base);
+};
+
 struct lp_build_tgsi_soa_context
 {
    struct lp_build_tgsi_context bld_base;
@@ -443,6 +571,16 @@ struct lp_build_tgsi_soa_context
    LLVMValueRef emitted_vertices_vec_ptr;
    LLVMValueRef max_output_vertices_vec;
 
+   const struct lp_build_tgsi_cs_iface *cs_iface;
+   LLVMValueRef ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   LLVMValueRef ssbo_sizes[LP_MAX_TGSI_SHADER_BUFFERS];
+
+   const struct lp_build_tgsi_tess_iface *tess_iface;
+   /* Registers of each vector of control shader invocations, kept across
+    * barriers.
+    */
+   LLVMValueRef tess_regs;
+
    LLVMValueRef consts_ptr;
    LLVMValueRef const_sizes_ptr;
    LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
@@ -524,6 +662,20 @@ lp_get_output_ptr(
    unsigned index,
    unsigned chan);
 
+LLVMValueRef
+lp_build_mem_lane_ptr(struct gallivm_state *gallivm,
+                      LLVMValueRef base_ptr,
+                      LLVMValueRef size,
+                      LLVMValueRef offset,
+                      unsigned chan,
+                      LLVMValueRef active,
+                      LLVMValueRef dummy_ptr);
+
+LLVMValueRef
+lp_build_lane_active(struct gallivm_state *gallivm,
+                     LLVMValueRef mask,
+                     LLVMValueRef idx);
+
 struct lp_build_tgsi_aos_context
 {
    struct lp_build_tgsi_context bld_base;
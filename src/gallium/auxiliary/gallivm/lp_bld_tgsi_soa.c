@@ -195,7 +195,7 @@ lp_exec_mask_function_init(struct lp_exec_mask *mask, int function_idx)
       ctx->loop_limiter);
 }
 
-static void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld)
+void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld)
 {
    mask->bld = bld;
    mask->has_mask = FALSE;
@@ -213,7 +213,7 @@ static void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context
    lp_exec_mask_function_init(mask, 0);
 }
 
-static void
+void
 lp_exec_mask_fini(struct lp_exec_mask *mask)
 {
    FREE(mask->function_stack);
@@ -263,8 +263,8 @@ static void lp_exec_mask_update(struct lp_exec_mask *mask)
                      has_ret_mask);
 }
 
-static void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
-                                   LLVMValueRef val)
+void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
+                            LLVMValueRef val)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -285,7 +285,7 @@ static void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
+void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -308,7 +308,7 @@ static void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
+void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
 {
    struct function_ctx *ctx = func_ctx(mask);
    assert(ctx->cond_stack_size);
@@ -319,7 +319,7 @@ static void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_bgnloop(struct lp_exec_mask *mask)
+void lp_exec_bgnloop(struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -352,8 +352,8 @@ static void lp_exec_bgnloop(struct lp_exec_mask *mask)
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_break(struct lp_exec_mask *mask,
-                          struct lp_build_tgsi_context * bld_base)
+void lp_exec_break(struct lp_exec_mask *mask,
+                   struct lp_build_tgsi_context * bld_base)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -403,7 +403,7 @@ static void lp_exec_break(struct lp_exec_mask *mask,
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_continue(struct lp_exec_mask *mask)
+void lp_exec_continue(struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    LLVMValueRef exec_mask = LLVMBuildNot(builder,
@@ -418,8 +418,8 @@ static void lp_exec_continue(struct lp_exec_mask *mask)
 }
 
 
-static void lp_exec_endloop(struct gallivm_state *gallivm,
-                            struct lp_exec_mask *mask)
+void lp_exec_endloop(struct gallivm_state *gallivm,
+                     struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -731,10 +731,10 @@ static void lp_exec_default(struct lp_exec_mask *mask,
  * should be stored into the address
  * (0 means don't store this bit, 1 means do store).
  */
-static void lp_exec_mask_store(struct lp_exec_mask *mask,
-                               struct lp_build_context *bld_store,
-                               LLVMValueRef val,
-                               LLVMValueRef dst_ptr)
+void lp_exec_mask_store(struct lp_exec_mask *mask,
+                        struct lp_build_context *bld_store,
+                        LLVMValueRef val,
+                        LLVMValueRef dst_ptr)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    LLVMValueRef exec_mask = mask->has_mask ? mask->exec_mask : NULL;
@@ -1051,28 +1051,17 @@ emit_mask_scatter(struct lp_build_tgsi_soa_context *bld,
 
 
 /**
- * Read the current value of the ADDR register, convert the floats to
- * ints, add the base index and return the vector of offsets.
- * The offsets will be used to index into the constant buffer or
- * temporary register file.
+ * Load the vector of offsets held by an indirect register.
  */
 static LLVMValueRef
-get_indirect_index(struct lp_build_tgsi_soa_context *bld,
-                   unsigned reg_file, unsigned reg_index,
-                   const struct tgsi_ind_register *indirect_reg)
+get_indirect_rel(struct lp_build_tgsi_soa_context *bld,
+                 const struct tgsi_ind_register *indirect_reg)
 {
    LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
    struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
    /* always use X component of address register */
    unsigned swizzle = indirect_reg->Swizzle;
-   LLVMValueRef base;
    LLVMValueRef rel;
-   LLVMValueRef max_index;
-   LLVMValueRef index;
-
-   assert(bld->indirect_files & (1 << reg_file));
-
-   base = lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type, reg_index);
 
    assert(swizzle < 4);
    switch (indirect_reg->File) {
@@ -1094,6 +1083,31 @@ get_indirect_index(struct lp_build_tgsi_soa_context *bld,
       rel = uint_bld->zero;
    }
 
+   return rel;
+}
+
+/**
+ * Read the current value of the ADDR register, convert the floats to
+ * ints, add the base index and return the vector of offsets.
+ * The offsets will be used to index into the constant buffer or
+ * temporary register file.
+ */
+static LLVMValueRef
+get_indirect_index(struct lp_build_tgsi_soa_context *bld,
+                   unsigned reg_file, unsigned reg_index,
+                   const struct tgsi_ind_register *indirect_reg)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef base;
+   LLVMValueRef rel;
+   LLVMValueRef max_index;
+   LLVMValueRef index;
+
+   assert(bld->indirect_files & (1 << reg_file));
+
+   base = lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type, reg_index);
+   rel = get_indirect_rel(bld, indirect_reg);
+
    index = lp_build_add(uint_bld, base, rel);
 
    /*
@@ -1117,6 +1131,23 @@ get_indirect_index(struct lp_build_tgsi_soa_context *bld,
    return index;
 }
 
+/**
+ * Vertex index of a tessellation shader register with an indirect
+ * dimension. The bounds are those of the patch, which only the driver
+ * knows about, so there's no clamping here.
+ */
+static LLVMValueRef
+get_indirect_vertex_index(struct lp_build_tgsi_soa_context *bld,
+                          unsigned reg_index,
+                          const struct tgsi_ind_register *indirect_reg)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef base;
+
+   base = lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type, reg_index);
+   return lp_build_add(uint_bld, base, get_indirect_rel(bld, indirect_reg));
+}
+
 static struct lp_build_context *
 stype_to_fetch(struct lp_build_tgsi_context * bld_base,
 	       enum tgsi_opcode_type stype)
@@ -1569,6 +1600,82 @@ emit_fetch_gs_input(
    return res;
 }
 
+/**
+ * Fetch a tessellation shader input, or a control shader output. Both are
+ * handed off to the driver, with a NULL vertex index for per-patch
+ * registers (no dimension).
+ */
+static LLVMValueRef
+emit_fetch_tess_reg(
+   struct lp_build_tgsi_context * bld_base,
+   const struct tgsi_full_src_register * reg,
+   enum tgsi_opcode_type stype,
+   unsigned swizzle_in)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   const struct lp_build_tgsi_tess_iface *tess_iface = bld->tess_iface;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef attrib_index = NULL;
+   LLVMValueRef vertex_index = NULL;
+   unsigned swizzle = swizzle_in & 0xffff;
+   LLVMValueRef swizzle_index = lp_build_const_int32(gallivm, swizzle);
+   LLVMValueRef (*fetch)(const struct lp_build_tgsi_tess_iface *,
+                         struct lp_build_tgsi_context *,
+                         boolean, LLVMValueRef,
+                         boolean, LLVMValueRef, LLVMValueRef);
+   LLVMValueRef res;
+
+   fetch = reg->Register.File == TGSI_FILE_OUTPUT ?
+           tess_iface->fetch_output : tess_iface->fetch_input;
+
+   if (reg->Register.Indirect) {
+      attrib_index = get_indirect_index(bld,
+                                        reg->Register.File,
+                                        reg->Register.Index,
+                                        &reg->Indirect);
+   } else {
+      attrib_index = lp_build_const_int32(gallivm, reg->Register.Index);
+   }
+
+   if (reg->Register.Dimension) {
+      if (reg->Dimension.Indirect) {
+         vertex_index = get_indirect_vertex_index(bld,
+                                                  reg->Dimension.Index,
+                                                  &reg->DimIndirect);
+      } else {
+         vertex_index = lp_build_const_int32(gallivm, reg->Dimension.Index);
+      }
+   }
+
+   res = fetch(tess_iface, bld_base,
+               reg->Dimension.Indirect,
+               vertex_index,
+               reg->Register.Indirect,
+               attrib_index,
+               swizzle_index);
+
+   assert(res);
+   if (tgsi_type_is_64bit(stype)) {
+      LLVMValueRef swizzle_index = lp_build_const_int32(gallivm, swizzle_in >> 16);
+      LLVMValueRef res2;
+      res2 = fetch(tess_iface, bld_base,
+                   reg->Dimension.Indirect,
+                   vertex_index,
+                   reg->Register.Indirect,
+                   attrib_index,
+                   swizzle_index);
+      assert(res2);
+      res = emit_fetch_64bit(bld_base, stype, res, res2);
+   } else if (stype == TGSI_TYPE_UNSIGNED) {
+      res = LLVMBuildBitCast(builder, res, bld_base->uint_bld.vec_type, "");
+   } else if (stype == TGSI_TYPE_SIGNED) {
+      res = LLVMBuildBitCast(builder, res, bld_base->int_bld.vec_type, "");
+   }
+
+   return res;
+}
+
 static LLVMValueRef
 emit_fetch_temporary(
    struct lp_build_tgsi_context * bld_base,
@@ -1680,10 +1787,65 @@ emit_fetch_system_value(
       break;
 
    case TGSI_SEMANTIC_INVOCATIONID:
-      res = lp_build_broadcast_scalar(&bld_base->uint_bld, bld->system_values.invocation_id);
+      /* tessellation control shaders run one invocation per lane */
+      if (info->processor == PIPE_SHADER_TESS_CTRL)
+         res = bld->system_values.invocation_id;
+      else
+         res = lp_build_broadcast_scalar(&bld_base->uint_bld, bld->system_values.invocation_id);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_THREAD_ID:
+      res = bld->system_values.thread_id[swizzle_in & 0xffff];
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+      res = lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.block_id[swizzle_in & 0xffff]);
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_GRID_SIZE:
+      res = lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.grid_size[swizzle_in & 0xffff]);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+      res = lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.block_size[swizzle_in & 0xffff]);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_VERTICESIN:
+      res = lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.vertices_in);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_TESSCOORD:
+      res = bld->system_values.tess_coord[swizzle_in & 0xffff];
+      if (!res)
+         res = bld_base->base.zero;
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_TESSOUTER:
+      res = lp_build_broadcast_scalar(&bld_base->base,
+                                      bld->system_values.tess_outer[swizzle_in & 0x3]);
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_TESSINNER:
+      if ((swizzle_in & 0xffff) < 2)
+         res = lp_build_broadcast_scalar(&bld_base->base,
+                                         bld->system_values.tess_inner[swizzle_in & 0xffff]);
+      else
+         res = bld_base->base.zero;
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -1770,6 +1932,52 @@ emit_store_64bit_chan(struct lp_build_tgsi_context *bld_base,
    lp_exec_mask_store(&bld->exec_mask, float_bld, temp2, chan_ptr2);
 }
 
+static LLVMValueRef
+mask_vec(struct lp_build_tgsi_context *bld_base);
+
+/**
+ * Store a tessellation control shader output. These are visible to all the
+ * invocations of the patch, so they live in driver memory rather than in
+ * the outputs[] allocas.
+ */
+static void
+emit_store_tess_output(
+   struct lp_build_tgsi_context *bld_base,
+   const struct tgsi_full_dst_register *reg,
+   LLVMValueRef indirect_index,
+   unsigned chan_index,
+   LLVMValueRef value)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   const struct lp_build_tgsi_tess_iface *tess_iface = bld->tess_iface;
+   LLVMValueRef attrib_index, vertex_index = NULL;
+
+   if (reg->Register.Indirect)
+      attrib_index = indirect_index;
+   else
+      attrib_index = lp_build_const_int32(gallivm, reg->Register.Index);
+
+   if (reg->Register.Dimension) {
+      if (reg->Dimension.Indirect) {
+         vertex_index = get_indirect_vertex_index(bld,
+                                                  reg->Dimension.Index,
+                                                  &reg->DimIndirect);
+      } else {
+         vertex_index = lp_build_const_int32(gallivm, reg->Dimension.Index);
+      }
+   }
+
+   tess_iface->store_output(tess_iface, bld_base,
+                            reg->Dimension.Indirect,
+                            vertex_index,
+                            reg->Register.Indirect,
+                            attrib_index,
+                            lp_build_const_int32(gallivm, chan_index),
+                            value,
+                            mask_vec(bld_base));
+}
+
 /**
  * Register store.
  */
@@ -1824,9 +2032,39 @@ emit_store_chan(
    switch( reg->Register.File ) {
    case TGSI_FILE_OUTPUT:
       /* Outputs are always stored as floats */
+      if (bld->tess_iface && bld->tess_iface->store_output &&
+          tgsi_type_is_64bit(dtype)) {
+         LLVMValueRef shuffles[LP_MAX_VECTOR_WIDTH/32];
+         LLVMValueRef shuffles2[LP_MAX_VECTOR_WIDTH/32];
+         LLVMValueRef lo, hi;
+         unsigned i;
+
+         for (i = 0; i < float_bld->type.length; i++) {
+            shuffles[i] = lp_build_const_int32(gallivm, i * 2);
+            shuffles2[i] = lp_build_const_int32(gallivm, i * 2 + 1);
+         }
+         value = LLVMBuildBitCast(builder, value,
+                                  LLVMVectorType(LLVMFloatTypeInContext(gallivm->context),
+                                                 float_bld->type.length * 2), "");
+         lo = LLVMBuildShuffleVector(builder, value,
+                                     LLVMGetUndef(LLVMTypeOf(value)),
+                                     LLVMConstVector(shuffles,
+                                                     float_bld->type.length), "");
+         hi = LLVMBuildShuffleVector(builder, value,
+                                     LLVMGetUndef(LLVMTypeOf(value)),
+                                     LLVMConstVector(shuffles2,
+                                                     float_bld->type.length), "");
+         emit_store_tess_output(bld_base, reg, indirect_index, chan_index, lo);
+         emit_store_tess_output(bld_base, reg, indirect_index, chan_index + 1, hi);
+         break;
+      }
+
       value = LLVMBuildBitCast(builder, value, float_bld->vec_type, "");
 
-      if (reg->Register.Indirect) {
+      if (bld->tess_iface && bld->tess_iface->store_output) {
+         emit_store_tess_output(bld_base, reg, indirect_index, chan_index, value);
+      }
+      else if (reg->Register.Indirect) {
          LLVMValueRef index_vec;  /* indexes into the output registers */
          LLVMValueRef outputs_array;
          LLVMTypeRef fptr_type;
@@ -2941,6 +3179,19 @@ lp_emit_declaration_soa(
    }
       break;
 
+   case TGSI_FILE_BUFFER:
+      /* Same reasoning as for constants, fetch the pointers only once. */
+      assert(last < LP_MAX_TGSI_SHADER_BUFFERS);
+      assert(bld->cs_iface);
+      for (idx = first; idx <= last; ++idx) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, idx);
+         bld->ssbos[idx] =
+            lp_build_array_get(gallivm, bld->cs_iface->ssbo_ptr, index);
+         bld->ssbo_sizes[idx] =
+            lp_build_array_get(gallivm, bld->cs_iface->ssbo_sizes_ptr, index);
+      }
+      break;
+
    default:
       /* don't need to declare other vars */
       break;
@@ -3494,6 +3745,540 @@ end_primitive(
    }
 }
 
+/*
+ * Shader buffer and shared memory access.
+ *
+ * Memory is byte addressed and every lane may access a different address,
+ * so the accesses are scalarized. Rather than branching around invalid
+ * accesses, lanes which are out of bounds (or masked out, for writes) are
+ * redirected to a private dummy location.
+ */
+static void
+mem_resource(struct lp_build_tgsi_soa_context *bld,
+             unsigned file, unsigned index,
+             LLVMValueRef *base_ptr, LLVMValueRef *size)
+{
+   assert(bld->cs_iface);
+
+   if (file == TGSI_FILE_MEMORY) {
+      *base_ptr = bld->cs_iface->shared_ptr;
+      *size = bld->cs_iface->shared_size;
+   }
+   else {
+      assert(file == TGSI_FILE_BUFFER);
+      assert(index < LP_MAX_TGSI_SHADER_BUFFERS);
+      *base_ptr = bld->ssbos[index];
+      *size = bld->ssbo_sizes[index];
+   }
+}
+
+/**
+ * Return a pointer to the dword at byte offset + 4 * chan, or dummy_ptr if
+ * that is out of bounds or the lane is not active.
+ */
+LLVMValueRef
+lp_build_mem_lane_ptr(struct gallivm_state *gallivm,
+                      LLVMValueRef base_ptr,
+                      LLVMValueRef size,
+                      LLVMValueRef offset,
+                      unsigned chan,
+                      LLVMValueRef active,
+                      LLVMValueRef dummy_ptr)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef bytes = lp_build_const_int32(gallivm, 4 * (chan + 1));
+   LLVMValueRef in_bounds, limit, ptr;
+
+   in_bounds = LLVMBuildICmp(builder, LLVMIntUGE, size, bytes, "");
+   limit = LLVMBuildSub(builder, size, bytes, "");
+   in_bounds = LLVMBuildAnd(builder, in_bounds,
+                            LLVMBuildICmp(builder, LLVMIntULE, offset,
+                                          limit, ""), "");
+   if (active) {
+      in_bounds = LLVMBuildAnd(builder, in_bounds, active, "");
+   }
+
+   offset = LLVMBuildAdd(builder, offset,
+                         lp_build_const_int32(gallivm, 4 * chan), "");
+   ptr = LLVMBuildGEP(builder, base_ptr, &offset, 1, "");
+   ptr = LLVMBuildBitCast(builder, ptr, LLVMTypeOf(dummy_ptr), "");
+
+   return LLVMBuildSelect(builder, in_bounds, ptr, dummy_ptr, "");
+}
+
+LLVMValueRef
+lp_build_lane_active(struct gallivm_state *gallivm,
+                     LLVMValueRef mask,
+                     LLVMValueRef idx)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef lane_mask = LLVMBuildExtractElement(builder, mask, idx, "");
+
+   return LLVMBuildICmp(builder, LLVMIntNE, lane_mask,
+                        LLVMConstNull(LLVMTypeOf(lane_mask)), "");
+}
+
+/**
+ * Image load, store and atomics, which go through the image code generator.
+ */
+static void
+img_op_emit(struct lp_build_tgsi_soa_context *bld,
+            struct lp_build_emit_data *emit_data,
+            unsigned img_op,
+            LLVMAtomicRMWBinOp op)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *coord_reg;
+   unsigned image_index, target, num_coords, chan;
+   LLVMValueRef coords[4], outdata[4];
+   struct lp_img_params params;
+
+   if (img_op == LP_IMG_STORE) {
+      assert(!inst->Dst[0].Register.Indirect);
+      image_index = inst->Dst[0].Register.Index;
+      coord_reg = &inst->Src[0];
+   }
+   else {
+      assert(!inst->Src[0].Register.Indirect);
+      image_index = inst->Src[0].Register.Index;
+      coord_reg = &inst->Src[1];
+   }
+   assert(image_index < LP_MAX_TGSI_SHADER_IMAGES);
+
+   target = tgsi_to_pipe_tex_target(inst->Memory.Texture);
+   num_coords = texture_dims(target);
+   if (target != PIPE_TEXTURE_3D && has_layer_coord(target)) {
+      num_coords++;
+   }
+   for (chan = 0; chan < num_coords; chan++) {
+      coords[chan] = lp_build_emit_fetch_src(bld_base, coord_reg,
+                                             TGSI_TYPE_UNSIGNED, chan);
+   }
+
+   memset(&params, 0, sizeof(params));
+   params.type = bld_base->base.type;
+   params.image_index = image_index;
+   params.img_op = img_op;
+   params.target = target;
+   params.op = op;
+   params.exec_mask = mask_vec(bld_base);
+   params.context_ptr = bld->context_ptr;
+   params.coords = coords;
+   params.outdata = outdata;
+
+   if (img_op == LP_IMG_STORE) {
+      for (chan = 0; chan < 4; chan++) {
+         params.indata[chan] = lp_build_emit_fetch_src(bld_base, &inst->Src[1],
+                                                       TGSI_TYPE_FLOAT, chan);
+      }
+   }
+   else if (img_op != LP_IMG_LOAD) {
+      params.indata[0] = lp_build_emit_fetch_src(bld_base, &inst->Src[2],
+                                                 TGSI_TYPE_UNSIGNED,
+                                                 TGSI_CHAN_X);
+      if (img_op == LP_IMG_ATOMIC_CAS) {
+         params.indata2[0] = lp_build_emit_fetch_src(bld_base, &inst->Src[3],
+                                                     TGSI_TYPE_UNSIGNED,
+                                                     TGSI_CHAN_X);
+      }
+   }
+
+   bld->cs_iface->image->emit_op(bld->cs_iface->image,
+                                 bld_base->base.gallivm, &params);
+
+   if (img_op == LP_IMG_STORE) {
+      return;
+   }
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      /* atomics return the old value in every channel */
+      emit_data->output[chan] = img_op == LP_IMG_LOAD ? outdata[chan] :
+                                                        outdata[0];
+   }
+}
+
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef base_ptr, size, offset, dummy_ptr;
+   unsigned chan, i;
+
+   if (inst->Src[0].Register.File == TGSI_FILE_IMAGE) {
+      img_op_emit(bld, emit_data, LP_IMG_LOAD, 0);
+      return;
+   }
+
+   assert(!inst->Src[0].Register.Indirect);
+   mem_resource(bld, inst->Src[0].Register.File, inst->Src[0].Register.Index,
+                &base_ptr, &size);
+
+   offset = lp_build_emit_fetch_src(bld_base, &inst->Src[1],
+                                    TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   /* zero initialized, out of bounds reads return 0 */
+   dummy_ptr = lp_build_alloca(gallivm, uint_bld->elem_type, "");
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef res = uint_bld->undef;
+
+      for (i = 0; i < uint_bld->type.length; i++) {
+         LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+         LLVMValueRef lane_offset =
+            LLVMBuildExtractElement(builder, offset, idx, "");
+         LLVMValueRef ptr = lp_build_mem_lane_ptr(gallivm, base_ptr, size,
+                                                  lane_offset, chan, NULL,
+                                                  dummy_ptr);
+
+         res = LLVMBuildInsertElement(builder, res,
+                                      LLVMBuildLoad(builder, ptr, ""),
+                                      idx, "");
+      }
+      emit_data->output[chan] = res;
+   }
+}
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef base_ptr, size, offset, exec_mask, dummy_ptr;
+   unsigned chan, i;
+
+   if (inst->Dst[0].Register.File == TGSI_FILE_IMAGE) {
+      img_op_emit(bld, emit_data, LP_IMG_STORE, 0);
+      return;
+   }
+
+   assert(!inst->Dst[0].Register.Indirect);
+   mem_resource(bld, inst->Dst[0].Register.File, inst->Dst[0].Register.Index,
+                &base_ptr, &size);
+
+   offset = lp_build_emit_fetch_src(bld_base, &inst->Src[0],
+                                    TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   exec_mask = mask_vec(bld_base);
+   dummy_ptr = lp_build_alloca_undef(gallivm, uint_bld->elem_type, "");
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef value = lp_build_emit_fetch_src(bld_base, &inst->Src[1],
+                                                   TGSI_TYPE_UNSIGNED, chan);
+
+      for (i = 0; i < uint_bld->type.length; i++) {
+         LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+         LLVMValueRef lane_offset =
+            LLVMBuildExtractElement(builder, offset, idx, "");
+         LLVMValueRef ptr =
+            lp_build_mem_lane_ptr(gallivm, base_ptr, size, lane_offset, chan,
+                                  lp_build_lane_active(gallivm, exec_mask, idx),
+                                  dummy_ptr);
+
+         LLVMBuildStore(builder,
+                        LLVMBuildExtractElement(builder, value, idx, ""),
+                        ptr);
+      }
+   }
+}
+
+static void
+atomic_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef base_ptr, size, offset, value, new_value = NULL;
+   LLVMValueRef exec_mask, dummy_ptr, res;
+   LLVMAtomicRMWBinOp op = LLVMAtomicRMWBinOpXchg;
+   unsigned chan, i;
+
+   switch (inst->Instruction.Opcode) {
+   case TGSI_OPCODE_ATOMUADD:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case TGSI_OPCODE_ATOMXCHG:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case TGSI_OPCODE_ATOMAND:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case TGSI_OPCODE_ATOMOR:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case TGSI_OPCODE_ATOMXOR:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case TGSI_OPCODE_ATOMUMIN:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case TGSI_OPCODE_ATOMUMAX:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case TGSI_OPCODE_ATOMIMIN:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case TGSI_OPCODE_ATOMIMAX:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   case TGSI_OPCODE_ATOMCAS:
+      break;
+   default:
+      assert(0);
+      break;
+   }
+
+   if (inst->Src[0].Register.File == TGSI_FILE_IMAGE) {
+      img_op_emit(bld, emit_data,
+                  inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS ?
+                  LP_IMG_ATOMIC_CAS : LP_IMG_ATOMIC, op);
+      return;
+   }
+
+   assert(!inst->Src[0].Register.Indirect);
+   mem_resource(bld, inst->Src[0].Register.File, inst->Src[0].Register.Index,
+                &base_ptr, &size);
+
+   offset = lp_build_emit_fetch_src(bld_base, &inst->Src[1],
+                                    TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   value = lp_build_emit_fetch_src(bld_base, &inst->Src[2],
+                                   TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+      new_value = lp_build_emit_fetch_src(bld_base, &inst->Src[3],
+                                          TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   }
+   exec_mask = mask_vec(bld_base);
+   dummy_ptr = lp_build_alloca(gallivm, uint_bld->elem_type, "");
+
+   res = uint_bld->undef;
+   for (i = 0; i < uint_bld->type.length; i++) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+      LLVMValueRef lane_offset =
+         LLVMBuildExtractElement(builder, offset, idx, "");
+      LLVMValueRef lane_value =
+         LLVMBuildExtractElement(builder, value, idx, "");
+      LLVMValueRef ptr =
+         lp_build_mem_lane_ptr(gallivm, base_ptr, size, lane_offset, 0,
+                               lp_build_lane_active(gallivm, exec_mask, idx),
+                               dummy_ptr);
+      LLVMValueRef old;
+
+      if (new_value) {
+#if HAVE_LLVM >= 0x0306
+         old = LLVMBuildAtomicCmpXchg(builder, ptr, lane_value,
+                                      LLVMBuildExtractElement(builder, new_value,
+                                                              idx, ""),
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      FALSE);
+         old = LLVMBuildExtractValue(builder, old, 0, "");
+#else
+         assert(!"ATOMCAS requires llvm 3.6");
+         old = LLVMBuildLoad(builder, ptr, "");
+#endif
+      }
+      else {
+         old = LLVMBuildAtomicRMW(builder, op, ptr, lane_value,
+                                  LLVMAtomicOrderingSequentiallyConsistent,
+                                  FALSE);
+      }
+      res = LLVMBuildInsertElement(builder, res, old, idx, "");
+   }
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] = res;
+   }
+}
+
+static void
+resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   unsigned chan;
+
+   assert(!inst->Src[0].Register.Indirect);
+
+   if (inst->Src[0].Register.File == TGSI_FILE_BUFFER) {
+      LLVMValueRef base_ptr, size;
+
+      mem_resource(bld, TGSI_FILE_BUFFER, inst->Src[0].Register.Index,
+                   &base_ptr, &size);
+      TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+         emit_data->output[chan] = chan == TGSI_CHAN_X ?
+            lp_build_broadcast_scalar(uint_bld, size) : uint_bld->zero;
+      }
+   }
+   else {
+      struct lp_sampler_size_query_params params;
+      LLVMValueRef sizes[4];
+
+      assert(inst->Src[0].Register.File == TGSI_FILE_IMAGE);
+
+      memset(&params, 0, sizeof(params));
+      params.int_type = bld_base->int_bld.type;
+      params.texture_unit = inst->Src[0].Register.Index;
+      params.target = tgsi_to_pipe_tex_target(inst->Memory.Texture);
+      params.context_ptr = bld->context_ptr;
+      params.lod_property = LP_SAMPLER_LOD_SCALAR;
+      params.sizes_out = sizes;
+
+      bld->cs_iface->image->emit_size_query(bld->cs_iface->image,
+                                            bld_base->base.gallivm, &params);
+
+      TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+         emit_data->output[chan] = sizes[chan];
+      }
+   }
+}
+
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+
+   if (bld->cs_iface->emit_barrier) {
+      bld->cs_iface->emit_barrier(bld->cs_iface, bld_base);
+   }
+}
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   /* Memory accesses are emitted in program order and atomics are
+    * sequentially consistent, so there's nothing to do here.
+    */
+}
+
+/**
+ * Save or restore the registers of the current vector of control shader
+ * invocations.
+ */
+static void
+tess_pass_regs(struct lp_build_tgsi_soa_context *bld, boolean save)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_shader_info *info = bld_base->info;
+   const unsigned num_temps = info->file_max[TGSI_FILE_TEMPORARY] + 1;
+   const unsigned num_addrs = info->file_max[TGSI_FILE_ADDRESS] + 1;
+   const unsigned pass_size = (num_temps + num_addrs) * TGSI_NUM_CHANNELS;
+   LLVMTypeRef int_vec_ptr_type =
+      LLVMPointerType(bld_base->base.int_vec_type, 0);
+   LLVMValueRef first, offset, regs;
+   unsigned index, chan;
+
+   if (!pass_size)
+      return;
+
+   if (!bld->tess_regs) {
+      const unsigned vertices_out =
+         info->properties[TGSI_PROPERTY_TCS_VERTICES_OUT];
+      const unsigned num_passes =
+         DIV_ROUND_UP(vertices_out, bld_base->base.type.length);
+
+      bld->tess_regs =
+         lp_build_array_alloca(gallivm, bld_base->base.vec_type,
+                               lp_build_const_int32(gallivm,
+                                                    num_passes * pass_size),
+                               "tess_regs");
+   }
+
+   /* Each pass runs the invocations from a multiple of the vector length. */
+   first = LLVMBuildExtractElement(builder, bld->system_values.invocation_id,
+                                   lp_build_const_int32(gallivm, 0), "");
+   offset = LLVMBuildMul(builder,
+                         LLVMBuildUDiv(builder, first,
+                                       lp_build_const_int32(gallivm,
+                                          bld_base->base.type.length), ""),
+                         lp_build_const_int32(gallivm, pass_size), "");
+   regs = LLVMBuildGEP(builder, bld->tess_regs, &offset, 1, "");
+
+   for (index = 0; index < num_temps + num_addrs; index++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         LLVMValueRef slot_index =
+            lp_build_const_int32(gallivm, index * TGSI_NUM_CHANNELS + chan);
+         LLVMValueRef slot = LLVMBuildGEP(builder, regs, &slot_index, 1, "");
+         LLVMValueRef reg;
+
+         if (index < num_temps) {
+            reg = get_file_ptr(bld, TGSI_FILE_TEMPORARY, index, chan);
+         } else {
+            reg = bld->addr[index - num_temps][chan];
+            slot = LLVMBuildBitCast(builder, slot, int_vec_ptr_type, "");
+         }
+
+         /* undeclared */
+         if (!reg)
+            continue;
+
+         if (save)
+            LLVMBuildStore(builder, LLVMBuildLoad(builder, reg, ""), slot);
+         else
+            LLVMBuildStore(builder, LLVMBuildLoad(builder, slot, ""), reg);
+      }
+   }
+}
+
+static void
+tess_barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct lp_exec_mask *mask = &bld->exec_mask;
+   LLVMValueRef all_ones = LLVMConstAllOnes(mask->int_vec_type);
+
+   /* GLSL only allows barrier() in main(), outside of any control flow and
+    * before any return, so the execution mask is just the lane mask.
+    */
+   assert(mask->function_stack_size == 1);
+   assert(!mask_has_cond(mask) && !mask_has_loop(mask) &&
+          !mask_has_switch(mask));
+
+   tess_pass_regs(bld, TRUE);
+   bld->system_values.invocation_id =
+      bld->tess_iface->emit_barrier(bld->tess_iface, bld_base);
+   tess_pass_regs(bld, FALSE);
+
+   /* Nothing computed in the previous pass may be used in this one. */
+   mask->ret_in_main = FALSE;
+   mask->exec_mask = mask->ret_mask = mask->break_mask = mask->cont_mask =
+         mask->cond_mask = mask->switch_mask = all_ones;
+   mask->has_mask = FALSE;
+   LLVMBuildStore(bld_base->base.gallivm->builder,
+                  lp_build_const_int32(bld_base->base.gallivm,
+                                       LP_MAX_TGSI_LOOP_ITERATIONS),
+                  func_ctx(mask)->loop_limiter);
+}
+
 static void
 cal_emit(
    const struct lp_build_tgsi_action * action,
@@ -3708,7 +4493,8 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
 
    /* If we have indirect addressing in inputs we need to copy them into
     * our alloca array to be able to iterate over them */
-   if (bld->indirect_files & (1 << TGSI_FILE_INPUT) && !bld->gs_iface) {
+   if (bld->indirect_files & (1 << TGSI_FILE_INPUT) &&
+       !bld->gs_iface && !bld->tess_iface) {
       unsigned index, chan;
       LLVMTypeRef vec_type = bld_base->base.vec_type;
       LLVMValueRef array_size = lp_build_const_int32(gallivm,
@@ -3760,7 +4546,7 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
    if (DEBUG_EXECUTION) {
       lp_build_printf(gallivm, "\n");
       emit_dump_file(bld, TGSI_FILE_CONSTANT);
-      if (!bld->gs_iface)
+      if (!bld->gs_iface && !bld->tess_iface)
          emit_dump_file(bld, TGSI_FILE_INPUT);
    }
 }
@@ -3817,7 +4603,9 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   const struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface,
+                  const struct lp_build_tgsi_tess_iface *tess_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3947,6 +4735,25 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
    bld.bld_base.op_actions[TGSI_OPCODE_SVIEWINFO].emit = sviewinfo_emit;
    bld.bld_base.op_actions[TGSI_OPCODE_LOD].emit = lod_emit;
 
+   if (cs_iface) {
+      bld.cs_iface = cs_iface;
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUADD].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXCHG].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMCAS].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMAND].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+   }
+
 
    if (gs_iface) {
       /* There's no specific value for this because it should always
@@ -3973,6 +4780,21 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (tess_iface) {
+      bld.tess_iface = tess_iface;
+      bld.bld_base.emit_fetch_funcs[TGSI_FILE_INPUT] = emit_fetch_tess_reg;
+      if (tess_iface->fetch_output) {
+         bld.bld_base.emit_fetch_funcs[TGSI_FILE_OUTPUT] = emit_fetch_tess_reg;
+         /*
+          * Outputs are written straight to memory shared by the patch, and
+          * the invocations run in lock step within a vector, so there's
+          * nothing to wait for unless the patch takes several vectors.
+          */
+         bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit =
+            tess_iface->emit_barrier ? tess_barrier_emit : membar_emit;
+      }
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
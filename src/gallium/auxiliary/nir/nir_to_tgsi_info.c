@@ -0,0 +1,504 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Gather the tgsi_shader_info of a NIR shader.
+ *
+ * Only the fields draw, gallivm and llvmpipe depend on are filled in; the
+ * rest is left zeroed.  The indices of inputs and outputs are the NIR
+ * variables' driver_location, which is also what nir_lower_io() hands to the
+ * backend, so the two always agree.
+ */
+
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "compiler/nir/nir.h"
+#include "compiler/shader_enums.h"
+#include "pipe/p_shader_tokens.h"
+#include "tgsi/tgsi_scan.h"
+#include "tgsi/tgsi_from_mesa.h"
+
+#include "nir_to_tgsi_info.h"
+
+
+/**
+ * Number of vec4 slots covered by an input/output variable.
+ */
+static unsigned
+var_num_slots(const nir_variable *var, const struct glsl_type *type)
+{
+   if (var->data.compact) {
+      /* clip/cull distance arrays are packed into vec4s */
+      return DIV_ROUND_UP(glsl_get_length(type) + var->data.location_frac, 4);
+   }
+   return glsl_count_attribute_slots(type, false);
+}
+
+
+static unsigned
+var_usage_mask(const nir_variable *var, const struct glsl_type *type,
+               unsigned slot, unsigned num_slots)
+{
+   const struct glsl_type *elem = glsl_without_array_or_matrix(type);
+   unsigned comps;
+
+   if (var->data.compact) {
+      unsigned first = slot * 4;
+      unsigned len = glsl_get_length(type) + var->data.location_frac;
+      comps = MIN2(len - first, 4);
+      return u_bit_consecutive(slot ? 0 : var->data.location_frac,
+                               comps - (slot ? 0 : var->data.location_frac));
+   }
+
+   if (glsl_type_is_struct(elem))
+      return TGSI_WRITEMASK_XYZW;
+
+   comps = glsl_get_vector_elements(elem);
+   if (glsl_type_is_64bit(elem)) {
+      /* dvec3/dvec4 take two slots, with the upper one partially used */
+      comps *= 2;
+      if (num_slots > 1 && (slot & 1))
+         comps = comps > 4 ? comps - 4 : 0;
+   }
+   comps = MIN2(comps, 4);
+   if (!comps)
+      return 0;
+
+   return u_bit_consecutive(var->data.location_frac,
+                            MIN2(comps, 4 - var->data.location_frac));
+}
+
+
+static unsigned
+fs_input_interpolate(const nir_variable *var, unsigned semantic_name)
+{
+   switch (var->data.interpolation) {
+   case INTERP_MODE_NONE:
+      if (semantic_name == TGSI_SEMANTIC_COLOR ||
+          semantic_name == TGSI_SEMANTIC_BCOLOR)
+         return TGSI_INTERPOLATE_COLOR;
+      /* fall through */
+   case INTERP_MODE_SMOOTH:
+      return TGSI_INTERPOLATE_PERSPECTIVE;
+   case INTERP_MODE_FLAT:
+      return TGSI_INTERPOLATE_CONSTANT;
+   case INTERP_MODE_NOPERSPECTIVE:
+      return TGSI_INTERPOLATE_LINEAR;
+   default:
+      assert(0);
+      return TGSI_INTERPOLATE_PERSPECTIVE;
+   }
+}
+
+
+static void
+scan_inputs(const struct nir_shader *nir, struct tgsi_shader_info *info,
+            bool need_texcoord)
+{
+   nir_foreach_variable(var, &nir->inputs) {
+      const struct glsl_type *type = var->type;
+      unsigned num_slots, i;
+
+      if (nir_is_per_vertex_io(var, nir->info.stage))
+         type = glsl_get_array_element(type);
+
+      num_slots = var_num_slots(var, type);
+
+      for (i = 0; i < num_slots; i++) {
+         unsigned index = var->data.driver_location + i;
+         unsigned name, sindex, interp;
+
+         if (index >= PIPE_MAX_SHADER_INPUTS)
+            break;
+
+         if (nir->info.stage == MESA_SHADER_VERTEX) {
+            name = TGSI_SEMANTIC_GENERIC;
+            sindex = index;
+            interp = TGSI_INTERPOLATE_CONSTANT;
+         }
+         else if (nir->info.stage == MESA_SHADER_FRAGMENT) {
+            switch (var->data.location) {
+            case VARYING_SLOT_POS:
+               name = TGSI_SEMANTIC_POSITION;
+               sindex = 0;
+               interp = TGSI_INTERPOLATE_LINEAR;
+               info->reads_position = TRUE;
+               info->properties[TGSI_PROPERTY_FS_COORD_ORIGIN] =
+                  var->data.origin_upper_left ?
+                     TGSI_FS_COORD_ORIGIN_UPPER_LEFT :
+                     TGSI_FS_COORD_ORIGIN_LOWER_LEFT;
+               info->properties[TGSI_PROPERTY_FS_COORD_PIXEL_CENTER] =
+                  var->data.pixel_center_integer ?
+                     TGSI_FS_COORD_PIXEL_CENTER_INTEGER :
+                     TGSI_FS_COORD_PIXEL_CENTER_HALF_INTEGER;
+               break;
+            case VARYING_SLOT_FACE:
+               name = TGSI_SEMANTIC_FACE;
+               sindex = 0;
+               interp = TGSI_INTERPOLATE_CONSTANT;
+               info->uses_frontface = TRUE;
+               break;
+            case VARYING_SLOT_PNTC:
+               if (!need_texcoord) {
+                  name = TGSI_SEMANTIC_GENERIC;
+                  sindex = tgsi_get_generic_gl_varying_index(VARYING_SLOT_PNTC,
+                                                             false);
+                  interp = TGSI_INTERPOLATE_LINEAR;
+                  break;
+               }
+               /* fall through */
+            default:
+               tgsi_get_gl_varying_semantic(var->data.location + i,
+                                            need_texcoord, &name, &sindex);
+               if (name == TGSI_SEMANTIC_PRIMID ||
+                   name == TGSI_SEMANTIC_LAYER ||
+                   name == TGSI_SEMANTIC_VIEWPORT_INDEX)
+                  interp = TGSI_INTERPOLATE_CONSTANT;
+               else if (name == TGSI_SEMANTIC_PCOORD)
+                  interp = TGSI_INTERPOLATE_LINEAR;
+               else
+                  interp = fs_input_interpolate(var, name);
+               break;
+            }
+
+            if (name == TGSI_SEMANTIC_PRIMID)
+               info->uses_primid = TRUE;
+            if (name == TGSI_SEMANTIC_COLOR)
+               info->colors_read |= TGSI_WRITEMASK_XYZW << (4 * sindex);
+
+            info->input_interpolate_loc[index] =
+               var->data.sample ? TGSI_INTERPOLATE_LOC_SAMPLE :
+               var->data.centroid ? TGSI_INTERPOLATE_LOC_CENTROID :
+               TGSI_INTERPOLATE_LOC_CENTER;
+         }
+         else {
+            tgsi_get_gl_varying_semantic(var->data.location + i,
+                                         need_texcoord, &name, &sindex);
+            interp = TGSI_INTERPOLATE_PERSPECTIVE;
+         }
+
+         info->input_semantic_name[index] = name;
+         info->input_semantic_index[index] = sindex;
+         info->input_interpolate[index] = interp;
+         info->input_usage_mask[index] |=
+            var_usage_mask(var, type, i, num_slots);
+         info->file_mask[TGSI_FILE_INPUT] |= 1u << (index & 31);
+         info->num_inputs = MAX2(info->num_inputs, index + 1);
+      }
+   }
+
+   info->file_count[TGSI_FILE_INPUT] = info->num_inputs;
+   info->file_max[TGSI_FILE_INPUT] = (int)info->num_inputs - 1;
+}
+
+
+static void
+scan_outputs(const struct nir_shader *nir, struct tgsi_shader_info *info,
+             bool need_texcoord)
+{
+   nir_foreach_variable(var, &nir->outputs) {
+      const struct glsl_type *type = var->type;
+      unsigned num_slots, i;
+
+      if (nir_is_per_vertex_io(var, nir->info.stage))
+         type = glsl_get_array_element(type);
+
+      num_slots = var_num_slots(var, type);
+
+      for (i = 0; i < num_slots; i++) {
+         unsigned index = var->data.driver_location + i;
+         unsigned name, sindex;
+
+         if (index >= PIPE_MAX_SHADER_OUTPUTS)
+            break;
+
+         if (nir->info.stage == MESA_SHADER_FRAGMENT) {
+            tgsi_get_gl_frag_result_semantic(var->data.location + i,
+                                             &name, &sindex);
+            /* second source of dual source blending */
+            sindex += var->data.index;
+
+            switch (var->data.location) {
+            case FRAG_RESULT_DEPTH:
+               info->writes_z = TRUE;
+               break;
+            case FRAG_RESULT_STENCIL:
+               info->writes_stencil = TRUE;
+               break;
+            case FRAG_RESULT_SAMPLE_MASK:
+               info->writes_samplemask = TRUE;
+               break;
+            case FRAG_RESULT_COLOR:
+               info->properties[TGSI_PROPERTY_FS_COLOR0_WRITES_ALL_CBUFS] = 1;
+               break;
+            default:
+               break;
+            }
+            if (name == TGSI_SEMANTIC_COLOR)
+               info->colors_written |= 1 << sindex;
+         }
+         else {
+            tgsi_get_gl_varying_semantic(var->data.location + i,
+                                         need_texcoord, &name, &sindex);
+
+            switch (name) {
+            case TGSI_SEMANTIC_POSITION:
+               info->writes_position = TRUE;
+               break;
+            case TGSI_SEMANTIC_PSIZE:
+               info->writes_psize = TRUE;
+               break;
+            case TGSI_SEMANTIC_CLIPVERTEX:
+               info->writes_clipvertex = TRUE;
+               break;
+            case TGSI_SEMANTIC_PRIMID:
+               info->writes_primid = TRUE;
+               break;
+            case TGSI_SEMANTIC_VIEWPORT_INDEX:
+               info->writes_viewport_index = TRUE;
+               break;
+            case TGSI_SEMANTIC_LAYER:
+               info->writes_layer = TRUE;
+               break;
+            case TGSI_SEMANTIC_EDGEFLAG:
+               info->writes_edgeflag = TRUE;
+               break;
+            default:
+               break;
+            }
+         }
+
+         info->output_semantic_name[index] = name;
+         info->output_semantic_index[index] = sindex;
+         info->output_usagemask[index] |=
+            var_usage_mask(var, type, i, num_slots);
+         info->output_streams[index] = var->data.stream;
+         info->file_mask[TGSI_FILE_OUTPUT] |= 1u << (index & 31);
+         info->num_outputs = MAX2(info->num_outputs, index + 1);
+      }
+   }
+
+   info->file_count[TGSI_FILE_OUTPUT] = info->num_outputs;
+   info->file_max[TGSI_FILE_OUTPUT] = (int)info->num_outputs - 1;
+
+   if (nir->info.stage != MESA_SHADER_FRAGMENT) {
+      info->num_written_clipdistance = nir->info.clip_distance_array_size;
+      info->num_written_culldistance = nir->info.cull_distance_array_size;
+      info->clipdist_writemask =
+         u_bit_consecutive(0, nir->info.clip_distance_array_size);
+      info->culldist_writemask =
+         u_bit_consecutive(0, nir->info.cull_distance_array_size);
+   }
+}
+
+
+static void
+scan_system_values(const struct nir_shader *nir,
+                   struct tgsi_shader_info *info)
+{
+   uint64_t read = nir->info.system_values_read;
+
+#define SV(x) (read & (1ull << SYSTEM_VALUE_##x))
+   info->uses_vertexid = !!SV(VERTEX_ID);
+   info->uses_vertexid_nobase = !!SV(VERTEX_ID_ZERO_BASE);
+   info->uses_basevertex = !!SV(BASE_VERTEX);
+   info->uses_instanceid = !!SV(INSTANCE_ID);
+   info->uses_invocationid = !!SV(INVOCATION_ID);
+   info->uses_primid |= !!SV(PRIMITIVE_ID);
+   info->uses_frontface |= !!SV(FRONT_FACE);
+   info->uses_block_size = !!SV(LOCAL_GROUP_SIZE);
+   info->uses_grid_size = !!SV(NUM_WORK_GROUPS);
+   for (unsigned i = 0; i < 3; i++) {
+      info->uses_thread_id[i] = !!SV(LOCAL_INVOCATION_ID);
+      info->uses_block_id[i] = !!SV(WORK_GROUP_ID);
+   }
+#undef SV
+}
+
+
+static void
+scan_instr(nir_instr *instr, struct tgsi_shader_info *info)
+{
+   info->num_instructions++;
+
+   switch (instr->type) {
+   case nir_instr_type_tex: {
+      nir_tex_instr *tex = nir_instr_as_tex(instr);
+      int max = MAX2(tex->texture_index, tex->sampler_index);
+      info->num_memory_instructions++;
+      info->file_max[TGSI_FILE_SAMPLER] =
+         MAX2(info->file_max[TGSI_FILE_SAMPLER], max);
+      info->file_max[TGSI_FILE_SAMPLER_VIEW] =
+         MAX2(info->file_max[TGSI_FILE_SAMPLER_VIEW], max);
+      if (nir_tex_instr_src_index(tex, nir_tex_src_texture_offset) >= 0 ||
+          nir_tex_instr_src_index(tex, nir_tex_src_sampler_offset) >= 0) {
+         info->indirect_files |= 1 << TGSI_FILE_SAMPLER;
+         info->indirect_files |= 1 << TGSI_FILE_SAMPLER_VIEW;
+      }
+      if (tex->op == nir_texop_tex || tex->op == nir_texop_txb ||
+          tex->op == nir_texop_lod)
+         info->uses_derivatives = TRUE;
+      break;
+   }
+   case nir_instr_type_alu: {
+      nir_alu_instr *alu = nir_instr_as_alu(instr);
+      switch (alu->op) {
+      case nir_op_fddx:
+      case nir_op_fddy:
+      case nir_op_fddx_fine:
+      case nir_op_fddy_fine:
+      case nir_op_fddx_coarse:
+      case nir_op_fddy_coarse:
+         info->uses_derivatives = TRUE;
+         break;
+      default:
+         break;
+      }
+      if (alu->dest.dest.is_ssa && alu->dest.dest.ssa.bit_size == 64)
+         info->uses_doubles = TRUE;
+      break;
+   }
+   case nir_instr_type_intrinsic: {
+      nir_intrinsic_instr *intr = nir_instr_as_intrinsic(instr);
+      switch (intr->intrinsic) {
+      case nir_intrinsic_discard:
+      case nir_intrinsic_discard_if:
+         info->uses_kill = TRUE;
+         break;
+      case nir_intrinsic_barrier:
+         info->opcode_count[TGSI_OPCODE_BARRIER]++;
+         break;
+      case nir_intrinsic_load_ssbo:
+         info->num_memory_instructions++;
+         break;
+      case nir_intrinsic_store_ssbo:
+      case nir_intrinsic_ssbo_atomic_add:
+      case nir_intrinsic_ssbo_atomic_imin:
+      case nir_intrinsic_ssbo_atomic_umin:
+      case nir_intrinsic_ssbo_atomic_imax:
+      case nir_intrinsic_ssbo_atomic_umax:
+      case nir_intrinsic_ssbo_atomic_and:
+      case nir_intrinsic_ssbo_atomic_or:
+      case nir_intrinsic_ssbo_atomic_xor:
+      case nir_intrinsic_ssbo_atomic_exchange:
+      case nir_intrinsic_ssbo_atomic_comp_swap:
+         info->num_memory_instructions++;
+         info->writes_memory = TRUE;
+         break;
+      default:
+         break;
+      }
+      break;
+   }
+   default:
+      break;
+   }
+}
+
+
+void
+nir_tgsi_scan_shader(const struct nir_shader *nir,
+                     struct tgsi_shader_info *info,
+                     bool need_texcoord)
+{
+   unsigned num_buffers;
+
+   memset(info, 0, sizeof(*info));
+   for (unsigned i = 0; i < TGSI_FILE_COUNT; i++)
+      info->file_max[i] = -1;
+   for (unsigned i = 0; i < ARRAY_SIZE(info->const_file_max); i++)
+      info->const_file_max[i] = -1;
+
+   info->processor = pipe_shader_type_from_mesa(nir->info.stage);
+
+   scan_inputs(nir, info, need_texcoord);
+   scan_outputs(nir, info, need_texcoord);
+   scan_system_values(nir, info);
+
+   /* uniforms are counted in vec4 slots */
+   if (nir->num_uniforms > 0) {
+      info->const_file_max[0] = nir->num_uniforms - 1;
+      info->const_buffers_declared |= 1;
+   }
+   if (nir->info.num_ubos)
+      info->const_buffers_declared |=
+         u_bit_consecutive(1, MIN2(nir->info.num_ubos,
+                                   PIPE_MAX_CONSTANT_BUFFERS - 1));
+   info->file_max[TGSI_FILE_CONSTANT] = nir->num_uniforms - 1;
+   info->file_mask[TGSI_FILE_CONSTANT] = info->const_buffers_declared;
+
+   num_buffers = nir->info.num_ssbos + nir->info.num_abos;
+   if (num_buffers) {
+      info->file_max[TGSI_FILE_BUFFER] = num_buffers - 1;
+      info->shader_buffers_declared = u_bit_consecutive(0, MIN2(num_buffers, 32));
+   }
+
+   info->file_max[TGSI_FILE_SAMPLER] = (int)nir->info.num_textures - 1;
+   info->file_max[TGSI_FILE_SAMPLER_VIEW] = (int)nir->info.num_textures - 1;
+
+   nir_foreach_function(func, (nir_shader *)nir) {
+      if (!func->impl)
+         continue;
+      nir_foreach_block(block, func->impl) {
+         nir_foreach_instr(instr, block)
+            scan_instr(instr, info);
+      }
+   }
+
+   info->file_count[TGSI_FILE_SAMPLER] = info->file_max[TGSI_FILE_SAMPLER] + 1;
+   info->file_mask[TGSI_FILE_SAMPLER] =
+      u_bit_consecutive(0, MIN2(info->file_count[TGSI_FILE_SAMPLER], 32));
+   info->file_count[TGSI_FILE_SAMPLER_VIEW] =
+      info->file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+   info->file_mask[TGSI_FILE_SAMPLER_VIEW] =
+      u_bit_consecutive(0, MIN2(info->file_count[TGSI_FILE_SAMPLER_VIEW], 32));
+   info->samplers_declared = info->file_mask[TGSI_FILE_SAMPLER];
+
+   switch (nir->info.stage) {
+   case MESA_SHADER_GEOMETRY:
+      info->properties[TGSI_PROPERTY_GS_INPUT_PRIM] =
+         nir->info.gs.input_primitive;
+      info->properties[TGSI_PROPERTY_GS_OUTPUT_PRIM] =
+         nir->info.gs.output_primitive;
+      info->properties[TGSI_PROPERTY_GS_MAX_OUTPUT_VERTICES] =
+         nir->info.gs.vertices_out;
+      info->properties[TGSI_PROPERTY_GS_INVOCATIONS] =
+         nir->info.gs.invocations;
+      break;
+   case MESA_SHADER_FRAGMENT:
+      info->uses_kill |= nir->info.fs.uses_discard;
+      info->properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL] =
+         nir->info.fs.early_fragment_tests;
+      break;
+   case MESA_SHADER_COMPUTE:
+      info->properties[TGSI_PROPERTY_CS_FIXED_BLOCK_WIDTH] =
+         nir->info.cs.local_size[0];
+      info->properties[TGSI_PROPERTY_CS_FIXED_BLOCK_HEIGHT] =
+         nir->info.cs.local_size[1];
+      info->properties[TGSI_PROPERTY_CS_FIXED_BLOCK_DEPTH] =
+         nir->info.cs.local_size[2];
+      break;
+   default:
+      break;
+   }
+}
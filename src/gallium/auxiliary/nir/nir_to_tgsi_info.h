@@ -0,0 +1,45 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef _NIR_TO_TGSI_INFO_H_
+#define _NIR_TO_TGSI_INFO_H_
+
+#include <stdbool.h>
+
+struct nir_shader;
+struct tgsi_shader_info;
+
+/**
+ * Fill in the subset of tgsi_shader_info which draw and llvmpipe look at
+ * from a NIR shader, so that NIR shaders can be handled by code which was
+ * written against tgsi_scan_shader().
+ *
+ * Input and output indices are the variables' driver_location, in vec4
+ * slots, as assigned by the state tracker.
+ */
+void
+nir_tgsi_scan_shader(const struct nir_shader *nir,
+                     struct tgsi_shader_info *info,
+                     bool need_texcoord);
+
+#endif
@@ -61,6 +61,7 @@
 #include "util/u_half.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_sse.h"
 #include "util/rounding.h"
 
 
@@ -86,14 +87,36 @@ struct tgsi_double_vector {
    union tgsi_double_channel zw;
 };
 
+#if defined(PIPE_ARCH_SSE)
+/*
+ * Channels live in the machine, in the interpreter's stack frames and in the
+ * callers' vertex/quad arrays, so don't rely on them being 16-byte aligned.
+ */
+static inline __m128
+chan_load(const union tgsi_exec_channel *chan)
+{
+   return _mm_loadu_ps(chan->f);
+}
+
+static inline void
+chan_store(union tgsi_exec_channel *chan, __m128 v)
+{
+   _mm_storeu_ps(chan->f, v);
+}
+#endif
+
 static void
 micro_abs(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_andnot_ps(_mm_set1_ps(-0.0f), chan_load(src)));
+#else
    dst->f[0] = fabsf(src->f[0]);
    dst->f[1] = fabsf(src->f[1]);
    dst->f[2] = fabsf(src->f[2]);
    dst->f[3] = fabsf(src->f[3]);
+#endif
 }
 
 static void
@@ -496,10 +519,17 @@ micro_lrp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   const __m128 c = chan_load(src2);
+   chan_store(dst, _mm_add_ps(_mm_mul_ps(chan_load(src0),
+                                         _mm_sub_ps(chan_load(src1), c)),
+                              c));
+#else
    dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
    dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
    dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
    dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
+#endif
 }
 
 static void
@@ -508,10 +538,15 @@ micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_add_ps(_mm_mul_ps(chan_load(src0), chan_load(src1)),
+                              chan_load(src2)));
+#else
    dst->f[0] = src0->f[0] * src1->f[0] + src2->f[0];
    dst->f[1] = src0->f[1] * src1->f[1] + src2->f[1];
    dst->f[2] = src0->f[2] * src1->f[2] + src2->f[2];
    dst->f[3] = src0->f[3] * src1->f[3] + src2->f[3];
+#endif
 }
 
 static void
@@ -1350,10 +1385,14 @@ micro_add(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_add_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] + src1->f[0];
    dst->f[1] = src0->f[1] + src1->f[1];
    dst->f[2] = src0->f[2] + src1->f[2];
    dst->f[3] = src0->f[3] + src1->f[3];
+#endif
 }
 
 static void
@@ -1395,10 +1434,15 @@ micro_max(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   /* same as the C below, NaNs included: the second operand is returned */
+   chan_store(dst, _mm_max_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] > src1->f[0] ? src0->f[0] : src1->f[0];
    dst->f[1] = src0->f[1] > src1->f[1] ? src0->f[1] : src1->f[1];
    dst->f[2] = src0->f[2] > src1->f[2] ? src0->f[2] : src1->f[2];
    dst->f[3] = src0->f[3] > src1->f[3] ? src0->f[3] : src1->f[3];
+#endif
 }
 
 static void
@@ -1406,10 +1450,15 @@ micro_min(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   /* same as the C below, NaNs included: the second operand is returned */
+   chan_store(dst, _mm_min_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] < src1->f[0] ? src0->f[0] : src1->f[0];
    dst->f[1] = src0->f[1] < src1->f[1] ? src0->f[1] : src1->f[1];
    dst->f[2] = src0->f[2] < src1->f[2] ? src0->f[2] : src1->f[2];
    dst->f[3] = src0->f[3] < src1->f[3] ? src0->f[3] : src1->f[3];
+#endif
 }
 
 static void
@@ -1417,10 +1466,14 @@ micro_mul(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_mul_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] * src1->f[0];
    dst->f[1] = src0->f[1] * src1->f[1];
    dst->f[2] = src0->f[2] * src1->f[2];
    dst->f[3] = src0->f[3] * src1->f[3];
+#endif
 }
 
 static void
@@ -1428,10 +1481,14 @@ micro_neg(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src )
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_xor_ps(_mm_set1_ps(-0.0f), chan_load(src)));
+#else
    dst->f[0] = -src->f[0];
    dst->f[1] = -src->f[1];
    dst->f[2] = -src->f[2];
    dst->f[3] = -src->f[3];
+#endif
 }
 
 static void
@@ -1469,10 +1526,14 @@ micro_sub(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_sub_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] - src1->f[0];
    dst->f[1] = src0->f[1] - src1->f[1];
    dst->f[2] = src0->f[2] - src1->f[2];
    dst->f[3] = src0->f[3] - src1->f[3];
+#endif
 }
 
 static void
@@ -1586,6 +1647,80 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
    }
 }
 
+/**
+ * Fetch a directly addressed source register channel, which is what nearly
+ * all instructions read, without going through per-pixel index vectors.
+ * \return FALSE if the register needs fetch_src_file_channel()
+ */
+static inline boolean
+fetch_direct_source(const struct tgsi_exec_machine *mach,
+                    union tgsi_exec_channel *chan,
+                    const struct tgsi_full_src_register *reg,
+                    const uint swizzle)
+{
+   const int index = reg->Register.Index;
+   uint i;
+
+   if (reg->Register.Indirect)
+      return FALSE;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_CONSTANT:
+      {
+         const uint constbuf =
+            reg->Register.Dimension ? reg->Dimension.Index : 0;
+         const int pos = index * 4 + swizzle;
+         uint value;
+
+         if (reg->Register.Dimension && reg->Dimension.Indirect)
+            return FALSE;
+
+         assert(constbuf < PIPE_MAX_CONSTANT_BUFFERS);
+         assert(mach->Consts[constbuf]);
+
+         /* same bounds check as fetch_src_file_channel() */
+         if (index < 0 || pos >= (int) mach->ConstsSize[constbuf])
+            value = 0;
+         else
+            value = ((const uint *) mach->Consts[constbuf])[pos];
+
+         for (i = 0; i < TGSI_QUAD_SIZE; i++)
+            chan->u[i] = value;
+      }
+      return TRUE;
+
+   case TGSI_FILE_INPUT:
+      if (reg->Register.Dimension)
+         return FALSE;
+      *chan = mach->Inputs[index].xyzw[swizzle];
+      return TRUE;
+
+   case TGSI_FILE_SYSTEM_VALUE:
+      if (reg->Register.Dimension)
+         return FALSE;
+      *chan = mach->SystemValue[index].xyzw[swizzle];
+      return TRUE;
+
+   case TGSI_FILE_TEMPORARY:
+      if (reg->Register.Dimension)
+         return FALSE;
+      assert(index < TGSI_EXEC_NUM_TEMPS);
+      *chan = mach->Temps[index].xyzw[swizzle];
+      return TRUE;
+
+   case TGSI_FILE_IMMEDIATE:
+      if (reg->Register.Dimension)
+         return FALSE;
+      assert(index >= 0 && index < (int) mach->ImmLimit);
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         chan->f[i] = mach->Imms[index][swizzle];
+      return TRUE;
+
+   default:
+      return FALSE;
+   }
+}
+
 static void
 fetch_source_d(const struct tgsi_exec_machine *mach,
                union tgsi_exec_channel *chan,
@@ -1596,6 +1731,11 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
    union tgsi_exec_channel index2D;
    uint swizzle;
 
+   if (fetch_direct_source(mach, chan, reg,
+                           tgsi_util_get_full_src_register_swizzle(reg,
+                                                                   chan_index)))
+      return;
+
    /* We start with a direct index into a register file.
     *
     *    file[1],
@@ -1962,6 +2102,21 @@ store_dest(struct tgsi_exec_machine *mach,
    if (!dst)
       return;
 
+   /* all pixels/vertices enabled: store the channel as a whole */
+   if (execmask == (1 << TGSI_QUAD_SIZE) - 1) {
+      if (!inst->Instruction.Saturate) {
+         *dst = *chan;
+         return;
+      }
+#if defined(PIPE_ARCH_SSE)
+      /* keeps NaNs and -0.0 like the C path below */
+      chan_store(dst, _mm_min_ps(_mm_set1_ps(1.0f),
+                                 _mm_max_ps(_mm_setzero_ps(),
+                                            chan_load(chan))));
+      return;
+#endif
+   }
+
    if (!inst->Instruction.Saturate) {
       for (i = 0; i < TGSI_QUAD_SIZE; i++)
          if (execmask & (1 << i))
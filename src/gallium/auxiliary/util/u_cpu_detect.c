@@ -36,6 +36,7 @@
 
 #include "u_debug.h"
 #include "u_cpu_detect.h"
+#include "u_math.h"
 #include "c11/threads.h"
 
 #if defined(PIPE_ARCH_PPC)
@@ -59,6 +60,9 @@
 #endif
 
 #if defined(PIPE_OS_LINUX)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <elf.h>
@@ -367,10 +371,111 @@ check_os_arm_support(void)
 }
 #endif /* PIPE_ARCH_ARM */
 
+#if defined(PIPE_OS_LINUX)
+/**
+ * Read the list of CPUs sharing the L3 cache of the given CPU from sysfs,
+ * e.g. "0-5,12-17", into a mask.
+ */
+static boolean
+read_L3_cpu_list(unsigned cpu, uint32_t *mask)
+{
+   char path[128], buf[1024];
+   unsigned index;
+   char *p;
+   FILE *f;
+
+   /* The index of the L3 among the caches varies, look for level 3 */
+   for (index = 0; ; index++) {
+      int level = 0;
+
+      snprintf(path, sizeof(path),
+               "/sys/devices/system/cpu/cpu%u/cache/index%u/level", cpu, index);
+      f = fopen(path, "r");
+      if (!f)
+         return FALSE;
+      if (fscanf(f, "%d", &level) != 1)
+         level = 0;
+      fclose(f);
+      if (level == 3)
+         break;
+   }
+
+   snprintf(path, sizeof(path),
+            "/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list",
+            cpu, index);
+   f = fopen(path, "r");
+   if (!f)
+      return FALSE;
+   p = fgets(buf, sizeof(buf), f);
+   fclose(f);
+   if (!p)
+      return FALSE;
+
+   memset(mask, 0, UTIL_MAX_CPUS / 8);
+   while (*p >= '0' && *p <= '9') {
+      unsigned long first = strtoul(p, &p, 10), last = first, i;
+
+      if (*p == '-')
+         last = strtoul(p + 1, &p, 10);
+      for (i = first; i <= last && i < UTIL_MAX_CPUS; i++)
+         mask[i / 32] |= 1u << (i % 32);
+      if (*p == ',')
+         p++;
+   }
+   return TRUE;
+}
+
+
+/**
+ * Get the L3 cache of each CPU from sysfs, which knows about how the CPUs
+ * are actually numbered (e.g. SMT siblings numbered after all cores).
+ */
+static void
+get_L3_topology_sysfs(void)
+{
+   uint32_t assigned[UTIL_MAX_CPUS / 32] = { 0 };
+   uint32_t mask[UTIL_MAX_CPUS / 32];
+   unsigned num_L3_caches = 0, cpu, i;
+   long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+   num_cpus = MIN2(MAX2(num_cpus, util_cpu_caps.nr_cpus), UTIL_MAX_CPUS);
+
+   for (cpu = 0; cpu < (unsigned)num_cpus; cpu++) {
+      unsigned count = 0;
+
+      if (assigned[cpu / 32] & (1u << (cpu % 32)))
+         continue;
+      /* Offline CPUs have no cache directory */
+      if (!read_L3_cpu_list(cpu, mask))
+         continue;
+
+      for (i = 0; i < UTIL_MAX_CPUS; i++) {
+         if (mask[i / 32] & (1u << (i % 32)) &&
+             !(assigned[i / 32] & (1u << (i % 32)))) {
+            util_cpu_caps.cpu_to_L3[i] = num_L3_caches;
+            assigned[i / 32] |= 1u << (i % 32);
+            count++;
+         }
+      }
+      if (!count)
+         continue;
+
+      if (!num_L3_caches)
+         util_cpu_caps.cores_per_L3 = count;
+      num_L3_caches++;
+   }
+
+   if (num_L3_caches)
+      util_cpu_caps.num_L3_caches = num_L3_caches;
+}
+#endif /* PIPE_OS_LINUX */
+
+
 static void
 get_cpu_topology(void)
 {
    uint32_t regs[4];
+   unsigned i;
 
    /* Default. This is correct if L3 is not present or there is only one. */
    util_cpu_caps.cores_per_L3 = util_cpu_caps.nr_cpus;
@@ -386,6 +491,40 @@ get_cpu_topology(void)
       if (cache_level == 3)
          util_cpu_caps.cores_per_L3 = cores_per_cache;
    }
+   else if (util_cpu_caps.has_intel) {
+      cpuid(0x00000000, regs);
+
+      /* Deterministic cache parameters, one subleaf per cache */
+      for (i = 0; regs[0] >= 4 && i < 16; i++) {
+         uint32_t cache_regs[4];
+
+         cpuid_count(0x00000004, i, cache_regs);
+         if ((cache_regs[0] & 0x1f) == 0)
+            break;
+         if (((cache_regs[0] >> 5) & 0x7) == 3) {
+            /* This is the number of IDs reserved for the sharing logical
+             * processors, which can be rounded up to a power of two.
+             */
+            util_cpu_caps.cores_per_L3 =
+               MIN2(((cache_regs[0] >> 14) & 0xfff) + 1,
+                    (unsigned)util_cpu_caps.nr_cpus);
+            break;
+         }
+      }
+   }
+#endif
+
+   /* Without better information, assume that CPUs sharing an L3 are
+    * numbered consecutively.
+    */
+   util_cpu_caps.cores_per_L3 = MAX2(util_cpu_caps.cores_per_L3, 1);
+   util_cpu_caps.num_L3_caches =
+      DIV_ROUND_UP(util_cpu_caps.nr_cpus, util_cpu_caps.cores_per_L3);
+   for (i = 0; i < UTIL_MAX_CPUS; i++)
+      util_cpu_caps.cpu_to_L3[i] = i / util_cpu_caps.cores_per_L3;
+
+#if defined(PIPE_OS_LINUX)
+   get_L3_topology_sysfs();
 #endif
 }
 
@@ -550,6 +689,8 @@ util_cpu_detect_once(void)
 
       debug_printf("util_cpu_caps.x86_cpu_type = %u\n", util_cpu_caps.x86_cpu_type);
       debug_printf("util_cpu_caps.cacheline = %u\n", util_cpu_caps.cacheline);
+      debug_printf("util_cpu_caps.cores_per_L3 = %u\n", util_cpu_caps.cores_per_L3);
+      debug_printf("util_cpu_caps.num_L3_caches = %u\n", util_cpu_caps.num_L3_caches);
 
       debug_printf("util_cpu_caps.has_tsc = %u\n", util_cpu_caps.has_tsc);
       debug_printf("util_cpu_caps.has_mmx = %u\n", util_cpu_caps.has_mmx);
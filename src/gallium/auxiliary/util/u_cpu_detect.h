@@ -45,6 +45,10 @@ extern "C" {
 #endif
 
 
+/** Highest CPU number + 1 the topology information covers */
+#define UTIL_MAX_CPUS 1024
+
+
 struct util_cpu_caps {
    int nr_cpus;
 
@@ -53,6 +57,14 @@ struct util_cpu_caps {
    unsigned cacheline;
    unsigned cores_per_L3;
 
+   /**
+    * Number of L3 caches, and the L3 cache each CPU (by OS CPU number) is
+    * attached to.  Where the OS doesn't tell, CPUs are assumed to be
+    * numbered consecutively, cores_per_L3 per cache.
+    */
+   unsigned num_L3_caches;
+   uint16_t cpu_to_L3[UTIL_MAX_CPUS];
+
    unsigned has_intel:1;
    unsigned has_tsc:1;
    unsigned has_mmx:1;
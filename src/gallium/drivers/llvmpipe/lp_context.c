@@ -43,8 +43,12 @@
 #include "lp_flush.h"
 #include "lp_perf.h"
 #include "lp_state.h"
+#include "lp_state_cs.h"
 #include "lp_surface.h"
 #include "lp_query.h"
+#include "lp_rast.h"
+#include "lp_debug.h"
+#include "lp_screen.h"
 #include "lp_setup.h"
 
 /* This is only safe if there's just one concurrent context */
@@ -57,7 +61,13 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    uint i, j;
 
-   lp_print_counters();
+   if (LP_DEBUG & DEBUG_COUNTERS) {
+      struct lp_counters counters = llvmpipe->counters;
+
+      /* the rasterizer threads are shared by all contexts of the screen */
+      lp_rast_add_counters(llvmpipe_screen(pipe->screen)->rast, &counters);
+      lp_print_counters(&counters);
+   }
 
    if (llvmpipe->blitter) {
       util_blitter_destroy(llvmpipe->blitter);
@@ -71,6 +81,8 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
    if (llvmpipe->draw)
       draw_destroy( llvmpipe->draw );
 
+   llvmpipe_cleanup_compute(llvmpipe);
+
    for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
       pipe_surface_reference(&llvmpipe->framebuffer.cbufs[i], NULL);
    }
@@ -89,6 +101,14 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
       pipe_sampler_view_reference(&llvmpipe->sampler_views[PIPE_SHADER_GEOMETRY][i], NULL);
    }
 
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->sampler_views[0]); i++) {
+      pipe_sampler_view_reference(&llvmpipe->sampler_views[PIPE_SHADER_TESS_CTRL][i], NULL);
+   }
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->sampler_views[0]); i++) {
+      pipe_sampler_view_reference(&llvmpipe->sampler_views[PIPE_SHADER_TESS_EVAL][i], NULL);
+   }
+
    for (i = 0; i < ARRAY_SIZE(llvmpipe->constants); i++) {
       for (j = 0; j < ARRAY_SIZE(llvmpipe->constants[i]); j++) {
          pipe_resource_reference(&llvmpipe->constants[i][j].buffer, NULL);
@@ -171,6 +191,8 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe_init_fs_funcs(llvmpipe);
    llvmpipe_init_vs_funcs(llvmpipe);
    llvmpipe_init_gs_funcs(llvmpipe);
+   llvmpipe_init_tess_funcs(llvmpipe);
+   llvmpipe_init_compute_funcs(llvmpipe);
    llvmpipe_init_rasterizer_funcs(llvmpipe);
    llvmpipe_init_context_resource_funcs( &llvmpipe->pipe );
    llvmpipe_init_surface_functions(llvmpipe);
@@ -225,7 +247,11 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    draw_wide_point_threshold(llvmpipe->draw, 10000.0);
    draw_wide_line_threshold(llvmpipe->draw, 10000.0);
 
-   lp_reset_counters();
+   /* shade vertices on the screen's threads, shared with other contexts */
+   if (llvmpipe_screen(screen)->num_threads > 1 &&
+       util_queue_is_initialized(&llvmpipe_screen(screen)->worker_queue))
+      draw_set_vs_queue(llvmpipe->draw,
+                        &llvmpipe_screen(screen)->worker_queue);
 
    /* If llvmpipe_set_scissor_states() is never called, we still need to
     * make sure that derived scissor state is computed.
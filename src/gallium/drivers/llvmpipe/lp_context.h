@@ -41,6 +41,7 @@
 #include "lp_setup.h"
 #include "lp_state_fs.h"
 #include "lp_state_setup.h"
+#include "lp_perf.h"
 
 
 struct llvmpipe_vbuf_render;
@@ -52,6 +53,8 @@ struct lp_blend_state;
 struct lp_setup_context;
 struct lp_setup_variant;
 struct lp_velems_state;
+struct lp_compute_shader;
+struct lp_cs_worker;
 
 struct llvmpipe_context {
    struct pipe_context pipe;  /**< base class */
@@ -65,8 +68,11 @@ struct llvmpipe_context {
    struct lp_fragment_shader *fs;
    struct draw_vertex_shader *vs;
    const struct lp_geometry_shader *gs;
+   struct draw_tess_ctrl_shader *tcs;
+   struct draw_tess_eval_shader *tes;
    const struct lp_velems_state *velems;
    const struct lp_so_state *so;
+   struct lp_compute_shader *cs;
 
    /** Other rendering state */
    unsigned sample_mask;
@@ -78,6 +84,8 @@ struct llvmpipe_context {
    struct pipe_poly_stipple poly_stipple;
    struct pipe_scissor_state scissors[PIPE_MAX_VIEWPORTS];
    struct pipe_sampler_view *sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct pipe_shader_buffer ssbos[PIPE_SHADER_TYPES][LP_MAX_TGSI_SHADER_BUFFERS];
+   struct pipe_image_view images[LP_MAX_TGSI_SHADER_IMAGES];  /**< compute only */
 
    struct pipe_viewport_state viewports[PIPE_MAX_VIEWPORTS];
    struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
@@ -94,6 +102,9 @@ struct llvmpipe_context {
    struct pipe_query_data_pipeline_statistics pipeline_statistics;
    unsigned active_statistics_queries;
 
+   /** Binning and compile counters, the rasterizer's are per thread */
+   struct lp_counters counters;
+
    unsigned active_occlusion_queries;
 
    unsigned dirty; /**< Mask of LP_NEW_x flags */
@@ -136,12 +147,16 @@ struct llvmpipe_context {
    struct blitter_context *blitter;
 
    unsigned tex_timestamp;
+   unsigned tex_layout_timestamp;
 
    /** List of all fragment shader variants */
    struct lp_fs_variant_list_item fs_variants_list;
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Bound fs variant still waiting for its optimized code */
+   struct lp_fragment_shader_variant *fs_variant_pending;
+
    struct lp_setup_variant_list_item setup_variants_list;
    unsigned nr_setup_variants;
 
@@ -152,6 +167,9 @@ struct llvmpipe_context {
 
    /** The LLVMContext to use for LLVM related work */
    LLVMContextRef context;
+
+   /** State for running compute workgroups on the calling thread */
+   struct lp_cs_worker *cs_worker;
 };
 
 
@@ -37,6 +37,7 @@
 #include "util/u_prim.h"
 
 #include "lp_context.h"
+#include "lp_flush.h"
 #include "lp_state.h"
 #include "lp_query.h"
 
@@ -44,6 +45,33 @@
 
 
 
+/**
+ * The draw module samples textures right away, so make sure scenes still
+ * in flight are done rendering to the ones its shaders use.
+ */
+static void
+llvmpipe_flush_draw_sampler_views(struct llvmpipe_context *lp)
+{
+   static const enum pipe_shader_type shaders[] = {
+      PIPE_SHADER_VERTEX,
+      PIPE_SHADER_GEOMETRY,
+      PIPE_SHADER_TESS_CTRL,
+      PIPE_SHADER_TESS_EVAL,
+   };
+   unsigned i, j;
+
+   for (i = 0; i < ARRAY_SIZE(shaders); i++) {
+      for (j = 0; j < lp->num_sampler_views[shaders[i]]; j++) {
+         struct pipe_sampler_view *view = lp->sampler_views[shaders[i]][j];
+
+         if (view)
+            llvmpipe_flush_resource(&lp->pipe, view->texture, 0,
+                                    TRUE, TRUE, FALSE, "vertex sampling");
+      }
+   }
+}
+
+
 /**
  * Draw vertex arrays, with optional indexing, optional instancing.
  * All the other drawing functions are implemented in terms of this function.
@@ -66,6 +94,9 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
       return;
    }
 
+   if (lp->fs_variant_pending)
+      llvmpipe_poll_fs_variant(lp);
+
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
@@ -109,12 +140,19 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    draw_set_mapped_so_targets(draw, lp->num_so_targets,
                               lp->so_targets);
 
+   llvmpipe_flush_draw_sampler_views(lp);
    llvmpipe_prepare_vertex_sampling(lp,
                                     lp->num_sampler_views[PIPE_SHADER_VERTEX],
                                     lp->sampler_views[PIPE_SHADER_VERTEX]);
    llvmpipe_prepare_geometry_sampling(lp,
                                       lp->num_sampler_views[PIPE_SHADER_GEOMETRY],
                                       lp->sampler_views[PIPE_SHADER_GEOMETRY]);
+   llvmpipe_prepare_tess_ctrl_sampling(lp,
+                                       lp->num_sampler_views[PIPE_SHADER_TESS_CTRL],
+                                       lp->sampler_views[PIPE_SHADER_TESS_CTRL]);
+   llvmpipe_prepare_tess_eval_sampling(lp,
+                                       lp->num_sampler_views[PIPE_SHADER_TESS_EVAL],
+                                       lp->sampler_views[PIPE_SHADER_TESS_EVAL]);
    if (lp->gs && lp->gs->no_tokens) {
       /* we have an empty geometry shader with stream output, so
          attach the stream output info to the current vertex shader */
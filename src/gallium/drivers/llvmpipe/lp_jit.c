@@ -39,6 +39,139 @@
 #include "gallivm/lp_bld_format.h"
 #include "lp_context.h"
 #include "lp_jit.h"
+#include "lp_state_cs.h"
+
+
+static LLVMTypeRef
+create_jit_texture_type(struct gallivm_state *gallivm)
+{
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef texture_type;
+   LLVMTypeRef elem_types[LP_JIT_TEXTURE_NUM_FIELDS];
+
+   elem_types[LP_JIT_TEXTURE_WIDTH]  =
+   elem_types[LP_JIT_TEXTURE_HEIGHT] =
+   elem_types[LP_JIT_TEXTURE_DEPTH] =
+   elem_types[LP_JIT_TEXTURE_FIRST_LEVEL] =
+   elem_types[LP_JIT_TEXTURE_LAST_LEVEL] = LLVMInt32TypeInContext(lc);
+   elem_types[LP_JIT_TEXTURE_BASE] = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+   elem_types[LP_JIT_TEXTURE_ROW_STRIDE] =
+   elem_types[LP_JIT_TEXTURE_IMG_STRIDE] =
+   elem_types[LP_JIT_TEXTURE_MIP_OFFSETS] =
+      LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TEXTURE_LEVELS);
+
+   texture_type = LLVMStructTypeInContext(lc, elem_types,
+                                          ARRAY_SIZE(elem_types), 0);
+
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, width,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_WIDTH);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, height,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_HEIGHT);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, depth,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_DEPTH);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, first_level,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_FIRST_LEVEL);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, last_level,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_LAST_LEVEL);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, base,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_BASE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, row_stride,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_ROW_STRIDE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, img_stride,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_IMG_STRIDE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, mip_offsets,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_MIP_OFFSETS);
+   LP_CHECK_STRUCT_SIZE(struct lp_jit_texture,
+                        gallivm->target, texture_type);
+
+   return texture_type;
+}
+
+
+static LLVMTypeRef
+create_jit_sampler_type(struct gallivm_state *gallivm)
+{
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef sampler_type;
+   LLVMTypeRef elem_types[LP_JIT_SAMPLER_NUM_FIELDS];
+
+   elem_types[LP_JIT_SAMPLER_MIN_LOD] =
+   elem_types[LP_JIT_SAMPLER_MAX_LOD] =
+   elem_types[LP_JIT_SAMPLER_LOD_BIAS] = LLVMFloatTypeInContext(lc);
+   elem_types[LP_JIT_SAMPLER_BORDER_COLOR] =
+      LLVMArrayType(LLVMFloatTypeInContext(lc), 4);
+
+   sampler_type = LLVMStructTypeInContext(lc, elem_types,
+                                          ARRAY_SIZE(elem_types), 0);
+
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, min_lod,
+                          gallivm->target, sampler_type,
+                          LP_JIT_SAMPLER_MIN_LOD);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, max_lod,
+                          gallivm->target, sampler_type,
+                          LP_JIT_SAMPLER_MAX_LOD);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, lod_bias,
+                          gallivm->target, sampler_type,
+                          LP_JIT_SAMPLER_LOD_BIAS);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, border_color,
+                          gallivm->target, sampler_type,
+                          LP_JIT_SAMPLER_BORDER_COLOR);
+   LP_CHECK_STRUCT_SIZE(struct lp_jit_sampler,
+                        gallivm->target, sampler_type);
+
+   return sampler_type;
+}
+
+
+static LLVMTypeRef
+create_jit_image_type(struct gallivm_state *gallivm)
+{
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef image_type;
+   LLVMTypeRef elem_types[LP_JIT_IMAGE_NUM_FIELDS];
+
+   elem_types[LP_JIT_IMAGE_WIDTH] =
+   elem_types[LP_JIT_IMAGE_HEIGHT] =
+   elem_types[LP_JIT_IMAGE_DEPTH] = LLVMInt32TypeInContext(lc);
+   elem_types[LP_JIT_IMAGE_BASE] = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+   elem_types[LP_JIT_IMAGE_ROW_STRIDE] =
+   elem_types[LP_JIT_IMAGE_IMG_STRIDE] = LLVMInt32TypeInContext(lc);
+
+   image_type = LLVMStructTypeInContext(lc, elem_types,
+                                        ARRAY_SIZE(elem_types), 0);
+
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, width,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_WIDTH);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, height,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_HEIGHT);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, depth,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_DEPTH);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, base,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_BASE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, row_stride,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_ROW_STRIDE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, img_stride,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_IMG_STRIDE);
+   LP_CHECK_STRUCT_SIZE(struct lp_jit_image,
+                        gallivm->target, image_type);
+
+   return image_type;
+}
 
 
 static void
@@ -68,82 +201,8 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
                            gallivm->target, viewport_type);
    }
 
-   /* struct lp_jit_texture */
-   {
-      LLVMTypeRef elem_types[LP_JIT_TEXTURE_NUM_FIELDS];
-
-      elem_types[LP_JIT_TEXTURE_WIDTH]  =
-      elem_types[LP_JIT_TEXTURE_HEIGHT] =
-      elem_types[LP_JIT_TEXTURE_DEPTH] =
-      elem_types[LP_JIT_TEXTURE_FIRST_LEVEL] =
-      elem_types[LP_JIT_TEXTURE_LAST_LEVEL] = LLVMInt32TypeInContext(lc);
-      elem_types[LP_JIT_TEXTURE_BASE] = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
-      elem_types[LP_JIT_TEXTURE_ROW_STRIDE] =
-      elem_types[LP_JIT_TEXTURE_IMG_STRIDE] =
-      elem_types[LP_JIT_TEXTURE_MIP_OFFSETS] =
-         LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TEXTURE_LEVELS);
-
-      texture_type = LLVMStructTypeInContext(lc, elem_types,
-                                             ARRAY_SIZE(elem_types), 0);
-
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, width,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_WIDTH);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, height,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_HEIGHT);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, depth,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_DEPTH);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, first_level,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_FIRST_LEVEL);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, last_level,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_LAST_LEVEL);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, base,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_BASE);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, row_stride,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_ROW_STRIDE);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, img_stride,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_IMG_STRIDE);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, mip_offsets,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_MIP_OFFSETS);
-      LP_CHECK_STRUCT_SIZE(struct lp_jit_texture,
-                           gallivm->target, texture_type);
-   }
-
-   /* struct lp_jit_sampler */
-   {
-      LLVMTypeRef elem_types[LP_JIT_SAMPLER_NUM_FIELDS];
-      elem_types[LP_JIT_SAMPLER_MIN_LOD] =
-      elem_types[LP_JIT_SAMPLER_MAX_LOD] =
-      elem_types[LP_JIT_SAMPLER_LOD_BIAS] = LLVMFloatTypeInContext(lc);
-      elem_types[LP_JIT_SAMPLER_BORDER_COLOR] =
-         LLVMArrayType(LLVMFloatTypeInContext(lc), 4);
-
-      sampler_type = LLVMStructTypeInContext(lc, elem_types,
-                                             ARRAY_SIZE(elem_types), 0);
-
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, min_lod,
-                             gallivm->target, sampler_type,
-                             LP_JIT_SAMPLER_MIN_LOD);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, max_lod,
-                             gallivm->target, sampler_type,
-                             LP_JIT_SAMPLER_MAX_LOD);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, lod_bias,
-                             gallivm->target, sampler_type,
-                             LP_JIT_SAMPLER_LOD_BIAS);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, border_color,
-                             gallivm->target, sampler_type,
-                             LP_JIT_SAMPLER_BORDER_COLOR);
-      LP_CHECK_STRUCT_SIZE(struct lp_jit_sampler,
-                           gallivm->target, sampler_type);
-   }
+   texture_type = create_jit_texture_type(gallivm);
+   sampler_type = create_jit_sampler_type(gallivm);
 
    /* struct lp_jit_context */
    {
@@ -164,6 +223,10 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
                                                       PIPE_MAX_SHADER_SAMPLER_VIEWS);
       elem_types[LP_JIT_CTX_SAMPLERS] = LLVMArrayType(sampler_type,
                                                       PIPE_MAX_SAMPLERS);
+      elem_types[LP_JIT_CTX_SSBOS] =
+         LLVMArrayType(LLVMPointerType(LLVMInt8TypeInContext(lc), 0), LP_MAX_TGSI_SHADER_BUFFERS);
+      elem_types[LP_JIT_CTX_NUM_SSBOS] =
+            LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_SHADER_BUFFERS);
 
       context_type = LLVMStructTypeInContext(lc, elem_types,
                                              ARRAY_SIZE(elem_types), 0);
@@ -198,6 +261,12 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
       LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, samplers,
                              gallivm->target, context_type,
                              LP_JIT_CTX_SAMPLERS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, ssbos,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_SSBOS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, num_ssbos,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_NUM_SSBOS);
       LP_CHECK_STRUCT_SIZE(struct lp_jit_context,
                            gallivm->target, context_type);
 
@@ -254,3 +323,92 @@ lp_jit_init_types(struct lp_fragment_shader_variant *lp)
    if (!lp->jit_context_ptr_type)
       lp_jit_create_types(lp);
 }
+
+
+static void
+lp_jit_create_cs_types(struct lp_compute_shader_variant *lp)
+{
+   struct gallivm_state *gallivm = lp->gallivm;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef texture_type, sampler_type, image_type;
+
+   texture_type = create_jit_texture_type(gallivm);
+   sampler_type = create_jit_sampler_type(gallivm);
+   image_type = create_jit_image_type(gallivm);
+
+   /* struct lp_jit_cs_context */
+   {
+      LLVMTypeRef elem_types[LP_JIT_CS_CTX_COUNT];
+      LLVMTypeRef cs_context_type;
+
+      elem_types[LP_JIT_CS_CTX_CONSTANTS] =
+         LLVMArrayType(LLVMPointerType(LLVMFloatTypeInContext(lc), 0), LP_MAX_TGSI_CONST_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_NUM_CONSTANTS] =
+            LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_CONST_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_SSBOS] =
+         LLVMArrayType(LLVMPointerType(LLVMInt8TypeInContext(lc), 0), LP_MAX_TGSI_SHADER_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_NUM_SSBOS] =
+            LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_SHADER_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_TEXTURES] = LLVMArrayType(texture_type,
+                                                         PIPE_MAX_SHADER_SAMPLER_VIEWS);
+      elem_types[LP_JIT_CS_CTX_SAMPLERS] = LLVMArrayType(sampler_type,
+                                                         PIPE_MAX_SAMPLERS);
+      elem_types[LP_JIT_CS_CTX_IMAGES] = LLVMArrayType(image_type,
+                                                       LP_MAX_TGSI_SHADER_IMAGES);
+      elem_types[LP_JIT_CS_CTX_SHARED_SIZE] = LLVMInt32TypeInContext(lc);
+
+      cs_context_type = LLVMStructTypeInContext(lc, elem_types,
+                                                ARRAY_SIZE(elem_types), 0);
+
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, constants,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_CONSTANTS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, num_constants,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_NUM_CONSTANTS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, ssbos,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_SSBOS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, num_ssbos,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_NUM_SSBOS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, textures,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_TEXTURES);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, samplers,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_SAMPLERS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, images,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_IMAGES);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, shared_size,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_SHARED_SIZE);
+      LP_CHECK_STRUCT_SIZE(struct lp_jit_cs_context,
+                           gallivm->target, cs_context_type);
+
+      lp->jit_cs_context_ptr_type = LLVMPointerType(cs_context_type, 0);
+   }
+
+   /* struct lp_jit_cs_thread_data */
+   {
+      LLVMTypeRef elem_types[LP_JIT_CS_THREAD_DATA_COUNT];
+      LLVMTypeRef thread_data_type;
+
+      elem_types[LP_JIT_CS_THREAD_DATA_SHARED] =
+            LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+
+      thread_data_type = LLVMStructTypeInContext(lc, elem_types,
+                                                 ARRAY_SIZE(elem_types), 0);
+
+      lp->jit_cs_thread_data_ptr_type = LLVMPointerType(thread_data_type, 0);
+   }
+}
+
+
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp)
+{
+   if (!lp->jit_cs_context_ptr_type)
+      lp_jit_create_cs_types(lp);
+}
@@ -61,7 +61,23 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
+/**
+ * Sanity limit for LP_NUM_THREADS.  Per-thread state is allocated at
+ * runtime, so this is not a hard architectural limit.
+ */
+#define LP_MAX_THREADS 1024
+
+/**
+ * Max number of rasterizer thread groups.  Threads in a group share a
+ * NUMA node / L3 and get bins from the same band of the framebuffer.
+ */
+#define LP_MAX_THREAD_GROUPS 64
+
+/**
+ * Max number of threads binning a batch of triangles (LP_BIN_THREADS),
+ * including the one issuing the draw.
+ */
+#define LP_MAX_BIN_THREADS 16
 
 
 /**
@@ -75,6 +91,12 @@
  */
 #define LP_MAX_SHADER_VARIANTS 1024
 
+/**
+ * Max number of compiled fragment shader variants no context uses any more
+ * that the screen keeps around, for contexts created later.
+ */
+#define LP_MAX_UNUSED_FS_CODE 64
+
 /**
  * Max number of instructions (for all fragment shaders combined per context)
  * that will be kept around (counted in terms of llvm ir).
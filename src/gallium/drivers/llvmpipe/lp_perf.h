@@ -36,56 +36,67 @@
 #include "pipe/p_compiler.h"
 
 /**
- * Various counters
+ * Various counters.
+ *
+ * Each rasterizer thread counts into its own struct (lp_rasterizer_task),
+ * while binning and shader compilation count into the llvmpipe context's
+ * one, so no atomics are needed.  They are always collected, and are made
+ * available per context through driver queries (see lp_query.c).
+ *
+ * All fields are uint64_t, see lp_counter_get().
  */
 struct lp_counters
 {
-   unsigned nr_tris;
-   unsigned nr_culled_tris;
-   unsigned nr_empty_64;
-   unsigned nr_fully_covered_64;
-   unsigned nr_partially_covered_64;
-   unsigned nr_pure_shade_opaque_64;
-   unsigned nr_pure_shade_64;
-   unsigned nr_shade_64;
-   unsigned nr_shade_opaque_64;
-   unsigned nr_empty_16;
-   unsigned nr_fully_covered_16;
-   unsigned nr_partially_covered_16;
-   unsigned nr_empty_4;
-   unsigned nr_fully_covered_4;
-   unsigned nr_partially_covered_4;
-   unsigned nr_non_empty_4;
-   unsigned nr_llvm_compiles;
-   int64_t llvm_compile_time;  /**< total, in microseconds */
-
-   unsigned nr_color_tile_clear;
-   unsigned nr_color_tile_load;
-   unsigned nr_color_tile_store;
+   uint64_t nr_tris;
+   uint64_t nr_culled_tris;
+   uint64_t nr_empty_64;
+   uint64_t nr_fully_covered_64;
+   uint64_t nr_partially_covered_64;
+   uint64_t nr_pure_shade_opaque_64;
+   uint64_t nr_pure_shade_64;
+   uint64_t nr_shade_64;
+   uint64_t nr_shade_opaque_64;
+   uint64_t nr_empty_16;
+   uint64_t nr_fully_covered_16;
+   uint64_t nr_partially_covered_16;
+   uint64_t nr_empty_4;
+   uint64_t nr_fully_covered_4;
+   uint64_t nr_partially_covered_4;
+   uint64_t nr_non_empty_4;
+   uint64_t nr_hiz_culled_64;  /**< tiles culled by hierarchical z */
+   uint64_t nr_hiz_culled_16;  /**< blocks culled by hierarchical z */
+   uint64_t nr_tex_cache_accesses;  /**< texels fetched through the block cache */
+   uint64_t nr_tex_cache_misses;    /**< blocks decoded into the block cache */
+   uint64_t nr_llvm_compiles;
+   uint64_t llvm_compile_time;  /**< total, in microseconds */
+
+   uint64_t nr_color_tile_clear;
+   uint64_t nr_color_tile_load;
+   uint64_t nr_color_tile_store;
 };
 
 
-extern struct lp_counters lp_count;
+/** Increment the named counter of a struct lp_counters */
+#define LP_COUNT(counters, counter) ((counters)->counter++)
+#define LP_COUNT_ADD(counters, counter, incr) ((counters)->counter += (incr))
 
+#define LP_COUNTER_OFFSET(counter) offsetof(struct lp_counters, counter)
 
-/** Increment the named counter (only for debug builds) */
-#ifdef DEBUG
-#define LP_COUNT(counter) lp_count.counter++
-#define LP_COUNT_ADD(counter, incr)  lp_count.counter += (incr)
-#define LP_COUNT_GET(counter) (lp_count.counter)
-#else
-#define LP_COUNT(counter)
-#define LP_COUNT_ADD(counter, incr) (void)(incr)
-#define LP_COUNT_GET(counter) 0
-#endif
+
+/** Read a counter given its LP_COUNTER_OFFSET() */
+static inline uint64_t
+lp_counter_get(const struct lp_counters *counters, unsigned offset)
+{
+   return *(const uint64_t *)((const char *)counters + offset);
+}
 
 
 extern void
-lp_reset_counters(void);
+lp_add_counters(struct lp_counters *dst, const struct lp_counters *src);
 
 
 extern void
-lp_print_counters(void);
+lp_print_counters(const struct lp_counters *counters);
 
 
 #endif /* LP_PERF_H */
@@ -41,6 +41,7 @@
 #include "lp_screen.h"
 #include "lp_state.h"
 #include "lp_rast.h"
+#include "lp_perf.h"
 
 
 static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
@@ -48,19 +49,110 @@ static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
    return (struct llvmpipe_query *)p;
 }
 
+
+/**
+ * The driver specific queries, in enum lp_query_type order.
+ */
+static const struct lp_driver_query {
+   struct pipe_driver_query_info info;
+   unsigned counter;      /**< LP_COUNTER_OFFSET() */
+   boolean rast_counter;  /**< counted by the rasterizer threads */
+} lp_driver_queries[] = {
+#define QUERY(NAME, ENUM, TYPE, COUNTER, RAST) \
+   { { NAME, ENUM, {0}, TYPE, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE, 0, 0x0 }, \
+     LP_COUNTER_OFFSET(COUNTER), RAST }
+
+   /* binning */
+   QUERY("lp-triangles", LP_QUERY_TRIANGLES,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_tris, FALSE),
+   QUERY("lp-culled-triangles", LP_QUERY_CULLED_TRIANGLES,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_culled_tris, FALSE),
+   QUERY("lp-empty-64x64", LP_QUERY_EMPTY_64,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_empty_64, FALSE),
+   QUERY("lp-fully-covered-64x64", LP_QUERY_FULLY_COVERED_64,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_fully_covered_64, FALSE),
+   QUERY("lp-partially-covered-64x64", LP_QUERY_PARTIALLY_COVERED_64,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_partially_covered_64, FALSE),
+   QUERY("lp-hiz-culled-64x64", LP_QUERY_HIZ_CULLED_64,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_hiz_culled_64, FALSE),
+
+   /* rasterization */
+   QUERY("lp-empty-16x16", LP_QUERY_EMPTY_16,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_empty_16, TRUE),
+   QUERY("lp-fully-covered-16x16", LP_QUERY_FULLY_COVERED_16,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_fully_covered_16, TRUE),
+   QUERY("lp-partially-covered-16x16", LP_QUERY_PARTIALLY_COVERED_16,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_partially_covered_16, TRUE),
+   QUERY("lp-hiz-culled-16x16", LP_QUERY_HIZ_CULLED_16,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_hiz_culled_16, TRUE),
+   QUERY("lp-empty-4x4", LP_QUERY_EMPTY_4,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_empty_4, TRUE),
+   QUERY("lp-fully-covered-4x4", LP_QUERY_FULLY_COVERED_4,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_fully_covered_4, TRUE),
+   QUERY("lp-partially-covered-4x4", LP_QUERY_PARTIALLY_COVERED_4,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_partially_covered_4, TRUE),
+   QUERY("lp-color-tile-clears", LP_QUERY_COLOR_TILE_CLEARS,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_color_tile_clear, TRUE),
+   QUERY("lp-texture-cache-accesses", LP_QUERY_TEX_CACHE_ACCESSES,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_tex_cache_accesses, TRUE),
+   QUERY("lp-texture-cache-misses", LP_QUERY_TEX_CACHE_MISSES,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_tex_cache_misses, TRUE),
+
+   /* shader compilation */
+   QUERY("lp-llvm-compiles", LP_QUERY_LLVM_COMPILES,
+         PIPE_DRIVER_QUERY_TYPE_UINT64, nr_llvm_compiles, FALSE),
+   QUERY("lp-llvm-compile-time", LP_QUERY_LLVM_COMPILE_TIME,
+         PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, llvm_compile_time, FALSE),
+#undef QUERY
+};
+
+
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   STATIC_ASSERT(ARRAY_SIZE(lp_driver_queries) ==
+                 LP_QUERY_LAST - PIPE_QUERY_DRIVER_SPECIFIC);
+
+   if (!info)
+      return ARRAY_SIZE(lp_driver_queries);
+
+   if (index >= ARRAY_SIZE(lp_driver_queries))
+      return 0;
+
+   *info = lp_driver_queries[index].info;
+   return 1;
+}
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe, 
                       unsigned type,
                       unsigned index)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= PIPE_QUERY_DRIVER_SPECIFIC && type < LP_QUERY_LAST));
 
-   pq = CALLOC_STRUCT( llvmpipe_query );
+   /* per-thread counters live right behind the query */
+   pq = CALLOC(1, sizeof *pq + 2 * num_threads * sizeof(uint64_t));
 
    if (pq) {
       pq->type = type;
+      pq->num_threads = num_threads;
+      pq->start = (uint64_t *) (pq + 1);
+      pq->end = pq->start + num_threads;
+
+      if (type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+         const struct lp_driver_query *dq =
+            &lp_driver_queries[type - PIPE_QUERY_DRIVER_SPECIFIC];
+         assert(dq->info.query_type == type);
+         pq->counter = dq->counter;
+         pq->rast_counter = dq->rast_counter;
+      }
    }
 
    return (struct pipe_query *) pq;
@@ -178,7 +270,13 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    }
       break;
    default:
-      assert(0);
+      /* driver queries, only the first thread's slot is used for the
+       * context's own counters
+       */
+      assert(pq->type >= PIPE_QUERY_DRIVER_SPECIFIC);
+      for (i = 0; i < num_threads; i++) {
+         *result += pq->end[i];
+      }
       break;
    }
 
@@ -192,17 +290,18 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
-   /* Check if the query is already in the scene.  If so, we need to
-    * flush the scene now.  Real apps shouldn't re-use a query in a
-    * frame of rendering.
+   /* Check if the query is already in a scene.  If so, we need to
+    * flush and wait for the scene now, as the rasterizer threads write
+    * the per-thread counters we're about to reset.  Real apps shouldn't
+    * re-use a query in a frame of rendering.
     */
-   if (pq->fence && !lp_fence_issued(pq->fence)) {
+   if (pq->fence && !lp_fence_signalled(pq->fence)) {
       llvmpipe_finish(pipe, __FUNCTION__);
    }
 
 
-   memset(pq->start, 0, sizeof(pq->start));
-   memset(pq->end, 0, sizeof(pq->end));
+   memset(pq->start, 0, pq->num_threads * sizeof(pq->start[0]));
+   memset(pq->end, 0, pq->num_threads * sizeof(pq->end[0]));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -237,6 +336,8 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe->dirty |= LP_NEW_OCCLUSION_QUERY;
       break;
    default:
+      if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC && !pq->rast_counter)
+         pq->start[0] = lp_counter_get(&llvmpipe->counters, pq->counter);
       break;
    }
    return true;
@@ -302,6 +403,9 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe->dirty |= LP_NEW_OCCLUSION_QUERY;
       break;
    default:
+      if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC && !pq->rast_counter)
+         pq->end[0] = lp_counter_get(&llvmpipe->counters, pq->counter) -
+                      pq->start[0];
       break;
    }
 
@@ -35,21 +35,59 @@
 
 #include <limits.h>
 #include "os/os_thread.h"
+#include "pipe/p_defines.h"
 #include "lp_limits.h"
 
 
 struct llvmpipe_context;
+struct pipe_screen;
+struct pipe_driver_query_info;
+
+
+/**
+ * Driver specific queries, each returning one of the counters of
+ * struct lp_counters for the commands in between begin and end.
+ */
+enum lp_query_type {
+   LP_QUERY_TRIANGLES = PIPE_QUERY_DRIVER_SPECIFIC,
+   LP_QUERY_CULLED_TRIANGLES,
+   LP_QUERY_EMPTY_64,
+   LP_QUERY_FULLY_COVERED_64,
+   LP_QUERY_PARTIALLY_COVERED_64,
+   LP_QUERY_HIZ_CULLED_64,
+   LP_QUERY_EMPTY_16,
+   LP_QUERY_FULLY_COVERED_16,
+   LP_QUERY_PARTIALLY_COVERED_16,
+   LP_QUERY_HIZ_CULLED_16,
+   LP_QUERY_EMPTY_4,
+   LP_QUERY_FULLY_COVERED_4,
+   LP_QUERY_PARTIALLY_COVERED_4,
+   LP_QUERY_COLOR_TILE_CLEARS,
+   LP_QUERY_TEX_CACHE_ACCESSES,
+   LP_QUERY_TEX_CACHE_MISSES,
+   LP_QUERY_LLVM_COMPILES,
+   LP_QUERY_LLVM_COMPILE_TIME,
+   LP_QUERY_LAST
+};
 
 
 struct llvmpipe_query {
-   uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
-   uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
+   uint64_t *start;                 /* start count value for each thread */
+   uint64_t *end;                   /* end count value for each thread */
+   unsigned num_threads;            /* size of start[] and end[] */
    struct lp_fence *fence;          /* fence from last scene this was binned in */
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned num_primitives_generated;
    unsigned num_primitives_written;
 
    struct pipe_query_data_pipeline_statistics stats;
+
+   /* For LP_QUERY_*: which counter, and whether it is counted by the
+    * rasterizer threads (thus binned like occlusion queries) rather than
+    * by the context.
+    */
+   unsigned counter;
+   boolean rast_counter;
 };
 
 
@@ -57,4 +95,9 @@ extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
+extern int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info);
+
 #endif /* LP_QUERY_H */
@@ -33,6 +33,7 @@
 #include "util/u_pack_color.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
+#include "util/u_cpu_detect.h"
 
 #include "util/os_time.h"
 
@@ -70,16 +71,51 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, rast->num_groups );
 }
 
 
+/**
+ * End rasterizing a scene, once all threads are done with it.
+ * Called once per scene by one thread.
+ */
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
+   struct lp_scene *scene = rast->curr_scene;
+   struct lp_fence *fence = NULL;
+
+   /* Release the framebuffer, resources and bin memory right away rather
+    * than when the scene's owner gets around to reusing it.  The owner may
+    * reuse the scene as soon as the fence is signalled, so that comes last,
+    * and we hold our own reference in case the owner drops the scene's.
+    */
+   lp_fence_reference(&fence, scene->fence);
+
+   mtx_lock(&scene->mutex);
+   lp_scene_end_rasterization(scene);
+   mtx_unlock(&scene->mutex);
 
    rast->curr_scene = NULL;
+
+   if (fence) {
+      lp_fence_signal(fence);
+      lp_fence_reference(&fence, NULL);
+   }
+}
+
+
+/**
+ * The texture block cache counts in its own struct, which the generated
+ * code updates; copy those counts into the tile's counters.
+ */
+static inline void
+lp_rast_get_tex_cache_counters(struct lp_rasterizer_task *task)
+{
+   const struct lp_build_format_cache *cache = task->thread_data.cache;
+
+   task->counters.nr_tex_cache_accesses = cache->cache_access_total;
+   task->counters.nr_tex_cache_misses = cache->cache_access_miss;
 }
 
 
@@ -108,6 +144,9 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
 
    task->thread_data.vis_counter = 0;
    task->thread_data.ps_invocations = 0;
+   memset(&task->counters, 0, sizeof(task->counters));
+   task->thread_data.cache->cache_access_total = 0;
+   task->thread_data.cache->cache_access_miss = 0;
 
    for (i = 0; i < task->scene->fb.nr_cbufs; i++) {
       if (task->scene->fb.cbufs[i]) {
@@ -166,7 +205,7 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
                  &uc);
 
    /* this will increase for each rb which probably doesn't mean much */
-   LP_COUNT(nr_color_tile_clear);
+   LP_COUNT(&task->counters, nr_color_tile_clear);
 }
 
 
@@ -490,7 +529,10 @@ lp_rast_begin_query(struct lp_rasterizer_task *task,
       pq->start[task->thread_index] = task->thread_data.ps_invocations;
       break;
    default:
-      assert(0);
+      assert(pq->rast_counter);
+      lp_rast_get_tex_cache_counters(task);
+      pq->start[task->thread_index] =
+         lp_counter_get(&task->counters, pq->counter);
       break;
    }
 }
@@ -524,7 +566,12 @@ lp_rast_end_query(struct lp_rasterizer_task *task,
       pq->start[task->thread_index] = 0;
       break;
    default:
-      assert(0);
+      assert(pq->rast_counter);
+      lp_rast_get_tex_cache_counters(task);
+      pq->end[task->thread_index] +=
+         lp_counter_get(&task->counters, pq->counter) -
+         pq->start[task->thread_index];
+      pq->start[task->thread_index] = 0;
       break;
    }
 }
@@ -551,6 +598,9 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
       lp_rast_end_query(task, lp_rast_arg_query(task->scene->active_queries[i]));
    }
 
+   lp_rast_get_tex_cache_counters(task);
+   lp_add_counters(&task->total_counters, &task->counters);
+
    /* debug */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
    task->depth_tile = NULL;
@@ -626,17 +676,16 @@ rasterize_bin(struct lp_rasterizer_task *task,
 
    do_rasterize_bin(task, bin, x, y);
 
-   lp_rast_tile_end(task);
-
-
    /* Debug/Perf flags:
     */
    if (bin->head->count == 1) {
       if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE_OPAQUE)
-         LP_COUNT(nr_pure_shade_opaque_64);
+         LP_COUNT(&task->counters, nr_pure_shade_opaque_64);
       else if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE)
-         LP_COUNT(nr_pure_shade_64);
+         LP_COUNT(&task->counters, nr_pure_shade_64);
    }
+
+   lp_rast_tile_end(task);
 }
 
 
@@ -664,16 +713,10 @@ rasterize_scene(struct lp_rasterizer_task *task,
 {
    task->scene = scene;
 
-   /* Clear the cache tags. This should not always be necessary but
-      simpler for now. */
-#if LP_USE_TEXTURE_CACHE
-   memset(task->thread_data.cache->cache_tags, 0,
-          sizeof(task->thread_data.cache->cache_tags));
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   task->thread_data.cache->cache_access_total = 0;
-   task->thread_data.cache->cache_access_miss = 0;
-#endif
-#endif
+   /* Clear the cache tags, texture contents may have changed since the
+    * last scene.  This should not always be necessary but simpler for now.
+    */
+   lp_build_format_cache_invalidate(task->thread_data.cache);
 
    if (!task->rast->no_rast) {
       /* loop over scene bins, rasterize each */
@@ -682,32 +725,13 @@ rasterize_scene(struct lp_rasterizer_task *task,
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_scene_bin_iter_next(scene, task->group, &i, &j))) {
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
          }
       }
    }
 
-
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   {
-      uint64_t total, miss;
-      total = task->thread_data.cache->cache_access_total;
-      miss = task->thread_data.cache->cache_access_miss;
-      if (total) {
-         debug_printf("thread %d cache access %llu miss %llu hit rate %f\n",
-                 task->thread_index, (long long unsigned)total,
-                 (long long unsigned)miss,
-                 (float)(total - miss)/(float)total);
-      }
-   }
-#endif
-
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
-
    task->scene = NULL;
 }
 
@@ -737,8 +761,6 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
       lp_rast_end( rast );
 
       util_fpstate_set(fpstate);
-
-      rast->curr_scene = NULL;
    }
    else {
       /* threaded rendering! */
@@ -756,23 +778,6 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
-void
-lp_rast_finish( struct lp_rasterizer *rast )
-{
-   if (rast->num_threads == 0) {
-      /* nothing to do */
-   }
-   else {
-      int i;
-
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
-      }
-   }
-}
-
-
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
@@ -831,17 +836,19 @@ thread_function(void *init_data)
       /* wait for all threads to finish with this scene */
       util_barrier_wait( &rast->barrier );
 
-      /* XXX: shouldn't be necessary:
-       */
       if (task->thread_index == 0) {
+         /* thread[0]:
+          *  - release the scene
+          *  - signal its fence
+          */
          lp_rast_end( rast );
       }
 
-      /* signal done with work */
+      /* Nobody waits for individual scenes here, completion is tracked
+       * with the scene fences.
+       */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -852,6 +859,36 @@ thread_function(void *init_data)
 }
 
 
+/**
+ * Pin a rasterizer thread to the CPUs of the L3 caches its group covers.
+ * The L3 caches are split evenly between the groups, or with more groups
+ * than caches, each group gets the cache its share of the groups maps to.
+ */
+static void
+pin_thread_to_group(thrd_t thread, unsigned group, unsigned num_groups)
+{
+   uint32_t mask[UTIL_MAX_CPUS / 32];
+   unsigned num_L3_caches = util_cpu_caps.num_L3_caches;
+   unsigned cpu;
+
+   memset(mask, 0, sizeof mask);
+   for (cpu = 0; cpu < UTIL_MAX_CPUS; cpu++) {
+      unsigned L3 = util_cpu_caps.cpu_to_L3[cpu];
+      boolean in_group;
+
+      if (num_groups <= num_L3_caches)
+         in_group = L3 * num_groups / num_L3_caches == group;
+      else
+         in_group = L3 == group * num_L3_caches / num_groups;
+
+      if (in_group)
+         mask[cpu / 32] |= 1u << (cpu % 32);
+   }
+
+   util_set_thread_affinity(thread, mask, UTIL_MAX_CPUS);
+}
+
+
 /**
  * Initialize semaphores and spawn the threads.
  */
@@ -866,10 +903,35 @@ create_rast_threads(struct lp_rasterizer *rast)
       pipe_semaphore_init(&rast->tasks[i].work_done, 0);
       rast->threads[i] = u_thread_create(thread_function,
                                             (void *) &rast->tasks[i]);
+
+      /* Keep each group on its own set of cores so that the tiles it
+       * touches first (and so the pages of the framebuffer backing them)
+       * stay local to it.
+       */
+      if (rast->num_groups > 1) {
+         pin_thread_to_group(rast->threads[i], rast->tasks[i].group,
+                             rast->num_groups);
+      }
    }
 }
 
 
+/**
+ * Number of groups to split the rasterizer threads in.  One per L3 cache
+ * by default, LP_THREAD_GROUPS overrides that.
+ */
+static unsigned
+get_num_thread_groups(unsigned num_threads)
+{
+   unsigned num_groups = MAX2(util_cpu_caps.num_L3_caches, 1);
+
+   num_groups = debug_get_num_option("LP_THREAD_GROUPS", num_groups);
+
+   return CLAMP(num_groups, 1, MIN2(MAX2(1, num_threads),
+                                    LP_MAX_THREAD_GROUPS));
+}
+
+
 
 /**
  * Create new lp_rasterizer.  If num_threads is zero, don't create any
@@ -892,10 +954,25 @@ lp_rast_create( unsigned num_threads )
       goto no_full_scenes;
    }
 
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof(rast->tasks[0]));
+   if (!rast->tasks) {
+      goto no_tasks;
+   }
+
+   if (num_threads) {
+      rast->threads = CALLOC(num_threads, sizeof(rast->threads[0]));
+      if (!rast->threads) {
+         goto no_threads;
+      }
+   }
+
+   rast->num_groups = get_num_thread_groups(num_threads);
+
    for (i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
+      task->group = i * rast->num_groups / MAX2(1, num_threads);
       task->thread_data.cache = align_malloc(sizeof(struct lp_build_format_cache),
                                              16);
       if (!task->thread_data.cache) {
@@ -919,12 +996,16 @@ lp_rast_create( unsigned num_threads )
    return rast;
 
 no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+   for (i = 0; i < MAX2(1, num_threads); i++) {
       if (rast->tasks[i].thread_data.cache) {
          align_free(rast->tasks[i].thread_data.cache);
       }
    }
 
+   FREE(rast->threads);
+no_threads:
+   FREE(rast->tasks);
+no_tasks:
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
    FREE(rast);
@@ -975,7 +1056,26 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 }
 
 
+
+
+/**
+ * Add up the counters of all rasterizer threads, for debugging.  These
+ * cover every context of the screen; per context counts are only
+ * available through queries.
+ */
+void
+lp_rast_add_counters( struct lp_rasterizer *rast,
+                      struct lp_counters *counters )
+{
+   unsigned i;
+
+   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+      lp_add_counters(counters, &rast->tasks[i].total_counters);
+   }
+}
@@ -45,6 +45,7 @@
 struct lp_rasterizer;
 struct lp_scene;
 struct lp_fence;
+struct lp_counters;
 struct cmd_bin;
 
 #define FIXED_TYPE_WIDTH 64
@@ -162,13 +163,14 @@ lp_rast_create( unsigned num_threads );
 void
 lp_rast_destroy( struct lp_rasterizer * );
 
+void
+lp_rast_add_counters( struct lp_rasterizer *rast,
+                      struct lp_counters *counters );
+
 void 
 lp_rast_queue_scene( struct lp_rasterizer *rast,
                      struct lp_scene *scene );
 
-void
-lp_rast_finish( struct lp_rasterizer *rast );
-
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
@@ -208,6 +210,24 @@ lp_rast_arg_triangle( const struct lp_rast_triangle *triangle,
    return arg;
 }
 
+/**
+ * The upper half of a triangle command's plane mask is a mask of 16x16
+ * blocks of the tile (bit = by * 4 + bx) which setup found to be hidden
+ * by hierarchical z, and which the rasterizer must skip.
+ */
+#define LP_RAST_HIZ_SHIFT 16
+
+static inline union lp_rast_cmd_arg
+lp_rast_arg_triangle_hiz( const struct lp_rast_triangle *triangle,
+                          unsigned plane_mask,
+                          unsigned hidden_mask)
+{
+   union lp_rast_cmd_arg arg;
+   arg.triangle.tri = triangle;
+   arg.triangle.plane_mask = plane_mask | (hidden_mask << LP_RAST_HIZ_SHIFT);
+   return arg;
+}
+
 /**
  * Build argument for a contained triangle.
  *
@@ -190,7 +190,7 @@ debug_triangle(int tilex, int tiley,
                char val)
 {
    const struct lp_rast_triangle *tri = arg.triangle.tri;
-   unsigned plane_mask = arg.triangle.plane_mask;
+   unsigned plane_mask = arg.triangle.plane_mask & 0xffff;
    const struct lp_rast_plane *tri_plane = GET_PLANES(tri);
    struct lp_rast_plane plane[8];
    int x, y;
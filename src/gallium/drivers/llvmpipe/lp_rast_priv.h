@@ -37,6 +37,7 @@
 #include "lp_state.h"
 #include "lp_texture.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 
 
 #define TILE_VECTOR_HEIGHT 4
@@ -97,9 +98,18 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** thread group (NUMA node / L3) this thread is pinned to */
+   unsigned group;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
+   /** Counters for the current tile, reset like the above, see lp_perf.h */
+   struct lp_counters counters;
+
+   /** Counters of all tiles done by this thread so far */
+   struct lp_counters total_counters;
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -121,11 +131,14 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
-   /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   /** A task object for each rasterization thread, MAX2(1, num_threads) */
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
+
+   /** Number of thread groups the bins are split between */
+   unsigned num_groups;
 
    /** For synchronizing the rasterization threads */
    util_barrier barrier;
@@ -128,7 +128,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
 
    assert((partial_mask & inmask) == 0);
 
-   LP_COUNT_ADD(nr_empty_4, util_bitcount(0xffff & ~(partial_mask | inmask)));
+   LP_COUNT_ADD(&task->counters, nr_empty_4, util_bitcount(0xffff & ~(partial_mask | inmask)));
 
    /* Iterate over partials:
     */
@@ -142,7 +142,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
 
       partial_mask &= ~(1 << i);
 
-      LP_COUNT(nr_partially_covered_4);
+      LP_COUNT(&task->counters, nr_partially_covered_4);
 
       for (j = 0; j < NR_PLANES; j++)
          cx[j] = (c[j] 
@@ -163,7 +163,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
 
       inmask &= ~(1 << i);
 
-      LP_COUNT(nr_fully_covered_4);
+      LP_COUNT(&task->counters, nr_fully_covered_4);
       block_full_4(task, tri, px, py);
    }
 }
@@ -178,7 +178,8 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
                       const union lp_rast_cmd_arg arg)
 {
    const struct lp_rast_triangle *tri = arg.triangle.tri;
-   unsigned plane_mask = arg.triangle.plane_mask;
+   unsigned plane_mask = arg.triangle.plane_mask & 0xffff;
+   const unsigned hidden_mask = arg.triangle.plane_mask >> LP_RAST_HIZ_SHIFT;
    const struct lp_rast_plane *tri_plane = GET_PLANES(tri);
    const int x = task->x, y = task->y;
    struct lp_rast_plane plane[NR_PLANES];
@@ -268,12 +269,18 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       j++;
    }
 
+   /* Blocks setup already found hidden behind the depth buffer contents
+    * are treated like blocks outside the triangle:
+    */
+   outmask |= hidden_mask;
+   LP_COUNT_ADD(&task->counters, nr_hiz_culled_16, util_bitcount(hidden_mask));
+
    if (outmask == 0xffff)
       return;
 
    /* Mask of sub-blocks which are inside all trivial accept planes:
     */
-   inmask = ~partmask & 0xffff;
+   inmask = ~(partmask | hidden_mask) & 0xffff;
 
    /* Mask of sub-blocks which are inside all trivial reject planes,
     * but outside at least one trivial accept plane:
@@ -282,7 +289,7 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
    assert((partial_mask & inmask) == 0);
 
-   LP_COUNT_ADD(nr_empty_16, util_bitcount(0xffff & ~(partial_mask | inmask)));
+   LP_COUNT_ADD(&task->counters, nr_empty_16, util_bitcount(0xffff & ~(partial_mask | inmask)));
 
    /* Iterate over partials:
     */
@@ -301,7 +308,7 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       partial_mask &= ~(1 << i);
 
-      LP_COUNT(nr_partially_covered_16);
+      LP_COUNT(&task->counters, nr_partially_covered_16);
       TAG(do_block_16)(task, tri, plane, px, py, cx);
    }
 
@@ -316,7 +323,7 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       inmask &= ~(1 << i);
 
-      LP_COUNT(nr_fully_covered_16);
+      LP_COUNT(&task->counters, nr_fully_covered_16);
       block_full_16(task, tri, px, py);
    }
 }
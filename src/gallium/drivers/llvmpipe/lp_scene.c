@@ -29,9 +29,12 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_inlines.h"
+#include "util/u_atomic.h"
 #include "util/simple_list.h"
 #include "util/u_format.h"
 #include "lp_scene.h"
+#include "lp_scene_pool.h"
+#include "lp_screen.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
 
@@ -42,6 +45,7 @@
 struct resource_ref {
    struct pipe_resource *resource[RESOURCE_REF_SZ];
    int count;
+   unsigned write_mask;   /**< resources which the scene may write to */
    struct resource_ref *next;
 };
 
@@ -58,11 +62,18 @@ lp_scene_create( struct pipe_context *pipe )
       return NULL;
 
    scene->pipe = pipe;
-
-   scene->data.head =
-      CALLOC_STRUCT(data_block);
-
+   scene->pool = llvmpipe_screen(pipe->screen)->scene_pool;
    (void) mtx_init(&scene->mutex, mtx_plain);
+   scene->max_size = LP_SCENE_MAX_SIZE;
+
+   scene->data.head = lp_scene_pool_get_block(scene->pool);
+   if (!scene->data.head) {
+      mtx_destroy(&scene->mutex);
+      FREE(scene);
+      return NULL;
+   }
+   scene->data.head->used = 0;
+   scene->data.head->next = NULL;
 
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
@@ -90,9 +101,9 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   mtx_destroy(&scene->mutex);
    assert(scene->data.head->next == NULL);
-   FREE(scene->data.head);
+   lp_scene_pool_put_blocks(scene->pool, scene->data.head, scene->data.head, 1);
+   mtx_destroy(&scene->mutex);
    FREE(scene);
 }
 
@@ -146,6 +157,138 @@ lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y)
 }
 
 
+/** Reset all of the scene's bins, without looking at their contents */
+static void
+reset_bins(struct lp_scene *scene)
+{
+   int i, j;
+
+   for (i = 0; i < scene->tiles_x; i++) {
+      for (j = 0; j < scene->tiles_y; j++) {
+         struct cmd_bin *bin = lp_scene_get_bin(scene, i, j);
+         bin->head = NULL;
+         bin->tail = NULL;
+         bin->last_state = NULL;
+      }
+   }
+}
+
+
+/** Give all data blocks but the current one back to the pool */
+static void
+put_data_blocks(struct lp_scene *scene)
+{
+   struct data_block_list *list = &scene->data;
+   struct data_block *block, *last = NULL;
+   unsigned count = 0;
+
+   for (block = list->head->next; block; block = block->next) {
+      last = block;
+      count++;
+   }
+
+   lp_scene_pool_put_blocks(scene->pool, list->head->next, last, count);
+
+   list->head->next = NULL;
+   list->head->used = 0;
+}
+
+
+/**
+ * Prepare an empty slice for binning commands destined for the given
+ * scene, using at most max_size bytes of data blocks.
+ */
+void
+lp_scene_slice_begin(struct lp_scene *slice,
+                     const struct lp_scene *scene,
+                     unsigned max_size)
+{
+   assert(slice->data.head->used == 0);
+   assert(slice->data.head->next == NULL);
+
+   slice->tiles_x = scene->tiles_x;
+   slice->tiles_y = scene->tiles_y;
+
+   /* What lp_setup_whole_tile() looks at.  The surface is borrowed, the
+    * slice never holds a reference to it.
+    */
+   slice->fb.zsbuf = scene->fb.zsbuf;
+   slice->fb_max_layer = scene->fb_max_layer;
+   slice->had_queries = scene->had_queries;
+
+   slice->scene_size = 0;
+   slice->max_size = max_size;
+   slice->alloc_failed = FALSE;
+}
+
+
+/**
+ * Append the commands of each of the slice's bins to the scene's, and
+ * hand all the data they point to over to the scene.  The slice is left
+ * empty.  Fails (leaving both untouched) if the slice can't get a new
+ * data block for the next time.
+ */
+boolean
+lp_scene_slice_merge(struct lp_scene *scene, struct lp_scene *slice)
+{
+   struct data_block *head, *last;
+   int i, j;
+
+   head = lp_scene_pool_get_block(slice->pool);
+   if (!head)
+      return FALSE;
+
+   for (i = 0; i < slice->tiles_x; i++) {
+      for (j = 0; j < slice->tiles_y; j++) {
+         struct cmd_bin *from = lp_scene_get_bin(slice, i, j);
+         struct cmd_bin *to = lp_scene_get_bin(scene, i, j);
+
+         if (!from->head)
+            continue;
+
+         if (to->tail)
+            to->tail->next = from->head;
+         else
+            to->head = from->head;
+         to->tail = from->tail;
+         to->last_state = from->last_state;
+
+         from->head = NULL;
+         from->tail = NULL;
+         from->last_state = NULL;
+      }
+   }
+
+   /* The scene keeps allocating from its own current block, so put the
+    * slice's blocks right behind it.
+    */
+   for (last = slice->data.head; last->next; last = last->next)
+      ;
+   last->next = scene->data.head->next;
+   scene->data.head->next = slice->data.head;
+   scene->scene_size += slice->scene_size + sizeof *head;
+
+   head->used = 0;
+   head->next = NULL;
+   slice->data.head = head;
+   slice->fb.zsbuf = NULL;
+
+   return TRUE;
+}
+
+
+/**
+ * Throw away everything binned into the slice.
+ */
+void
+lp_scene_slice_discard(struct lp_scene *slice)
+{
+   reset_bins(slice);
+   put_data_blocks(slice);
+   slice->fb.zsbuf = NULL;
+}
+
+
 void
 lp_scene_begin_rasterization(struct lp_scene *scene)
 {
@@ -205,11 +348,13 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 
 /**
  * Free all the temporary data in a scene.
+ * The fence is left to the scene's owner, which drops it when it reuses
+ * the scene.
  */
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
 {
-   int i, j;
+   int i;
 
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
@@ -235,14 +380,7 @@ lp_scene_end_rasterization(struct lp_scene *scene )
 
    /* Reset all command lists:
     */
-   for (i = 0; i < scene->tiles_x; i++) {
-      for (j = 0; j < scene->tiles_y; j++) {
-         struct cmd_bin *bin = lp_scene_get_bin(scene, i, j);
-         bin->head = NULL;
-         bin->tail = NULL;
-         bin->last_state = NULL;
-      }
-   }
+   reset_bins(scene);
 
    /* If there are any bins which weren't cleared by the loop above,
     * they will be caught (on debug builds at least) by this assert:
@@ -274,22 +412,9 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                       j, scene->resource_reference_size);
    }
 
-   /* Free all scene data blocks:
+   /* Give all scene data blocks but one back to the pool:
     */
-   {
-      struct data_block_list *list = &scene->data;
-      struct data_block *block, *tmp;
-
-      for (block = list->head->next; block; block = tmp) {
-         tmp = block->next;
-	 FREE(block);
-      }
-
-      list->head->next = NULL;
-      list->head->used = 0;
-   }
-
-   lp_fence_reference(&scene->fence, NULL);
+   put_data_blocks(scene);
 
    scene->resources = NULL;
    scene->scene_size = 0;
@@ -330,16 +455,18 @@ lp_scene_new_cmd_block( struct lp_scene *scene,
 struct data_block *
 lp_scene_new_data_block( struct lp_scene *scene )
 {
-   if (scene->scene_size + DATA_BLOCK_SIZE > LP_SCENE_MAX_SIZE) {
+   if (scene->scene_size + DATA_BLOCK_SIZE > scene->max_size) {
       if (0) debug_printf("%s: failed\n", __FUNCTION__);
       scene->alloc_failed = TRUE;
       return NULL;
    }
    else {
-      struct data_block *block = MALLOC_STRUCT(data_block);
-      if (!block)
+      struct data_block *block = lp_scene_pool_get_block(scene->pool);
+      if (!block) {
+         scene->alloc_failed = TRUE;
          return NULL;
-      
+      }
+
       scene->scene_size += sizeof *block;
 
       block->used = 0;
@@ -370,11 +497,13 @@ lp_scene_data_size( const struct lp_scene *scene )
 
 /**
  * Add a reference to a resource by the scene.
+ * \param writeable  whether shaders of the scene may write to the resource
  */
 boolean
 lp_scene_add_resource_reference(struct lp_scene *scene,
                                 struct pipe_resource *resource,
-                                boolean initializing_scene)
+                                boolean initializing_scene,
+                                boolean writeable)
 {
    struct resource_ref *ref, **last = &scene->resources;
    int i;
@@ -386,9 +515,13 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
       /* Search for this resource:
        */
-      for (i = 0; i < ref->count; i++)
-         if (ref->resource[i] == resource)
+      for (i = 0; i < ref->count; i++) {
+         if (ref->resource[i] == resource) {
+            if (writeable)
+               ref->write_mask |= 1u << i;
             return TRUE;
+         }
+      }
 
       if (ref->count < RESOURCE_REF_SZ) {
          /* If the block is half-empty, then append the reference here.
@@ -411,6 +544,8 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
    /* Append the reference to the reference block.
     */
+   if (writeable)
+      ref->write_mask |= 1u << ref->count;
    pipe_resource_reference(&ref->resource[ref->count++], resource);
    scene->resource_reference_size += llvmpipe_resource_size(resource);
 
@@ -429,8 +564,9 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
 /**
  * Does this scene have a reference to the given resource?
+ * \return LP_REFERENCED_FOR_* flags
  */
-boolean
+unsigned
 lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                 const struct pipe_resource *resource)
 {
@@ -438,72 +574,76 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
    int i;
 
    for (ref = scene->resources; ref; ref = ref->next) {
-      for (i = 0; i < ref->count; i++)
-         if (ref->resource[i] == resource)
-            return TRUE;
+      for (i = 0; i < ref->count; i++) {
+         if (ref->resource[i] == resource) {
+            if (ref->write_mask & (1u << i))
+               return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+            return LP_REFERENCED_FOR_READ;
+         }
+      }
    }
 
-   return FALSE;
+   return LP_UNREFERENCED;
 }
 
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/**
+ * Prepare to hand out the scene's bins to the rasterizer threads.
+ * The bins are split into num_bands bands of whole tile rows so that
+ * each thread group keeps working on the same part of the framebuffer
+ * from one scene to the next.
+ */
+void
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_bands )
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
-   }
-   return TRUE;
-}
+   unsigned i;
 
+   num_bands = MIN2(num_bands, MIN2(scene->tiles_y, LP_MAX_THREAD_GROUPS));
+   num_bands = MAX2(num_bands, 1);
 
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
-{
-   scene->curr_x = scene->curr_y = -1;
+   scene->num_bands = num_bands;
+   for (i = 0; i < num_bands; i++) {
+      unsigned y0 = scene->tiles_y * i / num_bands;
+      unsigned y1 = scene->tiles_y * (i + 1) / num_bands;
+      scene->band_next[i] = y0 * scene->tiles_x;
+      scene->band_end[i] = y1 * scene->tiles_x;
+   }
 }
 
 
 /**
  * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  Bins from the caller's own band are
+ * returned first; once that is exhausted we help out with the others.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned band,
+                        int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
+   unsigned i;
 
-   mtx_lock(&scene->mutex);
+   band %= scene->num_bands;
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
-   }
+   for (i = 0; i < scene->num_bands; i++) {
+      unsigned b = (band + i) % scene->num_bands;
+      unsigned idx;
+
+      if ((unsigned) p_atomic_read(&scene->band_next[b]) >= scene->band_end[b])
+         continue;
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+      idx = p_atomic_inc_return(&scene->band_next[b]) - 1;
+      if (idx < scene->band_end[b]) {
+         *x = idx % scene->tiles_x;
+         *y = idx / scene->tiles_x;
+         return lp_scene_get_bin(scene, *x, *y);
+      }
+   }
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   /* no more bins left */
+   return NULL;
 }
 
 
@@ -36,10 +36,12 @@
 #define LP_SCENE_H
 
 #include "os/os_thread.h"
+#include "lp_limits.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
 
 struct lp_scene_queue;
+struct lp_scene_pool;
 struct lp_rast_state;
 
 /* We're limited to 2K by 2K for 32bit fixed point rasterization.
@@ -129,6 +131,14 @@ struct lp_scene {
    struct pipe_context *pipe;
    struct lp_fence *fence;
 
+   /** Held by the rasterizer while it releases fb and resources, so that
+    * the owner can look at them while the scene is in flight.
+    */
+   mtx_t mutex;
+
+   /** where the data blocks come from, may be NULL */
+   struct lp_scene_pool *pool;
+
    /* The queries still active at end of scene */
    struct llvmpipe_query *active_queries[LP_MAX_ACTIVE_BINNED_QUERIES];
    unsigned num_active_queries;
@@ -160,6 +170,9 @@ struct lp_scene {
     */
    unsigned scene_size;
 
+   /** Limit of scene_size, LP_SCENE_MAX_SIZE except for binning slices */
+   unsigned max_size;
+
    /** Sum of sizes of all resources referenced by the scene.  Sums
     * all the textures read by the scene:
     */
@@ -172,8 +185,15 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   mtx_t mutex;
+   /**
+    * For iterating over bins.  The bins are split into horizontal bands,
+    * one per rasterizer thread group; band_next[] is the next bin (in
+    * row-major order) to hand out from each band and is advanced
+    * atomically.
+    */
+   unsigned num_bands;
+   unsigned band_end[LP_MAX_THREAD_GROUPS];
+   int band_next[LP_MAX_THREAD_GROUPS];
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -196,9 +216,10 @@ struct cmd_block *lp_scene_new_cmd_block( struct lp_scene *scene,
 
 boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
-                                        boolean initializing_scene);
+                                        boolean initializing_scene,
+                                        boolean writeable);
 
-boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
+unsigned lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                         const struct pipe_resource *resource );
 
 
@@ -218,7 +239,7 @@ lp_scene_alloc( struct lp_scene *scene, unsigned size)
    if (LP_DEBUG & DEBUG_MEM)
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
 		   size, block->used, DATA_BLOCK_SIZE,
-		   scene->scene_size, LP_SCENE_MAX_SIZE);
+		   scene->scene_size, scene->max_size);
 
    if (block->used + size > DATA_BLOCK_SIZE) {
       block = lp_scene_new_data_block( scene );
@@ -252,7 +273,7 @@ lp_scene_alloc_aligned( struct lp_scene *scene, unsigned size,
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
 		   size + alignment - 1,
 		   block->used, DATA_BLOCK_SIZE,
-		   scene->scene_size, LP_SCENE_MAX_SIZE);
+		   scene->scene_size, scene->max_size);
        
    if (block->used + size + alignment - 1 > DATA_BLOCK_SIZE) {
       block = lp_scene_new_data_block( scene );
@@ -378,10 +399,11 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_bands );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned band,
+                        int *x, int *y );
 
 
 
@@ -395,6 +417,21 @@ void
 lp_scene_end_binning(struct lp_scene *scene);
 
 
+/* Binning slices: scenes private to a binning thread, whose bins are
+ * appended to those of a real scene.  See lp_setup_slice.c.
+ */
+void
+lp_scene_slice_begin(struct lp_scene *slice,
+                     const struct lp_scene *scene,
+                     unsigned max_size);
+
+boolean
+lp_scene_slice_merge(struct lp_scene *scene, struct lp_scene *slice);
+
+void
+lp_scene_slice_discard(struct lp_scene *slice);
+
+
 /* Begin/end rasterization of a scene
  */
 void
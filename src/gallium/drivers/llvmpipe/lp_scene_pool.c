@@ -0,0 +1,374 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include <inttypes.h>
+
+#include "os/os_memory.h"
+#include "util/list.h"
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+#include "util/u_thread.h"
+#include "lp_scene.h"
+#include "lp_scene_pool.h"
+
+#if defined(PIPE_OS_LINUX)
+#include <sys/mman.h>
+#endif
+
+
+/* The size transparent huge pages come in on x86 */
+#define LP_SCENE_POOL_SLAB_SIZE (2 * 1024 * 1024)
+
+/* The end of each slab points back to its lp_scene_pool_slab */
+#define LP_SCENE_POOL_SLAB_BLOCKS \
+   ((LP_SCENE_POOL_SLAB_SIZE - sizeof(void *)) / sizeof(struct data_block))
+
+/* Free blocks beyond what two full scenes need are given back to the
+ * system, as soon as a whole slab of them is free.
+ */
+#define LP_SCENE_POOL_MAX_FREE_BLOCKS \
+   (2 * LP_SCENE_MAX_SIZE / DATA_BLOCK_SIZE)
+
+
+struct lp_scene_pool_slab
+{
+   struct list_head list;
+   void *mem;
+
+   /** Blocks of this slab not used by any scene, linked through
+    * data_block::next
+    */
+   struct data_block *free_blocks;
+   unsigned num_free;
+
+   boolean huge;   /**< the kernel took the advice */
+};
+
+
+struct lp_scene_pool
+{
+   mtx_t mutex;
+
+   /** Slabs with free blocks, the partly used ones first */
+   struct list_head slabs;
+   /** Slabs all of whose blocks are in use */
+   struct list_head full_slabs;
+
+   /* statistics */
+   unsigned num_slabs;
+   unsigned num_huge_slabs;   /**< slabs the kernel took the advice for */
+   unsigned num_blocks;       /**< carved out of all the slabs */
+   unsigned num_free;
+   unsigned max_used;
+   uint64_t num_gets;
+   uint64_t num_fallbacks;    /**< blocks malloc'd as no slab could be had */
+   uint64_t num_trimmed;      /**< slabs freed before the pool */
+};
+
+
+static inline struct lp_scene_pool_slab **
+lp_scene_pool_slab_backptr(void *mem)
+{
+   return (struct lp_scene_pool_slab **)
+      ((char *)mem + LP_SCENE_POOL_SLAB_SIZE - sizeof(void *));
+}
+
+
+/** The slab a block which came from one of them was carved out of */
+static inline struct lp_scene_pool_slab *
+lp_scene_pool_block_slab(const struct data_block *block)
+{
+   uintptr_t mem = (uintptr_t)block & ~(uintptr_t)(LP_SCENE_POOL_SLAB_SIZE - 1);
+   return *lp_scene_pool_slab_backptr((void *)mem);
+}
+
+
+struct lp_scene_pool *
+lp_scene_pool_create(void)
+{
+   struct lp_scene_pool *pool = CALLOC_STRUCT(lp_scene_pool);
+   if (!pool)
+      return NULL;
+
+   (void) mtx_init(&pool->mutex, mtx_plain);
+   list_inithead(&pool->slabs);
+   list_inithead(&pool->full_slabs);
+
+   return pool;
+}
+
+
+static void
+lp_scene_pool_free_slab(struct lp_scene_pool_slab *slab)
+{
+   list_del(&slab->list);
+   os_free_aligned(slab->mem);
+   FREE(slab);
+}
+
+
+void
+lp_scene_pool_destroy(struct lp_scene_pool *pool)
+{
+   struct lp_scene_pool_slab *slab, *next;
+
+   if (!pool)
+      return;
+
+   /* all the scenes must have been destroyed by now */
+   assert(pool->num_free == pool->num_blocks);
+   assert(list_empty(&pool->full_slabs));
+
+   LIST_FOR_EACH_ENTRY_SAFE(slab, next, &pool->slabs, list)
+      lp_scene_pool_free_slab(slab);
+
+   mtx_destroy(&pool->mutex);
+   FREE(pool);
+}
+
+
+/**
+ * Allocate a new slab and put it on the list of slabs with free blocks.
+ * Called with the pool mutex held.
+ */
+static boolean
+lp_scene_pool_grow(struct lp_scene_pool *pool)
+{
+   struct lp_scene_pool_slab *slab;
+   struct data_block *blocks;
+   unsigned i;
+
+   slab = CALLOC_STRUCT(lp_scene_pool_slab);
+   if (!slab)
+      return FALSE;
+
+   /* Huge pages need the slab to be aligned to their size, which also
+    * lets lp_scene_pool_block_slab() find it from any of its blocks.
+    */
+   slab->mem = os_malloc_aligned(LP_SCENE_POOL_SLAB_SIZE,
+                                 LP_SCENE_POOL_SLAB_SIZE);
+   if (!slab->mem) {
+      FREE(slab);
+      return FALSE;
+   }
+
+#if defined(PIPE_OS_LINUX) && defined(MADV_HUGEPAGE)
+   if (madvise(slab->mem, LP_SCENE_POOL_SLAB_SIZE, MADV_HUGEPAGE) == 0) {
+      slab->huge = TRUE;
+      pool->num_huge_slabs++;
+   }
+#endif
+
+   *lp_scene_pool_slab_backptr(slab->mem) = slab;
+
+   blocks = slab->mem;
+   for (i = 0; i < LP_SCENE_POOL_SLAB_BLOCKS; i++) {
+      blocks[i].next = slab->free_blocks;
+      slab->free_blocks = &blocks[i];
+   }
+   slab->num_free = LP_SCENE_POOL_SLAB_BLOCKS;
+
+   list_addtail(&slab->list, &pool->slabs);
+
+   pool->num_slabs++;
+   pool->num_blocks += LP_SCENE_POOL_SLAB_BLOCKS;
+   pool->num_free += LP_SCENE_POOL_SLAB_BLOCKS;
+
+   return TRUE;
+}
+
+
+/**
+ * Get a data block for a scene.  The block's contents are undefined.
+ */
+struct data_block *
+lp_scene_pool_get_block(struct lp_scene_pool *pool)
+{
+   struct data_block *block = NULL;
+
+   if (!pool)
+      return MALLOC_STRUCT(data_block);
+
+   mtx_lock(&pool->mutex);
+
+   pool->num_gets++;
+
+   if (!list_empty(&pool->slabs) || lp_scene_pool_grow(pool)) {
+      /* Take from the slab in use the most, so that the others get a
+       * chance to become entirely free.
+       */
+      struct lp_scene_pool_slab *slab =
+         LIST_ENTRY(struct lp_scene_pool_slab, pool->slabs.next, list);
+
+      block = slab->free_blocks;
+      slab->free_blocks = block->next;
+      if (--slab->num_free == 0) {
+         list_del(&slab->list);
+         list_add(&slab->list, &pool->full_slabs);
+      }
+
+      pool->num_free--;
+      pool->max_used = MAX2(pool->max_used,
+                            pool->num_blocks - pool->num_free);
+   }
+
+   mtx_unlock(&pool->mutex);
+
+   if (!block) {
+      /* Out of slabs, try a smaller allocation */
+      block = MALLOC_STRUCT(data_block);
+      if (block) {
+         mtx_lock(&pool->mutex);
+         pool->num_fallbacks++;
+         mtx_unlock(&pool->mutex);
+      }
+   }
+
+   return block;
+}
+
+
+static boolean
+lp_scene_pool_owns_block(const struct lp_scene_pool *pool,
+                         const struct data_block *block)
+{
+   const struct list_head *lists[] = { &pool->slabs, &pool->full_slabs };
+   const struct lp_scene_pool_slab *slab;
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(lists); i++) {
+      LIST_FOR_EACH_ENTRY(slab, lists[i], list) {
+         if ((const char *)block >= (const char *)slab->mem &&
+             (const char *)block < (const char *)slab->mem + LP_SCENE_POOL_SLAB_SIZE)
+            return TRUE;
+      }
+   }
+
+   return FALSE;
+}
+
+
+/**
+ * Give a block back to its slab.  Called with the pool mutex held.
+ */
+static void
+lp_scene_pool_put_block(struct lp_scene_pool *pool, struct data_block *block)
+{
+   struct lp_scene_pool_slab *slab = lp_scene_pool_block_slab(block);
+
+   block->next = slab->free_blocks;
+   slab->free_blocks = block;
+   slab->num_free++;
+   pool->num_free++;
+
+   if (slab->num_free == 1) {
+      /* was full, partly used slabs go first */
+      list_del(&slab->list);
+      list_add(&slab->list, &pool->slabs);
+   }
+   else if (slab->num_free == LP_SCENE_POOL_SLAB_BLOCKS) {
+      if (pool->num_free - LP_SCENE_POOL_SLAB_BLOCKS >=
+          LP_SCENE_POOL_MAX_FREE_BLOCKS) {
+         pool->num_huge_slabs -= slab->huge;
+         lp_scene_pool_free_slab(slab);
+         pool->num_slabs--;
+         pool->num_blocks -= LP_SCENE_POOL_SLAB_BLOCKS;
+         pool->num_free -= LP_SCENE_POOL_SLAB_BLOCKS;
+         pool->num_trimmed++;
+      }
+      else {
+         /* entirely free slabs go last */
+         list_del(&slab->list);
+         list_addtail(&slab->list, &pool->slabs);
+      }
+   }
+}
+
+
+/**
+ * Give back the count blocks of a list linked through data_block::next,
+ * from first to last.
+ */
+void
+lp_scene_pool_put_blocks(struct lp_scene_pool *pool,
+                         struct data_block *first,
+                         struct data_block *last,
+                         unsigned count)
+{
+   struct data_block *block, *next;
+
+   if (!count)
+      return;
+
+   assert(last->next == NULL);
+
+   if (!pool) {
+      for (block = first; block; block = next) {
+         next = block->next;
+         FREE(block);
+      }
+      return;
+   }
+
+   mtx_lock(&pool->mutex);
+
+   for (block = first; block; block = next) {
+      next = block->next;
+
+      /* blocks which didn't come from a slab go back to the heap */
+      if (likely(!pool->num_fallbacks) ||
+          lp_scene_pool_owns_block(pool, block))
+         lp_scene_pool_put_block(pool, block);
+      else
+         FREE(block);
+   }
+
+   assert(pool->num_free <= pool->num_blocks);
+
+   mtx_unlock(&pool->mutex);
+}
+
+
+void
+lp_scene_pool_print_stats(const struct lp_scene_pool *pool)
+{
+   if (!pool)
+      return;
+
+   debug_printf("llvmpipe: scene pool slabs:             %9u (%u huge)\n",
+                pool->num_slabs, pool->num_huge_slabs);
+   debug_printf("llvmpipe: scene pool slabs trimmed:     %9" PRIu64 "\n",
+                pool->num_trimmed);
+   debug_printf("llvmpipe: scene pool blocks:            %9u (%u max used)\n",
+                pool->num_blocks, pool->max_used);
+   debug_printf("llvmpipe: scene pool block gets:        %9" PRIu64 "\n",
+                pool->num_gets);
+   debug_printf("llvmpipe: scene pool malloc fallbacks:  %9" PRIu64 "\n",
+                pool->num_fallbacks);
+}
@@ -0,0 +1,70 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Per-screen pool of scene data blocks.
+ *
+ * Scenes get their data blocks (which also hold the bin command blocks)
+ * from here and hand them back when rasterization is done, so after the
+ * first few frames binning doesn't call malloc any more.  Blocks are
+ * carved out of big slabs which are advised to be backed by huge pages,
+ * to cut down on TLB misses when binning and rasterizing.  A slab whose
+ * blocks are all back is freed if the pool holds more free blocks than a
+ * couple of full scenes need, so the pool doesn't stay at its peak size.
+ */
+
+#ifndef LP_SCENE_POOL_H
+#define LP_SCENE_POOL_H
+
+#include "pipe/p_compiler.h"
+
+
+struct data_block;
+struct lp_scene_pool;
+
+
+struct lp_scene_pool *
+lp_scene_pool_create(void);
+
+void
+lp_scene_pool_destroy(struct lp_scene_pool *pool);
+
+struct data_block *
+lp_scene_pool_get_block(struct lp_scene_pool *pool);
+
+void
+lp_scene_pool_put_blocks(struct lp_scene_pool *pool,
+                         struct data_block *first,
+                         struct data_block *last,
+                         unsigned count);
+
+void
+lp_scene_pool_print_stats(const struct lp_scene_pool *pool);
+
+
+#endif /* LP_SCENE_POOL_H */
@@ -33,10 +33,16 @@
 #include "util/u_screen.h"
 #include "util/u_string.h"
 #include "util/u_format_s3tc.h"
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_misc.h"
+#include "gallivm/lp_bld_debug.h"
+#include "compiler/nir/nir.h"
 
 #include "os/os_misc.h"
 #include "util/os_time.h"
@@ -49,6 +55,10 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_scene_pool.h"
+#include "lp_state_cs.h"
+#include "lp_state_fs.h"
+#include "lp_query.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -82,6 +92,8 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_blend",       PERF_NO_BLEND, NULL },
    { "no_depth",       PERF_NO_DEPTH, NULL },
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
+   { "no_hiz",         PERF_NO_HIZ, NULL },
+   { "tex_cache",      PERF_TEX_CACHE, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -104,6 +116,17 @@ llvmpipe_get_name(struct pipe_screen *screen)
 }
 
 
+/**
+ * Tessellation only exists in the draw module's LLVM path, and only for TGSI
+ * shaders, while the state tracker gives all stages the same IR.
+ */
+static boolean
+llvmpipe_has_tess(const struct llvmpipe_screen *screen)
+{
+   return !screen->use_nir && draw_get_option_use_llvm();
+}
+
+
 static int
 llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
 {
@@ -214,7 +237,12 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION:
       return 0;
    case PIPE_CAP_COMPUTE:
-      return 0;
+      return LP_HAVE_COMPUTE;
+   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
+      /* Fragment and compute shaders have shader buffers, which are also
+       * where atomic counters live.
+       */
+      return LP_HAVE_COMPUTE ? 16 : 0;
    case PIPE_CAP_USER_VERTEX_BUFFERS:
       return 1;
    case PIPE_CAP_VERTEX_BUFFER_OFFSET_4BYTE_ALIGNED_ONLY:
@@ -310,10 +338,11 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
       return 1;
    case PIPE_CAP_CLEAR_TEXTURE:
       return 1;
+   case PIPE_CAP_MAX_SHADER_PATCH_VARYINGS:
+      return llvmpipe_has_tess(llvmpipe_screen(screen)) ? 32 : 0;
    case PIPE_CAP_MULTISAMPLE_Z_RESOLVE:
    case PIPE_CAP_RESOURCE_FROM_USER_MEMORY:
    case PIPE_CAP_DEVICE_RESET_STATUS_QUERY:
-   case PIPE_CAP_MAX_SHADER_PATCH_VARYINGS:
    case PIPE_CAP_DEPTH_BOUNDS_TEST:
    case PIPE_CAP_TGSI_TXQS:
    case PIPE_CAP_FORCE_PERSAMPLE_INTERP:
@@ -324,7 +353,6 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_MULTI_DRAW_INDIRECT_PARAMS:
    case PIPE_CAP_TGSI_FS_POSITION_IS_SYSVAL:
    case PIPE_CAP_TGSI_FS_FACE_IS_INTEGER_SYSVAL:
-   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
    case PIPE_CAP_INVALIDATE_BUFFER:
    case PIPE_CAP_GENERATE_MIPMAP:
    case PIPE_CAP_STRING_MARKER:
@@ -392,16 +420,30 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
                           enum pipe_shader_type shader,
                           enum pipe_shader_cap param)
 {
+   struct llvmpipe_screen *lp_screen = llvmpipe_screen(screen);
+
    switch(shader)
    {
    case PIPE_SHADER_FRAGMENT:
       switch (param) {
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_HAVE_COMPUTE ? LP_MAX_TGSI_SHADER_BUFFERS : 0;
+      case PIPE_SHADER_CAP_PREFERRED_IR:
+         return lp_screen->use_nir ? PIPE_SHADER_IR_NIR : PIPE_SHADER_IR_TGSI;
+      case PIPE_SHADER_CAP_SUPPORTED_IRS:
+         return (1 << PIPE_SHADER_IR_TGSI) |
+                (lp_screen->use_nir ? 1 << PIPE_SHADER_IR_NIR : 0);
       default:
          return gallivm_get_shader_param(param);
       }
    case PIPE_SHADER_VERTEX:
    case PIPE_SHADER_GEOMETRY:
       switch (param) {
+      case PIPE_SHADER_CAP_PREFERRED_IR:
+         return lp_screen->use_nir ? PIPE_SHADER_IR_NIR : PIPE_SHADER_IR_TGSI;
+      case PIPE_SHADER_CAP_SUPPORTED_IRS:
+         return (1 << PIPE_SHADER_IR_TGSI) |
+                (lp_screen->use_nir ? 1 << PIPE_SHADER_IR_NIR : 0);
       case PIPE_SHADER_CAP_MAX_TEXTURE_SAMPLERS:
          /* At this time, the draw module and llvmpipe driver only
           * support vertex shader texture lookups when LLVM is enabled in
@@ -419,11 +461,159 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
       default:
          return draw_get_shader_param(shader, param);
       }
+   case PIPE_SHADER_TESS_CTRL:
+   case PIPE_SHADER_TESS_EVAL:
+      if (!llvmpipe_has_tess(lp_screen))
+         return 0;
+
+      switch (param) {
+      case PIPE_SHADER_CAP_PREFERRED_IR:
+         return PIPE_SHADER_IR_TGSI;
+      case PIPE_SHADER_CAP_SUPPORTED_IRS:
+         return 1 << PIPE_SHADER_IR_TGSI;
+      case PIPE_SHADER_CAP_MAX_TEXTURE_SAMPLERS:
+         return PIPE_MAX_SAMPLERS;
+      case PIPE_SHADER_CAP_MAX_SAMPLER_VIEWS:
+         return PIPE_MAX_SHADER_SAMPLER_VIEWS;
+      default:
+         return draw_get_shader_param(shader, param);
+      }
+   case PIPE_SHADER_COMPUTE:
+      switch (param) {
+      case PIPE_SHADER_CAP_MAX_TEXTURE_SAMPLERS:
+         return PIPE_MAX_SAMPLERS;
+      case PIPE_SHADER_CAP_MAX_SAMPLER_VIEWS:
+         return PIPE_MAX_SHADER_SAMPLER_VIEWS;
+      case PIPE_SHADER_CAP_MAX_SHADER_IMAGES:
+         /* The NIR path doesn't do images, and so GL compute */
+         return lp_screen->use_nir ? 0 : LP_MAX_TGSI_SHADER_IMAGES;
+      case PIPE_SHADER_CAP_MAX_INPUTS:
+      case PIPE_SHADER_CAP_MAX_OUTPUTS:
+         return 0;
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+      case PIPE_SHADER_CAP_PREFERRED_IR:
+         return lp_screen->use_nir ? PIPE_SHADER_IR_NIR : PIPE_SHADER_IR_TGSI;
+      case PIPE_SHADER_CAP_SUPPORTED_IRS:
+         return (1 << PIPE_SHADER_IR_TGSI) |
+                (lp_screen->use_nir ? 1 << PIPE_SHADER_IR_NIR : 0);
+      default:
+         return gallivm_get_shader_param(param);
+      }
    default:
       return 0;
    }
 }
 
+
+static const struct nir_shader_compiler_options lp_nir_options = {
+   .lower_scmp = true,
+   .lower_flrp32 = true,
+   .lower_flrp64 = true,
+   .lower_ffma = true,
+   .lower_fmod32 = true,
+   .lower_fmod64 = true,
+   .lower_ldexp = true,
+   .lower_bitfield_extract_to_shifts = true,
+   .lower_bitfield_insert_to_shifts = true,
+   .lower_bitfield_reverse = true,
+   .lower_bit_count = true,
+   .lower_ifind_msb = true,
+   .lower_find_lsb = true,
+   .lower_uadd_carry = true,
+   .lower_usub_borrow = true,
+   .lower_pack_half_2x16 = true,
+   .lower_pack_unorm_2x16 = true,
+   .lower_pack_snorm_2x16 = true,
+   .lower_pack_unorm_4x8 = true,
+   .lower_pack_snorm_4x8 = true,
+   .lower_unpack_half_2x16 = true,
+   .lower_unpack_unorm_2x16 = true,
+   .lower_unpack_snorm_2x16 = true,
+   .lower_unpack_unorm_4x8 = true,
+   .lower_unpack_snorm_4x8 = true,
+   .lower_extract_byte = true,
+   .lower_extract_word = true,
+   .lower_cs_local_index_from_id = true,
+   .native_integers = true,
+   .max_unroll_iterations = 32,
+};
+
+
+static const void *
+llvmpipe_get_compiler_options(struct pipe_screen *screen,
+                              enum pipe_shader_ir ir,
+                              enum pipe_shader_type shader)
+{
+   assert(ir == PIPE_SHADER_IR_NIR);
+   return &lp_nir_options;
+}
+
+static int
+llvmpipe_get_compute_param(struct pipe_screen *_screen,
+                           enum pipe_shader_ir ir_type,
+                           enum pipe_compute_cap param,
+                           void *ret)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      return 0;
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (ret) {
+         uint64_t *grid_size = ret;
+         grid_size[0] = 65535;
+         grid_size[1] = 65535;
+         grid_size[2] = 65535;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      if (ret) {
+         uint64_t *block_size = ret;
+         block_size[0] = 1024;
+         block_size[1] = 1024;
+         block_size[2] = 1024;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (ret) {
+         uint64_t *max_threads_per_block = ret;
+         *max_threads_per_block = LP_MAX_CS_THREADS;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      if (ret) {
+         uint64_t *max_local_size = ret;
+         *max_local_size = 32768;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_COMPUTE_UNITS:
+      if (ret) {
+         uint32_t *max_compute_units = ret;
+         *max_compute_units = MAX2(screen->num_threads, 1);
+      }
+      return sizeof(uint32_t);
+   case PIPE_COMPUTE_CAP_SUBGROUP_SIZE:
+      if (ret) {
+         uint32_t *subgroup_size = ret;
+         *subgroup_size = MIN2(lp_native_vector_width / 32, 16);
+      }
+      return sizeof(uint32_t);
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_CLOCK_FREQUENCY:
+   case PIPE_COMPUTE_CAP_IMAGES_SUPPORTED:
+   case PIPE_COMPUTE_CAP_ADDRESS_BITS:
+   case PIPE_COMPUTE_CAP_MAX_VARIABLE_THREADS_PER_BLOCK:
+      break;
+   }
+   return 0;
+}
+
 static float
 llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
 {
@@ -529,6 +719,21 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
       }
    }
 
+   if (bind & PIPE_BIND_SHADER_IMAGE) {
+      /* what lp_build_store_rgba_soa() can write */
+      if (format_desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB)
+         return FALSE;
+
+      if (format != PIPE_FORMAT_R11G11B10_FLOAT &&
+          (format_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+           format_desc->block.width != 1 ||
+           format_desc->block.height != 1 ||
+           !util_is_power_of_two_nonzero(format_desc->block.bits) ||
+           format_desc->block.bits < 8 ||
+           format_desc->block.bits > 128))
+         return FALSE;
+   }
+
    if (bind & PIPE_BIND_DISPLAY_TARGET) {
       if(!winsys->is_displaytarget_format_supported(winsys, bind, format))
          return FALSE;
@@ -577,12 +782,40 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
+   struct lp_fence *fence = NULL;
+
+   /* Scenes are not waited for on flush anymore, so make sure whatever
+    * was queued to the rasterizer has landed before presenting.
+    */
+   mtx_lock(&screen->rast_mutex);
+   lp_fence_reference(&fence, screen->last_fence);
+   mtx_unlock(&screen->rast_mutex);
+   if (fence) {
+      lp_fence_wait(fence);
+      lp_fence_reference(&fence, NULL);
+   }
 
    assert(texture->dt);
    if (texture->dt)
       winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
 }
 
+static void
+lp_print_queue_stats(const char *name, struct util_queue *queue)
+{
+   struct util_queue_stats stats;
+
+   util_queue_get_stats(queue, &stats);
+
+   debug_printf("llvmpipe: %-7s queue jobs:        %9" PRIu64 " (%" PRIu64
+                " stolen)\n", name, stats.num_jobs, stats.num_stolen);
+   debug_printf("llvmpipe: %-7s queue wait ms:     %9" PRIu64 " (%" PRIu64
+                " max)\n", name, stats.total_wait_ns / 1000000,
+                stats.max_wait_ns / 1000000);
+   debug_printf("llvmpipe: %-7s queue run ms:      %9" PRIu64 "\n",
+                name, stats.total_run_ns / 1000000);
+}
+
 static void
 llvmpipe_destroy_screen( struct pipe_screen *_screen )
 {
@@ -592,12 +825,38 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   lp_cs_pool_destroy(screen);
+
+   if (util_queue_is_initialized(&screen->compile_queue)) {
+      if (LP_DEBUG & DEBUG_COUNTERS)
+         lp_print_queue_stats("compile", &screen->compile_queue);
+      util_queue_destroy(&screen->compile_queue);
+   }
+
+   if (util_queue_is_initialized(&screen->worker_queue)) {
+      if (LP_DEBUG & DEBUG_COUNTERS)
+         lp_print_queue_stats("worker", &screen->worker_queue);
+      util_queue_destroy(&screen->worker_queue);
+   }
+
+   lp_fs_code_cache_destroy(screen);
+
+   lp_fence_reference(&screen->last_fence, NULL);
+
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      lp_scene_pool_print_stats(screen->scene_pool);
+   lp_scene_pool_destroy(screen->scene_pool);
+
+   disk_cache_destroy(screen->disk_shader_cache);
+
    lp_jit_screen_cleanup(screen);
 
    if(winsys->destroy)
       winsys->destroy(winsys);
 
    mtx_destroy(&screen->rast_mutex);
+   mtx_destroy(&screen->cs_mutex);
+   mtx_destroy(&screen->layout_mutex);
 
    FREE(screen);
 }
@@ -644,6 +903,118 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+
+static struct disk_cache *
+llvmpipe_get_disk_shader_cache(struct pipe_screen *_screen)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   return screen->disk_shader_cache;
+}
+
+
+/**
+ * Create the on-disk cache of JIT compiled code.
+ *
+ * Generated code depends not only on the mesa and LLVM builds but also on
+ * the host CPU, on the (overridable) vector width and CPU caps, and on the
+ * LP_DEBUG, LP_PERF and GALLIVM_DEBUG flags, so all of these go into the
+ * cache id.
+ */
+static void
+lp_disk_cache_create(struct llvmpipe_screen *screen)
+{
+#ifdef HAVE_DLFCN_H
+   struct mesa_sha1 ctx;
+   unsigned char sha1[20];
+   char cache_id[20 * 2 + 1];
+   uint32_t mesa_timestamp, llvm_timestamp;
+   uint32_t caps[14];
+   char *cpu;
+
+   if (!disk_cache_get_function_timestamp(lp_disk_cache_create,
+                                          &mesa_timestamp) ||
+       !disk_cache_get_function_timestamp(LLVMLinkInMCJIT,
+                                          &llvm_timestamp))
+      return;
+
+   caps[0] = lp_native_vector_width;
+   caps[1] = util_cpu_caps.has_sse;
+   caps[2] = util_cpu_caps.has_sse2;
+   caps[3] = util_cpu_caps.has_sse3;
+   caps[4] = util_cpu_caps.has_ssse3;
+   caps[5] = util_cpu_caps.has_sse4_1;
+   caps[6] = util_cpu_caps.has_avx;
+   caps[7] = util_cpu_caps.has_avx2;
+   caps[8] = util_cpu_caps.has_f16c;
+   caps[9] = util_cpu_caps.has_fma;
+   caps[10] = screen->use_nir;
+   caps[11] = LP_DEBUG;
+   caps[12] = LP_PERF;
+   caps[13] = gallivm_debug;
+
+   cpu = lp_build_host_cpu_string();
+   if (!cpu)
+      return;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, &mesa_timestamp, sizeof mesa_timestamp);
+   _mesa_sha1_update(&ctx, &llvm_timestamp, sizeof llvm_timestamp);
+   _mesa_sha1_update(&ctx, caps, sizeof caps);
+   _mesa_sha1_update(&ctx, cpu, strlen(cpu));
+   _mesa_sha1_final(&ctx, sha1);
+   disk_cache_format_hex_id(cache_id, sha1, 20 * 2);
+   free(cpu);
+
+   screen->disk_shader_cache = disk_cache_create("llvmpipe", cache_id,
+                                                 gallivm_debug);
+#endif
+}
+
+
+/**
+ * Look up the object code of a shader variant.
+ * On a hit, cache->data must be freed by the caller.
+ */
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          const unsigned char ir_sha1_cache_key[20])
+{
+   cache_key sha1;
+
+   if (!screen->disk_shader_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key,
+                          20, sha1);
+   cache->data = disk_cache_get(screen->disk_shader_cache, sha1,
+                                &cache->data_size);
+   if (!cache->data)
+      cache->data_size = 0;
+}
+
+
+/**
+ * Store the object code of a freshly compiled shader variant.
+ */
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            const unsigned char ir_sha1_cache_key[20])
+{
+   cache_key sha1;
+
+   if (!screen->disk_shader_cache || !cache->data_size || cache->dont_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key,
+                          20, sha1);
+   disk_cache_put(screen->disk_shader_cache, sha1, cache->data,
+                  cache->data_size, NULL);
+}
+
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -652,6 +1023,7 @@ struct pipe_screen *
 llvmpipe_create_screen(struct sw_winsys *winsys)
 {
    struct llvmpipe_screen *screen;
+   unsigned num_workers;
 
    util_cpu_detect();
 
@@ -672,6 +1044,12 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    screen->winsys = winsys;
 
+   /* NIR is only translated by the llvm code paths, draw included */
+   screen->use_nir = debug_get_bool_option("LP_NIR", FALSE) &&
+                     draw_get_option_use_llvm();
+
+   screen->tiled_textures = debug_get_bool_option("LP_TILED_TEXTURES", FALSE);
+
    screen->base.destroy = llvmpipe_destroy_screen;
 
    screen->base.get_name = llvmpipe_get_name;
@@ -679,6 +1057,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_device_vendor = llvmpipe_get_vendor; // TODO should be the CPU vendor
    screen->base.get_param = llvmpipe_get_param;
    screen->base.get_shader_param = llvmpipe_get_shader_param;
+   screen->base.get_compute_param = llvmpipe_get_compute_param;
    screen->base.get_paramf = llvmpipe_get_paramf;
    screen->base.is_format_supported = llvmpipe_is_format_supported;
 
@@ -688,6 +1067,9 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+   screen->base.get_disk_shader_cache = llvmpipe_get_disk_shader_cache;
+   screen->base.get_compiler_options = llvmpipe_get_compiler_options;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -698,6 +1080,9 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   screen->num_bin_threads = debug_get_num_option("LP_BIN_THREADS", 0);
+   screen->num_bin_threads = MIN2(screen->num_bin_threads, LP_MAX_BIN_THREADS);
+
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
       lp_jit_screen_cleanup(screen);
@@ -705,6 +1090,37 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
       return NULL;
    }
    (void) mtx_init(&screen->rast_mutex, mtx_plain);
+   (void) mtx_init(&screen->cs_mutex, mtx_plain);
+   (void) mtx_init(&screen->layout_mutex, mtx_plain);
+
+   lp_fs_code_cache_init(screen);
+
+   /* Without it scenes just malloc their data blocks */
+   screen->scene_pool = lp_scene_pool_create();
+
+   /* One set of vertex shading and binning threads however many contexts
+    * there are, so they never add up to more than the bigger of the two
+    * thread counts.  A failure here just means vertices get shaded and
+    * binned on the drawing thread.  Threads are only started while all
+    * running ones are busy and stop again once idle, so contexts which
+    * draw little don't keep them all around.
+    */
+   num_workers = screen->num_threads > 1 ? screen->num_threads : 0;
+   if (screen->num_bin_threads > 1)
+      num_workers = MAX2(num_workers, screen->num_bin_threads - 1);
+   if (num_workers)
+      util_queue_init(&screen->worker_queue, "lpwork",
+                      2 * num_workers, num_workers,
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                      UTIL_QUEUE_INIT_SCALE_THREADS);
+
+   /* A failure here just means variants get compiled synchronously */
+   if (debug_get_bool_option("LP_ASYNC_COMPILE", FALSE))
+      util_queue_init(&screen->compile_queue, "lpcompile", 32, 1,
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                      UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY);
+
+   lp_disk_cache_create(screen);
 
    return &screen->base;
 }
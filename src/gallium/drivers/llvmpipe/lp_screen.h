@@ -37,10 +37,18 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/list.h"
+#include "util/u_queue.h"
 #include "gallivm/lp_bld.h"
 
 
 struct sw_winsys;
+struct disk_cache;
+struct lp_cached_code;
+struct lp_fence;
+struct lp_cs_pool;
+struct lp_scene_pool;
+struct hash_table;
 
 
 struct llvmpipe_screen
@@ -51,15 +59,80 @@ struct llvmpipe_screen
 
    unsigned num_threads;
 
+   /* Threads binning large triangle batches (LP_BIN_THREADS), 0 if off */
+   unsigned num_bin_threads;
+
    /* Increments whenever textures are modified.  Contexts can track this.
     */
    unsigned timestamp;
 
+   /* Increments whenever a texture changes layout (is detiled), which
+    * changes the code sampling from it.  Read and written atomically.
+    */
+   unsigned layout_timestamp;
+   /* Serializes detiling, which may be started by any context */
+   mtx_t layout_mutex;
+
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
+
+   /** Fence of the last scene queued to rast, protected by rast_mutex.
+    * Scenes are rasterized in order so this covers all earlier ones.
+    */
+   struct lp_fence *last_fence;
+
+   /* Object code of JIT compiled fragment shader/setup variants */
+   struct disk_cache *disk_shader_cache;
+
+   /* Take shaders as NIR rather than TGSI (LP_NIR) */
+   boolean use_nir;
+
+   /* Store sample-only textures tiled (LP_TILED_TEXTURES) */
+   boolean tiled_textures;
+
+   /* Background compilation of fs variants, only initialized when
+    * LP_ASYNC_COMPILE is set.
+    */
+   struct util_queue compile_queue;
+
+   /* Compiled fs variant code shared by all contexts, keyed on the hash of
+    * the shader and variant key.  NULL if it could not be created.
+    */
+   struct hash_table *fs_code_cache;
+   mtx_t fs_code_mutex;
+   /* Code of the cache no variant uses any more, most recently used first,
+    * at most LP_MAX_UNUSED_FS_CODE of it.
+    */
+   struct list_head fs_code_unused;
+   unsigned fs_code_num_unused;
+   unsigned fs_code_hits;
+
+   /* Threads shading vertices for the draw modules and binning slices of
+    * triangle batches, shared by all contexts.  Only initialized when there
+    * is more than one rendering or binning thread.
+    */
+   struct util_queue worker_queue;
+
+   /* Threads running compute workgroups, created on first use */
+   struct lp_cs_pool *cs_pool;
+   mtx_t cs_mutex;
+
+   /* Recycled scene data blocks of all contexts, may be NULL */
+   struct lp_scene_pool *scene_pool;
 };
 
 
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          const unsigned char ir_sha1_cache_key[20]);
+
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            const unsigned char ir_sha1_cache_key[20]);
+
+
 
 
 static inline struct llvmpipe_screen *
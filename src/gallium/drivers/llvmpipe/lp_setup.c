@@ -64,26 +64,50 @@ static boolean set_scene_state( struct lp_setup_context *, enum setup_state,
 static boolean try_update_scene_state( struct lp_setup_context *setup );
 
 
+/**
+ * Get the next scene to bin into.  Scenes are used round-robin, so the
+ * next one is the oldest; if the rasterizer is still busy with it we
+ * rather create another scene (up to max_scenes) than wait.
+ */
 static void
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
+   struct lp_scene *scene;
+   unsigned idx;
+
    assert(setup->scene == NULL);
 
-   setup->scene_idx++;
-   setup->scene_idx %= ARRAY_SIZE(setup->scenes);
+   idx = (setup->scene_idx + 1) % setup->num_scenes;
+   scene = setup->scenes[idx];
+
+   if (scene->fence && !lp_fence_signalled(scene->fence) &&
+       setup->num_scenes < setup->max_scenes) {
+      struct lp_scene *new_scene = lp_scene_create(setup->pipe);
+
+      if (new_scene) {
+         /* insert in front of the oldest scene to keep the order */
+         memmove(&setup->scenes[idx + 1], &setup->scenes[idx],
+                 (setup->num_scenes - idx) * sizeof(setup->scenes[0]));
+         setup->scenes[idx] = new_scene;
+         setup->num_scenes++;
+         scene = new_scene;
+      }
+   }
 
-   setup->scene = setup->scenes[setup->scene_idx];
+   setup->scene_idx = idx;
+   setup->scene = scene;
 
-   if (setup->scene->fence) {
+   if (scene->fence) {
       if (LP_DEBUG & DEBUG_SETUP)
          debug_printf("%s: wait for scene %d\n",
-                      __FUNCTION__, setup->scene->fence->id);
+                      __FUNCTION__, scene->fence->id);
 
-      lp_fence_wait(setup->scene->fence);
+      /* the rasterizer released everything else before signalling */
+      lp_fence_wait(scene->fence);
+      lp_fence_reference(&scene->fence, NULL);
    }
 
-   lp_scene_begin_binning(setup->scene, &setup->fb);
-
+   lp_scene_begin_binning(scene, &setup->fb);
 }
 
 
@@ -165,23 +189,16 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
-   mtx_lock(&screen->rast_mutex);
-
-   /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
-    * This means we never actually run any vertex stuff in parallel to
-    * rasterization (not in the same context at least) which is what the
-    * multiple scenes per setup is about - when we get a new empty scene
-    * any old one is already empty again because we waited here for
-    * raster tasks to be finished. Ideally, we shouldn't need to wait here
-    * and rely on fences elsewhere when waiting is necessary.
-    * Certainly, lp_scene_end_rasterization() would need to be deferred too
-    * and there's probably other bits why this doesn't actually work.
+   /* Don't wait for the rasterizer: we go on binning into the next scene
+    * while this one is being rasterized.  The rasterizer releases the
+    * scene's resources when it is done; anything needing the results
+    * waits on the fence.
     */
+   mtx_lock(&screen->rast_mutex);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
+   lp_fence_reference(&screen->last_fence, scene->fence);
    mtx_unlock(&screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
@@ -201,7 +218,8 @@ begin_binning( struct lp_setup_context *setup )
 
    /* Always create a fence:
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   /* Signalled once, by the rasterizer thread ending the scene */
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return FALSE;
 
@@ -342,7 +360,9 @@ set_scene_state( struct lp_setup_context *setup,
 
 fail:
    if (setup->scene) {
+      /* never queued, nobody else will release it */
       lp_scene_end_rasterization(setup->scene);
+      lp_fence_reference(&setup->scene->fence, NULL);
       setup->scene = NULL;
    }
 
@@ -490,6 +510,9 @@ lp_setup_try_clear_zs(struct lp_setup_context *setup,
 
    zsvalue &= zsmask;
 
+   if (flags & PIPE_CLEAR_DEPTH)
+      lp_setup_hiz_clear(setup, depth);
+
    if (format == PIPE_FORMAT_Z24X8_UNORM ||
        format == PIPE_FORMAT_X8Z24_UNORM) {
       /*
@@ -663,6 +686,35 @@ lp_setup_set_fs_constants(struct lp_setup_context *setup,
 }
 
 
+void
+lp_setup_set_fs_ssbos(struct lp_setup_context *setup,
+                      unsigned num,
+                      const struct pipe_shader_buffer *buffers)
+{
+   unsigned i;
+
+   LP_DBG(DEBUG_SETUP, "%s %p\n", __FUNCTION__, (void *) buffers);
+
+   assert(num <= ARRAY_SIZE(setup->ssbos));
+
+   for (i = 0; i < ARRAY_SIZE(setup->ssbos); ++i) {
+      struct pipe_shader_buffer *dst = &setup->ssbos[i];
+
+      if (i < num && buffers[i].buffer) {
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      }
+      else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+   setup->dirty |= LP_SETUP_NEW_SSBOS;
+}
+
+
 void
 lp_setup_set_alpha_ref_value( struct lp_setup_context *setup,
                               float alpha_ref_value )
@@ -787,6 +839,124 @@ lp_setup_set_viewports(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Fill in the jit texture for a sampler view, which references the
+ * resource's data. The caller must hold a reference to the resource for
+ * as long as the jit texture is used.
+ */
+void
+lp_setup_fill_jit_texture(struct lp_jit_texture *jit_tex,
+                          const struct pipe_sampler_view *view)
+{
+   struct pipe_resource *res = view->texture;
+   struct llvmpipe_resource *lp_tex = llvmpipe_resource(res);
+
+   if (!lp_tex->dt) {
+      /* regular texture - setup array of mipmap level offsets */
+      int j;
+      unsigned first_level = 0;
+      unsigned last_level = 0;
+
+      if (llvmpipe_resource_is_texture(res)) {
+         first_level = view->u.tex.first_level;
+         last_level = view->u.tex.last_level;
+         assert(first_level <= last_level);
+         assert(last_level <= res->last_level);
+         jit_tex->base = lp_tex->tex_data;
+      }
+      else {
+        jit_tex->base = lp_tex->data;
+      }
+
+      if (LP_PERF & PERF_TEX_MEM) {
+         /* use dummy tile memory */
+         jit_tex->base = lp_dummy_tile;
+         jit_tex->width = TILE_SIZE/8;
+         jit_tex->height = TILE_SIZE/8;
+         jit_tex->depth = 1;
+         jit_tex->first_level = 0;
+         jit_tex->last_level = 0;
+         jit_tex->mip_offsets[0] = 0;
+         jit_tex->row_stride[0] = 0;
+         jit_tex->img_stride[0] = 0;
+      }
+      else {
+         jit_tex->width = res->width0;
+         jit_tex->height = res->height0;
+         jit_tex->depth = res->depth0;
+         jit_tex->first_level = first_level;
+         jit_tex->last_level = last_level;
+
+         if (llvmpipe_resource_is_texture(res)) {
+            for (j = first_level; j <= last_level; j++) {
+               jit_tex->mip_offsets[j] = lp_tex->mip_offsets[j];
+               jit_tex->row_stride[j] = lp_tex->row_stride[j];
+               jit_tex->img_stride[j] = lp_tex->img_stride[j];
+            }
+
+            if (res->target == PIPE_TEXTURE_1D_ARRAY ||
+                res->target == PIPE_TEXTURE_2D_ARRAY ||
+                res->target == PIPE_TEXTURE_CUBE ||
+                res->target == PIPE_TEXTURE_CUBE_ARRAY) {
+               /*
+                * For array textures, we don't have first_layer, instead
+                * adjust last_layer (stored as depth) plus the mip level offsets
+                * (as we have mip-first layout can't just adjust base ptr).
+                * XXX For mip levels, could do something similar.
+                */
+               jit_tex->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+               for (j = first_level; j <= last_level; j++) {
+                  jit_tex->mip_offsets[j] += view->u.tex.first_layer *
+                                             lp_tex->img_stride[j];
+               }
+               if (view->target == PIPE_TEXTURE_CUBE ||
+                   view->target == PIPE_TEXTURE_CUBE_ARRAY) {
+                  assert(jit_tex->depth % 6 == 0);
+               }
+               assert(view->u.tex.first_layer <= view->u.tex.last_layer);
+               assert(view->u.tex.last_layer < res->array_size);
+            }
+         }
+         else {
+            /*
+             * For buffers, we don't have "offset", instead adjust
+             * the size (stored as width) plus the base pointer.
+             */
+            unsigned view_blocksize = util_format_get_blocksize(view->format);
+            /* probably don't really need to fill that out */
+            jit_tex->mip_offsets[0] = 0;
+            jit_tex->row_stride[0] = 0;
+            jit_tex->img_stride[0] = 0;
+
+            /* everything specified in number of elements here. */
+            jit_tex->width = view->u.buf.size / view_blocksize;
+            jit_tex->base = (uint8_t *)jit_tex->base + view->u.buf.offset;
+            /* XXX Unsure if we need to sanitize parameters? */
+            assert(view->u.buf.offset + view->u.buf.size <= res->width0);
+         }
+      }
+   }
+   else {
+      /* display target texture/surface */
+      /*
+       * XXX: Where should this be unmapped?
+       */
+      struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
+      struct sw_winsys *winsys = screen->winsys;
+      jit_tex->base = winsys->displaytarget_map(winsys, lp_tex->dt,
+                                                PIPE_TRANSFER_READ);
+      jit_tex->row_stride[0] = lp_tex->row_stride[0];
+      jit_tex->img_stride[0] = lp_tex->img_stride[0];
+      jit_tex->mip_offsets[0] = 0;
+      jit_tex->width = res->width0;
+      jit_tex->height = res->height0;
+      jit_tex->depth = res->depth0;
+      jit_tex->first_level = jit_tex->last_level = 0;
+      assert(jit_tex->base);
+   }
+}
+
+
 /**
  * Called during state validation when LP_NEW_SAMPLER_VIEW is set.
  */
@@ -807,119 +977,13 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
       struct pipe_sampler_view *view = i < num ? views[i] : NULL;
 
       if (view) {
-         struct pipe_resource *res = view->texture;
-         struct llvmpipe_resource *lp_tex = llvmpipe_resource(res);
-         struct lp_jit_texture *jit_tex;
-         jit_tex = &setup->fs.current.jit_context.textures[i];
-
          /* We're referencing the texture's internal data, so save a
           * reference to it.
           */
-         pipe_resource_reference(&setup->fs.current_tex[i], res);
-
-         if (!lp_tex->dt) {
-            /* regular texture - setup array of mipmap level offsets */
-            int j;
-            unsigned first_level = 0;
-            unsigned last_level = 0;
-
-            if (llvmpipe_resource_is_texture(res)) {
-               first_level = view->u.tex.first_level;
-               last_level = view->u.tex.last_level;
-               assert(first_level <= last_level);
-               assert(last_level <= res->last_level);
-               jit_tex->base = lp_tex->tex_data;
-            }
-            else {
-              jit_tex->base = lp_tex->data;
-            }
+         pipe_resource_reference(&setup->fs.current_tex[i], view->texture);
 
-            if (LP_PERF & PERF_TEX_MEM) {
-               /* use dummy tile memory */
-               jit_tex->base = lp_dummy_tile;
-               jit_tex->width = TILE_SIZE/8;
-               jit_tex->height = TILE_SIZE/8;
-               jit_tex->depth = 1;
-               jit_tex->first_level = 0;
-               jit_tex->last_level = 0;
-               jit_tex->mip_offsets[0] = 0;
-               jit_tex->row_stride[0] = 0;
-               jit_tex->img_stride[0] = 0;
-            }
-            else {
-               jit_tex->width = res->width0;
-               jit_tex->height = res->height0;
-               jit_tex->depth = res->depth0;
-               jit_tex->first_level = first_level;
-               jit_tex->last_level = last_level;
-
-               if (llvmpipe_resource_is_texture(res)) {
-                  for (j = first_level; j <= last_level; j++) {
-                     jit_tex->mip_offsets[j] = lp_tex->mip_offsets[j];
-                     jit_tex->row_stride[j] = lp_tex->row_stride[j];
-                     jit_tex->img_stride[j] = lp_tex->img_stride[j];
-                  }
-
-                  if (res->target == PIPE_TEXTURE_1D_ARRAY ||
-                      res->target == PIPE_TEXTURE_2D_ARRAY ||
-                      res->target == PIPE_TEXTURE_CUBE ||
-                      res->target == PIPE_TEXTURE_CUBE_ARRAY) {
-                     /*
-                      * For array textures, we don't have first_layer, instead
-                      * adjust last_layer (stored as depth) plus the mip level offsets
-                      * (as we have mip-first layout can't just adjust base ptr).
-                      * XXX For mip levels, could do something similar.
-                      */
-                     jit_tex->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
-                     for (j = first_level; j <= last_level; j++) {
-                        jit_tex->mip_offsets[j] += view->u.tex.first_layer *
-                                                   lp_tex->img_stride[j];
-                     }
-                     if (view->target == PIPE_TEXTURE_CUBE ||
-                         view->target == PIPE_TEXTURE_CUBE_ARRAY) {
-                        assert(jit_tex->depth % 6 == 0);
-                     }
-                     assert(view->u.tex.first_layer <= view->u.tex.last_layer);
-                     assert(view->u.tex.last_layer < res->array_size);
-                  }
-               }
-               else {
-                  /*
-                   * For buffers, we don't have "offset", instead adjust
-                   * the size (stored as width) plus the base pointer.
-                   */
-                  unsigned view_blocksize = util_format_get_blocksize(view->format);
-                  /* probably don't really need to fill that out */
-                  jit_tex->mip_offsets[0] = 0;
-                  jit_tex->row_stride[0] = 0;
-                  jit_tex->img_stride[0] = 0;
-
-                  /* everything specified in number of elements here. */
-                  jit_tex->width = view->u.buf.size / view_blocksize;
-                  jit_tex->base = (uint8_t *)jit_tex->base + view->u.buf.offset;
-                  /* XXX Unsure if we need to sanitize parameters? */
-                  assert(view->u.buf.offset + view->u.buf.size <= res->width0);
-               }
-            }
-         }
-         else {
-            /* display target texture/surface */
-            /*
-             * XXX: Where should this be unmapped?
-             */
-            struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
-            struct sw_winsys *winsys = screen->winsys;
-            jit_tex->base = winsys->displaytarget_map(winsys, lp_tex->dt,
-                                                         PIPE_TRANSFER_READ);
-            jit_tex->row_stride[0] = lp_tex->row_stride[0];
-            jit_tex->img_stride[0] = lp_tex->img_stride[0];
-            jit_tex->mip_offsets[0] = 0;
-            jit_tex->width = res->width0;
-            jit_tex->height = res->height0;
-            jit_tex->depth = res->depth0;
-            jit_tex->first_level = jit_tex->last_level = 0;
-            assert(jit_tex->base);
-         }
+         lp_setup_fill_jit_texture(&setup->fs.current.jit_context.textures[i],
+                                   view);
       }
       else {
          pipe_resource_reference(&setup->fs.current_tex[i], NULL);
@@ -983,11 +1047,29 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
+   /* check the scenes still being built or rasterized */
+   for (i = 0; i < setup->num_scenes; i++) {
+      struct lp_scene *scene = setup->scenes[i];
+      unsigned j, ref = LP_UNREFERENCED;
+
+      /* finished, just not recycled yet */
+      if (!scene->fence || lp_fence_signalled(scene->fence))
+         continue;
+
+      /* the rasterizer may be releasing the scene meanwhile */
+      mtx_lock(&scene->mutex);
+      for (j = 0; j < scene->fb.nr_cbufs; j++) {
+         if (scene->fb.cbufs[j] && scene->fb.cbufs[j]->texture == texture)
+            ref = LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
       }
+      if (scene->fb.zsbuf && scene->fb.zsbuf->texture == texture)
+         ref = LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      if (!ref)
+         ref = lp_scene_is_resource_referenced(scene, texture);
+      mtx_unlock(&scene->mutex);
+
+      if (ref)
+         return ref;
    }
 
    return LP_UNREFERENCED;
@@ -1010,6 +1092,7 @@ static boolean
 try_update_scene_state( struct lp_setup_context *setup )
 {
    static const float fake_const_buf[4];
+   static uint32_t fake_ssbo_buf;
    boolean new_scene = (setup->fs.stored == NULL);
    struct lp_scene *scene = setup->scene;
    unsigned i;
@@ -1134,6 +1217,25 @@ try_update_scene_state( struct lp_setup_context *setup )
    }
 
 
+   if (setup->dirty & LP_SETUP_NEW_SSBOS) {
+      for (i = 0; i < ARRAY_SIZE(setup->ssbos); ++i) {
+         const struct pipe_shader_buffer *sb = &setup->ssbos[i];
+
+         if (sb->buffer) {
+            setup->fs.current.jit_context.ssbos[i] =
+               (uint8_t *) llvmpipe_resource_data(sb->buffer) +
+               sb->buffer_offset;
+            setup->fs.current.jit_context.num_ssbos[i] = sb->buffer_size;
+         }
+         else {
+            setup->fs.current.jit_context.ssbos[i] = (uint8_t *) &fake_ssbo_buf;
+            setup->fs.current.jit_context.num_ssbos[i] = 0;
+         }
+      }
+      setup->dirty |= LP_SETUP_NEW_FS;
+   }
+
+
    if (setup->dirty & LP_SETUP_NEW_FS) {
       if (!setup->fs.stored ||
           memcmp(setup->fs.stored,
@@ -1164,7 +1266,21 @@ try_update_scene_state( struct lp_setup_context *setup )
             if (setup->fs.current_tex[i]) {
                if (!lp_scene_add_resource_reference(scene,
                                                     setup->fs.current_tex[i],
-                                                    new_scene)) {
+                                                    new_scene, FALSE)) {
+                  assert(!new_scene);
+                  return FALSE;
+               }
+            }
+         }
+
+         /* The shader may write to its buffers, which must keep later
+          * mappings waiting for the scene.
+          */
+         for (i = 0; i < ARRAY_SIZE(setup->ssbos); i++) {
+            if (setup->ssbos[i].buffer) {
+               if (!lp_scene_add_resource_reference(scene,
+                                                    setup->ssbos[i].buffer,
+                                                    new_scene, TRUE)) {
                   assert(!new_scene);
                   return FALSE;
                }
@@ -1228,6 +1344,8 @@ lp_setup_update_state( struct lp_setup_context *setup,
       assert(memcmp(&lp->setup_variant.key,
 		    &setup->setup.variant->key,
 		    setup->setup.variant->key.size) == 0);
+
+      lp_setup_hiz_update_state(setup);
    }
 
    if (update_scene && setup->state != SETUP_ACTIVE) {
@@ -1285,8 +1403,12 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->constants[i].current.buffer, NULL);
    }
 
+   for (i = 0; i < ARRAY_SIZE(setup->ssbos); i++) {
+      pipe_resource_reference(&setup->ssbos[i].buffer, NULL);
+   }
+
    /* free the scenes in the 'empty' queue */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+   for (i = 0; i < setup->num_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
 
       if (scene->fence)
@@ -1297,6 +1419,10 @@ lp_setup_destroy( struct lp_setup_context *setup )
 
    lp_fence_reference(&setup->last_fence, NULL);
 
+   lp_setup_hiz_destroy(setup);
+
+   lp_setup_destroy_slices(setup);
+
    FREE( setup );
 }
 
@@ -1312,21 +1438,26 @@ lp_setup_create( struct pipe_context *pipe,
 {
    struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    struct lp_setup_context *setup;
-   unsigned i;
 
    setup = CALLOC_STRUCT(lp_setup_context);
    if (!setup) {
       goto no_setup;
    }
 
-   lp_setup_init_vbuf(setup);
-   
    /* Used only in update_state():
     */
    setup->pipe = pipe;
+   setup->counters = &llvmpipe_context(pipe)->counters;
 
 
    setup->num_threads = screen->num_threads;
+
+   /* Before the vbuf stage is created, as it picks the batch size */
+   if (util_queue_is_initialized(&screen->worker_queue))
+      lp_setup_init_slices(setup, &screen->worker_queue,
+                           screen->num_bin_threads);
+   lp_setup_init_vbuf(setup);
+
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
    if (!setup->vbuf) {
       goto no_vbuf;
@@ -1335,13 +1466,18 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_rasterize_stage(draw, setup->vbuf);
    draw_set_render(draw, &setup->base);
 
-   /* create some empty scenes */
-   for (i = 0; i < MAX_SCENES; i++) {
-      setup->scenes[i] = lp_scene_create( pipe );
-      if (!setup->scenes[i]) {
-         goto no_scenes;
-      }
+   /* Create one empty scene, more are added as needed.  Without
+    * rasterizer threads scenes complete synchronously so one is enough.
+    */
+   setup->max_scenes = setup->num_threads ?
+      debug_get_num_option("LP_NUM_SCENES", 4) : 1;
+   setup->max_scenes = CLAMP(setup->max_scenes, 1, MAX_SCENES);
+
+   setup->scenes[0] = lp_scene_create( pipe );
+   if (!setup->scenes[0]) {
+      goto no_scenes;
    }
+   setup->num_scenes = 1;
 
    setup->triangle = first_triangle;
    setup->line     = first_line;
@@ -1356,14 +1492,9 @@ lp_setup_create( struct pipe_context *pipe,
    return setup;
 
 no_scenes:
-   for (i = 0; i < MAX_SCENES; i++) {
-      if (setup->scenes[i]) {
-         lp_scene_destroy(setup->scenes[i]);
-      }
-   }
-
    setup->vbuf->destroy(setup->vbuf);
 no_vbuf:
+   lp_setup_destroy_slices(setup);
    FREE(setup);
 no_setup:
    return NULL;
@@ -1383,7 +1514,8 @@ lp_setup_begin_query(struct lp_setup_context *setup,
    if (!(pq->type == PIPE_QUERY_OCCLUSION_COUNTER ||
          pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
          pq->type == PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE ||
-         pq->type == PIPE_QUERY_PIPELINE_STATISTICS))
+         pq->type == PIPE_QUERY_PIPELINE_STATISTICS ||
+         pq->rast_counter))
       return;
 
    /* init the query to its beginning state */
@@ -1435,7 +1567,8 @@ lp_setup_end_query(struct lp_setup_context *setup, struct llvmpipe_query *pq)
           pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
           pq->type == PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE ||
           pq->type == PIPE_QUERY_PIPELINE_STATISTICS ||
-          pq->type == PIPE_QUERY_TIMESTAMP) {
+          pq->type == PIPE_QUERY_TIMESTAMP ||
+          pq->rast_counter) {
          if (pq->type == PIPE_QUERY_TIMESTAMP &&
                !(setup->scene->tiles_x | setup->scene->tiles_y)) {
             /*
@@ -1471,7 +1604,8 @@ fail:
    if (pq->type == PIPE_QUERY_OCCLUSION_COUNTER ||
       pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
       pq->type == PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE ||
-      pq->type == PIPE_QUERY_PIPELINE_STATISTICS) {
+      pq->type == PIPE_QUERY_PIPELINE_STATISTICS ||
+      pq->rast_counter) {
       unsigned i;
 
       /* remove from active binned query list */
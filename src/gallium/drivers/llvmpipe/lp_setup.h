@@ -104,6 +104,11 @@ lp_setup_set_fs_constants(struct lp_setup_context *setup,
                           unsigned num,
                           struct pipe_constant_buffer *buffers);
 
+void
+lp_setup_set_fs_ssbos(struct lp_setup_context *setup,
+                      unsigned num,
+                      const struct pipe_shader_buffer *buffers);
+
 void
 lp_setup_set_alpha_ref_value( struct lp_setup_context *setup,
                               float alpha_ref_value );
@@ -125,6 +130,10 @@ lp_setup_set_viewports(struct lp_setup_context *setup,
                        unsigned num_viewports,
                        const struct pipe_viewport_state *viewports);
 
+void
+lp_setup_fill_jit_texture(struct lp_jit_texture *jit_tex,
+                          const struct pipe_sampler_view *view);
+
 void
 lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
                                     unsigned num,
@@ -39,25 +39,66 @@
 #include "lp_rast.h"
 #include "lp_scene.h"
 #include "lp_bld_interp.h"	/* for struct lp_shader_input */
+#include "lp_perf.h"
+#include "lp_limits.h"
 
 #include "draw/draw_vbuf.h"
 #include "util/u_rect.h"
 #include "util/u_pack_color.h"
+#include "util/u_queue.h"
 
 #define LP_SETUP_NEW_FS          0x01
 #define LP_SETUP_NEW_CONSTANTS   0x02
 #define LP_SETUP_NEW_BLEND_COLOR 0x04
 #define LP_SETUP_NEW_SCISSOR     0x08
 #define LP_SETUP_NEW_VIEWPORTS   0x10
+#define LP_SETUP_NEW_SSBOS       0x20
 
 
 struct lp_setup_variant;
+struct lp_setup_slice;
 
 
-/** Max number of scenes */
-/* XXX: make multiple scenes per context work, see lp_setup_rasterize_scene */
-#define MAX_SCENES 1
+/** Max number of scenes per context; up to LP_NUM_SCENES of them are
+ * created on demand, so that binning can run ahead of rasterization.
+ */
+#define MAX_SCENES 8
 
+/** Hierarchical z granularity, the rasterizer's 16x16 blocks */
+#define LP_HIZ_BLOCK_ORDER 4
+#define LP_HIZ_BLOCK_SIZE (1 << LP_HIZ_BLOCK_ORDER)
+
+
+/**
+ * Hierarchical z: conservative upper bounds of the contents of the bound
+ * depth buffer, as of everything binned so far.  See lp_setup_hiz.c.
+ */
+struct lp_setup_hiz
+{
+   boolean valid;           /**< bounds below describe the depth buffer */
+   unsigned resource_id;    /**< llvmpipe_resource::id they describe */
+   unsigned level, layer;
+   unsigned serial;         /**< llvmpipe_resource::hiz_serial seen */
+
+   unsigned blocks_x, blocks_y;
+   unsigned tiles_x, tiles_y;
+   float *block_zmax;       /**< per 16x16 block */
+   float *tile_zmax;        /**< per tile, max of its blocks */
+
+   boolean test;            /**< current state may cull against the bounds */
+   boolean update;          /**< current state may lower the bounds */
+   boolean depth_clamp;     /**< fragment z is clamped to the viewport range */
+};
+
+
+/** Depth plane of a primitive, for testing it against the hiz bounds */
+struct lp_setup_hiz_prim
+{
+   float a0, dzdx, dzdy;
+   float eps;               /**< error bound of evaluating the plane */
+   float zlo, zhi;          /**< range fragment z ends up clamped to */
+   struct u_rect bbox;
+};
 
 
 /**
@@ -74,6 +115,7 @@ struct lp_setup_context
    struct vbuf_render base;
 
    struct pipe_context *pipe;
+   struct lp_counters *counters;  /**< the llvmpipe context's */
    struct vertex_info *vertex_info;
    uint prim;
    uint vertex_size;
@@ -88,6 +130,8 @@ struct lp_setup_context
    struct draw_stage *vbuf;
    unsigned num_threads;
    unsigned scene_idx;
+   unsigned num_scenes;                  /**< scenes created so far */
+   unsigned max_scenes;                  /**< scenes we may create */
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
@@ -143,6 +187,9 @@ struct lp_setup_context
       const void *stored_data;
    } constants[LP_MAX_TGSI_CONST_BUFFERS];
 
+   /** fragment shader buffers, written in place by the rasterizer */
+   struct pipe_shader_buffer ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+
    struct {
       struct pipe_blend_color current;
       uint8_t *stored;
@@ -153,6 +200,14 @@ struct lp_setup_context
       const struct lp_setup_variant *variant;
    } setup;
 
+   struct lp_setup_hiz hiz;
+
+   /** Parallel binning of triangle lists, see lp_setup_slice.c */
+   struct util_queue *bin_queue;   /**< the screen's, shared */
+   unsigned num_slices;
+   struct lp_setup_slice *slices[LP_MAX_BIN_THREADS];
+   struct lp_setup_slice *slice;   /**< only set in a slice's copy */
+
    unsigned dirty;   /**< bitmask of LP_SETUP_NEW_x bits */
 
    void (*point)( struct lp_setup_context *,
@@ -214,6 +269,44 @@ lp_setup_alloc_triangle(struct lp_scene *scene,
                         unsigned nr_planes,
                         unsigned *tri_size);
 
+void
+lp_setup_hiz_destroy(struct lp_setup_context *setup);
+
+void
+lp_setup_hiz_update_state(struct lp_setup_context *setup);
+
+void
+lp_setup_hiz_clear(struct lp_setup_context *setup, double depth);
+
+boolean
+lp_setup_hiz_begin_prim(struct lp_setup_context *setup,
+                        const struct lp_rast_triangle *tri,
+                        const struct u_rect *bbox,
+                        unsigned viewport_index,
+                        struct lp_setup_hiz_prim *prim);
+
+unsigned
+lp_setup_hiz_tile(struct lp_setup_context *setup,
+                  const struct lp_setup_hiz_prim *prim,
+                  const struct lp_rast_triangle *tri,
+                  unsigned plane_mask,
+                  int tx, int ty);
+
+void
+lp_setup_init_slices(struct lp_setup_context *setup,
+                     struct util_queue *queue,
+                     unsigned num_threads);
+
+void
+lp_setup_destroy_slices(struct lp_setup_context *setup);
+
+unsigned
+lp_setup_bin_triangles(struct lp_setup_context *setup,
+                       const void *vertex_buffer,
+                       unsigned stride,
+                       const ushort *indices,
+                       unsigned nr);
+
 boolean
 lp_setup_bin_triangle(struct lp_setup_context *setup,
                       struct lp_rast_triangle *tri,
@@ -0,0 +1,487 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Hierarchical z for binning.
+ *
+ * Setup keeps a conservative upper bound of the depth buffer contents for
+ * each 16x16 block (and each tile) of the bound depth buffer.  The bounds
+ * start out unknown, are set by depth clears, and are lowered by primitives
+ * which are known to write depth over whole blocks with a LESS/LEQUAL
+ * test.  Primitives drawn with a LESS/LEQUAL/EQUAL test whose nearest
+ * depth lies behind the bound of a block can't touch any of its pixels, so
+ * such blocks are not binned (whole tiles) or are handed to the rasterizer
+ * as a mask of blocks to skip (see LP_RAST_HIZ_SHIFT).
+ *
+ * Everything here happens at binning time, in primitive order, so the
+ * bounds only ever reflect what has been binned, never what the rasterizer
+ * actually wrote.  Anything else writing the depth buffer (transfers, draws
+ * which may raise depth values) bumps llvmpipe_resource::hiz_serial, which
+ * resets the bounds to unknown.
+ */
+
+#include <float.h>
+
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_format.h"
+#include "util/u_inlines.h"
+#include "lp_setup_context.h"
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_rast.h"
+#include "lp_state_fs.h"
+#include "lp_texture.h"
+
+
+/**
+ * Slack for the rounding of depth values to the buffer format (16 bit
+ * unorm is the coarsest we have).
+ */
+#define HIZ_FORMAT_EPS (1.0f / 65536.0f)
+
+
+static void
+hiz_fill(struct lp_setup_hiz *hiz, float value)
+{
+   unsigned i;
+
+   for (i = 0; i < hiz->blocks_x * hiz->blocks_y; i++)
+      hiz->block_zmax[i] = value;
+
+   for (i = 0; i < hiz->tiles_x * hiz->tiles_y; i++)
+      hiz->tile_zmax[i] = value;
+}
+
+
+/**
+ * Point the bounds at the given depth surface, with unknown contents.
+ */
+static boolean
+hiz_bind(struct lp_setup_hiz *hiz,
+         const struct pipe_surface *zsbuf)
+{
+   const struct llvmpipe_resource *lpr = llvmpipe_resource(zsbuf->texture);
+   unsigned blocks_x = DIV_ROUND_UP(zsbuf->width, LP_HIZ_BLOCK_SIZE);
+   unsigned blocks_y = DIV_ROUND_UP(zsbuf->height, LP_HIZ_BLOCK_SIZE);
+
+   if (!hiz->block_zmax ||
+       hiz->blocks_x != blocks_x ||
+       hiz->blocks_y != blocks_y) {
+      FREE(hiz->block_zmax);
+      FREE(hiz->tile_zmax);
+
+      hiz->blocks_x = blocks_x;
+      hiz->blocks_y = blocks_y;
+      hiz->tiles_x = DIV_ROUND_UP(zsbuf->width, TILE_SIZE);
+      hiz->tiles_y = DIV_ROUND_UP(zsbuf->height, TILE_SIZE);
+      hiz->block_zmax = MALLOC(blocks_x * blocks_y * sizeof(float));
+      hiz->tile_zmax = MALLOC(hiz->tiles_x * hiz->tiles_y * sizeof(float));
+
+      if (!hiz->block_zmax || !hiz->tile_zmax) {
+         FREE(hiz->block_zmax);
+         FREE(hiz->tile_zmax);
+         hiz->block_zmax = NULL;
+         hiz->tile_zmax = NULL;
+         hiz->valid = FALSE;
+         return FALSE;
+      }
+   }
+
+   hiz->resource_id = lpr->id;
+   hiz->level = zsbuf->u.tex.level;
+   hiz->layer = zsbuf->u.tex.first_layer;
+   hiz->serial = p_atomic_read(&lpr->hiz_serial);
+   hiz->valid = TRUE;
+
+   hiz_fill(hiz, FLT_MAX);
+
+   return TRUE;
+}
+
+
+/**
+ * Is there a single-layer depth surface bound we can keep bounds for?
+ */
+static boolean
+hiz_usable_zsbuf(const struct pipe_surface *zsbuf)
+{
+   return zsbuf &&
+          zsbuf->texture->target != PIPE_BUFFER &&
+          zsbuf->u.tex.first_layer == zsbuf->u.tex.last_layer &&
+          util_format_has_depth(util_format_description(zsbuf->format));
+}
+
+
+static inline boolean
+hiz_func_less(unsigned func)
+{
+   return func == PIPE_FUNC_LESS || func == PIPE_FUNC_LEQUAL;
+}
+
+
+void
+lp_setup_hiz_destroy(struct lp_setup_context *setup)
+{
+   FREE(setup->hiz.block_zmax);
+   FREE(setup->hiz.tile_zmax);
+   setup->hiz.block_zmax = NULL;
+   setup->hiz.tile_zmax = NULL;
+   setup->hiz.valid = FALSE;
+}
+
+
+/**
+ * Called for every draw from lp_setup_update_state(), after the derived
+ * state has been validated: decides whether the current state may test
+ * against and/or lower the bounds, and drops them when the depth buffer
+ * changed behind our back.
+ */
+void
+lp_setup_hiz_update_state(struct lp_setup_context *setup)
+{
+   struct llvmpipe_context *lp = llvmpipe_context(setup->pipe);
+   struct lp_setup_hiz *hiz = &setup->hiz;
+   const struct pipe_surface *zsbuf = setup->fb.zsbuf;
+   const struct pipe_depth_stencil_alpha_state *dsa = lp->depth_stencil;
+   const struct pipe_rasterizer_state *rast = lp->rasterizer;
+   const struct lp_fragment_shader *fs = lp->fs;
+   struct llvmpipe_resource *lpr;
+   boolean depth_writes;
+   boolean stencil_keep;
+   unsigned func;
+   unsigned i;
+
+   hiz->test = FALSE;
+   hiz->update = FALSE;
+
+   if (!zsbuf || !dsa || !rast || !fs ||
+       rast->rasterizer_discard ||
+       (LP_PERF & PERF_NO_DEPTH))
+      return;
+
+   lpr = llvmpipe_resource(zsbuf->texture);
+   func = dsa->depth.func;
+   depth_writes = dsa->depth.enabled && dsa->depth.writemask;
+
+   /*
+    * A draw which may raise depth values invalidates everybody's bounds
+    * for this buffer, including ours.
+    */
+   if (depth_writes &&
+       func != PIPE_FUNC_NEVER &&
+       func != PIPE_FUNC_EQUAL &&
+       !hiz_func_less(func)) {
+      p_atomic_inc(&lpr->hiz_serial);
+      hiz->valid = FALSE;
+      return;
+   }
+
+   if ((LP_PERF & PERF_NO_HIZ) || !hiz_usable_zsbuf(zsbuf)) {
+      hiz->valid = FALSE;
+      return;
+   }
+
+   if (!hiz->valid ||
+       hiz->resource_id != lpr->id ||
+       hiz->level != zsbuf->u.tex.level ||
+       hiz->layer != zsbuf->u.tex.first_layer ||
+       hiz->serial != p_atomic_read(&lpr->hiz_serial)) {
+      if (!hiz_bind(hiz, zsbuf))
+         return;
+   }
+
+   /*
+    * Culled blocks must not have any side effects other than failing the
+    * depth test: no stencil updates, no shader stores, and the fragment
+    * depth must be what setup interpolates.
+    */
+   stencil_keep = TRUE;
+   for (i = 0; i < 2; i++) {
+      if (dsa->stencil[i].enabled &&
+          (dsa->stencil[i].fail_op != PIPE_STENCIL_OP_KEEP ||
+           dsa->stencil[i].zfail_op != PIPE_STENCIL_OP_KEEP))
+         stencil_keep = FALSE;
+   }
+
+   hiz->depth_clamp = rast->clip_halfz || !rast->depth_clip_near;
+
+   hiz->test = dsa->depth.enabled &&
+               (hiz_func_less(func) || func == PIPE_FUNC_EQUAL) &&
+               stencil_keep &&
+               !fs->info.base.writes_z &&
+               !fs->info.base.writes_memory;
+
+   /*
+    * Lowering the bounds needs every covered pixel to be written, unless
+    * it already held something nearer.
+    */
+   hiz->update = depth_writes &&
+                 hiz_func_less(func) &&
+                 !dsa->stencil[0].enabled &&
+                 !dsa->alpha.enabled &&
+                 !(lp->blend && lp->blend->alpha_to_coverage) &&
+                 !fs->info.base.uses_kill &&
+                 !fs->info.base.writes_z &&
+                 !fs->info.base.writes_samplemask;
+}
+
+
+/**
+ * A depth clear of the whole bound surface.
+ */
+void
+lp_setup_hiz_clear(struct lp_setup_context *setup, double depth)
+{
+   struct lp_setup_hiz *hiz = &setup->hiz;
+   const struct pipe_surface *zsbuf = setup->fb.zsbuf;
+   struct llvmpipe_resource *lpr;
+
+   if (!hiz_usable_zsbuf(zsbuf)) {
+      hiz->valid = FALSE;
+      return;
+   }
+
+   /* The clear may raise values other contexts have bounds for. */
+   lpr = llvmpipe_resource(zsbuf->texture);
+   p_atomic_inc(&lpr->hiz_serial);
+
+   if (!hiz_bind(hiz, zsbuf))
+      return;
+
+   hiz_fill(hiz, (float) depth + HIZ_FORMAT_EPS);
+}
+
+
+/**
+ * Get a primitive's depth plane.  Returns FALSE if there's nothing to test
+ * or update for it.
+ *
+ * \param bbox  the primitive's bounding box, not trimmed to the scissor /
+ *              draw region: pixels outside those are excluded by planes,
+ *              not by the box.
+ */
+boolean
+lp_setup_hiz_begin_prim(struct lp_setup_context *setup,
+                        const struct lp_rast_triangle *tri,
+                        const struct u_rect *bbox,
+                        unsigned viewport_index,
+                        struct lp_setup_hiz_prim *prim)
+{
+   const struct lp_setup_hiz *hiz = &setup->hiz;
+   const struct lp_rast_shader_inputs *inputs = &tri->inputs;
+   float x, y;
+
+   if (!hiz->valid || !(hiz->test || hiz->update))
+      return FALSE;
+
+   /* The position is always in input slot zero. */
+   prim->a0 = GET_A0(inputs)[0][2];
+   prim->dzdx = GET_DADX(inputs)[0][2];
+   prim->dzdy = GET_DADY(inputs)[0][2];
+   prim->bbox = *bbox;
+
+   /*
+    * Account for the rounding of evaluating the plane at the far corner,
+    * which is also an upper bound of what the shader's interpolation of
+    * the same plane gets wrong.
+    */
+   x = (float) MAX2(abs(bbox->x0 - 1), abs(bbox->x1 + 2));
+   y = (float) MAX2(abs(bbox->y0 - 1), abs(bbox->y1 + 2));
+   prim->eps = HIZ_FORMAT_EPS +
+               8.0f * FLT_EPSILON * (fabsf(prim->a0) +
+                                     fabsf(prim->dzdx) * x +
+                                     fabsf(prim->dzdy) * y);
+
+   if (hiz->depth_clamp) {
+      prim->zlo = setup->viewports[viewport_index].min_depth;
+      prim->zhi = setup->viewports[viewport_index].max_depth;
+   }
+   else {
+      prim->zlo = 0.0f;
+      prim->zhi = 1.0f;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Range of the primitive's depth over the pixels of a rect.  The plane is
+ * evaluated at the rect's corners, padded by a pixel for pixel centers.
+ */
+static inline void
+hiz_prim_z_range(const struct lp_setup_hiz_prim *prim,
+                 const struct u_rect *rect,
+                 float *zmin, float *zmax)
+{
+   float zx0 = prim->dzdx * (float) (rect->x0 - 1);
+   float zx1 = prim->dzdx * (float) (rect->x1 + 2);
+   float zy0 = prim->dzdy * (float) (rect->y0 - 1);
+   float zy1 = prim->dzdy * (float) (rect->y1 + 2);
+   float lo = prim->a0 + MIN2(zx0, zx1) + MIN2(zy0, zy1);
+   float hi = prim->a0 + MAX2(zx0, zx1) + MAX2(zy0, zy1);
+
+   *zmin = CLAMP(lo, prim->zlo, prim->zhi) - prim->eps;
+   *zmax = CLAMP(hi, prim->zlo, prim->zhi) + prim->eps;
+}
+
+
+/**
+ * Is a 16x16 block, at pixel position px, py, fully inside the given planes?
+ */
+static inline boolean
+hiz_block_covered(const struct lp_rast_triangle *tri,
+                  unsigned plane_mask,
+                  int px, int py)
+{
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+
+   while (plane_mask) {
+      const struct lp_rast_plane *p = &plane[u_bit_scan(&plane_mask)];
+      int64_t c = p->c + IMUL64(p->dcdy, py) - IMUL64(p->dcdx, px);
+      int64_t ei = ((int64_t) p->dcdy - p->dcdx - (int64_t) p->eo)
+                   << LP_HIZ_BLOCK_ORDER;
+
+      if (c + ei - 1 < 0)
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Test (and possibly update) the blocks of tile tx, ty against a primitive
+ * which is about to be binned there.
+ *
+ * \param plane_mask  planes which don't trivially accept the whole tile
+ * \return mask of 16x16 blocks (bit = by * 4 + bx) the primitive can't
+ *         touch, 0xffff if it can't touch the tile at all
+ */
+unsigned
+lp_setup_hiz_tile(struct lp_setup_context *setup,
+                  const struct lp_setup_hiz_prim *prim,
+                  const struct lp_rast_triangle *tri,
+                  unsigned plane_mask,
+                  int tx, int ty)
+{
+   struct lp_setup_hiz *hiz = &setup->hiz;
+   const unsigned tile_blocks = TILE_SIZE / LP_HIZ_BLOCK_SIZE;
+   unsigned hidden = 0, offgrid = 0;
+   boolean lowered = FALSE;
+   struct u_rect rect;
+   float zmin, zmax;
+   unsigned bx, by;
+
+   if (tx < 0 || ty < 0 ||
+       (unsigned) tx >= hiz->tiles_x || (unsigned) ty >= hiz->tiles_y)
+      return 0;
+
+   rect.x0 = tx * TILE_SIZE;
+   rect.y0 = ty * TILE_SIZE;
+   rect.x1 = rect.x0 + TILE_SIZE - 1;
+   rect.y1 = rect.y0 + TILE_SIZE - 1;
+   u_rect_find_intersection(&prim->bbox, &rect);
+
+   if (hiz->test) {
+      hiz_prim_z_range(prim, &rect, &zmin, &zmax);
+      if (zmin > hiz->tile_zmax[ty * hiz->tiles_x + tx]) {
+         LP_COUNT(setup->counters, nr_hiz_culled_64);
+         return 0xffff;
+      }
+   }
+
+   for (by = 0; by < tile_blocks; by++) {
+      for (bx = 0; bx < tile_blocks; bx++) {
+         const unsigned bit = 1 << (by * tile_blocks + bx);
+         const unsigned gx = tx * tile_blocks + bx;
+         const unsigned gy = ty * tile_blocks + by;
+         float *block_zmax;
+
+         if (gx >= hiz->blocks_x || gy >= hiz->blocks_y) {
+            offgrid |= bit;
+            continue;
+         }
+
+         rect.x0 = gx * LP_HIZ_BLOCK_SIZE;
+         rect.y0 = gy * LP_HIZ_BLOCK_SIZE;
+         rect.x1 = rect.x0 + LP_HIZ_BLOCK_SIZE - 1;
+         rect.y1 = rect.y0 + LP_HIZ_BLOCK_SIZE - 1;
+
+         if (!u_rect_test_intersection(&prim->bbox, &rect)) {
+            /* nothing of the primitive in there anyway */
+            hidden |= bit;
+            continue;
+         }
+
+         block_zmax = &hiz->block_zmax[gy * hiz->blocks_x + gx];
+
+         u_rect_find_intersection(&prim->bbox, &rect);
+         hiz_prim_z_range(prim, &rect, &zmin, &zmax);
+
+         if (hiz->test && zmin > *block_zmax) {
+            hidden |= bit;
+            continue;
+         }
+
+         /* Written this way so NaNs don't update anything. */
+         if (hiz->update &&
+             zmax < *block_zmax &&
+             hiz_block_covered(tri, plane_mask,
+                               gx * LP_HIZ_BLOCK_SIZE,
+                               gy * LP_HIZ_BLOCK_SIZE)) {
+            *block_zmax = zmax;
+            lowered = TRUE;
+         }
+      }
+   }
+
+   if (lowered) {
+      float tile_zmax = 0.0f;
+
+      for (by = 0; by < tile_blocks; by++) {
+         const unsigned gy = ty * tile_blocks + by;
+         for (bx = 0; bx < tile_blocks; bx++) {
+            const unsigned gx = tx * tile_blocks + bx;
+            if (gx < hiz->blocks_x && gy < hiz->blocks_y)
+               tile_zmax = MAX2(tile_zmax,
+                                hiz->block_zmax[gy * hiz->blocks_x + gx]);
+         }
+      }
+
+      hiz->tile_zmax[ty * hiz->tiles_x + tx] = tile_zmax;
+   }
+
+   if ((hidden | offgrid) == 0xffff) {
+      LP_COUNT(setup->counters, nr_hiz_culled_64);
+      return 0xffff;
+   }
+
+   return hidden;
+}
@@ -0,0 +1,244 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Parallel binning of triangle lists.
+ *
+ * With LP_BIN_THREADS set, a large enough batch of triangles is cut into
+ * contiguous runs, one per slice.  Each slice sets up and bins its run
+ * with a private copy of the setup context, into a private lp_scene which
+ * holds nothing but bins and the data blocks their commands point to.
+ * The slices are then merged into the real scene in order, by appending
+ * the commands of each of their bins to the scene's bin, so every bin
+ * still sees its commands in primitive order.
+ *
+ * A slice's copy doesn't lower the hierarchical z bounds, as culling would
+ * then depend on which thread got there first; it still culls against the
+ * bounds left by everything binned before the batch.  Nor can it flush the
+ * scene when running out of space: the slice is discarded instead, and
+ * binning continues serially from its first triangle.
+ */
+
+#include "util/u_memory.h"
+#include "lp_setup_context.h"
+#include "lp_scene.h"
+#include "lp_perf.h"
+
+
+/** Don't bother splitting off runs of fewer triangles than this */
+#define LP_SETUP_SLICE_MIN_TRIS 128
+
+
+struct lp_setup_slice
+{
+   struct lp_setup_context setup;   /**< copy of the context, for binning */
+   struct lp_scene *scene;          /**< where the copy bins to */
+   struct lp_counters counters;     /**< what the copy counts into */
+   struct util_queue_fence fence;
+
+   const char *vertex_buffer;
+   const ushort *indices;           /**< NULL for non-indexed draws */
+   unsigned stride;
+   unsigned start, end;             /**< vertices of the run */
+};
+
+
+typedef const float (*const_float4_ptr)[4];
+
+static inline const_float4_ptr
+slice_vert(const struct lp_setup_slice *slice, unsigned i)
+{
+   unsigned index = slice->indices ? slice->indices[i] : i;
+   return (const_float4_ptr)(slice->vertex_buffer + index * slice->stride);
+}
+
+
+static void
+bin_slice(void *data, int thread_index)
+{
+   struct lp_setup_slice *slice = (struct lp_setup_slice *) data;
+   struct lp_setup_context *setup = &slice->setup;
+   unsigned i;
+
+   for (i = slice->start; i < slice->end; i += 3) {
+      setup->triangle(setup,
+                      slice_vert(slice, i + 0),
+                      slice_vert(slice, i + 1),
+                      slice_vert(slice, i + 2));
+
+      /* The whole slice gets discarded anyway */
+      if (lp_scene_is_oom(slice->scene))
+         break;
+   }
+}
+
+
+/**
+ * Bin a triangle list, or a leading part of it, in parallel.
+ * \param indices  NULL for non-indexed draws
+ * \return number of vertices (a multiple of three) whose triangles have
+ *         been binned, the caller takes care of the rest
+ */
+unsigned
+lp_setup_bin_triangles(struct lp_setup_context *setup,
+                       const void *vertex_buffer,
+                       unsigned stride,
+                       const ushort *indices,
+                       unsigned nr)
+{
+   struct lp_scene *scene = setup->scene;
+   const unsigned num_tris = nr / 3;
+   unsigned num_slices, max_size, done;
+   unsigned i;
+
+   num_slices = MIN2(setup->num_slices, num_tris / LP_SETUP_SLICE_MIN_TRIS);
+   if (num_slices < 2 || setup->rasterizer_discard)
+      return 0;
+
+   assert(setup->state == SETUP_ACTIVE);
+   assert(scene);
+
+   /* Split up what is left of the scene's space, if it's worth it.  The
+    * current block of each slice gets accounted for when it's merged.
+    */
+   if (scene->scene_size >= scene->max_size)
+      return 0;
+   max_size = (scene->max_size - scene->scene_size) / num_slices;
+   if (max_size < 2 * sizeof(struct data_block))
+      return 0;
+   max_size -= sizeof(struct data_block);
+
+   /* What first_triangle() would do, before it gets copied */
+   lp_setup_choose_triangle(setup);
+
+   for (i = 0; i < num_slices; i++) {
+      struct lp_setup_slice *slice = setup->slices[i];
+
+      lp_scene_slice_begin(slice->scene, scene, max_size);
+
+      memcpy(&slice->setup, setup, sizeof *setup);
+      slice->setup.scene = slice->scene;
+      slice->setup.counters = &slice->counters;
+      slice->setup.hiz.update = FALSE;
+      slice->setup.slice = slice;
+
+      slice->vertex_buffer = vertex_buffer;
+      slice->indices = indices;
+      slice->stride = stride;
+      slice->start = i * num_tris / num_slices * 3;
+      slice->end = (i + 1) * num_tris / num_slices * 3;
+
+      /* This thread does the first one itself and then waits for the
+       * others, so they go ahead of the vertex shading queued by any
+       * context.
+       */
+      if (i > 0)
+         util_queue_add_job_with_priority(setup->bin_queue, slice,
+                                          &slice->fence, bin_slice, NULL,
+                                          UTIL_QUEUE_PRIORITY_HIGH);
+   }
+
+   bin_slice(setup->slices[0], 0);
+
+   /* Merge in order, up to the first slice which failed */
+   done = 0;
+   for (i = 0; i < num_slices; i++) {
+      struct lp_setup_slice *slice = setup->slices[i];
+
+      if (i > 0)
+         util_queue_fence_wait(&slice->fence);
+
+      if (done == slice->start &&
+          !lp_scene_is_oom(slice->scene) &&
+          lp_scene_slice_merge(scene, slice->scene)) {
+         lp_add_counters(setup->counters, &slice->counters);
+         done = slice->end;
+      }
+      else {
+         lp_scene_slice_discard(slice->scene);
+      }
+
+      memset(&slice->counters, 0, sizeof slice->counters);
+   }
+
+   return done;
+}
+
+
+/**
+ * \param queue  the screen's worker threads, which all contexts share
+ * \param num_threads  how many threads bin a batch, including the one
+ *                     issuing the draw, which bins one of the slices
+ */
+void
+lp_setup_init_slices(struct lp_setup_context *setup,
+                     struct util_queue *queue,
+                     unsigned num_threads)
+{
+   unsigned i;
+
+   if (num_threads < 2)
+      return;
+
+   setup->bin_queue = queue;
+
+   for (i = 0; i < num_threads; i++) {
+      struct lp_setup_slice *slice = CALLOC_STRUCT(lp_setup_slice);
+      if (!slice)
+         break;
+
+      slice->scene = lp_scene_create(setup->pipe);
+      if (!slice->scene) {
+         FREE(slice);
+         break;
+      }
+
+      util_queue_fence_init(&slice->fence);
+      setup->slices[i] = slice;
+   }
+
+   setup->num_slices = i;
+}
+
+
+void
+lp_setup_destroy_slices(struct lp_setup_context *setup)
+{
+   unsigned i;
+
+   for (i = 0; i < setup->num_slices; i++) {
+      struct lp_setup_slice *slice = setup->slices[i];
+
+      util_queue_fence_destroy(&slice->fence);
+      lp_scene_destroy(slice->scene);
+      FREE(slice);
+      setup->slices[i] = NULL;
+   }
+
+   setup->num_slices = 0;
+   setup->bin_queue = NULL;
+}
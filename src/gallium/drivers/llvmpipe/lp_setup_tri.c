@@ -218,7 +218,7 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
 {
    struct lp_scene *scene = setup->scene;
 
-   LP_COUNT(nr_fully_covered_64);
+   LP_COUNT(setup->counters, nr_fully_covered_64);
 
    /* if variant is opaque and scissor doesn't effect the tile */
    if (inputs->opaque) {
@@ -241,13 +241,13 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
          lp_scene_bin_reset( scene, tx, ty );
       }
 
-      LP_COUNT(nr_shade_opaque_64);
+      LP_COUNT(setup->counters, nr_shade_opaque_64);
       return lp_scene_bin_cmd_with_state( scene, tx, ty,
                                           setup->fs.stored,
                                           LP_RAST_OP_SHADE_TILE_OPAQUE,
                                           lp_rast_arg_inputs(inputs) );
    } else {
-      LP_COUNT(nr_shade_64);
+      LP_COUNT(setup->counters, nr_shade_64);
       return lp_scene_bin_cmd_with_state( scene, tx, ty,
                                           setup->fs.stored, 
                                           LP_RAST_OP_SHADE_TILE,
@@ -324,13 +324,13 @@ do_triangle_ccw(struct lp_setup_context *setup,
    if (bbox.x1 < bbox.x0 ||
        bbox.y1 < bbox.y0) {
       if (0) debug_printf("empty bounding box\n");
-      LP_COUNT(nr_culled_tris);
+      LP_COUNT(setup->counters, nr_culled_tris);
       return TRUE;
    }
 
    if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
       if (0) debug_printf("offscreen\n");
-      LP_COUNT(nr_culled_tris);
+      LP_COUNT(setup->counters, nr_culled_tris);
       return TRUE;
    }
 
@@ -371,7 +371,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
    tri->v[2][1] = v2[0][1];
 #endif
 
-   LP_COUNT(nr_tris);
+   LP_COUNT(setup->counters, nr_tris);
 
    /* Setup parameter interpolants:
     */
@@ -748,16 +748,18 @@ floor_pot(uint32_t n)
 }
 
 
-boolean
-lp_setup_bin_triangle(struct lp_setup_context *setup,
-                      struct lp_rast_triangle *tri,
-                      const struct u_rect *bboxorig,
-                      const struct u_rect *bbox,
-                      int nr_planes,
-                      unsigned viewport_index)
+static boolean
+do_bin_triangle(struct lp_setup_context *setup,
+                struct lp_rast_triangle *tri,
+                const struct u_rect *bboxorig,
+                const struct u_rect *bbox,
+                int nr_planes,
+                unsigned viewport_index)
 {
    struct lp_scene *scene = setup->scene;
    struct u_rect trimmed_box = *bbox;   
+   struct lp_setup_hiz_prim hiz_prim;
+   boolean hiz;
    int i;
    /* What is the largest power-of-two boundary this triangle crosses:
     */
@@ -789,6 +791,8 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
    u_rect_find_intersection(&setup->draw_regions[viewport_index],
                             &trimmed_box);
 
+   hiz = lp_setup_hiz_begin_prim(setup, tri, bbox, viewport_index, &hiz_prim);
+
    /* Determine which tile(s) intersect the triangle's bounding box
     */
    if (dx < TILE_SIZE)
@@ -797,10 +801,18 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       int iy0 = bbox->y0 / TILE_SIZE;
       unsigned px = bbox->x0 & 63 & ~3;
       unsigned py = bbox->y0 & 63 & ~3;
+      unsigned hidden = 0;
 
       assert(iy0 == bbox->y1 / TILE_SIZE &&
 	     ix0 == bbox->x1 / TILE_SIZE);
 
+      if (hiz) {
+         hidden = lp_setup_hiz_tile(setup, &hiz_prim, tri,
+                                    (1 << nr_planes) - 1, ix0, iy0);
+         if (hidden == 0xffff)
+            return TRUE;
+      }
+
       if (nr_planes == 3) {
          if (sz < 4)
          {
@@ -862,7 +874,7 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       return lp_scene_bin_cmd_with_state(
          scene, ix0, iy0, setup->fs.stored,
          use_32bits ? lp_rast_32_tri_tab[nr_planes] : lp_rast_tri_tab[nr_planes],
-         lp_rast_arg_triangle(tri, (1<<nr_planes)-1));
+         lp_rast_arg_triangle_hiz(tri, (1<<nr_planes)-1, hidden));
    }
    else
    {
@@ -913,6 +925,7 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
          {
             int out = 0;
             int partial = 0;
+            unsigned hidden = 0;
 
             for (i = 0; i < nr_planes; i++) {
                int64_t planeout = cx[i] + eo[i];
@@ -925,7 +938,7 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                /* do nothing */
                if (in)
                   break;  /* exiting triangle, all done with this row */
-               LP_COUNT(nr_empty_64);
+               LP_COUNT(setup->counters, nr_empty_64);
             }
             else if (partial) {
                /* Not trivially accepted by at least one plane -
@@ -933,22 +946,46 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                 */
                int count = util_bitcount(partial);
                in = TRUE;
-               
-               if (!lp_scene_bin_cmd_with_state( scene, x, y,
+
+               if (hiz)
+                  hidden = lp_setup_hiz_tile(setup, &hiz_prim, tri,
+                                             partial, x, y);
+
+               /* Skip the tile if it's all hidden by the depth buffer */
+               if (hidden != 0xffff &&
+                   !lp_scene_bin_cmd_with_state( scene, x, y,
                                                  setup->fs.stored,
                                                  use_32bits ?
                                                  lp_rast_32_tri_tab[count] :
                                                  lp_rast_tri_tab[count],
-                                                 lp_rast_arg_triangle(tri, partial) ))
+                                                 lp_rast_arg_triangle_hiz(tri, partial, hidden) ))
                   goto fail;
 
-               LP_COUNT(nr_partially_covered_64);
+               LP_COUNT(setup->counters, nr_partially_covered_64);
             }
             else {
                /* triangle covers the whole tile- shade whole tile */
-               LP_COUNT(nr_fully_covered_64);
+               LP_COUNT(setup->counters, nr_fully_covered_64);
                in = TRUE;
-               if (!lp_setup_whole_tile(setup, &tri->inputs, x, y))
+
+               if (hiz)
+                  hidden = lp_setup_hiz_tile(setup, &hiz_prim, tri,
+                                             0, x, y);
+
+               if (hidden == 0xffff) {
+                  /* hidden behind what's already in the depth buffer */
+               }
+               else if (hidden) {
+                  /* Partly hidden, rasterize with no planes to skip the
+                   * hidden blocks.
+                   */
+                  if (!lp_scene_bin_cmd_with_state( scene, x, y,
+                                                    setup->fs.stored,
+                                                    lp_rast_tri_tab[1],
+                                                    lp_rast_arg_triangle_hiz(tri, 0, hidden) ))
+                     goto fail;
+               }
+               else if (!lp_setup_whole_tile(setup, &tri->inputs, x, y))
                   goto fail;
             }
 
@@ -975,6 +1012,25 @@ fail:
 }
 
 
+boolean
+lp_setup_bin_triangle(struct lp_setup_context *setup,
+                      struct lp_rast_triangle *tri,
+                      const struct u_rect *bboxorig,
+                      const struct u_rect *bbox,
+                      int nr_planes,
+                      unsigned viewport_index)
+{
+   if (do_bin_triangle(setup, tri, bboxorig, bbox, nr_planes, viewport_index))
+      return TRUE;
+
+   /* The hiz bounds may have been lowered for tiles the (now disabled)
+    * triangle won't be drawn to after all.
+    */
+   setup->hiz.valid = FALSE;
+   return FALSE;
+}
+
+
 /**
  * Try to draw the triangle, restart the scene on failure.
  */
@@ -987,6 +1043,10 @@ static void retry_triangle_ccw( struct lp_setup_context *setup,
 {
    if (!do_triangle_ccw( setup, position, v0, v1, v2, front ))
    {
+      /* A binning slice can't flush, lp_setup_bin_triangles() takes care */
+      if (setup->slice)
+         return;
+
       if (!lp_setup_flush_and_restart(setup))
          return;
 
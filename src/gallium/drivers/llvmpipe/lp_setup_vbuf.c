@@ -46,6 +46,12 @@
 #define LP_MAX_VBUF_INDEXES 1024
 #define LP_MAX_VBUF_SIZE    4096
 
+/* With parallel binning, batches need to be big enough to be worth
+ * splitting up.
+ */
+#define LP_MAX_VBUF_INDEXES_SLICED (16 * 1024)
+#define LP_MAX_VBUF_SIZE_SLICED    (256 * 1024)
+
   
 
 /** cast wrapper */
@@ -184,7 +190,8 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
+      i = lp_setup_bin_triangles(setup, vertex_buffer, stride, indices, nr);
+      for (i += 2; i < nr; i += 3) {
          setup->triangle( setup,
                           get_vert(vertex_buffer, indices[i-2], stride),
                           get_vert(vertex_buffer, indices[i-1], stride),
@@ -382,7 +389,8 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
+      i = lp_setup_bin_triangles(setup, vertex_buffer, stride, NULL, nr);
+      for (i += 2; i < nr; i += 3) {
          setup->triangle( setup,
                           get_vert(vertex_buffer, i-2, stride),
                           get_vert(vertex_buffer, i-1, stride),
@@ -585,8 +593,14 @@ lp_setup_pipeline_statistics(
 void
 lp_setup_init_vbuf(struct lp_setup_context *setup)
 {
-   setup->base.max_indices = LP_MAX_VBUF_INDEXES;
-   setup->base.max_vertex_buffer_bytes = LP_MAX_VBUF_SIZE;
+   if (setup->num_slices > 1) {
+      setup->base.max_indices = LP_MAX_VBUF_INDEXES_SLICED;
+      setup->base.max_vertex_buffer_bytes = LP_MAX_VBUF_SIZE_SLICED;
+   }
+   else {
+      setup->base.max_indices = LP_MAX_VBUF_INDEXES;
+      setup->base.max_vertex_buffer_bytes = LP_MAX_VBUF_SIZE;
+   }
 
    setup->base.get_vertex_info = lp_setup_get_vertex_info;
    setup->base.allocate_vertices = lp_setup_allocate_vertices;
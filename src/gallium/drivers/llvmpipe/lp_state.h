@@ -56,6 +56,9 @@
 #define LP_NEW_GS            0x10000
 #define LP_NEW_SO            0x20000
 #define LP_NEW_SO_BUFFERS    0x40000
+#define LP_NEW_TCS           0x80000
+#define LP_NEW_TES           0x100000
+#define LP_NEW_FS_SSBOS      0x200000
 
 
 
@@ -90,6 +93,9 @@ llvmpipe_set_framebuffer_state(struct pipe_context *,
 void
 llvmpipe_update_fs(struct llvmpipe_context *lp);
 
+void
+llvmpipe_poll_fs_variant(struct llvmpipe_context *lp);
+
 void 
 llvmpipe_update_setup(struct llvmpipe_context *lp);
 
@@ -120,12 +126,18 @@ llvmpipe_init_vs_funcs(struct llvmpipe_context *llvmpipe);
 void
 llvmpipe_init_gs_funcs(struct llvmpipe_context *llvmpipe);
 
+void
+llvmpipe_init_tess_funcs(struct llvmpipe_context *llvmpipe);
+
 void
 llvmpipe_init_rasterizer_funcs(struct llvmpipe_context *llvmpipe);
 
 void
 llvmpipe_init_so_funcs(struct llvmpipe_context *llvmpipe);
 
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe);
+
 void
 llvmpipe_prepare_vertex_sampling(struct llvmpipe_context *ctx,
                                  unsigned num,
@@ -136,4 +148,14 @@ llvmpipe_prepare_geometry_sampling(struct llvmpipe_context *ctx,
                                    unsigned num,
                                    struct pipe_sampler_view **views);
 
+void
+llvmpipe_prepare_tess_ctrl_sampling(struct llvmpipe_context *ctx,
+                                    unsigned num,
+                                    struct pipe_sampler_view **views);
+
+void
+llvmpipe_prepare_tess_eval_sampling(struct llvmpipe_context *ctx,
+                                    unsigned num,
+                                    struct pipe_sampler_view **views);
+
 #endif
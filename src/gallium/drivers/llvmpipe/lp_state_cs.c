@@ -0,0 +1,1219 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Compute shaders.
+ *
+ * A workgroup is run one SIMD vector of invocations at a time, and the
+ * workgroups of a grid are distributed over a pool of worker threads which
+ * pull them off a shared counter. The calling thread helps out too.
+ *
+ * The invocations of a workgroup whose shader contains a barrier are run
+ * as LLVM coroutines, one per SIMD vector, which suspend at each barrier.
+ * The generated code resumes them in turn until all have finished, so
+ * that every invocation has reached a barrier before any proceeds.
+ */
+
+#include "pipe/p_defines.h"
+#include "util/u_atomic.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_queue.h"
+#include "util/u_string.h"
+#include "pipe/p_shader_tokens.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "compiler/nir/nir.h"
+#include "nir/nir_to_tgsi_info.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_coro.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_intr.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_nir.h"
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_flush.h"
+#include "lp_query.h"
+#include "lp_screen.h"
+#include "lp_setup.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_tex_sample.h"
+#include "lp_texture.h"
+
+
+static unsigned cs_no = 0;
+
+
+struct lp_cs_job;
+
+
+/**
+ * State of a thread running compute workgroups.
+ */
+struct lp_cs_worker
+{
+   struct lp_jit_cs_thread_data jit;  /**< must be first, passed to the JIT */
+
+   unsigned shared_size;
+
+   const struct lp_cs_job *job;
+   uint32_t block_id[3];
+};
+
+
+/**
+ * A grid launch.
+ */
+struct lp_cs_job
+{
+   struct lp_jit_cs_context jit_context;
+   lp_jit_cs_func func;
+   boolean uses_barrier;
+   unsigned lanes;
+
+   uint32_t grid[3];
+   uint32_t block[3];
+   unsigned block_threads;
+   unsigned shared_size;
+
+   uint64_t num_groups;
+   int64_t next_group;   /**< incremented atomically by the workers */
+};
+
+
+/**
+ * Screen wide pool of threads for running workgroups.
+ */
+struct lp_cs_pool
+{
+   struct util_queue queue;
+   unsigned num_threads;
+   struct lp_cs_worker **workers;   /**< indexed by queue thread index */
+};
+
+
+struct lp_cs_task
+{
+   struct util_queue_fence fence;
+   struct lp_cs_job *job;
+   struct lp_cs_pool *pool;
+};
+
+
+/**
+ * Our lp_build_tgsi_cs_iface, with the coroutine barriers suspend.
+ */
+struct lp_cs_iface
+{
+   struct lp_build_tgsi_cs_iface base;
+#if LP_HAVE_COMPUTE
+   struct lp_build_coro_suspend_info coro_info;
+#endif
+};
+
+
+static inline void
+cs_run_invocations(struct lp_cs_worker *worker, unsigned invocation_base)
+{
+   const struct lp_cs_job *job = worker->job;
+
+   job->func(&job->jit_context,
+             worker->block_id[0], worker->block_id[1], worker->block_id[2],
+             job->grid[0], job->grid[1], job->grid[2],
+             job->block[0], job->block[1], job->block[2],
+             invocation_base, &worker->jit);
+}
+
+
+static void
+cs_run_workgroup(struct lp_cs_worker *worker,
+                 uint32_t x, uint32_t y, uint32_t z)
+{
+   const struct lp_cs_job *job = worker->job;
+   unsigned num_vectors = DIV_ROUND_UP(job->block_threads, job->lanes);
+   unsigned i;
+
+   worker->block_id[0] = x;
+   worker->block_id[1] = y;
+   worker->block_id[2] = z;
+
+   /* With barriers the generated code runs the whole workgroup itself */
+   if (job->uses_barrier) {
+      cs_run_invocations(worker, 0);
+      return;
+   }
+
+   for (i = 0; i < num_vectors; i++) {
+      cs_run_invocations(worker, i * job->lanes);
+   }
+}
+
+
+/**
+ * Make sure the worker has enough shared memory for the job.
+ */
+static boolean
+cs_worker_reserve(struct lp_cs_worker *worker, const struct lp_cs_job *job)
+{
+   if (job->shared_size > worker->shared_size) {
+      align_free(worker->jit.shared);
+      worker->jit.shared = align_malloc(job->shared_size, 64);
+      if (!worker->jit.shared) {
+         worker->shared_size = 0;
+         return FALSE;
+      }
+      worker->shared_size = job->shared_size;
+   }
+
+   worker->job = job;
+   return TRUE;
+}
+
+
+static struct lp_cs_worker *
+cs_worker_create(void)
+{
+   return CALLOC_STRUCT(lp_cs_worker);
+}
+
+
+static void
+cs_worker_destroy(struct lp_cs_worker *worker)
+{
+   if (!worker)
+      return;
+
+   align_free(worker->jit.shared);
+   FREE(worker);
+}
+
+
+/**
+ * Run workgroups of the job until there are none left.
+ */
+static void
+cs_job_run(struct lp_cs_job *job, struct lp_cs_worker *worker)
+{
+   int64_t group;
+
+   if (!worker || !cs_worker_reserve(worker, job))
+      return;
+
+   while ((group = p_atomic_inc_return(&job->next_group) - 1) <
+          (int64_t) job->num_groups) {
+      uint32_t x = group % job->grid[0];
+      uint32_t y = (group / job->grid[0]) % job->grid[1];
+      uint32_t z = group / ((uint64_t) job->grid[0] * job->grid[1]);
+
+      cs_run_workgroup(worker, x, y, z);
+   }
+
+   worker->job = NULL;
+}
+
+
+static void
+cs_task_execute(void *data, int thread_index)
+{
+   struct lp_cs_task *task = (struct lp_cs_task *) data;
+
+   cs_job_run(task->job, task->pool->workers[thread_index]);
+}
+
+
+static struct lp_cs_pool *
+cs_pool_create(unsigned num_threads)
+{
+   struct lp_cs_pool *pool = CALLOC_STRUCT(lp_cs_pool);
+   unsigned i;
+
+   if (!pool)
+      return NULL;
+
+   pool->workers = CALLOC(num_threads, sizeof *pool->workers);
+   if (!pool->workers)
+      goto fail;
+
+   for (i = 0; i < num_threads; i++) {
+      pool->workers[i] = cs_worker_create();
+      if (!pool->workers[i])
+         goto fail;
+   }
+
+   if (!util_queue_init(&pool->queue, "llvmpipe_cs", 2 * num_threads,
+                        num_threads, UTIL_QUEUE_INIT_RESIZE_IF_FULL))
+      goto fail;
+
+   /* the queue may have started fewer threads than asked for */
+   pool->num_threads = pool->queue.num_threads;
+
+   return pool;
+
+fail:
+   if (pool->workers) {
+      for (i = 0; i < num_threads; i++)
+         cs_worker_destroy(pool->workers[i]);
+      FREE(pool->workers);
+   }
+   FREE(pool);
+   return NULL;
+}
+
+
+/**
+ * Get the screen's compute thread pool, creating it on first use.
+ */
+static struct lp_cs_pool *
+cs_get_pool(struct llvmpipe_screen *screen)
+{
+   struct lp_cs_pool *pool;
+
+   if (!screen->num_threads)
+      return NULL;
+
+   mtx_lock(&screen->cs_mutex);
+   if (!screen->cs_pool)
+      screen->cs_pool = cs_pool_create(screen->num_threads);
+   pool = screen->cs_pool;
+   mtx_unlock(&screen->cs_mutex);
+
+   return pool;
+}
+
+
+void
+lp_cs_pool_destroy(struct llvmpipe_screen *screen)
+{
+   struct lp_cs_pool *pool = screen->cs_pool;
+   unsigned i;
+
+   if (!pool)
+      return;
+
+   util_queue_destroy(&pool->queue);
+
+   for (i = 0; i < screen->num_threads; i++)
+      cs_worker_destroy(pool->workers[i]);
+   FREE(pool->workers);
+   FREE(pool);
+
+   screen->cs_pool = NULL;
+}
+
+
+#if LP_HAVE_COMPUTE
+/**
+ * A barrier suspends the invocations' coroutine, to be resumed once all the
+ * others of the workgroup have got as far.
+ */
+static void
+cs_emit_barrier(const struct lp_build_tgsi_cs_iface *cs_iface,
+                struct lp_build_tgsi_context *bld_base)
+{
+   const struct lp_cs_iface *iface = (const struct lp_cs_iface *) cs_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBasicBlockRef resume;
+
+   resume = lp_build_insert_new_block(gallivm, "resume");
+   lp_build_coro_suspend_switch(gallivm, &iface->coro_info, resume, FALSE);
+   LLVMPositionBuilderAtEnd(gallivm->builder, resume);
+}
+
+
+/**
+ * Generate the body of a function which runs a whole workgroup, by
+ * starting a coroutine for each SIMD vector and resuming the unfinished
+ * ones round-robin.
+ */
+static void
+generate_compute_sched(struct lp_compute_shader_variant *variant,
+                       LLVMValueRef function, LLVMValueRef coro,
+                       unsigned num_args)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(lc);
+   LLVMTypeRef int1_type = LLVMInt1TypeInContext(lc);
+   LLVMTypeRef hdl_type = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+   LLVMValueRef args[12];
+   LLVMValueRef total, num_vectors, lanes, hdls, hdl_ptr, hdl;
+   LLVMValueRef pending_ptr, not_done;
+   LLVMBasicBlockRef block, resume_block, done_block;
+   struct lp_build_loop_state loop;
+   struct lp_build_if_state ifthen;
+   unsigned i;
+
+   assert(num_args == ARRAY_SIZE(args));
+
+   block = LLVMAppendBasicBlockInContext(lc, function, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   for (i = 0; i < num_args; i++)
+      args[i] = LLVMGetParam(function, i);
+
+   total = LLVMBuildMul(builder, args[7], args[8], "");
+   total = LLVMBuildMul(builder, total, args[9], "");
+   lanes = lp_build_const_int32(gallivm, variant->lanes);
+   num_vectors = LLVMBuildAdd(builder, total,
+                              lp_build_const_int32(gallivm, variant->lanes - 1),
+                              "");
+   num_vectors = LLVMBuildUDiv(builder, num_vectors, lanes, "num_vectors");
+
+   hdls = lp_build_array_alloca(gallivm, hdl_type,
+                                lp_build_const_int32(gallivm,
+                                   DIV_ROUND_UP(LP_MAX_CS_THREADS,
+                                                variant->lanes)),
+                                "coro_hdls");
+   pending_ptr = lp_build_alloca(gallivm, int1_type, "pending");
+
+   /* Start the coroutines, each runs up to its first barrier */
+   lp_build_loop_begin(&loop, gallivm, LLVMConstInt(int32_type, 0, 0));
+   {
+      args[10] = LLVMBuildMul(builder, loop.counter, lanes, "");
+      hdl = LLVMBuildCall(builder, coro, args, num_args, "");
+      hdl_ptr = LLVMBuildGEP(builder, hdls, &loop.counter, 1, "");
+      LLVMBuildStore(builder, hdl, hdl_ptr);
+   }
+   lp_build_loop_end_cond(&loop, num_vectors, NULL, LLVMIntUGE);
+
+   /* Take them through the barriers, until they have all finished */
+   resume_block = lp_build_insert_new_block(gallivm, "resume_all");
+   LLVMBuildBr(builder, resume_block);
+   LLVMPositionBuilderAtEnd(builder, resume_block);
+   LLVMBuildStore(builder, LLVMConstInt(int1_type, 0, 0), pending_ptr);
+
+   lp_build_loop_begin(&loop, gallivm, LLVMConstInt(int32_type, 0, 0));
+   {
+      hdl_ptr = LLVMBuildGEP(builder, hdls, &loop.counter, 1, "");
+      hdl = LLVMBuildLoad(builder, hdl_ptr, "");
+      not_done = LLVMBuildNot(builder, lp_build_coro_done(gallivm, hdl), "");
+      lp_build_if(&ifthen, gallivm, not_done);
+      {
+         lp_build_coro_resume(gallivm, hdl);
+         LLVMBuildStore(builder, LLVMConstInt(int1_type, 1, 0), pending_ptr);
+      }
+      lp_build_endif(&ifthen);
+   }
+   lp_build_loop_end_cond(&loop, num_vectors, NULL, LLVMIntUGE);
+
+   done_block = lp_build_insert_new_block(gallivm, "resume_done");
+   LLVMBuildCondBr(builder, LLVMBuildLoad(builder, pending_ptr, ""),
+                   resume_block, done_block);
+   LLVMPositionBuilderAtEnd(builder, done_block);
+
+   /* Free the coroutine frames */
+   lp_build_loop_begin(&loop, gallivm, LLVMConstInt(int32_type, 0, 0));
+   {
+      hdl_ptr = LLVMBuildGEP(builder, hdls, &loop.counter, 1, "");
+      lp_build_coro_destroy(gallivm, LLVMBuildLoad(builder, hdl_ptr, ""));
+   }
+   lp_build_loop_end_cond(&loop, num_vectors, NULL, LLVMIntUGE);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, function);
+}
+#endif /* LP_HAVE_COMPUTE */
+
+
+/**
+ * Generate the compute shader function.
+ *
+ * Each call runs variant->lanes invocations of a workgroup, starting at
+ * the linear invocation index invocation_base. Lanes past the end of the
+ * workgroup are masked off.
+ *
+ * Shaders with barriers are generated as a coroutine which does that,
+ * with a function to run the whole workgroup around it.
+ */
+static void
+generate_compute(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   const struct lp_compute_shader_variant_key *key = &variant->key;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(lc);
+   LLVMTypeRef arg_types[12];
+   LLVMTypeRef func_type;
+   LLVMValueRef function, body;
+   LLVMValueRef context_ptr, thread_data_ptr;
+   LLVMValueRef invocation_base;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMValueRef lane_index[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef index, size_x, size_y, total, tmp, valid;
+   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_build_context uint_bld;
+   struct lp_build_mask_context mask;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_build_image_soa *image;
+   struct lp_cs_iface cs_iface;
+   struct lp_type cs_type;
+   boolean use_coro = LP_HAVE_COMPUTE && shader->uses_barrier;
+   unsigned i;
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;      /* floating point values */
+   cs_type.sign = TRUE;          /* values are signed */
+   cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
+   cs_type.width = 32;           /* 32-bit float */
+   cs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+
+   variant->lanes = cs_type.length;
+
+   /*
+    * Generate the function prototype. Any change here must be reflected in
+    * lp_jit.h's lp_jit_cs_func function pointer type, and vice-versa.
+    */
+   arg_types[0] = variant->jit_cs_context_ptr_type;       /* context */
+   arg_types[1] = int32_type;                             /* block_x */
+   arg_types[2] = int32_type;                             /* block_y */
+   arg_types[3] = int32_type;                             /* block_z */
+   arg_types[4] = int32_type;                             /* grid_x */
+   arg_types[5] = int32_type;                             /* grid_y */
+   arg_types[6] = int32_type;                             /* grid_z */
+   arg_types[7] = int32_type;                             /* block_size_x */
+   arg_types[8] = int32_type;                             /* block_size_y */
+   arg_types[9] = int32_type;                             /* block_size_z */
+   arg_types[10] = int32_type;                            /* invocation_base */
+   arg_types[11] = variant->jit_cs_thread_data_ptr_type;  /* per thread data */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(lc),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   function = LLVMAddFunction(gallivm->module, "cs_variant", func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+
+   variant->function = function;
+
+   /* The coroutine takes the same arguments, and returns its handle */
+   if (use_coro) {
+      func_type = LLVMFunctionType(LLVMPointerType(LLVMInt8TypeInContext(lc), 0),
+                                   arg_types, ARRAY_SIZE(arg_types), 0);
+      body = LLVMAddFunction(gallivm->module, "cs_co", func_type);
+      LLVMSetFunctionCallConv(body, LLVMCCallConv);
+   }
+   else {
+      body = function;
+   }
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(body, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   context_ptr = LLVMGetParam(body, 0);
+   memset(&system_values, 0, sizeof system_values);
+   for (i = 0; i < 3; i++) {
+      system_values.block_id[i] = LLVMGetParam(body, 1 + i);
+      system_values.grid_size[i] = LLVMGetParam(body, 4 + i);
+      system_values.block_size[i] = LLVMGetParam(body, 7 + i);
+   }
+   invocation_base = LLVMGetParam(body, 10);
+   thread_data_ptr = LLVMGetParam(body, 11);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(invocation_base, "invocation_base");
+   lp_build_name(thread_data_ptr, "thread_data");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(lc, body, "entry");
+   builder = gallivm->builder;
+   assert(builder);
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   memset(&cs_iface, 0, sizeof cs_iface);
+#if LP_HAVE_COMPUTE
+   if (use_coro) {
+      lp_build_coro_begin(gallivm, &cs_iface.coro_info);
+      cs_iface.base.emit_barrier = cs_emit_barrier;
+   }
+#endif
+
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(cs_type));
+
+   /* linear invocation index of each lane, and the thread id it maps to */
+   for (i = 0; i < cs_type.length; i++)
+      lane_index[i] = lp_build_const_int32(gallivm, i);
+   index = lp_build_broadcast_scalar(&uint_bld, invocation_base);
+   index = lp_build_add(&uint_bld, index,
+                        LLVMConstVector(lane_index, cs_type.length));
+
+   size_x = lp_build_broadcast_scalar(&uint_bld, system_values.block_size[0]);
+   size_y = lp_build_broadcast_scalar(&uint_bld, system_values.block_size[1]);
+   system_values.thread_id[0] = LLVMBuildURem(builder, index, size_x, "");
+   tmp = LLVMBuildUDiv(builder, index, size_x, "");
+   system_values.thread_id[1] = LLVMBuildURem(builder, tmp, size_y, "");
+   system_values.thread_id[2] = LLVMBuildUDiv(builder, tmp, size_y, "");
+
+   total = LLVMBuildMul(builder, system_values.block_size[0],
+                        system_values.block_size[1], "");
+   total = LLVMBuildMul(builder, total, system_values.block_size[2], "");
+   valid = lp_build_cmp(&uint_bld, PIPE_FUNC_LESS, index,
+                        lp_build_broadcast_scalar(&uint_bld, total));
+
+   consts_ptr = lp_jit_cs_context_constants(gallivm, context_ptr);
+   num_consts_ptr = lp_jit_cs_context_num_constants(gallivm, context_ptr);
+
+   /* code generators for the textures and images */
+   sampler = lp_llvm_cs_sampler_soa_create(key->state);
+   image = lp_llvm_image_soa_create(key->image_state);
+
+   cs_iface.base.ssbo_ptr = lp_jit_cs_context_ssbos(gallivm, context_ptr);
+   cs_iface.base.ssbo_sizes_ptr = lp_jit_cs_context_num_ssbos(gallivm, context_ptr);
+   cs_iface.base.shared_ptr = lp_jit_cs_thread_data_shared(gallivm, thread_data_ptr);
+   cs_iface.base.shared_size = lp_jit_cs_context_shared_size(gallivm, context_ptr);
+   cs_iface.base.image = image;
+
+   memset(outputs, 0, sizeof outputs);
+
+   lp_build_mask_begin(&mask, gallivm, cs_type, valid);
+
+   if (shader->nir)
+      lp_build_nir_soa(gallivm, shader->nir, cs_type, &mask,
+                       consts_ptr, num_consts_ptr, &system_values,
+                       NULL, outputs, context_ptr, thread_data_ptr,
+                       sampler, &shader->info, NULL, &cs_iface.base);
+   else
+      lp_build_tgsi_soa(gallivm, shader->tokens, cs_type, &mask,
+                        consts_ptr, num_consts_ptr, &system_values,
+                        NULL, outputs, context_ptr, thread_data_ptr,
+                        sampler, &shader->info, NULL, &cs_iface.base, NULL);
+
+   lp_build_mask_end(&mask);
+
+   sampler->destroy(sampler);
+   image->destroy(image);
+
+#if LP_HAVE_COMPUTE
+   if (use_coro) {
+      lp_build_coro_suspend_switch(gallivm, &cs_iface.coro_info, NULL, TRUE);
+
+      gallivm_verify_function(gallivm, body);
+
+      generate_compute_sched(variant, function, body, ARRAY_SIZE(arg_types));
+      return;
+   }
+#endif
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static struct lp_compute_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 const struct lp_compute_shader_variant_key *key)
+{
+   struct lp_compute_shader_variant *variant;
+   char module_name[64];
+
+   variant = CALLOC_STRUCT(lp_compute_shader_variant);
+   if (!variant)
+      return NULL;
+
+   variant->key = *key;
+
+   util_snprintf(module_name, sizeof(module_name), "cs%u_variant%u",
+                 shader->no, shader->num_variants);
+
+   variant->gallivm = gallivm_create(module_name, lp->context, NULL);
+   if (!variant->gallivm) {
+      FREE(variant);
+      return NULL;
+   }
+
+   lp_jit_init_cs_types(variant);
+
+   generate_compute(lp, shader, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_function = (lp_jit_cs_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   gallivm_free_ir(variant->gallivm);
+
+   return variant;
+}
+
+
+static void
+destroy_variant(struct lp_compute_shader_variant *variant)
+{
+   gallivm_destroy(variant->gallivm);
+   FREE(variant);
+}
+
+
+/**
+ * Derive the variant key from the bound samplers, views and images.
+ */
+static void
+make_variant_key(struct llvmpipe_context *lp,
+                 const struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant_key *key)
+{
+   const struct tgsi_shader_info *info = &shader->info;
+   unsigned i;
+
+   memset(key, 0, sizeof *key);
+
+   key->nr_samplers = info->file_max[TGSI_FILE_SAMPLER] + 1;
+
+   for (i = 0; i < key->nr_samplers; ++i) {
+      if (info->file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+         lp_sampler_static_sampler_state(&key->state[i].sampler_state,
+                                         lp->samplers[PIPE_SHADER_COMPUTE][i]);
+      }
+   }
+
+   /* see make_variant_key() in lp_state_fs.c */
+   if (info->file_max[TGSI_FILE_SAMPLER_VIEW] != -1) {
+      key->nr_sampler_views = info->file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (info->file_mask[TGSI_FILE_SAMPLER_VIEW] & (1u << (i & 31))) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+   else {
+      key->nr_sampler_views = key->nr_samplers;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (info->file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+
+   key->nr_images = info->file_max[TGSI_FILE_IMAGE] + 1;
+   for (i = 0; i < key->nr_images; ++i) {
+      if (info->file_mask[TGSI_FILE_IMAGE] & (1 << i)) {
+         lp_sampler_static_texture_state_image(&key->image_state[i],
+                                               &lp->images[i]);
+      }
+   }
+}
+
+
+/**
+ * Find or compile the shader's variant for the current state.
+ */
+static struct lp_compute_shader_variant *
+get_variant(struct llvmpipe_context *lp, struct lp_compute_shader *shader)
+{
+   struct lp_compute_shader_variant_key key;
+   struct lp_compute_shader_variant *variant, **prev;
+
+   make_variant_key(lp, shader, &key);
+
+   for (prev = &shader->variants; *prev; prev = &(*prev)->next) {
+      variant = *prev;
+      if (memcmp(&variant->key, &key, sizeof key) == 0) {
+         /* move it to the front */
+         *prev = variant->next;
+         variant->next = shader->variants;
+         shader->variants = variant;
+         return variant;
+      }
+   }
+
+   /* grids are run synchronously, nothing can still be using the oldest */
+   if (shader->num_variants >= LP_MAX_CS_VARIANTS) {
+      for (prev = &shader->variants; (*prev)->next; prev = &(*prev)->next)
+         ;
+      destroy_variant(*prev);
+      *prev = NULL;
+      shader->num_variants--;
+   }
+
+   variant = generate_variant(lp, shader, &key);
+   if (!variant)
+      return NULL;
+
+   variant->next = shader->variants;
+   shader->variants = variant;
+   shader->num_variants++;
+
+   return variant;
+}
+
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct lp_compute_shader *shader;
+
+   assert(templ->ir_type == PIPE_SHADER_IR_TGSI ||
+          templ->ir_type == PIPE_SHADER_IR_NIR);
+
+   shader = CALLOC_STRUCT(lp_compute_shader);
+   if (!shader) {
+      if (templ->ir_type == PIPE_SHADER_IR_NIR)
+         ralloc_free((void *) templ->prog);
+      return NULL;
+   }
+
+   shader->no = cs_no++;
+   if (templ->ir_type == PIPE_SHADER_IR_NIR) {
+      /* the NIR shader is ours now */
+      shader->nir = (struct nir_shader *) templ->prog;
+      lp_build_nir_prepare(shader->nir);
+      nir_tgsi_scan_shader(shader->nir, &shader->info, false);
+   }
+   else {
+      shader->tokens = tgsi_dup_tokens(templ->prog);
+      if (!shader->tokens) {
+         FREE(shader);
+         return NULL;
+      }
+
+      tgsi_scan_shader(shader->tokens, &shader->info);
+   }
+   shader->req_local_mem = templ->req_local_mem;
+   shader->uses_barrier = shader->info.opcode_count[TGSI_OPCODE_BARRIER] > 0;
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader #%u %p:\n",
+                   shader->no, (void *) shader);
+      if (shader->nir)
+         nir_print_shader(shader->nir, stderr);
+      else
+         tgsi_dump(shader->tokens, 0);
+   }
+
+   /* Variants depend on the bound textures and images, and are compiled
+    * at launch.
+    */
+   return shader;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *) cs;
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct lp_compute_shader *shader = (struct lp_compute_shader *) cs;
+   struct lp_compute_shader_variant *variant, *next;
+
+   /* grids are run synchronously, nothing can still be using them */
+   for (variant = shader->variants; variant; variant = next) {
+      next = variant->next;
+      destroy_variant(variant);
+   }
+   ralloc_free(shader->nir);
+   FREE((void *) shader->tokens);
+   FREE(shader);
+}
+
+
+static void
+llvmpipe_set_shader_buffers(struct pipe_context *pipe,
+                            enum pipe_shader_type shader,
+                            unsigned start_slot, unsigned count,
+                            const struct pipe_shader_buffer *buffers)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   /* only fragment and compute shaders have shader buffers */
+   if (shader != PIPE_SHADER_FRAGMENT && shader != PIPE_SHADER_COMPUTE)
+      return;
+
+   assert(start_slot + count <= LP_MAX_TGSI_SHADER_BUFFERS);
+
+   for (i = 0; i < count; i++) {
+      struct pipe_shader_buffer *dst = &llvmpipe->ssbos[shader][start_slot + i];
+
+      if (buffers && buffers[i].buffer) {
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      }
+      else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+
+   if (shader == PIPE_SHADER_FRAGMENT)
+      llvmpipe->dirty |= LP_NEW_FS_SSBOS;
+}
+
+
+static void
+llvmpipe_set_shader_images(struct pipe_context *pipe,
+                           enum pipe_shader_type shader,
+                           unsigned start_slot, unsigned count,
+                           const struct pipe_image_view *images)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   /* only compute shaders have images */
+   if (shader != PIPE_SHADER_COMPUTE)
+      return;
+
+   assert(start_slot + count <= LP_MAX_TGSI_SHADER_IMAGES);
+
+   for (i = 0; i < count; i++) {
+      struct pipe_image_view *dst = &llvmpipe->images[start_slot + i];
+
+      if (images && images[i].resource)
+         util_copy_image_view(dst, &images[i]);
+      else
+         util_copy_image_view(dst, NULL);
+   }
+}
+
+
+static void
+fill_grid_size(struct pipe_context *pipe,
+               const struct pipe_grid_info *info,
+               uint32_t grid_size[3])
+{
+   struct pipe_transfer *transfer;
+   uint32_t *params;
+
+   if (!info->indirect) {
+      grid_size[0] = info->grid[0];
+      grid_size[1] = info->grid[1];
+      grid_size[2] = info->grid[2];
+      return;
+   }
+
+   params = pipe_buffer_map_range(pipe, info->indirect,
+                                  info->indirect_offset,
+                                  3 * sizeof(uint32_t),
+                                  PIPE_TRANSFER_READ,
+                                  &transfer);
+   if (!transfer) {
+      grid_size[0] = grid_size[1] = grid_size[2] = 0;
+      return;
+   }
+
+   grid_size[0] = params[0];
+   grid_size[1] = params[1];
+   grid_size[2] = params[2];
+   pipe_buffer_unmap(pipe, transfer);
+}
+
+
+/**
+ * Fill in the jit image for an image view, mapping the resource.
+ * Unbound images get a zero size, so all accesses are out of bounds.
+ */
+static void
+fill_jit_image(struct lp_jit_image *jit_image,
+               const struct pipe_image_view *view)
+{
+   static uint32_t fake_image_buf[4];
+   struct pipe_resource *res = view->resource;
+   struct llvmpipe_resource *lpr;
+
+   memset(jit_image, 0, sizeof *jit_image);
+   jit_image->base = fake_image_buf;
+
+   if (!res)
+      return;
+
+   lpr = llvmpipe_resource(res);
+
+   if (llvmpipe_resource_is_texture(res)) {
+      unsigned level = view->u.tex.level;
+
+      jit_image->width = u_minify(res->width0, level);
+      jit_image->height = u_minify(res->height0, level);
+      jit_image->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+      jit_image->row_stride = lpr->row_stride[level];
+      jit_image->img_stride = lpr->img_stride[level];
+      jit_image->base = llvmpipe_resource_map(res, level,
+                                              view->u.tex.first_layer,
+                                              LP_TEX_USAGE_READ_WRITE);
+   }
+   else {
+      unsigned blocksize = util_format_get_blocksize(view->format);
+
+      jit_image->width = view->u.buf.size / blocksize;
+      jit_image->height = 1;
+      jit_image->depth = 1;
+      jit_image->base = (uint8_t *) llvmpipe_resource_data(res) +
+                        view->u.buf.offset;
+   }
+}
+
+
+/**
+ * Point the JIT context at the bound constant and shader buffers, textures
+ * and images, waiting for any rendering which may still write (or for
+ * images and shader buffers, read) them.
+ */
+static void
+update_cs_jit_context(struct llvmpipe_context *llvmpipe,
+                      const struct lp_compute_shader_variant *variant,
+                      struct lp_jit_cs_context *jit_context)
+{
+   static const float fake_const_buf[4];
+   static uint32_t fake_ssbo_buf;
+   const struct lp_compute_shader_variant_key *key = &variant->key;
+   unsigned i;
+
+   for (i = 0; i < LP_MAX_TGSI_CONST_BUFFERS; ++i) {
+      const struct pipe_constant_buffer *cb =
+         &llvmpipe->constants[PIPE_SHADER_COMPUTE][i];
+      const ubyte *data = NULL;
+
+      if (cb->buffer) {
+         llvmpipe_flush_resource(&llvmpipe->pipe, cb->buffer, 0,
+                                 TRUE, TRUE, FALSE, "compute constants");
+         data = (const ubyte *) llvmpipe_resource_data(cb->buffer);
+      }
+      else if (cb->user_buffer) {
+         data = (const ubyte *) cb->user_buffer;
+      }
+
+      if (data) {
+         unsigned size = MIN2(cb->buffer_size, LP_MAX_TGSI_CONST_BUFFER_SIZE);
+
+         jit_context->constants[i] = (const float *) (data + cb->buffer_offset);
+         jit_context->num_constants[i] = size / (sizeof(float) * 4);
+      }
+      else {
+         jit_context->constants[i] = fake_const_buf;
+         jit_context->num_constants[i] = 0;
+      }
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_SHADER_BUFFERS; ++i) {
+      const struct pipe_shader_buffer *sb =
+         &llvmpipe->ssbos[PIPE_SHADER_COMPUTE][i];
+
+      if (sb->buffer) {
+         llvmpipe_flush_resource(&llvmpipe->pipe, sb->buffer, 0,
+                                 FALSE, TRUE, FALSE, "compute buffers");
+         jit_context->ssbos[i] =
+            (uint8_t *) llvmpipe_resource_data(sb->buffer) + sb->buffer_offset;
+         jit_context->num_ssbos[i] = sb->buffer_size;
+      }
+      else {
+         jit_context->ssbos[i] = (uint8_t *) &fake_ssbo_buf;
+         jit_context->num_ssbos[i] = 0;
+      }
+   }
+
+   for (i = 0; i < key->nr_sampler_views; ++i) {
+      const struct pipe_sampler_view *view =
+         llvmpipe->sampler_views[PIPE_SHADER_COMPUTE][i];
+
+      /* the context holds the resource reference until the grid is done */
+      if (view && view->texture) {
+         llvmpipe_flush_resource(&llvmpipe->pipe, view->texture, 0,
+                                 TRUE, TRUE, FALSE, "compute textures");
+         lp_setup_fill_jit_texture(&jit_context->textures[i], view);
+      }
+   }
+
+   for (i = 0; i < key->nr_samplers; ++i) {
+      const struct pipe_sampler_state *sampler =
+         llvmpipe->samplers[PIPE_SHADER_COMPUTE][i];
+
+      if (sampler) {
+         struct lp_jit_sampler *jit_sam = &jit_context->samplers[i];
+
+         jit_sam->min_lod = sampler->min_lod;
+         jit_sam->max_lod = sampler->max_lod;
+         jit_sam->lod_bias = sampler->lod_bias;
+         COPY_4V(jit_sam->border_color, sampler->border_color.f);
+      }
+   }
+
+   for (i = 0; i < key->nr_images; ++i) {
+      const struct pipe_image_view *view = &llvmpipe->images[i];
+
+      if (view->resource) {
+         llvmpipe_flush_resource(&llvmpipe->pipe, view->resource, 0,
+                                 FALSE, TRUE, FALSE, "compute images");
+      }
+      fill_jit_image(&jit_context->images[i], view);
+   }
+}
+
+
+/**
+ * Unmap the display target images fill_jit_image mapped.
+ */
+static void
+unmap_cs_images(struct llvmpipe_context *llvmpipe,
+                const struct lp_compute_shader_variant *variant)
+{
+   unsigned i;
+
+   for (i = 0; i < variant->key.nr_images; ++i) {
+      const struct pipe_image_view *view = &llvmpipe->images[i];
+
+      if (view->resource && llvmpipe_resource_is_texture(view->resource)) {
+         llvmpipe_resource_unmap(view->resource, view->u.tex.level,
+                                 view->u.tex.first_layer);
+      }
+   }
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const struct pipe_grid_info *info)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_compute_shader *shader = llvmpipe->cs;
+   struct lp_compute_shader_variant *variant;
+   struct lp_cs_pool *pool = NULL;
+   struct lp_cs_task *tasks = NULL;
+   struct lp_cs_job job;
+   unsigned num_tasks = 0;
+   unsigned i;
+
+   if (!shader)
+      return;
+
+   if (!llvmpipe_check_render_cond(llvmpipe))
+      return;
+
+   memset(&job, 0, sizeof job);
+   fill_grid_size(pipe, info, job.grid);
+   job.block[0] = info->block[0];
+   job.block[1] = info->block[1];
+   job.block[2] = info->block[2];
+   job.block_threads = job.block[0] * job.block[1] * job.block[2];
+   job.num_groups = (uint64_t) job.grid[0] * job.grid[1] * job.grid[2];
+   if (!job.num_groups || !job.block_threads)
+      return;
+
+   assert(job.block_threads <= LP_MAX_CS_THREADS);
+
+   variant = get_variant(llvmpipe, shader);
+   if (!variant)
+      return;
+
+   job.func = variant->jit_function;
+   job.lanes = variant->lanes;
+   job.uses_barrier = shader->uses_barrier;
+   job.shared_size = shader->req_local_mem;
+   job.jit_context.shared_size = shader->req_local_mem;
+   update_cs_jit_context(llvmpipe, variant, &job.jit_context);
+
+   if (!llvmpipe->cs_worker)
+      llvmpipe->cs_worker = cs_worker_create();
+
+   if (job.num_groups > 1)
+      pool = cs_get_pool(screen);
+
+   if (pool) {
+      num_tasks = MIN2(pool->num_threads, job.num_groups - 1);
+      tasks = CALLOC(num_tasks, sizeof *tasks);
+      if (!tasks)
+         num_tasks = 0;
+   }
+
+   for (i = 0; i < num_tasks; i++) {
+      util_queue_fence_init(&tasks[i].fence);
+      tasks[i].job = &job;
+      tasks[i].pool = pool;
+      util_queue_add_job(&pool->queue, &tasks[i], &tasks[i].fence,
+                         cs_task_execute, NULL);
+   }
+
+   /* The calling thread takes its share of workgroups too */
+   cs_job_run(&job, llvmpipe->cs_worker);
+
+   for (i = 0; i < num_tasks; i++) {
+      util_queue_fence_wait(&tasks[i].fence);
+      util_queue_fence_destroy(&tasks[i].fence);
+   }
+   FREE(tasks);
+
+   unmap_cs_images(llvmpipe, variant);
+}
+
+
+void
+llvmpipe_cleanup_compute(struct llvmpipe_context *llvmpipe)
+{
+   unsigned i, j;
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->ssbos); i++) {
+      for (j = 0; j < ARRAY_SIZE(llvmpipe->ssbos[i]); j++)
+         pipe_resource_reference(&llvmpipe->ssbos[i][j].buffer, NULL);
+   }
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->images); i++)
+      pipe_resource_reference(&llvmpipe->images[i].resource, NULL);
+
+   cs_worker_destroy(llvmpipe->cs_worker);
+   llvmpipe->cs_worker = NULL;
+}
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
+   llvmpipe->pipe.set_shader_images = llvmpipe_set_shader_images;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+}
@@ -0,0 +1,120 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+
+#ifndef LP_STATE_CS_H_
+#define LP_STATE_CS_H_
+
+
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
+#include "lp_jit.h"
+
+
+/*
+ * The invocations of a workgroup which contains a barrier are run as
+ * coroutines (one per SIMD vector), which suspend at each barrier.
+ */
+#define LP_HAVE_COMPUTE GALLIVM_HAVE_CORO
+
+/** Max invocations in a workgroup */
+#define LP_MAX_CS_THREADS 1024
+
+/** Max variants kept per compute shader */
+#define LP_MAX_CS_VARIANTS 16
+
+
+struct llvmpipe_context;
+struct llvmpipe_screen;
+struct lp_cs_worker;
+
+
+/**
+ * The state a compute shader variant is compiled for.
+ */
+struct lp_compute_shader_variant_key
+{
+   unsigned nr_samplers:8;
+   unsigned nr_sampler_views:8;
+   unsigned nr_images:8;
+
+   struct lp_sampler_static_state state[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct lp_static_texture_state image_state[LP_MAX_TGSI_SHADER_IMAGES];
+};
+
+
+struct lp_compute_shader_variant
+{
+   struct lp_compute_shader_variant_key key;
+
+   struct gallivm_state *gallivm;
+
+   LLVMTypeRef jit_cs_context_ptr_type;
+   LLVMTypeRef jit_cs_thread_data_ptr_type;
+
+   LLVMValueRef function;
+   lp_jit_cs_func jit_function;
+
+   /** number of invocations run by one call of jit_function */
+   unsigned lanes;
+
+   /** next in the shader's list, most recently used first */
+   struct lp_compute_shader_variant *next;
+};
+
+
+struct lp_compute_shader
+{
+   /** Either of these is set, depending on the IR the shader was given in */
+   const struct tgsi_token *tokens;
+   struct nir_shader *nir;
+   struct tgsi_shader_info info;
+
+   unsigned req_local_mem;
+   boolean uses_barrier;
+
+   unsigned no;
+
+   struct lp_compute_shader_variant *variants;
+   unsigned num_variants;
+};
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe);
+
+void
+llvmpipe_cleanup_compute(struct llvmpipe_context *llvmpipe);
+
+void
+lp_cs_pool_destroy(struct llvmpipe_screen *screen);
+
+
+#endif /* LP_STATE_CS_H_ */
@@ -183,6 +183,7 @@ compute_vertex_info(struct llvmpipe_context *llvmpipe)
 void llvmpipe_update_derived( struct llvmpipe_context *llvmpipe )
 {
    struct llvmpipe_screen *lp_screen = llvmpipe_screen(llvmpipe->pipe.screen);
+   unsigned layout_timestamp;
 
    /* Check for updated textures.
     */
@@ -191,10 +192,30 @@ void llvmpipe_update_derived( struct llvmpipe_context *llvmpipe )
       llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
    }
 
+   /* Check for textures changing layout.  The draw module only looks at
+    * the sampler views when they're set, so set them again.
+    */
+   layout_timestamp = p_atomic_read(&lp_screen->layout_timestamp);
+   if (llvmpipe->tex_layout_timestamp != layout_timestamp) {
+      enum pipe_shader_type shader;
+
+      llvmpipe->tex_layout_timestamp = layout_timestamp;
+      llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
+
+      for (shader = PIPE_SHADER_VERTEX; shader < PIPE_SHADER_TYPES; shader++) {
+         if (shader == PIPE_SHADER_FRAGMENT || shader == PIPE_SHADER_COMPUTE)
+            continue;
+         draw_set_sampler_views(llvmpipe->draw, shader,
+                                llvmpipe->sampler_views[shader],
+                                llvmpipe->num_sampler_views[shader]);
+      }
+   }
+
    /* This needs LP_NEW_RASTERIZER because of draw_prepare_shader_outputs(). */
    if (llvmpipe->dirty & (LP_NEW_RASTERIZER |
                           LP_NEW_FS |
                           LP_NEW_GS |
+                          LP_NEW_TES |
                           LP_NEW_VS))
       compute_vertex_info(llvmpipe);
 
@@ -255,6 +276,11 @@ void llvmpipe_update_derived( struct llvmpipe_context *llvmpipe )
                                 ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_FRAGMENT]),
                                 llvmpipe->constants[PIPE_SHADER_FRAGMENT]);
 
+   if (llvmpipe->dirty & LP_NEW_FS_SSBOS)
+      lp_setup_set_fs_ssbos(llvmpipe->setup,
+                            ARRAY_SIZE(llvmpipe->ssbos[PIPE_SHADER_FRAGMENT]),
+                            llvmpipe->ssbos[PIPE_SHADER_FRAGMENT]);
+
    if (llvmpipe->dirty & (LP_NEW_SAMPLER_VIEW))
       lp_setup_set_fragment_sampler_views(llvmpipe->setup,
                                           llvmpipe->num_sampler_views[PIPE_SHADER_FRAGMENT],
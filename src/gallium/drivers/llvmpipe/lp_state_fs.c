@@ -68,10 +68,16 @@
 #include "util/simple_list.h"
 #include "util/u_dual_blend.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
+#include "util/hash_table.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_scan.h"
+#include "compiler/blob.h"
+#include "compiler/nir/nir.h"
+#include "compiler/nir/nir_serialize.h"
+#include "nir/nir_to_tgsi_info.h"
 #include "tgsi/tgsi_parse.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_const.h"
@@ -80,6 +86,7 @@
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_logic.h"
 #include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_nir.h"
 #include "gallivm/lp_bld_swizzle.h"
 #include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_debug.h"
@@ -96,6 +103,7 @@
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
+#include "lp_screen.h"
 #include "lp_setup.h"
 #include "lp_state.h"
 #include "lp_tex_sample.h"
@@ -308,7 +316,6 @@ generate_fs_loop(struct gallivm_state *gallivm,
                  LLVMValueRef thread_data_ptr)
 {
    const struct util_format_description *zs_format_desc = NULL;
-   const struct tgsi_token *tokens = shader->base.tokens;
    struct lp_type int_type = lp_int_type(type);
    LLVMTypeRef vec_type, int_vec_type;
    LLVMValueRef mask_ptr, mask_val;
@@ -336,9 +343,15 @@ generate_fs_loop(struct gallivm_state *gallivm,
    unsigned depth_mode;
 
    struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_tgsi_cs_iface buf_iface;
 
    memset(&system_values, 0, sizeof(system_values));
 
+   /* shader buffers, and the atomic counters lowered to them */
+   memset(&buf_iface, 0, sizeof buf_iface);
+   buf_iface.ssbo_ptr = lp_jit_context_ssbos(gallivm, context_ptr);
+   buf_iface.ssbo_sizes_ptr = lp_jit_context_num_ssbos(gallivm, context_ptr);
+
    if (key->depth.enabled ||
        key->stencil[0].enabled) {
 
@@ -475,11 +488,18 @@ generate_fs_loop(struct gallivm_state *gallivm,
    lp_build_interp_soa_update_inputs_dyn(interp, gallivm, loop_state.counter);
 
    /* Build the actual shader */
-   lp_build_tgsi_soa(gallivm, tokens, type, &mask,
-                     consts_ptr, num_consts_ptr, &system_values,
-                     interp->inputs,
-                     outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      lp_build_nir_soa(gallivm, shader->base.ir.nir, type, &mask,
+                       consts_ptr, num_consts_ptr, &system_values,
+                       interp->inputs,
+                       outputs, context_ptr, thread_data_ptr,
+                       sampler, &shader->info.base, NULL, &buf_iface);
+   else
+      lp_build_tgsi_soa(gallivm, shader->base.tokens, type, &mask,
+                        consts_ptr, num_consts_ptr, &system_values,
+                        interp->inputs,
+                        outputs, context_ptr, thread_data_ptr,
+                        sampler, &shader->info.base, NULL, &buf_iface, NULL);
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -2397,8 +2417,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -2486,8 +2505,9 @@ generate_fragment(struct llvmpipe_context *lp,
 
    blend_vec_type = lp_build_vec_type(gallivm, blend_type);
 
-   util_snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s",
-                 shader->no, variant->no, partial_mask ? "partial" : "whole");
+   /* Not made unique, as cached object code is looked up by function name */
+   util_snprintf(func_name, sizeof(func_name), "fs_variant_%s",
+                 partial_mask ? "partial" : "whole");
 
    arg_types[0] = variant->jit_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* x */
@@ -2800,7 +2820,10 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 {
    debug_printf("llvmpipe: Fragment shader #%u variant #%u:\n", 
                 variant->shader->no, variant->no);
-   tgsi_dump(variant->shader->base.tokens, 0);
+   if (variant->shader->base.type == PIPE_SHADER_IR_NIR)
+      nir_print_shader(variant->shader->base.ir.nir, stderr);
+   else
+      tgsi_dump(variant->shader->base.tokens, 0);
    dump_fs_variant_key(&variant->key);
    debug_printf("variant->opaque = %u\n", variant->opaque);
    debug_printf("\n");
@@ -2808,38 +2831,44 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 
 
 /**
- * Generate a new fragment shader variant from the shader code and
- * other state indicated by the key.
+ * Compute the key identifying the generated code of a variant: the shader
+ * tokens (or NIR) and the variant key determine the generated code entirely.
  */
-static struct lp_fragment_shader_variant *
-generate_variant(struct llvmpipe_context *lp,
-                 struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+static void
+lp_fs_get_ir_cache_key(const struct lp_fragment_shader *shader,
+                       const struct lp_fragment_shader_variant_key *key,
+                       unsigned char ir_sha1_cache_key[20])
 {
-   struct lp_fragment_shader_variant *variant;
-   const struct util_format_description *cbuf0_format_desc = NULL;
-   boolean fullcolormask;
-   char module_name[64];
-
-   variant = CALLOC_STRUCT(lp_fragment_shader_variant);
-   if (!variant)
-      return NULL;
-
-   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-                 shader->no, shader->variants_created);
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      _mesa_sha1_update(&ctx, shader->nir_sha1, sizeof(shader->nir_sha1));
+   else
+      _mesa_sha1_update(&ctx, shader->base.tokens,
+                        tgsi_num_tokens(shader->base.tokens) *
+                        sizeof(struct tgsi_token));
+   _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
 
-   variant->gallivm = gallivm_create(module_name, lp->context);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
 
-   variant->shader = shader;
-   variant->list_item_global.base = variant;
-   variant->list_item_local.base = variant;
-   variant->no = shader->variants_created++;
-
-   memcpy(&variant->key, key, shader->variant_key_size);
+/**
+ * Build and compile the code of a variant whose key, shader and gallivm
+ * have been set up already.
+ *
+ * A quick variant only gets the generic partial tile function (no opaque
+ * specialization) and its gallivm is expected to skip optimizations; that
+ * code is used as a stand-in while the real one compiles in the background.
+ */
+static void
+compile_variant(struct lp_fragment_shader *shader,
+                struct lp_fragment_shader_variant *variant,
+                boolean quick)
+{
+   const struct lp_fragment_shader_variant_key *key = &variant->key;
+   const struct util_format_description *cbuf0_format_desc = NULL;
+   boolean fullcolormask;
 
    /*
     * Determine whether we are touching all channels in the color buffer.
@@ -2851,6 +2880,7 @@ generate_variant(struct llvmpipe_context *lp,
    }
 
    variant->opaque =
+         !quick &&
          !key->blend.logicop_enable &&
          !key->blend.rt[0].blend_enable &&
          fullcolormask &&
@@ -2869,12 +2899,12 @@ generate_variant(struct llvmpipe_context *lp,
    lp_jit_init_types(variant);
    
    if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+      generate_fragment(shader, variant, RAST_EDGE_TEST);
 
    if (variant->jit_function[RAST_WHOLE] == NULL) {
       if (variant->opaque) {
          /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
+         generate_fragment(shader, variant, RAST_WHOLE);
       }
    }
 
@@ -2899,9 +2929,472 @@ generate_variant(struct llvmpipe_context *lp,
    } else if (!variant->jit_function[RAST_WHOLE]) {
       variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
    }
+}
+
+
+/**
+ * JIT compiled code of a fragment shader variant.
+ *
+ * The code only depends on the shader and the variant key, so contexts
+ * drawing with the same shader share it rather than each compiling their
+ * own copy.  It lives in its own LLVM context, so that it can outlive the
+ * llvmpipe context which compiled it, and is reference counted by the
+ * variants using it.  The screen keeps some code no variant uses any more,
+ * for the contexts created later.
+ */
+struct lp_fs_variant_code
+{
+   struct pipe_reference reference;
+   unsigned char sha1[20];
+
+   /* in the screen's list of unused code, when no variant uses it */
+   struct list_head unused;
+
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+
+   lp_jit_frag_func jit_function[2];
+   boolean opaque;
+   unsigned nr_instrs;
+};
+
+
+static struct lp_fs_variant_code *
+fs_code_create(const unsigned char sha1[20])
+{
+   struct lp_fs_variant_code *code = CALLOC_STRUCT(lp_fs_variant_code);
+
+   if (!code)
+      return NULL;
+
+   code->context = LLVMContextCreate();
+   if (!code->context) {
+      FREE(code);
+      return NULL;
+   }
+
+   pipe_reference_init(&code->reference, 1);
+   memcpy(code->sha1, sha1, sizeof(code->sha1));
+
+   return code;
+}
+
+
+static void
+fs_code_destroy(struct lp_fs_variant_code *code)
+{
+   if (code->gallivm)
+      gallivm_destroy(code->gallivm);
+   LLVMContextDispose(code->context);
+   FREE(code);
+}
+
+
+static uint32_t
+fs_code_hash(const void *key)
+{
+   return _mesa_hash_data(key, 20);
+}
+
+
+static bool
+fs_code_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, 20) == 0;
+}
+
+
+void
+lp_fs_code_cache_init(struct llvmpipe_screen *screen)
+{
+   (void) mtx_init(&screen->fs_code_mutex, mtx_plain);
+   screen->fs_code_cache = _mesa_hash_table_create(NULL, fs_code_hash,
+                                                   fs_code_equal);
+   list_inithead(&screen->fs_code_unused);
+}
+
+
+static void
+fs_code_cache_delete_entry(struct hash_entry *entry)
+{
+   fs_code_destroy(entry->data);
+}
+
+
+void
+lp_fs_code_cache_destroy(struct llvmpipe_screen *screen)
+{
+   /*
+    * Every context is gone by now, but variants of shaders which were never
+    * deleted may still have held references.
+    */
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      debug_printf("llvmpipe: fs code cache hits: %u\n",
+                   screen->fs_code_hits);
+
+   if (screen->fs_code_cache)
+      _mesa_hash_table_destroy(screen->fs_code_cache,
+                               fs_code_cache_delete_entry);
+   mtx_destroy(&screen->fs_code_mutex);
+}
+
+
+/**
+ * Take a reference to code of the cache, which may be unused.  Called with
+ * the screen's lock held.
+ */
+static void
+fs_code_cache_reference(struct llvmpipe_screen *screen,
+                        struct lp_fs_variant_code *code)
+{
+   if (p_atomic_read(&code->reference.count) == 0) {
+      list_del(&code->unused);
+      screen->fs_code_num_unused--;
+      pipe_reference_init(&code->reference, 1);
+   }
+   else {
+      pipe_reference(NULL, &code->reference);
+   }
+}
+
+
+/**
+ * Look for code compiled by any context of the screen, returning a new
+ * reference to it.
+ */
+static struct lp_fs_variant_code *
+fs_code_lookup(struct llvmpipe_screen *screen,
+               const unsigned char sha1[20])
+{
+   struct lp_fs_variant_code *code = NULL;
+   struct hash_entry *entry;
+
+   if (!screen->fs_code_cache)
+      return NULL;
+
+   mtx_lock(&screen->fs_code_mutex);
+   entry = _mesa_hash_table_search(screen->fs_code_cache, sha1);
+   if (entry) {
+      code = entry->data;
+      fs_code_cache_reference(screen, code);
+      screen->fs_code_hits++;
+   }
+   mtx_unlock(&screen->fs_code_mutex);
+
+   return code;
+}
+
+
+/**
+ * Make freshly compiled code available to the other contexts.  Should some
+ * other context have published the same code meanwhile, ours is dropped
+ * and a reference to theirs returned instead.
+ */
+static struct lp_fs_variant_code *
+fs_code_publish(struct llvmpipe_screen *screen,
+                struct lp_fs_variant_code *code)
+{
+   struct lp_fs_variant_code *existing = NULL;
+   struct hash_entry *entry;
+
+   if (!screen->fs_code_cache)
+      return code;
+
+   mtx_lock(&screen->fs_code_mutex);
+   entry = _mesa_hash_table_search(screen->fs_code_cache, code->sha1);
+   if (entry) {
+      existing = entry->data;
+      fs_code_cache_reference(screen, existing);
+   }
+   else {
+      _mesa_hash_table_insert(screen->fs_code_cache, code->sha1, code);
+   }
+   mtx_unlock(&screen->fs_code_mutex);
+
+   if (existing) {
+      fs_code_destroy(code);
+      return existing;
+   }
+
+   return code;
+}
+
+
+/**
+ * Drop a variant's reference to its code.  The last reference is dropped
+ * with the screen's lock held so that a concurrent lookup can't pick the
+ * code up again while it is being destroyed or put on the unused list.
+ * Unused code beyond LP_MAX_UNUSED_FS_CODE is destroyed, least recently
+ * used first.
+ */
+static void
+fs_code_release(struct llvmpipe_screen *screen,
+                struct lp_fs_variant_code *code)
+{
+   struct lp_fs_variant_code *destroy = NULL;
+
+   if (!screen->fs_code_cache) {
+      if (pipe_reference(&code->reference, NULL))
+         fs_code_destroy(code);
+      return;
+   }
+
+   mtx_lock(&screen->fs_code_mutex);
+   if (pipe_reference(&code->reference, NULL)) {
+      struct hash_entry *entry =
+         _mesa_hash_table_search(screen->fs_code_cache, code->sha1);
+
+      if (entry && entry->data == code) {
+         list_add(&code->unused, &screen->fs_code_unused);
+         if (++screen->fs_code_num_unused > LP_MAX_UNUSED_FS_CODE) {
+            destroy = LIST_ENTRY(struct lp_fs_variant_code,
+                                 screen->fs_code_unused.prev, unused);
+            list_del(&destroy->unused);
+            screen->fs_code_num_unused--;
+            _mesa_hash_table_remove_key(screen->fs_code_cache,
+                                        destroy->sha1);
+         }
+      }
+      else {
+         destroy = code;
+      }
+   }
+   mtx_unlock(&screen->fs_code_mutex);
+
+   if (destroy)
+      fs_code_destroy(destroy);
+}
+
+
+static void
+fs_variant_set_code(struct lp_fragment_shader_variant *variant,
+                    struct lp_fs_variant_code *code)
+{
+   variant->code = code;
+   variant->jit_function[RAST_EDGE_TEST] = code->jit_function[RAST_EDGE_TEST];
+   variant->jit_function[RAST_WHOLE] = code->jit_function[RAST_WHOLE];
+   variant->opaque = code->opaque;
+   variant->nr_instrs = code->nr_instrs;
+}
+
+
+static void
+fs_code_set_compiled(struct lp_fs_variant_code *code,
+                     const struct lp_fragment_shader_variant *variant)
+{
+   code->jit_function[RAST_EDGE_TEST] = variant->jit_function[RAST_EDGE_TEST];
+   code->jit_function[RAST_WHOLE] = variant->jit_function[RAST_WHOLE];
+   code->opaque = variant->opaque;
+   code->nr_instrs = variant->nr_instrs;
+}
+
+
+/**
+ * Background compilation of the optimized code of a variant, see
+ * LP_ASYNC_COMPILE.
+ *
+ * The job builds into its own copy of the variant and into a code object
+ * not published yet, which has its own LLVM context, as LLVM contexts
+ * can't be shared between threads.  Only the owning llvmpipe context ever
+ * looks at the result, once the fence is signalled.
+ */
+struct lp_fs_variant_job
+{
+   struct util_queue_fence fence;
+   struct llvmpipe_screen *screen;
+   struct lp_fs_variant_code *code;
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached;
+   struct lp_fragment_shader_variant variant;
+};
+
+
+static void
+fs_variant_job_execute(void *data, int thread_index)
+{
+   struct lp_fs_variant_job *job = data;
+   struct lp_fragment_shader_variant *variant = &job->variant;
+   int64_t t0 = 0;
+
+   if (gallivm_debug & GALLIVM_DEBUG_PERF)
+      t0 = os_time_get();
+
+   variant->gallivm = gallivm_create(job->module_name, job->code->context,
+                                     &job->cached);
+   if (!variant->gallivm)
+      return;
+   job->code->gallivm = variant->gallivm;
+
+   compile_variant(variant->shader, variant, FALSE);
+   fs_code_set_compiled(job->code, variant);
+
+   lp_disk_cache_insert_shader(job->screen, &job->cached,
+                               job->ir_sha1_cache_key);
 
    gallivm_free_ir(variant->gallivm);
 
+   if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+      debug_printf("background compile of %s took %d msec\n",
+                   job->module_name, (int)((os_time_get() - t0) / 1000));
+   }
+}
+
+
+static void
+fs_variant_job_destroy(struct lp_fs_variant_job *job)
+{
+   if (job->code)
+      fs_code_destroy(job->code);
+   free(job->cached.data);
+   util_queue_fence_destroy(&job->fence);
+   FREE(job);
+}
+
+
+/**
+ * Switch a variant over to its optimized code, if that has finished
+ * compiling.  Returns TRUE when the variant has no compile pending anymore.
+ */
+static boolean
+fs_variant_job_finish(struct llvmpipe_context *lp,
+                      struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fs_variant_job *job = variant->job;
+   struct lp_fs_variant_code *code = job->code;
+
+   if (!util_queue_fence_is_signalled(&job->fence))
+      return FALSE;
+
+   /* On failure just keep using the stand-in code */
+   if (code->gallivm && code->jit_function[RAST_EDGE_TEST]) {
+      /*
+       * Scenes binned earlier may still be running the stand-in code, so
+       * that stays around for as long as the variant does.  Both versions
+       * are correct for the key, so it does not matter which one the
+       * rasterizer threads pick up meanwhile.
+       */
+      job->code = NULL;
+      code = fs_code_publish(job->screen, code);
+
+      lp->nr_fs_instrs += code->nr_instrs - variant->nr_instrs;
+      fs_variant_set_code(variant, code);
+   }
+
+   fs_variant_job_destroy(job);
+   variant->job = NULL;
+
+   return TRUE;
+}
+
+
+/**
+ * Generate a new fragment shader variant from the shader code and
+ * other state indicated by the key.
+ */
+static struct lp_fragment_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_fragment_shader_variant *variant;
+   struct lp_fs_variant_job *job = NULL;
+   struct lp_fs_variant_code *code;
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching;
+
+   variant = CALLOC_STRUCT(lp_fragment_shader_variant);
+   if (!variant)
+      return NULL;
+
+   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
+                 shader->no, shader->variants_created);
+
+   variant->shader = shader;
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+   variant->no = shader->variants_created++;
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   lp_fs_get_ir_cache_key(shader, key, ir_sha1_cache_key);
+
+   /* Some other context may have compiled the very same code already */
+   code = fs_code_lookup(screen, ir_sha1_cache_key);
+   if (code) {
+      if (LP_DEBUG & DEBUG_FS)
+         debug_printf("llvmpipe: fs #%u var %u shares compiled code\n",
+                      shader->no, variant->no);
+      fs_variant_set_code(variant, code);
+      return variant;
+   }
+
+   code = fs_code_create(ir_sha1_cache_key);
+   if (!code) {
+      FREE(variant);
+      return NULL;
+   }
+
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+   needs_caching = !cached.data_size;
+
+   /*
+    * Unless the object code is cached already, draw with quick unoptimized
+    * code for now and compile the real thing in the background.
+    */
+   if (needs_caching && util_queue_is_initialized(&screen->compile_queue))
+      job = CALLOC_STRUCT(lp_fs_variant_job);
+
+   if (job) {
+      variant->stand_in_gallivm =
+         gallivm_create_unoptimized(module_name, lp->context);
+      variant->gallivm = variant->stand_in_gallivm;
+   }
+   else {
+      code->gallivm = gallivm_create(module_name, code->context, &cached);
+      variant->gallivm = code->gallivm;
+   }
+   if (!variant->gallivm) {
+      FREE(job);
+      fs_code_destroy(code);
+      free(cached.data);
+      FREE(variant);
+      return NULL;
+   }
+
+   compile_variant(shader, variant, job != NULL);
+
+   if (needs_caching && !job)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
+   gallivm_free_ir(variant->gallivm);
+   variant->gallivm = NULL;
+
+   free(cached.data);
+
+   if (!job) {
+      fs_code_set_compiled(code, variant);
+      fs_variant_set_code(variant, fs_code_publish(screen, code));
+   }
+   else {
+      job->screen = screen;
+      job->code = code;
+      memcpy(job->module_name, module_name, sizeof(module_name));
+      memcpy(job->ir_sha1_cache_key, ir_sha1_cache_key,
+             sizeof(ir_sha1_cache_key));
+      job->variant.shader = shader;
+      job->variant.no = variant->no;
+      memcpy(&job->variant.key, key, shader->variant_key_size);
+
+      util_queue_fence_init(&job->fence);
+      util_queue_add_job(&screen->compile_queue, job, &job->fence,
+                         fs_variant_job_execute, NULL);
+      variant->job = job;
+   }
+
    return variant;
 }
 
@@ -2923,15 +3416,36 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    shader->no = fs_no++;
    make_empty_list(&shader->variants);
 
-   /* get/save the summary info for this shader */
-   lp_build_tgsi_info(templ->tokens, &shader->info);
+   if (templ->type == PIPE_SHADER_IR_NIR) {
+      /* the NIR shader is ours now */
+      nir_shader *nir = templ->ir.nir;
+      struct blob blob;
 
-   /* we need to keep a local copy of the tokens */
-   shader->base.tokens = tgsi_dup_tokens(templ->tokens);
+      lp_build_nir_prepare(nir);
+
+      blob_init(&blob);
+      nir_serialize(&blob, nir);
+      _mesa_sha1_compute(blob.data, blob.size, shader->nir_sha1);
+      blob_finish(&blob);
+
+      shader->base.type = PIPE_SHADER_IR_NIR;
+      shader->base.ir.nir = nir;
+      nir_tgsi_scan_shader(nir, &shader->info.base, false);
+   }
+   else {
+      /* get/save the summary info for this shader */
+      lp_build_tgsi_info(templ->tokens, &shader->info);
+
+      /* we need to keep a local copy of the tokens */
+      shader->base.tokens = tgsi_dup_tokens(templ->tokens);
+   }
 
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
-      FREE((void *) shader->base.tokens);
+      if (shader->base.type == PIPE_SHADER_IR_NIR)
+         ralloc_free(shader->base.ir.nir);
+      else
+         FREE((void *) shader->base.tokens);
       FREE(shader);
       return NULL;
    }
@@ -2984,7 +3498,10 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
       unsigned attrib;
       debug_printf("llvmpipe: Create fragment shader #%u %p:\n",
                    shader->no, (void *) shader);
-      tgsi_dump(templ->tokens, 0);
+      if (shader->base.type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(shader->base.ir.nir, stderr);
+      else
+         tgsi_dump(templ->tokens, 0);
       debug_printf("usage masks:\n");
       for (attrib = 0; attrib < shader->info.base.num_inputs; ++attrib) {
          unsigned usage_mask = shader->info.base.input_usage_mask[attrib];
@@ -3027,6 +3544,8 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       debug_printf("llvmpipe: del fs #%u var %u v created %u v cached %u "
                    "v total cached %u inst %u total inst %u\n",
@@ -3036,7 +3555,18 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
    }
 
-   gallivm_destroy(variant->gallivm);
+   if (variant->job) {
+      util_queue_drop_job(&screen->compile_queue, &variant->job->fence);
+      fs_variant_job_destroy(variant->job);
+   }
+
+   if (lp->fs_variant_pending == variant)
+      lp->fs_variant_pending = NULL;
+
+   if (variant->code)
+      fs_code_release(screen, variant->code);
+   if (variant->stand_in_gallivm)
+      gallivm_destroy(variant->stand_in_gallivm);
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -3079,7 +3609,10 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    draw_delete_fragment_shader(llvmpipe->draw, shader->draw_data);
 
    assert(shader->variants_cached == 0);
-   FREE((void *) shader->base.tokens);
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(shader->base.ir.nir);
+   else
+      FREE((void *) shader->base.tokens);
    FREE(shader);
 }
 
@@ -3107,7 +3640,9 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
    }
 
    if (shader == PIPE_SHADER_VERTEX ||
-       shader == PIPE_SHADER_GEOMETRY) {
+       shader == PIPE_SHADER_GEOMETRY ||
+       shader == PIPE_SHADER_TESS_CTRL ||
+       shader == PIPE_SHADER_TESS_EVAL) {
       /* Pass the constants to the 'draw' module */
       const unsigned size = cb ? cb->buffer_size : 0;
       const ubyte *data;
@@ -3128,7 +3663,7 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
       draw_set_mapped_constant_buffer(llvmpipe->draw, shader,
                                       index, data, size);
    }
-   else {
+   else if (shader == PIPE_SHADER_FRAGMENT) {
       llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
    }
 
@@ -3388,6 +3923,9 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
        * deletion of shader's when we have too many.
        */
       move_to_head(&lp->fs_variants_list, &variant->list_item_global);
+
+      if (variant->job)
+         fs_variant_job_finish(lp, variant);
    }
    else {
       /* variant not found, create it now */
@@ -3451,8 +3989,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       variant = generate_variant(lp, shader, &key);
       t1 = os_time_get();
       dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      LP_COUNT_ADD(&lp->counters, llvm_compile_time, dt);
+      LP_COUNT_ADD(&lp->counters, nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
 
       /* Put the new variant into the list */
       if (variant) {
@@ -3466,6 +4004,21 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
 
    /* Bind this variant */
    lp_setup_set_fs_variant(lp->setup, variant);
+
+   /* Keep checking for the optimized code while drawing with it */
+   lp->fs_variant_pending = variant && variant->job ? variant : NULL;
+}
+
+
+/**
+ * Switch the bound fs variant over to its optimized code, if that has
+ * finished compiling in the background meanwhile.
+ */
+void
+llvmpipe_poll_fs_variant(struct llvmpipe_context *lp)
+{
+   if (fs_variant_job_finish(lp, lp->fs_variant_pending))
+      lp->fs_variant_pending = NULL;
 }
 
 
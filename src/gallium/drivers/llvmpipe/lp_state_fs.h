@@ -40,6 +40,9 @@
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct lp_fs_variant_job;
+struct lp_fs_variant_code;
+struct llvmpipe_screen;
 
 
 /** Indexes into jit_function[] array */
@@ -99,6 +102,7 @@ struct lp_fragment_shader_variant
 
    boolean opaque;
 
+   /* Only valid while the code is being built */
    struct gallivm_state *gallivm;
 
    LLVMTypeRef jit_context_ptr_type;
@@ -112,6 +116,19 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /* Compile of the optimized code still pending, the code above being
+    * unoptimized stand-in code meanwhile (LP_ASYNC_COMPILE).
+    */
+   struct lp_fs_variant_job *job;
+
+   /* The compiled code, shared with other contexts of the screen */
+   struct lp_fs_variant_code *code;
+
+   /* Unoptimized stand-in code (LP_ASYNC_COMPILE).  This stays around once
+    * replaced by the real code, as binned scenes may still use it.
+    */
+   struct gallivm_state *stand_in_gallivm;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
@@ -127,6 +144,9 @@ struct lp_fragment_shader
 
    struct lp_tgsi_info info;
 
+   /** SHA1 of the serialized shader, when base.type is PIPE_SHADER_IR_NIR */
+   unsigned char nir_sha1[20];
+
    struct lp_fs_variant_list_item variants;
 
    struct draw_fragment_shader *draw_data;
@@ -149,4 +169,10 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant);
 
+void
+lp_fs_code_cache_init(struct llvmpipe_screen *screen);
+
+void
+lp_fs_code_cache_destroy(struct llvmpipe_screen *screen);
+
 #endif /* LP_STATE_FS_H_ */
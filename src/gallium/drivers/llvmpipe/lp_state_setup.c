@@ -30,6 +30,7 @@
 #include "util/u_memory.h"
 #include "util/simple_list.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
 #include "gallivm/lp_bld_arit.h"
 #include "gallivm/lp_bld_bitarit.h"
 #include "gallivm/lp_bld_const.h"
@@ -707,16 +708,21 @@ static struct lp_setup_variant *
 generate_setup_variant(struct lp_setup_variant_key *key,
                        struct llvmpipe_context *lp)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_setup_variant *variant = NULL;
    struct gallivm_state *gallivm;
    struct lp_setup_args args;
    char func_name[64];
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching;
    LLVMTypeRef vec4f_type;
    LLVMTypeRef func_type;
    LLVMTypeRef arg_types[7];
    LLVMBasicBlockRef block;
    LLVMBuilderRef builder;
-   int64_t t0 = 0, t1;
+   int64_t t0, t1;
 
    if (0)
       goto fail;
@@ -727,19 +733,26 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    variant->no = setup_no++;
 
-   util_snprintf(func_name, sizeof(func_name), "setup_variant_%u",
+   util_snprintf(module_name, sizeof(module_name), "setup_variant_%u",
                  variant->no);
 
-   variant->gallivm = gallivm = gallivm_create(func_name, lp->context);
+   /* Not made unique, as cached object code is looked up by function name */
+   util_snprintf(func_name, sizeof(func_name), "setup_variant");
+
+   /* The key alone determines the generated code */
+   _mesa_sha1_compute(key, key->size, ir_sha1_cache_key);
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+   needs_caching = !cached.data_size;
+
+   variant->gallivm = gallivm = gallivm_create(module_name, lp->context,
+                                               &cached);
    if (!variant->gallivm) {
       goto fail;
    }
 
    builder = gallivm->builder;
 
-   if (LP_DEBUG & DEBUG_COUNTERS) {
-      t0 = os_time_get();
-   }
+   t0 = os_time_get();
 
    memcpy(&variant->key, key, key->size);
    variant->list_item_global.base = variant;
@@ -805,16 +818,19 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    if (!variant->jit_function)
       goto fail;
 
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
    gallivm_free_ir(variant->gallivm);
 
+   free(cached.data);
+
    /*
     * Update timing information:
     */
-   if (LP_DEBUG & DEBUG_COUNTERS) {
-      t1 = os_time_get();
-      LP_COUNT_ADD(llvm_compile_time, t1 - t0);
-      LP_COUNT_ADD(nr_llvm_compiles, 1);
-   }
+   t1 = os_time_get();
+   LP_COUNT_ADD(&lp->counters, llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD(&lp->counters, nr_llvm_compiles, 1);
 
    return variant;
 
@@ -826,6 +842,8 @@ fail:
       FREE(variant);
    }
 
+   free(cached.data);
+
    return NULL;
 }
 
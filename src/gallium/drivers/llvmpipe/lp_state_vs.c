@@ -32,6 +32,7 @@
 #include "tgsi/tgsi_parse.h"
 #include "util/u_memory.h"
 #include "draw/draw_context.h"
+#include "compiler/nir/nir.h"
 
 #include "lp_context.h"
 #include "lp_debug.h"
@@ -46,15 +47,19 @@ llvmpipe_create_vs_state(struct pipe_context *pipe,
    struct draw_vertex_shader *vs;
 
    vs = draw_create_vertex_shader(llvmpipe->draw, templ);
-   if (!vs) {
-      return NULL;
-   }
 
-   if (LP_DEBUG & DEBUG_TGSI) {
+   if (vs && (LP_DEBUG & DEBUG_TGSI)) {
       debug_printf("llvmpipe: Create vertex shader %p:\n", (void *) vs);
-      tgsi_dump(templ->tokens, 0);
+      if (templ->type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(templ->ir.nir, stderr);
+      else
+         tgsi_dump(templ->tokens, 0);
    }
 
+   /* draw keeps its own copy of the NIR, and we own the one we got */
+   if (templ->type == PIPE_SHADER_IR_NIR)
+      ralloc_free(templ->ir.nir);
+
    return vs;
 }
 
@@ -0,0 +1,342 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Round trip of shader object code through the on-disk cache of
+ * successive screens: what one screen stores the next one finds, unless
+ * a flag which changes the generated code differs.  Code embedding an
+ * absolute address must never be stored.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+
+#include "util/disk_cache.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_init.h"
+#include "state_tracker/sw_winsys.h"
+#include "lp_public.h"
+#include "lp_screen.h"
+
+#include "lp_test.h"
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "test\n");
+
+   fflush(fp);
+}
+
+
+static const unsigned char test_ir_key[20] = "lp_test_disk_cache";
+static const unsigned char relative_ir_key[20] = "lp_test_relative";
+static const unsigned char absolute_ir_key[20] = "lp_test_absolute";
+static const char test_code[] = "not really object code";
+
+static const uintptr_t test_value = 0x1234;
+
+typedef uintptr_t (*load_func_t)(const uintptr_t *);
+
+
+static struct llvmpipe_screen *
+create_screen(struct sw_winsys *winsys)
+{
+   struct pipe_screen *screen = llvmpipe_create_screen(winsys);
+
+   return screen ? llvmpipe_screen(screen) : NULL;
+}
+
+
+/**
+ * Look code up in a new screen's cache, checking it against code unless
+ * that is NULL.
+ * \return 1 on a hit, 0 on a miss, -1 on failure
+ */
+static int
+find_code(struct sw_winsys *winsys, const unsigned char ir_key[20],
+          const void *code, size_t code_size)
+{
+   struct llvmpipe_screen *screen = create_screen(winsys);
+   struct lp_cached_code cached = { 0 };
+   int result;
+
+   if (!screen)
+      return -1;
+
+   lp_disk_cache_find_shader(screen, &cached, ir_key);
+   if (!cached.data_size)
+      result = 0;
+   else if (!code ||
+            (cached.data_size == code_size &&
+             memcmp(cached.data, code, code_size) == 0))
+      result = 1;
+   else
+      result = -1;
+
+   free(cached.data);
+   screen->base.destroy(&screen->base);
+   return result;
+}
+
+
+/**
+ * Compile a function loading a pointer sized value, from its argument or
+ * from the absolute address of test_value, and store its object code the
+ * way fragment shader variants are.
+ */
+static boolean
+compile_and_store(struct llvmpipe_screen *screen,
+                  const unsigned char ir_key[20], boolean absolute,
+                  boolean *dont_cache)
+{
+   LLVMContextRef context = LLVMContextCreate();
+   struct gallivm_state *gallivm;
+   struct lp_cached_code cached = { 0 };
+   LLVMTypeRef int_type, ptr_type, func_type;
+   LLVMValueRef func, ptr;
+   LLVMBasicBlockRef block;
+   load_func_t load;
+   boolean success;
+
+   gallivm = gallivm_create("test_module", context, &cached);
+   if (!gallivm) {
+      LLVMContextDispose(context);
+      return FALSE;
+   }
+
+   int_type = LLVMIntTypeInContext(context, 8 * sizeof(void *));
+   ptr_type = LLVMPointerType(int_type, 0);
+   func_type = LLVMFunctionType(int_type, &ptr_type, 1, 0);
+   func = LLVMAddFunction(gallivm->module, "load", func_type);
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(gallivm->builder, block);
+
+   if (absolute)
+      ptr = lp_build_const_int_pointer(gallivm, &test_value);
+   else
+      ptr = LLVMGetParam(func, 0);
+   LLVMBuildRet(gallivm->builder,
+                LLVMBuildLoad(gallivm->builder, ptr, "value"));
+
+   gallivm_verify_function(gallivm, func);
+   gallivm_compile_module(gallivm);
+   load = (load_func_t)gallivm_jit_function(gallivm, func);
+   success = load(&test_value) == test_value;
+
+   *dont_cache = cached.dont_cache;
+   lp_disk_cache_insert_shader(screen, &cached, ir_key);
+
+   gallivm_destroy(gallivm);
+   free(cached.data);
+   LLVMContextDispose(context);
+
+   return success;
+}
+
+
+static int
+remove_file(const char *path, const struct stat *sb, int type,
+            struct FTW *ftw)
+{
+   return remove(path);
+}
+
+
+static boolean
+test_round_trip(unsigned verbose, FILE *fp)
+{
+   struct sw_winsys winsys;
+   struct llvmpipe_screen *screen;
+   struct lp_cached_code cached = { 0 };
+   char dir[] = "/tmp/lp_test_disk_cache_XXXXXX";
+   boolean success = TRUE;
+   int hit;
+
+   if (!mkdtemp(dir))
+      return FALSE;
+
+   /* The screen doesn't call into the winsys unless rendering */
+   memset(&winsys, 0, sizeof winsys);
+   setenv("MESA_GLSL_CACHE_DIR", dir, 1);
+   unsetenv("MESA_GLSL_CACHE_DISABLE");
+   setenv("LP_NUM_THREADS", "0", 1);
+   unsetenv("LP_PERF");
+
+   screen = create_screen(&winsys);
+   if (!screen) {
+      success = FALSE;
+      goto out;
+   }
+
+   if (!screen->disk_shader_cache) {
+      if (verbose)
+         printf("no disk cache, skipping\n");
+      screen->base.destroy(&screen->base);
+      goto out;
+   }
+
+   cached.data = (void *)test_code;
+   cached.data_size = sizeof test_code;
+   lp_disk_cache_insert_shader(screen, &cached, test_ir_key);
+   disk_cache_wait_for_idle(screen->disk_shader_cache);
+   screen->base.destroy(&screen->base);
+
+   /* Same flags: a hit, with the data stored */
+   hit = find_code(&winsys, test_ir_key, test_code, sizeof test_code);
+   if (verbose || hit != 1)
+      printf("same flags: %s\n", hit == 1 ? "hit" : "miss");
+   success = success && hit == 1;
+
+   /* A flag changing the code: a miss */
+   setenv("LP_PERF", "no_hiz", 1);
+   hit = find_code(&winsys, test_ir_key, test_code, sizeof test_code);
+   if (verbose || hit != 0)
+      printf("LP_PERF=no_hiz: %s\n", hit == 1 ? "hit" : "miss");
+   success = success && hit == 0;
+   unsetenv("LP_PERF");
+
+   if (fp)
+      fprintf(fp, "%s\tround_trip\n", success ? "pass" : "fail");
+
+out:
+   nftw(dir, remove_file, 16, FTW_DEPTH | FTW_PHYS);
+   return success;
+}
+
+
+/**
+ * lp_build_const_int_pointer() marks the code as not cacheable, and such
+ * code must not end up on disk where another process would load it.
+ */
+static boolean
+test_absolute_pointer(unsigned verbose, FILE *fp)
+{
+   struct sw_winsys winsys;
+   struct llvmpipe_screen *screen;
+   char dir[] = "/tmp/lp_test_disk_cache_XXXXXX";
+   boolean success = TRUE;
+   boolean relative_dont_cache, absolute_dont_cache;
+   int hit;
+
+   if (!mkdtemp(dir))
+      return FALSE;
+
+   memset(&winsys, 0, sizeof winsys);
+   setenv("MESA_GLSL_CACHE_DIR", dir, 1);
+   unsetenv("MESA_GLSL_CACHE_DISABLE");
+   setenv("LP_NUM_THREADS", "0", 1);
+   unsetenv("LP_PERF");
+
+   screen = create_screen(&winsys);
+   if (!screen) {
+      success = FALSE;
+      goto out;
+   }
+
+   if (!screen->disk_shader_cache) {
+      if (verbose)
+         printf("no disk cache, skipping\n");
+      screen->base.destroy(&screen->base);
+      goto out;
+   }
+
+   success = compile_and_store(screen, relative_ir_key, FALSE,
+                               &relative_dont_cache) &&
+             compile_and_store(screen, absolute_ir_key, TRUE,
+                               &absolute_dont_cache);
+   disk_cache_wait_for_idle(screen->disk_shader_cache);
+   screen->base.destroy(&screen->base);
+   if (!success) {
+      printf("jit functions returned wrong values\n");
+      goto out;
+   }
+
+   if (verbose || relative_dont_cache || !absolute_dont_cache)
+      printf("dont_cache: relative %u, absolute %u\n",
+             relative_dont_cache, absolute_dont_cache);
+   success = !relative_dont_cache && absolute_dont_cache;
+
+   /* The code loading through its argument is stored, which shows that
+    * compiled code does get there ...
+    */
+   hit = find_code(&winsys, relative_ir_key, NULL, 0);
+   if (verbose || hit != 1)
+      printf("argument pointer: %s\n", hit == 1 ? "hit" : "miss");
+   success = success && hit == 1;
+
+   /* ... and the code with the address of test_value is not */
+   hit = find_code(&winsys, absolute_ir_key, NULL, 0);
+   if (verbose || hit != 0)
+      printf("absolute pointer: %s\n", hit == 1 ? "hit" : "miss");
+   success = success && hit == 0;
+
+out:
+   if (fp)
+      fprintf(fp, "%s\tabsolute_pointer\n", success ? "pass" : "fail");
+
+   nftw(dir, remove_file, 16, FTW_DEPTH | FTW_PHYS);
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = TRUE;
+
+   success = test_round_trip(verbose, fp) && success;
+   success = test_absolute_pointer(verbose, fp) && success;
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
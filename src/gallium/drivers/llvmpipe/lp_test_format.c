@@ -150,7 +150,7 @@ test_format_float(unsigned verbose, FILE *fp,
    unsigned i, j, k, l;
 
    context = LLVMContextCreate();
-   gallivm = gallivm_create("test_module_float", context);
+   gallivm = gallivm_create("test_module_float", context, NULL);
 
    fetch = add_fetch_rgba_test(gallivm, verbose, desc, lp_float32_vec4_type());
 
@@ -175,6 +175,10 @@ test_format_float(unsigned verbose, FILE *fp,
          /* To ensure it's 16-byte aligned */
          memcpy(packed, test->packed, sizeof packed);
 
+         /* Same address as the previous test's block, so drop the cache */
+         if (cache_ptr)
+            lp_build_format_cache_invalidate(cache_ptr);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                boolean match = TRUE;
@@ -249,7 +253,7 @@ test_format_unorm8(unsigned verbose, FILE *fp,
    unsigned i, j, k, l;
 
    context = LLVMContextCreate();
-   gallivm = gallivm_create("test_module_unorm8", context);
+   gallivm = gallivm_create("test_module_unorm8", context, NULL);
 
    fetch = add_fetch_rgba_test(gallivm, verbose, desc, lp_unorm8_vec4_type());
 
@@ -274,6 +278,9 @@ test_format_unorm8(unsigned verbose, FILE *fp,
          /* Could skip this and use unaligned lp_build_fetch_rgba_aos */
          memcpy(packed, test->packed, sizeof packed);
 
+         if (cache_ptr)
+            lp_build_format_cache_invalidate(cache_ptr);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                boolean match;
@@ -359,6 +366,7 @@ test_all(unsigned verbose, FILE *fp)
 
 #if USE_TEXTURE_CACHE
    cache_ptr = align_malloc(sizeof(struct lp_build_format_cache), 16);
+   lp_build_format_cache_invalidate(cache_ptr);
 #endif
 
    for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
@@ -0,0 +1,394 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Lifetime of the fragment shader code shared by the contexts of a screen:
+ * code compiled by one context is reused by contexts created after it is
+ * gone, parked on the screen's list of unused code in between, which is
+ * bounded by LP_MAX_UNUSED_FS_CODE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_parse.h"
+#include "tgsi/tgsi_text.h"
+#include "util/hash_table.h"
+#include "util/u_memory.h"
+#include "util/u_thread.h"
+#include "state_tracker/sw_winsys.h"
+#include "lp_context.h"
+#include "lp_limits.h"
+#include "lp_public.h"
+#include "lp_screen.h"
+#include "lp_state.h"
+
+#include "lp_test.h"
+
+
+#define NUM_THREADS 4
+#define NUM_THREAD_ITERATIONS 16
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "test\n");
+
+   fflush(fp);
+}
+
+
+static const char vs_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL OUT[0], POSITION\n"
+   "  0: MOV OUT[0], IN[0]\n"
+   "  1: END\n";
+
+/* Shader n writes a red of n, which makes its code unique */
+static const char fs_text_format[] =
+   "FRAG\n"
+   "DCL OUT[0], COLOR\n"
+   "IMM[0] FLT32 { %10u.0000,     0.0000,     0.0000,     1.0000}\n"
+   "  0: MOV OUT[0], IMM[0]\n"
+   "  1: END\n";
+
+
+static boolean
+create_shader_state(struct pipe_shader_state *state, const char *text)
+{
+   struct tgsi_token tokens[1024];
+
+   memset(state, 0, sizeof *state);
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens)))
+      return FALSE;
+
+   state->type = PIPE_SHADER_IR_TGSI;
+   state->tokens = tgsi_dup_tokens(tokens);
+   return state->tokens != NULL;
+}
+
+
+/**
+ * Create a context, make it build the fragment shader variants it would
+ * draw with for shaders first to first + count - 1, one after the other,
+ * and destroy it again.  Each shader is deleted as soon as it was used,
+ * releasing its code.
+ */
+static boolean
+use_shaders_in_context(struct llvmpipe_screen *screen,
+                       unsigned first, unsigned count)
+{
+   struct pipe_context *pipe;
+   struct pipe_shader_state vs_state;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_rasterizer_state rast;
+   void *vs, *blend_cso, *dsa_cso, *rast_cso;
+   boolean success = TRUE;
+   unsigned i;
+
+   if (!create_shader_state(&vs_state, vs_text))
+      return FALSE;
+
+   pipe = screen->base.context_create(&screen->base, NULL, 0);
+   if (!pipe) {
+      FREE((void *)vs_state.tokens);
+      return FALSE;
+   }
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   memset(&dsa, 0, sizeof dsa);
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+
+   blend_cso = pipe->create_blend_state(pipe, &blend);
+   dsa_cso = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   rast_cso = pipe->create_rasterizer_state(pipe, &rast);
+   vs = pipe->create_vs_state(pipe, &vs_state);
+
+   pipe->bind_blend_state(pipe, blend_cso);
+   pipe->bind_depth_stencil_alpha_state(pipe, dsa_cso);
+   pipe->bind_rasterizer_state(pipe, rast_cso);
+   pipe->bind_vs_state(pipe, vs);
+
+   for (i = first; i < first + count && success; i++) {
+      struct pipe_shader_state fs_state;
+      char fs_text[sizeof fs_text_format + 16];
+      void *fs;
+
+      snprintf(fs_text, sizeof fs_text, fs_text_format, i);
+      if (!create_shader_state(&fs_state, fs_text)) {
+         success = FALSE;
+         break;
+      }
+
+      fs = pipe->create_fs_state(pipe, &fs_state);
+      pipe->bind_fs_state(pipe, fs);
+
+      /* what draw_vbo does before drawing */
+      llvmpipe_update_derived(llvmpipe_context(pipe));
+      success = llvmpipe_context(pipe)->nr_fs_variants == 1;
+
+      pipe->bind_fs_state(pipe, NULL);
+      pipe->delete_fs_state(pipe, fs);
+      FREE((void *)fs_state.tokens);
+   }
+
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->delete_vs_state(pipe, vs);
+   pipe->delete_rasterizer_state(pipe, rast_cso);
+   pipe->delete_depth_stencil_alpha_state(pipe, dsa_cso);
+   pipe->delete_blend_state(pipe, blend_cso);
+   pipe->destroy(pipe);
+
+   FREE((void *)vs_state.tokens);
+   return success;
+}
+
+
+static struct llvmpipe_screen *
+create_screen(struct sw_winsys *winsys)
+{
+   struct pipe_screen *screen;
+
+   /* The screen doesn't call into the winsys unless rendering */
+   memset(winsys, 0, sizeof *winsys);
+   setenv("MESA_GLSL_CACHE_DISABLE", "1", 1);
+   setenv("LP_NUM_THREADS", "0", 1);
+   unsetenv("LP_ASYNC_COMPILE");
+
+   screen = llvmpipe_create_screen(winsys);
+   if (!screen)
+      return NULL;
+
+   if (!llvmpipe_screen(screen)->fs_code_cache) {
+      screen->destroy(screen);
+      return NULL;
+   }
+
+   return llvmpipe_screen(screen);
+}
+
+
+static boolean
+test_sequential_contexts(unsigned verbose, FILE *fp)
+{
+   struct sw_winsys winsys;
+   struct llvmpipe_screen *screen;
+   boolean success;
+   unsigned hits[2], unused[2];
+
+   screen = create_screen(&winsys);
+   if (!screen)
+      return FALSE;
+
+   /* The first context compiles the code, which stays around unused once
+    * the context is gone, and the second one finds it.
+    */
+   success = use_shaders_in_context(screen, 0, 1);
+   hits[0] = screen->fs_code_hits;
+   unused[0] = screen->fs_code_num_unused;
+   success = success && use_shaders_in_context(screen, 0, 1);
+   hits[1] = screen->fs_code_hits;
+   unused[1] = screen->fs_code_num_unused;
+
+   success = success &&
+             hits[0] == 0 && hits[1] == 1 &&
+             unused[0] == 1 && unused[1] == 1 &&
+             screen->fs_code_cache->entries == 1;
+   if (verbose || !success)
+      printf("first context: %u hits, second context: %u hits, "
+             "%u and %u unused\n",
+             hits[0], hits[1] - hits[0], unused[0], unused[1]);
+
+   screen->base.destroy(&screen->base);
+
+   if (fp)
+      fprintf(fp, "%s\tsequential_contexts\n", success ? "pass" : "fail");
+
+   return success;
+}
+
+
+/**
+ * Code no variant uses is kept for LP_MAX_UNUSED_FS_CODE shaders, the least
+ * recently used being destroyed first.
+ */
+static boolean
+test_unused_lru(unsigned verbose, FILE *fp)
+{
+   struct sw_winsys winsys;
+   struct llvmpipe_screen *screen;
+   boolean success;
+   unsigned unused, entries, hits[2];
+
+   screen = create_screen(&winsys);
+   if (!screen)
+      return FALSE;
+
+   /* One more than what's kept: the code of shader 0 goes */
+   success = use_shaders_in_context(screen, 0, LP_MAX_UNUSED_FS_CODE + 1);
+   unused = screen->fs_code_num_unused;
+   entries = screen->fs_code_cache->entries;
+
+   /* Shader 0 gets compiled again, pushing out shader 1, and the most
+    * recently used one is still there.
+    */
+   success = success && use_shaders_in_context(screen, 0, 1);
+   hits[0] = screen->fs_code_hits;
+   success = success &&
+             use_shaders_in_context(screen, LP_MAX_UNUSED_FS_CODE, 1);
+   hits[1] = screen->fs_code_hits;
+
+   success = success &&
+             unused == LP_MAX_UNUSED_FS_CODE &&
+             entries == LP_MAX_UNUSED_FS_CODE &&
+             hits[0] == 0 && hits[1] == 1 &&
+             screen->fs_code_num_unused == LP_MAX_UNUSED_FS_CODE;
+   if (verbose || !success)
+      printf("%u unused of %u cached, least recently used: %s, "
+             "most recently used: %s\n",
+             unused, entries,
+             hits[0] ? "hit" : "miss", hits[1] > hits[0] ? "hit" : "miss");
+
+   screen->base.destroy(&screen->base);
+
+   if (fp)
+      fprintf(fp, "%s\tunused_lru\n", success ? "pass" : "fail");
+
+   return success;
+}
+
+
+struct thread_data {
+   struct llvmpipe_screen *screen;
+   boolean success;
+};
+
+
+static int
+use_shaders_thread(void *data)
+{
+   struct thread_data *thread = data;
+   unsigned i;
+
+   thread->success = TRUE;
+   for (i = 0; i < NUM_THREAD_ITERATIONS && thread->success; i++)
+      thread->success = use_shaders_in_context(thread->screen, i % 2, 1);
+
+   return 0;
+}
+
+
+/**
+ * Contexts on several threads picking up and dropping the same code, which
+ * has to be taken off and put back on the unused list consistently.
+ */
+static boolean
+test_concurrent_contexts(unsigned verbose, FILE *fp)
+{
+   struct sw_winsys winsys;
+   struct llvmpipe_screen *screen;
+   struct thread_data threads[NUM_THREADS];
+   thrd_t handles[NUM_THREADS];
+   boolean success = TRUE;
+   unsigned i;
+
+   screen = create_screen(&winsys);
+   if (!screen)
+      return FALSE;
+
+   for (i = 0; i < NUM_THREADS; i++) {
+      threads[i].screen = screen;
+      handles[i] = u_thread_create(use_shaders_thread, &threads[i]);
+   }
+   for (i = 0; i < NUM_THREADS; i++) {
+      thrd_join(handles[i], NULL);
+      success = success && threads[i].success;
+   }
+
+   /* Contexts compiling the same code at once keep only one copy */
+   success = success &&
+             screen->fs_code_num_unused == 2 &&
+             screen->fs_code_cache->entries == 2 &&
+             screen->fs_code_hits >=
+                NUM_THREADS * (NUM_THREAD_ITERATIONS - 2);
+   if (verbose || !success)
+      printf("%u threads: %u hits, %u unused of %u cached\n",
+             NUM_THREADS, screen->fs_code_hits,
+             screen->fs_code_num_unused, screen->fs_code_cache->entries);
+
+   screen->base.destroy(&screen->base);
+
+   if (fp)
+      fprintf(fp, "%s\tconcurrent_contexts\n", success ? "pass" : "fail");
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = TRUE;
+
+   success = test_sequential_contexts(verbose, fp) && success;
+   success = test_unused_lru(verbose, fp) && success;
+   success = test_concurrent_contexts(verbose, fp) && success;
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
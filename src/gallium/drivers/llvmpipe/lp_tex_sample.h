@@ -33,11 +33,7 @@
 
 
 struct lp_sampler_static_state;
-
-/**
- * Whether texture cache is used for s3tc textures.
- */
-#define LP_USE_TEXTURE_CACHE 0
+struct lp_static_texture_state;
 
 /**
  * Pure-LLVM texture sampling code generator.
@@ -46,4 +42,10 @@ struct lp_sampler_static_state;
 struct lp_build_sampler_soa *
 lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *key);
 
+struct lp_build_sampler_soa *
+lp_llvm_cs_sampler_soa_create(const struct lp_sampler_static_state *key);
+
+struct lp_build_image_soa *
+lp_llvm_image_soa_create(const struct lp_static_texture_state *key);
+
 #endif /* LP_TEX_SAMPLE_H */
@@ -41,9 +41,11 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
+#include "util/u_surface.h"
 #include "util/u_transfer.h"
 
 #include "lp_context.h"
+#include "lp_fence.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_texture.h"
@@ -51,6 +53,8 @@
 #include "lp_state.h"
 #include "lp_rast.h"
 
+#include "gallivm/lp_bld_sample.h"
+
 #include "state_tracker/sw_winsys.h"
 
 
@@ -60,6 +64,39 @@ static struct llvmpipe_resource resource_list;
 static unsigned id_counter = 0;
 
 
+/**
+ * Whether a texture can use the tiled layout (LP_RESOURCE_FLAG_TILED).
+ * Only the texture samplers and transfers know about that layout, so it's
+ * limited to textures which are never used as depth buffers or images.
+ * Render targets start out tiled too (the state tracker makes most color
+ * textures bindable as such), and are detiled when first rendered to.
+ */
+static boolean
+llvmpipe_texture_can_tile(const struct llvmpipe_screen *screen,
+                          const struct pipe_resource *pt)
+{
+   if (!screen->tiled_textures)
+      return FALSE;
+
+   if (!(pt->bind & PIPE_BIND_SAMPLER_VIEW) ||
+       (pt->bind & (PIPE_BIND_DEPTH_STENCIL |
+                    PIPE_BIND_SHADER_IMAGE |
+                    PIPE_BIND_LINEAR)))
+      return FALSE;
+
+   /* persistent mappings have to alias the texture memory */
+   if (pt->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                    PIPE_RESOURCE_FLAG_MAP_COHERENT))
+      return FALSE;
+
+   if (llvmpipe_resource_is_1d(pt))
+      return FALSE;
+
+   return util_format_get_blockwidth(pt->format) == 1 &&
+          util_format_get_blockheight(pt->format) == 1;
+}
+
+
 /**
  * Conventional allocation path for non-display textures:
  * Compute strides and allocate data (unless asked not to).
@@ -112,6 +149,12 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
             align_y = LP_RASTER_BLOCK_SIZE;
       }
 
+      /* Tiled textures are made of whole tiles */
+      if (pt->flags & LP_RESOURCE_FLAG_TILED) {
+         align_x = MAX2(align_x, LP_TEXTURE_TILE_WIDTH);
+         align_y = MAX2(align_y, LP_TEXTURE_TILE_HEIGHT);
+      }
+
       nblocksx = util_format_get_nblocksx(pt->format,
                                           align(width, align_x));
       nblocksy = util_format_get_nblocksy(pt->format,
@@ -262,6 +305,8 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
       }
       else {
          /* texture map */
+         if (llvmpipe_texture_can_tile(screen, &lpr->base))
+            lpr->base.flags |= LP_RESOURCE_FLAG_TILED;
          if (!llvmpipe_texture_layout(screen, lpr, true))
             goto fail;
       }
@@ -504,6 +549,139 @@ llvmpipe_resource_get_handle(struct pipe_screen *screen,
 }
 
 
+/**
+ * Copy a box of texels of one image of a tiled texture to (to_linear) or
+ * from a linear buffer.
+ */
+static void
+llvmpipe_copy_tiled(ubyte *tiled, unsigned tiled_stride,
+                    ubyte *linear, unsigned linear_stride,
+                    unsigned x, unsigned y,
+                    unsigned width, unsigned height,
+                    unsigned cpp, boolean to_linear)
+{
+   const unsigned tw = LP_TEXTURE_TILE_WIDTH;
+   const unsigned th = LP_TEXTURE_TILE_HEIGHT;
+   unsigned i, j, n;
+
+   for (j = 0; j < height; j++) {
+      unsigned ty = y + j;
+      ubyte *tiled_row = tiled + (ty & ~(th - 1)) * tiled_stride +
+                         (ty & (th - 1)) * tw * cpp;
+      ubyte *linear_row = linear + j * linear_stride;
+
+      for (i = 0; i < width; i += n) {
+         unsigned tx = x + i;
+         ubyte *texel = tiled_row + (tx & ~(tw - 1)) * th * cpp +
+                        (tx & (tw - 1)) * cpp;
+
+         /* texels are contiguous up to the end of the tile row */
+         n = MIN2(tw - (tx & (tw - 1)), width - i);
+
+         if (to_linear)
+            memcpy(linear_row + i * cpp, texel, n * cpp);
+         else
+            memcpy(texel, linear_row + i * cpp, n * cpp);
+      }
+   }
+}
+
+
+/**
+ * Switch a tiled texture to the linear layout, which is what the rasterizer
+ * renders to.  Called when the first surface of the texture is created, so
+ * textures which are only ever sampled from stay tiled.
+ *
+ * The texture may be shared with other contexts, so this waits for the
+ * scenes all of them queued, not just the calling context's.  Work another
+ * context has not flushed yet is not covered, but GL leaves using an object
+ * in one context while another modifies it undefined until they sync, which
+ * implies a flush.
+ */
+void
+llvmpipe_detile_resource(struct pipe_context *pipe,
+                         struct pipe_resource *resource)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   const unsigned th = LP_TEXTURE_TILE_HEIGHT;
+   const unsigned cpp = util_format_get_blocksize(resource->format);
+   unsigned level, layer, y;
+   struct lp_fence *fence = NULL;
+   ubyte *tmp;
+
+   if (!(resource->flags & LP_RESOURCE_FLAG_TILED))
+      return;
+
+   mtx_lock(&screen->layout_mutex);
+
+   /* Another context may have got there first */
+   if (!(resource->flags & LP_RESOURCE_FLAG_TILED)) {
+      mtx_unlock(&screen->layout_mutex);
+      return;
+   }
+
+   /* Rendering may still be sampling from the tiled texture.  Scenes are
+    * rasterized in order, so once this context's are queued the last one
+    * queued by any context covers them all.
+    */
+   llvmpipe_flush_resource(pipe, resource, 0,
+                           FALSE, /* read_only */
+                           FALSE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           __FUNCTION__);
+
+   mtx_lock(&screen->rast_mutex);
+   lp_fence_reference(&fence, screen->last_fence);
+   mtx_unlock(&screen->rast_mutex);
+   if (fence) {
+      lp_fence_wait(fence);
+      lp_fence_reference(&fence, NULL);
+   }
+
+   /* A row of tiles takes the same memory as the texel rows it covers, so
+    * it is enough to detile a row of tiles at a time through a copy.
+    */
+   tmp = MALLOC(lpr->row_stride[0] * th);
+   if (!tmp) {
+      mtx_unlock(&screen->layout_mutex);
+      return;
+   }
+
+   for (level = 0; level <= resource->last_level; level++) {
+      unsigned width = u_minify(resource->width0, level);
+      unsigned height = u_minify(resource->height0, level);
+      unsigned num_layers = resource->target == PIPE_TEXTURE_3D ?
+                            u_minify(resource->depth0, level) :
+                            resource->array_size;
+      unsigned stride = lpr->row_stride[level];
+
+      for (layer = 0; layer < num_layers; layer++) {
+         ubyte *image = llvmpipe_get_texture_image_address(lpr, layer, level);
+
+         for (y = 0; y < height; y += th) {
+            memcpy(tmp, image + y * stride, stride * th);
+            llvmpipe_copy_tiled(tmp, stride,
+                                image + y * stride, stride,
+                                0, 0, width, MIN2(th, height - y),
+                                cpp, TRUE);
+         }
+      }
+   }
+
+   FREE(tmp);
+
+   resource->flags &= ~LP_RESOURCE_FLAG_TILED;
+
+   /* Sampling code of all contexts has to be switched to the linear layout.
+    * The increment also orders the flag change before it for them.
+    */
+   p_atomic_inc(&screen->layout_timestamp);
+
+   mtx_unlock(&screen->layout_mutex);
+}
+
+
 static void *
 llvmpipe_transfer_map( struct pipe_context *pipe,
                        struct pipe_resource *resource,
@@ -525,6 +703,11 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
    assert(resource);
    assert(level <= resource->last_level);
 
+   /* Tiled textures are only ever mapped through a linear copy */
+   if ((resource->flags & LP_RESOURCE_FLAG_TILED) &&
+       (usage & PIPE_TRANSFER_MAP_DIRECTLY))
+      return NULL;
+
    /*
     * Transfers, like other pipe operations, must happen in order, so flush the
     * context if necessary.
@@ -609,6 +792,40 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       /* Do something to notify sharing contexts of a texture change.
        */
       screen->timestamp++;
+      p_atomic_inc(&lpr->hiz_serial);
+   }
+
+   if (resource->flags & LP_RESOURCE_FLAG_TILED) {
+      /* Hand out a linear copy of the box, tiled back on unmap */
+      const unsigned cpp = util_format_get_blocksize(format);
+      unsigned z;
+
+      pt->stride = align(box->width * cpp, 16);
+      pt->layer_stride = pt->stride * box->height;
+
+      lpt->staging = align_malloc(pt->layer_stride * box->depth, 64);
+      if (!lpt->staging) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         *transfer = NULL;
+         return NULL;
+      }
+
+      if (!(usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                     PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))) {
+         for (z = 0; z < box->depth; z++) {
+            llvmpipe_copy_tiled(llvmpipe_get_texture_image_address(lpr,
+                                                                   box->z + z,
+                                                                   level),
+                                lpr->row_stride[level],
+                                lpt->staging + z * pt->layer_stride,
+                                pt->stride,
+                                box->x, box->y, box->width, box->height,
+                                cpp, TRUE);
+         }
+      }
+
+      return lpt->staging;
    }
 
    map +=
@@ -623,16 +840,53 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
 
-   /* Effectively do the texture_update work here - if texture images
-    * needed post-processing to put them into hardware layout, this is
-    * where it would happen.  For llvmpipe, nothing to do.
+   /* Effectively do the texture_update work here - texture images which
+    * need post-processing to put them into their layout are tiled here.
     */
+   if (lpt->staging) {
+      struct llvmpipe_resource *lpr = llvmpipe_resource(transfer->resource);
+      const struct pipe_box *box = &transfer->box;
+
+      if (!(lpr->base.flags & LP_RESOURCE_FLAG_TILED)) {
+         /* the texture got detiled while mapped */
+         if (transfer->usage & PIPE_TRANSFER_WRITE) {
+            util_copy_box(llvmpipe_get_texture_image_address(lpr, 0,
+                                                             transfer->level),
+                          lpr->base.format,
+                          lpr->row_stride[transfer->level],
+                          lpr->img_stride[transfer->level],
+                          box->x, box->y, box->z,
+                          box->width, box->height, box->depth,
+                          lpt->staging, transfer->stride,
+                          transfer->layer_stride, 0, 0, 0);
+         }
+      }
+      else if (transfer->usage & PIPE_TRANSFER_WRITE) {
+         const unsigned cpp = util_format_get_blocksize(lpr->base.format);
+         unsigned z;
+
+         for (z = 0; z < box->depth; z++) {
+            llvmpipe_copy_tiled(llvmpipe_get_texture_image_address(lpr,
+                                                                   box->z + z,
+                                                                   transfer->level),
+                                lpr->row_stride[transfer->level],
+                                lpt->staging + z * transfer->layer_stride,
+                                transfer->stride,
+                                box->x, box->y, box->width, box->height,
+                                cpp, FALSE);
+         }
+      }
+      align_free(lpt->staging);
+   }
+
    assert (transfer->resource);
    pipe_resource_reference(&transfer->resource, NULL);
    FREE(transfer);
@@ -90,6 +90,12 @@ struct llvmpipe_resource
 
    unsigned id;  /**< temporary, for debugging */
 
+   /**
+    * Bumped whenever the contents may have changed behind the back of
+    * setup's hierarchical z bounds (cpu writes, draws raising depth values).
+    */
+   unsigned hiz_serial;
+
 #ifdef DEBUG
    /** for linked list */
    struct llvmpipe_resource *prev, *next;
@@ -102,6 +108,9 @@ struct llvmpipe_transfer
    struct pipe_transfer base;
 
    unsigned long offset;
+
+   /** Linear copy of the mapped box, for tiled textures */
+   ubyte *staging;
 };
 
 
@@ -206,6 +215,10 @@ llvmpipe_resource_unmap(struct pipe_resource *resource,
                         unsigned level,
                         unsigned layer);
 
+void
+llvmpipe_detile_resource(struct pipe_context *pipe,
+                         struct pipe_resource *resource);
+
 
 void *
 llvmpipe_resource_data(struct pipe_resource *resource);
@@ -38,6 +38,7 @@
 #include "sp_clear.h"
 #include "sp_context.h"
 #include "sp_query.h"
+#include "sp_rast_threads.h"
 #include "sp_tile_cache.h"
 
 
@@ -66,6 +67,10 @@ softpipe_clear(struct pipe_context *pipe, unsigned buffers,
    softpipe_update_derived(softpipe, PIPE_PRIM_TRIANGLES); /* not needed?? */
 #endif
 
+   /* clears go through the context's surface caches */
+   if (softpipe->rast_threads)
+      sp_rast_threads_flush(softpipe, FALSE);
+
    if (buffers & PIPE_CLEAR_COLOR) {
       for (i = 0; i < softpipe->framebuffer.nr_cbufs; i++) {
          sp_tile_cache_clear(softpipe->cbuf_cache[i], color, 0);
@@ -44,6 +44,7 @@
 #include "sp_context.h"
 #include "sp_flush.h"
 #include "sp_prim_vbuf.h"
+#include "sp_rast_threads.h"
 #include "sp_state.h"
 #include "sp_surface.h"
 #include "sp_tile_cache.h"
@@ -75,17 +76,9 @@ softpipe_destroy( struct pipe_context *pipe )
    if (softpipe->draw)
       draw_destroy( softpipe->draw );
 
-   if (softpipe->quad.shade)
-      softpipe->quad.shade->destroy( softpipe->quad.shade );
+   sp_destroy_rast_threads(softpipe);
 
-   if (softpipe->quad.depth_test)
-      softpipe->quad.depth_test->destroy( softpipe->quad.depth_test );
-
-   if (softpipe->quad.blend)
-      softpipe->quad.blend->destroy( softpipe->quad.blend );
-
-   if (softpipe->quad.pstipple)
-      softpipe->quad.pstipple->destroy( softpipe->quad.pstipple );
+   sp_destroy_quad_pipe(&softpipe->quad);
 
    if (softpipe->pipe.stream_uploader)
       u_upload_destroy(softpipe->pipe.stream_uploader);
@@ -266,10 +259,20 @@ softpipe_create_context(struct pipe_screen *screen,
    softpipe->fs_machine = tgsi_exec_machine_create(PIPE_SHADER_FRAGMENT);
 
    /* setup quad rendering stages */
-   softpipe->quad.shade = sp_quad_shade_stage(softpipe);
-   softpipe->quad.depth_test = sp_quad_depth_test_stage(softpipe);
-   softpipe->quad.blend = sp_quad_blend_stage(softpipe);
-   softpipe->quad.pstipple = sp_quad_polygon_stipple_stage(softpipe);
+   if (!sp_create_quad_pipe(softpipe, &softpipe->quad))
+      goto fail;
+
+   softpipe->quad.fs_machine = softpipe->fs_machine;
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      softpipe->quad.cbuf_cache[i] = softpipe->cbuf_cache[i];
+   softpipe->quad.zsbuf_cache = softpipe->zsbuf_cache;
+   softpipe->quad.occlusion_count = &softpipe->occlusion_count;
+   softpipe->quad.ps_invocations =
+      &softpipe->pipeline_statistics.ps_invocations;
+
+   /* before the vbuf backend, which sizes its batches by it */
+   sp_create_rast_threads(softpipe,
+                          debug_get_num_option("SOFTPIPE_NUM_THREADS", 0));
 
    softpipe->pipe.stream_uploader = u_upload_create_default(&softpipe->pipe);
    if (!softpipe->pipe.stream_uploader)
@@ -35,6 +35,7 @@
 #include "draw/draw_context.h"
 #include "sp_flush.h"
 #include "sp_context.h"
+#include "sp_rast_threads.h"
 #include "sp_state.h"
 #include "sp_tile_cache.h"
 #include "sp_tex_tile_cache.h"
@@ -53,6 +54,9 @@ softpipe_flush( struct pipe_context *pipe,
 
    draw_flush(softpipe->draw);
 
+   if (softpipe->rast_threads)
+      sp_rast_threads_flush(softpipe, !!(flags & SP_FLUSH_TEXTURE_CACHE));
+
    if (flags & SP_FLUSH_TEXTURE_CACHE) {
       unsigned sh;
 
@@ -174,6 +178,9 @@ void softpipe_texture_barrier(struct pipe_context *pipe, unsigned flags)
    struct softpipe_context *softpipe = softpipe_context(pipe);
    uint i, sh;
 
+   if (softpipe->rast_threads)
+      sp_rast_threads_flush(softpipe, TRUE);
+
    for (sh = 0; sh < ARRAY_SIZE(softpipe->tex_cache); sh++) {
       for (i = 0; i < softpipe->num_sampler_views[sh]; i++) {
          sp_flush_tex_tile_cache(softpipe->tex_cache[sh][i]);
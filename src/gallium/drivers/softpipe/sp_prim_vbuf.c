@@ -40,6 +40,7 @@
 #include "sp_setup.h"
 #include "sp_state.h"
 #include "sp_prim_vbuf.h"
+#include "sp_rast_threads.h"
 #include "draw/draw_context.h"
 #include "draw/draw_vbuf.h"
 #include "util/u_memory.h"
@@ -49,6 +50,10 @@
 #define SP_MAX_VBUF_INDEXES 1024
 #define SP_MAX_VBUF_SIZE    4096
 
+/* Larger batches with rasterizer threads, which sync once per batch */
+#define SP_MAX_THREADED_VBUF_INDEXES 16384
+#define SP_MAX_THREADED_VBUF_SIZE    65536
+
 typedef const float (*cptrf4)[4];
 
 /**
@@ -68,6 +73,21 @@ struct softpipe_vbuf_render
 };
 
 
+/**
+ * A batch of primitives handed to draw_elements() or draw_arrays(), for
+ * each rasterizer thread to set up.
+ */
+struct sp_vbuf_batch
+{
+   enum pipe_prim_type prim;
+   const void *vertex_buffer;
+   unsigned stride;
+   const ushort *indices;  /**< draw_elements() only */
+   uint nr;
+   boolean flatshade_first;
+};
+
+
 /** cast wrapper */
 static struct softpipe_vbuf_render *
 softpipe_vbuf_render(struct vbuf_render *vbr)
@@ -140,6 +160,9 @@ sp_vbuf_set_primitive(struct vbuf_render *vbr, enum pipe_prim_type prim)
    
    sp_setup_prepare( setup_ctx );
 
+   if (cvbr->softpipe->rast_threads)
+      sp_rast_threads_prepare(cvbr->softpipe);
+
    cvbr->softpipe->reduced_prim = u_reduced_prim(prim);
    cvbr->prim = prim;
 }
@@ -154,20 +177,31 @@ static inline cptrf4 get_vert( const void *vertex_buffer,
 
 
 /**
- * draw elements / indexed primitives
+ * Set up and render a batch, on the rasterizer threads if there are any.
  */
 static void
-sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
+render_batch(struct softpipe_vbuf_render *cvbr,
+             sp_rast_func func, struct sp_vbuf_batch *batch)
 {
-   struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
-   struct softpipe_context *softpipe = cvbr->softpipe;
-   const unsigned stride = softpipe->vertex_info.size * sizeof(float);
-   const void *vertex_buffer = cvbr->vertex_buffer;
-   struct setup_context *setup = cvbr->setup;
-   const boolean flatshade_first = softpipe->rasterizer->flatshade_first;
+   if (cvbr->softpipe->rast_threads)
+      sp_rast_threads_run(cvbr->softpipe, cvbr->setup, func, batch);
+   else
+      func(cvbr->setup, batch);
+}
+
+
+static void
+render_elements(struct setup_context *setup, void *data)
+{
+   const struct sp_vbuf_batch *batch = (const struct sp_vbuf_batch *) data;
+   const unsigned stride = batch->stride;
+   const void *vertex_buffer = batch->vertex_buffer;
+   const ushort *indices = batch->indices;
+   const uint nr = batch->nr;
+   const boolean flatshade_first = batch->flatshade_first;
    unsigned i;
 
-   switch (cvbr->prim) {
+   switch (batch->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
          sp_setup_point( setup,
@@ -349,22 +383,37 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
 
 
 /**
- * This function is hit when the draw module is working in pass-through mode.
- * It's up to us to convert the vertex array into point/line/tri prims.
+ * draw elements / indexed primitives
  */
 static void
-sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
+sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
 {
    struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
    struct softpipe_context *softpipe = cvbr->softpipe;
-   struct setup_context *setup = cvbr->setup;
-   const unsigned stride = softpipe->vertex_info.size * sizeof(float);
-   const void *vertex_buffer =
-      (void *) get_vert(cvbr->vertex_buffer, start, stride);
-   const boolean flatshade_first = softpipe->rasterizer->flatshade_first;
+   struct sp_vbuf_batch batch;
+
+   batch.prim = cvbr->prim;
+   batch.stride = softpipe->vertex_info.size * sizeof(float);
+   batch.vertex_buffer = cvbr->vertex_buffer;
+   batch.indices = indices;
+   batch.nr = nr;
+   batch.flatshade_first = softpipe->rasterizer->flatshade_first;
+
+   render_batch(cvbr, render_elements, &batch);
+}
+
+
+static void
+render_arrays(struct setup_context *setup, void *data)
+{
+   const struct sp_vbuf_batch *batch = (const struct sp_vbuf_batch *) data;
+   const unsigned stride = batch->stride;
+   const void *vertex_buffer = batch->vertex_buffer;
+   const uint nr = batch->nr;
+   const boolean flatshade_first = batch->flatshade_first;
    unsigned i;
 
-   switch (cvbr->prim) {
+   switch (batch->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
          sp_setup_point( setup,
@@ -587,6 +636,27 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    }
 }
 
+/**
+ * This function is hit when the draw module is working in pass-through mode.
+ * It's up to us to convert the vertex array into point/line/tri prims.
+ */
+static void
+sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
+{
+   struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
+   struct softpipe_context *softpipe = cvbr->softpipe;
+   struct sp_vbuf_batch batch;
+
+   batch.prim = cvbr->prim;
+   batch.stride = softpipe->vertex_info.size * sizeof(float);
+   batch.vertex_buffer = get_vert(cvbr->vertex_buffer, start, batch.stride);
+   batch.indices = NULL;
+   batch.nr = nr;
+   batch.flatshade_first = softpipe->rasterizer->flatshade_first;
+
+   render_batch(cvbr, render_arrays, &batch);
+}
+
 /*
  * FIXME: it is unclear if primitives_storage_needed (which is generally
  * the same as pipe query num_primitives_generated) should increase
@@ -650,8 +720,14 @@ sp_create_vbuf_backend(struct softpipe_context *sp)
 
    assert(sp->draw);
 
-   cvbr->base.max_indices = SP_MAX_VBUF_INDEXES;
-   cvbr->base.max_vertex_buffer_bytes = SP_MAX_VBUF_SIZE;
+   if (sp->rast_threads) {
+      cvbr->base.max_indices = SP_MAX_THREADED_VBUF_INDEXES;
+      cvbr->base.max_vertex_buffer_bytes = SP_MAX_THREADED_VBUF_SIZE;
+   }
+   else {
+      cvbr->base.max_indices = SP_MAX_VBUF_INDEXES;
+      cvbr->base.max_vertex_buffer_bytes = SP_MAX_VBUF_SIZE;
+   }
 
    cvbr->base.get_vertex_info = sp_vbuf_get_vertex_info;
    cvbr->base.allocate_vertices = sp_vbuf_allocate_vertices;
@@ -667,7 +743,7 @@ sp_create_vbuf_backend(struct softpipe_context *sp)
 
    cvbr->softpipe = sp;
 
-   cvbr->setup = sp_setup_create_context(cvbr->softpipe);
+   cvbr->setup = sp_setup_create_context(cvbr->softpipe, &sp->quad);
 
    return &cvbr->base;
 }
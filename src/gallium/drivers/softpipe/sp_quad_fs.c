@@ -63,11 +63,10 @@ static inline boolean
 shade_quad(struct quad_stage *qs, struct quad_header *quad)
 {
    struct softpipe_context *softpipe = qs->softpipe;
-   struct tgsi_exec_machine *machine = softpipe->fs_machine;
+   struct tgsi_exec_machine *machine = qs->qp->fs_machine;
 
    if (softpipe->active_statistics_queries) {
-      softpipe->pipeline_statistics.ps_invocations +=
-         util_bitcount(quad->inout.mask);         
+      *qs->qp->ps_invocations += util_bitcount(quad->inout.mask);
    }
 
    /* run shader */
@@ -106,7 +105,7 @@ shade_quads(struct quad_stage *qs,
             unsigned nr)
 {
    struct softpipe_context *softpipe = qs->softpipe;
-   struct tgsi_exec_machine *machine = softpipe->fs_machine;
+   struct tgsi_exec_machine *machine = qs->qp->fs_machine;
    unsigned i, nr_quads = 0;
 
    tgsi_exec_set_constant_buffers(machine, PIPE_MAX_CONSTANT_BUFFERS,
@@ -32,15 +32,15 @@
 
 
 static void
-insert_stage_at_head(struct softpipe_context *sp, struct quad_stage *quad)
+insert_stage_at_head(struct sp_quad_pipe *qp, struct quad_stage *quad)
 {
-   quad->next = sp->quad.first;
-   sp->quad.first = quad;
+   quad->next = qp->first;
+   qp->first = quad;
 }
 
 
 void
-sp_build_quad_pipeline(struct softpipe_context *sp)
+sp_build_quad_pipeline(struct softpipe_context *sp, struct sp_quad_pipe *qp)
 {
    boolean early_depth_test =
       (sp->depth_stencil->depth.enabled &&
@@ -51,21 +51,61 @@ sp_build_quad_pipeline(struct softpipe_context *sp)
        !sp->fs_variant->info.writes_stencil) ||
       sp->fs_variant->info.properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL];
 
-   sp->quad.first = sp->quad.blend;
+   qp->first = qp->blend;
 
    sp->early_depth = early_depth_test;
    if (early_depth_test) {
-      insert_stage_at_head( sp, sp->quad.shade );
-      insert_stage_at_head( sp, sp->quad.depth_test );
+      insert_stage_at_head( qp, qp->shade );
+      insert_stage_at_head( qp, qp->depth_test );
    }
    else {
-      insert_stage_at_head( sp, sp->quad.depth_test );
-      insert_stage_at_head( sp, sp->quad.shade );
+      insert_stage_at_head( qp, qp->depth_test );
+      insert_stage_at_head( qp, qp->shade );
    }
 
 #if !DO_PSTIPPLE_IN_DRAW_MODULE && !DO_PSTIPPLE_IN_HELPER_MODULE
    if (sp->rasterizer->poly_stipple_enable)
-      insert_stage_at_head( sp, sp->quad.pstipple );
+      insert_stage_at_head( qp, qp->pstipple );
 #endif
 }
 
+
+/**
+ * Create the stages of a quad pipeline.  The machine, caches and counters
+ * they use are up to the caller.
+ */
+boolean
+sp_create_quad_pipe(struct softpipe_context *sp, struct sp_quad_pipe *qp)
+{
+   qp->shade = sp_quad_shade_stage(sp);
+   qp->depth_test = sp_quad_depth_test_stage(sp);
+   qp->blend = sp_quad_blend_stage(sp);
+   qp->pstipple = sp_quad_polygon_stipple_stage(sp);
+
+   if (!qp->shade || !qp->depth_test || !qp->blend || !qp->pstipple)
+      return FALSE;
+
+   qp->shade->qp = qp;
+   qp->depth_test->qp = qp;
+   qp->blend->qp = qp;
+   qp->pstipple->qp = qp;
+
+   return TRUE;
+}
+
+
+void
+sp_destroy_quad_pipe(struct sp_quad_pipe *qp)
+{
+   if (qp->shade)
+      qp->shade->destroy( qp->shade );
+
+   if (qp->depth_test)
+      qp->depth_test->destroy( qp->depth_test );
+
+   if (qp->blend)
+      qp->blend->destroy( qp->blend );
+
+   if (qp->pstipple)
+      qp->pstipple->destroy( qp->pstipple );
+}
@@ -31,9 +31,14 @@
 #ifndef SP_QUAD_PIPE_H
 #define SP_QUAD_PIPE_H
 
+#include "pipe/p_state.h"
+
 
 struct softpipe_context;
+struct softpipe_tile_cache;
+struct tgsi_exec_machine;
 struct quad_header;
+struct sp_quad_pipe;
 
 
 /**
@@ -43,6 +48,7 @@ struct quad_header;
  */
 struct quad_stage {
    struct softpipe_context *softpipe;
+   struct sp_quad_pipe *qp;  /**< the pipeline this stage is part of */
 
    struct quad_stage *next;
 
@@ -55,6 +61,28 @@ struct quad_stage {
 };
 
 
+/**
+ * A quad pipeline, and the interpreter and surface caches its stages
+ * render with.  The context has one; with SOFTPIPE_NUM_THREADS each
+ * rasterizer thread has another (see sp_rast_threads.c).
+ */
+struct sp_quad_pipe {
+   struct quad_stage *shade;
+   struct quad_stage *depth_test;
+   struct quad_stage *blend;
+   struct quad_stage *pstipple;
+   struct quad_stage *first; /**< points to one of the above stages */
+
+   struct tgsi_exec_machine *fs_machine;
+   struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
+   struct softpipe_tile_cache *zsbuf_cache;
+
+   /** Where the stages count fragments, for queries */
+   uint64_t *occlusion_count;
+   uint64_t *ps_invocations;
+};
+
+
 struct quad_stage *sp_quad_polygon_stipple_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_earlyz_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_shade_stage( struct softpipe_context *softpipe );
@@ -67,6 +95,11 @@ struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_colormask_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_output_stage( struct softpipe_context *softpipe );
 
-void sp_build_quad_pipeline(struct softpipe_context *sp);
+boolean sp_create_quad_pipe(struct softpipe_context *sp,
+                            struct sp_quad_pipe *qp);
+void sp_destroy_quad_pipe(struct sp_quad_pipe *qp);
+
+void sp_build_quad_pipeline(struct softpipe_context *sp,
+                            struct sp_quad_pipe *qp);
 
 #endif /* SP_QUAD_PIPE_H */
@@ -0,0 +1,477 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Rasterizer threads.
+ *
+ * With SOFTPIPE_NUM_THREADS=n the framebuffer is split into rows of tiles
+ * (TILE_SIZE pixels high), and row number r belongs to band r % n.  Each
+ * band is rendered by its own thread, with its own setup context, quad
+ * pipeline, interpreter, and surface and texture caches.  The thread
+ * issuing the draw renders band 0 with the context's own ones.
+ *
+ * Every thread sets up every primitive of a batch, but only walks the
+ * spans, and shades the quads, of its own rows.  Quads never straddle
+ * tile rows, and each thread sees the primitives in order, so the result
+ * is the same as rendering on a single thread.
+ *
+ * A thread's surface caches only ever hold tiles of its band, so the
+ * caches can't get in each other's way.  That doesn't hold for the
+ * context's caches when they render everything (after a clear, or for a
+ * fragment shader storing to memory), so they are written back before
+ * rendering in bands again, and the threads' caches are written back
+ * before the context's are used for everything.
+ */
+
+#include "util/u_memory.h"
+#include "util/u_queue.h"
+#include "tgsi/tgsi_exec.h"
+#include "sp_context.h"
+#include "sp_rast_threads.h"
+#include "sp_setup.h"
+#include "sp_state.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_texture.h"
+#include "sp_tile_cache.h"
+
+
+struct sp_rast_thread
+{
+   struct setup_context *setup;
+   struct sp_quad_pipe quad;
+
+   /** Fragment shader sampler, with texture caches of this thread's own */
+   struct sp_tgsi_sampler *sampler;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   unsigned num_sampler_views;
+
+   /** The variant prepared for quad.fs_machine */
+   const struct sp_fragment_shader_variant *fs_variant;
+
+   /** Counted by the quad stages, added to the context's after each batch */
+   uint64_t occlusion_count;
+   uint64_t ps_invocations;
+
+   sp_rast_func func;
+   void *data;
+   struct util_queue_fence fence;
+};
+
+
+struct sp_rast_threads
+{
+   struct util_queue queue;
+
+   /** Threads rendering bands 1 .. num_threads */
+   struct sp_rast_thread *threads[SP_MAX_THREADS - 1];
+   unsigned num_threads;
+
+   /** Whether the current state can be rendered in bands */
+   boolean banded;
+
+   /** Whether the threads' surface caches may hold tiles */
+   boolean thread_tiles;
+
+   /** Whether the context's surface caches may hold tiles (or pending
+    * clears) outside of band 0
+    */
+   boolean context_tiles;
+};
+
+
+static void
+destroy_thread(struct sp_rast_thread *t)
+{
+   unsigned i;
+
+   if (t->setup)
+      sp_setup_destroy_context(t->setup);
+
+   sp_destroy_quad_pipe(&t->quad);
+   tgsi_exec_machine_destroy(t->quad.fs_machine);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp_destroy_tile_cache(t->quad.cbuf_cache[i]);
+   sp_destroy_tile_cache(t->quad.zsbuf_cache);
+
+   for (i = 0; i < ARRAY_SIZE(t->tex_cache); i++) {
+      if (t->tex_cache[i]) {
+         sp_tex_tile_cache_set_sampler_view(t->tex_cache[i], NULL);
+         sp_destroy_tex_tile_cache(t->tex_cache[i]);
+      }
+   }
+
+   FREE(t->sampler);
+   util_queue_fence_destroy(&t->fence);
+   FREE(t);
+}
+
+
+static struct sp_rast_thread *
+create_thread(struct softpipe_context *sp)
+{
+   struct sp_rast_thread *t = CALLOC_STRUCT(sp_rast_thread);
+   unsigned i;
+
+   if (!t)
+      return NULL;
+
+   util_queue_fence_init(&t->fence);
+
+   if (!sp_create_quad_pipe(sp, &t->quad))
+      goto fail;
+
+   t->quad.fs_machine = tgsi_exec_machine_create(PIPE_SHADER_FRAGMENT);
+   if (!t->quad.fs_machine)
+      goto fail;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      t->quad.cbuf_cache[i] = sp_create_tile_cache(&sp->pipe);
+      if (!t->quad.cbuf_cache[i])
+         goto fail;
+   }
+   t->quad.zsbuf_cache = sp_create_tile_cache(&sp->pipe);
+   if (!t->quad.zsbuf_cache)
+      goto fail;
+
+   t->quad.occlusion_count = &t->occlusion_count;
+   t->quad.ps_invocations = &t->ps_invocations;
+
+   t->sampler = sp_create_tgsi_sampler();
+   if (!t->sampler)
+      goto fail;
+
+   t->setup = sp_setup_create_context(sp, &t->quad);
+   if (!t->setup)
+      goto fail;
+
+   return t;
+
+fail:
+   destroy_thread(t);
+   return NULL;
+}
+
+
+/**
+ * Start num_threads - 1 rasterizer threads, the thread issuing the draws
+ * being the remaining one.  Leaves sp->rast_threads NULL if that doesn't
+ * come to at least two.
+ */
+void
+sp_create_rast_threads(struct softpipe_context *sp, unsigned num_threads)
+{
+   struct sp_rast_threads *rt;
+   unsigned i;
+
+   num_threads = MIN2(num_threads, SP_MAX_THREADS);
+   if (num_threads < 2)
+      return;
+
+   rt = CALLOC_STRUCT(sp_rast_threads);
+   if (!rt)
+      return;
+
+   sp->rast_threads = rt;
+
+   if (!util_queue_init(&rt->queue, "sprast", num_threads,
+                        num_threads - 1, 0)) {
+      sp_destroy_rast_threads(sp);
+      return;
+   }
+
+   for (i = 0; i < num_threads - 1; i++) {
+      rt->threads[i] = create_thread(sp);
+      if (!rt->threads[i])
+         break;
+   }
+   rt->num_threads = i;
+
+   if (!rt->num_threads) {
+      sp_destroy_rast_threads(sp);
+      return;
+   }
+
+   for (i = 0; i < rt->num_threads; i++)
+      sp_setup_set_band(rt->threads[i]->setup, i + 1, rt->num_threads + 1);
+
+   sp_rast_threads_set_framebuffer(sp);
+}
+
+
+void
+sp_destroy_rast_threads(struct softpipe_context *sp)
+{
+   struct sp_rast_threads *rt = sp->rast_threads;
+   unsigned i;
+
+   if (!rt)
+      return;
+
+   if (util_queue_is_initialized(&rt->queue))
+      util_queue_destroy(&rt->queue);
+
+   for (i = 0; i < rt->num_threads; i++)
+      destroy_thread(rt->threads[i]);
+
+   FREE(rt);
+   sp->rast_threads = NULL;
+}
+
+
+/**
+ * Point a thread's fragment sampler at the context's sampler states and
+ * views, through texture caches of its own.
+ * \return FALSE if out of memory
+ */
+static boolean
+update_samplers(struct softpipe_context *sp, struct sp_rast_thread *t)
+{
+   const struct sp_tgsi_sampler *src = sp->tgsi.sampler[PIPE_SHADER_FRAGMENT];
+   const unsigned num = sp->num_sampler_views[PIPE_SHADER_FRAGMENT];
+   unsigned i;
+
+   memcpy(t->sampler->sp_sampler, src->sp_sampler,
+          sizeof(t->sampler->sp_sampler));
+
+   for (i = 0; i < MAX2(num, t->num_sampler_views); i++) {
+      struct pipe_sampler_view *view =
+         i < num ? sp->sampler_views[PIPE_SHADER_FRAGMENT][i] : NULL;
+      struct softpipe_tex_tile_cache *tc = t->tex_cache[i];
+
+      if (!tc) {
+         if (!view)
+            continue;
+
+         tc = sp_create_tex_tile_cache(&sp->pipe);
+         if (!tc)
+            return FALSE;
+         t->tex_cache[i] = tc;
+      }
+
+      sp_tex_tile_cache_set_sampler_view(tc, view);
+
+      if (tc->texture) {
+         struct softpipe_resource *spt = softpipe_resource(tc->texture);
+         if (spt->timestamp != tc->timestamp) {
+            sp_tex_tile_cache_validate_texture(tc);
+            tc->timestamp = spt->timestamp;
+         }
+      }
+
+      t->sampler->sp_sview[i] = src->sp_sview[i];
+      t->sampler->sp_sview[i].cache = tc;
+   }
+
+   t->num_sampler_views = num;
+
+   return TRUE;
+}
+
+
+/**
+ * Called after sp_setup_prepare(), to get the threads ready for a new
+ * batch of primitives.
+ */
+void
+sp_rast_threads_prepare(struct softpipe_context *sp)
+{
+   struct sp_rast_threads *rt = sp->rast_threads;
+   unsigned i;
+
+   /* Stores to images and buffers from several threads would race, and a
+    * framebuffer of one row of tiles has nothing to split.
+    */
+   rt->banded = !sp->fs_variant->info.writes_memory &&
+                sp->framebuffer.height > TILE_SIZE;
+   if (!rt->banded)
+      return;
+
+   for (i = 0; i < rt->num_threads; i++) {
+      struct sp_rast_thread *t = rt->threads[i];
+
+      if (!update_samplers(sp, t)) {
+         rt->banded = FALSE;
+         return;
+      }
+
+      if (t->fs_variant != sp->fs_variant) {
+         sp->fs_variant->prepare(sp->fs_variant,
+                                 t->quad.fs_machine,
+                                 (struct tgsi_sampler *) t->sampler,
+                                 (struct tgsi_image *)
+                                    sp->tgsi.image[PIPE_SHADER_FRAGMENT],
+                                 (struct tgsi_buffer *)
+                                    sp->tgsi.buffer[PIPE_SHADER_FRAGMENT]);
+         t->fs_variant = sp->fs_variant;
+      }
+
+      sp_build_quad_pipeline(sp, &t->quad);
+      sp_setup_prepare(t->setup);
+   }
+}
+
+
+static void
+rast_thread_execute(void *data, int thread_index)
+{
+   struct sp_rast_thread *t = (struct sp_rast_thread *) data;
+
+   t->func(t->setup, t->data);
+}
+
+
+/**
+ * Render a batch of primitives: func is called with the given setup context
+ * on this thread, and with each rasterizer thread's own on that thread.
+ */
+void
+sp_rast_threads_run(struct softpipe_context *sp,
+                    struct setup_context *setup,
+                    sp_rast_func func, void *data)
+{
+   struct sp_rast_threads *rt = sp->rast_threads;
+   unsigned i;
+
+   if (!rt->banded) {
+      sp_rast_threads_flush(sp, FALSE);
+      func(setup, data);
+      return;
+   }
+
+   if (rt->context_tiles) {
+      for (i = 0; i < sp->framebuffer.nr_cbufs; i++)
+         sp_flush_tile_cache(sp->cbuf_cache[i]);
+      sp_flush_tile_cache(sp->zsbuf_cache);
+      rt->context_tiles = FALSE;
+   }
+
+   for (i = 0; i < rt->num_threads; i++) {
+      struct sp_rast_thread *t = rt->threads[i];
+
+      t->func = func;
+      t->data = data;
+      util_queue_add_job(&rt->queue, t, &t->fence, rast_thread_execute, NULL);
+   }
+
+   sp_setup_set_band(setup, 0, rt->num_threads + 1);
+   func(setup, data);
+   sp_setup_set_band(setup, 0, 1);
+
+   for (i = 0; i < rt->num_threads; i++) {
+      struct sp_rast_thread *t = rt->threads[i];
+
+      util_queue_fence_wait(&t->fence);
+
+      sp->occlusion_count += t->occlusion_count;
+      sp->pipeline_statistics.ps_invocations += t->ps_invocations;
+      t->occlusion_count = 0;
+      t->ps_invocations = 0;
+   }
+
+   rt->thread_tiles = TRUE;
+}
+
+
+/**
+ * Write back the tiles the threads have cached, before the context's own
+ * surface caches get used for the whole framebuffer, or the framebuffer is
+ * read.  With tex_caches, also forget the threads' cached texture tiles.
+ */
+void
+sp_rast_threads_flush(struct softpipe_context *sp, boolean tex_caches)
+{
+   struct sp_rast_threads *rt = sp->rast_threads;
+   unsigned i, j;
+
+   for (i = 0; i < rt->num_threads; i++) {
+      struct sp_rast_thread *t = rt->threads[i];
+
+      if (rt->thread_tiles) {
+         for (j = 0; j < sp->framebuffer.nr_cbufs; j++)
+            sp_flush_tile_cache(t->quad.cbuf_cache[j]);
+         sp_flush_tile_cache(t->quad.zsbuf_cache);
+      }
+
+      if (tex_caches) {
+         for (j = 0; j < t->num_sampler_views; j++) {
+            if (t->tex_cache[j])
+               sp_flush_tex_tile_cache(t->tex_cache[j]);
+         }
+      }
+   }
+
+   rt->thread_tiles = FALSE;
+   rt->context_tiles = TRUE;
+}
+
+
+/**
+ * Point the threads' surface caches at the context's framebuffer.  They
+ * must have been flushed before it changed.
+ */
+void
+sp_rast_threads_set_framebuffer(struct softpipe_context *sp)
+{
+   struct sp_rast_threads *rt = sp->rast_threads;
+   unsigned i, j;
+
+   assert(!rt->thread_tiles);
+
+   for (i = 0; i < rt->num_threads; i++) {
+      struct sp_rast_thread *t = rt->threads[i];
+
+      for (j = 0; j < PIPE_MAX_COLOR_BUFS; j++)
+         sp_tile_cache_set_surface(t->quad.cbuf_cache[j],
+                                   sp->framebuffer.cbufs[j]);
+      sp_tile_cache_set_surface(t->quad.zsbuf_cache, sp->framebuffer.zsbuf);
+   }
+}
+
+
+/**
+ * Called before a fragment shader variant gets deleted.
+ */
+void
+sp_rast_threads_release_variant(struct softpipe_context *sp,
+                                struct sp_fragment_shader_variant *var)
+{
+   struct sp_rast_threads *rt = sp->rast_threads;
+   unsigned i;
+
+   for (i = 0; i < rt->num_threads; i++) {
+      struct sp_rast_thread *t = rt->threads[i];
+
+      if (t->fs_variant == var) {
+         tgsi_exec_machine_bind_shader(t->quad.fs_machine,
+                                       NULL, NULL, NULL, NULL);
+         t->fs_variant = NULL;
+      }
+   }
+}
@@ -0,0 +1,77 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Rasterizer threads: with SOFTPIPE_NUM_THREADS=n each batch of primitives
+ * is set up by n threads, each of which renders only every n'th row of
+ * tiles (see sp_tile_cache.h) with its own quad pipeline, interpreter and
+ * surface and texture caches.
+ */
+
+#ifndef SP_RAST_THREADS_H
+#define SP_RAST_THREADS_H
+
+
+#include "pipe/p_compiler.h"
+
+
+struct softpipe_context;
+struct sp_fragment_shader_variant;
+struct setup_context;
+
+
+/** Sets up and renders a batch of primitives with the given context */
+typedef void (*sp_rast_func)(struct setup_context *setup, void *data);
+
+
+void
+sp_create_rast_threads(struct softpipe_context *sp, unsigned num_threads);
+
+void
+sp_destroy_rast_threads(struct softpipe_context *sp);
+
+void
+sp_rast_threads_prepare(struct softpipe_context *sp);
+
+void
+sp_rast_threads_run(struct softpipe_context *sp,
+                    struct setup_context *setup,
+                    sp_rast_func func, void *data);
+
+void
+sp_rast_threads_flush(struct softpipe_context *sp, boolean tex_caches);
+
+void
+sp_rast_threads_set_framebuffer(struct softpipe_context *sp);
+
+void
+sp_rast_threads_release_variant(struct softpipe_context *sp,
+                                struct sp_fragment_shader_variant *var);
+
+
+#endif /* SP_RAST_THREADS_H */
@@ -37,6 +37,7 @@
 #include "sp_quad_pipe.h"
 #include "sp_setup.h"
 #include "sp_state.h"
+#include "sp_tile_cache.h"
 #include "draw/draw_context.h"
 #include "pipe/p_shader_tokens.h"
 #include "util/u_math.h"
@@ -73,6 +74,14 @@ struct edge {
  */
 struct setup_context {
    struct softpipe_context *softpipe;
+   struct sp_quad_pipe *pipeline;  /**< where quads go */
+
+   /**
+    * With rasterizer threads, each renders every num_bands'th row of tiles,
+    * starting at row number band.
+    */
+   unsigned band;
+   unsigned num_bands;
 
    /* Vertices are just an array of floats making up each attribute in
     * turn.  Currently fixed at 4 floats, but should change in time.
@@ -121,6 +130,17 @@ struct setup_context {
 
 
 
+/**
+ * Is pixel row y in one of the rows of tiles we render?
+ */
+static inline boolean
+setup_owns_row(const struct setup_context *setup, int y)
+{
+   return setup->num_bands == 1 ||
+          ((unsigned) y >> TILE_SIZE_LOG2) % setup->num_bands == setup->band;
+}
+
+
 /**
  * Clip setup->quad against the scissor/surface bounds.
  */
@@ -161,14 +181,14 @@ clip_emit_quad(struct setup_context *setup, struct quad_header *quad)
 {
    quad_clip(setup, quad);
 
-   if (quad->inout.mask) {
-      struct softpipe_context *sp = setup->softpipe;
+   if (quad->inout.mask && setup_owns_row(setup, quad->input.y0)) {
+      struct quad_stage *pipe = setup->pipeline->first;
 
 #if DEBUG_FRAGS
       setup->numFragsEmitted += util_bitcount(quad->inout.mask);
 #endif
 
-      sp->quad.first->run( sp->quad.first, &quad, 1 );
+      pipe->run( pipe, &quad, 1 );
    }
 }
 
@@ -203,7 +223,7 @@ flush_spans(struct setup_context *setup)
    const int xleft1 = setup->span.left[1];
    const int xright0 = setup->span.right[0];
    const int xright1 = setup->span.right[1];
-   struct quad_stage *pipe = setup->softpipe->quad.first;
+   struct quad_stage *pipe = setup->pipeline->first;
 
    const int minleft = block_x(MIN2(xleft0, xleft1));
    const int maxright = MAX2(xright0, xright1);
@@ -741,6 +761,10 @@ subtriangle(struct setup_context *setup,
    */
 
    for (y = start_y; y < finish_y; y++) {
+      int left, right;
+
+      if (!setup_owns_row(setup, sy + y))
+         continue;
 
       /* avoid accumulating adds as floats don't have the precision to
        * accurately iterate large triangle edges that way.  luckily we
@@ -748,8 +772,8 @@ subtriangle(struct setup_context *setup,
        *
        * this is all drowned out by the attribute interpolation anyway.
        */
-      int left = (int)(eleft->sx + y * eleft->dxdy);
-      int right = (int)(eright->sx + y * eright->dxdy);
+      left = (int)(eleft->sx + y * eleft->dxdy);
+      right = (int)(eright->sx + y * eright->dxdy);
 
       /* clip left/right */
       if (left < minx)
@@ -873,7 +897,8 @@ sp_setup_tri(struct setup_context *setup,
 
    flush_spans( setup );
 
-   if (setup->softpipe->active_statistics_queries) {
+   /* every rasterizer thread sets up every triangle, count it once */
+   if (setup->softpipe->active_statistics_queries && setup->band == 0) {
       setup->softpipe->pipeline_statistics.c_primitives++;
    }
 
@@ -1478,7 +1503,7 @@ sp_setup_prepare(struct setup_context *setup)
 
    setup->max_layer = max_layer;
 
-   sp->quad.first->begin( sp->quad.first );
+   setup->pipeline->first->begin( setup->pipeline->first );
 
    if (sp->reduced_api_prim == PIPE_PRIM_TRIANGLES &&
        sp->rasterizer->fill_front == PIPE_POLYGON_MODE_FILL &&
@@ -1504,12 +1529,16 @@ sp_setup_destroy_context(struct setup_context *setup)
  * Create a new primitive setup/render stage.
  */
 struct setup_context *
-sp_setup_create_context(struct softpipe_context *softpipe)
+sp_setup_create_context(struct softpipe_context *softpipe,
+                        struct sp_quad_pipe *pipeline)
 {
    struct setup_context *setup = CALLOC_STRUCT(setup_context);
    unsigned i;
 
    setup->softpipe = softpipe;
+   setup->pipeline = pipeline;
+   setup->band = 0;
+   setup->num_bands = 1;
 
    for (i = 0; i < MAX_QUADS; i++) {
       setup->quad[i].coef = setup->coef;
@@ -1521,3 +1550,18 @@ sp_setup_create_context(struct softpipe_context *softpipe)
 
    return setup;
 }
+
+
+/**
+ * Restrict rendering to every num_bands'th row of tiles, starting at row
+ * number band.  num_bands = 1 renders everything.
+ */
+void
+sp_setup_set_band(struct setup_context *setup,
+                  unsigned band, unsigned num_bands)
+{
+   assert(band < num_bands);
+
+   setup->band = band;
+   setup->num_bands = num_bands;
+}
@@ -29,6 +29,7 @@
 
 struct setup_context;
 struct softpipe_context;
+struct sp_quad_pipe;
 
 /**
  * Attribute interpolation mode
@@ -70,8 +71,12 @@ sp_clamp_viewport_idx(int idx)
    return (PIPE_MAX_VIEWPORTS > idx && idx >= 0) ? idx : 0;
 }
 
-struct setup_context *sp_setup_create_context( struct softpipe_context *softpipe );
+struct setup_context *sp_setup_create_context( struct softpipe_context *softpipe,
+                                              struct sp_quad_pipe *pipeline );
 void sp_setup_prepare( struct setup_context *setup );
 void sp_setup_destroy_context( struct setup_context *setup );
 
+void sp_setup_set_band( struct setup_context *setup,
+                        unsigned band, unsigned num_bands );
+
 #endif
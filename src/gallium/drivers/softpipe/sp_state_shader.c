@@ -28,6 +28,7 @@
 #include "sp_context.h"
 #include "sp_state.h"
 #include "sp_fs.h"
+#include "sp_rast_threads.h"
 #include "sp_texture.h"
 
 #include "pipe/p_defines.h"
@@ -190,6 +191,9 @@ softpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
       draw_delete_fragment_shader(softpipe->draw, var->draw_shader);
 #endif
 
+      if (softpipe->rast_threads)
+         sp_rast_threads_release_variant(softpipe, var);
+
       var->delete(var, softpipe->fs_machine);
    }
 
@@ -29,6 +29,7 @@
  */
 
 #include "sp_context.h"
+#include "sp_rast_threads.h"
 #include "sp_state.h"
 #include "sp_tile_cache.h"
 
@@ -53,6 +54,9 @@ softpipe_set_framebuffer_state(struct pipe_context *pipe,
 
    draw_flush(sp->draw);
 
+   if (sp->rast_threads)
+      sp_rast_threads_flush(sp, FALSE);
+
    for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
       struct pipe_surface *cb = i < fb->nr_cbufs ? fb->cbufs[i] : NULL;
 
@@ -97,5 +101,8 @@ softpipe_set_framebuffer_state(struct pipe_context *pipe,
    sp->framebuffer.samples = fb->samples;
    sp->framebuffer.layers = fb->layers;
 
+   if (sp->rast_threads)
+      sp_rast_threads_set_framebuffer(sp);
+
    sp->dirty |= SP_NEW_FRAMEBUFFER;
 }
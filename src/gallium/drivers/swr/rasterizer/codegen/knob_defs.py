@@ -71,6 +71,16 @@ KNOBS = [
         'category'  : 'perf',
     }],
 
+    ['NUMA_HUGE_PAGES', {
+        'type'      : 'bool',
+        'default'   : 'false',
+        'desc'      : ['Allocate hot tiles on the NUMA-node of the workers owning their',
+                       'macrotile, and draw arena blocks on the node of the thread',
+                       'allocating them, carved from 2MB (huge / large) pages.',
+                       'Large pages on Windows need the SeLockMemoryPrivilege.'],
+        'category'  : 'perf',
+    }],
+
     ['MAX_CORES_PER_NUMA_NODE', {
         'type'      : 'uint32_t',
         'default'   : '0',
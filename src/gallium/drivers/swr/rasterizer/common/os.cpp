@@ -32,6 +32,8 @@
 
 #if defined(__APPLE__) || defined(FORCE_LINUX) || defined(__linux__) || defined(__gnu_linux__)
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #endif // Linux
 
 #if defined(_WIN32)
@@ -152,6 +154,127 @@ void SWR_API CreateDirectoryPath(const std::string& path)
 #endif // Unix
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief Allocate pages on a NUMA node, backed by large pages.  Both are
+///        only hints, the memory comes from wherever the OS finds it if they
+///        can't be honored.
+/// @param size - bytes to allocate, a multiple of SWR_LARGE_PAGE_SIZE if
+///        largePages is set
+/// @param numaNode - node to place the pages on, or SWR_ANY_NUMA_NODE
+/// @returns the pages or nullptr, free with FreeNumaPages
+void* SWR_API AllocNumaPages(size_t size, uint32_t numaNode, bool largePages)
+{
+#if defined(_WIN32)
+    const DWORD  type     = MEM_RESERVE | MEM_COMMIT;
+    const SIZE_T minLarge = GetLargePageMinimum();
+    void*        p        = nullptr;
+
+    if (numaNode == SWR_ANY_NUMA_NODE)
+    {
+        numaNode = NUMA_NO_PREFERRED_NODE;
+    }
+
+    // Needs SeLockMemoryPrivilege, which most processes don't have
+    if (largePages && minLarge && (size % minLarge) == 0)
+    {
+        p = VirtualAllocExNuma(
+            GetCurrentProcess(), nullptr, size, type | MEM_LARGE_PAGES, PAGE_READWRITE, numaNode);
+    }
+
+    if (!p)
+    {
+        p = VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, type, PAGE_READWRITE, numaNode);
+    }
+
+    return p;
+#elif defined(FORCE_LINUX) || defined(__linux__) || defined(__gnu_linux__)
+    // Transparent huge pages only back 2MB aligned ranges, so map a bit more
+    // and trim the mapping to an aligned one.
+    const size_t align   = largePages ? SWR_LARGE_PAGE_SIZE : 0;
+    const size_t mapSize = size + align;
+
+    uint8_t* pMap = (uint8_t*)mmap(
+        nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pMap == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    uint8_t* p = pMap;
+    if (align)
+    {
+        p = (uint8_t*)(((uintptr_t)pMap + align - 1) & ~(uintptr_t)(align - 1));
+        if (p != pMap)
+        {
+            munmap(pMap, p - pMap);
+        }
+        if (p + size != pMap + mapSize)
+        {
+            munmap(p + size, (pMap + mapSize) - (p + size));
+        }
+#if defined(MADV_HUGEPAGE)
+        madvise(p, size, MADV_HUGEPAGE);
+#endif
+    }
+
+#if defined(SYS_mbind)
+    if (numaNode != SWR_ANY_NUMA_NODE && numaNode < sizeof(unsigned long) * 8)
+    {
+        // MPOL_PREFERRED: fall back to other nodes when this one is full.
+        // Fails harmlessly on kernels without NUMA support.
+        const int     mpolPreferred = 1;
+        unsigned long nodeMask      = 1UL << numaNode;
+        syscall(SYS_mbind, p, size, mpolPreferred, &nodeMask, sizeof(nodeMask) * 8 + 1, 0);
+    }
+#endif
+
+    return p;
+#else
+    return AlignedMalloc(size, largePages ? SWR_LARGE_PAGE_SIZE : 4096);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Free pages returned by AllocNumaPages.
+void SWR_API FreeNumaPages(void* p, size_t size)
+{
+#if defined(_WIN32)
+    VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(FORCE_LINUX) || defined(__linux__) || defined(__gnu_linux__)
+    munmap(p, size);
+#else
+    AlignedFree(p);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief NUMA node of the processor the calling thread runs on, 0 if
+///        that can't be determined.
+uint32_t SWR_API GetCurrentNumaNode()
+{
+#if defined(_WIN32)
+    PROCESSOR_NUMBER procNum;
+    USHORT           numaId = 0;
+
+    GetCurrentProcessorNumberEx(&procNum);
+    if (!GetNumaProcessorNodeEx(&procNum, &numaId))
+    {
+        return 0;
+    }
+    return numaId;
+#elif (defined(FORCE_LINUX) || defined(__linux__) || defined(__gnu_linux__)) && defined(SYS_getcpu)
+    unsigned cpu = 0, node = 0;
+
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+    {
+        return 0;
+    }
+    return node;
+#else
+    return 0;
+#endif
+}
+
 /// Execute Command (block until finished)
 /// @returns process exit value
 int SWR_API ExecCmd(const std::string& cmd,     ///< (In) Command line string
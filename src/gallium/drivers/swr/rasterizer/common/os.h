@@ -274,6 +274,13 @@ typedef MEGABYTE GIGABYTE[1024];
 void SWR_API SetCurrentThreadName(const char* pThreadName);
 void SWR_API CreateDirectoryPath(const std::string& path);
 
+#define SWR_LARGE_PAGE_SIZE (2 * 1024 * 1024)
+#define SWR_ANY_NUMA_NODE uint32_t(-1)
+
+void* SWR_API AllocNumaPages(size_t size, uint32_t numaNode, bool largePages);
+void SWR_API FreeNumaPages(void* p, size_t size);
+uint32_t SWR_API GetCurrentNumaNode();
+
 /// Execute Command (block until finished)
 /// @returns process exit value
 int SWR_API
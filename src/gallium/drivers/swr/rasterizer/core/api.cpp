@@ -80,6 +80,12 @@ HANDLE SwrCreateContext(SWR_CREATECONTEXT_INFO* pCreateInfo)
         pContext->MAX_DRAWS_IN_FLIGHT = pCreateInfo->MAX_DRAWS_IN_FLIGHT;
     }
 
+    if (KNOB_NUMA_HUGE_PAGES)
+    {
+        pContext->pNumaAllocator = new NumaAllocator();
+        pContext->cachingArenaAllocator.SetNumaAllocator(pContext->pNumaAllocator);
+    }
+
     pContext->dcRing.Init(pContext->MAX_DRAWS_IN_FLIGHT);
     pContext->dsRing.Init(pContext->MAX_DRAWS_IN_FLIGHT);
 
@@ -190,7 +196,7 @@ HANDLE SwrCreateContext(SWR_CREATECONTEXT_INFO* pCreateInfo)
     SetupDefaultState(pContext);
 
     // initialize hot tile manager
-    pContext->pHotTileMgr = new HotTileMgr();
+    pContext->pHotTileMgr = new HotTileMgr(pContext->pNumaAllocator);
 
     // initialize callback functions
     pContext->pfnLoadTile            = pCreateInfo->pfnLoadTile;
@@ -447,8 +453,13 @@ void SwrDestroyContext(HANDLE hContext)
     delete pContext->pHotTileMgr;
     delete pContext->pSingleThreadLockedTiles;
 
+    // The caching arena allocator hands its blocks back on destruction
+    NumaAllocator* pNumaAllocator = pContext->pNumaAllocator;
+
     pContext->~SWR_CONTEXT();
     AlignedFree(GetContext(hContext));
+
+    delete pNumaAllocator;
 }
 
 void SwrBindApiThread(HANDLE hContext, uint32_t apiThreadId)
@@ -36,6 +36,7 @@
 #include <algorithm>
 #include <atomic>
 #include "core/utils.h"
+#include "core/numa_alloc.h"
 
 static const size_t ARENA_BLOCK_ALIGN = 64;
 
@@ -53,7 +54,18 @@ public:
     {
         SWR_ASSUME_ASSERT(size >= sizeof(ArenaBlock));
 
-        ArenaBlock* p = new (AlignedMalloc(size, align)) ArenaBlock();
+        void* pMem;
+        if (m_pNumaAllocator)
+        {
+            SWR_ASSERT(align <= NumaAllocator::MIN_CHUNK_SIZE);
+            pMem = m_pNumaAllocator->Alloc(size);
+        }
+        else
+        {
+            pMem = AlignedMalloc(size, align);
+        }
+
+        ArenaBlock* p = new (pMem) ArenaBlock();
         p->blockSize  = size;
         return p;
     }
@@ -63,9 +75,23 @@ public:
         if (pMem)
         {
             SWR_ASSUME_ASSERT(pMem->blockSize < size_t(0xdddddddd));
-            AlignedFree(pMem);
+            if (m_pNumaAllocator)
+            {
+                m_pNumaAllocator->Free(pMem);
+            }
+            else
+            {
+                AlignedFree(pMem);
+            }
         }
     }
+
+    /// Take blocks from the node of the allocating thread, in large pages.
+    /// Must be set before the first allocation and outlive the allocator.
+    void SetNumaAllocator(NumaAllocator* pNumaAllocator) { m_pNumaAllocator = pNumaAllocator; }
+
+private:
+    NumaAllocator* m_pNumaAllocator = nullptr;
 };
 
 // Caching Allocator for Arena
@@ -542,6 +542,9 @@ struct SWR_CONTEXT
     volatile OSALIGNLINE(uint32_t) drawsOutstandingFE;
 
     OSALIGNLINE(CachingAllocator) cachingArenaAllocator;
+
+    // Backs arena blocks and hot tiles when KNOB_NUMA_HUGE_PAGES is set
+    NumaAllocator* pNumaAllocator;
     uint32_t frameCount;
 
     uint32_t lastFrameChecked;
@@ -0,0 +1,141 @@
+/****************************************************************************
+ * Copyright (C) 2026 agent.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * @file numa_alloc.cpp
+ *
+ * @brief Implementation of the NUMA / large page allocator.
+ *
+ ******************************************************************************/
+#include "core/numa_alloc.h"
+#include "core/utils.h"
+
+static_assert((NumaAllocator::MIN_CHUNK_SIZE << 9) == NumaAllocator::SLAB_SIZE,
+              "Adjust NUM_SIZE_CLASSES");
+
+NumaAllocator::~NumaAllocator()
+{
+    for (auto& slab : m_slabs)
+    {
+        FreeNumaPages((void*)slab.first, slab.second.size);
+    }
+}
+
+uint32_t NumaAllocator::GetSizeClass(size_t size)
+{
+    uint32_t sizeClass = 0;
+    while ((MIN_CHUNK_SIZE << sizeClass) < size)
+    {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Map a new slab and put all of its chunks on the free list.
+///        Called with m_mutex held.
+bool NumaAllocator::AddSlab(uint32_t numaNode, uint32_t sizeClass)
+{
+    uint8_t* pSlab = (uint8_t*)AllocNumaPages(SLAB_SIZE, numaNode, true);
+    if (!pSlab)
+    {
+        return false;
+    }
+
+    m_slabs[(uintptr_t)pSlab] = {SLAB_SIZE, numaNode, sizeClass};
+
+    const size_t chunkSize = MIN_CHUNK_SIZE << sizeClass;
+    FreeChunk*&  pFree     = m_nodes[numaNode].pFree[sizeClass];
+    for (size_t offset = SLAB_SIZE; offset != 0; offset -= chunkSize)
+    {
+        FreeChunk* pChunk = (FreeChunk*)(pSlab + offset - chunkSize);
+        pChunk->pNext     = pFree;
+        pFree             = pChunk;
+    }
+
+    return true;
+}
+
+void* NumaAllocator::Alloc(size_t size, uint32_t numaNode)
+{
+    if (numaNode == LOCAL_NODE)
+    {
+        numaNode = GetCurrentNumaNode();
+    }
+
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    if (size > SLAB_SIZE)
+    {
+        size    = AlignUp(size, SLAB_SIZE);
+        void* p = AllocNumaPages(size, numaNode, true);
+        if (p)
+        {
+            m_slabs[(uintptr_t)p] = {size, numaNode, NUM_SIZE_CLASSES};
+        }
+        return p;
+    }
+
+    if (numaNode >= m_nodes.size())
+    {
+        m_nodes.resize(numaNode + 1);
+    }
+
+    uint32_t    sizeClass = GetSizeClass(size);
+    FreeChunk*& pFree     = m_nodes[numaNode].pFree[sizeClass];
+    if (!pFree && !AddSlab(numaNode, sizeClass))
+    {
+        return nullptr;
+    }
+
+    FreeChunk* pChunk = pFree;
+    pFree             = pChunk->pNext;
+    return pChunk;
+}
+
+void NumaAllocator::Free(void* pMem)
+{
+    if (!pMem)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    // The slab holding the chunk is the last one starting at or before it
+    auto it = m_slabs.upper_bound((uintptr_t)pMem);
+    SWR_ASSERT(it != m_slabs.begin(), "Freeing unknown memory %p", pMem);
+    --it;
+    SWR_ASSERT((uintptr_t)pMem < it->first + it->second.size, "Freeing unknown memory %p", pMem);
+
+    const Slab& slab = it->second;
+    if (slab.sizeClass == NUM_SIZE_CLASSES)
+    {
+        FreeNumaPages(pMem, slab.size);
+        m_slabs.erase(it);
+        return;
+    }
+
+    FreeChunk*& pFree  = m_nodes[slab.numaNode].pFree[slab.sizeClass];
+    FreeChunk*  pChunk = (FreeChunk*)pMem;
+    pChunk->pNext      = pFree;
+    pFree              = pChunk;
+}
@@ -0,0 +1,86 @@
+/****************************************************************************
+ * Copyright (C) 2026 agent.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * @file numa_alloc.h
+ *
+ * @brief Allocator placing memory on a NUMA node, backed by large pages.
+ *
+ ******************************************************************************/
+#pragma once
+
+#include <mutex>
+#include <map>
+#include <vector>
+#include "common/os.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// NumaAllocator
+/// @brief For the big, long lived buffers the workers hammer on: hot tiles
+///        and arena blocks.  Power of two sized chunks are carved out of
+///        2MB slabs, each bound to a NUMA node and backed by a large page
+///        where the OS allows, so a hot tile only takes a fraction of a TLB
+///        entry and lives on the node of the workers owning its macrotile.
+///        Freed chunks are kept for reuse, slabs only go back to the OS
+///        when the allocator is destroyed.  Thread safe.
+class NumaAllocator
+{
+public:
+    static const size_t   SLAB_SIZE      = SWR_LARGE_PAGE_SIZE;
+    static const size_t   MIN_CHUNK_SIZE = 4 * sizeof(KILOBYTE);
+    static const uint32_t LOCAL_NODE     = SWR_ANY_NUMA_NODE; ///< node of the calling thread
+
+    NumaAllocator() = default;
+    ~NumaAllocator();
+
+    /// @returns MIN_CHUNK_SIZE aligned memory on numaNode, or nullptr
+    void* Alloc(size_t size, uint32_t numaNode = LOCAL_NODE);
+    void  Free(void* pMem);
+
+private:
+    // Chunk sizes MIN_CHUNK_SIZE << sizeClass up to SLAB_SIZE, allocations
+    // bigger than that get their own pages (sizeClass == NUM_SIZE_CLASSES).
+    static const uint32_t NUM_SIZE_CLASSES = 10;
+
+    struct Slab
+    {
+        size_t   size;
+        uint32_t numaNode;
+        uint32_t sizeClass;
+    };
+
+    struct FreeChunk
+    {
+        FreeChunk* pNext;
+    };
+
+    struct NodeChunks
+    {
+        FreeChunk* pFree[NUM_SIZE_CLASSES] = {};
+    };
+
+    static uint32_t GetSizeClass(size_t size);
+    bool            AddSlab(uint32_t numaNode, uint32_t sizeClass);
+
+    std::mutex                m_mutex;
+    std::map<uintptr_t, Slab> m_slabs; // by base address
+    std::vector<NodeChunks>   m_nodes;
+};
@@ -229,8 +229,10 @@ HOTTILE* HotTileMgr::GetHotTileNoLoad(SWR_CONTEXT*                pContext,
     {
         if (create)
         {
-            uint32_t size                  = numSamples * mHotTileSize[attachment];
-            hotTile.pBuffer                = (uint8_t*)AlignedMalloc(size, 64);
+            uint32_t size     = numSamples * mHotTileSize[attachment];
+            uint32_t numaNode = ((x ^ y) & pContext->threadPool.numaMask);
+            hotTile.pBuffer =
+                (uint8_t*)AllocHotTileMem(size, 64, numaNode + pContext->threadInfo.BASE_NUMA_NODE);
             hotTile.state                  = HOTTILE_INVALID;
             hotTile.numSamples             = numSamples;
             hotTile.renderTargetArrayIndex = 0;
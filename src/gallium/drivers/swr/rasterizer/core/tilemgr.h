@@ -266,7 +266,7 @@ union HotTileSet
 class HotTileMgr
 {
 public:
-    HotTileMgr()
+    HotTileMgr(NumaAllocator* pNumaAllocator = nullptr) : mpNumaAllocator(pNumaAllocator)
     {
         memset(mHotTiles, 0, sizeof(mHotTiles));
 
@@ -322,12 +322,18 @@ public:
     static void ClearStencilHotTile(const HOTTILE* pHotTile);
 
 private:
-    HotTileSet mHotTiles[KNOB_NUM_HOT_TILES_X][KNOB_NUM_HOT_TILES_Y];
-    uint32_t   mHotTileSize[SWR_NUM_ATTACHMENTS];
+    HotTileSet     mHotTiles[KNOB_NUM_HOT_TILES_X][KNOB_NUM_HOT_TILES_Y];
+    uint32_t       mHotTileSize[SWR_NUM_ATTACHMENTS];
+    NumaAllocator* mpNumaAllocator;
 
     void* AllocHotTileMem(size_t size, uint32_t align, uint32_t numaNode)
     {
         void* p = nullptr;
+        if (mpNumaAllocator)
+        {
+            SWR_ASSERT(align <= NumaAllocator::MIN_CHUNK_SIZE);
+            return mpNumaAllocator->Alloc(size, numaNode);
+        }
 #if defined(_WIN32)
         HANDLE hProcess = GetCurrentProcess();
         p               = VirtualAllocExNuma(
@@ -341,7 +347,11 @@ private:
 
     void FreeHotTileMem(void* pBuffer)
     {
-        if (pBuffer)
+        if (pBuffer && mpNumaAllocator)
+        {
+            mpNumaAllocator->Free(pBuffer);
+        }
+        else if (pBuffer)
         {
 #if defined(_WIN32)
             VirtualFree(pBuffer, 0, MEM_RELEASE);
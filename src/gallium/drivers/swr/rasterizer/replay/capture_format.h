@@ -0,0 +1,245 @@
+/****************************************************************************
+ * Copyright (C) 2026 agent.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * @file capture_format.h
+ *
+ * @brief Layout of the SWR API command streams recorded by the gallium
+ *        driver's capture mode (SWR_CAPTURE) and played back by swr_replay.
+ *
+ *        A stream is a SWR_CAPTURE_HEADER followed by commands.  Each command
+ *        is a SWR_CAPTURE_CMD_HEADER, a payload of 'size' bytes and then
+ *        'numRelocs' SWR_CAPTURE_RELOC entries.  Pointers inside a payload
+ *        are stored as zero and patched by the relocations: they refer either
+ *        to a memory object (a resource or scratch buffer, sent with
+ *        SWR_CAPTURE_CMD_OBJECT_DEFINE) or to a jitted function (sent with
+ *        SWR_CAPTURE_CMD_SHADER_DEFINE), by id.
+ *
+ *        API state is stored as the raw structs from state.h, so a stream can
+ *        only be played back by a replayer built from the same sources.
+ *
+ ******************************************************************************/
+#pragma once
+
+#include "common/os.h"
+#include "core/api.h"
+#include "jitter/jit_api.h"
+
+#define SWR_CAPTURE_MAGIC 0x50435753 // 'SWCP'
+#define SWR_CAPTURE_VERSION 2
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Fingerprint of the API structs stored verbatim in a stream.
+//////////////////////////////////////////////////////////////////////////
+INLINE uint32_t SwrCaptureApiHash()
+{
+    const size_t sizes[] = {
+        sizeof(SWR_VERTEX_BUFFER_STATE),
+        sizeof(SWR_INDEX_BUFFER_STATE),
+        sizeof(SWR_STREAMOUT_STATE),
+        sizeof(SWR_STREAMOUT_BUFFER),
+        sizeof(SWR_FRONTEND_STATE),
+        sizeof(SWR_GS_STATE),
+        sizeof(SWR_DEPTH_STENCIL_STATE),
+        sizeof(SWR_BACKEND_STATE),
+        sizeof(SWR_DEPTH_BOUNDS_STATE),
+        sizeof(SWR_PS_STATE),
+        sizeof(SWR_BLEND_STATE),
+        sizeof(SWR_RASTSTATE),
+        sizeof(SWR_VIEWPORT),
+        sizeof(SWR_VIEWPORT_MATRICES),
+        sizeof(SWR_SURFACE_STATE),
+        sizeof(FETCH_COMPILE_STATE),
+        sizeof(STREAMOUT_COMPILE_STATE),
+        sizeof(BLEND_COMPILE_STATE),
+    };
+
+    uint32_t hash = 2166136261u;
+    for (size_t size : sizes)
+    {
+        hash = (hash ^ uint32_t(size)) * 16777619u;
+    }
+    return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief FNV-1a 64 bit hash of the render targets recorded at the end of
+///        each frame, continued over each target in id order.
+//////////////////////////////////////////////////////////////////////////
+#define SWR_CAPTURE_CHECKSUM_INIT 14695981039346656037ull
+
+INLINE uint64_t SwrCaptureChecksum(uint64_t hash, const uint8_t* pData, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ pData[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+struct SWR_CAPTURE_HEADER
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t apiHash;             ///< SwrCaptureApiHash() of the capturing driver
+    uint32_t simdWidth;           ///< KNOB_SIMD_WIDTH of the capturing driver
+    uint32_t privateStateSize;    ///< size of the driver's private draw state
+    uint32_t renderTargetsOffset; ///< offset of its SWR_SURFACE_STATE array
+};
+
+enum SWR_CAPTURE_CMD : uint32_t
+{
+    // memory and shaders
+    SWR_CAPTURE_CMD_OBJECT_DEFINE, ///< SWR_CAPTURE_OBJECT + initial contents
+    SWR_CAPTURE_CMD_OBJECT_UPDATE, ///< SWR_CAPTURE_OBJECT + new contents of a range
+    SWR_CAPTURE_CMD_OBJECT_FREE,   ///< SWR_CAPTURE_OBJECT, freed once queued work is done
+    SWR_CAPTURE_CMD_SHADER_DEFINE, ///< SWR_CAPTURE_SHADER + compile state or bitcode
+
+    // state, payload is the API struct unless noted
+    SWR_CAPTURE_CMD_PRIVATE_STATE, ///< contents of SwrGetPrivateContextState()
+    SWR_CAPTURE_CMD_SET_VERTEX_BUFFERS, ///< SWR_CAPTURE_COUNT + SWR_VERTEX_BUFFER_STATE[]
+    SWR_CAPTURE_CMD_SET_INDEX_BUFFER,
+    SWR_CAPTURE_CMD_SET_FETCH_FUNC, ///< SWR_CAPTURE_FUNC
+    SWR_CAPTURE_CMD_SET_SO_FUNC,    ///< SWR_CAPTURE_FUNC
+    SWR_CAPTURE_CMD_SET_SO_STATE,
+    SWR_CAPTURE_CMD_SET_SO_BUFFERS, ///< SWR_CAPTURE_SO_BUFFER
+    SWR_CAPTURE_CMD_SET_VERTEX_FUNC, ///< SWR_CAPTURE_FUNC
+    SWR_CAPTURE_CMD_SET_FRONTEND_STATE,
+    SWR_CAPTURE_CMD_SET_GS_STATE,
+    SWR_CAPTURE_CMD_SET_GS_FUNC, ///< SWR_CAPTURE_FUNC
+    SWR_CAPTURE_CMD_SET_DEPTH_STENCIL_STATE,
+    SWR_CAPTURE_CMD_SET_BACKEND_STATE,
+    SWR_CAPTURE_CMD_SET_DEPTH_BOUNDS_STATE,
+    SWR_CAPTURE_CMD_SET_PIXEL_SHADER_STATE,
+    SWR_CAPTURE_CMD_SET_BLEND_STATE,
+    SWR_CAPTURE_CMD_SET_BLEND_FUNC, ///< SWR_CAPTURE_FUNC
+    SWR_CAPTURE_CMD_SET_RAST_STATE,
+    SWR_CAPTURE_CMD_SET_VIEWPORTS, ///< SWR_CAPTURE_COUNT + SWR_VIEWPORT[] + SWR_VIEWPORT_MATRICES
+    SWR_CAPTURE_CMD_SET_SCISSOR_RECTS, ///< SWR_CAPTURE_COUNT + SWR_RECT[]
+    SWR_CAPTURE_CMD_ENABLE_STATS_FE, ///< uint32_t enable
+    SWR_CAPTURE_CMD_ENABLE_STATS_BE, ///< uint32_t enable
+
+    // work, payload is SWR_CAPTURE_WORK
+    SWR_CAPTURE_CMD_DRAW,
+    SWR_CAPTURE_CMD_DRAW_INSTANCED,
+    SWR_CAPTURE_CMD_DRAW_INDEXED,
+    SWR_CAPTURE_CMD_DRAW_INDEXED_INSTANCED,
+    SWR_CAPTURE_CMD_INVALIDATE_TILES,
+    SWR_CAPTURE_CMD_DISCARD_RECT,
+    SWR_CAPTURE_CMD_STORE_TILES,
+    SWR_CAPTURE_CMD_CLEAR_RENDER_TARGET,
+
+    // synchronization, no payload unless noted
+    SWR_CAPTURE_CMD_SYNC,
+    SWR_CAPTURE_CMD_STALL_BE,
+    SWR_CAPTURE_CMD_WAIT_FOR_IDLE,
+    SWR_CAPTURE_CMD_WAIT_FOR_IDLE_FE,
+    SWR_CAPTURE_CMD_END_FRAME, ///< SWR_CAPTURE_FRAME
+
+    SWR_CAPTURE_CMD_COUNT
+};
+
+struct SWR_CAPTURE_CMD_HEADER
+{
+    uint32_t cmd;       ///< SWR_CAPTURE_CMD
+    uint32_t numRelocs; ///< number of SWR_CAPTURE_RELOC after the payload
+    uint64_t size;      ///< payload size in bytes
+};
+
+enum SWR_CAPTURE_RELOC_TYPE : uint32_t
+{
+    SWR_CAPTURE_RELOC_OBJECT, ///< address of memory object 'id' + delta
+    SWR_CAPTURE_RELOC_SHADER, ///< entry point of shader 'id'
+};
+
+struct SWR_CAPTURE_RELOC
+{
+    uint32_t offset; ///< of the 64 bit pointer within the payload
+    uint32_t type;   ///< SWR_CAPTURE_RELOC_TYPE
+    uint32_t id;
+    uint32_t pad;
+    int64_t  delta;  ///< pointers may point before the start of their object
+};
+
+#define SWR_CAPTURE_OBJECT_TRANSIENT 0x1 ///< only valid until the next frame
+#define SWR_CAPTURE_OBJECT_WAIT 0x2      ///< may be in use by queued work
+
+struct SWR_CAPTURE_OBJECT
+{
+    uint32_t id;
+    uint32_t flags;  ///< SWR_CAPTURE_OBJECT_*
+    uint64_t offset; ///< 0 unless updating
+    uint64_t size;   ///< of the data following, the whole object when defined
+};
+
+enum SWR_CAPTURE_SHADER_TYPE : uint32_t
+{
+    SWR_CAPTURE_SHADER_FETCH,     ///< FETCH_COMPILE_STATE for JitCompileFetch
+    SWR_CAPTURE_SHADER_STREAMOUT, ///< STREAMOUT_COMPILE_STATE for JitCompileStreamout
+    SWR_CAPTURE_SHADER_BLEND,     ///< BLEND_COMPILE_STATE for JitCompileBlend
+    SWR_CAPTURE_SHADER_VERTEX,    ///< LLVM bitcode defining "VS"
+    SWR_CAPTURE_SHADER_GEOMETRY,  ///< LLVM bitcode defining "GS"
+    SWR_CAPTURE_SHADER_PIXEL,     ///< LLVM bitcode defining "FS"
+};
+
+struct SWR_CAPTURE_SHADER
+{
+    uint32_t id;
+    uint32_t type; ///< SWR_CAPTURE_SHADER_TYPE
+    uint64_t size; ///< of the data following
+};
+
+struct SWR_CAPTURE_COUNT
+{
+    uint32_t count; ///< of the array following
+    uint32_t flags; ///< for SetViewports, whether matrices follow
+};
+
+struct SWR_CAPTURE_FUNC
+{
+    uint64_t pfnFunc; ///< relocated to a shader, or null
+    uint32_t index;   ///< so stream / render target for SetSoFunc / SetBlendFunc
+    uint32_t pad;
+};
+
+struct SWR_CAPTURE_SO_BUFFER
+{
+    uint32_t             slot;
+    uint32_t             pad;
+    SWR_STREAMOUT_BUFFER buffer;
+};
+
+struct SWR_CAPTURE_FRAME
+{
+    uint64_t checksum; ///< of the live render targets once the frame is idle
+};
+
+struct SWR_CAPTURE_WORK
+{
+    uint32_t topology; ///< PRIMITIVE_TOPOLOGY for draws
+    uint32_t args[5];  ///< remaining integer arguments of the call, in order
+    uint32_t attachmentMask;
+    uint32_t tileState; ///< SWR_TILE_STATE for SwrStoreTiles
+    float    clearColor[4];
+    float    clearDepth;
+    uint32_t clearStencil;
+    SWR_RECT rect;
+};
@@ -0,0 +1,993 @@
+/****************************************************************************
+ * Copyright (C) 2026 agent.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * @file swr_replay.cpp
+ *
+ * @brief Plays back SWR API recordings made by the gallium driver with
+ *        SWR_CAPTURE=<file>, against the rasterizer alone, and reports how
+ *        long each frame took.
+ *
+ *        Frames are delimited by SwrEndFrame, so the usual KNOB_AR_* and
+ *        KNOB_BUCKETS_* settings give per frame ArchRast statistics for a
+ *        workload which is the same on every run.  The fetch, streamout and
+ *        blend functions get recompiled from their compile state, the
+ *        shaders from the bitcode the driver jitted them from.
+ *
+ *        Usage: swr_replay [-n loops] [-q] [-c] <recording>
+ *          -n  play the recording this many times; the first time includes
+ *              JIT compilation, so it is left out of the summary
+ *          -q  only print the summary
+ *          -c  print a checksum of the render targets after each frame
+ *              and compare it with the one the driver recorded; exits
+ *              with an error if any frame differs
+ *
+ ******************************************************************************/
+#include "common/os.h"
+#include "core/api.h"
+#include "core/knobs.h"
+#include "jitter/JitManager.h"
+#include "jitter/jit_api.h"
+#include "memory/InitMemory.h"
+#include "replay/capture_format.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+    SWR_INTERFACE gApi;
+    uint32_t      gRenderTargetsOffset;
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Tile callbacks, the render targets are where the driver keeps
+    ///        them in the private state.
+    SWR_SURFACE_STATE* GetRenderTarget(HANDLE hPrivateContext, uint32_t index)
+    {
+        return (SWR_SURFACE_STATE*)((uint8_t*)hPrivateContext + gRenderTargetsOffset) + index;
+    }
+
+    void SWR_API LoadTile(HANDLE                      hPrivateContext,
+                          HANDLE                      hWorkerPrivateData,
+                          SWR_FORMAT                  dstFormat,
+                          SWR_RENDERTARGET_ATTACHMENT renderTargetIndex,
+                          uint32_t                    x,
+                          uint32_t                    y,
+                          uint32_t                    renderTargetArrayIndex,
+                          uint8_t*                    pDstHotTile)
+    {
+        gApi.pfnSwrLoadHotTile(hWorkerPrivateData,
+                               GetRenderTarget(hPrivateContext, renderTargetIndex),
+                               dstFormat,
+                               renderTargetIndex,
+                               x,
+                               y,
+                               renderTargetArrayIndex,
+                               pDstHotTile);
+    }
+
+    void SWR_API StoreTile(HANDLE                      hPrivateContext,
+                           HANDLE                      hWorkerPrivateData,
+                           SWR_FORMAT                  srcFormat,
+                           SWR_RENDERTARGET_ATTACHMENT renderTargetIndex,
+                           uint32_t                    x,
+                           uint32_t                    y,
+                           uint32_t                    renderTargetArrayIndex,
+                           uint8_t*                    pSrcHotTile)
+    {
+        gApi.pfnSwrStoreHotTileToSurface(hWorkerPrivateData,
+                                         GetRenderTarget(hPrivateContext, renderTargetIndex),
+                                         srcFormat,
+                                         renderTargetIndex,
+                                         x,
+                                         y,
+                                         renderTargetArrayIndex,
+                                         pSrcHotTile);
+    }
+
+    void SWR_API ClearTile(HANDLE                      hPrivateContext,
+                           HANDLE                      hWorkerPrivateData,
+                           SWR_RENDERTARGET_ATTACHMENT renderTargetIndex,
+                           uint32_t                    x,
+                           uint32_t                    y,
+                           uint32_t                    renderTargetArrayIndex,
+                           const float*                pClearColor)
+    {
+        gApi.pfnSwrStoreHotTileClear(hWorkerPrivateData,
+                                     GetRenderTarget(hPrivateContext, renderTargetIndex),
+                                     renderTargetIndex,
+                                     x,
+                                     y,
+                                     renderTargetArrayIndex,
+                                     pClearColor);
+    }
+
+    void SWR_API SyncCallback(uint64_t, uint64_t, uint64_t) {}
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief A command of the recording
+    struct Command
+    {
+        uint32_t                 cmd;
+        const uint8_t*           pPayload;
+        size_t                   size;
+        const SWR_CAPTURE_RELOC* pRelocs;
+        uint32_t                 numRelocs;
+    };
+
+    struct Object
+    {
+        uint8_t* pData;
+        size_t   size;
+    };
+
+    struct FrameStats
+    {
+        double   ms;
+        uint32_t draws;
+    };
+
+    class Replay
+    {
+    public:
+        Replay(const std::vector<uint8_t>& stream, bool checksums) :
+            mStream(stream), mChecksums(checksums)
+        {
+        }
+
+        ~Replay() { Destroy(); }
+
+        bool Init();
+        bool Play(std::vector<FrameStats>& frames);
+
+        uint32_t Mismatches() const { return mMismatches; }
+
+    private:
+        bool Execute(const Command& cmd);
+        void Resolve(const Command& cmd, void* pDst, size_t size, size_t offset = 0);
+        void EndFrame(std::vector<FrameStats>& frames, const SWR_CAPTURE_FRAME* pRecorded);
+        void ReleasePending();
+        void Destroy();
+
+        template <typename T>
+        bool Read(const Command& cmd, T& out)
+        {
+            if (cmd.size != sizeof(T))
+            {
+                return false;
+            }
+            Resolve(cmd, &out, sizeof(T));
+            return true;
+        }
+
+        void* CompileShader(const SWR_CAPTURE_SHADER& desc, const uint8_t* pData);
+        void* LoadBitcode(const uint8_t* pData, size_t size, const char* pEntry, uint32_t id);
+
+        const std::vector<uint8_t>& mStream;
+        bool                        mChecksums;
+
+        HANDLE mhContext         = nullptr;
+        HANDLE mhJitMgr          = nullptr;
+        size_t mPrivateStateSize = 0;
+
+        std::unordered_map<uint32_t, Object> mObjects;
+        std::unordered_map<uint32_t, void*>  mShaders;
+        std::unordered_set<uint32_t>         mRenderTargets;
+        std::vector<uint32_t>                mPendingFrees; ///< released at the end of the frame
+
+        std::chrono::high_resolution_clock::time_point mFrameStart;
+        uint32_t                                       mFrameDraws = 0;
+        uint32_t                                       mMismatches = 0;
+    };
+
+    bool Replay::Init()
+    {
+        const SWR_CAPTURE_HEADER* pHeader = (const SWR_CAPTURE_HEADER*)mStream.data();
+
+        if (mStream.size() < sizeof(*pHeader) || pHeader->magic != SWR_CAPTURE_MAGIC)
+        {
+            fprintf(stderr, "not an SWR recording\n");
+            return false;
+        }
+
+        if (pHeader->version != SWR_CAPTURE_VERSION || pHeader->apiHash != SwrCaptureApiHash() ||
+            pHeader->simdWidth != KNOB_SIMD_WIDTH)
+        {
+            fprintf(stderr, "recording made by a different build of the driver\n");
+            return false;
+        }
+
+        gRenderTargetsOffset = pHeader->renderTargetsOffset;
+        mPrivateStateSize    = pHeader->privateStateSize;
+
+        SwrGetInterface(gApi);
+        InitTilesTable();
+
+        mhJitMgr = JitCreateContext(KNOB_SIMD_WIDTH, "", "swr");
+
+        SWR_CREATECONTEXT_INFO createInfo = {};
+        createInfo.privateStateSize       = pHeader->privateStateSize;
+        createInfo.pfnLoadTile            = LoadTile;
+        createInfo.pfnStoreTile           = StoreTile;
+        createInfo.pfnClearTile           = ClearTile;
+
+        mhContext = gApi.pfnSwrCreateContext(&createInfo);
+        gApi.pfnSwrInit();
+
+        return mhContext != nullptr;
+    }
+
+    void Replay::Destroy()
+    {
+        if (mhContext)
+        {
+            gApi.pfnSwrWaitForIdle(mhContext);
+            gApi.pfnSwrDestroyContext(mhContext);
+            mhContext = nullptr;
+        }
+
+        for (auto& entry : mObjects)
+        {
+            AlignedFree(entry.second.pData);
+        }
+        mObjects.clear();
+        mPendingFrees.clear();
+
+        if (mhJitMgr)
+        {
+            JitDestroyContext(mhJitMgr);
+            mhJitMgr = nullptr;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Copies a payload, from offset on, and patches its pointers.
+    void Replay::Resolve(const Command& cmd, void* pDst, size_t size, size_t offset)
+    {
+        memcpy(pDst, cmd.pPayload + offset, size);
+
+        for (uint32_t i = 0; i < cmd.numRelocs; i++)
+        {
+            const SWR_CAPTURE_RELOC& reloc = cmd.pRelocs[i];
+            uint64_t                 value = 0;
+
+            if (reloc.offset < offset || reloc.offset + sizeof(value) > offset + size)
+            {
+                continue;
+            }
+
+            if (reloc.type == SWR_CAPTURE_RELOC_OBJECT)
+            {
+                auto it = mObjects.find(reloc.id);
+                if (it != mObjects.end())
+                {
+                    value = (uint64_t)(it->second.pData + reloc.delta);
+                }
+            }
+            else
+            {
+                auto it = mShaders.find(reloc.id);
+                if (it != mShaders.end())
+                {
+                    value = (uint64_t)it->second;
+                }
+            }
+
+            memcpy((uint8_t*)pDst + reloc.offset - offset, &value, sizeof(value));
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief JITs the entry point of a module the driver recorded.
+    void* Replay::LoadBitcode(const uint8_t* pData, size_t size, const char* pEntry, uint32_t id)
+    {
+        JitManager* pJitMgr = reinterpret_cast<JitManager*>(mhJitMgr);
+
+        // No identifier, so it doesn't go through the JIT cache
+        std::unique_ptr<llvm::MemoryBuffer> pBuffer = llvm::MemoryBuffer::getMemBuffer(
+            llvm::StringRef((const char*)pData, size), "", false);
+        auto module = llvm::parseBitcodeFile(pBuffer->getMemBufferRef(), pJitMgr->mContext);
+        if (!module)
+        {
+            llvm::consumeError(module.takeError());
+            return nullptr;
+        }
+
+        llvm::Function* pFunc = (*module)->getFunction(pEntry);
+        if (!pFunc)
+        {
+            return nullptr;
+        }
+
+        // Every shader module has the same names in it
+        for (llvm::GlobalValue& value : (*module)->global_values())
+        {
+            if (&value != pFunc && !value.isDeclaration())
+            {
+                value.setLinkage(llvm::GlobalValue::InternalLinkage);
+            }
+        }
+
+        std::string name = std::string(pEntry) + "_" + std::to_string(id);
+        pFunc->setName(name);
+
+        (*module)->setDataLayout(pJitMgr->mpExec->getDataLayout());
+        pJitMgr->mpExec->addModule(std::move(*module));
+
+        return (void*)pJitMgr->mpExec->getFunctionAddress(name);
+    }
+
+    void* Replay::CompileShader(const SWR_CAPTURE_SHADER& desc, const uint8_t* pData)
+    {
+        switch (desc.type)
+        {
+        case SWR_CAPTURE_SHADER_FETCH:
+        {
+            FETCH_COMPILE_STATE state;
+            if (desc.size != sizeof(state))
+                return nullptr;
+            memcpy(&state, pData, sizeof(state));
+            return (void*)JitCompileFetch(mhJitMgr, state);
+        }
+        case SWR_CAPTURE_SHADER_STREAMOUT:
+        {
+            STREAMOUT_COMPILE_STATE state;
+            if (desc.size != sizeof(state))
+                return nullptr;
+            memcpy(&state, pData, sizeof(state));
+            return (void*)JitCompileStreamout(mhJitMgr, state);
+        }
+        case SWR_CAPTURE_SHADER_BLEND:
+        {
+            BLEND_COMPILE_STATE state;
+            if (desc.size != sizeof(state))
+                return nullptr;
+            memcpy(&state, pData, sizeof(state));
+            return (void*)JitCompileBlend(mhJitMgr, state);
+        }
+        case SWR_CAPTURE_SHADER_VERTEX:
+            return LoadBitcode(pData, desc.size, "VS", desc.id);
+        case SWR_CAPTURE_SHADER_GEOMETRY:
+            return LoadBitcode(pData, desc.size, "GS", desc.id);
+        case SWR_CAPTURE_SHADER_PIXEL:
+            return LoadBitcode(pData, desc.size, "FS", desc.id);
+        default:
+            return nullptr;
+        }
+    }
+
+    void Replay::ReleasePending()
+    {
+        for (uint32_t id : mPendingFrees)
+        {
+            auto it = mObjects.find(id);
+            if (it != mObjects.end())
+            {
+                AlignedFree(it->second.pData);
+                mObjects.erase(it);
+                mRenderTargets.erase(id);
+            }
+        }
+        mPendingFrees.clear();
+    }
+
+    void Replay::EndFrame(std::vector<FrameStats>& frames, const SWR_CAPTURE_FRAME* pRecorded)
+    {
+        gApi.pfnSwrEndFrame(mhContext);
+        gApi.pfnSwrWaitForIdle(mhContext);
+
+        auto now = std::chrono::high_resolution_clock::now();
+
+        FrameStats stats;
+        stats.ms    = std::chrono::duration<double, std::milli>(now - mFrameStart).count();
+        stats.draws = mFrameDraws;
+        frames.push_back(stats);
+
+        if (mChecksums)
+        {
+            // Over the render targets in id order, leaving out the ones
+            // freed during the frame as the driver had already lost them
+            std::vector<uint32_t> ids;
+            for (uint32_t id : mRenderTargets)
+            {
+                if (std::find(mPendingFrees.begin(), mPendingFrees.end(), id) ==
+                    mPendingFrees.end())
+                {
+                    ids.push_back(id);
+                }
+            }
+            std::sort(ids.begin(), ids.end());
+
+            uint64_t hash = SWR_CAPTURE_CHECKSUM_INIT;
+            for (uint32_t id : ids)
+            {
+                const Object& obj = mObjects[id];
+                hash              = SwrCaptureChecksum(hash, obj.pData, obj.size);
+            }
+
+            uint32_t frame = (uint32_t)frames.size() - 1;
+            if (!pRecorded)
+            {
+                printf("frame %u checksum %016llx (unfinished)\n",
+                       frame,
+                       (unsigned long long)hash);
+            }
+            else if (hash == pRecorded->checksum)
+            {
+                printf("frame %u checksum %016llx match\n", frame, (unsigned long long)hash);
+            }
+            else
+            {
+                printf("frame %u checksum %016llx MISMATCH, recorded %016llx\n",
+                       frame,
+                       (unsigned long long)hash,
+                       (unsigned long long)pRecorded->checksum);
+                mMismatches++;
+            }
+        }
+
+        ReleasePending();
+
+        mFrameDraws = 0;
+        mFrameStart = std::chrono::high_resolution_clock::now();
+    }
+
+    bool Replay::Execute(const Command& cmd)
+    {
+        switch (cmd.cmd)
+        {
+        case SWR_CAPTURE_CMD_OBJECT_DEFINE:
+        {
+            SWR_CAPTURE_OBJECT desc;
+            if (cmd.size < sizeof(desc))
+                return false;
+            memcpy(&desc, cmd.pPayload, sizeof(desc));
+            if (cmd.size != sizeof(desc) + desc.size)
+                return false;
+
+            // Played again, or the recording reused the id
+            auto it = mObjects.find(desc.id);
+            if (it != mObjects.end())
+            {
+                gApi.pfnSwrWaitForIdle(mhContext);
+                AlignedFree(it->second.pData);
+                mObjects.erase(it);
+            }
+
+            Object obj;
+            obj.size  = desc.size;
+            obj.pData = (uint8_t*)AlignedMalloc(std::max<size_t>(desc.size, 1), 64);
+            memcpy(obj.pData, cmd.pPayload + sizeof(desc), desc.size);
+            mObjects[desc.id] = obj;
+
+            if (desc.flags & SWR_CAPTURE_OBJECT_TRANSIENT)
+            {
+                mPendingFrees.push_back(desc.id);
+            }
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_OBJECT_UPDATE:
+        {
+            SWR_CAPTURE_OBJECT desc;
+            if (cmd.size < sizeof(desc))
+                return false;
+            memcpy(&desc, cmd.pPayload, sizeof(desc));
+
+            auto it = mObjects.find(desc.id);
+            if (cmd.size != sizeof(desc) + desc.size || it == mObjects.end() ||
+                desc.offset + desc.size > it->second.size)
+                return false;
+
+            if (desc.flags & SWR_CAPTURE_OBJECT_WAIT)
+            {
+                gApi.pfnSwrWaitForIdle(mhContext);
+            }
+            memcpy(it->second.pData + desc.offset, cmd.pPayload + sizeof(desc), desc.size);
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_OBJECT_FREE:
+        {
+            SWR_CAPTURE_OBJECT desc;
+            if (!Read(cmd, desc))
+                return false;
+            mPendingFrees.push_back(desc.id);
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_SHADER_DEFINE:
+        {
+            SWR_CAPTURE_SHADER desc;
+            if (cmd.size < sizeof(desc))
+                return false;
+            memcpy(&desc, cmd.pPayload, sizeof(desc));
+            if (cmd.size != sizeof(desc) + desc.size)
+                return false;
+
+            // Compiled by an earlier loop
+            if (mShaders.count(desc.id))
+                return true;
+
+            void* pfnFunc = CompileShader(desc, cmd.pPayload + sizeof(desc));
+            if (!pfnFunc)
+            {
+                fprintf(stderr, "failed to compile shader %u\n", desc.id);
+                return false;
+            }
+            mShaders[desc.id] = pfnFunc;
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_PRIVATE_STATE:
+        {
+            const uint32_t rtSize = SWR_NUM_ATTACHMENTS * sizeof(SWR_SURFACE_STATE);
+            if (cmd.size != mPrivateStateSize)
+                return false;
+
+            void* pState = gApi.pfnSwrGetPrivateContextState(mhContext);
+            Resolve(cmd, pState, cmd.size);
+
+            for (uint32_t i = 0; i < cmd.numRelocs; i++)
+            {
+                const SWR_CAPTURE_RELOC& reloc = cmd.pRelocs[i];
+                if (reloc.type == SWR_CAPTURE_RELOC_OBJECT &&
+                    reloc.offset >= gRenderTargetsOffset &&
+                    reloc.offset < gRenderTargetsOffset + rtSize)
+                {
+                    mRenderTargets.insert(reloc.id);
+                }
+            }
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_SET_VERTEX_BUFFERS:
+        {
+            SWR_CAPTURE_COUNT count;
+            if (cmd.size < sizeof(count))
+                return false;
+            memcpy(&count, cmd.pPayload, sizeof(count));
+            if (cmd.size != sizeof(count) + count.count * sizeof(SWR_VERTEX_BUFFER_STATE))
+                return false;
+
+            std::vector<SWR_VERTEX_BUFFER_STATE> buffers(count.count);
+            Resolve(cmd, buffers.data(), cmd.size - sizeof(count), sizeof(count));
+            gApi.pfnSwrSetVertexBuffers(mhContext, count.count, buffers.data());
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_SET_INDEX_BUFFER:
+        {
+            SWR_INDEX_BUFFER_STATE state;
+            if (!Read(cmd, state))
+                return false;
+            gApi.pfnSwrSetIndexBuffer(mhContext, &state);
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_SET_FETCH_FUNC:
+        case SWR_CAPTURE_CMD_SET_SO_FUNC:
+        case SWR_CAPTURE_CMD_SET_VERTEX_FUNC:
+        case SWR_CAPTURE_CMD_SET_GS_FUNC:
+        case SWR_CAPTURE_CMD_SET_BLEND_FUNC:
+        {
+            SWR_CAPTURE_FUNC func;
+            if (!Read(cmd, func))
+                return false;
+
+            void* pfnFunc = (void*)func.pfnFunc;
+            switch (cmd.cmd)
+            {
+            case SWR_CAPTURE_CMD_SET_FETCH_FUNC:
+                gApi.pfnSwrSetFetchFunc(mhContext, (PFN_FETCH_FUNC)pfnFunc);
+                break;
+            case SWR_CAPTURE_CMD_SET_SO_FUNC:
+                gApi.pfnSwrSetSoFunc(mhContext, (PFN_SO_FUNC)pfnFunc, func.index);
+                break;
+            case SWR_CAPTURE_CMD_SET_VERTEX_FUNC:
+                gApi.pfnSwrSetVertexFunc(mhContext, (PFN_VERTEX_FUNC)pfnFunc);
+                break;
+            case SWR_CAPTURE_CMD_SET_GS_FUNC:
+                gApi.pfnSwrSetGsFunc(mhContext, (PFN_GS_FUNC)pfnFunc);
+                break;
+            default:
+                gApi.pfnSwrSetBlendFunc(mhContext, func.index, (PFN_BLEND_JIT_FUNC)pfnFunc);
+                break;
+            }
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_SET_SO_BUFFERS:
+        {
+            SWR_CAPTURE_SO_BUFFER buffer;
+            if (!Read(cmd, buffer))
+                return false;
+            gApi.pfnSwrSetSoBuffers(mhContext, &buffer.buffer, buffer.slot);
+            return true;
+        }
+
+#define REPLAY_STATE(cmdName, type, func)           \
+    case cmdName:                                   \
+    {                                               \
+        type state;                                 \
+        if (!Read(cmd, state))                      \
+            return false;                           \
+        gApi.func(mhContext, &state);               \
+        return true;                                \
+    }
+
+        REPLAY_STATE(SWR_CAPTURE_CMD_SET_SO_STATE, SWR_STREAMOUT_STATE, pfnSwrSetSoState)
+        REPLAY_STATE(SWR_CAPTURE_CMD_SET_FRONTEND_STATE, SWR_FRONTEND_STATE, pfnSwrSetFrontendState)
+        REPLAY_STATE(SWR_CAPTURE_CMD_SET_GS_STATE, SWR_GS_STATE, pfnSwrSetGsState)
+        REPLAY_STATE(SWR_CAPTURE_CMD_SET_DEPTH_STENCIL_STATE,
+                     SWR_DEPTH_STENCIL_STATE,
+                     pfnSwrSetDepthStencilState)
+        REPLAY_STATE(SWR_CAPTURE_CMD_SET_BACKEND_STATE, SWR_BACKEND_STATE, pfnSwrSetBackendState)
+        REPLAY_STATE(SWR_CAPTURE_CMD_SET_DEPTH_BOUNDS_STATE,
+                     SWR_DEPTH_BOUNDS_STATE,
+                     pfnSwrSetDepthBoundsState)
+        REPLAY_STATE(SWR_CAPTURE_CMD_SET_PIXEL_SHADER_STATE, SWR_PS_STATE, pfnSwrSetPixelShaderState)
+        REPLAY_STATE(SWR_CAPTURE_CMD_SET_BLEND_STATE, SWR_BLEND_STATE, pfnSwrSetBlendState)
+        REPLAY_STATE(SWR_CAPTURE_CMD_SET_RAST_STATE, SWR_RASTSTATE, pfnSwrSetRastState)
+#undef REPLAY_STATE
+
+        case SWR_CAPTURE_CMD_SET_VIEWPORTS:
+        {
+            SWR_CAPTURE_COUNT count;
+            if (cmd.size < sizeof(count))
+                return false;
+            memcpy(&count, cmd.pPayload, sizeof(count));
+
+            size_t size = sizeof(count) + count.count * sizeof(SWR_VIEWPORT);
+            if (cmd.size != size + (count.flags ? sizeof(SWR_VIEWPORT_MATRICES) : 0))
+                return false;
+
+            std::vector<SWR_VIEWPORT> viewports(count.count);
+            memcpy(viewports.data(), cmd.pPayload + sizeof(count), size - sizeof(count));
+
+            SWR_VIEWPORT_MATRICES matrices;
+            if (count.flags)
+            {
+                memcpy(&matrices, cmd.pPayload + size, sizeof(matrices));
+            }
+
+            gApi.pfnSwrSetViewports(
+                mhContext, count.count, viewports.data(), count.flags ? &matrices : nullptr);
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_SET_SCISSOR_RECTS:
+        {
+            SWR_CAPTURE_COUNT count;
+            if (cmd.size < sizeof(count))
+                return false;
+            memcpy(&count, cmd.pPayload, sizeof(count));
+            if (cmd.size != sizeof(count) + count.count * sizeof(SWR_RECT))
+                return false;
+
+            std::vector<SWR_RECT> rects(count.count);
+            memcpy(rects.data(), cmd.pPayload + sizeof(count), count.count * sizeof(SWR_RECT));
+            gApi.pfnSwrSetScissorRects(mhContext, count.count, rects.data());
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_ENABLE_STATS_FE:
+        case SWR_CAPTURE_CMD_ENABLE_STATS_BE:
+        {
+            uint32_t enable;
+            if (!Read(cmd, enable))
+                return false;
+            if (cmd.cmd == SWR_CAPTURE_CMD_ENABLE_STATS_FE)
+                gApi.pfnSwrEnableStatsFE(mhContext, enable != 0);
+            else
+                gApi.pfnSwrEnableStatsBE(mhContext, enable != 0);
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_DRAW:
+        case SWR_CAPTURE_CMD_DRAW_INSTANCED:
+        case SWR_CAPTURE_CMD_DRAW_INDEXED:
+        case SWR_CAPTURE_CMD_DRAW_INDEXED_INSTANCED:
+        case SWR_CAPTURE_CMD_INVALIDATE_TILES:
+        case SWR_CAPTURE_CMD_DISCARD_RECT:
+        case SWR_CAPTURE_CMD_STORE_TILES:
+        case SWR_CAPTURE_CMD_CLEAR_RENDER_TARGET:
+        {
+            SWR_CAPTURE_WORK work;
+            if (!Read(cmd, work))
+                return false;
+
+            PRIMITIVE_TOPOLOGY topology = (PRIMITIVE_TOPOLOGY)work.topology;
+            const uint32_t*    args     = work.args;
+
+            switch (cmd.cmd)
+            {
+            case SWR_CAPTURE_CMD_DRAW:
+                gApi.pfnSwrDraw(mhContext, topology, args[0], args[1]);
+                mFrameDraws++;
+                break;
+            case SWR_CAPTURE_CMD_DRAW_INSTANCED:
+                gApi.pfnSwrDrawInstanced(mhContext, topology, args[0], args[1], args[2], args[3]);
+                mFrameDraws++;
+                break;
+            case SWR_CAPTURE_CMD_DRAW_INDEXED:
+                gApi.pfnSwrDrawIndexed(mhContext, topology, args[0], args[1], (int32_t)args[2]);
+                mFrameDraws++;
+                break;
+            case SWR_CAPTURE_CMD_DRAW_INDEXED_INSTANCED:
+                gApi.pfnSwrDrawIndexedInstanced(
+                    mhContext, topology, args[0], args[1], args[2], (int32_t)args[3], args[4]);
+                mFrameDraws++;
+                break;
+            case SWR_CAPTURE_CMD_INVALIDATE_TILES:
+                gApi.pfnSwrInvalidateTiles(mhContext, work.attachmentMask, work.rect);
+                break;
+            case SWR_CAPTURE_CMD_DISCARD_RECT:
+                gApi.pfnSwrDiscardRect(mhContext, work.attachmentMask, work.rect);
+                break;
+            case SWR_CAPTURE_CMD_STORE_TILES:
+                gApi.pfnSwrStoreTiles(
+                    mhContext, work.attachmentMask, (SWR_TILE_STATE)work.tileState, work.rect);
+                break;
+            default:
+                gApi.pfnSwrClearRenderTarget(mhContext,
+                                             work.attachmentMask,
+                                             args[0],
+                                             work.clearColor,
+                                             work.clearDepth,
+                                             (uint8_t)work.clearStencil,
+                                             work.rect);
+                break;
+            }
+            return true;
+        }
+
+        case SWR_CAPTURE_CMD_SYNC:
+            gApi.pfnSwrSync(mhContext, SyncCallback, 0, 0, 0);
+            return true;
+        case SWR_CAPTURE_CMD_STALL_BE:
+            gApi.pfnSwrStallBE(mhContext);
+            return true;
+        case SWR_CAPTURE_CMD_WAIT_FOR_IDLE:
+            gApi.pfnSwrWaitForIdle(mhContext);
+            return true;
+        case SWR_CAPTURE_CMD_WAIT_FOR_IDLE_FE:
+            gApi.pfnSwrWaitForIdleFE(mhContext);
+            return true;
+
+        default:
+            fprintf(stderr, "unknown command %u\n", cmd.cmd);
+            return false;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Plays the whole recording once, appending to frames.
+    bool Replay::Play(std::vector<FrameStats>& frames)
+    {
+        const uint8_t* pCur = mStream.data() + sizeof(SWR_CAPTURE_HEADER);
+        const uint8_t* pEnd = mStream.data() + mStream.size();
+
+        mFrameDraws = 0;
+        mFrameStart = std::chrono::high_resolution_clock::now();
+
+        while (pCur < pEnd)
+        {
+            SWR_CAPTURE_CMD_HEADER header;
+            if ((size_t)(pEnd - pCur) < sizeof(header))
+            {
+                break;
+            }
+            memcpy(&header, pCur, sizeof(header));
+            pCur += sizeof(header);
+
+            size_t relocSize = header.numRelocs * sizeof(SWR_CAPTURE_RELOC);
+            if ((size_t)(pEnd - pCur) < header.size + relocSize)
+            {
+                // Recording cut short, e.g. by the application exiting
+                break;
+            }
+
+            // Keep the payload in aligned memory, the API structs need it
+            std::vector<uint64_t> payload((header.size + 7) / 8);
+            memcpy(payload.data(), pCur, header.size);
+
+            std::vector<SWR_CAPTURE_RELOC> relocs(header.numRelocs);
+            memcpy(relocs.data(), pCur + header.size, relocSize);
+
+            pCur += header.size + relocSize;
+
+            Command cmd;
+            cmd.cmd       = header.cmd;
+            cmd.pPayload  = (const uint8_t*)payload.data();
+            cmd.size      = header.size;
+            cmd.pRelocs   = relocs.data();
+            cmd.numRelocs = header.numRelocs;
+
+            if (cmd.cmd == SWR_CAPTURE_CMD_END_FRAME)
+            {
+                SWR_CAPTURE_FRAME recorded;
+                if (!Read(cmd, recorded))
+                {
+                    fprintf(stderr, "bad end of frame in recording\n");
+                    return false;
+                }
+                EndFrame(frames, &recorded);
+            }
+            else if (!Execute(cmd))
+            {
+                fprintf(stderr, "bad command %u in recording\n", cmd.cmd);
+                return false;
+            }
+        }
+
+        // Whatever came after the last frame
+        if (mFrameDraws)
+        {
+            EndFrame(frames, nullptr);
+        }
+        return true;
+    }
+
+    bool LoadFile(const char* pFilename, std::vector<uint8_t>& data)
+    {
+        FILE* fp = fopen(pFilename, "rb");
+        if (!fp)
+        {
+            return false;
+        }
+
+        fseek(fp, 0, SEEK_END);
+        long size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+
+        data.resize(size > 0 ? size : 0);
+        bool ok = fread(data.data(), 1, data.size(), fp) == data.size();
+        fclose(fp);
+        return ok;
+    }
+
+    void Usage()
+    {
+        fprintf(stderr, "usage: swr_replay [-n loops] [-q] [-c] <recording>\n");
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* pFilename = nullptr;
+    uint32_t    loops     = 1;
+    bool        quiet     = false;
+    bool        checksums = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            loops = std::max(atoi(argv[++i]), 1);
+        }
+        else if (!strcmp(argv[i], "-q"))
+        {
+            quiet = true;
+        }
+        else if (!strcmp(argv[i], "-c"))
+        {
+            checksums = true;
+        }
+        else if (argv[i][0] != '-' && !pFilename)
+        {
+            pFilename = argv[i];
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (!pFilename)
+    {
+        Usage();
+        return 1;
+    }
+
+    std::vector<uint8_t> stream;
+    if (!LoadFile(pFilename, stream))
+    {
+        fprintf(stderr, "can't read %s\n", pFilename);
+        return 1;
+    }
+
+    Replay replay(stream, checksums);
+    if (!replay.Init())
+    {
+        return 1;
+    }
+
+    std::vector<FrameStats> measured;
+    for (uint32_t loop = 0; loop < loops; loop++)
+    {
+        std::vector<FrameStats> frames;
+        if (!replay.Play(frames))
+        {
+            return 1;
+        }
+
+        if (!quiet)
+        {
+            for (size_t i = 0; i < frames.size(); i++)
+            {
+                printf("loop %u frame %zu: %u draws, %.3f ms\n",
+                       loop,
+                       i,
+                       frames[i].draws,
+                       frames[i].ms);
+            }
+        }
+
+        // The first loop compiles the shaders
+        if (loop > 0 || loops == 1)
+        {
+            measured.insert(measured.end(), frames.begin(), frames.end());
+        }
+    }
+
+    if (measured.empty())
+    {
+        printf("no frames\n");
+        return 0;
+    }
+
+    double   total = 0.0, minMs = measured[0].ms, maxMs = measured[0].ms;
+    uint64_t draws = 0;
+    for (const FrameStats& frame : measured)
+    {
+        total += frame.ms;
+        minMs = std::min(minMs, frame.ms);
+        maxMs = std::max(maxMs, frame.ms);
+        draws += frame.draws;
+    }
+
+    double avg = total / measured.size();
+    printf("%zu frames, %llu draws: total %.3f ms, avg %.3f ms, min %.3f ms, max %.3f ms, "
+           "%.2f fps\n",
+           measured.size(),
+           (unsigned long long)draws,
+           total,
+           avg,
+           minMs,
+           maxMs,
+           avg > 0.0 ? 1000.0 / avg : 0.0);
+
+    if (replay.Mismatches())
+    {
+        fprintf(stderr, "%u frames differ from the recording\n", replay.Mismatches());
+        return 1;
+    }
+    return 0;
+}
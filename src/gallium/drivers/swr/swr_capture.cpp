@@ -0,0 +1,1212 @@
+/****************************************************************************
+ * Copyright (C) 2026 agent.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ***************************************************************************/
+
+/*
+ * With SWR_CAPTURE=<file> set, the SWR_INTERFACE of every context is
+ * replaced by wrappers which record each call to <file> (<file>.1, <file>.2
+ * and so on for further contexts) before passing it on.  swr_replay plays
+ * such a recording back against the rasterizer alone.  The stream layout
+ * is described in rasterizer/replay/capture_format.h.
+ *
+ * Memory the rasterizer gets pointed at is tracked as objects: resources
+ * and scratch buffers are registered as they are allocated, and pointers
+ * in the API state are recorded relative to the object containing them.
+ * An object's contents are recorded the first time a stream refers to it,
+ * and changes made by the CPU afterwards by comparing against a shadow
+ * copy before each draw, or at transfer unmap for the objects the
+ * rasterizer writes itself (render targets and stream output buffers),
+ * whose contents a replay produces on its own.  Pointers outside of any
+ * object, such as large client arrays, are recorded as transient objects.
+ * The rasterizer gets idled before every draw to keep the copies
+ * consistent, so capturing is slow.
+ *
+ * The end of each frame records a checksum of the render targets, which
+ * swr_replay -c checks its own output against.
+ *
+ * Jitted functions are recorded as their compile state (fetch, streamout,
+ * blend) or as the LLVM bitcode of their module (VS, GS, FS).
+ */
+
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+
+#include "gallivm/lp_bld_init.h"
+#include <llvm-c/BitWriter.h>
+
+#include "swr_context.h"
+#include "swr_resource.h"
+#include "swr_capture.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* Granularity of the updates sent for modified objects */
+#define SWR_CAPTURE_UPDATE_CHUNK 256
+
+struct swr_capture_region {
+   uintptr_t end;
+   uint32_t id;
+   bool scratch;
+};
+
+struct swr_capture_object {
+   const uint8_t *base;
+   size_t size;
+   std::vector<uint8_t> shadow; /* contents as last recorded */
+   bool device_written;
+};
+
+struct swr_capture_shader {
+   uint32_t id;
+   SWR_CAPTURE_SHADER_TYPE type;
+   std::vector<uint8_t> data;
+};
+
+struct swr_capture_stream {
+   FILE *file;
+   HANDLE hContext;
+   SWR_INTERFACE api; /* the real entry points */
+
+   /* set by SwrGetPrivateContextState, recorded with the next work item */
+   void *private_state;
+
+   std::unordered_map<uint32_t, swr_capture_object> objects;
+   std::unordered_set<uint32_t> shaders;
+
+   /* objects the current state reads from */
+   uint32_t vertex_buffers[KNOB_NUM_STREAMS];
+   uint32_t index_buffer;
+   std::vector<uint32_t> private_objects;
+
+   /* objects bound as render targets, checksummed at the end of a frame */
+   std::unordered_set<uint32_t> render_targets;
+};
+
+struct swr_capture_state {
+   char *filename;
+   unsigned num_streams;
+
+   std::mutex mutex;
+   std::map<uintptr_t, swr_capture_region> regions; /* by start address */
+   std::unordered_map<uintptr_t, swr_capture_shader> shaders; /* by entry */
+   std::unordered_map<HANDLE, swr_capture_stream *> streams;
+   uint32_t next_object_id;
+   uint32_t next_shader_id;
+};
+
+static swr_capture_state *capture;
+
+
+void
+swr_capture_init(void)
+{
+   const char *filename = debug_get_option("SWR_CAPTURE", NULL);
+
+   if (capture || !filename || !*filename)
+      return;
+
+   capture = new swr_capture_state();
+   capture->filename = strdup(filename);
+}
+
+
+static void
+emit(swr_capture_stream *s, SWR_CAPTURE_CMD cmd,
+     const void *payload, size_t size,
+     const void *data = NULL, size_t data_size = 0,
+     const std::vector<SWR_CAPTURE_RELOC> *relocs = NULL)
+{
+   SWR_CAPTURE_CMD_HEADER header = {};
+   header.cmd = cmd;
+   header.numRelocs = relocs ? relocs->size() : 0;
+   header.size = size + data_size;
+
+   fwrite(&header, sizeof(header), 1, s->file);
+   if (size)
+      fwrite(payload, size, 1, s->file);
+   if (data_size)
+      fwrite(data, data_size, 1, s->file);
+   if (header.numRelocs)
+      fwrite(relocs->data(), sizeof(SWR_CAPTURE_RELOC), header.numRelocs,
+             s->file);
+}
+
+
+static swr_capture_stream *
+get_stream(HANDLE hContext)
+{
+   auto it = capture->streams.find(hContext);
+   assert(it != capture->streams.end());
+   return it->second;
+}
+
+
+/*
+ * Memory objects
+ */
+
+static const swr_capture_region *
+find_region(uintptr_t addr, uintptr_t *start)
+{
+   auto it = capture->regions.upper_bound(addr);
+   if (it == capture->regions.begin())
+      return NULL;
+   --it;
+   if (addr >= it->second.end)
+      return NULL;
+
+   *start = it->first;
+   return &it->second;
+}
+
+static void
+unregister_memory_locked(uintptr_t start)
+{
+   auto it = capture->regions.find(start);
+   if (it == capture->regions.end())
+      return;
+
+   for (auto &entry : capture->streams) {
+      swr_capture_stream *s = entry.second;
+
+      s->render_targets.erase(it->second.id);
+      if (s->objects.erase(it->second.id)) {
+         SWR_CAPTURE_OBJECT desc = {};
+         desc.id = it->second.id;
+         emit(s, SWR_CAPTURE_CMD_OBJECT_FREE, &desc, sizeof(desc));
+      }
+   }
+   capture->regions.erase(it);
+}
+
+void
+swr_capture_register_memory(const void *ptr, size_t size, bool scratch)
+{
+   if (!capture || !ptr || !size)
+      return;
+
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   unregister_memory_locked((uintptr_t)ptr);
+
+   swr_capture_region &region = capture->regions[(uintptr_t)ptr];
+   region.end = (uintptr_t)ptr + size;
+   region.id = ++capture->next_object_id;
+   region.scratch = scratch;
+}
+
+void
+swr_capture_unregister_memory(const void *ptr)
+{
+   if (!capture || !ptr)
+      return;
+
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   unregister_memory_locked((uintptr_t)ptr);
+}
+
+static size_t
+surface_size(const SWR_SURFACE_STATE *surface)
+{
+   return (size_t)surface->depth * surface->qpitch * surface->pitch *
+      surface->numSamples;
+}
+
+void
+swr_capture_resource_create(struct swr_resource *res)
+{
+   swr_capture_register_memory((void *)res->swr.xpBaseAddress,
+                               surface_size(&res->swr), false);
+   swr_capture_register_memory((void *)res->secondary.xpBaseAddress,
+                               surface_size(&res->secondary), false);
+}
+
+void
+swr_capture_resource_destroy(struct swr_resource *res)
+{
+   swr_capture_unregister_memory((void *)res->swr.xpBaseAddress);
+   swr_capture_unregister_memory((void *)res->secondary.xpBaseAddress);
+}
+
+
+/* Records the whole object the first time a stream refers to it */
+static swr_capture_object *
+define_object(swr_capture_stream *s, uintptr_t start,
+              const swr_capture_region *region)
+{
+   auto it = s->objects.find(region->id);
+   if (it != s->objects.end())
+      return &it->second;
+
+   /* Queued work may still be writing to it */
+   s->api.pfnSwrWaitForIdle(s->hContext);
+
+   swr_capture_object &obj = s->objects[region->id];
+   obj.base = (const uint8_t *)start;
+   obj.size = region->end - start;
+   obj.shadow.assign(obj.base, obj.base + obj.size);
+   obj.device_written = false;
+
+   SWR_CAPTURE_OBJECT desc = {};
+   desc.id = region->id;
+   desc.size = obj.size;
+   emit(s, SWR_CAPTURE_CMD_OBJECT_DEFINE, &desc, sizeof(desc),
+        obj.base, obj.size);
+
+   return &obj;
+}
+
+/* Records the parts of an object which changed since the last time */
+static void
+update_object(swr_capture_stream *s, uint32_t id, swr_capture_object *obj,
+              uint32_t flags)
+{
+   size_t offset = 0;
+
+   while (offset < obj->size) {
+      size_t n = MIN2(SWR_CAPTURE_UPDATE_CHUNK, obj->size - offset);
+      if (!memcmp(obj->base + offset, &obj->shadow[offset], n)) {
+         offset += n;
+         continue;
+      }
+
+      /* Extend the range over the following modified chunks */
+      size_t start = offset;
+      offset += n;
+      while (offset < obj->size) {
+         n = MIN2(SWR_CAPTURE_UPDATE_CHUNK, obj->size - offset);
+         if (!memcmp(obj->base + offset, &obj->shadow[offset], n))
+            break;
+         offset += n;
+      }
+
+      memcpy(&obj->shadow[start], obj->base + start, offset - start);
+
+      SWR_CAPTURE_OBJECT desc = {};
+      desc.id = id;
+      desc.flags = flags;
+      desc.offset = start;
+      desc.size = offset - start;
+      emit(s, SWR_CAPTURE_CMD_OBJECT_UPDATE, &desc, sizeof(desc),
+           obj->base + start, offset - start);
+   }
+}
+
+static void
+sync_object(swr_capture_stream *s, uint32_t id)
+{
+   auto it = s->objects.find(id);
+   if (it != s->objects.end() && !it->second.device_written)
+      update_object(s, id, &it->second, 0);
+}
+
+
+/*
+ * Relocations.  The pointer at 'slot' within 'payload' gets recorded
+ * relative to the object containing 'probe', which is the pointer itself
+ * unless it may point before the memory actually accessed, and cleared.
+ * Returns the id of the object, or 0 if there is none, in which case the
+ * pointer is recorded as null.
+ */
+static uint32_t
+reloc_pointer(swr_capture_stream *s, std::vector<SWR_CAPTURE_RELOC> &relocs,
+              const void *payload, void *slot, uintptr_t probe,
+              bool device_written)
+{
+   uint64_t ptr;
+   uintptr_t start;
+
+   memcpy(&ptr, slot, sizeof(ptr));
+   memset(slot, 0, sizeof(ptr));
+   if (!ptr)
+      return 0;
+
+   const swr_capture_region *region = find_region(probe, &start);
+   if (!region)
+      return 0;
+
+   swr_capture_object *obj = define_object(s, start, region);
+   obj->device_written |= device_written;
+
+   SWR_CAPTURE_RELOC reloc = {};
+   reloc.offset = (const uint8_t *)slot - (const uint8_t *)payload;
+   reloc.type = SWR_CAPTURE_RELOC_OBJECT;
+   reloc.id = region->id;
+   reloc.delta = (int64_t)(ptr - start);
+   relocs.push_back(reloc);
+
+   return region->id;
+}
+
+/* For memory only valid for the call, recorded along with it */
+static void
+reloc_transient(swr_capture_stream *s, std::vector<SWR_CAPTURE_RELOC> &relocs,
+                const void *payload, void *slot, size_t size)
+{
+   uint64_t ptr;
+
+   memcpy(&ptr, slot, sizeof(ptr));
+   memset(slot, 0, sizeof(ptr));
+   if (!ptr || !size)
+      return;
+
+   SWR_CAPTURE_OBJECT desc = {};
+   desc.id = ++capture->next_object_id;
+   desc.flags = SWR_CAPTURE_OBJECT_TRANSIENT;
+   desc.size = size;
+   emit(s, SWR_CAPTURE_CMD_OBJECT_DEFINE, &desc, sizeof(desc),
+        (const void *)(uintptr_t)ptr, size);
+
+   SWR_CAPTURE_RELOC reloc = {};
+   reloc.offset = (const uint8_t *)slot - (const uint8_t *)payload;
+   reloc.type = SWR_CAPTURE_RELOC_OBJECT;
+   reloc.id = desc.id;
+   relocs.push_back(reloc);
+}
+
+static void
+reloc_shader(swr_capture_stream *s, std::vector<SWR_CAPTURE_RELOC> &relocs,
+             const void *payload, void *slot)
+{
+   uint64_t func;
+
+   memcpy(&func, slot, sizeof(func));
+   memset(slot, 0, sizeof(func));
+   if (!func)
+      return;
+
+   auto it = capture->shaders.find((uintptr_t)func);
+   if (it == capture->shaders.end()) {
+      static bool warned;
+      if (!warned) {
+         fprintf(stderr, "SWR_CAPTURE: unknown jitted function, "
+                 "recording as null\n");
+         warned = true;
+      }
+      return;
+   }
+
+   const swr_capture_shader &shader = it->second;
+   if (s->shaders.insert(shader.id).second) {
+      SWR_CAPTURE_SHADER desc = {};
+      desc.id = shader.id;
+      desc.type = shader.type;
+      desc.size = shader.data.size();
+      emit(s, SWR_CAPTURE_CMD_SHADER_DEFINE, &desc, sizeof(desc),
+           shader.data.data(), shader.data.size());
+   }
+
+   SWR_CAPTURE_RELOC reloc = {};
+   reloc.offset = (const uint8_t *)slot - (const uint8_t *)payload;
+   reloc.type = SWR_CAPTURE_RELOC_SHADER;
+   reloc.id = shader.id;
+   relocs.push_back(reloc);
+}
+
+
+/*
+ * Private state, laid out as swr_draw_context
+ */
+
+static uint32_t
+reloc_private(swr_capture_stream *s, std::vector<SWR_CAPTURE_RELOC> &relocs,
+              const swr_draw_context *dc, void *slot, bool device_written)
+{
+   uintptr_t ptr;
+
+   memcpy(&ptr, slot, sizeof(ptr));
+   uint32_t id = reloc_pointer(s, relocs, dc, slot, ptr, device_written);
+   if (id)
+      s->private_objects.push_back(id);
+   return id;
+}
+
+static void
+reloc_constants(swr_capture_stream *s, std::vector<SWR_CAPTURE_RELOC> &relocs,
+                swr_draw_context *dc, const float **constants,
+                const uint32_t *num_constants)
+{
+   /* Slots past the bound buffers may hold stale pointers */
+   for (unsigned i = 0; i < PIPE_MAX_CONSTANT_BUFFERS; i++) {
+      if (num_constants[i])
+         reloc_private(s, relocs, dc, &constants[i], false);
+      else
+         constants[i] = NULL;
+   }
+}
+
+static void
+reloc_textures(swr_capture_stream *s, std::vector<SWR_CAPTURE_RELOC> &relocs,
+               swr_draw_context *dc, swr_jit_texture *textures)
+{
+   for (unsigned i = 0; i < PIPE_MAX_SHADER_SAMPLER_VIEWS; i++)
+      reloc_private(s, relocs, dc, &textures[i].base_ptr, false);
+}
+
+static void
+flush_private_state(swr_capture_stream *s)
+{
+   if (!s->private_state)
+      return;
+
+   swr_draw_context dc;
+   std::vector<SWR_CAPTURE_RELOC> relocs;
+
+   memcpy(&dc, s->private_state, sizeof(dc));
+   s->private_state = NULL;
+   s->private_objects.clear();
+
+   reloc_constants(s, relocs, &dc, dc.constantVS, dc.num_constantsVS);
+   reloc_constants(s, relocs, &dc, dc.constantFS, dc.num_constantsFS);
+   reloc_constants(s, relocs, &dc, dc.constantGS, dc.num_constantsGS);
+   reloc_textures(s, relocs, &dc, dc.texturesVS);
+   reloc_textures(s, relocs, &dc, dc.texturesFS);
+   reloc_textures(s, relocs, &dc, dc.texturesGS);
+
+   for (unsigned i = 0; i < SWR_NUM_ATTACHMENTS; i++) {
+      SWR_SURFACE_STATE *rt = &dc.renderTargets[i];
+
+      uint32_t id = reloc_private(s, relocs, &dc, &rt->xpBaseAddress, true);
+      if (id)
+         s->render_targets.insert(id);
+
+      /* Multisample resolve targets are referenced by their surface state */
+      if (rt->xpAuxBaseAddress) {
+         static bool warned;
+         if (!warned) {
+            fprintf(stderr, "SWR_CAPTURE: multisample resolves are not "
+                    "recorded\n");
+            warned = true;
+         }
+         rt->xpAuxBaseAddress = 0;
+      }
+   }
+
+   /* Only used by the driver's callbacks */
+   dc.pStats = NULL;
+   dc.pAPI = NULL;
+
+   emit(s, SWR_CAPTURE_CMD_PRIVATE_STATE, &dc, sizeof(dc), NULL, 0, &relocs);
+}
+
+/* Before any call creating a draw context */
+static void
+begin_work(swr_capture_stream *s, bool draw)
+{
+   if (draw)
+      s->api.pfnSwrWaitForIdle(s->hContext);
+
+   flush_private_state(s);
+
+   if (!draw)
+      return;
+
+   for (unsigned i = 0; i < KNOB_NUM_STREAMS; i++) {
+      if (s->vertex_buffers[i])
+         sync_object(s, s->vertex_buffers[i]);
+   }
+   if (s->index_buffer)
+      sync_object(s, s->index_buffer);
+   for (uint32_t id : s->private_objects)
+      sync_object(s, id);
+}
+
+
+/*
+ * SWR_INTERFACE wrappers
+ */
+
+static void SWR_API
+capture_SwrDestroyContext(HANDLE hContext)
+{
+   PFNSwrDestroyContext pfnDestroy;
+   {
+      std::lock_guard<std::mutex> lock(capture->mutex);
+      swr_capture_stream *s = get_stream(hContext);
+
+      if (fclose(s->file))
+         fprintf(stderr, "SWR_CAPTURE: error writing the recording\n");
+
+      pfnDestroy = s->api.pfnSwrDestroyContext;
+      capture->streams.erase(hContext);
+      delete s;
+   }
+
+   pfnDestroy(hContext);
+}
+
+static void SWR_API
+capture_SwrSync(HANDLE hContext, PFN_CALLBACK_FUNC pfnFunc,
+                uint64_t userData, uint64_t userData2, uint64_t userData3)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+
+   begin_work(s, false);
+   emit(s, SWR_CAPTURE_CMD_SYNC, NULL, 0);
+   s->api.pfnSwrSync(hContext, pfnFunc, userData, userData2, userData3);
+}
+
+#define CAPTURE_NO_ARGS(func, cmd)                                   \
+static void SWR_API                                                  \
+capture_##func(HANDLE hContext)                                      \
+{                                                                    \
+   std::lock_guard<std::mutex> lock(capture->mutex);                 \
+   swr_capture_stream *s = get_stream(hContext);                     \
+                                                                     \
+   emit(s, cmd, NULL, 0);                                            \
+   s->api.pfn##func(hContext);                                       \
+}
+
+CAPTURE_NO_ARGS(SwrStallBE, SWR_CAPTURE_CMD_STALL_BE)
+CAPTURE_NO_ARGS(SwrWaitForIdle, SWR_CAPTURE_CMD_WAIT_FOR_IDLE)
+CAPTURE_NO_ARGS(SwrWaitForIdleFE, SWR_CAPTURE_CMD_WAIT_FOR_IDLE_FE)
+
+static void SWR_API
+capture_SwrEndFrame(HANDLE hContext)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+
+   s->api.pfnSwrEndFrame(hContext);
+   s->api.pfnSwrWaitForIdle(hContext);
+
+   /* Same as swr_replay -c computes, over the objects still alive */
+   std::vector<uint32_t> ids(s->render_targets.begin(),
+                             s->render_targets.end());
+   std::sort(ids.begin(), ids.end());
+
+   SWR_CAPTURE_FRAME frame = {};
+   frame.checksum = SWR_CAPTURE_CHECKSUM_INIT;
+   for (uint32_t id : ids) {
+      const swr_capture_object &obj = s->objects[id];
+      frame.checksum = SwrCaptureChecksum(frame.checksum, obj.base, obj.size);
+   }
+
+   emit(s, SWR_CAPTURE_CMD_END_FRAME, &frame, sizeof(frame));
+   fflush(s->file);
+}
+
+static void SWR_API
+capture_SwrSetVertexBuffers(HANDLE hContext, uint32_t numBuffers,
+                            const SWR_VERTEX_BUFFER_STATE *pVertexBuffers)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   std::vector<SWR_CAPTURE_RELOC> relocs;
+   std::vector<uint8_t> payload(sizeof(SWR_CAPTURE_COUNT) +
+                                numBuffers * sizeof(*pVertexBuffers));
+
+   SWR_CAPTURE_COUNT *count = (SWR_CAPTURE_COUNT *)payload.data();
+   SWR_VERTEX_BUFFER_STATE *vbs = (SWR_VERTEX_BUFFER_STATE *)(count + 1);
+   count->count = numBuffers;
+   memcpy(vbs, pVertexBuffers, numBuffers * sizeof(*pVertexBuffers));
+
+   for (uint32_t i = 0; i < numBuffers; i++) {
+      SWR_VERTEX_BUFFER_STATE *vb = &vbs[i];
+      uintptr_t end = vb->xpData + MAX2((size_t)vb->maxVertex * vb->pitch +
+                                        vb->partialInboundsSize, vb->size);
+      uintptr_t start;
+
+      /* Client arrays copied to scratch space are addressed relative to
+       * the first vertex of the draw, which may be outside of it, so look
+       * those up by their end. */
+      const swr_capture_region *region = find_region(end - 1, &start);
+      uintptr_t probe = region && region->scratch ? end - 1 : vb->xpData;
+
+      uint32_t id = reloc_pointer(s, relocs, payload.data(), &vb->xpData,
+                                  probe, false);
+      if (!id && pVertexBuffers[i].xpData)
+         reloc_transient(s, relocs, payload.data(), &vb->xpData,
+                         end - pVertexBuffers[i].xpData);
+
+      if (vb->index < KNOB_NUM_STREAMS)
+         s->vertex_buffers[vb->index] = id;
+   }
+
+   emit(s, SWR_CAPTURE_CMD_SET_VERTEX_BUFFERS, payload.data(), payload.size(),
+        NULL, 0, &relocs);
+   s->api.pfnSwrSetVertexBuffers(hContext, numBuffers, pVertexBuffers);
+}
+
+static void SWR_API
+capture_SwrSetIndexBuffer(HANDLE hContext,
+                          const SWR_INDEX_BUFFER_STATE *pIndexBuffer)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   std::vector<SWR_CAPTURE_RELOC> relocs;
+   SWR_INDEX_BUFFER_STATE ib = *pIndexBuffer;
+
+   s->index_buffer = reloc_pointer(s, relocs, &ib, &ib.xpIndices,
+                                   ib.xpIndices, false);
+   if (!s->index_buffer && pIndexBuffer->xpIndices)
+      reloc_transient(s, relocs, &ib, &ib.xpIndices, ib.size);
+
+   emit(s, SWR_CAPTURE_CMD_SET_INDEX_BUFFER, &ib, sizeof(ib),
+        NULL, 0, &relocs);
+   s->api.pfnSwrSetIndexBuffer(hContext, pIndexBuffer);
+}
+
+static void
+record_func(swr_capture_stream *s, SWR_CAPTURE_CMD cmd, const void *func,
+            uint32_t index)
+{
+   std::vector<SWR_CAPTURE_RELOC> relocs;
+   SWR_CAPTURE_FUNC payload = {};
+
+   payload.pfnFunc = (uintptr_t)func;
+   payload.index = index;
+   reloc_shader(s, relocs, &payload, &payload.pfnFunc);
+   emit(s, cmd, &payload, sizeof(payload), NULL, 0, &relocs);
+}
+
+#define CAPTURE_FUNC(func, cmd, type)                                \
+static void SWR_API                                                  \
+capture_##func(HANDLE hContext, type pfnFunc)                        \
+{                                                                    \
+   std::lock_guard<std::mutex> lock(capture->mutex);                 \
+   swr_capture_stream *s = get_stream(hContext);                     \
+                                                                     \
+   record_func(s, cmd, (const void *)pfnFunc, 0);                    \
+   s->api.pfn##func(hContext, pfnFunc);                              \
+}
+
+CAPTURE_FUNC(SwrSetFetchFunc, SWR_CAPTURE_CMD_SET_FETCH_FUNC, PFN_FETCH_FUNC)
+CAPTURE_FUNC(SwrSetVertexFunc, SWR_CAPTURE_CMD_SET_VERTEX_FUNC,
+             PFN_VERTEX_FUNC)
+CAPTURE_FUNC(SwrSetGsFunc, SWR_CAPTURE_CMD_SET_GS_FUNC, PFN_GS_FUNC)
+
+static void SWR_API
+capture_SwrSetSoFunc(HANDLE hContext, PFN_SO_FUNC pfnSoFunc,
+                     uint32_t streamIndex)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+
+   record_func(s, SWR_CAPTURE_CMD_SET_SO_FUNC, (const void *)pfnSoFunc,
+               streamIndex);
+   s->api.pfnSwrSetSoFunc(hContext, pfnSoFunc, streamIndex);
+}
+
+static void SWR_API
+capture_SwrSetBlendFunc(HANDLE hContext, uint32_t renderTarget,
+                        PFN_BLEND_JIT_FUNC pfnBlendFunc)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+
+   record_func(s, SWR_CAPTURE_CMD_SET_BLEND_FUNC, (const void *)pfnBlendFunc,
+               renderTarget);
+   s->api.pfnSwrSetBlendFunc(hContext, renderTarget, pfnBlendFunc);
+}
+
+static void SWR_API
+capture_SwrSetPixelShaderState(HANDLE hContext, SWR_PS_STATE *pState)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   std::vector<SWR_CAPTURE_RELOC> relocs;
+   SWR_PS_STATE state = *pState;
+
+   reloc_shader(s, relocs, &state, &state.pfnPixelShader);
+   emit(s, SWR_CAPTURE_CMD_SET_PIXEL_SHADER_STATE, &state, sizeof(state),
+        NULL, 0, &relocs);
+   s->api.pfnSwrSetPixelShaderState(hContext, pState);
+}
+
+static void SWR_API
+capture_SwrSetSoBuffers(HANDLE hContext, SWR_STREAMOUT_BUFFER *pSoBuffer,
+                        uint32_t slot)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   std::vector<SWR_CAPTURE_RELOC> relocs;
+   SWR_CAPTURE_SO_BUFFER payload = {};
+
+   payload.slot = slot;
+   payload.buffer = *pSoBuffer;
+   reloc_pointer(s, relocs, &payload, &payload.buffer.pBuffer,
+                 (uintptr_t)payload.buffer.pBuffer, true);
+   reloc_pointer(s, relocs, &payload, &payload.buffer.pWriteOffset,
+                 (uintptr_t)payload.buffer.pWriteOffset, true);
+   emit(s, SWR_CAPTURE_CMD_SET_SO_BUFFERS, &payload, sizeof(payload),
+        NULL, 0, &relocs);
+   s->api.pfnSwrSetSoBuffers(hContext, pSoBuffer, slot);
+}
+
+/* State without pointers */
+#define CAPTURE_STATE(func, cmd, type)                               \
+static void SWR_API                                                  \
+capture_##func(HANDLE hContext, type *pState)                        \
+{                                                                    \
+   std::lock_guard<std::mutex> lock(capture->mutex);                 \
+   swr_capture_stream *s = get_stream(hContext);                     \
+                                                                     \
+   emit(s, cmd, pState, sizeof(*pState));                            \
+   s->api.pfn##func(hContext, pState);                               \
+}
+
+CAPTURE_STATE(SwrSetSoState, SWR_CAPTURE_CMD_SET_SO_STATE,
+              SWR_STREAMOUT_STATE)
+CAPTURE_STATE(SwrSetFrontendState, SWR_CAPTURE_CMD_SET_FRONTEND_STATE,
+              SWR_FRONTEND_STATE)
+CAPTURE_STATE(SwrSetGsState, SWR_CAPTURE_CMD_SET_GS_STATE, SWR_GS_STATE)
+CAPTURE_STATE(SwrSetDepthStencilState,
+              SWR_CAPTURE_CMD_SET_DEPTH_STENCIL_STATE,
+              SWR_DEPTH_STENCIL_STATE)
+CAPTURE_STATE(SwrSetBackendState, SWR_CAPTURE_CMD_SET_BACKEND_STATE,
+              SWR_BACKEND_STATE)
+CAPTURE_STATE(SwrSetDepthBoundsState, SWR_CAPTURE_CMD_SET_DEPTH_BOUNDS_STATE,
+              SWR_DEPTH_BOUNDS_STATE)
+CAPTURE_STATE(SwrSetBlendState, SWR_CAPTURE_CMD_SET_BLEND_STATE,
+              SWR_BLEND_STATE)
+CAPTURE_STATE(SwrSetRastState, SWR_CAPTURE_CMD_SET_RAST_STATE,
+              const SWR_RASTSTATE)
+
+static void SWR_API
+capture_SwrSetViewports(HANDLE hContext, uint32_t numViewports,
+                        const SWR_VIEWPORT *pViewports,
+                        const SWR_VIEWPORT_MATRICES *pMatrices)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_COUNT count = {};
+   std::vector<uint8_t> payload;
+
+   count.count = numViewports;
+   count.flags = pMatrices != NULL;
+   payload.insert(payload.end(), (const uint8_t *)&count,
+                  (const uint8_t *)(&count + 1));
+   payload.insert(payload.end(), (const uint8_t *)pViewports,
+                  (const uint8_t *)(pViewports + numViewports));
+   if (pMatrices)
+      payload.insert(payload.end(), (const uint8_t *)pMatrices,
+                     (const uint8_t *)(pMatrices + 1));
+
+   emit(s, SWR_CAPTURE_CMD_SET_VIEWPORTS, payload.data(), payload.size());
+   s->api.pfnSwrSetViewports(hContext, numViewports, pViewports, pMatrices);
+}
+
+static void SWR_API
+capture_SwrSetScissorRects(HANDLE hContext, uint32_t numScissors,
+                           const SWR_RECT *pScissors)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_COUNT count = {};
+
+   count.count = numScissors;
+   emit(s, SWR_CAPTURE_CMD_SET_SCISSOR_RECTS, &count, sizeof(count),
+        pScissors, numScissors * sizeof(*pScissors));
+   s->api.pfnSwrSetScissorRects(hContext, numScissors, pScissors);
+}
+
+static void * SWR_API
+capture_SwrGetPrivateContextState(HANDLE hContext)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+
+   s->private_state = s->api.pfnSwrGetPrivateContextState(hContext);
+   return s->private_state;
+}
+
+static void SWR_API
+capture_SwrEnableStatsFE(HANDLE hContext, bool enable)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   uint32_t payload = enable;
+
+   emit(s, SWR_CAPTURE_CMD_ENABLE_STATS_FE, &payload, sizeof(payload));
+   s->api.pfnSwrEnableStatsFE(hContext, enable);
+}
+
+static void SWR_API
+capture_SwrEnableStatsBE(HANDLE hContext, bool enable)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   uint32_t payload = enable;
+
+   emit(s, SWR_CAPTURE_CMD_ENABLE_STATS_BE, &payload, sizeof(payload));
+   s->api.pfnSwrEnableStatsBE(hContext, enable);
+}
+
+static void SWR_API
+capture_SwrDraw(HANDLE hContext, PRIMITIVE_TOPOLOGY topology,
+                uint32_t startVertex, uint32_t primCount)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_WORK work = {};
+
+   begin_work(s, true);
+   work.topology = topology;
+   work.args[0] = startVertex;
+   work.args[1] = primCount;
+   emit(s, SWR_CAPTURE_CMD_DRAW, &work, sizeof(work));
+   s->api.pfnSwrDraw(hContext, topology, startVertex, primCount);
+}
+
+static void SWR_API
+capture_SwrDrawInstanced(HANDLE hContext, PRIMITIVE_TOPOLOGY topology,
+                         uint32_t numVertsPerInstance, uint32_t numInstances,
+                         uint32_t startVertex, uint32_t startInstance)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_WORK work = {};
+
+   begin_work(s, true);
+   work.topology = topology;
+   work.args[0] = numVertsPerInstance;
+   work.args[1] = numInstances;
+   work.args[2] = startVertex;
+   work.args[3] = startInstance;
+   emit(s, SWR_CAPTURE_CMD_DRAW_INSTANCED, &work, sizeof(work));
+   s->api.pfnSwrDrawInstanced(hContext, topology, numVertsPerInstance,
+                              numInstances, startVertex, startInstance);
+}
+
+static void SWR_API
+capture_SwrDrawIndexed(HANDLE hContext, PRIMITIVE_TOPOLOGY topology,
+                       uint32_t numIndices, uint32_t indexOffset,
+                       int32_t baseVertex)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_WORK work = {};
+
+   begin_work(s, true);
+   work.topology = topology;
+   work.args[0] = numIndices;
+   work.args[1] = indexOffset;
+   work.args[2] = baseVertex;
+   emit(s, SWR_CAPTURE_CMD_DRAW_INDEXED, &work, sizeof(work));
+   s->api.pfnSwrDrawIndexed(hContext, topology, numIndices, indexOffset,
+                            baseVertex);
+}
+
+static void SWR_API
+capture_SwrDrawIndexedInstanced(HANDLE hContext, PRIMITIVE_TOPOLOGY topology,
+                                uint32_t numIndices, uint32_t numInstances,
+                                uint32_t indexOffset, int32_t baseVertex,
+                                uint32_t startInstance)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_WORK work = {};
+
+   begin_work(s, true);
+   work.topology = topology;
+   work.args[0] = numIndices;
+   work.args[1] = numInstances;
+   work.args[2] = indexOffset;
+   work.args[3] = baseVertex;
+   work.args[4] = startInstance;
+   emit(s, SWR_CAPTURE_CMD_DRAW_INDEXED_INSTANCED, &work, sizeof(work));
+   s->api.pfnSwrDrawIndexedInstanced(hContext, topology, numIndices,
+                                     numInstances, indexOffset, baseVertex,
+                                     startInstance);
+}
+
+static void SWR_API
+capture_SwrInvalidateTiles(HANDLE hContext, uint32_t attachmentMask,
+                           const SWR_RECT &invalidateRect)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_WORK work = {};
+
+   begin_work(s, false);
+   work.attachmentMask = attachmentMask;
+   work.rect = invalidateRect;
+   emit(s, SWR_CAPTURE_CMD_INVALIDATE_TILES, &work, sizeof(work));
+   s->api.pfnSwrInvalidateTiles(hContext, attachmentMask, invalidateRect);
+}
+
+static void SWR_API
+capture_SwrDiscardRect(HANDLE hContext, uint32_t attachmentMask,
+                       const SWR_RECT &rect)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_WORK work = {};
+
+   begin_work(s, false);
+   work.attachmentMask = attachmentMask;
+   work.rect = rect;
+   emit(s, SWR_CAPTURE_CMD_DISCARD_RECT, &work, sizeof(work));
+   s->api.pfnSwrDiscardRect(hContext, attachmentMask, rect);
+}
+
+static void SWR_API
+capture_SwrStoreTiles(HANDLE hContext, uint32_t attachmentMask,
+                      SWR_TILE_STATE postStoreTileState,
+                      const SWR_RECT &storeRect)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_WORK work = {};
+
+   begin_work(s, false);
+   work.attachmentMask = attachmentMask;
+   work.tileState = postStoreTileState;
+   work.rect = storeRect;
+   emit(s, SWR_CAPTURE_CMD_STORE_TILES, &work, sizeof(work));
+   s->api.pfnSwrStoreTiles(hContext, attachmentMask, postStoreTileState,
+                           storeRect);
+}
+
+static void SWR_API
+capture_SwrClearRenderTarget(HANDLE hContext, uint32_t attachmentMask,
+                             uint32_t renderTargetArrayIndex,
+                             const float clearColor[4], float z,
+                             uint8_t stencil, const SWR_RECT &clearRect)
+{
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   swr_capture_stream *s = get_stream(hContext);
+   SWR_CAPTURE_WORK work = {};
+
+   begin_work(s, false);
+   work.attachmentMask = attachmentMask;
+   work.args[0] = renderTargetArrayIndex;
+   memcpy(work.clearColor, clearColor, sizeof(work.clearColor));
+   work.clearDepth = z;
+   work.clearStencil = stencil;
+   work.rect = clearRect;
+   emit(s, SWR_CAPTURE_CMD_CLEAR_RENDER_TARGET, &work, sizeof(work));
+   s->api.pfnSwrClearRenderTarget(hContext, attachmentMask,
+                                  renderTargetArrayIndex, clearColor, z,
+                                  stencil, clearRect);
+}
+
+
+void
+swr_capture_context_create(struct swr_context *ctx)
+{
+   if (!capture || !ctx->swrContext)
+      return;
+
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   char filename[4096];
+
+   if (capture->num_streams)
+      snprintf(filename, sizeof(filename), "%s.%u", capture->filename,
+               capture->num_streams);
+   else
+      snprintf(filename, sizeof(filename), "%s", capture->filename);
+   capture->num_streams++;
+
+   FILE *file = fopen(filename, "wb");
+   if (!file) {
+      fprintf(stderr, "SWR_CAPTURE: can't open %s\n", filename);
+      return;
+   }
+
+   swr_capture_stream *s = new swr_capture_stream();
+   s->file = file;
+   s->hContext = ctx->swrContext;
+   s->api = ctx->api;
+   capture->streams[ctx->swrContext] = s;
+
+   SWR_CAPTURE_HEADER header = {};
+   header.magic = SWR_CAPTURE_MAGIC;
+   header.version = SWR_CAPTURE_VERSION;
+   header.apiHash = SwrCaptureApiHash();
+   header.simdWidth = KNOB_SIMD_WIDTH;
+   header.privateStateSize = sizeof(swr_draw_context);
+   header.renderTargetsOffset = offsetof(swr_draw_context, renderTargets);
+   fwrite(&header, sizeof(header), 1, file);
+
+   /* The tile callbacks run on the worker threads, leave them alone */
+   SWR_INTERFACE *api = &ctx->api;
+   api->pfnSwrDestroyContext = capture_SwrDestroyContext;
+   api->pfnSwrSync = capture_SwrSync;
+   api->pfnSwrStallBE = capture_SwrStallBE;
+   api->pfnSwrWaitForIdle = capture_SwrWaitForIdle;
+   api->pfnSwrWaitForIdleFE = capture_SwrWaitForIdleFE;
+   api->pfnSwrSetVertexBuffers = capture_SwrSetVertexBuffers;
+   api->pfnSwrSetIndexBuffer = capture_SwrSetIndexBuffer;
+   api->pfnSwrSetFetchFunc = capture_SwrSetFetchFunc;
+   api->pfnSwrSetSoFunc = capture_SwrSetSoFunc;
+   api->pfnSwrSetSoState = capture_SwrSetSoState;
+   api->pfnSwrSetSoBuffers = capture_SwrSetSoBuffers;
+   api->pfnSwrSetVertexFunc = capture_SwrSetVertexFunc;
+   api->pfnSwrSetFrontendState = capture_SwrSetFrontendState;
+   api->pfnSwrSetGsState = capture_SwrSetGsState;
+   api->pfnSwrSetGsFunc = capture_SwrSetGsFunc;
+   api->pfnSwrSetDepthStencilState = capture_SwrSetDepthStencilState;
+   api->pfnSwrSetBackendState = capture_SwrSetBackendState;
+   api->pfnSwrSetDepthBoundsState = capture_SwrSetDepthBoundsState;
+   api->pfnSwrSetPixelShaderState = capture_SwrSetPixelShaderState;
+   api->pfnSwrSetBlendState = capture_SwrSetBlendState;
+   api->pfnSwrSetBlendFunc = capture_SwrSetBlendFunc;
+   api->pfnSwrDraw = capture_SwrDraw;
+   api->pfnSwrDrawInstanced = capture_SwrDrawInstanced;
+   api->pfnSwrDrawIndexed = capture_SwrDrawIndexed;
+   api->pfnSwrDrawIndexedInstanced = capture_SwrDrawIndexedInstanced;
+   api->pfnSwrInvalidateTiles = capture_SwrInvalidateTiles;
+   api->pfnSwrDiscardRect = capture_SwrDiscardRect;
+   api->pfnSwrStoreTiles = capture_SwrStoreTiles;
+   api->pfnSwrClearRenderTarget = capture_SwrClearRenderTarget;
+   api->pfnSwrSetRastState = capture_SwrSetRastState;
+   api->pfnSwrSetViewports = capture_SwrSetViewports;
+   api->pfnSwrSetScissorRects = capture_SwrSetScissorRects;
+   api->pfnSwrGetPrivateContextState = capture_SwrGetPrivateContextState;
+   api->pfnSwrEnableStatsFE = capture_SwrEnableStatsFE;
+   api->pfnSwrEnableStatsBE = capture_SwrEnableStatsBE;
+   api->pfnSwrEndFrame = capture_SwrEndFrame;
+
+   fprintf(stderr, "SWR_CAPTURE: recording to %s\n", filename);
+}
+
+
+/*
+ * CPU access
+ */
+
+/* The driver waited for the rasterizer before mapping, so does a replay */
+void
+swr_capture_transfer_wait(struct swr_context *ctx)
+{
+   if (!capture)
+      return;
+
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   auto it = capture->streams.find(ctx->swrContext);
+   if (it != capture->streams.end())
+      emit(it->second, SWR_CAPTURE_CMD_WAIT_FOR_IDLE, NULL, 0);
+}
+
+static void
+transfer_surface(const SWR_SURFACE_STATE *surface, bool unmap)
+{
+   auto region = capture->regions.find((uintptr_t)surface->xpBaseAddress);
+   if (!surface->xpBaseAddress || region == capture->regions.end())
+      return;
+
+   uint32_t id = region->second.id;
+   for (auto &entry : capture->streams) {
+      swr_capture_stream *s = entry.second;
+      auto it = s->objects.find(id);
+      if (it == s->objects.end())
+         continue;
+
+      swr_capture_object *obj = &it->second;
+      if (unmap) {
+         update_object(s, id, obj,
+                       obj->device_written ? SWR_CAPTURE_OBJECT_WAIT : 0);
+      } else if (obj->device_written) {
+         /* What the rasterizer wrote, which a replay does too */
+         s->api.pfnSwrWaitForIdle(s->hContext);
+         memcpy(obj->shadow.data(), obj->base, obj->size);
+      }
+   }
+}
+
+/* Before the CPU writes to a resource */
+void
+swr_capture_transfer_map(struct swr_resource *res)
+{
+   if (!capture)
+      return;
+
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   transfer_surface(&res->swr, false);
+   transfer_surface(&res->secondary, false);
+}
+
+/* After the CPU wrote to a resource */
+void
+swr_capture_transfer_unmap(struct swr_resource *res)
+{
+   if (!capture)
+      return;
+
+   std::lock_guard<std::mutex> lock(capture->mutex);
+   transfer_surface(&res->swr, true);
+   transfer_surface(&res->secondary, true);
+}
+
+
+/*
+ * Jitted functions
+ */
+
+static void
+register_shader(const void *func, SWR_CAPTURE_SHADER_TYPE type,
+                const void *data, size_t size)
+{
+   if (!capture || !func)
+      return;
+
+   std::lock_guard<std::mutex> lock(capture->mutex);
+
+   /* Entry points of freed variants get reused, so always renumber */
+   swr_capture_shader &shader = capture->shaders[(uintptr_t)func];
+   shader.id = ++capture->next_shader_id;
+   shader.type = type;
+   shader.data.assign((const uint8_t *)data, (const uint8_t *)data + size);
+}
+
+void
+swr_capture_jit_fetch(PFN_FETCH_FUNC func, const FETCH_COMPILE_STATE &state)
+{
+   register_shader((const void *)func, SWR_CAPTURE_SHADER_FETCH,
+                   &state, sizeof(state));
+}
+
+void
+swr_capture_jit_streamout(PFN_SO_FUNC func,
+                          const STREAMOUT_COMPILE_STATE &state)
+{
+   register_shader((const void *)func, SWR_CAPTURE_SHADER_STREAMOUT,
+                   &state, sizeof(state));
+}
+
+void
+swr_capture_jit_blend(PFN_BLEND_JIT_FUNC func,
+                      const BLEND_COMPILE_STATE &state)
+{
+   register_shader((const void *)func, SWR_CAPTURE_SHADER_BLEND,
+                   &state, sizeof(state));
+}
+
+void
+swr_capture_jit_shader(const void *func, SWR_CAPTURE_SHADER_TYPE type,
+                       struct gallivm_state *gallivm)
+{
+   if (!capture || !func)
+      return;
+
+   LLVMMemoryBufferRef buffer = LLVMWriteBitcodeToMemoryBuffer(gallivm->module);
+   register_shader(func, type, LLVMGetBufferStart(buffer),
+                   LLVMGetBufferSize(buffer));
+   LLVMDisposeMemoryBuffer(buffer);
+}
@@ -0,0 +1,65 @@
+/****************************************************************************
+ * Copyright (C) 2026 agent.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ***************************************************************************/
+
+#ifndef SWR_CAPTURE_H
+#define SWR_CAPTURE_H
+
+#include "jit_api.h"
+#include "replay/capture_format.h"
+
+struct swr_context;
+struct swr_resource;
+struct gallivm_state;
+
+/*
+ * Recording of the SWR API calls made by the driver, for playback with
+ * swr_replay.  Everything is a no-op unless SWR_CAPTURE is set.
+ */
+
+void swr_capture_init(void);
+
+/* Starts recording a context, by wrapping its SWR_INTERFACE */
+void swr_capture_context_create(struct swr_context *ctx);
+
+/* Memory the rasterizer may be pointed at */
+void swr_capture_register_memory(const void *ptr, size_t size, bool scratch);
+void swr_capture_unregister_memory(const void *ptr);
+void swr_capture_resource_create(struct swr_resource *res);
+void swr_capture_resource_destroy(struct swr_resource *res);
+
+/* CPU access to resources */
+void swr_capture_transfer_wait(struct swr_context *ctx);
+void swr_capture_transfer_map(struct swr_resource *res);
+void swr_capture_transfer_unmap(struct swr_resource *res);
+
+/* Jitted functions, recorded so a replay can rebuild them */
+void swr_capture_jit_fetch(PFN_FETCH_FUNC func,
+                           const FETCH_COMPILE_STATE &state);
+void swr_capture_jit_streamout(PFN_SO_FUNC func,
+                               const STREAMOUT_COMPILE_STATE &state);
+void swr_capture_jit_blend(PFN_BLEND_JIT_FUNC func,
+                           const BLEND_COMPILE_STATE &state);
+void swr_capture_jit_shader(const void *func, SWR_CAPTURE_SHADER_TYPE type,
+                            struct gallivm_state *gallivm);
+
+#endif
@@ -28,6 +28,7 @@
 #include "swr_scratch.h"
 #include "swr_query.h"
 #include "swr_fence.h"
+#include "swr_capture.h"
 
 #include "util/u_memory.h"
 #include "util/u_inlines.h"
@@ -126,10 +127,14 @@ swr_transfer_map(struct pipe_context *pipe,
 
             swr_fence_finish(pipe->screen, NULL, screen->flush_fence, 0);
             swr_resource_unused(resource);
+            swr_capture_transfer_wait(swr_context(pipe));
          }
       }
    }
 
+   if (usage & PIPE_TRANSFER_WRITE)
+      swr_capture_transfer_map(spr);
+
    pt = CALLOC_STRUCT(pipe_transfer);
    if (!pt)
       return NULL;
@@ -231,6 +236,9 @@ swr_transfer_unmap(struct pipe_context *pipe, struct pipe_transfer *transfer)
       swr_transfer_flush_region(pipe, transfer, &box);
    }
 
+   if (transfer->usage & PIPE_TRANSFER_WRITE)
+      swr_capture_transfer_unmap(spr);
+
    pipe_resource_reference(&transfer->resource, NULL);
    FREE(transfer);
 }
@@ -525,6 +533,8 @@ swr_create_context(struct pipe_screen *p_screen, void *priv, unsigned flags)
    if (ctx->swrContext == NULL)
       goto fail;
 
+   swr_capture_context_create(ctx);
+
    ctx->pipe.screen = p_screen;
    ctx->pipe.destroy = swr_destroy;
    ctx->pipe.priv = priv;
@@ -26,6 +26,7 @@
 #include "swr_resource.h"
 #include "swr_fence.h"
 #include "swr_query.h"
+#include "swr_capture.h"
 #include "jit_api.h"
 
 #include "util/u_draw.h"
@@ -104,6 +105,7 @@ swr_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
 
          HANDLE hJitMgr = swr_screen(pipe->screen)->hJitMgr;
          ctx->vs->soFunc[info->mode] = JitCompileStreamout(hJitMgr, state);
+         swr_capture_jit_streamout(ctx->vs->soFunc[info->mode], state);
          debug_printf("so shader    %p\n", ctx->vs->soFunc[info->mode]);
          assert(ctx->vs->soFunc[info->mode] && "Error: SoShader = NULL");
       }
@@ -127,6 +129,7 @@ swr_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    } else {
       HANDLE hJitMgr = swr_screen(ctx->pipe.screen)->hJitMgr;
       velems->fsFunc = JitCompileFetch(hJitMgr, velems->fsState);
+      swr_capture_jit_fetch(velems->fsFunc, velems->fsState);
 
       debug_printf("fetch shader %p\n", velems->fsFunc);
       assert(velems->fsFunc && "Error: FetchShader = NULL");
@@ -26,6 +26,7 @@
 #include "swr_screen.h"
 #include "swr_scratch.h"
 #include "swr_fence_work.h"
+#include "swr_capture.h"
 #include "api.h"
 
 void *
@@ -46,6 +47,8 @@ swr_copy_to_scratch_space(struct swr_context *ctx,
       space->current_size = max_size_in_flight;
 
       if (space->base) {
+         swr_capture_unregister_memory(space->base);
+
          /* defer delete, use aligned-free */
          struct swr_screen *screen = swr_screen(ctx->pipe.screen);
          swr_fence_work_free(screen->flush_fence, space->base, true);
@@ -56,6 +59,7 @@ swr_copy_to_scratch_space(struct swr_context *ctx,
          space->base = (uint8_t *)AlignedMalloc(space->current_size,
                                                 sizeof(void *));
          space->head = (void *)space->base;
+         swr_capture_register_memory(space->base, space->current_size, true);
       }
    }
 
@@ -91,6 +95,11 @@ swr_destroy_scratch_buffers(struct swr_context *ctx)
    struct swr_scratch_buffers *scratch = ctx->scratch;
 
    if (scratch) {
+      swr_capture_unregister_memory(scratch->vs_constants.base);
+      swr_capture_unregister_memory(scratch->fs_constants.base);
+      swr_capture_unregister_memory(scratch->gs_constants.base);
+      swr_capture_unregister_memory(scratch->vertex_buffer.base);
+      swr_capture_unregister_memory(scratch->index_buffer.base);
       AlignedFree(scratch->vs_constants.base);
       AlignedFree(scratch->fs_constants.base);
       AlignedFree(scratch->gs_constants.base);
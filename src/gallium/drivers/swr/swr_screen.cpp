@@ -26,6 +26,7 @@
 #include "swr_screen.h"
 #include "swr_resource.h"
 #include "swr_fence.h"
+#include "swr_capture.h"
 #include "gen_knobs.h"
 
 #include "pipe/p_screen.h"
@@ -676,6 +677,9 @@ swr_displaytarget_layout(struct swr_screen *screen, struct swr_resource *res)
    res->display_target = dt;
    res->swr.xpBaseAddress = (gfxptr_t)map;
 
+   /* The winsys owns this memory, register what it allocated */
+   swr_capture_register_memory(map, (size_t)height * stride, false);
+
    /* Clear the display target surface */
    if (map)
       memset(map, 0, height * stride);
@@ -871,6 +875,8 @@ swr_texture_layout(struct swr_screen *screen,
             return false;
          }
       }
+
+      swr_capture_resource_create(res);
    }
 
    return true;
@@ -909,7 +915,9 @@ swr_create_resolve_resource(struct pipe_screen *_screen,
        * display_target has been created already. */
       if (msaa_res->base.bind & (PIPE_BIND_DISPLAY_TARGET | PIPE_BIND_SCANOUT
                | PIPE_BIND_SHARED)) {
-         /* Allocate the multisample buffers. */
+         /* Allocate the multisample buffers.  The rasterizer renders to
+          * those rather than to the display target memory. */
+         swr_capture_unregister_memory((void *)msaa_res->swr.xpBaseAddress);
          if (!swr_texture_layout(screen, msaa_res, true))
             return false;
 
@@ -984,6 +992,7 @@ swr_resource_create(struct pipe_screen *_screen,
    return &res->base;
 
 fail:
+   swr_capture_resource_destroy(res);
    FREE(res);
    return NULL;
 }
@@ -994,6 +1003,10 @@ swr_resource_destroy(struct pipe_screen *p_screen, struct pipe_resource *pt)
    struct swr_screen *screen = swr_screen(p_screen);
    struct swr_resource *spr = swr_resource(pt);
 
+   swr_capture_resource_destroy(spr);
+   if (spr->resolve_target)
+      swr_capture_resource_destroy(swr_resource(spr->resolve_target));
+
    if (spr->display_target) {
       /* If resource is display target, winsys manages the buffer and will
        * free it on displaytarget_destroy. */
@@ -1187,6 +1200,8 @@ swr_create_screen_internal(struct sw_winsys *winsys)
 
    swr_validate_env_options(screen);
 
+   swr_capture_init();
+
    return &screen->base;
 }
 
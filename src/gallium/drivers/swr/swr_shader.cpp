@@ -48,6 +48,7 @@
 #include "swr_resource.h"
 #include "swr_state.h"
 #include "swr_screen.h"
+#include "swr_capture.h"
 
 using namespace SwrJit;
 using namespace llvm;
@@ -214,7 +215,7 @@ struct BuilderSWR : public Builder {
       : Builder(pJitMgr)
    {
       pJitMgr->SetupNewModule();
-      gallivm = gallivm_create(pName, wrap(&JM()->mContext));
+      gallivm = gallivm_create(pName, wrap(&JM()->mContext), NULL);
       pJitMgr->mpCurrentModule = unwrap(gallivm->module);
    }
 
@@ -690,7 +691,9 @@ BuilderSWR::CompileGS(struct swr_context *ctx, swr_jit_gs_key &key)
                      NULL, // thread data
                      sampler,
                      &gs->info.base,
-                     &gs_iface.base);
+                     &gs_iface.base,
+                     NULL, // compute shader face
+                     NULL); // tessellation shader face
 
    lp_build_mask_end(&mask);
 
@@ -721,6 +724,8 @@ swr_compile_gs(struct swr_context *ctx, swr_jit_gs_key &key)
       reinterpret_cast<JitManager *>(swr_screen(ctx->pipe.screen)->hJitMgr),
       "GS");
    PFN_GS_FUNC func = builder.CompileGS(ctx, key);
+   swr_capture_jit_shader((const void *)func, SWR_CAPTURE_SHADER_GEOMETRY,
+                          builder.gallivm);
 
    ctx->gs->map.insert(std::make_pair(key, make_unique<VariantGS>(builder.gallivm, func)));
    return func;
@@ -841,7 +846,9 @@ BuilderSWR::CompileVS(struct swr_context *ctx, swr_jit_vs_key &key)
                      NULL, // thread data
                      sampler, // sampler
                      &swr_vs->info.base,
-                     NULL); // geometry shader face
+                     NULL, // geometry shader face
+                     NULL, // compute shader face
+                     NULL); // tessellation shader face
 
    sampler->destroy(sampler);
 
@@ -975,6 +982,8 @@ swr_compile_vs(struct swr_context *ctx, swr_jit_vs_key &key)
       reinterpret_cast<JitManager *>(swr_screen(ctx->pipe.screen)->hJitMgr),
       "VS");
    PFN_VERTEX_FUNC func = builder.CompileVS(ctx, key);
+   swr_capture_jit_shader((const void *)func, SWR_CAPTURE_SHADER_VERTEX,
+                          builder.gallivm);
 
    ctx->vs->map.insert(std::make_pair(key, make_unique<VariantVS>(builder.gallivm, func)));
    return func;
@@ -1331,7 +1340,9 @@ BuilderSWR::CompileFS(struct swr_context *ctx, swr_jit_fs_key &key)
                      NULL, // thread data
                      sampler, // sampler
                      &swr_fs->info.base,
-                     NULL); // geometry shader face
+                     NULL, // geometry shader face
+                     NULL, // compute shader face
+                     NULL); // tessellation shader face
 
    sampler->destroy(sampler);
 
@@ -1425,6 +1436,8 @@ swr_compile_fs(struct swr_context *ctx, swr_jit_fs_key &key)
       reinterpret_cast<JitManager *>(swr_screen(ctx->pipe.screen)->hJitMgr),
       "FS");
    PFN_PIXEL_KERNEL func = builder.CompileFS(ctx, key);
+   swr_capture_jit_shader((const void *)func, SWR_CAPTURE_SHADER_PIXEL,
+                          builder.gallivm);
 
    ctx->fs->map.insert(std::make_pair(key, make_unique<VariantFS>(builder.gallivm, func)));
    return func;
@@ -52,6 +52,7 @@
 #include "swr_scratch.h"
 #include "swr_shader.h"
 #include "swr_fence.h"
+#include "swr_capture.h"
 
 /* These should be pulled out into separate files as necessary
  * Just initializing everything here to get going. */
@@ -1718,6 +1719,7 @@ swr_update_derived(struct pipe_context *pipe,
             } else {
                HANDLE hJitMgr = screen->hJitMgr;
                func = JitCompileBlend(hJitMgr, compileState);
+               swr_capture_jit_blend(func, compileState);
                debug_printf("BLEND shader %p\n", func);
                assert(func && "Error: BlendShader = NULL");
 
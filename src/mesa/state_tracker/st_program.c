@@ -220,6 +220,8 @@ delete_vp_variant(struct st_context *st, struct st_vp_variant *vpv)
 
    if (((vpv->tgsi.type == PIPE_SHADER_IR_TGSI)) && vpv->tgsi.tokens)
       ureg_free_tokens(vpv->tgsi.tokens);
+   else if (vpv->tgsi.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(vpv->tgsi.ir.nir);
 
    free( vpv );
 }
@@ -570,9 +572,12 @@ st_create_vp_variant(struct st_context *st,
       st_finalize_nir(st, &stvp->Base, stvp->shader_program,
                       vpv->tgsi.ir.nir);
 
-      vpv->driver_shader = pipe->create_vs_state(pipe, &vpv->tgsi);
-      /* driver takes ownership of IR: */
-      vpv->tgsi.ir.nir = NULL;
+      /* The driver takes ownership of the IR it is given, so hand it a copy
+       * and keep ours around for the draw module (feedback/select modes).
+       */
+      struct pipe_shader_state state = vpv->tgsi;
+      state.ir.nir = nir_shader_clone(NULL, vpv->tgsi.ir.nir);
+      vpv->driver_shader = pipe->create_vs_state(pipe, &state);
       return vpv;
    }
 
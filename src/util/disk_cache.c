@@ -37,19 +37,29 @@
 #include <pwd.h>
 #include <errno.h>
 #include <dirent.h>
+#include <inttypes.h>
 #include "zlib.h"
 
+#ifdef HAVE_ZSTD
+#include "zstd.h"
+#endif
+
 #include "util/crc32.h"
 #include "util/debug.h"
+#include "util/hash_table.h"
+#include "util/list.h"
 #include "util/rand_xor.h"
 #include "util/u_atomic.h"
 #include "util/u_queue.h"
 #include "util/mesa-sha1.h"
+#include "util/os_time.h"
 #include "util/ralloc.h"
+#include "util/simple_mtx.h"
 #include "main/compiler.h"
 #include "main/errors.h"
 
 #include "disk_cache.h"
+#include "disk_cache_pack.h"
 
 /* Number of bits to mask off from a cache key to get an index. */
 #define CACHE_INDEX_KEY_BITS 16
@@ -74,6 +84,31 @@
  */
 #define CACHE_VERSION 1
 
+/* Maximum number of MESA_GLSL_CACHE_READ_ONLY_PACK_DIRS entries. */
+#define CACHE_MAX_READ_ONLY_PACKS 8
+
+/* Codecs for compressing new cache entries. Either can be read back, the
+ * codec of an entry is told by its first bytes.
+ */
+enum cache_codec {
+   CACHE_CODEC_ZLIB,
+   CACHE_CODEC_ZSTD,
+};
+
+/* Default compression levels. The zstd one favours write speed: zstd
+ * decompression speed barely depends on the level anyway.
+ */
+#define CACHE_ZLIB_DEFAULT_LEVEL Z_BEST_COMPRESSION
+#define CACHE_ZSTD_DEFAULT_LEVEL 1
+
+/* An entry of the in-memory tier. */
+struct mem_cache_entry {
+   cache_key key;
+   struct list_head link;
+   size_t size;
+   uint8_t data[];
+};
+
 struct disk_cache {
    /* The path to the cache directory. */
    char *path;
@@ -104,6 +139,36 @@ struct disk_cache {
 
    disk_cache_put_cb blob_put_cb;
    disk_cache_get_cb blob_get_cb;
+
+   /* Pack file entries are stored in instead of a file each, with
+    * MESA_GLSL_CACHE_PACK.
+    */
+   struct disk_cache_pack *pack;
+
+   /* Prebuilt packs, looked up before anything else. */
+   struct disk_cache_pack *read_only_packs[CACHE_MAX_READ_ONLY_PACKS];
+   unsigned num_read_only_packs;
+
+   /* Codec and level new entries are compressed with. */
+   enum cache_codec codec;
+   int compression_level;
+
+   /* Updated atomically, from both the cache thread and callers. */
+   struct disk_cache_stats stats;
+
+   /* Print the stats on destruction, with MESA_GLSL_CACHE_STATS. */
+   bool print_stats;
+
+   /* In-memory tier of the entries recently stored or loaded, looked up
+    * before anything else. It is shared by all the contexts using this
+    * cache object, and bounded to mem_max_size bytes by dropping the least
+    * recently used entries.
+    */
+   simple_mtx_t mem_mutex;
+   struct hash_table *mem_entries;
+   struct list_head mem_lru; /* most recently used first */
+   uint64_t mem_size;
+   uint64_t mem_max_size;
 };
 
 struct disk_cache_put_job {
@@ -182,6 +247,151 @@ concatenate_and_mkdir(void *ctx, const char *path, const char *name)
       return NULL;
 }
 
+/* Open the packs for these driver keys: ours, and the prebuilt ones from
+ * MESA_GLSL_CACHE_READ_ONLY_PACK_DIRS.  Packs are named after the keys, so
+ * packs for several drivers and builds can live side by side.
+ */
+static void
+open_packs(struct disk_cache *cache, void *local)
+{
+   unsigned char sha1[20];
+   char name[41];
+   char *dirs, *dir, *save_ptr;
+
+   _mesa_sha1_compute(cache->driver_keys_blob, cache->driver_keys_blob_size,
+                      sha1);
+   _mesa_sha1_format(name, sha1);
+
+   if (!cache->path_init_failed &&
+       env_var_as_boolean("MESA_GLSL_CACHE_PACK", false)) {
+      cache->pack = disk_cache_pack_open(cache->path, name,
+                                         cache->driver_keys_blob,
+                                         cache->driver_keys_blob_size,
+                                         false);
+   }
+
+   dirs = getenv("MESA_GLSL_CACHE_READ_ONLY_PACK_DIRS");
+   if (!dirs)
+      return;
+
+   dirs = ralloc_strdup(local, dirs);
+   if (!dirs)
+      return;
+
+   for (dir = strtok_r(dirs, ":", &save_ptr); dir;
+        dir = strtok_r(NULL, ":", &save_ptr)) {
+      struct disk_cache_pack *pack;
+
+      if (cache->num_read_only_packs == CACHE_MAX_READ_ONLY_PACKS)
+         break;
+
+      pack = disk_cache_pack_open(dir, name, cache->driver_keys_blob,
+                                  cache->driver_keys_blob_size, true);
+      if (pack)
+         cache->read_only_packs[cache->num_read_only_packs++] = pack;
+   }
+}
+
+/* Parse a size for MESA_GLSL_CACHE_*_SIZE: a number optionally followed by
+ * 'K', 'M' or 'G', gigabytes being assumed. Returns 0 for invalid sizes.
+ */
+static uint64_t
+parse_size(const char *str)
+{
+   uint64_t size;
+   char *end;
+
+   size = strtoul(str, &end, 10);
+   if (end == str)
+      return 0;
+
+   switch (*end) {
+   case 'K':
+   case 'k':
+      size *= 1024;
+      break;
+   case 'M':
+   case 'm':
+      size *= 1024*1024;
+      break;
+   case '\0':
+   case 'G':
+   case 'g':
+   default:
+      size *= 1024*1024*1024;
+      break;
+   }
+
+   return size;
+}
+
+static uint32_t
+key_hash(const void *key)
+{
+   uint32_t hash;
+
+   /* Keys are SHA-1s already. */
+   memcpy(&hash, key, sizeof(hash));
+   return hash;
+}
+
+static bool
+key_equals(const void *a, const void *b)
+{
+   return memcmp(a, b, CACHE_KEY_SIZE) == 0;
+}
+
+/* Pick the codec and level from MESA_GLSL_CACHE_COMPRESSION and
+ * MESA_GLSL_CACHE_COMPRESSION_LEVEL, defaulting to zstd when available.
+ */
+static void
+init_compression(struct disk_cache *cache)
+{
+   const char *codec_str = getenv("MESA_GLSL_CACHE_COMPRESSION");
+   const char *level_str = getenv("MESA_GLSL_CACHE_COMPRESSION_LEVEL");
+
+#ifdef HAVE_ZSTD
+   cache->codec = CACHE_CODEC_ZSTD;
+#else
+   cache->codec = CACHE_CODEC_ZLIB;
+#endif
+
+   if (codec_str) {
+      if (strcmp(codec_str, "zlib") == 0) {
+         cache->codec = CACHE_CODEC_ZLIB;
+#ifdef HAVE_ZSTD
+      } else if (strcmp(codec_str, "zstd") == 0) {
+         cache->codec = CACHE_CODEC_ZSTD;
+#endif
+      } else {
+         fprintf(stderr, "Unsupported shader cache compression \"%s\", "
+                 "using %s.\n", codec_str,
+                 cache->codec == CACHE_CODEC_ZSTD ? "zstd" : "zlib");
+      }
+   }
+
+   switch (cache->codec) {
+   case CACHE_CODEC_ZLIB:
+      cache->compression_level = CACHE_ZLIB_DEFAULT_LEVEL;
+      if (level_str) {
+         int level = atoi(level_str);
+         if (level >= Z_BEST_SPEED && level <= Z_BEST_COMPRESSION)
+            cache->compression_level = level;
+      }
+      break;
+   case CACHE_CODEC_ZSTD:
+#ifdef HAVE_ZSTD
+      cache->compression_level = CACHE_ZSTD_DEFAULT_LEVEL;
+      if (level_str) {
+         int level = atoi(level_str);
+         if (level >= 1 && level <= ZSTD_maxCLevel())
+            cache->compression_level = level;
+      }
+#endif
+      break;
+   }
+}
+
 #define DRV_KEY_CPY(_dst, _src, _src_size) \
 do {                                       \
    memcpy(_dst, _src, _src_size);          \
@@ -194,7 +404,7 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
 {
    void *local;
    struct disk_cache *cache = NULL;
-   char *path, *max_size_str;
+   char *path, *max_size_str, *mem_size_str;
    uint64_t max_size;
    int fd = -1;
    struct stat sb;
@@ -338,30 +548,8 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    max_size = 0;
 
    max_size_str = getenv("MESA_GLSL_CACHE_MAX_SIZE");
-   if (max_size_str) {
-      char *end;
-      max_size = strtoul(max_size_str, &end, 10);
-      if (end == max_size_str) {
-         max_size = 0;
-      } else {
-         switch (*end) {
-         case 'K':
-         case 'k':
-            max_size *= 1024;
-            break;
-         case 'M':
-         case 'm':
-            max_size *= 1024*1024;
-            break;
-         case '\0':
-         case 'G':
-         case 'g':
-         default:
-            max_size *= 1024*1024*1024;
-            break;
-         }
-      }
-   }
+   if (max_size_str)
+      max_size = parse_size(max_size_str);
 
    /* Default to 1GB for maximum cache size. */
    if (max_size == 0) {
@@ -414,6 +602,25 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    DRV_KEY_CPY(drv_key_blob, &ptr_size, ptr_size_size)
    DRV_KEY_CPY(drv_key_blob, &driver_flags, driver_flags_size)
 
+   open_packs(cache, local);
+
+   init_compression(cache);
+   cache->print_stats = env_var_as_boolean("MESA_GLSL_CACHE_STATS", false);
+
+   /* The in-memory tier is opt-in, it costs memory for every process. */
+   mem_size_str = getenv("MESA_GLSL_CACHE_MEMORY_SIZE");
+   if (mem_size_str)
+      cache->mem_max_size = parse_size(mem_size_str);
+
+   if (cache->mem_max_size) {
+      cache->mem_entries = _mesa_hash_table_create(cache, key_hash,
+                                                   key_equals);
+      if (!cache->mem_entries)
+         goto fail;
+      simple_mtx_init(&cache->mem_mutex, mtx_plain);
+      list_inithead(&cache->mem_lru);
+   }
+
    /* Seed our rand function */
    s_rand_xorshift128plus(cache->seed_xorshift128plus, true);
 
@@ -431,6 +638,31 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    return NULL;
 }
 
+static void
+print_stats(struct disk_cache *cache)
+{
+   const struct disk_cache_stats *stats = &cache->stats;
+   uint64_t gets = stats->hits + stats->misses;
+
+   fprintf(stderr, "Mesa shader cache (%s level %d):\n",
+           cache->codec == CACHE_CODEC_ZSTD ? "zstd" : "zlib",
+           cache->compression_level);
+   fprintf(stderr, "  gets: %" PRIu64 " hits, %" PRIu64 " misses, "
+           "%.3f ms total, %.3f ms decompressing\n",
+           stats->hits, stats->misses, stats->get_time_ns / 1e6,
+           stats->decompress_time_ns / 1e6);
+   if (gets) {
+      fprintf(stderr, "  %.1f us per get\n",
+              stats->get_time_ns / 1e3 / gets);
+   }
+   fprintf(stderr, "  %" PRIu64 " hits from memory\n", stats->memory_hits);
+   fprintf(stderr, "  read: %" PRIu64 " bytes, %" PRIu64 " uncompressed\n",
+           stats->bytes_read, stats->bytes_uncompressed);
+   fprintf(stderr, "  puts: %" PRIu64 ", %" PRIu64 " bytes written, "
+           "%.3f ms total\n",
+           stats->puts, stats->bytes_written, stats->put_time_ns / 1e6);
+}
+
 void
 disk_cache_destroy(struct disk_cache *cache)
 {
@@ -439,6 +671,24 @@ disk_cache_destroy(struct disk_cache *cache)
       munmap(cache->index_mmap, cache->index_mmap_size);
    }
 
+   if (cache) {
+      unsigned i;
+
+      if (cache->print_stats)
+         print_stats(cache);
+
+      if (cache->mem_entries) {
+         list_for_each_entry_safe(struct mem_cache_entry, entry,
+                                  &cache->mem_lru, link)
+            free(entry);
+         simple_mtx_destroy(&cache->mem_mutex);
+      }
+
+      disk_cache_pack_close(cache->pack);
+      for (i = 0; i < cache->num_read_only_packs; i++)
+         disk_cache_pack_close(cache->read_only_packs[i]);
+   }
+
    ralloc_free(cache);
 }
 
@@ -666,11 +916,118 @@ evict_lru_item(struct disk_cache *cache)
       p_atomic_add(cache->size, - (uint64_t)size);
 }
 
+/* Must be called with mem_mutex held. */
+static void
+mem_cache_remove_entry(struct disk_cache *cache, struct hash_entry *he)
+{
+   struct mem_cache_entry *entry = he->data;
+
+   _mesa_hash_table_remove(cache->mem_entries, he);
+   list_del(&entry->link);
+   cache->mem_size -= entry->size;
+   free(entry);
+}
+
+static void
+mem_cache_put(struct disk_cache *cache, const cache_key key,
+              const void *data, size_t size)
+{
+   struct mem_cache_entry *entry;
+   struct hash_entry *he;
+
+   if (!cache->mem_entries || size > cache->mem_max_size)
+      return;
+
+   entry = malloc(sizeof(*entry) + size);
+   if (!entry)
+      return;
+
+   memcpy(entry->key, key, CACHE_KEY_SIZE);
+   entry->size = size;
+   memcpy(entry->data, data, size);
+
+   simple_mtx_lock(&cache->mem_mutex);
+
+   he = _mesa_hash_table_search(cache->mem_entries, key);
+   if (he)
+      mem_cache_remove_entry(cache, he);
+
+   while (cache->mem_size + size > cache->mem_max_size) {
+      struct mem_cache_entry *lru =
+         list_last_entry(&cache->mem_lru, struct mem_cache_entry, link);
+
+      mem_cache_remove_entry(cache,
+                             _mesa_hash_table_search(cache->mem_entries,
+                                                     lru->key));
+   }
+
+   _mesa_hash_table_insert(cache->mem_entries, entry->key, entry);
+   list_add(&entry->link, &cache->mem_lru);
+   cache->mem_size += size;
+
+   simple_mtx_unlock(&cache->mem_mutex);
+}
+
+/* Returns a malloc'ed copy of the entry, like disk_cache_get(). */
+static void *
+mem_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   struct mem_cache_entry *entry;
+   struct hash_entry *he;
+   void *data = NULL;
+
+   if (!cache->mem_entries)
+      return NULL;
+
+   simple_mtx_lock(&cache->mem_mutex);
+
+   he = _mesa_hash_table_search(cache->mem_entries, key);
+   if (he) {
+      entry = he->data;
+      data = malloc(entry->size);
+      if (data) {
+         memcpy(data, entry->data, entry->size);
+         *size = entry->size;
+
+         list_del(&entry->link);
+         list_add(&entry->link, &cache->mem_lru);
+      }
+   }
+
+   simple_mtx_unlock(&cache->mem_mutex);
+
+   return data;
+}
+
+static void
+mem_cache_remove(struct disk_cache *cache, const cache_key key)
+{
+   struct hash_entry *he;
+
+   if (!cache->mem_entries)
+      return;
+
+   simple_mtx_lock(&cache->mem_mutex);
+
+   he = _mesa_hash_table_search(cache->mem_entries, key);
+   if (he)
+      mem_cache_remove_entry(cache, he);
+
+   simple_mtx_unlock(&cache->mem_mutex);
+}
+
 void
 disk_cache_remove(struct disk_cache *cache, const cache_key key)
 {
    struct stat sb;
 
+   mem_cache_remove(cache, key);
+
+   if (cache->pack) {
+      disk_cache_pack_remove(cache->pack, key);
+      return;
+   }
+
    char *filename = get_cache_file(cache, key);
    if (filename == NULL) {
       return;
@@ -718,22 +1075,14 @@ write_all(int fd, const void *buf, size_t count)
    return done;
 }
 
-/* From the zlib docs:
- *    "If the memory is available, buffers sizes on the order of 128K or 256K
- *    bytes should be used."
- */
-#define BUFSIZE 256 * 1024
-
 /**
- * Compresses cache entry in memory and writes it to disk. Returns the size
- * of the data written to disk.
+ * Compresses cache entry in memory. Returns the compressed size, 0 on
+ * failure (which includes the output buffer being too small).
  */
 static size_t
-deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
-                          const char *filename)
+deflate_cache_data(const void *in_data, size_t in_data_size,
+                   uint8_t *out_data, size_t out_data_size, int level)
 {
-   unsigned char out[BUFSIZE];
-
    /* allocate deflate state */
    z_stream strm;
    strm.zalloc = Z_NULL;
@@ -741,50 +1090,59 @@ deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
    strm.opaque = Z_NULL;
    strm.next_in = (uint8_t *) in_data;
    strm.avail_in = in_data_size;
+   strm.next_out = out_data;
+   strm.avail_out = out_data_size;
 
-   int ret = deflateInit(&strm, Z_BEST_COMPRESSION);
+   int ret = deflateInit(&strm, level);
    if (ret != Z_OK)
        return 0;
 
-   /* compress until end of in_data */
-   size_t compressed_size = 0;
-   int flush;
-   do {
-      int remaining = in_data_size - BUFSIZE;
-      flush = remaining > 0 ? Z_NO_FLUSH : Z_FINISH;
-      in_data_size -= BUFSIZE;
-
-      /* Run deflate() on input until the output buffer is not full (which
-       * means there is no more data to deflate).
-       */
-      do {
-         strm.avail_out = BUFSIZE;
-         strm.next_out = out;
-
-         ret = deflate(&strm, flush);    /* no bad return value */
-         assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
+   /* We know the whole input and have a large enough buffer, so compress
+    * it in one go.
+    */
+   ret = deflate(&strm, Z_FINISH);
+   assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
 
-         size_t have = BUFSIZE - strm.avail_out;
-         compressed_size += have;
+   size_t compressed_size = out_data_size - strm.avail_out;
 
-         ssize_t written = write_all(dest, out, have);
-         if (written == -1) {
-            (void)deflateEnd(&strm);
-            return 0;
-         }
-      } while (strm.avail_out == 0);
+   /* clean up and return */
+   (void)deflateEnd(&strm);
+   return ret == Z_STREAM_END ? compressed_size : 0;
+}
 
-      /* all input should be used */
-      assert(strm.avail_in == 0);
+/**
+ * Compresses cache entry in memory with the cache's codec. Returns the
+ * compressed size, 0 on failure.
+ */
+static size_t
+compress_cache_data(struct disk_cache *cache,
+                    const void *in_data, size_t in_data_size,
+                    uint8_t *out_data, size_t out_data_size)
+{
+#ifdef HAVE_ZSTD
+   if (cache->codec == CACHE_CODEC_ZSTD) {
+      size_t ret = ZSTD_compress(out_data, out_data_size, in_data,
+                                 in_data_size, cache->compression_level);
+      return ZSTD_isError(ret) ? 0 : ret;
+   }
+#endif
 
-   } while (flush != Z_FINISH);
+   return deflate_cache_data(in_data, in_data_size, out_data, out_data_size,
+                             cache->compression_level);
+}
 
-   /* stream should be complete */
-   assert(ret == Z_STREAM_END);
+/**
+ * Upper bound of the compressed size of in_data_size bytes.
+ */
+static size_t
+compress_bound(struct disk_cache *cache, size_t in_data_size)
+{
+#ifdef HAVE_ZSTD
+   if (cache->codec == CACHE_CODEC_ZSTD)
+      return ZSTD_compressBound(in_data_size);
+#endif
 
-   /* clean up and return */
-   (void)deflateEnd(&strm);
-   return compressed_size;
+   return compressBound(in_data_size);
 }
 
 static struct disk_cache_put_job *
@@ -848,6 +1206,95 @@ struct cache_entry_file_data {
    uint32_t uncompressed_size;
 };
 
+/**
+ * Serialize a cache entry, as it is stored after the driver keys blob: the
+ * cache item metadata, the CRC and size of the data, and the compressed
+ * data.  Returns the malloc'ed entry, or NULL on failure.
+ */
+static uint8_t *
+create_entry(struct disk_cache_put_job *dc_job, size_t *entry_size)
+{
+   const struct cache_item_metadata *md = &dc_job->cache_item_metadata;
+   size_t md_size = sizeof(uint32_t);
+   size_t max_size;
+   uint8_t *entry, *p;
+
+   if (md->type == CACHE_ITEM_TYPE_GLSL)
+      md_size += sizeof(uint32_t) + md->num_keys * sizeof(cache_key);
+
+   max_size = md_size + sizeof(struct cache_entry_file_data) +
+              compress_bound(dc_job->cache, dc_job->size);
+
+   entry = malloc(max_size);
+   if (!entry)
+      return NULL;
+
+   /* Write the cache item metadata. This data can be used to deal with
+    * hash collisions, as well as providing useful information to 3rd party
+    * tools reading the cache files.
+    */
+   p = entry;
+   memcpy(p, &md->type, sizeof(uint32_t));
+   p += sizeof(uint32_t);
+
+   if (md->type == CACHE_ITEM_TYPE_GLSL) {
+      memcpy(p, &md->num_keys, sizeof(uint32_t));
+      p += sizeof(uint32_t);
+      memcpy(p, md->keys, md->num_keys * sizeof(cache_key));
+      p += md->num_keys * sizeof(cache_key);
+   }
+
+   /* Create CRC of the data. We will read this when restoring the cache and
+    * use it to check for corruption.
+    */
+   struct cache_entry_file_data cf_data;
+   cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
+   cf_data.uncompressed_size = dc_job->size;
+
+   memcpy(p, &cf_data, sizeof(cf_data));
+   p += sizeof(cf_data);
+
+   size_t compressed_size =
+      compress_cache_data(dc_job->cache, dc_job->data, dc_job->size, p,
+                          max_size - (p - entry));
+   if (compressed_size == 0) {
+      free(entry);
+      return NULL;
+   }
+
+   *entry_size = (p - entry) + compressed_size;
+   return entry;
+}
+
+static void
+cache_put_pack(struct disk_cache_put_job *dc_job)
+{
+   struct disk_cache *cache = dc_job->cache;
+   int64_t start = os_time_get_nano();
+   size_t entry_size;
+   uint8_t *entry;
+
+   entry = create_entry(dc_job, &entry_size);
+   if (!entry)
+      return;
+
+   /* Packs are append-only, so nothing gets evicted one at a time: once the
+    * pack is full, compact it down to half the maximum size, which drops
+    * the entries added least recently.
+    */
+   if (disk_cache_pack_size(cache->pack) + entry_size > cache->max_size)
+      disk_cache_pack_compact(cache->pack, cache->max_size / 2);
+
+   if (disk_cache_pack_put(cache->pack, dc_job->key, entry, entry_size,
+                           cache->max_size)) {
+      p_atomic_inc(&cache->stats.puts);
+      p_atomic_add(&cache->stats.bytes_written, entry_size);
+   }
+   p_atomic_add(&cache->stats.put_time_ns, os_time_get_nano() - start);
+
+   free(entry);
+}
+
 static void
 cache_put(void *job, int thread_index)
 {
@@ -856,7 +1303,15 @@ cache_put(void *job, int thread_index)
    int fd = -1, fd_final = -1, err, ret;
    unsigned i = 0;
    char *filename = NULL, *filename_tmp = NULL;
+   uint8_t *entry = NULL;
+   size_t entry_size;
    struct disk_cache_put_job *dc_job = (struct disk_cache_put_job *) job;
+   int64_t start = os_time_get_nano();
+
+   if (dc_job->cache->pack) {
+      cache_put_pack(dc_job);
+      return;
+   }
 
    filename = get_cache_file(dc_job->cache, dc_job->key);
    if (filename == NULL)
@@ -927,58 +1382,21 @@ cache_put(void *job, int thread_index)
       goto done;
    }
 
-   /* Write the cache item metadata. This data can be used to deal with
-    * hash collisions, as well as providing useful information to 3rd party
-    * tools reading the cache files.
+   /* Now, finally, write out the contents to the temporary file, then
+    * rename them atomically to the destination filename, and also
+    * perform an atomic increment of the total cache size.
     */
-   ret = write_all(fd, &dc_job->cache_item_metadata.type,
-                   sizeof(uint32_t));
-   if (ret == -1) {
+   entry = create_entry(dc_job, &entry_size);
+   if (entry == NULL) {
       unlink(filename_tmp);
       goto done;
    }
 
-   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
-      ret = write_all(fd, &dc_job->cache_item_metadata.num_keys,
-                      sizeof(uint32_t));
-      if (ret == -1) {
-         unlink(filename_tmp);
-         goto done;
-      }
-
-      ret = write_all(fd, dc_job->cache_item_metadata.keys[0],
-                      dc_job->cache_item_metadata.num_keys *
-                      sizeof(cache_key));
-      if (ret == -1) {
-         unlink(filename_tmp);
-         goto done;
-      }
-   }
-
-   /* Create CRC of the data. We will read this when restoring the cache and
-    * use it to check for corruption.
-    */
-   struct cache_entry_file_data cf_data;
-   cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
-   cf_data.uncompressed_size = dc_job->size;
-
-   size_t cf_data_size = sizeof(cf_data);
-   ret = write_all(fd, &cf_data, cf_data_size);
+   ret = write_all(fd, entry, entry_size);
    if (ret == -1) {
       unlink(filename_tmp);
       goto done;
    }
-
-   /* Now, finally, write out the contents to the temporary file, then
-    * rename them atomically to the destination filename, and also
-    * perform an atomic increment of the total cache size.
-    */
-   size_t file_size = deflate_and_write_to_disk(dc_job->data, dc_job->size,
-                                                fd, filename_tmp);
-   if (file_size == 0) {
-      unlink(filename_tmp);
-      goto done;
-   }
    ret = rename(filename_tmp, filename);
    if (ret == -1) {
       unlink(filename_tmp);
@@ -994,6 +1412,9 @@ cache_put(void *job, int thread_index)
 
    p_atomic_add(dc_job->cache->size, sb.st_blocks * 512);
 
+   p_atomic_inc(&dc_job->cache->stats.puts);
+   p_atomic_add(&dc_job->cache->stats.bytes_written, entry_size);
+
  done:
    if (fd_final != -1)
       close(fd_final);
@@ -1002,6 +1423,9 @@ cache_put(void *job, int thread_index)
     */
    if (fd != -1)
       close(fd);
+   p_atomic_add(&dc_job->cache->stats.put_time_ns,
+                os_time_get_nano() - start);
+   free(entry);
    free(filename_tmp);
    free(filename);
 }
@@ -1013,12 +1437,15 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
 {
    if (cache->blob_put_cb) {
       cache->blob_put_cb(key, CACHE_KEY_SIZE, data, size);
+      mem_cache_put(cache, key, data, size);
       return;
    }
 
    if (cache->path_init_failed)
       return;
 
+   mem_cache_put(cache, key, data, size);
+
    struct disk_cache_put_job *dc_job =
       create_put_job(cache, key, data, size, cache_item_metadata);
 
@@ -1068,15 +1495,135 @@ inflate_cache_data(uint8_t *in_data, size_t in_data_size,
    return true;
 }
 
-void *
-disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+/**
+ * Decompresses cache entry with whichever codec it was compressed with,
+ * returns true if successful.
+ */
+static bool
+decompress_cache_data(uint8_t *in_data, size_t in_data_size,
+                      uint8_t *out_data, size_t out_data_size)
+{
+#ifdef HAVE_ZSTD
+   /* A zstd frame starts with a magic number that can't start a zlib
+    * stream.
+    */
+   if (in_data_size >= 4 &&
+       (in_data[0] | in_data[1] << 8 | in_data[2] << 16 |
+        (uint32_t) in_data[3] << 24) == ZSTD_MAGICNUMBER) {
+      size_t ret = ZSTD_decompress(out_data, out_data_size, in_data,
+                                   in_data_size);
+      return !ZSTD_isError(ret) && ret == out_data_size;
+   }
+#endif
+
+   return inflate_cache_data(in_data, in_data_size, out_data, out_data_size);
+}
+
+/**
+ * Decode a cache entry as created by create_entry(). Returns the malloc'ed
+ * uncompressed data, or NULL if the entry is truncated or corrupt.
+ */
+static void *
+parse_entry(struct disk_cache *cache, const uint8_t *entry, size_t entry_size,
+            size_t *size)
+{
+   const uint8_t *p = entry, *end = entry + entry_size;
+   struct cache_entry_file_data cf_data;
+   uint8_t *uncompressed_data;
+   uint32_t md_type;
+   int64_t start;
+
+   if (end - p < sizeof(uint32_t))
+      return NULL;
+   memcpy(&md_type, p, sizeof(uint32_t));
+   p += sizeof(uint32_t);
+
+   if (md_type == CACHE_ITEM_TYPE_GLSL) {
+      uint32_t num_keys;
+
+      if (end - p < sizeof(uint32_t))
+         return NULL;
+      memcpy(&num_keys, p, sizeof(uint32_t));
+      p += sizeof(uint32_t);
+
+      /* The cache item metadata is currently just used for distributing
+       * precompiled shaders, they are not used by Mesa so just skip them for
+       * now.
+       * TODO: pass the metadata back to the caller and do some basic
+       * validation.
+       */
+      if ((end - p) / sizeof(cache_key) < num_keys)
+         return NULL;
+      p += num_keys * sizeof(cache_key);
+   }
+
+   /* Load the CRC that was created when the file was written. */
+   if (end - p < sizeof(cf_data))
+      return NULL;
+   memcpy(&cf_data, p, sizeof(cf_data));
+   p += sizeof(cf_data);
+
+   /* Uncompress the cache data */
+   uncompressed_data = malloc(cf_data.uncompressed_size);
+   if (!uncompressed_data)
+      return NULL;
+
+   start = os_time_get_nano();
+   if (!decompress_cache_data((uint8_t *) p, end - p, uncompressed_data,
+                              cf_data.uncompressed_size))
+      goto fail;
+   p_atomic_add(&cache->stats.decompress_time_ns, os_time_get_nano() - start);
+
+   /* Check the data for corruption */
+   if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
+                                        cf_data.uncompressed_size))
+      goto fail;
+
+   if (size)
+      *size = cf_data.uncompressed_size;
+
+   p_atomic_add(&cache->stats.bytes_read, entry_size);
+   p_atomic_add(&cache->stats.bytes_uncompressed, cf_data.uncompressed_size);
+
+   return uncompressed_data;
+
+ fail:
+   free(uncompressed_data);
+   return NULL;
+}
+
+static void *
+get_from_packs(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   void *entry, *data;
+   size_t entry_size;
+   unsigned i;
+
+   entry = NULL;
+   for (i = 0; i < cache->num_read_only_packs && !entry; i++) {
+      entry = disk_cache_pack_get(cache->read_only_packs[i], key,
+                                  &entry_size);
+   }
+
+   if (!entry && cache->pack)
+      entry = disk_cache_pack_get(cache->pack, key, &entry_size);
+
+   if (!entry)
+      return NULL;
+
+   data = parse_entry(cache, entry, entry_size, size);
+   free(entry);
+   return data;
+}
+
+static void *
+get_entry(struct disk_cache *cache, const cache_key key, size_t *size)
 {
    int fd = -1, ret;
    struct stat sb;
    char *filename = NULL;
    uint8_t *data = NULL;
    uint8_t *uncompressed_data = NULL;
-   uint8_t *file_header = NULL;
 
    if (size)
       *size = 0;
@@ -1103,6 +1650,12 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
       return blob;
    }
 
+   if (cache->num_read_only_packs || cache->pack) {
+      uncompressed_data = get_from_packs(cache, key, size);
+      if (uncompressed_data || cache->pack)
+         return uncompressed_data;
+   }
+
    filename = get_cache_file(cache, key);
    if (filename == NULL)
       goto fail;
@@ -1114,101 +1667,61 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    if (fstat(fd, &sb) == -1)
       goto fail;
 
-   data = malloc(sb.st_size);
-   if (data == NULL)
-      goto fail;
-
    size_t ck_size = cache->driver_keys_blob_size;
-   file_header = malloc(ck_size);
-   if (!file_header)
+   if (sb.st_size < ck_size)
       goto fail;
 
-   if (sb.st_size < ck_size)
+   data = malloc(sb.st_size);
+   if (data == NULL)
       goto fail;
 
-   ret = read_all(fd, file_header, ck_size);
+   ret = read_all(fd, data, sb.st_size);
    if (ret == -1)
       goto fail;
 
    /* Check for extremely unlikely hash collisions */
-   if (memcmp(cache->driver_keys_blob, file_header, ck_size) != 0) {
+   if (memcmp(cache->driver_keys_blob, data, ck_size) != 0) {
       assert(!"Mesa cache keys mismatch!");
       goto fail;
    }
 
-   size_t cache_item_md_size = sizeof(uint32_t);
-   uint32_t md_type;
-   ret = read_all(fd, &md_type, cache_item_md_size);
-   if (ret == -1)
-      goto fail;
-
-   if (md_type == CACHE_ITEM_TYPE_GLSL) {
-      uint32_t num_keys;
-      cache_item_md_size += sizeof(uint32_t);
-      ret = read_all(fd, &num_keys, sizeof(uint32_t));
-      if (ret == -1)
-         goto fail;
-
-      /* The cache item metadata is currently just used for distributing
-       * precompiled shaders, they are not used by Mesa so just skip them for
-       * now.
-       * TODO: pass the metadata back to the caller and do some basic
-       * validation.
-       */
-      cache_item_md_size += num_keys * sizeof(cache_key);
-      ret = lseek(fd, num_keys * sizeof(cache_key), SEEK_CUR);
-      if (ret == -1)
-         goto fail;
-   }
-
-   /* Load the CRC that was created when the file was written. */
-   struct cache_entry_file_data cf_data;
-   size_t cf_data_size = sizeof(cf_data);
-   ret = read_all(fd, &cf_data, cf_data_size);
-   if (ret == -1)
-      goto fail;
-
-   /* Load the actual cache data. */
-   size_t cache_data_size =
-      sb.st_size - cf_data_size - ck_size - cache_item_md_size;
-   ret = read_all(fd, data, cache_data_size);
-   if (ret == -1)
-      goto fail;
-
-   /* Uncompress the cache data */
-   uncompressed_data = malloc(cf_data.uncompressed_size);
-   if (!inflate_cache_data(data, cache_data_size, uncompressed_data,
-                           cf_data.uncompressed_size))
-      goto fail;
-
-   /* Check the data for corruption */
-   if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
-                                        cf_data.uncompressed_size))
-      goto fail;
+   uncompressed_data = parse_entry(cache, data + ck_size,
+                                   sb.st_size - ck_size, size);
 
+ fail:
    free(data);
    free(filename);
-   free(file_header);
-   close(fd);
-
-   if (size)
-      *size = cf_data.uncompressed_size;
+   if (fd != -1)
+      close(fd);
 
    return uncompressed_data;
+}
+
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   int64_t start = os_time_get_nano();
+   size_t data_size = 0;
+   void *data;
+
+   data = mem_cache_get(cache, key, &data_size);
+   if (data) {
+      p_atomic_inc(&cache->stats.memory_hits);
+   } else {
+      data = get_entry(cache, key, &data_size);
+      if (data)
+         mem_cache_put(cache, key, data, data_size);
+   }
 
- fail:
    if (data)
-      free(data);
-   if (uncompressed_data)
-      free(uncompressed_data);
-   if (filename)
-      free(filename);
-   if (file_header)
-      free(file_header);
-   if (fd != -1)
-      close(fd);
+      p_atomic_inc(&cache->stats.hits);
+   else
+      p_atomic_inc(&cache->stats.misses);
+   p_atomic_add(&cache->stats.get_time_ns, os_time_get_nano() - start);
 
-   return NULL;
+   if (size)
+      *size = data_size;
+   return data;
 }
 
 void
@@ -1279,4 +1792,26 @@ disk_cache_set_callbacks(struct disk_cache *cache, disk_cache_put_cb put,
    cache->blob_get_cb = get;
 }
 
+void
+disk_cache_get_stats(struct disk_cache *cache, struct disk_cache_stats *stats)
+{
+   stats->hits = p_atomic_read(&cache->stats.hits);
+   stats->misses = p_atomic_read(&cache->stats.misses);
+   stats->puts = p_atomic_read(&cache->stats.puts);
+   stats->memory_hits = p_atomic_read(&cache->stats.memory_hits);
+   stats->bytes_read = p_atomic_read(&cache->stats.bytes_read);
+   stats->bytes_uncompressed = p_atomic_read(&cache->stats.bytes_uncompressed);
+   stats->bytes_written = p_atomic_read(&cache->stats.bytes_written);
+   stats->get_time_ns = p_atomic_read(&cache->stats.get_time_ns);
+   stats->decompress_time_ns = p_atomic_read(&cache->stats.decompress_time_ns);
+   stats->put_time_ns = p_atomic_read(&cache->stats.put_time_ns);
+}
+
+void
+disk_cache_wait_for_idle(struct disk_cache *cache)
+{
+   if (!cache->path_init_failed)
+      util_queue_finish(&cache->cache_queue);
+}
+
 #endif /* ENABLE_SHADER_CACHE */
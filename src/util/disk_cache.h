@@ -30,6 +30,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #ifdef __cplusplus
@@ -71,6 +72,32 @@ struct cache_item_metadata {
    uint32_t num_keys;
 };
 
+/**
+ * Counters of a cache object, see disk_cache_get_stats().
+ */
+struct disk_cache_stats {
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t puts;
+
+   /** Hits served by the in-memory tier, included in hits */
+   uint64_t memory_hits;
+
+   /** Bytes of compressed entries loaded, and of data returned, on hits */
+   uint64_t bytes_read;
+   uint64_t bytes_uncompressed;
+
+   /** Bytes of compressed entries written */
+   uint64_t bytes_written;
+
+   /** Time spent in disk_cache_get(), of which decompressing */
+   uint64_t get_time_ns;
+   uint64_t decompress_time_ns;
+
+   /** Time the cache thread spent compressing and writing entries */
+   uint64_t put_time_ns;
+};
+
 struct disk_cache;
 
 static inline char *
@@ -217,6 +244,20 @@ void
 disk_cache_set_callbacks(struct disk_cache *cache, disk_cache_put_cb put,
                          disk_cache_get_cb get);
 
+/**
+ * Return the counters accumulated since the cache object was created.
+ * Writes still in the cache queue are not accounted yet.
+ */
+void
+disk_cache_get_stats(struct disk_cache *cache, struct disk_cache_stats *stats);
+
+/**
+ * Wait until all the items passed to disk_cache_put() so far have been
+ * written out.
+ */
+void
+disk_cache_wait_for_idle(struct disk_cache *cache);
+
 #else
 
 static inline struct disk_cache *
@@ -277,6 +318,18 @@ disk_cache_set_callbacks(struct disk_cache *cache, disk_cache_put_cb put,
    return;
 }
 
+static inline void
+disk_cache_get_stats(struct disk_cache *cache, struct disk_cache_stats *stats)
+{
+   memset(stats, 0, sizeof(*stats));
+}
+
+static inline void
+disk_cache_wait_for_idle(struct disk_cache *cache)
+{
+   return;
+}
+
 #endif /* ENABLE_SHADER_CACHE */
 
 #ifdef __cplusplus
@@ -0,0 +1,931 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifdef ENABLE_SHADER_CACHE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "util/crc32.h"
+#include "util/macros.h"
+#include "util/set.h"
+#include "util/simple_mtx.h"
+#include "util/u_atomic.h"
+
+#include "disk_cache_pack.h"
+
+/* Bump when the layout of the pack, its records or its index changes. */
+#define PACK_VERSION 1
+
+#define PACK_MAGIC "MESAPACK"
+#define PACK_RECORD_MAGIC 0x4b505344 /* "DSPK" */
+#define PACK_INDEX_MAGIC 0x58444950  /* "PIDX" */
+
+/* Number of index slots, a power of two.  Keys are cryptographic hashes, so
+ * their first bytes are as good an index as any.
+ */
+#define PACK_INDEX_SLOTS (1 << 16)
+
+/* How far from its home slot a key may land.  Records that can't be
+ * indexed are dropped by the next compaction.
+ */
+#define PACK_INDEX_MAX_PROBES 32
+
+struct pack_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t blob_size;  /* of the driver keys blob following this */
+};
+
+struct pack_record {
+   uint32_t magic;
+   uint32_t size;       /* of the payload following this, 0 if removed */
+   cache_key key;
+   uint32_t crc32;      /* of the payload */
+};
+
+struct pack_index_header {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t num_slots;
+   uint32_t pad;
+   uint64_t end;        /* end of the last complete record in the pack */
+   uint64_t dead;       /* bytes of records a compaction would drop */
+};
+
+struct pack_index_slot {
+   cache_key key;
+   uint32_t size;
+   uint64_t offset;     /* of the record, 0 if the slot is free */
+};
+
+/* Opening a writable pack compacts it when at least this many bytes, and
+ * half of its records, are dead: removed, superseded or unindexed.
+ */
+#define PACK_COMPACT_MIN_DEAD (1024 * 1024)
+
+#define PACK_INDEX_SIZE (sizeof(struct pack_index_header) + \
+                         PACK_INDEX_SLOTS * sizeof(struct pack_index_slot))
+
+struct disk_cache_pack {
+   /* Serializes the threads of this process; other processes are kept out
+    * by flock() on fd.
+    */
+   simple_mtx_t mutex;
+
+   char *path;
+   char *index_path;
+   bool read_only;
+
+   /* struct pack_header followed by the driver keys blob */
+   uint8_t *header;
+   size_t header_size;
+
+   int fd;
+   ino_t ino;
+
+   void *index_map;
+   struct pack_index_header *index;
+   struct pack_index_slot *slots;
+};
+
+static bool
+pread_all(int fd, void *buf, size_t count, uint64_t offset)
+{
+   uint8_t *in = buf;
+
+   while (count) {
+      ssize_t ret = pread(fd, in, count, offset);
+      if (ret <= 0)
+         return false;
+      in += ret;
+      count -= ret;
+      offset += ret;
+   }
+   return true;
+}
+
+static bool
+pwrite_all(int fd, const void *buf, size_t count, uint64_t offset)
+{
+   const uint8_t *out = buf;
+
+   while (count) {
+      ssize_t ret = pwrite(fd, out, count, offset);
+      if (ret <= 0)
+         return false;
+      out += ret;
+      count -= ret;
+      offset += ret;
+   }
+   return true;
+}
+
+static uint32_t
+key_hash(const void *key)
+{
+   uint32_t hash;
+
+   memcpy(&hash, key, sizeof(hash));
+   return hash;
+}
+
+static bool
+key_equals(const void *a, const void *b)
+{
+   return memcmp(a, b, CACHE_KEY_SIZE) == 0;
+}
+
+/**
+ * Find the slot holding \key, or with insert, the free slot it would go to.
+ *
+ * This runs concurrently with other processes updating the index, so what
+ * it finds is only a hint: records are checked against the key when read.
+ */
+static struct pack_index_slot *
+find_slot(struct pack_index_slot *slots, const cache_key key, bool insert)
+{
+   uint32_t home = key_hash(key);
+   unsigned i;
+
+   for (i = 0; i < PACK_INDEX_MAX_PROBES; i++) {
+      struct pack_index_slot *slot =
+         &slots[(home + i) & (PACK_INDEX_SLOTS - 1)];
+
+      if (!p_atomic_read(&slot->offset))
+         return insert ? slot : NULL;
+
+      if (key_equals(slot->key, key))
+         return slot;
+   }
+
+   return NULL;
+}
+
+/**
+ * Point \key at a record.  Free slots are published by their offset, which
+ * is written last.
+ */
+static bool
+index_insert(struct pack_index_slot *slots, const cache_key key,
+             uint64_t offset, uint32_t size)
+{
+   struct pack_index_slot *slot = find_slot(slots, key, true);
+
+   if (!slot)
+      return false;
+
+   if (!slot->offset)
+      memcpy(slot->key, key, CACHE_KEY_SIZE);
+   slot->size = size;
+   p_atomic_set(&slot->offset, offset);
+
+   return true;
+}
+
+/**
+ * Index a record appended to the pack, accounting for the bytes it makes
+ * dead.
+ */
+static void
+index_add_record(struct pack_index_header *index, const cache_key key,
+                 uint64_t offset, uint32_t size)
+{
+   struct pack_index_slot *slots = (struct pack_index_slot *) (index + 1);
+   struct pack_index_slot *slot = find_slot(slots, key, false);
+   const uint64_t record_size = sizeof(struct pack_record) + size;
+
+   if (slot && slot->size)
+      index->dead += sizeof(struct pack_record) + slot->size;
+
+   /* Removal marks only matter until the next compaction. */
+   if (!index_insert(slots, key, offset, size) || !size)
+      index->dead += record_size;
+}
+
+typedef void (*record_cb)(void *data, const struct pack_record *record,
+                          uint64_t offset);
+
+/**
+ * Walk the records from offset start on, up to end, or the first record
+ * that doesn't fit.
+ *
+ * \return the end of the last complete record
+ */
+static uint64_t
+scan_records(int fd, uint64_t start, uint64_t end, record_cb cb, void *data)
+{
+   uint64_t offset = start;
+
+   while (offset + sizeof(struct pack_record) <= end) {
+      struct pack_record record;
+
+      if (!pread_all(fd, &record, sizeof(record), offset) ||
+          record.magic != PACK_RECORD_MAGIC ||
+          offset + sizeof(record) + record.size > end)
+         break;
+
+      cb(data, &record, offset);
+      offset += sizeof(record) + record.size;
+   }
+
+   return offset;
+}
+
+static void
+index_record(void *data, const struct pack_record *record, uint64_t offset)
+{
+   index_add_record((struct pack_index_header *) data, record->key, offset,
+                    record->size);
+}
+
+static void
+unmap_index(struct disk_cache_pack *pack)
+{
+   if (pack->index_map)
+      munmap(pack->index_map, PACK_INDEX_SIZE);
+   pack->index_map = NULL;
+   pack->index = NULL;
+   pack->slots = NULL;
+}
+
+static void
+close_files(struct disk_cache_pack *pack)
+{
+   unmap_index(pack);
+   if (pack->fd != -1)
+      close(pack->fd);
+   pack->fd = -1;
+}
+
+static bool
+header_matches(struct disk_cache_pack *pack, const struct stat *sb)
+{
+   bool match = false;
+
+   if (sb->st_size >= pack->header_size) {
+      uint8_t *header = malloc(pack->header_size);
+
+      if (header) {
+         match = pread_all(pack->fd, header, pack->header_size, 0) &&
+                 memcmp(header, pack->header, pack->header_size) == 0;
+         free(header);
+      }
+   }
+
+   return match;
+}
+
+static bool
+index_matches(const struct pack_index_header *index, const struct stat *pack_sb)
+{
+   return index->magic == PACK_INDEX_MAGIC &&
+          index->version == PACK_VERSION &&
+          index->num_slots == PACK_INDEX_SLOTS &&
+          index->end <= pack_sb->st_size;
+}
+
+/**
+ * Map the index, (re)creating it from the pack if it's missing or doesn't
+ * match.  Called with the pack flock()ed, unless read only.
+ */
+static bool
+map_index(struct disk_cache_pack *pack, const struct stat *pack_sb)
+{
+   struct stat sb;
+   int fd;
+
+   fd = open(pack->index_path,
+             (pack->read_only ? O_RDONLY : O_RDWR | O_CREAT) | O_CLOEXEC,
+             0644);
+   if (fd == -1)
+      return false;
+
+   if (fstat(fd, &sb) == -1)
+      goto fail;
+
+   if (!pack->read_only && sb.st_size != PACK_INDEX_SIZE) {
+      /* resizing zeroes it, which the check below catches */
+      if (ftruncate(fd, 0) == -1 || ftruncate(fd, PACK_INDEX_SIZE) == -1)
+         goto fail;
+   } else if (sb.st_size != PACK_INDEX_SIZE) {
+      goto fail;
+   }
+
+   pack->index_map = mmap(NULL, PACK_INDEX_SIZE,
+                          PROT_READ | (pack->read_only ? 0 : PROT_WRITE),
+                          MAP_SHARED, fd, 0);
+   if (pack->index_map == MAP_FAILED) {
+      pack->index_map = NULL;
+      goto fail;
+   }
+   close(fd);
+
+   pack->index = (struct pack_index_header *) pack->index_map;
+   pack->slots = (struct pack_index_slot *) (pack->index + 1);
+
+   if (!index_matches(pack->index, pack_sb)) {
+      if (pack->read_only) {
+         unmap_index(pack);
+         return false;
+      }
+
+      memset(pack->index_map, 0, PACK_INDEX_SIZE);
+      pack->index->magic = PACK_INDEX_MAGIC;
+      pack->index->version = PACK_VERSION;
+      pack->index->num_slots = PACK_INDEX_SLOTS;
+      pack->index->end = scan_records(pack->fd, pack->header_size,
+                                      pack_sb->st_size, index_record,
+                                      pack->index);
+   }
+
+   return true;
+
+ fail:
+   close(fd);
+   return false;
+}
+
+static bool
+open_files(struct disk_cache_pack *pack)
+{
+   struct stat sb;
+
+   pack->fd = open(pack->path,
+                   (pack->read_only ? O_RDONLY : O_RDWR | O_CREAT) | O_CLOEXEC,
+                   0644);
+   if (pack->fd == -1)
+      return false;
+
+   if (!pack->read_only && flock(pack->fd, LOCK_EX) == -1)
+      goto fail;
+
+   if (fstat(pack->fd, &sb) == -1)
+      goto fail_unlock;
+
+   if (!header_matches(pack, &sb)) {
+      if (pack->read_only)
+         goto fail;
+
+      /* new, or not ours (mismatch of the header blob, which also names
+       * the pack, means it is corrupted): start over
+       */
+      if (ftruncate(pack->fd, 0) == -1 ||
+          !pwrite_all(pack->fd, pack->header, pack->header_size, 0) ||
+          fstat(pack->fd, &sb) == -1)
+         goto fail_unlock;
+
+      /* make map_index() rebuild the index */
+      unlink(pack->index_path);
+   }
+
+   if (!map_index(pack, &sb))
+      goto fail_unlock;
+
+   pack->ino = sb.st_ino;
+
+   if (!pack->read_only)
+      flock(pack->fd, LOCK_UN);
+
+   return true;
+
+ fail_unlock:
+   if (!pack->read_only)
+      flock(pack->fd, LOCK_UN);
+ fail:
+   close_files(pack);
+   return false;
+}
+
+/**
+ * Whether a compaction (or a user) replaced or removed the pack file since
+ * we opened it.
+ */
+static bool
+replaced(struct disk_cache_pack *pack)
+{
+   struct stat sb;
+
+   if (pack->read_only)
+      return false;
+
+   return stat(pack->path, &sb) == -1 || sb.st_ino != pack->ino;
+}
+
+static bool
+reopen(struct disk_cache_pack *pack)
+{
+   close_files(pack);
+   return open_files(pack);
+}
+
+/**
+ * Take the cross-process lock on the current pack file, for appending.
+ */
+static bool
+lock_file(struct disk_cache_pack *pack)
+{
+   unsigned tries;
+
+   for (tries = 0; tries < 2; tries++) {
+      if (pack->fd == -1 && !open_files(pack))
+         return false;
+
+      if (flock(pack->fd, LOCK_EX) == -1)
+         return false;
+
+      if (!replaced(pack))
+         return true;
+
+      flock(pack->fd, LOCK_UN);
+      close_files(pack);
+   }
+
+   return false;
+}
+
+static void
+unlock_file(struct disk_cache_pack *pack)
+{
+   flock(pack->fd, LOCK_UN);
+}
+
+struct disk_cache_pack *
+disk_cache_pack_open(const char *dir, const char *name,
+                     const void *header_blob, size_t header_blob_size,
+                     bool read_only)
+{
+   struct disk_cache_pack *pack = calloc(1, sizeof(*pack));
+   struct pack_header header;
+
+   if (!pack)
+      return NULL;
+
+   simple_mtx_init(&pack->mutex, mtx_plain);
+   pack->fd = -1;
+   pack->read_only = read_only;
+
+   if (asprintf(&pack->path, "%s/%s" DISK_CACHE_PACK_SUFFIX,
+                dir, name) == -1) {
+      pack->path = NULL;
+      goto fail;
+   }
+   if (asprintf(&pack->index_path, "%s/%s" DISK_CACHE_PACK_INDEX_SUFFIX,
+                dir, name) == -1) {
+      pack->index_path = NULL;
+      goto fail;
+   }
+
+   memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+   header.version = PACK_VERSION;
+   header.blob_size = header_blob_size;
+
+   pack->header_size = sizeof(header) + header_blob_size;
+   pack->header = malloc(pack->header_size);
+   if (!pack->header)
+      goto fail;
+   memcpy(pack->header, &header, sizeof(header));
+   memcpy(pack->header + sizeof(header), header_blob, header_blob_size);
+
+   if (!open_files(pack))
+      goto fail;
+
+   /* Compaction by size only happens once the pack is full, which a cache
+    * whose entries keep getting removed or replaced may never be.
+    */
+   if (!read_only && pack->index->dead >= PACK_COMPACT_MIN_DEAD &&
+       pack->index->dead * 2 >= pack->index->end)
+      disk_cache_pack_compact(pack, UINT64_MAX);
+
+   return pack;
+
+ fail:
+   disk_cache_pack_close(pack);
+   return NULL;
+}
+
+void
+disk_cache_pack_close(struct disk_cache_pack *pack)
+{
+   if (!pack)
+      return;
+
+   close_files(pack);
+   simple_mtx_destroy(&pack->mutex);
+   free(pack->header);
+   free(pack->index_path);
+   free(pack->path);
+   free(pack);
+}
+
+static void *
+read_record(struct disk_cache_pack *pack, const cache_key key, size_t *size)
+{
+   struct pack_index_slot *slot;
+   struct pack_record record;
+   uint64_t offset;
+   uint32_t payload_size;
+   uint8_t *payload;
+
+   if (pack->fd == -1)
+      return NULL;
+
+   slot = find_slot(pack->slots, key, false);
+   if (!slot)
+      return NULL;
+
+   payload_size = slot->size;
+   offset = p_atomic_read(&slot->offset);
+   if (!payload_size)
+      return NULL;
+
+   if (!pread_all(pack->fd, &record, sizeof(record), offset) ||
+       record.magic != PACK_RECORD_MAGIC ||
+       record.size != payload_size ||
+       !key_equals(record.key, key))
+      return NULL;
+
+   payload = malloc(payload_size);
+   if (!payload)
+      return NULL;
+
+   if (!pread_all(pack->fd, payload, payload_size,
+                  offset + sizeof(record)) ||
+       util_hash_crc32(payload, payload_size) != record.crc32) {
+      free(payload);
+      return NULL;
+   }
+
+   *size = payload_size;
+   return payload;
+}
+
+void *
+disk_cache_pack_get(struct disk_cache_pack *pack, const cache_key key,
+                    size_t *size)
+{
+   void *payload;
+
+   simple_mtx_lock(&pack->mutex);
+
+   payload = read_record(pack, key, size);
+
+   /* A miss may be because the pack got compacted under us. */
+   if (!payload && replaced(pack) && reopen(pack))
+      payload = read_record(pack, key, size);
+
+   simple_mtx_unlock(&pack->mutex);
+
+   return payload;
+}
+
+/**
+ * Append a record at the end of the last complete one, which overwrites
+ * whatever a writer that died half way left behind.
+ */
+static bool
+append_record(struct disk_cache_pack *pack, const cache_key key,
+              const void *payload, uint32_t size)
+{
+   const uint64_t offset = pack->index->end;
+   struct pack_record record;
+
+   record.magic = PACK_RECORD_MAGIC;
+   record.size = size;
+   memcpy(record.key, key, CACHE_KEY_SIZE);
+   record.crc32 = size ? util_hash_crc32(payload, size) : 0;
+
+   if (!pwrite_all(pack->fd, &record, sizeof(record), offset) ||
+       !pwrite_all(pack->fd, payload, size, offset + sizeof(record))) {
+      if (ftruncate(pack->fd, offset) == -1) {
+         /* the next append overwrites it anyway */
+      }
+      return false;
+   }
+
+   pack->index->end = offset + sizeof(record) + size;
+
+   /* A full neighbourhood leaves the record unindexed, and it gets dropped
+    * by the next compaction.
+    */
+   index_add_record(pack->index, key, offset, size);
+
+   return true;
+}
+
+bool
+disk_cache_pack_put(struct disk_cache_pack *pack, const cache_key key,
+                    const void *payload, size_t size, uint64_t max_size)
+{
+   struct pack_index_slot *slot;
+   bool stored = false;
+
+   if (pack->read_only || size > UINT32_MAX)
+      return false;
+
+   simple_mtx_lock(&pack->mutex);
+
+   if (!lock_file(pack)) {
+      simple_mtx_unlock(&pack->mutex);
+      return false;
+   }
+
+   /* Another process may have beaten us to it. */
+   slot = find_slot(pack->slots, key, false);
+   if (slot && slot->size) {
+      stored = true;
+   } else if (pack->index->end + sizeof(struct pack_record) + size <=
+              max_size) {
+      stored = append_record(pack, key, payload, size);
+   }
+
+   unlock_file(pack);
+   simple_mtx_unlock(&pack->mutex);
+
+   return stored;
+}
+
+void
+disk_cache_pack_remove(struct disk_cache_pack *pack, const cache_key key)
+{
+   struct pack_index_slot *slot;
+
+   if (pack->read_only)
+      return;
+
+   simple_mtx_lock(&pack->mutex);
+
+   if (lock_file(pack)) {
+      /* Records stay until compacted, so mark the key removed by a record
+       * too, or compacting would bring it back.
+       */
+      slot = find_slot(pack->slots, key, false);
+      if (slot && slot->size)
+         append_record(pack, key, NULL, 0);
+
+      unlock_file(pack);
+   }
+
+   simple_mtx_unlock(&pack->mutex);
+}
+
+uint64_t
+disk_cache_pack_size(struct disk_cache_pack *pack)
+{
+   uint64_t size = 0;
+
+   simple_mtx_lock(&pack->mutex);
+   if (pack->index)
+      size = p_atomic_read(&pack->index->end);
+   simple_mtx_unlock(&pack->mutex);
+
+   return size;
+}
+
+struct compact_record {
+   cache_key key;
+   uint64_t offset;
+   uint32_t size;
+   bool keep;
+};
+
+struct compact_state {
+   struct compact_record *records;
+   unsigned num_records;
+   unsigned max_records;
+   bool failed;
+};
+
+static void
+collect_record(void *data, const struct pack_record *record, uint64_t offset)
+{
+   struct compact_state *state = (struct compact_state *) data;
+
+   if (state->num_records == state->max_records) {
+      unsigned max_records = MAX2(state->max_records * 2, 1024);
+      struct compact_record *records =
+         realloc(state->records, max_records * sizeof(*records));
+
+      if (!records) {
+         state->failed = true;
+         return;
+      }
+      state->records = records;
+      state->max_records = max_records;
+   }
+
+   struct compact_record *r = &state->records[state->num_records++];
+   memcpy(r->key, record->key, CACHE_KEY_SIZE);
+   r->offset = offset;
+   r->size = record->size;
+   r->keep = false;
+}
+
+/**
+ * Pick the records to keep: the latest one of each key, unless it marks a
+ * removal, going back from the newest until max_size is reached.
+ */
+static bool
+choose_records(struct compact_state *state, uint64_t header_size,
+               uint64_t max_size)
+{
+   struct set *seen = _mesa_set_create(NULL, key_hash, key_equals);
+   uint64_t size = header_size;
+   unsigned i;
+
+   if (!seen)
+      return false;
+
+   for (i = state->num_records; i-- > 0; ) {
+      struct compact_record *r = &state->records[i];
+      uint64_t record_size = sizeof(struct pack_record) + r->size;
+
+      if (_mesa_set_search(seen, r->key))
+         continue;
+      _mesa_set_add(seen, r->key);
+
+      if (!r->size)
+         continue;
+
+      if (size + record_size > max_size)
+         break;
+
+      r->keep = true;
+      size += record_size;
+   }
+
+   _mesa_set_destroy(seen, NULL);
+   return true;
+}
+
+/**
+ * Write the chosen records to a new pack and index at the given paths.
+ */
+static bool
+write_compacted(struct disk_cache_pack *pack, struct compact_state *state,
+                const char *path, const char *index_path)
+{
+   struct pack_index_header *index;
+   uint8_t *buf = NULL;
+   size_t buf_size = 0;
+   uint64_t end = pack->header_size;
+   bool ok = false;
+   unsigned i;
+   int fd, index_fd = -1;
+
+   fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd == -1)
+      return false;
+
+   index = calloc(1, PACK_INDEX_SIZE);
+   if (!index)
+      goto done;
+
+   index->magic = PACK_INDEX_MAGIC;
+   index->version = PACK_VERSION;
+   index->num_slots = PACK_INDEX_SLOTS;
+
+   if (!pwrite_all(fd, pack->header, pack->header_size, 0))
+      goto done;
+
+   for (i = 0; i < state->num_records; i++) {
+      struct compact_record *r = &state->records[i];
+      const struct pack_record *record;
+      size_t record_size = sizeof(*record) + r->size;
+
+      if (!r->keep)
+         continue;
+
+      if (record_size > buf_size) {
+         uint8_t *tmp = realloc(buf, record_size);
+         if (!tmp)
+            goto done;
+         buf = tmp;
+         buf_size = record_size;
+      }
+
+      /* Drop records whose payload got corrupted, or that can't be
+       * indexed.
+       */
+      record = (const struct pack_record *) buf;
+      if (!pread_all(pack->fd, buf, record_size, r->offset) ||
+          util_hash_crc32(buf + sizeof(*record), r->size) != record->crc32 ||
+          !index_insert((struct pack_index_slot *) (index + 1), r->key, end,
+                        r->size))
+         continue;
+
+      if (!pwrite_all(fd, buf, record_size, end))
+         goto done;
+      end += record_size;
+   }
+
+   index->end = end;
+
+   index_fd = open(index_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                   0644);
+   if (index_fd == -1)
+      goto done;
+
+   ok = pwrite_all(index_fd, index, PACK_INDEX_SIZE, 0);
+
+ done:
+   if (index_fd != -1)
+      close(index_fd);
+   close(fd);
+   free(index);
+   free(buf);
+   return ok;
+}
+
+bool
+disk_cache_pack_compact(struct disk_cache_pack *pack, uint64_t max_size)
+{
+   struct compact_state state = { 0 };
+   char *tmp_path = NULL, *tmp_index_path = NULL;
+   bool ok = false;
+
+   if (pack->read_only)
+      return false;
+
+   simple_mtx_lock(&pack->mutex);
+
+   if (!lock_file(pack)) {
+      simple_mtx_unlock(&pack->mutex);
+      return false;
+   }
+
+   if (asprintf(&tmp_path, "%s.tmp", pack->path) == -1) {
+      tmp_path = NULL;
+      goto done;
+   }
+   if (asprintf(&tmp_index_path, "%s.tmp", pack->index_path) == -1) {
+      tmp_index_path = NULL;
+      goto done;
+   }
+
+   scan_records(pack->fd, pack->header_size, pack->index->end,
+                collect_record, &state);
+   if (state.failed ||
+       !choose_records(&state, pack->header_size, max_size) ||
+       !write_compacted(pack, &state, tmp_path, tmp_index_path)) {
+      unlink(tmp_path);
+      unlink(tmp_index_path);
+      goto done;
+   }
+
+   /* Index first: a process opening the files in between gets the old pack
+    * with the new index, which only makes for misses until it notices the
+    * new pack.
+    */
+   if (rename(tmp_index_path, pack->index_path) == -1 ||
+       rename(tmp_path, pack->path) == -1) {
+      unlink(tmp_path);
+      unlink(tmp_index_path);
+      goto done;
+   }
+
+   ok = true;
+
+ done:
+   /* Appenders waiting for the lock notice the new pack once they get it. */
+   unlock_file(pack);
+   if (ok)
+      reopen(pack);
+
+   simple_mtx_unlock(&pack->mutex);
+
+   free(state.records);
+   free(tmp_index_path);
+   free(tmp_path);
+   return ok;
+}
+
+#endif /* ENABLE_SHADER_CACHE */
@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Packed storage for disk_cache entries.
+ *
+ * Instead of one file per entry, entries are appended to a single pack file
+ * per set of driver keys, and looked up through an index file which every
+ * process maps shared:
+ *
+ *   <name>.pack:  header, then records (record header + entry payload)
+ *   <name>.idx:   header, then an open addressed table of key -> record
+ *
+ * Appends and index updates are serialized between processes by an
+ * exclusive flock() on the pack file.  Lookups don't take it: index slots
+ * are published by writing their offset last, and every record is checked
+ * against its key and CRC when read, so a racing or torn write is just a
+ * miss.
+ *
+ * Nothing is ever rewritten in place.  disk_cache_pack_compact() drops
+ * removed, duplicated and least recently added records by writing a new
+ * pack and index and renaming them over the old ones; other processes
+ * notice the new files and reopen them.  The cache compacts a pack once it
+ * is full, and opening one compacts it when most of it is dead records.
+ */
+
+#ifndef DISK_CACHE_PACK_H
+#define DISK_CACHE_PACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "disk_cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DISK_CACHE_PACK_SUFFIX ".pack"
+#define DISK_CACHE_PACK_INDEX_SUFFIX ".idx"
+
+struct disk_cache_pack;
+
+/**
+ * Open (creating it unless read_only) the pack <dir>/<name>.pack and its
+ * index.  The pack's header records header_blob, and a pack with another
+ * one is not used: reset if writable, ignored if read only.
+ *
+ * \return NULL if the pack can't be used
+ */
+struct disk_cache_pack *
+disk_cache_pack_open(const char *dir, const char *name,
+                     const void *header_blob, size_t header_blob_size,
+                     bool read_only);
+
+void
+disk_cache_pack_close(struct disk_cache_pack *pack);
+
+/**
+ * Look up the payload stored under \key.
+ *
+ * \return a malloc'ed copy of the payload, or NULL
+ */
+void *
+disk_cache_pack_get(struct disk_cache_pack *pack, const cache_key key,
+                    size_t *size);
+
+/**
+ * Append a payload under \key, unless it's already there or the pack would
+ * grow beyond \max_size.
+ *
+ * \return whether \key is now in the pack
+ */
+bool
+disk_cache_pack_put(struct disk_cache_pack *pack, const cache_key key,
+                    const void *payload, size_t size, uint64_t max_size);
+
+/**
+ * Hide \key from lookups until it is put again.
+ */
+void
+disk_cache_pack_remove(struct disk_cache_pack *pack, const cache_key key);
+
+/**
+ * Size of the pack file, in bytes.
+ */
+uint64_t
+disk_cache_pack_size(struct disk_cache_pack *pack);
+
+/**
+ * Rewrite the pack without removed or duplicated records, keeping the most
+ * recently added ones that fit in \max_size bytes.
+ *
+ * Other processes may keep using the pack meanwhile, but their appends wait
+ * for the compaction to finish.
+ */
+bool
+disk_cache_pack_compact(struct disk_cache_pack *pack, uint64_t max_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_CACHE_PACK_H */
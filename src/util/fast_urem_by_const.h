@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef FAST_UREM_BY_CONST_H
+#define FAST_UREM_BY_CONST_H
+
+#include <assert.h>
+#include <stdint.h>
+
+/*
+ * Computes n % d for a divisor known in advance, with two multiplications
+ * instead of a division, see:
+ *
+ * D. Lemire, O. Kaser, N. Kurz, "Faster Remainder by Direct Computation:
+ * Applications to Compilers and Software Libraries"
+ *
+ * The magic number returned by util_fast_urem32_magic(d) is passed to
+ * util_fast_urem32 along with d. It is valid for any d > 1 and any n.
+ */
+
+static inline uint64_t
+util_fast_urem32_magic(uint32_t d)
+{
+   assert(d > 1);
+   return UINT64_MAX / d + 1;
+}
+
+/* The high 64 bits of the 96-bit product of a and b. */
+static inline uint32_t
+_util_mul32by64_hi(uint32_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+   return ((unsigned __int128) b * a) >> 64;
+#else
+   /* With b = b0 + 2^32 * b1, a * b = a * b0 + 2^32 * a * b1, and the low
+    * 32 bits of a * b0 can't carry into bit 64.
+    */
+   uint64_t b0 = b & UINT32_MAX;
+   uint64_t b1 = b >> 32;
+
+   return ((uint64_t) a * b1 + (((uint64_t) a * b0) >> 32)) >> 32;
+#endif
+}
+
+static inline uint32_t
+util_fast_urem32(uint32_t n, uint32_t d, uint64_t magic)
+{
+   uint64_t lowbits = magic * n;
+   uint32_t result = _util_mul32by64_hi(d, lowbits);
+
+   assert(result == n % d);
+   return result;
+}
+
+#endif /* FAST_UREM_BY_CONST_H */
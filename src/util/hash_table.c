@@ -47,6 +47,7 @@
 #include "hash_table.h"
 #include "ralloc.h"
 #include "macros.h"
+#include "fast_urem_by_const.h"
 #include "main/hash.h"
 
 static const uint32_t deleted_key_value;
@@ -110,6 +111,17 @@ entry_is_present(const struct hash_table *ht, struct hash_entry *entry)
    return entry->key != NULL && entry->key != ht->deleted_key;
 }
 
+static void
+hash_table_set_size_index(struct hash_table *ht, uint32_t size_index)
+{
+   ht->size_index = size_index;
+   ht->size = hash_sizes[size_index].size;
+   ht->rehash = hash_sizes[size_index].rehash;
+   ht->size_magic = util_fast_urem32_magic(ht->size);
+   ht->rehash_magic = util_fast_urem32_magic(ht->rehash);
+   ht->max_entries = hash_sizes[size_index].max_entries;
+}
+
 struct hash_table *
 _mesa_hash_table_create(void *mem_ctx,
                         uint32_t (*key_hash_function)(const void *key),
@@ -122,10 +134,7 @@ _mesa_hash_table_create(void *mem_ctx,
    if (ht == NULL)
       return NULL;
 
-   ht->size_index = 0;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
+   hash_table_set_size_index(ht, 0);
    ht->key_hash_function = key_hash_function;
    ht->key_equals_function = key_equals_function;
    ht->table = rzalloc_array(ht, struct hash_entry, ht->size);
@@ -228,15 +237,38 @@ _mesa_hash_table_set_deleted_key(struct hash_table *ht, const void *deleted_key)
    ht->deleted_key = deleted_key;
 }
 
+/* The first address to probe for the hash, and the step to the next. */
+static inline uint32_t
+hash_table_start_address(const struct hash_table *ht, uint32_t hash)
+{
+   return util_fast_urem32(hash, ht->size, ht->size_magic);
+}
+
+static inline uint32_t
+hash_table_double_hash(const struct hash_table *ht, uint32_t hash)
+{
+   return 1 + util_fast_urem32(hash, ht->rehash, ht->rehash_magic);
+}
+
+/* Both the address and the step are below the size. */
+static inline uint32_t
+hash_table_next_address(const struct hash_table *ht, uint32_t hash_address,
+                        uint32_t double_hash)
+{
+   hash_address += double_hash;
+   if (hash_address >= ht->size)
+      hash_address -= ht->size;
+   return hash_address;
+}
+
 static struct hash_entry *
 hash_table_search(struct hash_table *ht, uint32_t hash, const void *key)
 {
-   uint32_t start_hash_address = hash % ht->size;
+   uint32_t start_hash_address = hash_table_start_address(ht, hash);
+   uint32_t double_hash = hash_table_double_hash(ht, hash);
    uint32_t hash_address = start_hash_address;
 
    do {
-      uint32_t double_hash;
-
       struct hash_entry *entry = ht->table + hash_address;
 
       if (entry_is_free(entry)) {
@@ -247,9 +279,7 @@ hash_table_search(struct hash_table *ht, uint32_t hash, const void *key)
          }
       }
 
-      double_hash = 1 + hash % ht->rehash;
-
-      hash_address = (hash_address + double_hash) % ht->size;
+      hash_address = hash_table_next_address(ht, hash_address, double_hash);
    } while (hash_address != start_hash_address);
 
    return NULL;
@@ -297,10 +327,7 @@ _mesa_hash_table_rehash(struct hash_table *ht, unsigned new_size_index)
    old_ht = *ht;
 
    ht->table = table;
-   ht->size_index = new_size_index;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
+   hash_table_set_size_index(ht, new_size_index);
    ht->entries = 0;
    ht->deleted_entries = 0;
 
@@ -315,7 +342,7 @@ static struct hash_entry *
 hash_table_insert(struct hash_table *ht, uint32_t hash,
                   const void *key, void *data)
 {
-   uint32_t start_hash_address, hash_address;
+   uint32_t start_hash_address, hash_address, double_hash;
    struct hash_entry *available_entry = NULL;
 
    assert(key != NULL);
@@ -326,11 +353,11 @@ hash_table_insert(struct hash_table *ht, uint32_t hash,
       _mesa_hash_table_rehash(ht, ht->size_index);
    }
 
-   start_hash_address = hash % ht->size;
+   start_hash_address = hash_table_start_address(ht, hash);
+   double_hash = hash_table_double_hash(ht, hash);
    hash_address = start_hash_address;
    do {
       struct hash_entry *entry = ht->table + hash_address;
-      uint32_t double_hash;
 
       if (!entry_is_present(ht, entry)) {
          /* Stash the first available entry we find */
@@ -359,10 +386,7 @@ hash_table_insert(struct hash_table *ht, uint32_t hash,
          return entry;
       }
 
-
-      double_hash = 1 + hash % ht->rehash;
-
-      hash_address = (hash_address + double_hash) % ht->size;
+      hash_address = hash_table_next_address(ht, hash_address, double_hash);
    } while (hash_address != start_hash_address);
 
    if (available_entry) {
@@ -489,35 +513,107 @@ _mesa_hash_table_random_entry(struct hash_table *ht,
 }
 
 
-/**
- * Quick FNV-1a hash implementation based on:
- * http://www.isthe.com/chongo/tech/comp/fnv/
+/*
+ * xxHash32 by Yann Collet, see https://github.com/Cyan4973/xxHash.
  *
- * FNV-1a is not be the best hash out there -- Jenkins's lookup3 is supposed
- * to be quite good, and it probably beats FNV.  But FNV has the advantage
- * that it involves almost no code.  For an improvement on both, see Paul
- * Hsieh's http://www.azillionmonkeys.com/qed/hash.html
+ * It consumes 16 bytes per iteration in four independent lanes, so it is
+ * several times faster than byte-at-a-time hashes like FNV-1a for all but
+ * the smallest keys, with better distribution. Words are read in native
+ * byte order, so hashes differ between little and big endian machines.
+ * They're not meant to be stored.
  */
+#define XXH_PRIME32_1 2654435761u
+#define XXH_PRIME32_2 2246822519u
+#define XXH_PRIME32_3 3266489917u
+#define XXH_PRIME32_4  668265263u
+#define XXH_PRIME32_5  374761393u
+
+static inline uint32_t
+xxh_rotl32(uint32_t x, unsigned r)
+{
+   return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t
+xxh_read32(const uint8_t *p)
+{
+   uint32_t v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+static inline uint32_t
+xxh32_round(uint32_t acc, uint32_t input)
+{
+   acc += input * XXH_PRIME32_2;
+   acc = xxh_rotl32(acc, 13);
+   return acc * XXH_PRIME32_1;
+}
+
+static uint32_t
+xxh32(const void *data, size_t size, uint32_t seed)
+{
+   const uint8_t *p = (const uint8_t *)data;
+   const uint8_t *end = p + size;
+   uint32_t hash;
+
+   if (size >= 16) {
+      const uint8_t *limit = end - 16;
+      uint32_t v1 = seed + XXH_PRIME32_1 + XXH_PRIME32_2;
+      uint32_t v2 = seed + XXH_PRIME32_2;
+      uint32_t v3 = seed;
+      uint32_t v4 = seed - XXH_PRIME32_1;
+
+      do {
+         v1 = xxh32_round(v1, xxh_read32(p));
+         v2 = xxh32_round(v2, xxh_read32(p + 4));
+         v3 = xxh32_round(v3, xxh_read32(p + 8));
+         v4 = xxh32_round(v4, xxh_read32(p + 12));
+         p += 16;
+      } while (p <= limit);
+
+      hash = xxh_rotl32(v1, 1) + xxh_rotl32(v2, 7) +
+             xxh_rotl32(v3, 12) + xxh_rotl32(v4, 18);
+   } else {
+      hash = seed + XXH_PRIME32_5;
+   }
+
+   hash += (uint32_t)size;
+
+   while (p + 4 <= end) {
+      hash += xxh_read32(p) * XXH_PRIME32_3;
+      hash = xxh_rotl32(hash, 17) * XXH_PRIME32_4;
+      p += 4;
+   }
+
+   while (p < end) {
+      hash += *p * XXH_PRIME32_5;
+      hash = xxh_rotl32(hash, 11) * XXH_PRIME32_1;
+      p++;
+   }
+
+   hash ^= hash >> 15;
+   hash *= XXH_PRIME32_2;
+   hash ^= hash >> 13;
+   hash *= XXH_PRIME32_3;
+   hash ^= hash >> 16;
+
+   return hash;
+}
+
 uint32_t
 _mesa_hash_data(const void *data, size_t size)
 {
-   return _mesa_fnv32_1a_accumulate_block(_mesa_fnv32_1a_offset_bias,
-                                          data, size);
+   return xxh32(data, size, 0);
 }
 
-/** FNV-1a string hash implementation */
+/** String hash, see _mesa_hash_data */
 uint32_t
 _mesa_hash_string(const void *_key)
 {
-   uint32_t hash = _mesa_fnv32_1a_offset_bias;
    const char *key = _key;
 
-   while (*key != 0) {
-      hash = _mesa_fnv32_1a_accumulate(hash, *key);
-      key++;
-   }
-
-   return hash;
+   return xxh32(key, strlen(key), 0);
 }
 
 /**
@@ -39,6 +39,7 @@
 #include "macros.h"
 #include "ralloc.h"
 #include "set.h"
+#include "fast_urem_by_const.h"
 
 /*
  * From Knuth -- a good choice for hash/rehash values is p, p-2 where
@@ -103,6 +104,41 @@ entry_is_present(struct set_entry *entry)
    return entry->key != NULL && entry->key != deleted_key;
 }
 
+static void
+set_set_size_index(struct set *ht, uint32_t size_index)
+{
+   ht->size_index = size_index;
+   ht->size = hash_sizes[size_index].size;
+   ht->rehash = hash_sizes[size_index].rehash;
+   ht->size_magic = util_fast_urem32_magic(ht->size);
+   ht->rehash_magic = util_fast_urem32_magic(ht->rehash);
+   ht->max_entries = hash_sizes[size_index].max_entries;
+}
+
+/* The first address to probe for the hash, and the step to the next. */
+static inline uint32_t
+set_start_address(const struct set *ht, uint32_t hash)
+{
+   return util_fast_urem32(hash, ht->size, ht->size_magic);
+}
+
+static inline uint32_t
+set_double_hash(const struct set *ht, uint32_t hash)
+{
+   return 1 + util_fast_urem32(hash, ht->rehash, ht->rehash_magic);
+}
+
+/* Both the address and the step are below the size. */
+static inline uint32_t
+set_next_address(const struct set *ht, uint32_t hash_address,
+                 uint32_t double_hash)
+{
+   hash_address += double_hash;
+   if (hash_address >= ht->size)
+      hash_address -= ht->size;
+   return hash_address;
+}
+
 struct set *
 _mesa_set_create(void *mem_ctx,
                  uint32_t (*key_hash_function)(const void *key),
@@ -115,10 +151,7 @@ _mesa_set_create(void *mem_ctx,
    if (ht == NULL)
       return NULL;
 
-   ht->size_index = 0;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
+   set_set_size_index(ht, 0);
    ht->key_hash_function = key_hash_function;
    ht->key_equals_function = key_equals_function;
    ht->table = rzalloc_array(ht, struct set_entry, ht->size);
@@ -209,12 +242,11 @@ _mesa_set_clear(struct set *set, void (*delete_function)(struct set_entry *entry
 static struct set_entry *
 set_search(const struct set *ht, uint32_t hash, const void *key)
 {
-   uint32_t hash_address;
+   uint32_t start_hash_address = set_start_address(ht, hash);
+   uint32_t double_hash = set_double_hash(ht, hash);
+   uint32_t hash_address = start_hash_address;
 
-   hash_address = hash % ht->size;
    do {
-      uint32_t double_hash;
-
       struct set_entry *entry = ht->table + hash_address;
 
       if (entry_is_free(entry)) {
@@ -225,10 +257,8 @@ set_search(const struct set *ht, uint32_t hash, const void *key)
          }
       }
 
-      double_hash = 1 + hash % ht->rehash;
-
-      hash_address = (hash_address + double_hash) % ht->size;
-   } while (hash_address != hash % ht->size);
+      hash_address = set_next_address(ht, hash_address, double_hash);
+   } while (hash_address != start_hash_address);
 
    return NULL;
 }
@@ -269,10 +299,7 @@ set_rehash(struct set *ht, unsigned new_size_index)
    old_ht = *ht;
 
    ht->table = table;
-   ht->size_index = new_size_index;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
+   set_set_size_index(ht, new_size_index);
    ht->entries = 0;
    ht->deleted_entries = 0;
 
@@ -292,7 +319,7 @@ set_rehash(struct set *ht, unsigned new_size_index)
 static struct set_entry *
 set_add(struct set *ht, uint32_t hash, const void *key)
 {
-   uint32_t hash_address;
+   uint32_t start_hash_address, hash_address, double_hash;
    struct set_entry *available_entry = NULL;
 
    if (ht->entries >= ht->max_entries) {
@@ -301,10 +328,11 @@ set_add(struct set *ht, uint32_t hash, const void *key)
       set_rehash(ht, ht->size_index);
    }
 
-   hash_address = hash % ht->size;
+   start_hash_address = set_start_address(ht, hash);
+   double_hash = set_double_hash(ht, hash);
+   hash_address = start_hash_address;
    do {
       struct set_entry *entry = ht->table + hash_address;
-      uint32_t double_hash;
 
       if (!entry_is_present(entry)) {
          /* Stash the first available entry we find */
@@ -331,10 +359,8 @@ set_add(struct set *ht, uint32_t hash, const void *key)
          return entry;
       }
 
-      double_hash = 1 + hash % ht->rehash;
-
-      hash_address = (hash_address + double_hash) % ht->size;
-   } while (hash_address != hash % ht->size);
+      hash_address = set_next_address(ht, hash_address, double_hash);
+   } while (hash_address != start_hash_address);
 
    if (available_entry) {
       if (entry_is_deleted(available_entry))
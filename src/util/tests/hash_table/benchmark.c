@@ -0,0 +1,204 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Measures the throughput of the hash functions and of hash table inserts
+ * and lookups for common kinds of keys, with FNV-1a as a reference hash.
+ *
+ * Not a test, run it by hand: benchmark [num_keys [num_rounds]]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "os_time.h"
+
+#define STRING_KEY_SIZE 32
+
+struct key_type {
+   const char *name;
+   unsigned size; /* 0 for strings */
+   uint32_t (*hash)(const void *key);
+   uint32_t (*fnv_hash)(const void *key);
+   bool (*equals)(const void *a, const void *b);
+};
+
+static unsigned num_keys = 100000;
+static unsigned num_rounds = 10;
+
+#define DEFINE_DATA_KEY(size)                                              \
+   static uint32_t hash_data_##size(const void *key)                       \
+   {                                                                       \
+      return _mesa_hash_data(key, size);                                   \
+   }                                                                       \
+   static uint32_t fnv_data_##size(const void *key)                        \
+   {                                                                       \
+      return _mesa_fnv32_1a_accumulate_block(_mesa_fnv32_1a_offset_bias,   \
+                                             key, size);                   \
+   }                                                                       \
+   static bool equals_data_##size(const void *a, const void *b)            \
+   {                                                                       \
+      return memcmp(a, b, size) == 0;                                      \
+   }
+
+DEFINE_DATA_KEY(4)
+DEFINE_DATA_KEY(16)
+DEFINE_DATA_KEY(64)
+
+static uint32_t
+fnv_string(const void *key)
+{
+   return _mesa_fnv32_1a_accumulate_block(_mesa_fnv32_1a_offset_bias,
+                                          key, strlen(key));
+}
+
+static const struct key_type key_types[] = {
+   { "pointer", sizeof(void *), _mesa_hash_pointer, NULL,
+     _mesa_key_pointer_equal },
+   { "data-4", 4, hash_data_4, fnv_data_4, equals_data_4 },
+   { "data-16", 16, hash_data_16, fnv_data_16, equals_data_16 },
+   { "data-64", 64, hash_data_64, fnv_data_64, equals_data_64 },
+   { "string", 0, _mesa_hash_string, fnv_string, _mesa_key_string_equal },
+};
+
+static unsigned
+key_stride(const struct key_type *type)
+{
+   return type->size ? type->size : STRING_KEY_SIZE;
+}
+
+/* Random keys, and for strings identifiers like GLSL variable names.
+ * Pointer keys are the addresses of the keys.
+ */
+static void *
+create_keys(const struct key_type *type)
+{
+   unsigned stride = key_stride(type);
+   uint8_t *data = malloc((size_t)num_keys * stride);
+
+   if (!data)
+      return NULL;
+
+   for (unsigned i = 0; i < num_keys; i++) {
+      uint8_t *key = data + (size_t)i * stride;
+
+      if (type->size) {
+         for (unsigned j = 0; j < type->size; j++)
+            key[j] = rand();
+      } else {
+         snprintf((char *)key, stride, "gl_var_%u_%x", i, rand());
+      }
+   }
+
+   return data;
+}
+
+static const void *
+get_key(const struct key_type *type, void *data, unsigned i)
+{
+   return (uint8_t *)data + (size_t)i * key_stride(type);
+}
+
+static double
+ns_per_key(int64_t start)
+{
+   return (double)(os_time_get_nano() - start) / num_keys / num_rounds;
+}
+
+static void
+bench_hash(const char *name, const struct key_type *type,
+           uint32_t (*hash)(const void *key), void *data)
+{
+   uint32_t sum = 0;
+   int64_t start = os_time_get_nano();
+
+   for (unsigned r = 0; r < num_rounds; r++) {
+      for (unsigned i = 0; i < num_keys; i++)
+         sum += hash(get_key(type, data, i));
+   }
+
+   printf("  %-8s hash    %7.2f ns/key (%08x)\n", name,
+          ns_per_key(start), sum);
+}
+
+static void
+bench_table(const char *name, const struct key_type *type,
+            uint32_t (*hash)(const void *key), void *data)
+{
+   double insert_ns = 0, search_ns = 0;
+   unsigned found = 0;
+
+   for (unsigned r = 0; r < num_rounds; r++) {
+      struct hash_table *ht =
+         _mesa_hash_table_create(NULL, hash, type->equals);
+      int64_t start = os_time_get_nano();
+
+      for (unsigned i = 0; i < num_keys; i++)
+         _mesa_hash_table_insert(ht, get_key(type, data, i), NULL);
+      insert_ns += os_time_get_nano() - start;
+
+      start = os_time_get_nano();
+      for (unsigned i = 0; i < num_keys; i++)
+         found += _mesa_hash_table_search(ht, get_key(type, data, i)) != NULL;
+      search_ns += os_time_get_nano() - start;
+
+      _mesa_hash_table_destroy(ht, NULL);
+   }
+
+   printf("  %-8s insert  %7.2f ns/key\n", name,
+          insert_ns / num_keys / num_rounds);
+   printf("  %-8s search  %7.2f ns/key (%u found)\n", name,
+          search_ns / num_keys / num_rounds, found / num_rounds);
+}
+
+int
+main(int argc, char **argv)
+{
+   if (argc > 1)
+      num_keys = MAX2(atoi(argv[1]), 1);
+   if (argc > 2)
+      num_rounds = MAX2(atoi(argv[2]), 1);
+
+   printf("%u keys, %u rounds\n", num_keys, num_rounds);
+
+   for (unsigned t = 0; t < ARRAY_SIZE(key_types); t++) {
+      const struct key_type *type = &key_types[t];
+      void *data = create_keys(type);
+
+      if (!data)
+         return 1;
+
+      printf("%s:\n", type->name);
+      bench_hash("mesa", type, type->hash, data);
+      if (type->fnv_hash)
+         bench_hash("fnv-1a", type, type->fnv_hash, data);
+      bench_table("mesa", type, type->hash, data);
+      if (type->fnv_hash)
+         bench_table("fnv-1a", type, type->fnv_hash, data);
+
+      free(data);
+   }
+
+   return 0;
+}
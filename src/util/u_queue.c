@@ -226,11 +226,194 @@ util_queue_fence_destroy(struct util_queue_fence *fence)
  * util_queue implementation
  */
 
+/* How long a thread of a UTIL_QUEUE_INIT_SCALE_THREADS queue waits for a
+ * job before stopping.
+ */
+#define UTIL_QUEUE_IDLE_TIMEOUT_SEC 1
+
 struct thread_input {
    struct util_queue *queue;
    int thread_index;
 };
 
+/* A read that, unlike p_atomic_read, can't be ordered before the atomic
+ * operations preceding it. A thread incrementing A then reading B and
+ * another incrementing B then reading A this way can't both miss the other
+ * increment, which is what lets workers sleep and producers wait for space
+ * without a lock on the fast paths.
+ */
+static inline int
+read_fenced(int *v)
+{
+   return p_atomic_cmpxchg(v, 0, 0);
+}
+
+static void
+ring_push(struct util_queue_ring *ring, const struct util_queue_job *job)
+{
+   if (ring->num_queued == ring->size) {
+      unsigned new_size = MAX2(ring->size * 2, 8);
+      struct util_queue_job *jobs =
+         (struct util_queue_job*)malloc(new_size *
+                                        sizeof(struct util_queue_job));
+      assert(jobs);
+
+      for (unsigned i = 0; i < ring->num_queued; i++)
+         jobs[i] = ring->jobs[(ring->read_idx + i) & (ring->size - 1)];
+
+      free(ring->jobs);
+      ring->jobs = jobs;
+      ring->size = new_size;
+      ring->read_idx = 0;
+   }
+
+   ring->jobs[(ring->read_idx + ring->num_queued) & (ring->size - 1)] = *job;
+   p_atomic_set(&ring->num_queued, ring->num_queued + 1);
+}
+
+static bool
+ring_pop(struct util_queue_ring *ring, struct util_queue_job *job)
+{
+   if (!ring->num_queued)
+      return false;
+
+   *job = ring->jobs[ring->read_idx];
+   ring->read_idx = (ring->read_idx + 1) & (ring->size - 1);
+   p_atomic_set(&ring->num_queued, ring->num_queued - 1);
+   return true;
+}
+
+/**
+ * Take the next job for the thread: the oldest job of the highest priority,
+ * from the thread's own jobs first and then from the other threads'.
+ */
+static bool
+util_queue_get_job(struct util_queue *queue, unsigned thread_index,
+                   struct util_queue_job *job)
+{
+   for (unsigned p = 0; p < UTIL_QUEUE_NUM_PRIORITIES; p++) {
+      for (unsigned i = 0; i < queue->max_threads; i++) {
+         unsigned w = (thread_index + i) % queue->max_threads;
+         struct util_queue_worker *worker = &queue->workers[w];
+         bool found;
+
+         if (!p_atomic_read(&worker->rings[p].num_queued))
+            continue;
+
+         mtx_lock(&worker->lock);
+         found = ring_pop(&worker->rings[p], job);
+         mtx_unlock(&worker->lock);
+
+         if (found) {
+            if (i)
+               p_atomic_inc(&queue->stats.num_stolen);
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+static void
+util_queue_job_done(struct util_queue *queue, unsigned generation)
+{
+   if (p_atomic_dec_zero(&queue->num_pending[generation & 1])) {
+      mtx_lock(&queue->lock);
+      cnd_broadcast(&queue->finished_cond);
+      mtx_unlock(&queue->lock);
+   }
+}
+
+/* Signal the fences of all queued jobs, when the threads are killed. */
+static void
+util_queue_signal_remaining(struct util_queue *queue)
+{
+   for (unsigned w = 0; w < queue->max_threads; w++) {
+      struct util_queue_worker *worker = &queue->workers[w];
+
+      mtx_lock(&worker->lock);
+      for (unsigned p = 0; p < UTIL_QUEUE_NUM_PRIORITIES; p++) {
+         struct util_queue_job job;
+
+         while (ring_pop(&worker->rings[p], &job)) {
+            p_atomic_dec(&queue->num_queued);
+            if (job.job) {
+               util_queue_fence_signal(job.fence);
+               util_queue_job_done(queue, job.generation);
+            }
+         }
+      }
+      mtx_unlock(&worker->lock);
+   }
+}
+
+static void
+update_max(uint64_t *max, uint64_t value)
+{
+   uint64_t old = p_atomic_read(max);
+
+   while (value > old) {
+      uint64_t prev = p_atomic_cmpxchg(max, old, value);
+      if (prev == old)
+         break;
+      old = prev;
+   }
+}
+
+/* Must be called with the queue lock held. */
+static bool
+util_queue_thread_should_exit(struct util_queue *queue, unsigned thread_index)
+{
+   if (!queue->kill_threads && thread_index < queue->num_threads)
+      return false;
+
+   queue->workers[thread_index].exited = true;
+   return true;
+}
+
+/**
+ * Sleep until there may be a job. Returns false if the thread should exit.
+ */
+static bool
+util_queue_wait_for_job(struct util_queue *queue, unsigned thread_index)
+{
+   bool keep_running;
+
+   mtx_lock(&queue->lock);
+   if (util_queue_thread_should_exit(queue, thread_index)) {
+      mtx_unlock(&queue->lock);
+      return false;
+   }
+
+   p_atomic_inc(&queue->num_sleeping);
+   if (!read_fenced(&queue->num_queued)) {
+      /* The last thread of a scaling queue stops when idle, but the first
+       * thread always stays.
+       */
+      if (queue->flags & UTIL_QUEUE_INIT_SCALE_THREADS &&
+          thread_index > 0 && thread_index == queue->num_threads - 1) {
+         struct timespec ts;
+
+         timespec_get(&ts, TIME_UTC);
+         ts.tv_sec += UTIL_QUEUE_IDLE_TIMEOUT_SEC;
+
+         if (cnd_timedwait(&queue->has_queued_cond, &queue->lock,
+                           &ts) != thrd_success &&
+             !p_atomic_read(&queue->num_queued) &&
+             thread_index == queue->num_threads - 1)
+            p_atomic_set(&queue->num_threads, thread_index);
+      } else {
+         cnd_wait(&queue->has_queued_cond, &queue->lock);
+      }
+   }
+   p_atomic_dec(&queue->num_sleeping);
+
+   keep_running = !util_queue_thread_should_exit(queue, thread_index);
+   mtx_unlock(&queue->lock);
+   return keep_running;
+}
+
 static int
 util_queue_thread_func(void *input)
 {
@@ -248,49 +431,107 @@ util_queue_thread_func(void *input)
    while (1) {
       struct util_queue_job job;
 
-      mtx_lock(&queue->lock);
-      assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
-
-      /* wait if the queue is empty */
-      while (!queue->kill_threads && queue->num_queued == 0)
-         cnd_wait(&queue->has_queued_cond, &queue->lock);
-
-      if (queue->kill_threads) {
+      if (p_atomic_read(&queue->kill_threads) ||
+          (unsigned)thread_index >= p_atomic_read(&queue->num_threads)) {
+         mtx_lock(&queue->lock);
+         bool exit = util_queue_thread_should_exit(queue, thread_index);
          mtx_unlock(&queue->lock);
-         break;
+         if (exit)
+            break;
       }
 
-      job = queue->jobs[queue->read_idx];
-      memset(&queue->jobs[queue->read_idx], 0, sizeof(struct util_queue_job));
-      queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
+      if (!util_queue_get_job(queue, thread_index, &job)) {
+         if (!util_queue_wait_for_job(queue, thread_index))
+            break;
+         continue;
+      }
 
-      queue->num_queued--;
-      cnd_signal(&queue->has_space_cond);
-      mtx_unlock(&queue->lock);
+      p_atomic_dec(&queue->num_queued);
+      if (read_fenced(&queue->num_waiting_for_space)) {
+         mtx_lock(&queue->lock);
+         cnd_signal(&queue->has_space_cond);
+         mtx_unlock(&queue->lock);
+      }
 
       if (job.job) {
+         int64_t start = os_time_get_nano();
+
          job.execute(job.job, thread_index);
          util_queue_fence_signal(job.fence);
          if (job.cleanup)
             job.cleanup(job.job, thread_index);
+
+         int64_t end = os_time_get_nano();
+         p_atomic_inc(&queue->stats.num_jobs);
+         p_atomic_add(&queue->stats.total_wait_ns, start - job.add_time);
+         p_atomic_add(&queue->stats.total_run_ns, end - start);
+         update_max(&queue->stats.max_wait_ns, start - job.add_time);
+
+         util_queue_job_done(queue, job.generation);
       }
    }
 
    /* signal remaining jobs before terminating */
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].job) {
-         util_queue_fence_signal(queue->jobs[i].fence);
-         queue->jobs[i].job = NULL;
-      }
-   }
-   queue->read_idx = queue->write_idx;
-   queue->num_queued = 0;
-   mtx_unlock(&queue->lock);
+   if (p_atomic_read(&queue->kill_threads))
+      util_queue_signal_remaining(queue);
    return 0;
 }
 
+/**
+ * Start the thread of the given index, or keep it if it is still running.
+ * Called with the queue lock held, or from util_queue_init.
+ */
+static bool
+util_queue_start_thread(struct util_queue *queue, unsigned index)
+{
+   struct util_queue_worker *worker = &queue->workers[index];
+   struct thread_input *input;
+
+   if (worker->started) {
+      /* A stopping thread only exits once it has seen it should under the
+       * lock, so it can just carry on if it hasn't.
+       */
+      if (!worker->exited)
+         return true;
+
+      thrd_join(queue->threads[index], NULL);
+      worker->started = false;
+   }
+
+   input = (struct thread_input *) malloc(sizeof(struct thread_input));
+   if (!input)
+      return false;
+
+   input->queue = queue;
+   input->thread_index = index;
+
+   queue->threads[index] = u_thread_create(util_queue_thread_func, input);
+
+   if (!queue->threads[index]) {
+      free(input);
+      return false;
+   }
+
+   worker->started = true;
+   worker->exited = false;
+
+   if (queue->flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY) {
+#if defined(__linux__) && defined(SCHED_IDLE)
+      struct sched_param sched_param = {0};
+
+      /* The nice() function can only set a maximum of 19.
+       * SCHED_IDLE is the same as nice = 20.
+       *
+       * Note that Linux only allows decreasing the priority. The original
+       * priority can't be restored.
+       */
+      pthread_setschedparam(queue->threads[index], SCHED_IDLE, &sched_param);
+#endif
+   }
+
+   return true;
+}
+
 bool
 util_queue_init(struct util_queue *queue,
                 const char *name,
@@ -329,60 +570,44 @@ util_queue_init(struct util_queue *queue,
    }
 
    queue->flags = flags;
-   queue->num_threads = num_threads;
+   queue->max_threads = num_threads;
    queue->max_jobs = max_jobs;
 
-   queue->jobs = (struct util_queue_job*)
-                 calloc(max_jobs, sizeof(struct util_queue_job));
-   if (!queue->jobs)
+   queue->workers = (struct util_queue_worker*)
+                    calloc(num_threads, sizeof(struct util_queue_worker));
+   if (!queue->workers)
       goto fail;
 
+   for (i = 0; i < num_threads; i++)
+      (void) mtx_init(&queue->workers[i].lock, mtx_plain);
+
    (void) mtx_init(&queue->lock, mtx_plain);
    (void) mtx_init(&queue->finish_lock, mtx_plain);
 
    queue->num_queued = 0;
    cnd_init(&queue->has_queued_cond);
    cnd_init(&queue->has_space_cond);
+   cnd_init(&queue->finished_cond);
 
    queue->threads = (thrd_t*) calloc(num_threads, sizeof(thrd_t));
    if (!queue->threads)
       goto fail;
 
-   /* start threads */
+   if (flags & UTIL_QUEUE_INIT_SCALE_THREADS)
+      num_threads = 1;
+
+   /* start threads, which must not see num_threads before it's final */
+   mtx_lock(&queue->lock);
    for (i = 0; i < num_threads; i++) {
-      struct thread_input *input =
-         (struct thread_input *) malloc(sizeof(struct thread_input));
-      input->queue = queue;
-      input->thread_index = i;
-
-      queue->threads[i] = u_thread_create(util_queue_thread_func, input);
-
-      if (!queue->threads[i]) {
-         free(input);
-
-         if (i == 0) {
-            /* no threads created, fail */
-            goto fail;
-         } else {
-            /* at least one thread created, so use it */
-            queue->num_threads = i;
-            break;
-         }
-      }
+      if (!util_queue_start_thread(queue, i))
+         break;
+   }
+   p_atomic_set(&queue->num_threads, i);
+   mtx_unlock(&queue->lock);
 
-      if (flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY) {
-   #if defined(__linux__) && defined(SCHED_IDLE)
-         struct sched_param sched_param = {0};
-
-         /* The nice() function can only set a maximum of 19.
-          * SCHED_IDLE is the same as nice = 20.
-          *
-          * Note that Linux only allows decreasing the priority. The original
-          * priority can't be restored.
-          */
-         pthread_setschedparam(queue->threads[i], SCHED_IDLE, &sched_param);
-   #endif
-      }
+   if (!queue->num_threads) {
+      /* no threads created, fail */
+      goto fail;
    }
 
    add_to_atexit_list(queue);
@@ -391,11 +616,15 @@ util_queue_init(struct util_queue *queue,
 fail:
    free(queue->threads);
 
-   if (queue->jobs) {
+   if (queue->workers) {
+      cnd_destroy(&queue->finished_cond);
       cnd_destroy(&queue->has_space_cond);
       cnd_destroy(&queue->has_queued_cond);
+      mtx_destroy(&queue->finish_lock);
       mtx_destroy(&queue->lock);
-      free(queue->jobs);
+      for (i = 0; i < queue->max_threads; i++)
+         mtx_destroy(&queue->workers[i].lock);
+      free(queue->workers);
    }
    /* also util_queue_is_initialized can be used to check for success */
    memset(queue, 0, sizeof(*queue));
@@ -409,13 +638,19 @@ util_queue_killall_and_wait(struct util_queue *queue)
 
    /* Signal all threads to terminate. */
    mtx_lock(&queue->lock);
-   queue->kill_threads = 1;
+   p_atomic_set(&queue->kill_threads, 1);
    cnd_broadcast(&queue->has_queued_cond);
+   cnd_broadcast(&queue->has_space_cond);
    mtx_unlock(&queue->lock);
 
-   for (i = 0; i < queue->num_threads; i++)
-      thrd_join(queue->threads[i], NULL);
-   queue->num_threads = 0;
+   /* No thread is started once kill_threads is set. */
+   for (i = 0; i < queue->max_threads; i++) {
+      if (queue->workers[i].started) {
+         thrd_join(queue->threads[i], NULL);
+         queue->workers[i].started = false;
+      }
+   }
+   p_atomic_set(&queue->num_threads, 0);
 }
 
 void
@@ -424,26 +659,70 @@ util_queue_destroy(struct util_queue *queue)
    util_queue_killall_and_wait(queue);
    remove_from_atexit_list(queue);
 
+   cnd_destroy(&queue->finished_cond);
    cnd_destroy(&queue->has_space_cond);
    cnd_destroy(&queue->has_queued_cond);
    mtx_destroy(&queue->finish_lock);
    mtx_destroy(&queue->lock);
-   free(queue->jobs);
+   for (unsigned i = 0; i < queue->max_threads; i++) {
+      mtx_destroy(&queue->workers[i].lock);
+      for (unsigned p = 0; p < UTIL_QUEUE_NUM_PRIORITIES; p++)
+         free(queue->workers[i].rings[p].jobs);
+   }
+   free(queue->workers);
    free(queue->threads);
 }
 
-void
-util_queue_add_job(struct util_queue *queue,
-                   void *job,
-                   struct util_queue_fence *fence,
-                   util_queue_execute_func execute,
-                   util_queue_execute_func cleanup)
+/**
+ * Count a job as queued, waiting for a free slot if the queue is full.
+ * Returns false if the threads were killed meanwhile.
+ */
+static bool
+util_queue_reserve_slot(struct util_queue *queue)
 {
-   struct util_queue_job *ptr;
+   /* If the queue is full, it just gets larger to avoid waiting for a free
+    * slot.
+    */
+   if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL) {
+      p_atomic_inc(&queue->num_queued);
+      return true;
+   }
 
-   mtx_lock(&queue->lock);
-   if (queue->kill_threads) {
+   while (p_atomic_inc_return(&queue->num_queued) > queue->max_jobs) {
+      p_atomic_dec(&queue->num_queued);
+
+      /* Wait until there is a free slot. */
+      mtx_lock(&queue->lock);
+      p_atomic_inc(&queue->num_waiting_for_space);
+      while (read_fenced(&queue->num_queued) >= queue->max_jobs &&
+             !queue->kill_threads)
+         cnd_wait(&queue->has_space_cond, &queue->lock);
+      p_atomic_dec(&queue->num_waiting_for_space);
       mtx_unlock(&queue->lock);
+
+      if (p_atomic_read(&queue->kill_threads))
+         return false;
+   }
+
+   return true;
+}
+
+void
+util_queue_add_job_with_priority(struct util_queue *queue,
+                                 void *job,
+                                 struct util_queue_fence *fence,
+                                 util_queue_execute_func execute,
+                                 util_queue_execute_func cleanup,
+                                 enum util_queue_priority priority)
+{
+   struct util_queue_worker *worker;
+   struct util_queue_job entry;
+   unsigned num_threads;
+
+   assert(priority < UTIL_QUEUE_NUM_PRIORITIES);
+
+   if (p_atomic_read(&queue->kill_threads) ||
+       !util_queue_reserve_slot(queue)) {
       /* well no good option here, but any leaks will be
        * short-lived as things are shutting down..
        */
@@ -452,53 +731,41 @@ util_queue_add_job(struct util_queue *queue,
 
    util_queue_fence_reset(fence);
 
-   assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
-
-   if (queue->num_queued == queue->max_jobs) {
-      if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL) {
-         /* If the queue is full, make it larger to avoid waiting for a free
-          * slot.
-          */
-         unsigned new_max_jobs = queue->max_jobs + 8;
-         struct util_queue_job *jobs =
-            (struct util_queue_job*)calloc(new_max_jobs,
-                                           sizeof(struct util_queue_job));
-         assert(jobs);
-
-         /* Copy all queued jobs into the new list. */
-         unsigned num_jobs = 0;
-         unsigned i = queue->read_idx;
-
-         do {
-            jobs[num_jobs++] = queue->jobs[i];
-            i = (i + 1) % queue->max_jobs;
-         } while (i != queue->write_idx);
-
-         assert(num_jobs == queue->num_queued);
-
-         free(queue->jobs);
-         queue->jobs = jobs;
-         queue->read_idx = 0;
-         queue->write_idx = num_jobs;
-         queue->max_jobs = new_max_jobs;
-      } else {
-         /* Wait until there is a free slot. */
-         while (queue->num_queued == queue->max_jobs)
-            cnd_wait(&queue->has_space_cond, &queue->lock);
-      }
-   }
+   entry.job = job;
+   entry.fence = fence;
+   entry.execute = execute;
+   entry.cleanup = cleanup;
+   entry.add_time = os_time_get_nano();
+   entry.generation = p_atomic_read(&queue->generation);
+   p_atomic_inc(&queue->num_pending[entry.generation & 1]);
 
-   ptr = &queue->jobs[queue->write_idx];
-   assert(ptr->job == NULL);
-   ptr->job = job;
-   ptr->fence = fence;
-   ptr->execute = execute;
-   ptr->cleanup = cleanup;
-   queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
+   /* Spread the jobs over the running threads. */
+   num_threads = MAX2(p_atomic_read(&queue->num_threads), 1);
+   worker = &queue->workers[p_atomic_inc_return(&queue->next_worker) %
+                            num_threads];
 
-   queue->num_queued++;
-   cnd_signal(&queue->has_queued_cond);
-   mtx_unlock(&queue->lock);
+   mtx_lock(&worker->lock);
+   ring_push(&worker->rings[priority], &entry);
+   mtx_unlock(&worker->lock);
+
+   if (read_fenced(&queue->num_sleeping)) {
+      mtx_lock(&queue->lock);
+      cnd_signal(&queue->has_queued_cond);
+      mtx_unlock(&queue->lock);
+   } else if (queue->flags & UTIL_QUEUE_INIT_SCALE_THREADS &&
+              p_atomic_read(&queue->num_threads) < queue->max_threads) {
+      /* All threads are busy, add one. */
+      mtx_lock(&queue->lock);
+      if (!queue->kill_threads && !queue->num_sleeping &&
+          queue->num_threads < queue->max_threads &&
+          util_queue_start_thread(queue, queue->num_threads))
+         p_atomic_inc(&queue->num_threads);
+      mtx_unlock(&queue->lock);
+   }
+
+   /* The threads may have been killed before the job was visible to them. */
+   if (p_atomic_read(&queue->kill_threads))
+      util_queue_signal_remaining(queue);
 }
 
 /**
@@ -515,36 +782,43 @@ void
 util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
 {
    bool removed = false;
+   unsigned generation = 0;
 
    if (util_queue_fence_is_signalled(fence))
       return;
 
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].fence == fence) {
-         if (queue->jobs[i].cleanup)
-            queue->jobs[i].cleanup(queue->jobs[i].job, -1);
-
-         /* Just clear it. The threads will treat as a no-op job. */
-         memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
-         removed = true;
-         break;
+   for (unsigned w = 0; w < queue->max_threads && !removed; w++) {
+      struct util_queue_worker *worker = &queue->workers[w];
+
+      mtx_lock(&worker->lock);
+      for (unsigned p = 0; p < UTIL_QUEUE_NUM_PRIORITIES && !removed; p++) {
+         struct util_queue_ring *ring = &worker->rings[p];
+
+         for (unsigned i = 0; i < ring->num_queued; i++) {
+            struct util_queue_job *job =
+               &ring->jobs[(ring->read_idx + i) & (ring->size - 1)];
+
+            if (job->job && job->fence == fence) {
+               if (job->cleanup)
+                  job->cleanup(job->job, -1);
+
+               /* Just clear it. The threads will treat as a no-op job. */
+               generation = job->generation;
+               memset(job, 0, sizeof(*job));
+               removed = true;
+               break;
+            }
+         }
       }
+      mtx_unlock(&worker->lock);
    }
-   mtx_unlock(&queue->lock);
 
-   if (removed)
+   if (removed) {
       util_queue_fence_signal(fence);
-   else
+      util_queue_job_done(queue, generation);
+   } else {
       util_queue_fence_wait(fence);
-}
-
-static void
-util_queue_finish_execute(void *data, int num_thread)
-{
-   util_barrier *barrier = data;
-   util_barrier_wait(barrier);
+   }
 }
 
 /**
@@ -553,39 +827,70 @@ util_queue_finish_execute(void *data, int num_thread)
 void
 util_queue_finish(struct util_queue *queue)
 {
-   util_barrier barrier;
-   struct util_queue_fence *fences = malloc(queue->num_threads * sizeof(*fences));
-
-   util_barrier_init(&barrier, queue->num_threads);
+   unsigned generation;
 
-   /* If 2 threads were adding jobs for 2 different barries at the same time,
-    * a deadlock would happen, because 1 barrier requires that all threads
-    * wait for it exclusively.
+   /* Jobs added from now on belong to the next generation. Since the
+    * previous util_queue_finish waited for the generation before this one,
+    * two counters are enough.
     */
    mtx_lock(&queue->finish_lock);
+   mtx_lock(&queue->lock);
 
-   for (unsigned i = 0; i < queue->num_threads; ++i) {
-      util_queue_fence_init(&fences[i]);
-      util_queue_add_job(queue, &barrier, &fences[i], util_queue_finish_execute, NULL);
-   }
+   generation = queue->generation;
+   p_atomic_set(&queue->generation, generation + 1);
 
-   for (unsigned i = 0; i < queue->num_threads; ++i) {
-      util_queue_fence_wait(&fences[i]);
-      util_queue_fence_destroy(&fences[i]);
-   }
-   mtx_unlock(&queue->finish_lock);
+   while (p_atomic_read(&queue->num_pending[generation & 1]))
+      cnd_wait(&queue->finished_cond, &queue->lock);
 
-   util_barrier_destroy(&barrier);
-
-   free(fences);
+   mtx_unlock(&queue->lock);
+   mtx_unlock(&queue->finish_lock);
 }
 
 int64_t
 util_queue_get_thread_time_nano(struct util_queue *queue, unsigned thread_index)
 {
+   int64_t time = 0;
+
+   /* Scaling may stop or restart the thread meanwhile. */
+   mtx_lock(&queue->lock);
    /* Allow some flexibility by not raising an error. */
-   if (thread_index >= queue->num_threads)
-      return 0;
+   if (thread_index < queue->num_threads)
+      time = u_thread_get_time_nano(queue->threads[thread_index]);
+   mtx_unlock(&queue->lock);
 
-   return u_thread_get_time_nano(queue->threads[thread_index]);
+   return time;
+}
+
+/**
+ * Change the number of threads, within the number given to util_queue_init.
+ * Stopped threads finish the job they are executing, and their queued jobs
+ * are taken by the remaining threads.
+ */
+void
+util_queue_adjust_num_threads(struct util_queue *queue, unsigned num_threads)
+{
+   num_threads = CLAMP(num_threads, 1, queue->max_threads);
+
+   mtx_lock(&queue->lock);
+   if (!queue->kill_threads) {
+      while (queue->num_threads < num_threads &&
+             util_queue_start_thread(queue, queue->num_threads))
+         p_atomic_inc(&queue->num_threads);
+
+      if (num_threads < queue->num_threads) {
+         p_atomic_set(&queue->num_threads, num_threads);
+         cnd_broadcast(&queue->has_queued_cond);
+      }
+   }
+   mtx_unlock(&queue->lock);
+}
+
+void
+util_queue_get_stats(struct util_queue *queue, struct util_queue_stats *stats)
+{
+   stats->num_jobs = p_atomic_read(&queue->stats.num_jobs);
+   stats->num_stolen = p_atomic_read(&queue->stats.num_stolen);
+   stats->total_wait_ns = p_atomic_read(&queue->stats.total_wait_ns);
+   stats->max_wait_ns = p_atomic_read(&queue->stats.max_wait_ns);
+   stats->total_run_ns = p_atomic_read(&queue->stats.total_run_ns);
 }
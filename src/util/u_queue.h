@@ -28,6 +28,12 @@
  *
  * Jobs can be added from any thread. After that, the wait call can be used
  * to wait for completion of the job.
+ *
+ * Each thread has its own lists of jobs, one per priority, which new jobs
+ * are spread over. A thread runs out of its own jobs before taking the
+ * oldest job of another thread, but starts jobs of a higher priority first
+ * wherever they are. Jobs of the same priority start in the order they
+ * were added when the queue has a single thread.
  */
 
 #ifndef U_QUEUE_H
@@ -48,6 +54,11 @@ extern "C" {
 
 #define UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY      (1 << 0)
 #define UTIL_QUEUE_INIT_RESIZE_IF_FULL            (1 << 1)
+/* Start with one thread, add threads up to the number given to
+ * util_queue_init when all are busy, and stop them after being idle for a
+ * while.
+ */
+#define UTIL_QUEUE_INIT_SCALE_THREADS             (1 << 2)
 
 #if defined(__GNUC__) && defined(HAVE_LINUX_FUTEX_H)
 #define UTIL_QUEUE_FENCE_FUTEX
@@ -190,28 +201,77 @@ util_queue_fence_wait_timeout(struct util_queue_fence *fence,
 
 typedef void (*util_queue_execute_func)(void *job, int thread_index);
 
+enum util_queue_priority {
+   UTIL_QUEUE_PRIORITY_HIGH,
+   UTIL_QUEUE_PRIORITY_NORMAL,
+   UTIL_QUEUE_PRIORITY_LOW,
+   UTIL_QUEUE_NUM_PRIORITIES,
+};
+
 struct util_queue_job {
    void *job;
    struct util_queue_fence *fence;
    util_queue_execute_func execute;
    util_queue_execute_func cleanup;
+   int64_t add_time;
+   unsigned generation;
+};
+
+/* FIFO of the jobs of one priority. */
+struct util_queue_ring {
+   struct util_queue_job *jobs;
+   unsigned size; /* power of two */
+   unsigned read_idx;
+   unsigned num_queued;
+};
+
+/* The jobs handed to one thread. */
+struct util_queue_worker {
+   mtx_t lock;
+   struct util_queue_ring rings[UTIL_QUEUE_NUM_PRIORITIES];
+
+   /* protected by the queue lock */
+   bool started; /* thrd_t is valid and must be joined */
+   bool exited;  /* the thread has stopped taking jobs */
+};
+
+/* Statistics of the jobs executed so far, see util_queue_get_stats. */
+struct util_queue_stats {
+   uint64_t num_jobs;
+   uint64_t num_stolen;    /* jobs a thread took from another's list */
+   uint64_t total_wait_ns; /* from util_queue_add_job to execution */
+   uint64_t max_wait_ns;
+   uint64_t total_run_ns;
 };
 
 /* Put this into your context. */
 struct util_queue {
    char name[14]; /* 13 characters = the thread name without the index */
    mtx_t finish_lock; /* only for util_queue_finish */
-   mtx_t lock;
+   mtx_t lock; /* for sleeping, waiting and starting or stopping threads */
    cnd_t has_queued_cond;
    cnd_t has_space_cond;
+   cnd_t finished_cond;
    thrd_t *threads;
+   struct util_queue_worker *workers;
    unsigned flags;
-   int num_queued;
-   unsigned num_threads;
+   int num_queued; /* including jobs being added */
+   unsigned num_threads; /* running, indices [0, num_threads) */
+   unsigned max_threads;
+   int num_sleeping;
+   int num_waiting_for_space;
    int kill_threads;
    int max_jobs;
-   int write_idx, read_idx; /* ring buffer pointers */
-   struct util_queue_job *jobs;
+   unsigned next_worker;
+
+   /* Jobs not completed yet, by parity of the generation they were added
+    * in. util_queue_finish starts a new generation and waits for the
+    * previous one.
+    */
+   unsigned generation;
+   int num_pending[2];
+
+   struct util_queue_stats stats;
 
    /* for cleanup at exit(), protected by exit_mutex */
    struct list_head head;
@@ -225,11 +285,23 @@ bool util_queue_init(struct util_queue *queue,
 void util_queue_destroy(struct util_queue *queue);
 
 /* optional cleanup callback is called after fence is signaled: */
-void util_queue_add_job(struct util_queue *queue,
-                        void *job,
-                        struct util_queue_fence *fence,
-                        util_queue_execute_func execute,
-                        util_queue_execute_func cleanup);
+void util_queue_add_job_with_priority(struct util_queue *queue,
+                                      void *job,
+                                      struct util_queue_fence *fence,
+                                      util_queue_execute_func execute,
+                                      util_queue_execute_func cleanup,
+                                      enum util_queue_priority priority);
+
+static inline void
+util_queue_add_job(struct util_queue *queue,
+                   void *job,
+                   struct util_queue_fence *fence,
+                   util_queue_execute_func execute,
+                   util_queue_execute_func cleanup)
+{
+   util_queue_add_job_with_priority(queue, job, fence, execute, cleanup,
+                                    UTIL_QUEUE_PRIORITY_NORMAL);
+}
 void util_queue_drop_job(struct util_queue *queue,
                          struct util_queue_fence *fence);
 
@@ -238,6 +310,12 @@ void util_queue_finish(struct util_queue *queue);
 int64_t util_queue_get_thread_time_nano(struct util_queue *queue,
                                         unsigned thread_index);
 
+void util_queue_adjust_num_threads(struct util_queue *queue,
+                                   unsigned num_threads);
+
+void util_queue_get_stats(struct util_queue *queue,
+                          struct util_queue_stats *stats);
+
 /* util_queue needs to be cleared to zeroes for this to work */
 static inline bool
 util_queue_is_initialized(struct util_queue *queue)
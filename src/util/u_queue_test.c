@@ -0,0 +1,248 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Force assertions, even on release builds. */
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "macros.h"
+#include "os_time.h"
+#include "u_atomic.h"
+#include "u_queue.h"
+
+#define NUM_JOBS 64
+
+struct test_job {
+   struct util_queue_fence fence;
+   int *order;
+   int *next;
+   int id;
+};
+
+/* Jobs record their execution order. */
+static void
+record_execute(void *data, int thread_index)
+{
+   struct test_job *job = data;
+
+   job->order[p_atomic_inc_return(job->next) - 1] = job->id;
+}
+
+/* A job keeping the thread busy until the test releases it. */
+static void
+block_execute(void *data, int thread_index)
+{
+   util_queue_fence_wait(data);
+}
+
+static void
+sleep_execute(void *data, int thread_index)
+{
+   os_time_sleep(1000);
+}
+
+struct monitor {
+   struct util_queue *queue;
+   int done;
+};
+
+/* Polls the queue like the HUD does, from another thread. */
+static int
+monitor_thread(void *data)
+{
+   struct monitor *mon = data;
+   struct util_queue_stats stats;
+
+   while (!p_atomic_read(&mon->done)) {
+      util_queue_get_stats(mon->queue, &stats);
+      for (unsigned i = 0; i < 4; i++)
+         util_queue_get_thread_time_nano(mon->queue, i);
+      os_time_sleep(100);
+   }
+   return 0;
+}
+
+static void
+init_jobs(struct test_job *jobs, unsigned num, int *order, int *next)
+{
+   for (unsigned i = 0; i < num; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      jobs[i].order = order;
+      jobs[i].next = next;
+      jobs[i].id = i;
+   }
+}
+
+static void
+destroy_jobs(struct test_job *jobs, unsigned num)
+{
+   for (unsigned i = 0; i < num; i++)
+      util_queue_fence_destroy(&jobs[i].fence);
+}
+
+static void
+test_fifo(void)
+{
+   struct util_queue queue;
+   struct test_job jobs[NUM_JOBS];
+   struct util_queue_stats stats;
+   int order[NUM_JOBS], next = 0;
+
+   /* A small queue, so that adding jobs waits for free slots. */
+   assert(util_queue_init(&queue, "test", 4, 1, 0));
+   init_jobs(jobs, NUM_JOBS, order, &next);
+
+   for (unsigned i = 0; i < NUM_JOBS; i++)
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence, record_execute,
+                         NULL);
+   util_queue_finish(&queue);
+
+   assert(next == NUM_JOBS);
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      assert(util_queue_fence_is_signalled(&jobs[i].fence));
+      assert(order[i] == (int)i);
+   }
+
+   util_queue_get_stats(&queue, &stats);
+   assert(stats.num_jobs == NUM_JOBS);
+   assert(stats.num_stolen == 0);
+   assert(stats.max_wait_ns * NUM_JOBS >= stats.total_wait_ns);
+
+   util_queue_destroy(&queue);
+   destroy_jobs(jobs, NUM_JOBS);
+}
+
+static void
+test_priorities(void)
+{
+   static const enum util_queue_priority priorities[] = {
+      UTIL_QUEUE_PRIORITY_LOW,
+      UTIL_QUEUE_PRIORITY_NORMAL,
+      UTIL_QUEUE_PRIORITY_HIGH,
+      UTIL_QUEUE_PRIORITY_LOW,
+      UTIL_QUEUE_PRIORITY_HIGH,
+      UTIL_QUEUE_PRIORITY_NORMAL,
+   };
+   static const int expected[] = { 2, 4, 1, 5, 0, 3 };
+   struct util_queue queue;
+   struct util_queue_fence block_fence, release;
+   struct test_job jobs[ARRAY_SIZE(priorities)];
+   int order[ARRAY_SIZE(priorities)], next = 0;
+
+   assert(util_queue_init(&queue, "test", 8, 1, 0));
+   init_jobs(jobs, ARRAY_SIZE(jobs), order, &next);
+
+   /* Keep the thread busy until all jobs are queued. */
+   util_queue_fence_init(&block_fence);
+   util_queue_fence_init(&release);
+   util_queue_fence_reset(&release);
+   util_queue_add_job(&queue, &release, &block_fence, block_execute, NULL);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(jobs); i++) {
+      util_queue_add_job_with_priority(&queue, &jobs[i], &jobs[i].fence,
+                                       record_execute, NULL, priorities[i]);
+   }
+
+   /* A dropped job doesn't execute. */
+   util_queue_drop_job(&queue, &jobs[3].fence);
+   assert(util_queue_fence_is_signalled(&jobs[3].fence));
+
+   util_queue_fence_signal(&release);
+   util_queue_finish(&queue);
+
+   assert(next == ARRAY_SIZE(jobs) - 1);
+   for (unsigned i = 0, j = 0; i < ARRAY_SIZE(expected); i++) {
+      if (expected[i] == 3)
+         continue;
+      assert(order[j++] == expected[i]);
+   }
+
+   util_queue_destroy(&queue);
+   util_queue_fence_destroy(&block_fence);
+   util_queue_fence_destroy(&release);
+   destroy_jobs(jobs, ARRAY_SIZE(jobs));
+}
+
+static void
+test_scale_threads(void)
+{
+   struct util_queue queue;
+   struct util_queue_fence fences[NUM_JOBS];
+   struct util_queue_stats stats;
+   struct monitor mon = { &queue, 0 };
+   thrd_t monitor;
+
+   assert(util_queue_init(&queue, "test", NUM_JOBS, 4,
+                          UTIL_QUEUE_INIT_SCALE_THREADS));
+   assert(p_atomic_read(&queue.num_threads) == 1);
+   monitor = u_thread_create(monitor_thread, &mon);
+
+   /* Threads are added while all are busy. */
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      util_queue_fence_init(&fences[i]);
+      util_queue_add_job(&queue, &fences[i], &fences[i], sleep_execute,
+                         NULL);
+   }
+   util_queue_finish(&queue);
+   assert(p_atomic_read(&queue.num_threads) > 1 &&
+          p_atomic_read(&queue.num_threads) <= 4);
+
+   util_queue_adjust_num_threads(&queue, 1);
+   assert(p_atomic_read(&queue.num_threads) == 1);
+   util_queue_adjust_num_threads(&queue, 100);
+   assert(p_atomic_read(&queue.num_threads) == 4);
+
+   /* The jobs of the stopped threads are executed by the others. */
+   for (unsigned i = 0; i < NUM_JOBS; i++)
+      util_queue_add_job(&queue, &fences[i], &fences[i], sleep_execute,
+                         NULL);
+   util_queue_adjust_num_threads(&queue, 2);
+   util_queue_finish(&queue);
+
+   for (unsigned i = 0; i < NUM_JOBS; i++)
+      assert(util_queue_fence_is_signalled(&fences[i]));
+
+   p_atomic_set(&mon.done, 1);
+   thrd_join(monitor, NULL);
+
+   util_queue_get_stats(&queue, &stats);
+   assert(stats.num_jobs == 2 * NUM_JOBS);
+   assert(stats.total_run_ns >= 2 * NUM_JOBS * 1000);
+
+   util_queue_destroy(&queue);
+   for (unsigned i = 0; i < NUM_JOBS; i++)
+      util_queue_fence_destroy(&fences[i]);
+}
+
+int
+main(int argc, char *argv[])
+{
+   test_fifo();
+   test_priorities();
+   test_scale_threads();
+
+   return 0;
+}
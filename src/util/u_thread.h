@@ -93,6 +93,32 @@ util_pin_thread_to_L3(thrd_t thread, unsigned L3_index, unsigned cores_per_L3)
 #endif
 }
 
+/**
+ * Restrict a thread to an arbitrary set of CPUs.
+ *
+ * \param thread         thread
+ * \param mask           bitmask of the OS CPU numbers, 32 CPUs per word
+ * \param num_mask_bits  number of bits in mask
+ * \return true on success
+ */
+static inline bool
+util_set_thread_affinity(thrd_t thread, const uint32_t *mask,
+                         unsigned num_mask_bits)
+{
+#if defined(HAVE_PTHREAD)
+   cpu_set_t cpuset;
+
+   CPU_ZERO(&cpuset);
+   for (unsigned i = 0; i < num_mask_bits && i < CPU_SETSIZE; i++) {
+      if (mask[i / 32] & (1u << (i % 32)))
+         CPU_SET(i, &cpuset);
+   }
+   return pthread_setaffinity_np(thread, sizeof(cpuset), &cpuset) == 0;
+#else
+   return false;
+#endif
+}
+
 /**
  * Return the index of L3 that the thread is pinned to. If the thread is
  * pinned to multiple L3 caches, return -1.